@@ -63,6 +63,24 @@ sipi = {
         j2k = "high"
     },
 
+    --
+    -- JPEG renderings of a JPEG2000 image whose longest edge is at most this many pixels decode only
+    -- part of the codestream's quality layers (at least half of them; fewer for smaller outputs and
+    -- lower jpeg_quality values). The skipped layers only refine detail that the downscale and the
+    -- JPEG compression throw away, so thumbnails and low-zoom tiles decode less. 0 turns it off.
+    --
+    -- j2k_layer_truncation_size = 512,
+
+    --
+    -- How "gray" renderings of colour JPEG2000 images decode. "exact" (the default) decodes all
+    -- colour components and converts them to gray through the ICC profiles. "luminance" decodes only
+    -- the codestream's luma component, a third of the decoding work, at a small tonal deviation;
+    -- "luminance_toned" additionally corrects the luma to the exact path's gray tone curve (exact
+    -- for neutral colours). Images without a luma component (palette, alpha, CMYK, ICC-tagged
+    -- RGB) always decode exactly.
+    --
+    -- j2k_gray_decode = "exact",
+
     --
     -- Maximal size of a post request.
     --
@@ -107,6 +125,20 @@ sipi = {
     --
     cache_nfiles = 8,
 
+    --
+    -- Directory for shadow pyramids (auto-created if missing; unset or '' = off). A JPEG, PNG or
+    -- untiled TIFF has no reduced resolutions, so every tile and thumbnail of it decodes the full
+    -- image. After shadow_hot_threshold such decodes, a tiled pyramidal TIFF copy of the image is
+    -- written here in the background and later requests decode from it, for as long as the
+    -- original's modification time and size are unchanged. Builds run one at a time at low
+    -- priority and only while half of the decode memory budget is free and no request waits for
+    -- it. Copies of deleted or rewritten originals are removed, and the least recently used ones
+    -- once the directory grows beyond shadow_max_size ('-1' = unlimited).
+    --
+    -- shadow_dir = './shadows',
+    -- shadow_max_size = '10G',
+    -- shadow_hot_threshold = 3,
+
     --
     -- Path to the directory where the scripts for the routes defined below are to be found
     --
@@ -139,6 +171,18 @@ sipi = {
     -- "WARNING", "ERR", "CRIT", "ALERT", "EMERG" (default "INFO").
     --
 
+    --
+    -- Serves at least this many milliseconds slow are logged at WARNING with
+    -- their profiling zones (the flight recorder); 0 = off.
+    --
+    -- slow_request_ms = 1000,
+
+    --
+    -- Server-mode log lines written per second for each level below ERR; the
+    -- excess is counted, not written. 0 = off.
+    --
+    -- log_rate_limit = 200,
+
     --
     -- The two-lane admission knobs are CLI/env (or Rust TOML config) settings,
     -- not Lua config keys:
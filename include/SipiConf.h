@@ -45,17 +45,24 @@ private:
   bool prefix_as_path{ true };//<! Use IIIF-prefix as part of path or ignore it...
   int jpeg_quality{ 80 };
   std::map<std::string, std::string> scaling_quality;
+  int j2k_layer_truncation_size{ 0 };//<! longest output edge (px) up to which JPEG2000 decodes drop quality layers; 0 = off
+  std::string j2k_gray_decode{ "exact" };//<! "exact" | "luminance" | "luminance_toned": how gray renderings of colour JPEG2000 decode
   std::string init_script;
   std::string cache_dir;
   long long cache_size{ 200LL * 1024 * 1024 };// 200M (the Lua-config default)
   std::string thumb_size;
   size_t cache_n_files{ 200 };
+  std::string shadow_dir;//<! directory for the shadow pyramids of hot flat sources; empty = off
+  long long shadow_max_size{ 10LL * 1024 * 1024 * 1024 };//<! size cap of shadow_dir, 10G; -1 = unlimited
+  int shadow_hot_threshold{ 3 };//<! decodes of a flat source after which its shadow pyramid is built
   size_t max_post_size{ 0 }; // 0 = unlimited
   std::string tmp_dir;
   std::string scriptdir;
   std::string knora_path;
   std::string knora_port;
   std::string loglevel;
+  int slow_request_ms{ 1000 };//<! flight-recorder threshold: serves at least this slow are kept and logged; 0 = off
+  unsigned log_rate_limit{ 200 };//<! server-mode log lines per second written for each level below ERR; 0 = off
   std::string docroot;
   std::string wwwroute;
   std::string jwt_secret;
@@ -93,6 +100,12 @@ public:
   std::map<std::string, std::string> getScalingQuality() { return scaling_quality; }
   void setScalingQuality(const std::map<std::string, std::string> &v) { scaling_quality = v; }
 
+  int getJ2kLayerTruncationSize() const { return j2k_layer_truncation_size; }
+  void setJ2kLayerTruncationSize(int i) { j2k_layer_truncation_size = i; }
+
+  std::string getJ2kGrayDecode() { return j2k_gray_decode; }
+  void setJ2kGrayDecode(const std::string &str) { j2k_gray_decode = str; }
+
   std::string getInitScript() { return init_script; }
   void setInitScript(const std::string &str) { init_script = str; }
 
@@ -102,6 +115,15 @@ public:
   std::string getCacheDir() { return cache_dir; }
   void setCacheDir(const std::string &str) { cache_dir = str; }
 
+  std::string getShadowDir() { return shadow_dir; }
+  void setShadowDir(const std::string &str) { shadow_dir = str; }
+
+  long long getShadowMaxSize() const { return shadow_max_size; }
+  void setShadowMaxSize(long long i) { shadow_max_size = i; }
+
+  int getShadowHotThreshold() const { return shadow_hot_threshold; }
+  void setShadowHotThreshold(int i) { shadow_hot_threshold = i; }
+
   std::string getThumbSize() { return thumb_size; }
   void setThumbSize(const std::string &str) { thumb_size = str; }
 
@@ -127,6 +149,12 @@ public:
   std::string getLoglevel() { return loglevel; }
   void setLogLevel(const std::string &str) { loglevel = str; }
 
+  int getSlowRequestMs() const { return slow_request_ms; }
+  void setSlowRequestMs(int i) { slow_request_ms = i; }
+
+  unsigned getLogRateLimit() const { return log_rate_limit; }
+  void setLogRateLimit(unsigned n) { log_rate_limit = n; }
+
   std::string getDocRoot() { return docroot; }
   void setDocRoot(const std::string &str) { docroot = str; }
 
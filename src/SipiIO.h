@@ -9,9 +9,12 @@
 #ifndef _sipi_io_h
 #define _sipi_io_h
 
+#include <cstddef>
 #include <cstdint>
+#include <functional>
 #include <string>
 #include <unordered_map>
+#include <vector>
 
 #include "iiifparser/SipiRegion.h"
 #include "iiifparser/SipiSize.h"
@@ -26,12 +29,26 @@ namespace Sipi {
 
 enum class ScalingMethod : std::uint8_t { HIGH = 0, MEDIUM = 1, LOW = 2 };
 
+//! How a `gray` rendering of a colour JPEG2000 decodes. EXACT decodes all
+//! components and converts to gray through the ICC profiles; LUMINANCE decodes
+//! only the codestream's luma component (Y of the irreversible/reversible
+//! colour transform), tagged `icc_GRAY_sRGB`; LUMINANCE_TONED additionally maps
+//! that luma onto the exact path's `icc_GRAY_D50` tone curve (see
+//! `j2k_luma_tone`, SipiIOJ2k.h).
+enum class J2kGrayDecode : std::uint8_t { EXACT = 0, LUMINANCE = 1, LUMINANCE_TONED = 2 };
+
 struct ScalingQuality
 {
   ScalingMethod jk2;
   ScalingMethod jpeg;
   ScalingMethod tiff;
   ScalingMethod png;
+  //! Share (1-100 %) of a JPEG2000 codestream's quality layers to decode; 0 = all
+  //! layers. Set per request from `j2k_layer_percent` (SipiIOJ2k.h).
+  std::uint8_t j2k_layer_percent{ 0 };
+  //! Gray-rendering hint for JPEG2000 reads. Set per request, and only for the
+  //! IIIF `gray` quality; EXACT leaves the decode untouched.
+  J2kGrayDecode j2k_gray{ J2kGrayDecode::EXACT };
 };
 
 enum Orientation : std::uint8_t {
@@ -98,12 +115,25 @@ enum SipiCompressionParamName : std::uint8_t {
   J2K_Stiles,
   J2K_rates,
   TIFF_Pyramid,
+  TIFF_Compression,
 };
 
 using SipiCompressionParams = std::unordered_map<int, std::string>;
 
 class SipiImage;//!< forward declaration of class SipiImage
 
+//! One rendering of a multi-tile read (`SipiIO::read_tiles`): the region of the
+//! source and the size to scale it to, as for a single `read`.
+struct SipiTileRequest
+{
+  std::shared_ptr<SipiRegion> region;
+  std::shared_ptr<SipiSize> size;
+};
+
+//! Receives the decoded tile `index` of a multi-tile read. The image is the
+//! callee's to move from; it is destroyed when the call returns.
+using SipiTileEmit = std::function<void(std::size_t index, SipiImage &img)>;
+
 /*!
  * This is the virtual base class for all classes implementing image I/O.
  */
@@ -167,6 +197,25 @@ public:
    */
   [[nodiscard]] virtual SipiImgInfo read_shape(const std::string &filepath) = 0;
 
+  /*!
+   * Read several regions of one image file, handing each decoded image to
+   * `emit` in request order before the next one is decoded. Handlers that can
+   * keep the source open across the reads (one TIFF handle, one JPEG2000
+   * codestream) override this; the default reads each tile with `read`.
+   *
+   * \param filepath Image file path
+   * \param tiles Region and size of each rendering
+   * \param force_bps_8 Convert every tile to 8 bits/sample
+   * \param scaling_quality Quality of the scaling algorithm
+   * \param emit Receives each decoded tile
+   * \return false if the file is not of this handler's format (nothing emitted)
+   */
+  virtual bool read_tiles(const std::string &filepath,
+    const std::vector<SipiTileRequest> &tiles,
+    bool force_bps_8,
+    ScalingQuality scaling_quality,
+    const SipiTileEmit &emit);
+
 
   /*!
    * Write an image using the given file format implemented by the subclass.
@@ -286,6 +286,62 @@ void SipiImage::read(const std::string &filepath,
 
 //============================================================================
 
+bool SipiIO::read_tiles(const std::string &filepath,
+  const std::vector<SipiTileRequest> &tiles,
+  bool force_bps_8,
+  ScalingQuality scaling_quality,
+  const SipiTileEmit &emit)
+{
+  for (std::size_t i = 0; i < tiles.size(); ++i) {
+    SipiImage tile;
+    if (!read(&tile, filepath, tiles[i].region, tiles[i].size, force_bps_8, scaling_quality)) {
+      if (i == 0) { return false; }
+      throw SipiImageError("Error reading tile " + std::to_string(i) + " of file " + filepath);
+    }
+    emit(i, tile);
+  }
+  return true;
+}
+
+//============================================================================
+
+void SipiImage::read_tiles(const std::string &filepath,
+  const std::vector<SipiTileRequest> &tiles,
+  const SipiTileEmit &emit,
+  bool force_bps_8,
+  ScalingQuality scaling_quality)
+{
+  SIPI_ZONE_N("SipiImage::read_tiles");
+  if (tiles.empty()) { return; }
+  size_t pos = filepath.find_last_of('.');
+  std::string fext = filepath.substr(pos + 1);
+  std::string _fext;
+
+  bool got_file = false;
+  _fext.resize(fext.size());
+  std::transform(fext.begin(), fext.end(), _fext.begin(), ::tolower);
+
+  if ((_fext == "tif") || (_fext == "tiff")) {
+    got_file = io[std::string("tif")]->read_tiles(filepath, tiles, force_bps_8, scaling_quality, emit);
+  } else if ((_fext == "jpg") || (_fext == "jpeg")) {
+    got_file = io[std::string("jpg")]->read_tiles(filepath, tiles, force_bps_8, scaling_quality, emit);
+  } else if (_fext == "png") {
+    got_file = io[std::string("png")]->read_tiles(filepath, tiles, force_bps_8, scaling_quality, emit);
+  } else if ((_fext == "jp2") || (_fext == "jpx") || (_fext == "j2k")) {
+    got_file = io[std::string("jpx")]->read_tiles(filepath, tiles, force_bps_8, scaling_quality, emit);
+  }
+
+  if (!got_file) {
+    for (auto const &iterator : io) {
+      if ((got_file = iterator.second->read_tiles(filepath, tiles, force_bps_8, scaling_quality, emit))) break;
+    }
+  }
+
+  if (!got_file) { throw SipiImageError("Error reading file " + filepath); }
+}
+
+//============================================================================
+
 void SipiImage::readSource(const std::string &filepath,
   const std::shared_ptr<SipiRegion> &region,
   const std::shared_ptr<SipiSize> &size)
@@ -520,7 +576,8 @@ void SipiImage::convertToIcc(const Icc &target_icc_p, int new_bps)
 
   PredefinedProfiles targetPT = target_icc_p.getProfileType();
   switch (targetPT) {
-  case icc_GRAY_D50: {
+  case icc_GRAY_D50:
+  case icc_GRAY_sRGB: {
     photo = PhotometricInterpretation::MINISBLACK;
     break;
   }
@@ -986,95 +1043,6 @@ bool SipiImage::scaleMedium(size_t nnx, size_t nny)
 /*==========================================================================*/
 
 
-namespace {
-
-// Fixed-point one (weights sum to this per output). kResamplePrecisionBits and
-// the accumulation kernel live in resample.h / resample.cc; the builder below
-// only produces the integer weights the kernel consumes.
-constexpr int32_t kResampleOne = 1 << kResamplePrecisionBits;
-
-// Separable resample weights for one axis, in CSR layout: output sample `i`
-// is the weighted sum of source samples idx[offset[i] .. offset[i+1]). The
-// per-output weights are fixed-point and sum to exactly kResampleOne. Shrinking
-// uses area (box) averaging for an anti-aliased downscale; enlarging uses 2-tap
-// linear interpolation; an unchanged axis is an identity passthrough.
-struct AxisWeights
-{
-  std::vector<size_t> offset;// dst + 1 row pointers into idx/wt
-  std::vector<size_t> idx;   // source sample indices
-  std::vector<int32_t> wt;   // fixed-point weights (each output's weights sum to kResampleOne)
-};
-
-AxisWeights build_axis_weights(size_t src, size_t dst)
-{
-  AxisWeights w;
-  std::vector<double> dwt;// real-valued weights, quantised to fixed point below
-  w.offset.reserve(dst + 1);
-
-  if (dst == src) {
-    for (size_t i = 0; i < dst; ++i) {
-      w.offset.push_back(w.idx.size());
-      w.idx.push_back(i);
-      dwt.push_back(1.0);
-    }
-  } else if (dst < src) {
-    // Area averaging: output i covers the source interval [i*ratio, (i+1)*ratio);
-    // each covered source sample contributes its overlap length, normalised by
-    // the interval width so the weights sum to 1.
-    const double ratio = static_cast<double>(src) / static_cast<double>(dst);
-    for (size_t i = 0; i < dst; ++i) {
-      w.offset.push_back(w.idx.size());
-      const double start = static_cast<double>(i) * ratio;
-      const double end = static_cast<double>(i + 1) * ratio;
-      for (auto s = static_cast<size_t>(std::floor(start)); static_cast<double>(s) < end && s < src; ++s) {
-        const double lo = std::max(start, static_cast<double>(s));
-        const double hi = std::min(end, static_cast<double>(s + 1));
-        const double cover = hi - lo;
-        if (cover <= 0.0) { continue; }
-        w.idx.push_back(s);
-        dwt.push_back(cover / ratio);
-      }
-    }
-  } else {
-    // Enlarge: 2-tap linear interpolation. The sample position matches the
-    // legacy mapping i*(src-1)/(dst-1), so an exact integer upscale lands on
-    // grid points.
-    for (size_t i = 0; i < dst; ++i) {
-      w.offset.push_back(w.idx.size());
-      const double pos =
-        (dst > 1) ? static_cast<double>(i) * static_cast<double>(src - 1) / static_cast<double>(dst - 1) : 0.0;
-      const auto s0 = static_cast<size_t>(std::floor(pos));
-      const double frac = pos - static_cast<double>(s0);
-      const size_t s1 = std::min(s0 + 1, src - 1);
-      w.idx.push_back(s0);
-      dwt.push_back(1.0 - frac);
-      if (s1 != s0) {
-        w.idx.push_back(s1);
-        dwt.push_back(frac);
-      }
-    }
-  }
-  w.offset.push_back(w.idx.size());
-
-  // Quantise each output's real weights to fixed point, then fold the rounding
-  // residual into the largest tap so the group sums to exactly kResampleOne
-  // (preserves the DC level: a flat region resamples to itself).
-  w.wt.resize(dwt.size());
-  for (size_t i = 0; i + 1 < w.offset.size(); ++i) {
-    int32_t sum = 0;
-    size_t max_t = w.offset[i];
-    for (size_t t = w.offset[i]; t < w.offset[i + 1]; ++t) {
-      w.wt[t] = static_cast<int32_t>(std::lround(dwt[t] * kResampleOne));
-      sum += w.wt[t];
-      if (dwt[t] > dwt[max_t]) { max_t = t; }
-    }
-    if (w.offset[i] < w.offset[i + 1]) { w.wt[max_t] += kResampleOne - sum; }
-  }
-  return w;
-}
-
-}// namespace
-
 bool SipiImage::scale(size_t nnx, size_t nny)
 {
   SIPI_ZONE_N("SipiImage::scale");
@@ -189,6 +189,11 @@ public:
    */
   [[nodiscard]] size_t getBps() const { return bps; }
 
+  /*!
+   * Bytes held by the pixel buffer (its capacity, which may exceed nx * ny * nc * bps / 8)
+   */
+  [[nodiscard]] size_t getPixelBytes() const { return pixels.capacity(); }
+
   /**
    * Get the exif metadata of the image.
    * \return exif metadata
@@ -349,6 +354,30 @@ public:
       ScalingMethod::HIGH,
       ScalingMethod::HIGH });
 
+  /*!
+   * Read several regions of one image file against a single open source: the
+   * TIFF and JPEG2000 handlers open the file, parse its header and set up the
+   * decoder once for the whole list instead of once per tile. Each decoded tile
+   * is handed to `emit` in request order before the next is decoded, so only
+   * one tile's pixels are live at a time.
+   *
+   * \param[in] filepath A string containing the path to the image file
+   * \param[in] tiles Region and size of each rendering (as for `read`)
+   * \param[in] emit Receives each decoded tile with its index in `tiles`
+   * \param[in] force_bps_8 We want in any case 8 Bit/sample tiles. Default is false.
+   * \param[in] scaling_quality Quality of the scaling algorithm. Default is HIGH.
+   *
+   * \throws SipiImageError
+   */
+  static void read_tiles(const std::string &filepath,
+    const std::vector<SipiTileRequest> &tiles,
+    const SipiTileEmit &emit,
+    bool force_bps_8 = false,
+    ScalingQuality scaling_quality = { ScalingMethod::HIGH,
+      ScalingMethod::HIGH,
+      ScalingMethod::HIGH,
+      ScalingMethod::HIGH });
+
   /*!
    * Read an image from disk into memory. The tool makes no claim that the file
    * is "the original" — it is the source for the current operation (ADR-0009,
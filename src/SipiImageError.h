@@ -118,6 +118,9 @@ private:
  * needed (POLLRDHUP misses RST and write-timeout aborts). The HTTP handler
  * uses the distinct type to skip Sentry capture — these are not
  * server-side errors.
+ *
+ * A decode abandoned at a cancellation checkpoint (`decode_cancel.h`) ends
+ * with the same type: the client is gone before the response has begun.
  */
 class SipiImageClientAbortError final : public SipiImageError
 {
@@ -1,4 +1,5 @@
-/* Reads mimalloc's allocator accounting for the `sipi.malloc.*` gauges.
+/* Reads mimalloc's allocator accounting for the `sipi.malloc.*` gauges and
+ * the engine's decode-memory calibration.
  *
  * Deliberately a C translation unit compiled against the vendored
  * `mimalloc-stats.h` (the same @mimalloc tree the allocator links from), so
@@ -44,3 +45,17 @@ bool sipi_mi_stats_read(int64_t* malloc_normal_current,
   *rss_current = (int64_t)current_rss;
   return true;
 }
+
+/* Memory mimalloc currently has committed, process-wide, for the engine's
+ * peak-memory calibration (`sipi_set_heap_reader`). A decode's codec buffers
+ * are allocated on worker threads too (Kakadu's thread environment, the TIFF
+ * strip and JPEG-tile workers), and `malloc_normal`/`malloc_huge` only see a
+ * thread's allocations once that thread merges its statistics; the commit
+ * count is kept process-wide as it changes. The engine records a reading only
+ * for a decode that ran with no other engine work in flight. */
+int64_t sipi_mi_heap_in_use(void) {
+  size_t elapsed, user, sys, current_rss, peak_rss, current_commit, peak_commit, faults;
+  mi_process_info(&elapsed, &user, &sys, &current_rss, &peak_rss, &current_commit, &peak_commit,
+                  &faults);
+  return (int64_t)current_commit;
+}
@@ -3,4 +3,5 @@
 //! forwarded to the C++ CLI by `main`.
 
 pub mod health;
+pub mod replay;
 pub mod server;
@@ -0,0 +1,227 @@
+//! The `replay` verb: replay an access log through the engine, offline, and
+//! report latency, cache hit rate, memory-budget rejections and peak RSS.
+//!
+//! The engine is configured exactly as for `server` — a Lua or TOML `--config`
+//! plus the path, cache, limits and logging flags layered on top — so two runs
+//! of the same log with one knob changed (`--cache-size`,
+//! `--tiles-memory-ratio`, a config with another `scaling_quality`) compare
+//! like for like. The replay itself lives in the `sipi` library
+//! ([`sipi::replay`]); this module owns the clap surface and the mapping onto
+//! `ServerOverrides`.
+
+use super::server::args::{CacheArgs, ConcurrencyArgs, LimitsArgs, LoggingArgs, PathArgs};
+use clap::Parser;
+use sipi::replay::{Pace, ReplayOptions};
+use sipi::ServerOverrides;
+use std::path::PathBuf;
+use std::process::ExitCode;
+use std::time::Duration;
+
+#[derive(Parser, Debug)]
+#[command(name = "sipi replay", term_width = 0)]
+struct ReplayArgs {
+    /// The access log: Common/Combined Log Format, or one
+    /// `<unix-seconds> [GET|HEAD] <path>` request per line. Identifiers resolve
+    /// under the image root; Lua routes and preflight hooks are not run.
+    #[arg(value_name = "LOG")]
+    log: PathBuf,
+
+    /// Path to the SIPI Lua or TOML config the engine is installed from.
+    #[arg(long, short = 'c', env = "SIPI_CONFIGFILE", value_name = "FILE")]
+    config: Option<String>,
+
+    /// Open loop: replay at the logged rate times this factor (default 1).
+    #[arg(long, value_name = "FACTOR", conflicts_with = "concurrency", value_parser = parse_speed)]
+    speed: Option<f64>,
+    /// Closed loop: keep this many requests in flight, each client sending its
+    /// next request as soon as the last one completes.
+    #[arg(long, value_name = "N", value_parser = clap::value_parser!(u32).range(1..))]
+    concurrency: Option<u32>,
+    /// Length in seconds of one row of the over-time report.
+    #[arg(long, value_name = "SECS", default_value_t = 10, value_parser = clap::value_parser!(u64).range(1..))]
+    window: u64,
+    /// Replay only the first N requests of the log.
+    #[arg(long, value_name = "N")]
+    limit: Option<usize>,
+    /// Print the report as JSON instead of text.
+    #[arg(long)]
+    json: bool,
+
+    #[command(flatten)]
+    concurrency_args: ConcurrencyArgs,
+    #[command(flatten)]
+    limits: LimitsArgs,
+    #[command(flatten)]
+    paths: PathArgs,
+    #[command(flatten)]
+    cache: CacheArgs,
+    #[command(flatten)]
+    logging: LoggingArgs,
+}
+
+fn parse_speed(s: &str) -> Result<f64, String> {
+    match s.parse::<f64>() {
+        Ok(v) if v.is_finite() && v > 0.0 => Ok(v),
+        _ => Err(format!("`{s}` is not a positive number")),
+    }
+}
+
+impl From<&ReplayArgs> for ServerOverrides {
+    fn from(args: &ReplayArgs) -> Self {
+        // Exhaustive like `From<&ServerArgs>`: a flag added to a shared group
+        // fails to compile here until it is forwarded or bound `_`. The
+        // concurrency group is handed to the admission pool directly, and the
+        // preflight cache has no preflight to serve here.
+        let PathArgs {
+            imgroot,
+            docroot,
+            wwwroute,
+            scriptdir,
+            tmpdir,
+            maxtmpage,
+            initscript,
+            pathprefix,
+        } = &args.paths;
+        let CacheArgs {
+            cache_dir,
+            cache_size,
+            cache_nfiles,
+            cachedir,
+            cachesize,
+            cachenfiles,
+        } = &args.cache;
+        let LimitsArgs {
+            maxpost,
+            memory_limit,
+            admission_mode,
+            tiles_memory_ratio,
+            large_decode_threshold_bytes,
+            thumbsize,
+        } = &args.limits;
+        let LoggingArgs {
+            logfile: _,
+            loglevel,
+            slow_request_ms,
+            log_rate_limit,
+        } = &args.logging;
+        let ConcurrencyArgs {
+            nthreads: _,
+            tiles_thread_ratio: _,
+            max_waiting: _,
+            queue_timeout: _,
+            preflight_cache_ttl: _,
+            preflight_cache_slots: _,
+        } = &args.concurrency_args;
+
+        ServerOverrides {
+            imgroot: imgroot.clone(),
+            scriptdir: scriptdir.clone(),
+            initscript: initscript.clone(),
+            tmpdir: tmpdir.clone(),
+            maxtmpage: *maxtmpage,
+            docroot: docroot.clone(),
+            wwwroute: wwwroute.clone(),
+            pathprefix: *pathprefix,
+            cache_dir: cache_dir.clone().or_else(|| cachedir.clone()),
+            cache_size: cache_size.clone().or_else(|| cachesize.clone()),
+            cache_nfiles: cache_nfiles.or(*cachenfiles),
+            memory_limit: memory_limit.clone(),
+            admission_mode: admission_mode.clone(),
+            tiles_memory_ratio: *tiles_memory_ratio,
+            large_decode_threshold_bytes: *large_decode_threshold_bytes,
+            maxpost: maxpost.clone(),
+            thumbsize: thumbsize.clone(),
+            loglevel: loglevel.clone(),
+            slow_request_ms: *slow_request_ms,
+            log_rate_limit: *log_rate_limit,
+            // No socket, auth or Knora in a replay; jpeg_quality and
+            // scaling_quality come from a TOML --config, as for `server`.
+            ..Default::default()
+        }
+    }
+}
+
+/// Parse the `replay` flags (argv from the "replay" token onward), replay the
+/// log and print the report. Exit 0 once the replay has run, whatever the
+/// statuses it saw; 1 if it could not start, 2 on a bad flag.
+pub fn run(replay_argv: &[String]) -> ExitCode {
+    let args = match ReplayArgs::try_parse_from(replay_argv) {
+        Ok(a) => a,
+        Err(e) => {
+            let _ = e.print();
+            return ExitCode::from(e.exit_code() as u8);
+        }
+    };
+
+    let overrides = ServerOverrides::from(&args);
+    let pace = match args.concurrency {
+        Some(n) => Pace::Closed {
+            concurrency: n as usize,
+        },
+        None => Pace::Open {
+            speed: args.speed.unwrap_or(1.0),
+        },
+    };
+    let options = ReplayOptions {
+        log: args.log,
+        pace,
+        window: Duration::from_secs(args.window),
+        limit: args.limit,
+        json: args.json,
+        nthreads: args.concurrency_args.nthreads,
+        tiles_thread_ratio: args.concurrency_args.tiles_thread_ratio,
+        max_waiting: args.concurrency_args.max_waiting,
+        queue_timeout: args.concurrency_args.queue_timeout,
+    };
+    sipi::replay::run(args.config, overrides, options)
+}
+
+#[cfg(test)]
+mod tests {
+    use super::ReplayArgs;
+    use clap::Parser;
+
+    #[test]
+    fn replay_flags_parse_into_the_shared_groups() {
+        let args = ReplayArgs::try_parse_from([
+            "replay",
+            "access.log",
+            "--concurrency",
+            "16",
+            "--imgroot",
+            "/img",
+            "--cache-size",
+            "2G",
+            "--tiles-memory-ratio",
+            "0.6",
+            "-t",
+            "8",
+        ])
+        .unwrap();
+        assert_eq!(args.log.to_str(), Some("access.log"));
+        assert_eq!(args.concurrency, Some(16));
+        assert_eq!(args.speed, None);
+        assert_eq!(args.window, 10);
+        assert_eq!(args.paths.imgroot.as_deref(), Some("/img"));
+        assert_eq!(args.cache.cache_size.as_deref(), Some("2G"));
+        assert_eq!(args.limits.tiles_memory_ratio, Some(0.6));
+        assert_eq!(args.concurrency_args.nthreads, Some(8));
+    }
+
+    #[test]
+    fn open_and_closed_loop_are_exclusive_and_speed_is_positive() {
+        assert!(ReplayArgs::try_parse_from([
+            "replay",
+            "a.log",
+            "--speed",
+            "2",
+            "--concurrency",
+            "4"
+        ])
+        .is_err());
+        assert!(ReplayArgs::try_parse_from(["replay", "a.log", "--speed", "0"]).is_err());
+        assert!(ReplayArgs::try_parse_from(["replay", "a.log", "--window", "0"]).is_err());
+        let args = ReplayArgs::try_parse_from(["replay", "a.log", "--speed", "0.5"]).unwrap();
+        assert_eq!(args.speed, Some(0.5));
+    }
+}
@@ -15,4 +15,10 @@ pub struct LoggingArgs {
     /// Logging level: DEBUG, INFO, WARNING, ERR, CRIT, ALERT, EMERG.
     #[arg(long, env = "SIPI_LOGLEVEL", value_name = "LEVEL")]
     pub loglevel: Option<String>,
+    /// Keep and log serves at least this many milliseconds slow (default 1000; 0 = off).
+    #[arg(long, env = "SIPI_SLOW_REQUEST_MS", value_name = "MS")]
+    pub slow_request_ms: Option<u32>,
+    /// Log lines written per second for each level below ERR (default 200; 0 = off).
+    #[arg(long, env = "SIPI_LOG_RATE_LIMIT", value_name = "LINES")]
+    pub log_rate_limit: Option<u32>,
 }
@@ -4,7 +4,8 @@
 //! flattened in so `--help` renders sectioned and a reader finds every flag by
 //! domain. Group structs are crate-internal — only `ServerArgs` is the public
 //! surface (the binary owns the CLI, the `sipi` library takes a
-//! Rust-native `ServerOverrides`).
+//! Rust-native `ServerOverrides`); `replay` flattens the engine-facing groups
+//! too, so a replay is configured with the same flags as the server it models.
 //!
 //! The full ~40-flag server surface parses here (so e.g. `server --imgroot X`
 //! no longer exits 2), with each overridable flag an `Option<T>` carrying its
@@ -9,7 +9,7 @@
 //! channel into the engine (the `repr(C)` struct + the `sipi_init` apply block)
 //! lives in `server-rs/config.rs`.
 
-mod args;
+pub(crate) mod args;
 
 use args::{
     CacheArgs, ConcurrencyArgs, KnoraArgs, LimitsArgs, LoggingArgs, NetworkArgs, PathArgs,
@@ -94,6 +94,8 @@ impl From<&ServerArgs> for ServerOverrides {
         let LoggingArgs {
             logfile: _,
             loglevel,
+            slow_request_ms,
+            log_rate_limit,
         } = logging;
         let ConcurrencyArgs {
             nthreads: _,
@@ -120,6 +122,10 @@ impl From<&ServerArgs> for ServerOverrides {
             cache_dir: cache_dir.clone().or_else(|| cachedir.clone()),
             cache_size: cache_size.clone().or_else(|| cachesize.clone()),
             cache_nfiles: cache_nfiles.or(*cachenfiles),
+            // The shadow-pyramid knobs are TOML/Lua-config-only (no CLI flag).
+            shadow_dir: None,
+            shadow_max_size: None,
+            shadow_hot_threshold: None,
             memory_limit: memory_limit.clone(),
             admission_mode: admission_mode.clone(),
             tiles_memory_ratio: *tiles_memory_ratio,
@@ -129,10 +135,15 @@ impl From<&ServerArgs> for ServerOverrides {
             knorapath: knorapath.clone(),
             knoraport: knoraport.clone(),
             loglevel: loglevel.clone(),
-            // jpeg_quality + scaling_quality are TOML-config-only (no CLI flag),
-            // so the clap path never sets them.
+            slow_request_ms: *slow_request_ms,
+            log_rate_limit: *log_rate_limit,
+            // jpeg_quality, scaling_quality, j2k_layer_truncation_size and
+            // j2k_gray_decode are TOML-config-only (no CLI flag), so the clap
+            // path never sets them.
             jpeg_quality: None,
             scaling_quality: Default::default(),
+            j2k_layer_truncation_size: None,
+            j2k_gray_decode: None,
             // Lua-config-only (the CLI --hostname/--sslport transport flags are
             // deliberately not forwarded; these fields feed the Lua `config`
             // table and are set by the Lua config parse alone).
@@ -2,6 +2,7 @@
 //!
 //! `cli-rs` owns `main` and the verb dispatch; all server behaviour lives in the
 //! `sipi` library (`//src/server-rs`). The `server` verb runs the axum shell;
+//! `replay` drives the same router and engine in-process from an access log;
 //! `health` is a Rust-native loopback probe (no FFI); every other argv (offline
 //! subcommands, `--version`, `--help`) is handed to the C++ CLI (`sipi_cli_main`)
 //! verbatim. A downstream crate can replace this binary with its own `main`
@@ -91,6 +92,8 @@ fn main() -> ExitCode {
         // `server` → the Rust shell. Pass the slice from the verb onward; clap
         // treats argv[idx] ("server"/"health") as the binary name and skips it.
         Some(idx) if argv[idx] == "server" => commands::server::run(&argv[idx..]),
+        // `replay` → an access log replayed through the engine, offline.
+        Some(idx) if argv[idx] == "replay" => commands::replay::run(&argv[idx..]),
         // `health` → the Rust-native loopback probe (no FFI, no engine).
         Some(idx) if argv[idx] == "health" => commands::health::run(&argv[idx..]),
         // Everything else → the C++ CLI, verbatim.
@@ -134,13 +137,17 @@ mod allocator {
             malloc_huge_current: *mut i64,
             rss_current: *mut i64,
         ) -> bool;
+        // Process-wide committed bytes (same shim).
+        fn sipi_mi_heap_in_use() -> i64;
     }
 
-    /// Verify interposition (abort on failure) and register the mimalloc
-    /// stats reader with the library's allocator gauges.
+    /// Verify interposition (abort on failure), register the mimalloc stats
+    /// reader with the library's allocator gauges and its live-heap reader
+    /// with the engine's peak-memory calibration.
     pub(super) fn init() {
         verify_interposition();
         sipi::malloc_stats::set_source(stats);
+        sipi::malloc_stats::set_heap_reader(sipi_mi_heap_in_use);
     }
 
     /// Verify that the statically linked mimalloc interposes *libc-internal*
@@ -195,6 +195,7 @@ extern "C" int sipi_cli_main(int argc, char **argv)
   std::string j2k_Cblk;
   bool j2k_Cuse_sop = false;
   bool tiff_Pyramid = false;
+  std::string tiff_Compression;
 
 
   //
@@ -412,6 +413,13 @@ extern "C" int sipi_cli_main(int argc, char **argv)
     if (user_set("--Cuse_sop")) comp_params[Sipi::J2K_Cuse_sop] = j2k_Cuse_sop ? "yes" : "no";
     if (user_set("--Stiles")) comp_params[Sipi::J2K_Stiles] = j2k_Stiles;
     if (user_set("--Ctiff_pyramid")) comp_params[Sipi::TIFF_Pyramid] = tiff_Pyramid ? "yes" : "no";
+    if (user_set("--Ctiff_compression")) {
+      if (tiff_Compression == "lzw") {
+        comp_params[Sipi::TIFF_Compression] = "COMPRESSION_LZW";
+      } else if (tiff_Compression == "deflate") {
+        comp_params[Sipi::TIFF_Compression] = "COMPRESSION_DEFLATE";
+      }
+    }
 
     if (user_set("--rates")) {
       std::stringstream ss;
@@ -578,6 +586,9 @@ extern "C" int sipi_cli_main(int argc, char **argv)
       "J2K Cuse_sop: Include SOP markers (resync markers) [Default: yes].");
     cmd->add_option("--Ctiff_pyramid", tiff_Pyramid,
       "TIFF: store in Pyramidal TIFF format [Default: no].");
+    cmd->add_option("--Ctiff_compression", tiff_Compression,
+      "TIFF: tile compression of a Pyramidal TIFF: none, lzw, deflate [Default: none].")
+      ->check(CLI::IsMember({ "none", "lzw", "deflate" }));
   };
 
 
@@ -0,0 +1,36 @@
+/*
+ * Copyright © 2016 - 2026 Swiss National Data and Service Center for the Humanities and/or DaSCH Service Platform
+ * contributors. SPDX-License-Identifier: AGPL-3.0-or-later
+ */
+
+#include "decode_cancel.h"
+
+#include "SipiImageError.h"
+#include "throttling/SipiPeakCalibration.h"
+
+namespace Sipi {
+namespace {
+
+  thread_local const std::function<bool()> *g_cancelled = nullptr;
+
+}// namespace
+
+DecodeCancelScope::DecodeCancelScope(const std::function<bool()> &cancelled) noexcept : previous_(g_cancelled)
+{
+  g_cancelled = &cancelled;
+}
+
+DecodeCancelScope::~DecodeCancelScope() { g_cancelled = previous_; }
+
+bool decode_cancelled()
+{
+  // The checkpoints are where the codecs' working buffers are live, so they
+  // double as the heap samples of a measured decode (SipiPeakCalibration.h);
+  // without one open this is a thread-local test.
+  HeapPeakScope::sample();
+  return g_cancelled != nullptr && *g_cancelled && (*g_cancelled)();
+}
+
+void throw_decode_cancelled() { throw SipiImageClientAbortError("decode cancelled: the client is gone"); }
+
+}// namespace Sipi
@@ -0,0 +1,86 @@
+/*
+ * Copyright © 2016 - 2026 Swiss National Data and Service Center for the Humanities and/or DaSCH Service Platform
+ * contributors. SPDX-License-Identifier: AGPL-3.0-or-later
+ */
+
+/*!
+ * Cooperative cancellation of a decode.
+ *
+ * The serve path checks for a gone client only between its stages, so without
+ * help a disconnect during a multi-second JPEG2000 decode or a long TIFF tile
+ * loop still pays for the whole decode and keeps its memory reservation. The
+ * caller installs its disconnect poll on the decoding thread with a
+ * `DecodeCancelScope`; the codecs and the resampler call `check_decode_cancelled`
+ * at their checkpoints — between Kakadu stripes, TIFF tiles and strips, JPEG
+ * scanline batches and resample row bands — which throws
+ * `SipiImageClientAbortError` once the poll reports the client gone. Outside a
+ * scope (the CLI, tests, background builds) every checkpoint is a no-op. During
+ * a calibration measurement each checkpoint also samples the heap
+ * (`HeapPeakScope`).
+ */
+#ifndef SIPI_DECODE_CANCEL_H
+#define SIPI_DECODE_CANCEL_H
+
+#include <atomic>
+#include <cstddef>
+#include <functional>
+
+namespace Sipi {
+
+//! Rows between two checkpoints in the row-at-a-time loops (JPEG scanlines,
+//! resample passes, Kakadu stripes): coarse enough that the poll is noise next
+//! to the decode, fine enough that an abort lands within milliseconds.
+inline constexpr std::size_t kDecodeCancelRows = 64;
+
+/*! Installs `cancelled` as the calling thread's decode-cancellation poll for the
+ *  scope's lifetime; scopes nest, restoring the outer poll on exit. */
+class DecodeCancelScope
+{
+public:
+  explicit DecodeCancelScope(const std::function<bool()> &cancelled) noexcept;
+  ~DecodeCancelScope();
+
+  DecodeCancelScope(const DecodeCancelScope &) = delete;
+  DecodeCancelScope &operator=(const DecodeCancelScope &) = delete;
+
+private:
+  const std::function<bool()> *previous_;
+};
+
+/*! Whether the calling thread's decode has been cancelled; false outside a scope. */
+[[nodiscard]] bool decode_cancelled();
+
+/*! Throws the `SipiImageClientAbortError` a cancelled decode ends with. */
+[[noreturn]] void throw_decode_cancelled();
+
+/*! Throws `SipiImageClientAbortError` if the calling thread's decode has been cancelled. */
+inline void check_decode_cancelled()
+{
+  if (decode_cancelled()) { throw_decode_cancelled(); }
+}
+
+/*!
+ * Carries a cancellation to the worker threads of a parallel decode. Only the
+ * thread that owns the scope may poll the client, so it calls `poll()` at its
+ * checkpoints and the workers test `stopped()` at theirs; once the decode has
+ * joined them, the owner throws if `stopped()`.
+ */
+class DecodeCancelFanout
+{
+public:
+  //! Polls the calling thread's scope; true once the decode is cancelled.
+  bool poll()
+  {
+    if (!stopped() && decode_cancelled()) { stopped_.store(true, std::memory_order_relaxed); }
+    return stopped();
+  }
+
+  [[nodiscard]] bool stopped() const noexcept { return stopped_.load(std::memory_order_relaxed); }
+
+private:
+  std::atomic<bool> stopped_{ false };
+};
+
+}// namespace Sipi
+
+#endif// SIPI_DECODE_CANCEL_H
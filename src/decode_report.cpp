@@ -0,0 +1,33 @@
+/*
+ * Copyright © 2016 - 2026 Swiss National Data and Service Center for the Humanities and/or DaSCH Service Platform
+ * contributors. SPDX-License-Identifier: AGPL-3.0-or-later
+ */
+
+#include "decode_report.h"
+
+#include <algorithm>
+
+namespace Sipi {
+namespace {
+
+  thread_local DecodeReportScope *g_report = nullptr;
+
+}// namespace
+
+DecodeReportScope::DecodeReportScope() noexcept : previous_(g_report) { g_report = this; }
+
+DecodeReportScope::~DecodeReportScope() { g_report = previous_; }
+
+void report_decoded(std::uint64_t pixels, DecodePath path)
+{
+  if (g_report == nullptr) { return; }
+  g_report->pixels_ += pixels;
+  g_report->path_ = std::max(g_report->path_, path);
+}
+
+void report_decode_bytes(std::uint64_t bytes)
+{
+  if (g_report != nullptr) { g_report->bytes_ += bytes; }
+}
+
+}// namespace Sipi
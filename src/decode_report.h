@@ -0,0 +1,69 @@
+/*
+ * Copyright © 2016 - 2026 Swiss National Data and Service Center for the Humanities and/or DaSCH Service Platform
+ * contributors. SPDX-License-Identifier: AGPL-3.0-or-later
+ */
+
+/*!
+ * What a decode actually decoded.
+ *
+ * The serve path knows the rendering it asked for, but only the codec knows how
+ * it got there: which resolution level or DCT scale it decoded at, and so how
+ * many pixels it produced for the output it was asked for. The caller installs a
+ * `DecodeReportScope` on the decoding thread; the codecs call `report_decoded`
+ * once they know their decode size and `report_decode_bytes` for compressed
+ * data they fetch, and the scope accumulates both. Outside a scope (the CLI,
+ * tests, background builds) every report is a no-op, like the checkpoints in
+ * decode_cancel.h.
+ */
+#ifndef SIPI_DECODE_REPORT_H
+#define SIPI_DECODE_REPORT_H
+
+#include <cstdint>
+
+namespace Sipi {
+
+//! How a decode reached its resolution, cheapest last: at full resolution, in
+//! the DCT domain at 1/2, 1/4 or 1/8 (JPEG), or from a reduced resolution level
+//! (a TIFF pyramid directory or JPEG2000 wavelet levels).
+enum class DecodePath : std::uint8_t { Full = 0, DctScaled = 1, Pyramid = 2 };
+
+/*! Collects the calling thread's decode reports for the scope's lifetime;
+ *  scopes nest, restoring the outer one on exit. */
+class DecodeReportScope
+{
+public:
+  DecodeReportScope() noexcept;
+  ~DecodeReportScope();
+
+  DecodeReportScope(const DecodeReportScope &) = delete;
+  DecodeReportScope &operator=(const DecodeReportScope &) = delete;
+
+  //! Pixels decoded (per channel-interleaved pixel, not samples).
+  [[nodiscard]] std::uint64_t pixels() const { return pixels_; }
+
+  //! Compressed bytes the codecs reported fetching; 0 when none reports them.
+  [[nodiscard]] std::uint64_t bytes() const { return bytes_; }
+
+  //! The cheapest path any report took (`Full` when nothing was reported).
+  [[nodiscard]] DecodePath path() const { return path_; }
+
+private:
+  friend void report_decoded(std::uint64_t pixels, DecodePath path);
+  friend void report_decode_bytes(std::uint64_t bytes);
+
+  DecodeReportScope *previous_;
+  std::uint64_t pixels_{ 0 };
+  std::uint64_t bytes_{ 0 };
+  DecodePath path_{ DecodePath::Full };
+};
+
+/*! Adds `pixels` decoded along `path` to the calling thread's scope, if any. A
+ *  reader that counts its pixels in a helper may report the path alone, with 0. */
+void report_decoded(std::uint64_t pixels, DecodePath path);
+
+/*! Adds `bytes` of compressed data fetched to the calling thread's scope, if any. */
+void report_decode_bytes(std::uint64_t bytes);
+
+}// namespace Sipi
+
+#endif// SIPI_DECODE_REPORT_H
@@ -0,0 +1,65 @@
+/*
+ * Copyright © 2016 - 2026 Swiss National Data and Service Center for the Humanities and/or DaSCH Service Platform
+ * contributors. SPDX-License-Identifier: AGPL-3.0-or-later
+ */
+
+#include "ffi/decode_amplification.h"
+
+#include <algorithm>
+
+namespace Sipi::ffi {
+
+DecodeAmplification::DecodeAmplification(std::size_t capacity) : capacity_(std::max<std::size_t>(capacity, 1))
+{
+  entries_.reserve(capacity_);
+  index_.reserve(capacity_);
+}
+
+void DecodeAmplification::record(const std::string &path, std::uint64_t decoded_pixels, std::uint64_t output_pixels)
+{
+  if (decoded_pixels == 0) { return; }
+  const double amplification =
+    static_cast<double>(decoded_pixels) / static_cast<double>(std::max<std::uint64_t>(output_pixels, 1));
+
+  const std::lock_guard lock(mutex_);
+  auto it = index_.find(path);
+  if (it == index_.end()) {
+    if (entries_.size() < capacity_) {
+      it = index_.emplace(path, entries_.size()).first;
+      entries_.push_back(DecodeOffender{ .path = path });
+    } else {
+      // Evict the lowest-ranked source; the newcomer inherits its score.
+      const auto victim = std::min_element(entries_.begin(), entries_.end(), [](const auto &a, const auto &b) {
+        return a.amplification < b.amplification;
+      });
+      const auto slot = static_cast<std::size_t>(victim - entries_.begin());
+      index_.erase(victim->path);
+      *victim = DecodeOffender{ .path = path, .amplification = victim->amplification, .error = victim->amplification };
+      it = index_.emplace(path, slot).first;
+    }
+  }
+  DecodeOffender &entry = entries_[it->second];
+  ++entry.requests;
+  entry.decoded_pixels += decoded_pixels;
+  entry.output_pixels += output_pixels;
+  entry.amplification += amplification;
+}
+
+std::vector<DecodeOffender> DecodeAmplification::top(std::size_t n) const
+{
+  std::vector<DecodeOffender> out;
+  {
+    const std::lock_guard lock(mutex_);
+    out = entries_;
+  }
+  const auto by_amplification = [](const auto &a, const auto &b) { return a.amplification > b.amplification; };
+  if (out.size() > n) {
+    std::partial_sort(out.begin(), out.begin() + static_cast<std::ptrdiff_t>(n), out.end(), by_amplification);
+    out.resize(n);
+  } else {
+    std::sort(out.begin(), out.end(), by_amplification);
+  }
+  return out;
+}
+
+}// namespace Sipi::ffi
@@ -0,0 +1,70 @@
+/*
+ * Copyright © 2016 - 2026 Swiss National Data and Service Center for the Humanities and/or DaSCH Service Platform
+ * contributors. SPDX-License-Identifier: AGPL-3.0-or-later
+ */
+
+/*!
+ * The source files that cost the most decode work per pixel served.
+ *
+ * Each decode's amplification is the pixels its codec decoded (decode_report.h)
+ * over the pixels it rendered: near 1 for a tile read from a well-tiled pyramid,
+ * in the hundreds for a thumbnail of a flat 100-megapixel JPEG. Summed per
+ * source, it ranks the files that most need a pyramid or re-tiling — a file
+ * rendered often at a small fraction of its size ranks high, one decoded once
+ * ranks low however large it is.
+ *
+ * The table is bounded: it tracks `capacity` sources with the Space-Saving
+ * scheme. A source not in a full table takes the place of the lowest-ranked one
+ * and inherits its score as `error`, so any source whose true sum exceeds the
+ * lowest tracked score is in the table, and its reported sum overstates the
+ * true one by at most `error`.
+ */
+#ifndef SIPI_FFI_DECODE_AMPLIFICATION_H
+#define SIPI_FFI_DECODE_AMPLIFICATION_H
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace Sipi::ffi {
+
+/*! One tracked source. */
+struct DecodeOffender
+{
+  std::string path;
+  std::uint64_t requests{ 0 };//!< decodes recorded since it entered the table
+  std::uint64_t decoded_pixels{ 0 };
+  std::uint64_t output_pixels{ 0 };
+  double amplification{ 0.0 };//!< summed decoded / output pixels, `error` included
+  double error{ 0.0 };//!< the score inherited on entry
+};
+
+/*! Bounded top-N of sources by summed decode amplification. Thread-safe; one
+ *  short lock per recorded decode. */
+class DecodeAmplification
+{
+public:
+  static constexpr std::size_t kDefaultCapacity = 64;
+
+  explicit DecodeAmplification(std::size_t capacity = kDefaultCapacity);
+
+  /*! Records a decode of `path` that decoded `decoded_pixels` to render
+   *  `output_pixels`. A decode that decoded nothing is ignored. */
+  void record(const std::string &path, std::uint64_t decoded_pixels, std::uint64_t output_pixels);
+
+  /*! Up to `n` tracked sources, highest amplification first. */
+  [[nodiscard]] std::vector<DecodeOffender> top(std::size_t n) const;
+
+private:
+  std::size_t capacity_;
+  mutable std::mutex mutex_;
+  std::vector<DecodeOffender> entries_;
+  std::unordered_map<std::string, std::size_t> index_;//!< path → position in entries_
+};
+
+}// namespace Sipi::ffi
+
+#endif// SIPI_FFI_DECODE_AMPLIFICATION_H
@@ -0,0 +1,76 @@
+/*
+ * Copyright © 2016 - 2026 Swiss National Data and Service Center for the Humanities and/or DaSCH Service Platform
+ * contributors. SPDX-License-Identifier: AGPL-3.0-or-later
+ */
+
+// Co-located unit tests for the decode-amplification table: per-source sums,
+// the ranking, and the Space-Saving eviction that keeps it bounded.
+
+#include "gtest/gtest.h"
+
+#include <string>
+
+#include "ffi/decode_amplification.h"
+
+namespace {
+
+using Sipi::ffi::DecodeAmplification;
+
+TEST(DecodeAmplification, SumsEachSourcesDecodes)
+{
+  DecodeAmplification table;
+  table.record("/img/flat.jpg", 10000, 100);
+  table.record("/img/flat.jpg", 10000, 1000);
+  const auto top = table.top(10);
+  ASSERT_EQ(top.size(), 1U);
+  EXPECT_EQ(top[0].path, "/img/flat.jpg");
+  EXPECT_EQ(top[0].requests, 2U);
+  EXPECT_EQ(top[0].decoded_pixels, 20000U);
+  EXPECT_EQ(top[0].output_pixels, 1100U);
+  EXPECT_DOUBLE_EQ(top[0].amplification, 110.0);
+  EXPECT_DOUBLE_EQ(top[0].error, 0.0);
+}
+
+TEST(DecodeAmplification, RanksByAmplificationNotSize)
+{
+  DecodeAmplification table;
+  table.record("/img/huge_once.tif", 100'000'000, 100'000'000);
+  for (int i = 0; i < 5; ++i) { table.record("/img/thumbs.jpg", 4'000'000, 40'000); }
+  table.record("/img/tile.jp2", 65536, 65536);
+  const auto top = table.top(2);
+  ASSERT_EQ(top.size(), 2U);
+  EXPECT_EQ(top[0].path, "/img/thumbs.jpg");
+  EXPECT_DOUBLE_EQ(top[0].amplification, 500.0);
+  EXPECT_DOUBLE_EQ(top[1].amplification, 1.0);
+}
+
+TEST(DecodeAmplification, DecodesWithoutPixelsAreIgnored)
+{
+  DecodeAmplification table;
+  table.record("/img/none.tif", 0, 100);
+  EXPECT_TRUE(table.top(10).empty());
+}
+
+TEST(DecodeAmplification, FullTableEvictsTheLowestAndTheNewcomerInheritsItsScore)
+{
+  DecodeAmplification table(2);
+  table.record("/img/a.jpg", 800, 100);// 8
+  table.record("/img/b.jpg", 300, 100);// 3
+  table.record("/img/c.jpg", 200, 100);// 2, evicts b
+  const auto top = table.top(10);
+  ASSERT_EQ(top.size(), 2U);
+  EXPECT_EQ(top[0].path, "/img/a.jpg");
+  EXPECT_EQ(top[1].path, "/img/c.jpg");
+  EXPECT_DOUBLE_EQ(top[1].amplification, 5.0);
+  EXPECT_DOUBLE_EQ(top[1].error, 3.0);
+  EXPECT_EQ(top[1].requests, 1U);
+
+  // The evicted source comes back in place of the lowest again.
+  table.record("/img/b.jpg", 100, 100);
+  const auto again = table.top(10);
+  EXPECT_EQ(again[0].path, "/img/a.jpg");
+  EXPECT_EQ(again[1].path, "/img/b.jpg");
+  EXPECT_DOUBLE_EQ(again[1].amplification, 6.0);
+}
+
+}// namespace
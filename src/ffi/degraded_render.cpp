@@ -0,0 +1,137 @@
+/*
+ * Copyright © 2016 - 2026 Swiss National Data and Service Center for the Humanities and/or DaSCH Service Platform
+ * contributors. SPDX-License-Identifier: AGPL-3.0-or-later
+ */
+
+#include "ffi/degraded_render.h"
+
+#include <algorithm>
+#include <array>
+
+#include "SipiError.h"
+#include "throttling/SipiPeakMemory.h"
+
+namespace Sipi::ffi {
+namespace {
+
+  // Weight of a new sample in the running decode rate (1/8).
+  constexpr double kRateWeight = 0.125;
+
+  // The configured resampler of the format that is decoded.
+  ScalingMethod method_for(const ScalingQuality &sq, SipiQualityFormat::FormatType decode_format)
+  {
+    switch (decode_format) {
+    case SipiQualityFormat::JP2:
+      return sq.jk2;
+    case SipiQualityFormat::JPG:
+      return sq.jpeg;
+    case SipiQualityFormat::PNG:
+      return sq.png;
+    default:
+      return sq.tiff;
+    }
+  }
+
+  struct StepName
+  {
+    unsigned step;
+    const char *name;
+  };
+  constexpr std::array<StepName, 4> kStepNames = { {
+    { kDegradeLevel, "level" },
+    { kDegradeFastScaling, "fast-scaling" },
+    { kDegradeJ2kLayers, "layers" },
+    { kDegradeJpegQuality, "jpeg-quality" },
+  } };
+
+}// namespace
+
+DegradedRendering plan_degraded(const DegradeInput &in)
+{
+  DegradedRendering out;
+  out.decode_size = in.size;
+  out.out_w = in.ddims.out_w;
+  out.out_h = in.ddims.out_h;
+  out.scaling_quality = in.scaling_quality;
+  out.jpeg_quality = in.jpeg_quality;
+  out.estimated = in.estimated;
+
+  // Half the output is decoded from the next coarser level (or DCT scale) and
+  // upscaled back, a quarter of the decode's pixels. The half Size is internal,
+  // derived from an output the request's own Size already admitted, so it may
+  // exceed the Region (an upscaled request) without a SipiSizeError.
+  if (in.decode_format != SipiQualityFormat::PNG && out.out_w >= 2 && out.out_h >= 2) {
+    auto half = std::make_shared<SipiSize>(SipiSize::PIXELS_XY, true, 0.F, 0, out.out_w / 2, out.out_h / 2);
+    try {
+      const DecodeDims hd = compute_decode_dims(in.img_w, in.img_h, in.clevels, in.region, half);
+      const std::size_t estimated =
+        estimate_peak_memory(hd.width, hd.height, out.out_w, out.out_h, in.nc, in.bps, in.angle, in.needs_icc);
+      if (estimated < in.estimated) {
+        out.decode_size = std::move(half);
+        out.estimated = estimated;
+        out.steps |= kDegradeLevel;
+      }
+    } catch (const SipiError &) {
+      // keep the request's own Size
+    }
+  }
+
+  // The resampler only runs when the decode is scaled away from the Region's
+  // size; a same-size decode has nothing for scaleFast to speed up.
+  const std::size_t region_w = in.ddims.region_w != 0 ? in.ddims.region_w : in.img_w;
+  const std::size_t region_h = in.ddims.region_h != 0 ? in.ddims.region_h : in.img_h;
+  const bool halved = (out.steps & kDegradeLevel) != 0;
+  const std::size_t decode_w = halved ? out.out_w / 2 : out.out_w;
+  const std::size_t decode_h = halved ? out.out_h / 2 : out.out_h;
+  if ((decode_w != region_w || decode_h != region_h)
+      && method_for(out.scaling_quality, in.decode_format) != ScalingMethod::LOW) {
+    out.scaling_quality.jk2 = ScalingMethod::LOW;
+    out.scaling_quality.jpeg = ScalingMethod::LOW;
+    out.scaling_quality.tiff = ScalingMethod::LOW;
+    out.scaling_quality.png = ScalingMethod::LOW;
+    out.steps |= kDegradeFastScaling;
+  }
+
+  if (in.decode_format == SipiQualityFormat::JP2
+      && (out.scaling_quality.j2k_layer_percent == 0 || out.scaling_quality.j2k_layer_percent > kDegradedJ2kLayerPercent)) {
+    out.scaling_quality.j2k_layer_percent = kDegradedJ2kLayerPercent;
+    out.steps |= kDegradeJ2kLayers;
+  }
+
+  if (in.out_format == SipiQualityFormat::JPG && out.jpeg_quality > kDegradedJpegQuality) {
+    out.jpeg_quality = kDegradedJpegQuality;
+    out.steps |= kDegradeJpegQuality;
+  }
+  return out;
+}
+
+std::string degraded_header_value(unsigned steps)
+{
+  std::string value;
+  for (const auto &[step, name] : kStepNames) {
+    if ((steps & step) == 0) { continue; }
+    if (!value.empty()) { value += ", "; }
+    value += name;
+  }
+  return value;
+}
+
+void DecodeRate::record(std::size_t estimated_bytes, std::chrono::nanoseconds took)
+{
+  if (estimated_bytes == 0) { return; }
+  const double sample = static_cast<double>(took.count()) / static_cast<double>(estimated_bytes);
+  double current = ns_per_byte_.load(std::memory_order_relaxed);
+  double next = 0.0;
+  do {
+    next = current == 0.0 ? sample : current + kRateWeight * (sample - current);
+  } while (!ns_per_byte_.compare_exchange_weak(current, next, std::memory_order_relaxed));
+}
+
+std::optional<std::chrono::nanoseconds> DecodeRate::predict(std::size_t estimated_bytes) const
+{
+  const double rate = ns_per_byte_.load(std::memory_order_relaxed);
+  if (rate == 0.0) { return std::nullopt; }
+  return std::chrono::nanoseconds(static_cast<std::chrono::nanoseconds::rep>(rate * static_cast<double>(estimated_bytes)));
+}
+
+}// namespace Sipi::ffi
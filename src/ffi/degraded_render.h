@@ -0,0 +1,110 @@
+/*
+ * Copyright © 2016 - 2026 Swiss National Data and Service Center for the Humanities and/or DaSCH Service Platform
+ * contributors. SPDX-License-Identifier: AGPL-3.0-or-later
+ */
+
+/*!
+ * Degraded rendering for IIIF requests that carry a deadline.
+ *
+ * A request may pass `deadline_ms` over the seam. When `execute_plan` predicts
+ * that the exact rendering misses it — the engine's running decode rate says
+ * the decode takes longer than what is left, or the full-lane budget has no
+ * room for it — it renders a cheaper variant instead of queueing or answering
+ * 503. The variant keeps the requested region, size, rotation, quality and
+ * format, so it is still a conformant IIIF response; only its pixels are
+ * coarser. It carries an `X-Sipi-Degraded` header naming the steps taken,
+ * `Cache-Control: no-store`, and is never written to the cache.
+ */
+#ifndef SIPI_FFI_DEGRADED_RENDER_H
+#define SIPI_FFI_DEGRADED_RENDER_H
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+
+#include "SipiIO.h"// ScalingQuality
+#include "iiifparser/SipiDecodeDims.h"
+#include "iiifparser/SipiQualityFormat.h"
+#include "iiifparser/SipiRegion.h"
+#include "iiifparser/SipiSize.h"
+
+namespace Sipi::ffi {
+
+// The cheaper-rendering steps, as bits of `DegradedRendering::steps`.
+constexpr unsigned kDegradeLevel = 1U << 0;//!< decode at half the output size (a coarser resolution level), then upscale
+constexpr unsigned kDegradeFastScaling = 1U << 1;//!< nearest-neighbour scaling (scaleFast) instead of the configured resampler
+constexpr unsigned kDegradeJ2kLayers = 1U << 2;//!< decode only part of a JPEG2000 codestream's quality layers
+constexpr unsigned kDegradeJpegQuality = 1U << 3;//!< encode JPEG output at kDegradedJpegQuality
+
+constexpr int kDegradedJpegQuality = 40;
+constexpr std::uint8_t kDegradedJ2kLayerPercent = 50;
+
+/*! A planned decode, as `plan_degraded` needs it. */
+struct DegradeInput
+{
+  std::size_t img_w{ 0 };
+  std::size_t img_h{ 0 };
+  int clevels{ 0 };//!< resolution levels of the file actually decoded
+  int nc{ 0 };
+  int bps{ 0 };
+  std::shared_ptr<SipiRegion> region;
+  std::shared_ptr<SipiSize> size;
+  DecodeDims ddims;//!< the exact rendering's decode
+  std::size_t estimated{ 0 };//!< the exact rendering's peak decode memory
+  double angle{ 0.0 };
+  bool needs_icc{ false };
+  SipiQualityFormat::FormatType decode_format{ SipiQualityFormat::UNSUPPORTED };
+  SipiQualityFormat::FormatType out_format{ SipiQualityFormat::UNSUPPORTED };
+  ScalingQuality scaling_quality{};//!< the exact rendering's, with its JPEG2000 layer share set
+  int jpeg_quality{ 0 };
+};
+
+/*! The cheaper rendering of a request. */
+struct DegradedRendering
+{
+  unsigned steps{ 0 };//!< kDegrade* bits; 0 when nothing cheaper is possible
+  std::shared_ptr<SipiSize> decode_size;//!< the Size decoded at: the request's own unless kDegradeLevel
+  std::size_t out_w{ 0 };//!< the requested output size, upscaled to after a kDegradeLevel decode
+  std::size_t out_h{ 0 };
+  ScalingQuality scaling_quality{};
+  int jpeg_quality{ 0 };
+  std::size_t estimated{ 0 };//!< peak decode memory of the degraded rendering
+};
+
+/*! The cheapest conformant rendering of the planned decode `in`. A PNG decode
+ *  has no coarser level to read, so it never gets kDegradeLevel; the level step
+ *  is also dropped when it would not lower the memory estimate, and
+ *  kDegradeFastScaling only when the decode scales the Region at all. */
+[[nodiscard]] DegradedRendering plan_degraded(const DegradeInput &in);
+
+/*! The `X-Sipi-Degraded` header value for `steps`, e.g. "level, fast-scaling". */
+[[nodiscard]] std::string degraded_header_value(unsigned steps);
+
+/*!
+ * How long decodes take per byte of their peak-memory estimate: an
+ * exponentially weighted mean over the decodes served so far (each new sample
+ * weighs 1/8). The estimate tracks the decode's pixel work closely enough to
+ * predict whether a request meets its deadline. Lock-free; shared by every
+ * serve thread.
+ */
+class DecodeRate
+{
+public:
+  /*! Records a decode of `estimated_bytes` that took `took`. A zero estimate is ignored. */
+  void record(std::size_t estimated_bytes, std::chrono::nanoseconds took);
+
+  /*! The predicted duration of a decode of `estimated_bytes`, or nullopt
+   *  before the first recorded decode. */
+  [[nodiscard]] std::optional<std::chrono::nanoseconds> predict(std::size_t estimated_bytes) const;
+
+private:
+  std::atomic<double> ns_per_byte_{ 0.0 };
+};
+
+}// namespace Sipi::ffi
+
+#endif// SIPI_FFI_DEGRADED_RENDER_H
@@ -0,0 +1,123 @@
+/*
+ * Copyright © 2016 - 2026 Swiss National Data and Service Center for the Humanities and/or DaSCH Service Platform
+ * contributors. SPDX-License-Identifier: AGPL-3.0-or-later
+ */
+
+// Co-located unit tests for degraded rendering: which cheaper steps
+// plan_degraded takes for a given source and output format, that the result
+// keeps the requested output size, the X-Sipi-Degraded header value, and the
+// running DecodeRate that predicts a deadline miss.
+
+#include "gtest/gtest.h"
+
+#include <chrono>
+#include <cstddef>
+#include <memory>
+#include <string>
+
+#include "ffi/degraded_render.h"
+#include "throttling/SipiPeakMemory.h"
+
+namespace {
+
+using namespace Sipi::ffi;
+using Sipi::SipiQualityFormat;
+
+// A full-region request of a 4000 x 3000 RGB source scaled to `size`.
+DegradeInput request(SipiQualityFormat::FormatType decode_format,
+  SipiQualityFormat::FormatType out_format,
+  const std::string &size,
+  int clevels = 5)
+{
+  DegradeInput in;
+  in.img_w = 4000;
+  in.img_h = 3000;
+  in.clevels = clevels;
+  in.nc = 3;
+  in.bps = 8;
+  in.region = std::make_shared<Sipi::SipiRegion>();
+  in.size = std::make_shared<Sipi::SipiSize>(size);
+  in.ddims = Sipi::compute_decode_dims(in.img_w, in.img_h, in.clevels, in.region, in.size);
+  in.estimated = Sipi::estimate_peak_memory(
+    in.ddims.width, in.ddims.height, in.ddims.out_w, in.ddims.out_h, in.nc, in.bps, 0.0, false);
+  in.decode_format = decode_format;
+  in.out_format = out_format;
+  in.scaling_quality = { Sipi::ScalingMethod::HIGH, Sipi::ScalingMethod::HIGH, Sipi::ScalingMethod::HIGH,
+    Sipi::ScalingMethod::HIGH };
+  in.jpeg_quality = 80;
+  return in;
+}
+
+TEST(PlanDegraded, Jpeg2000ToJpegTakesEveryStep)
+{
+  const auto in = request(SipiQualityFormat::JP2, SipiQualityFormat::JPG, "1500,");
+  const auto d = plan_degraded(in);
+  EXPECT_EQ(d.steps, kDegradeLevel | kDegradeFastScaling | kDegradeJ2kLayers | kDegradeJpegQuality);
+  EXPECT_LT(d.estimated, in.estimated);
+  EXPECT_EQ(d.out_w, in.ddims.out_w);
+  EXPECT_EQ(d.out_h, in.ddims.out_h);
+  EXPECT_NE(d.decode_size, in.size);
+  EXPECT_EQ(d.scaling_quality.jk2, Sipi::ScalingMethod::LOW);
+  EXPECT_EQ(d.scaling_quality.j2k_layer_percent, kDegradedJ2kLayerPercent);
+  EXPECT_EQ(d.jpeg_quality, kDegradedJpegQuality);
+}
+
+TEST(PlanDegraded, PngDecodeHasNoCoarserLevel)
+{
+  const auto in = request(SipiQualityFormat::PNG, SipiQualityFormat::PNG, "1500,", 0);
+  const auto d = plan_degraded(in);
+  EXPECT_EQ(d.steps, kDegradeFastScaling);
+  EXPECT_EQ(d.decode_size, in.size);
+  EXPECT_EQ(d.estimated, in.estimated);
+  EXPECT_EQ(d.jpeg_quality, in.jpeg_quality);
+}
+
+TEST(PlanDegraded, UnscaledDecodeKeepsItsResampler)
+{
+  const auto in = request(SipiQualityFormat::PNG, SipiQualityFormat::PNG, "max", 0);
+  const auto d = plan_degraded(in);
+  EXPECT_EQ(d.steps & kDegradeFastScaling, 0U);
+  EXPECT_EQ(d.scaling_quality.png, Sipi::ScalingMethod::HIGH);
+}
+
+TEST(PlanDegraded, StepsAlreadyInEffectAreNotRepeated)
+{
+  auto in = request(SipiQualityFormat::JP2, SipiQualityFormat::JPG, "max");
+  in.scaling_quality.jk2 = Sipi::ScalingMethod::LOW;
+  in.scaling_quality.j2k_layer_percent = 30;
+  in.jpeg_quality = kDegradedJpegQuality;
+  const auto d = plan_degraded(in);
+  EXPECT_EQ(d.steps & (kDegradeFastScaling | kDegradeJ2kLayers | kDegradeJpegQuality), 0U);
+  EXPECT_EQ(d.scaling_quality.j2k_layer_percent, 30);
+}
+
+TEST(PlanDegraded, HeaderNamesTheStepsInOrder)
+{
+  EXPECT_EQ(degraded_header_value(kDegradeJpegQuality | kDegradeLevel), "level, jpeg-quality");
+  EXPECT_EQ(degraded_header_value(kDegradeFastScaling), "fast-scaling");
+  EXPECT_EQ(degraded_header_value(kDegradeLevel | kDegradeFastScaling | kDegradeJ2kLayers | kDegradeJpegQuality),
+    "level, fast-scaling, layers, jpeg-quality");
+  EXPECT_EQ(degraded_header_value(0), "");
+}
+
+TEST(DecodeRate, PredictsNothingBeforeTheFirstDecode)
+{
+  DecodeRate rate;
+  EXPECT_FALSE(rate.predict(1000).has_value());
+  rate.record(0, std::chrono::milliseconds(5));// a zero estimate carries no rate
+  EXPECT_FALSE(rate.predict(1000).has_value());
+}
+
+TEST(DecodeRate, ScalesWithTheEstimateAndFollowsNewSamples)
+{
+  DecodeRate rate;
+  rate.record(1000, std::chrono::microseconds(10));// 10 ns per byte
+  EXPECT_EQ(rate.predict(2000), std::chrono::nanoseconds(20000));
+  for (int i = 0; i < 64; ++i) { rate.record(1000, std::chrono::microseconds(20)); }
+  const auto predicted = rate.predict(1000);
+  ASSERT_TRUE(predicted.has_value());
+  EXPECT_GT(*predicted, std::chrono::microseconds(19));
+  EXPECT_LE(*predicted, std::chrono::microseconds(20));
+}
+
+}// namespace
@@ -16,24 +16,34 @@
 #define SIPI_FFI_ENGINE_CONTEXT_H
 
 #include <cstddef>
+#include <cstdint>
 #include <string>
 
-#include "SipiIO.h"// ScalingQuality (value member)
+#include "SipiIO.h"// ScalingQuality, J2kGrayDecode (value members)
 
 namespace Sipi {
 class SipiCache;
 class SipiMemoryBudget;
+class PeakCalibration;
 }// namespace Sipi
 
 namespace Sipi::ffi {
 
-/*! Engine services + config read by the IIIF image pipeline. The two service
+class DecodeAmplification;
+class DecodeRate;
+class ShadowPyramids;
+
+/*! Engine services + config read by the IIIF image pipeline. The service
  *  pointers are non-owning (the installer outlives every serve call) and may be
  *  null when the corresponding feature is disabled. */
 struct EngineContext
 {
   SipiCache *cache = nullptr;//!< file cache, or null when caching is off
   SipiMemoryBudget *memory_budget = nullptr;//!< full-lane decode memory budget (always installed; basic or advanced)
+  ShadowPyramids *shadow_pyramids = nullptr;//!< pyramidal sidecars of hot flat sources, or null when `shadow_dir` is unset
+  DecodeRate *decode_rate = nullptr;//!< running decode rate that predicts deadline misses, or null to degrade only on budget pressure
+  PeakCalibration *peak_calibration = nullptr;//!< measured corrections of the peak-memory estimate, or null to charge the static estimate
+  DecodeAmplification *decode_amplification = nullptr;//!< top sources by decoded per rendered pixels, or null to rank none
   //!< A decode whose estimated peak memory is >= this threshold is a full-lane
   //!< decode and is charged against `memory_budget`; below it is a tile decode
   //!< and bypasses the budget. Single-sourced in the shell config and passed
@@ -54,6 +64,8 @@ struct EngineContext
   bool prefix_as_path = true;//!< IIIF prefix is a path component under imgroot (config knob, exposed to the edge)
   int jpeg_quality = 60;//!< JPEG encode quality
   ScalingQuality scaling_quality{};//!< per-format scaling method
+  std::uint32_t j2k_layer_truncation_size = 0;//!< longest output edge (px) up to which JPEG2000 decodes drop quality layers; 0 = off
+  J2kGrayDecode j2k_gray_decode = J2kGrayDecode::EXACT;//!< how `gray` renderings of colour JPEG2000 decode
   int port = 3333;//!< configured HTTP listen port (the config `port`); a fallback for the Rust edge's listener bind when no `--serverport`/`SIPI_SERVERPORT`/`SIPI_RS_PORT` selected one
   std::size_t max_post_size = 0;//!< max POST body size in bytes (the Rust shell caps Lua-route uploads); 0 = unlimited
 };
@@ -14,7 +14,9 @@
  * (`src/ffi`), not in the CLI package (`src/cli`).
  */
 
+#include <algorithm>
 #include <climits>
+#include <cstdint>
 #include <cstdlib>
 #include <fstream>
 #include <iterator>
@@ -28,17 +30,27 @@
 
 #include "SipiCache.h"
 #include "SipiConf.h"// Sipi::SipiConf, Sipi::parseSizeString
-#include "SipiIO.h"// Sipi::ScalingMethod, Sipi::ScalingQuality
+#include "SipiIO.h"// Sipi::ScalingMethod, Sipi::ScalingQuality, Sipi::J2kGrayDecode
 #include "throttling/SipiMemoryBudget.h"// Sipi::SipiMemoryBudget, AdmissionMode, parse_admission_mode
-#include "logging/logger.h"// log_warn / log_err / log_info
+#include "throttling/SipiPeakCalibration.h"// Sipi::PeakCalibration
+#include "logging/logger.h"// log_warn / log_err / log_info, start_async_logging
+#include "observability/flight_recorder.h"// Sipi::observability::FlightRecorder
 #include "observability/metrics.h"// Sipi::observability::Metrics
 
 #include "ffi/engine_context.h"// Sipi::ffi::set_engine_context, EngineContext
+#include "ffi/decode_amplification.h"// Sipi::ffi::DecodeAmplification
+#include "ffi/degraded_render.h"// Sipi::ffi::DecodeRate
+#include "ffi/shadow_pyramids.h"// Sipi::ffi::ShadowPyramids
 #include "ffi/sipi_ffi.h"// the extern "C" sipi_init contract + SipiServerConfig
 #include "ffi/startup.h"// Sipi::ffi::LibraryInitialiser, detect_available_memory
 
 namespace {
 
+/*! Bound on full-lane decodes waiting for budget in advanced mode. The shell's
+ *  full lane already caps how many run at once; this only keeps the queue from
+ *  parking an unbounded number of serve threads. */
+constexpr std::size_t kMemoryBudgetMaxWaiters = 64;
+
 /*! Map a config scaling-quality string to a ScalingMethod; unknown/missing → HIGH. */
 Sipi::ScalingMethod parse_scaling_method(const std::string &v)
 {
@@ -47,6 +59,15 @@ Sipi::ScalingMethod parse_scaling_method(const std::string &v)
   return Sipi::ScalingMethod::HIGH;
 }
 
+/*! Map a config `j2k_gray_decode` string to a J2kGrayDecode; nullopt for anything else. */
+std::optional<Sipi::J2kGrayDecode> parse_j2k_gray_decode(const std::string &v)
+{
+  if (v == "exact") { return Sipi::J2kGrayDecode::EXACT; }
+  if (v == "luminance") { return Sipi::J2kGrayDecode::LUMINANCE; }
+  if (v == "luminance_toned") { return Sipi::J2kGrayDecode::LUMINANCE_TONED; }
+  return std::nullopt;
+}
+
 /*! Convert SipiConf's `map<string,string>` scaling-quality table into the
  *  `ScalingQuality` struct EngineContext holds (jk2 ← the "jpk" key). */
 Sipi::ScalingQuality to_scaling_quality(const std::map<std::string, std::string> &m)
@@ -76,6 +97,10 @@ struct ServerRuntime
   Sipi::SipiConf conf;
   std::unique_ptr<Sipi::SipiCache> cache;
   std::unique_ptr<Sipi::SipiMemoryBudget> memory_budget;
+  std::unique_ptr<Sipi::ffi::ShadowPyramids> shadow_pyramids;// charges memory_budget, so declared (and stopped) after it
+  Sipi::ffi::DecodeRate decode_rate;
+  Sipi::PeakCalibration peak_calibration;
+  Sipi::ffi::DecodeAmplification decode_amplification;
 };
 std::unique_ptr<ServerRuntime> g_server_runtime;
 
@@ -133,6 +158,8 @@ extern "C" int sipi_init(const SipiServerConfig *overrides)
       if (o.adminuser != nullptr) conf.setAdminUser(o.adminuser);
       if (o.adminpasswd != nullptr) conf.setPasswort(o.adminpasswd);// `setPasswort` is the real (typo'd) setter
       if (o.cache_dir != nullptr) conf.setCacheDir(o.cache_dir);
+      if (o.shadow_dir != nullptr) conf.setShadowDir(o.shadow_dir);
+      if (o.shadow_max_size != nullptr) conf.setShadowMaxSize(Sipi::parseSizeString(o.shadow_max_size));
       if (o.cache_size != nullptr) conf.setCacheSize(Sipi::parseSizeString(o.cache_size));
       if (o.maxpost != nullptr) {
         const long long v = Sipi::parseSizeString(o.maxpost);
@@ -169,17 +196,37 @@ extern "C" int sipi_init(const SipiServerConfig *overrides)
         if (o.scaling_quality_j2k != nullptr) sq["j2k"] = o.scaling_quality_j2k;
         conf.setScalingQuality(sq);
       }
+      if (o.j2k_gray_decode != nullptr) conf.setJ2kGrayDecode(o.j2k_gray_decode);
       // Scalars (presence flag — 0 is a valid value, so gate on has_).
       if (o.has_serverport) conf.setPort(o.serverport);
       if (o.has_maxtmpage) conf.setMaxTempFileAge(o.maxtmpage);
       if (o.has_cache_nfiles) conf.setCacheNFiles(o.cache_nfiles);
       if (o.has_pathprefix) conf.setPrefixAsPath(o.pathprefix != 0);
       if (o.has_jpeg_quality) conf.setJpegQuality(o.jpeg_quality);
+      if (o.has_j2k_layer_truncation_size) conf.setJ2kLayerTruncationSize(o.j2k_layer_truncation_size);
+      if (o.has_shadow_hot_threshold) conf.setShadowHotThreshold(static_cast<int>(o.shadow_hot_threshold));
+      if (o.has_slow_request_ms) conf.setSlowRequestMs(static_cast<int>(o.slow_request_ms));
+      if (o.has_log_rate_limit) conf.setLogRateLimit(o.log_rate_limit);
     }
 
     // Apply the resolved engine log level to the C++ logger gate (CLI/env/TOML;
     // LL_INFO when unset). Without this the configured level is silently ignored.
     set_log_level(parse_log_level(conf.getLoglevel(), LL_INFO));
+    // Server-mode engine logs leave the serving threads: a slow log pipe costs
+    // dropped (and counted) lines, never a stalled request, and a sub-error line
+    // repeated on every request is held to log_rate_limit lines per second per
+    // level (0 = off).
+    set_log_rate_limit(conf.getLogRateLimit());
+    start_async_logging();
+
+    // Slow-request flight recorder: a serve at least this slow is kept and
+    // logged; 0 = off. A negative value is a config error, not "off".
+    if (conf.getSlowRequestMs() < 0) {
+      log_err("sipi_init: slow_request_ms %d must be >= 0 (0 = off)", conf.getSlowRequestMs());
+      return EXIT_FAILURE;
+    }
+    Sipi::observability::FlightRecorder::instance().set_threshold_ms(
+      static_cast<std::uint32_t>(conf.getSlowRequestMs()));
 
     // Engine services built from the config values (with the CLI/env overrides
     // above already applied). A null service means the corresponding feature is
@@ -230,8 +277,49 @@ extern "C" int sipi_init(const SipiServerConfig *overrides)
       }
       memory_limit_resolved = envelope;
       const auto full_mem = static_cast<std::size_t>(static_cast<double>(envelope) * (1.0 - ratio));
-      runtime->memory_budget = std::make_unique<Sipi::SipiMemoryBudget>(full_mem, mode);
+      runtime->memory_budget = std::make_unique<Sipi::SipiMemoryBudget>(full_mem, mode, kMemoryBudgetMaxWaiters);
+      runtime->memory_budget->set_waiting_observer([](std::size_t waiting) {
+        Sipi::observability::Metrics::instance().decode_memory_waiting.Set(static_cast<double>(waiting));
+      });
       Sipi::observability::Metrics::instance().decode_memory_budget_bytes.Set(static_cast<double>(full_mem));
+      Sipi::observability::Metrics::instance().decode_memory_calibration_factor_max_percent.Set(100.0);
+    }
+    // Shadow pyramids for hot flat sources, built against the full-lane budget.
+    // Like the cache, an unusable directory disables the feature, not startup.
+    {
+      const std::string shadowdir = conf.getShadowDir();
+      // The size cap is a byte count or -1 (unlimited); 0 would evict every
+      // shadow as soon as it is built.
+      const long long shadow_max_size = conf.getShadowMaxSize();
+      if (shadow_max_size == 0 || shadow_max_size < -1) {
+        log_err("sipi_init: shadow_max_size %lld must be positive or -1 (unlimited)", shadow_max_size);
+        return EXIT_FAILURE;
+      }
+      if (!shadowdir.empty()) {
+        try {
+          runtime->shadow_pyramids = std::make_unique<Sipi::ffi::ShadowPyramids>(shadowdir,
+            static_cast<unsigned>(std::max(conf.getShadowHotThreshold(), 1)),
+            shadow_max_size < 0 ? 0 : static_cast<std::uintmax_t>(shadow_max_size),
+            runtime->memory_budget.get());
+        } catch (const shttps::Error &e) {
+          log_warn("sipi_init: shadow pyramids disabled — %s", e.what());
+          runtime->shadow_pyramids = nullptr;
+        }
+      }
+    }
+
+    // JPEG2000 layer truncation: an edge length in px, 0 = off. A negative
+    // value is a config error, not "off".
+    if (conf.getJ2kLayerTruncationSize() < 0) {
+      log_err("sipi_init: j2k_layer_truncation_size %d must be >= 0 (0 = off)", conf.getJ2kLayerTruncationSize());
+      return EXIT_FAILURE;
+    }
+
+    const std::optional<Sipi::J2kGrayDecode> j2k_gray_decode = parse_j2k_gray_decode(conf.getJ2kGrayDecode());
+    if (!j2k_gray_decode) {
+      log_err("sipi_init: j2k_gray_decode '%s' is not one of exact, luminance, luminance_toned",
+        conf.getJ2kGrayDecode().c_str());
+      return EXIT_FAILURE;
     }
 
     // Resolve the image root (realpath) for path-traversal containment (R2).
@@ -247,6 +335,10 @@ extern "C" int sipi_init(const SipiServerConfig *overrides)
     Sipi::ffi::set_engine_context(Sipi::ffi::EngineContext{
       .cache = runtime->cache.get(),
       .memory_budget = runtime->memory_budget.get(),
+      .shadow_pyramids = runtime->shadow_pyramids.get(),
+      .decode_rate = &runtime->decode_rate,
+      .peak_calibration = &runtime->peak_calibration,
+      .decode_amplification = &runtime->decode_amplification,
       .large_decode_threshold_bytes = large_decode_threshold_bytes,
       .admission_mode = admission_mode_resolved,
       .tiles_memory_ratio = tiles_memory_ratio_resolved,
@@ -258,6 +350,8 @@ extern "C" int sipi_init(const SipiServerConfig *overrides)
       .prefix_as_path = conf.getPrefixAsPath(),
       .jpeg_quality = conf.getJpegQuality(),
       .scaling_quality = to_scaling_quality(conf.getScalingQuality()),
+      .j2k_layer_truncation_size = static_cast<std::uint32_t>(conf.getJ2kLayerTruncationSize()),
+      .j2k_gray_decode = *j2k_gray_decode,
       .port = conf.getPort(),
       .max_post_size = conf.getMaxPostSize(),
     });
@@ -66,6 +66,38 @@ struct SipiMetricsSnapshot
   uint64_t decode_memory_too_large_total;
   uint64_t decode_memory_shadow_too_large_total;
 
+  /* Flat sources decoded from their pyramidal sidecar / sidecars built / builds
+   * deferred for lack of full-lane budget (ffi/shadow_pyramids.h). */
+  uint64_t shadow_pyramid_hits_total;
+  uint64_t shadow_pyramid_builds_total;
+  uint64_t shadow_pyramid_deferred_total;
+
+  /* Decodes aborted at a cancellation checkpoint / decode microseconds spent on
+   * requests whose client left before the encode. */
+  uint64_t decode_cancelled_total;
+  uint64_t decode_wasted_microseconds_total;
+
+  /* Requests rendered cheaper than asked to meet their deadline (ffi/degraded_render.h). */
+  uint64_t decode_degraded_total;
+
+  /* Full-lane decodes admitted after waiting in the advanced-mode budget queue /
+   * their total wait in microseconds. */
+  uint64_t decode_memory_waited_total;
+  uint64_t decode_memory_wait_microseconds_total;
+
+  /* Measured decodes recorded by the peak-memory calibration. */
+  uint64_t decode_memory_calibration_samples_total;
+
+  /* Pixels decoded / pixels those decodes rendered (decode amplification). The
+   * worst sources by amplification come from `sipi_decode_offenders`. */
+  uint64_t decoded_pixels_total;
+  uint64_t decode_output_pixels_total;
+
+  /* Server-mode log lines dropped because the async ring was full / held back
+   * by the per-level rate limit, all levels summed (logging/logger.h). */
+  uint64_t log_dropped_lines_total;
+  uint64_t log_suppressed_lines_total;
+
   /* ── Gauges (signed: cache_size_limit_bytes uses -1 = unlimited) ─────────── */
   int64_t waiting_connections;
   int64_t cache_size_bytes;
@@ -74,6 +106,8 @@ struct SipiMetricsSnapshot
   int64_t cache_files_limit;
   int64_t decode_memory_budget_bytes;
   int64_t decode_memory_used_bytes;
+  int64_t decode_memory_waiting;
+  int64_t decode_memory_calibration_factor_max_percent;
 };
 
 #ifdef __cplusplus
@@ -81,7 +115,7 @@ struct SipiMetricsSnapshot
  * src/server-rs/src/ffi.rs. Every field is 8 bytes wide (uint64_t / int64_t),
  * so there is no packing subtlety, but the guard still catches an accidental
  * field reorder or insertion on either side. LP64 on every supported target. */
-static_assert(sizeof(SipiMetricsSnapshot) == 168, "SipiMetricsSnapshot size drifted from src/server-rs/src/ffi.rs");
+static_assert(sizeof(SipiMetricsSnapshot) == 288, "SipiMetricsSnapshot size drifted from src/server-rs/src/ffi.rs");
 static_assert(offsetof(SipiMetricsSnapshot, cache_hits_total) == 0, "SipiMetricsSnapshot layout drift");
 static_assert(offsetof(SipiMetricsSnapshot, cache_misses_total) == 8, "SipiMetricsSnapshot layout drift");
 static_assert(offsetof(SipiMetricsSnapshot, cache_evictions_total) == 16, "SipiMetricsSnapshot layout drift");
@@ -96,13 +130,28 @@ static_assert(offsetof(SipiMetricsSnapshot, decode_memory_near_limit_total) == 8
 static_assert(offsetof(SipiMetricsSnapshot, tiff_pyramid_reduced_decodes_total) == 88, "SipiMetricsSnapshot layout drift");
 static_assert(offsetof(SipiMetricsSnapshot, decode_memory_too_large_total) == 96, "SipiMetricsSnapshot layout drift");
 static_assert(offsetof(SipiMetricsSnapshot, decode_memory_shadow_too_large_total) == 104, "SipiMetricsSnapshot layout drift");
-static_assert(offsetof(SipiMetricsSnapshot, waiting_connections) == 112, "SipiMetricsSnapshot layout drift");
-static_assert(offsetof(SipiMetricsSnapshot, cache_size_bytes) == 120, "SipiMetricsSnapshot layout drift");
-static_assert(offsetof(SipiMetricsSnapshot, cache_files) == 128, "SipiMetricsSnapshot layout drift");
-static_assert(offsetof(SipiMetricsSnapshot, cache_size_limit_bytes) == 136, "SipiMetricsSnapshot layout drift");
-static_assert(offsetof(SipiMetricsSnapshot, cache_files_limit) == 144, "SipiMetricsSnapshot layout drift");
-static_assert(offsetof(SipiMetricsSnapshot, decode_memory_budget_bytes) == 152, "SipiMetricsSnapshot layout drift");
-static_assert(offsetof(SipiMetricsSnapshot, decode_memory_used_bytes) == 160, "SipiMetricsSnapshot layout drift");
+static_assert(offsetof(SipiMetricsSnapshot, shadow_pyramid_hits_total) == 112, "SipiMetricsSnapshot layout drift");
+static_assert(offsetof(SipiMetricsSnapshot, shadow_pyramid_builds_total) == 120, "SipiMetricsSnapshot layout drift");
+static_assert(offsetof(SipiMetricsSnapshot, shadow_pyramid_deferred_total) == 128, "SipiMetricsSnapshot layout drift");
+static_assert(offsetof(SipiMetricsSnapshot, decode_cancelled_total) == 136, "SipiMetricsSnapshot layout drift");
+static_assert(offsetof(SipiMetricsSnapshot, decode_wasted_microseconds_total) == 144, "SipiMetricsSnapshot layout drift");
+static_assert(offsetof(SipiMetricsSnapshot, decode_degraded_total) == 152, "SipiMetricsSnapshot layout drift");
+static_assert(offsetof(SipiMetricsSnapshot, decode_memory_waited_total) == 160, "SipiMetricsSnapshot layout drift");
+static_assert(offsetof(SipiMetricsSnapshot, decode_memory_wait_microseconds_total) == 168, "SipiMetricsSnapshot layout drift");
+static_assert(offsetof(SipiMetricsSnapshot, decode_memory_calibration_samples_total) == 176, "SipiMetricsSnapshot layout drift");
+static_assert(offsetof(SipiMetricsSnapshot, decoded_pixels_total) == 184, "SipiMetricsSnapshot layout drift");
+static_assert(offsetof(SipiMetricsSnapshot, decode_output_pixels_total) == 192, "SipiMetricsSnapshot layout drift");
+static_assert(offsetof(SipiMetricsSnapshot, log_dropped_lines_total) == 200, "SipiMetricsSnapshot layout drift");
+static_assert(offsetof(SipiMetricsSnapshot, log_suppressed_lines_total) == 208, "SipiMetricsSnapshot layout drift");
+static_assert(offsetof(SipiMetricsSnapshot, waiting_connections) == 216, "SipiMetricsSnapshot layout drift");
+static_assert(offsetof(SipiMetricsSnapshot, cache_size_bytes) == 224, "SipiMetricsSnapshot layout drift");
+static_assert(offsetof(SipiMetricsSnapshot, cache_files) == 232, "SipiMetricsSnapshot layout drift");
+static_assert(offsetof(SipiMetricsSnapshot, cache_size_limit_bytes) == 240, "SipiMetricsSnapshot layout drift");
+static_assert(offsetof(SipiMetricsSnapshot, cache_files_limit) == 248, "SipiMetricsSnapshot layout drift");
+static_assert(offsetof(SipiMetricsSnapshot, decode_memory_budget_bytes) == 256, "SipiMetricsSnapshot layout drift");
+static_assert(offsetof(SipiMetricsSnapshot, decode_memory_used_bytes) == 264, "SipiMetricsSnapshot layout drift");
+static_assert(offsetof(SipiMetricsSnapshot, decode_memory_waiting) == 272, "SipiMetricsSnapshot layout drift");
+static_assert(offsetof(SipiMetricsSnapshot, decode_memory_calibration_factor_max_percent) == 280, "SipiMetricsSnapshot layout drift");
 #endif
 
 #endif /* SIPI_FFI_METRICS_SNAPSHOT_H */
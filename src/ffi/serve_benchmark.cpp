@@ -0,0 +1,412 @@
+/*
+ * Copyright © 2016 - 2026 Swiss National Data and Service Center for the Humanities and/or DaSCH Service Platform
+ * contributors. SPDX-License-Identifier: AGPL-3.0-or-later
+ */
+
+// Serve-tier benchmarks — whole IIIF image requests through `sipi_serve_image`
+// in-process, the path the Rust shell drives per request: shape probe, cache,
+// memory budget, decode, transforms, encode. The response sink is a no-op, so
+// what is timed is the engine, not a socket.
+//
+// Each benchmark replays one request mix over one @sipi_bench_fixtures source
+// (the 7216×5412 master, see decode_benchmark.cpp):
+//
+//   tiles     a deep-zoom viewer's walk: every 256×256 tile of every level,
+//             coarsest first (`x,y,w,h/w,/0/default.jpg`)
+//   thumbs    `!n,n` best-fit thumbnails, n ∈ {64, 128, 256, 512}
+//   full      the full image at `max` as JPEG — the full-lane decode
+//   variants  rotated (90/180/270, mirrored) and `gray` renderings
+//   mixed     the four above interleaved by weight: SIPI_BENCH_SERVE_MIX,
+//             e.g. `tiles=70,thumbs=20,full=2,variants=8` (the default)
+//
+// at 1..hardware_concurrency threads (the threads share one cursor into the
+// mix, like viewers on one server), with the file cache off (cache=0) or on
+// (cache=1; each run starts it cold in TEST_TMPDIR). The memory budget is the
+// basic one sized as `sipi_init` sizes it by default.
+//
+// Reported: requests/s (items_per_second, wall clock across the threads),
+// response bytes/s, and per phase of `SipiServeTimings` the p50 and p99
+// duration over every request of the run (`<phase>_p50_us`, `<phase>_p99_us`)
+// plus the same for the whole serve (`serve_*`). A phase appears only if some
+// request ran it.
+//
+// Built only via `just bench serve` (-c opt, manual-tagged cc_binary), which
+// exports SIPI_BENCH_FIXTURES_DIR from the binary's runfiles tree.
+// See docs/src/development/benchmarking.md.
+
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <climits>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "SipiCache.h"
+#include "throttling/SipiMemoryBudget.h"
+
+#include "ffi/engine_context.h"
+#include "ffi/sipi_ffi.h"
+#include "ffi/startup.h"
+
+namespace {
+
+constexpr std::size_t kMasterWidth = 7216;
+constexpr std::size_t kMasterHeight = 5412;
+constexpr std::size_t kTileSize = 256;
+// The shell's default (DEFAULT_LARGE_DECODE_THRESHOLD_BYTES in config.rs).
+constexpr std::size_t kLargeDecodeThresholdBytes = 32ULL * 1024 * 1024;
+constexpr std::size_t kMixedLength = 1000;
+
+enum Mix : std::int64_t { kTiles = 0, kThumbs = 1, kFull = 2, kVariants = 3, kMixed = 4 };
+
+constexpr std::array<const char *, SIPI_PHASE_COUNT> kPhaseNames = {
+  "shape", "decode", "rotate", "quality", "watermark", "encode"
+};
+
+// Same resolution as decode_benchmark.cpp: the `just bench` recipe exports the
+// fixtures' runfiles location. Resolved through realpath, as `sipi_init`
+// resolves the image root.
+std::string fixtures_dir()
+{
+  const char *dir = std::getenv("SIPI_BENCH_FIXTURES_DIR");
+  if (dir == nullptr) {
+    std::fprintf(stderr, "SIPI_BENCH_FIXTURES_DIR not set — run via `just bench serve`\n");
+    std::exit(1);
+  }
+  const std::string p = std::string{ dir } + "/big_building";
+  char buf[PATH_MAX];
+  return realpath(p.c_str(), buf) != nullptr ? std::string(buf) : p;
+}
+
+// One request of a mix: its IIIF parameters and the URI it stands for.
+struct ServeCase
+{
+  SipiIiifParams params;
+  std::string uri;
+};
+
+SipiIiifParams jpeg_params()
+{
+  SipiIiifParams p{};
+  p.region_type = SIPI_REGION_FULL;
+  p.size_type = SIPI_SIZE_MAXDIM;
+  p.quality_type = SIPI_QUALITY_DEFAULT;
+  p.format_type = SIPI_FORMAT_JPG;
+  return p;
+}
+
+std::vector<ServeCase> tile_walk()
+{
+  std::vector<ServeCase> out;
+  for (std::size_t scale = 32; scale != 0; scale /= 2) {
+    const std::size_t span = kTileSize * scale;
+    for (std::size_t y = 0; y < kMasterHeight; y += span) {
+      for (std::size_t x = 0; x < kMasterWidth; x += span) {
+        const std::size_t w = std::min(span, kMasterWidth - x);
+        const std::size_t h = std::min(span, kMasterHeight - y);
+        SipiIiifParams p = jpeg_params();
+        p.region_type = SIPI_REGION_COORDS;
+        p.region[0] = static_cast<float>(x);
+        p.region[1] = static_cast<float>(y);
+        p.region[2] = static_cast<float>(w);
+        p.region[3] = static_cast<float>(h);
+        p.size_type = SIPI_SIZE_PIXELS_X;
+        p.size_nx = (w + scale - 1) / scale;
+        const std::string region =
+          std::to_string(x) + "," + std::to_string(y) + "," + std::to_string(w) + "," + std::to_string(h);
+        out.push_back({ p, "/" + region + "/" + std::to_string(p.size_nx) + ",/0/default.jpg" });
+      }
+    }
+  }
+  return out;
+}
+
+std::vector<ServeCase> thumbnails()
+{
+  std::vector<ServeCase> out;
+  for (const std::size_t n : { 64, 128, 256, 512 }) {
+    SipiIiifParams p = jpeg_params();
+    p.size_nx = n;
+    p.size_ny = n;
+    out.push_back({ p, "/full/!" + std::to_string(n) + "," + std::to_string(n) + "/0/default.jpg" });
+  }
+  return out;
+}
+
+std::vector<ServeCase> full_downloads()
+{
+  SipiIiifParams p = jpeg_params();
+  p.size_type = SIPI_SIZE_FULL;
+  return { { p, "/full/max/0/default.jpg" } };
+}
+
+std::vector<ServeCase> variants()
+{
+  std::vector<ServeCase> out;
+  const auto variant = [&out](float rotation, int mirror, SipiQualityType quality, const std::string &uri) {
+    SipiIiifParams p = jpeg_params();
+    p.size_nx = 1024;
+    p.size_ny = 1024;
+    p.rotation = rotation;
+    p.rotation_mirror = mirror;
+    p.quality_type = quality;
+    out.push_back({ p, "/full/!1024,1024/" + uri });
+  };
+  variant(90.F, 0, SIPI_QUALITY_DEFAULT, "90/default.jpg");
+  variant(180.F, 0, SIPI_QUALITY_DEFAULT, "180/default.jpg");
+  variant(270.F, 0, SIPI_QUALITY_DEFAULT, "270/default.jpg");
+  variant(0.F, 1, SIPI_QUALITY_DEFAULT, "!0/default.jpg");
+  variant(0.F, 0, SIPI_QUALITY_GRAY, "0/gray.jpg");
+  variant(90.F, 0, SIPI_QUALITY_GRAY, "90/gray.jpg");
+  return out;
+}
+
+// SIPI_BENCH_SERVE_MIX as weights per mix (tiles, thumbs, full, variants).
+std::array<unsigned, 4> mix_weights()
+{
+  std::array<unsigned, 4> weights = { 70, 20, 2, 8 };
+  const char *spec = std::getenv("SIPI_BENCH_SERVE_MIX");
+  if (spec == nullptr || *spec == '\0') { return weights; }
+  weights = {};
+  constexpr std::array<const char *, 4> kKeys = { "tiles", "thumbs", "full", "variants" };
+  std::string rest(spec);
+  while (!rest.empty()) {
+    const std::size_t comma = rest.find(',');
+    const std::string item = rest.substr(0, comma);
+    rest = comma == std::string::npos ? "" : rest.substr(comma + 1);
+    const std::size_t eq = item.find('=');
+    const auto key = std::find(kKeys.begin(), kKeys.end(), item.substr(0, eq));
+    char *end = nullptr;
+    const unsigned long weight = eq == std::string::npos ? 0 : std::strtoul(item.c_str() + eq + 1, &end, 10);
+    if (key == kKeys.end() || end == nullptr || *end != '\0') {
+      std::fprintf(stderr, "SIPI_BENCH_SERVE_MIX: bad entry '%s' (want tiles|thumbs|full|variants=<weight>)\n",
+        item.c_str());
+      std::exit(1);
+    }
+    weights[static_cast<std::size_t>(key - kKeys.begin())] = static_cast<unsigned>(weight);
+  }
+  if (weights[0] + weights[1] + weights[2] + weights[3] == 0) {
+    std::fprintf(stderr, "SIPI_BENCH_SERVE_MIX: all weights are 0\n");
+    std::exit(1);
+  }
+  return weights;
+}
+
+// The mixes interleaved by weight in a fixed pseudo-random order, each mix
+// cycling through its own requests — every run replays the same sequence.
+std::vector<ServeCase> mixed()
+{
+  const std::array<std::vector<ServeCase>, 4> sets = { tile_walk(), thumbnails(), full_downloads(), variants() };
+  const std::array<unsigned, 4> weights = mix_weights();
+  const unsigned total = weights[0] + weights[1] + weights[2] + weights[3];
+  std::array<std::size_t, 4> cursor{};
+  std::vector<ServeCase> out;
+  out.reserve(kMixedLength);
+  std::uint32_t state = 0x2545F491U;
+  while (out.size() < kMixedLength) {
+    state = state * 1664525U + 1013904223U;// LCG; the order only has to be fixed
+    unsigned pick = (state >> 8) % total;
+    std::size_t set = 0;
+    while (pick >= weights[set]) { pick -= weights[set++]; }
+    out.push_back(sets[set][cursor[set]++ % sets[set].size()]);
+  }
+  return out;
+}
+
+std::vector<ServeCase> build_mix(std::int64_t mix)
+{
+  switch (mix) {
+  case kTiles:
+    return tile_walk();
+  case kThumbs:
+    return thumbnails();
+  case kFull:
+    return full_downloads();
+  case kVariants:
+    return variants();
+  default:
+    return mixed();
+  }
+}
+
+// The no-op sink: discards the body, keeps the status so a failed serve is
+// reported instead of timed.
+struct Sink
+{
+  int status = 0;
+};
+
+SipiResponse noop_response(Sink &sink)
+{
+  SipiResponse r{};
+  r.ctx = &sink;
+  r.set_status = [](void *ctx, int status) { static_cast<Sink *>(ctx)->status = status; };
+  r.add_header = [](void *, const char *, const char *) {};
+  r.write = [](void *, const uint8_t *, size_t) { return 0; };
+  r.send_file = [](void *, const char *, uint64_t, uint64_t) { return 0; };
+  r.cancelled = [](void *) { return 0; };
+  r.write_owned = [](void *, uint8_t *data, size_t, SipiReleaseFn release) {
+    release(data);
+    return 0;
+  };
+  return r;
+}
+
+// Durations of one thread's requests: per phase, and of the whole serve.
+struct Samples
+{
+  std::array<std::vector<std::uint64_t>, SIPI_PHASE_COUNT> phase_ns;
+  std::vector<std::uint64_t> serve_ns;
+};
+
+// The state of one benchmark run, shared by its threads. Thread 0 builds it
+// before the timed loop and reads it back after; Google Benchmark's start and
+// stop barriers order those against the other threads' loops.
+struct Run
+{
+  std::string path;
+  std::string uri_base;
+  std::vector<ServeCase> cases;
+  std::unique_ptr<Sipi::SipiCache> cache;
+  std::unique_ptr<Sipi::SipiMemoryBudget> budget;
+  std::vector<Samples> samples;// one per thread
+};
+
+Run g_run;
+
+void start_run(const benchmark::State &state, const char *file)
+{
+  Sipi::ffi::LibraryInitialiser::instance();
+  const std::string dir = fixtures_dir();
+  g_run.path = dir + "/" + file;
+  g_run.uri_base = std::string("/bench/") + file;
+  g_run.cases = build_mix(state.range(0));
+  g_run.samples.assign(static_cast<std::size_t>(state.threads()), Samples{});
+
+  g_run.cache.reset();
+  if (state.range(1) != 0) {
+    const char *tmp = std::getenv("TEST_TMPDIR");
+    const std::string cachedir = std::string{ tmp != nullptr ? tmp : "/tmp" } + "/sipi_bench_serve_cache";
+    std::filesystem::remove_all(cachedir);
+    g_run.cache = std::make_unique<Sipi::SipiCache>(cachedir);
+  }
+  const std::size_t detected = Sipi::ffi::detect_available_memory();
+  const std::size_t envelope = detected > 0 ? detected : 1ULL * 1024 * 1024 * 1024;
+  g_run.budget = std::make_unique<Sipi::SipiMemoryBudget>(envelope / 4 * 3, Sipi::AdmissionMode::BASIC);
+
+  Sipi::ffi::EngineContext eng;
+  eng.cache = g_run.cache.get();
+  eng.memory_budget = g_run.budget.get();
+  eng.large_decode_threshold_bytes = kLargeDecodeThresholdBytes;
+  eng.imgroot = dir;
+  eng.resolved_imgroot = dir;
+  Sipi::ffi::set_engine_context(eng);
+}
+
+std::uint64_t percentile(std::vector<std::uint64_t> &v, double q)
+{
+  const auto rank = static_cast<std::size_t>(q * static_cast<double>(v.size() - 1) + 0.5);
+  std::nth_element(v.begin(), v.begin() + static_cast<std::ptrdiff_t>(rank), v.end());
+  return v[rank];
+}
+
+void report_percentiles(benchmark::State &state, const std::string &name, std::vector<std::uint64_t> &v)
+{
+  if (v.empty()) { return; }
+  state.counters[name + "_p50_us"] = static_cast<double>(percentile(v, 0.50)) / 1e3;
+  state.counters[name + "_p99_us"] = static_cast<double>(percentile(v, 0.99)) / 1e3;
+}
+
+// Merges every thread's samples; only thread 0 reports them, so the per-thread
+// counter sum Google Benchmark takes is thread 0's value.
+void finish_run(benchmark::State &state)
+{
+  Samples all;
+  for (auto &s : g_run.samples) {
+    for (std::size_t p = 0; p < SIPI_PHASE_COUNT; ++p) {
+      all.phase_ns[p].insert(all.phase_ns[p].end(), s.phase_ns[p].begin(), s.phase_ns[p].end());
+    }
+    all.serve_ns.insert(all.serve_ns.end(), s.serve_ns.begin(), s.serve_ns.end());
+  }
+  for (std::size_t p = 0; p < SIPI_PHASE_COUNT; ++p) { report_percentiles(state, kPhaseNames[p], all.phase_ns[p]); }
+  report_percentiles(state, "serve", all.serve_ns);
+
+  // Uninstall the services before they are freed; the next run installs its own.
+  Sipi::ffi::set_engine_context(Sipi::ffi::EngineContext{});
+  g_run.cache.reset();
+  g_run.budget.reset();
+}
+
+void serve_mix(benchmark::State &state, const char *file)
+{
+  if (state.thread_index() == 0) { start_run(state, file); }
+  const auto threads = static_cast<std::size_t>(state.threads());
+  std::size_t next = static_cast<std::size_t>(state.thread_index());
+  Sink sink;
+  const SipiResponse response = noop_response(sink);
+  SipiServeTimings timings{};
+  std::int64_t response_bytes = 0;
+
+  for (auto _ : state) {
+    Samples &samples = g_run.samples[static_cast<std::size_t>(state.thread_index())];
+    const ServeCase &c = g_run.cases[next % g_run.cases.size()];
+    next += threads;
+    const std::string uri = g_run.uri_base + c.uri;
+    SipiServeRequest req{};
+    req.resolved_path = g_run.path.c_str();
+    req.prefix = "bench";
+    req.identifier = file;
+    req.client_ip = "127.0.0.1";
+    req.params = c.params;
+    req.forwarded_host = "localhost";
+    req.request_uri = uri.c_str();
+
+    sink.status = 0;
+    const auto start = std::chrono::steady_clock::now();
+    const int status = sipi_serve_image(&req, &response);
+    const auto elapsed = std::chrono::steady_clock::now() - start;
+    sipi_serve_timings_take(&timings);
+    if (status != 0 || sink.status >= 400) {
+      state.SkipWithError(("serve failed: " + uri + " (status " + std::to_string(status) + ", HTTP "
+                           + std::to_string(sink.status) + ")")
+                            .c_str());
+      break;
+    }
+
+    samples.serve_ns.push_back(
+      static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count()));
+    for (std::size_t p = 0; p < SIPI_PHASE_COUNT; ++p) {
+      if (timings.present[p] != 0) { samples.phase_ns[p].push_back(timings.dur_ns[p]); }
+    }
+    response_bytes += static_cast<std::int64_t>(timings.response_bytes);
+  }
+
+  state.SetItemsProcessed(state.iterations());
+  state.SetBytesProcessed(response_bytes);
+  if (state.thread_index() == 0) { finish_run(state); }
+}
+
+int max_threads() { return static_cast<int>(std::max(1U, std::thread::hardware_concurrency())); }
+
+#define SIPI_SERVE_BENCH(name, file)                                           \
+  BENCHMARK_CAPTURE(serve_mix, name, file)                                     \
+    ->ArgsProduct({ { kTiles, kThumbs, kFull, kVariants, kMixed }, { 0, 1 } }) \
+    ->ArgNames({ "mix", "cache" })                                             \
+    ->ThreadRange(1, max_threads())                                            \
+    ->UseRealTime()                                                            \
+    ->Unit(benchmark::kMillisecond)
+
+SIPI_SERVE_BENCH(pyr_zstd, "pyr-zstd.tif");
+SIPI_SERVE_BENCH(jp2, "pyr.jp2");
+
+#undef SIPI_SERVE_BENCH
+
+}// namespace
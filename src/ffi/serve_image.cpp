@@ -4,24 +4,38 @@
  */
 
 #include "ffi/serve_image.h"
+#include "ffi/degraded_render.h"// plan_degraded, DecodeRate
 #include "ffi/serve_timings.h"// PhaseTimer + decode-estimate capture, read back by the shell
+#include "ffi/shadow_pyramids.h"// is_flat_source, ShadowPyramids::lookup
 
 #include <sys/stat.h>
 #include <unistd.h>
 
+#include <algorithm>
 #include <array>
+#include <chrono>
 #include <cmath>
 #include <cstdint>
 #include <fstream>
 #include <memory>
 #include <optional>
+#include <span>
 #include <string>
+#include <utility>
+#include <variant>
+#include <vector>
 
 #include "SipiImage.h"
 #include "SipiImageError.h"
 #include "SipiCache.h"
+#include "decode_cancel.h"
+#include "decode_report.h"
+#include "ffi/decode_amplification.h"
 #include "throttling/SipiMemoryBudget.h"
+#include "throttling/SipiPeakCalibration.h"
 #include "throttling/SipiPeakMemory.h"
+#include "formats/SipiIOJ2k.h"// j2k_layer_percent, plan_region_transcode, transcode_region
+#include "formats/SipiIOTiff.h"// plan_tile_copy, copy_tiles
 #include "formats/output_sink.h"
 #include "iiifparser/SipiDecodeDims.h"
 #include "iiifparser/SipiIdentifier.h"
@@ -31,6 +45,7 @@
 #include "iiifparser/SipiSize.h"
 #include "logging/logger.h"
 #include "metadata/icc.h"
+#include "observability/flight_recorder.h"// flight_note: the pipeline's decisions, for a slow serve's capture
 #include "observability/metrics.h"
 #include "populate_from_image.h"
 #include "util/Parsing.h"
@@ -39,12 +54,77 @@
 namespace Sipi::ffi {
 namespace {
 
+  using observability::flight_note;
   using observability::get_file_size;
   using observability::ImageContext;
   using observability::Metrics;
   using observability::populate_from_image;
 
   constexpr const char *kCacheControl = "must-revalidate, post-check=0, pre-check=0";
+  constexpr const char *kDegradedHeader = "X-Sipi-Degraded";
+
+  // How long a full-lane decode without a deadline waits in the advanced-mode
+  // budget queue before it is turned away: the Retry-After it would get.
+  constexpr auto kMemoryBudgetWait = std::chrono::seconds(5);
+
+  // Counts a full-lane acquisition that was admitted after queueing.
+  void record_memory_wait(const MemoryBudgetResult &result)
+  {
+    if (!result.allowed || result.waited == std::chrono::nanoseconds::zero()) { return; }
+    auto &metrics = Metrics::instance();
+    metrics.decode_memory_waited_total.Increment();
+    metrics.decode_memory_wait_microseconds_total.Increment(
+      static_cast<double>(std::chrono::duration_cast<std::chrono::microseconds>(result.waited).count()));
+  }
+
+  // The calibration slot of a decode: its codec and the steps that follow it.
+  CalibrationKey calibration_key(SipiQualityFormat::FormatType decode_format,
+    const DecodeDims &ddims,
+    bool rotates,
+    bool converts)
+  {
+    unsigned codec = 4;
+    switch (decode_format) {
+    case SipiQualityFormat::JP2:
+      codec = 0;
+      break;
+    case SipiQualityFormat::TIF:
+      codec = 1;
+      break;
+    case SipiQualityFormat::JPG:
+      codec = 2;
+      break;
+    case SipiQualityFormat::PNG:
+      codec = 3;
+      break;
+    default:
+      break;
+    }
+    return CalibrationKey{ .codec = codec,
+      .reduced = ddims.reduce > 0,
+      .scales = !ddims.reduce_only && (ddims.out_w != ddims.width || ddims.out_h != ddims.height),
+      .rotates = rotates,
+      .converts = converts };
+  }
+
+  // Shrinks a full-lane reservation to what the rest of the pipeline needs:
+  // `img`'s live buffer plus the one each step still to run allocates beside
+  // it (a mirror, a rotation by `angle`, a colour conversion). The surplus of
+  // the worst-case estimate goes back to the budget at once.
+  void shrink_reservation(std::optional<MemoryBudgetGuard> &guard,
+    const SipiImage &img,
+    bool mirror,
+    double angle,
+    bool converts)
+  {
+    if (!guard) { return; }
+    const size_t live = img.getPixelBytes();
+    size_t need = std::max(live,
+      estimate_peak_memory(img.getNx(), img.getNy(), 0, 0, static_cast<int>(img.getNc()),
+        static_cast<int>(img.getBps()), angle, converts));
+    if (mirror) { need = std::max(need, 2 * live); }
+    guard->shrink_to(need);
+  }
 
   // Flattens a handled image error into the seam's SipiImageErrorReport and
   // reports it through `report_error` iff non-null — the seam's "NULL =
@@ -265,6 +345,10 @@ namespace {
     return std::make_pair(std::string(canonical_header), canonical);
   }
 
+  // A compressed-domain rendering of the source, served instead of encoding a
+  // decoded image: a JP2 code-block transcode or a TIFF raw-tile copy.
+  using CompressedCopy = std::variant<std::monostate, J2kRegionTranscode, TiffTileCopy>;
+
   // The decoded image + the encode job, captured for the streamed-body tail.
   // produce() runs ONLY the encode (the rarely-failing step): the decode +
   // transforms already ran in build_image_response, before the response committed.
@@ -282,19 +366,23 @@ namespace {
       SipiImgInfo info,
       std::optional<MemoryBudgetGuard> budget_guard,
       SipiReportErrorFn report_error,
-      void *report_ctx)
+      void *report_ctx,
+      CompressedCopy copy = std::monostate{})
       : budget_guard_(std::move(budget_guard)), img_(std::move(img)), format_(format), jpeg_quality_(jpeg_quality),
         cache_(cache), cachefile_(std::move(cachefile)), infile_(std::move(infile)), cache_key_(std::move(cache_key)),
-        request_uri_(std::move(request_uri)), info_(info), report_error_(report_error), report_ctx_(report_ctx)
+        request_uri_(std::move(request_uri)), info_(info), report_error_(report_error), report_ctx_(report_ctx),
+        copy_(std::move(copy))
     {}
 
     int produce(const StreamSink &sink) override
     {
-      // Bridge the StreamSink to the format handlers' C-ABI write callback. The
-      // free thunk + struct ctx carry both the sink (the socket) and a running
+      // Bridge the StreamSink to the format handlers' C-ABI write callbacks. The
+      // free thunks + struct ctx carry both the sink (the socket) and a running
       // byte count for the DEV-6660 cache-integrity check.
       ThunkCtx tctx{ &sink, 0 };
-      const CallbackSink socket{ &ImageEncodeProducer::sink_thunk, &tctx };
+      const CallbackSink socket{
+        &ImageEncodeProducer::sink_thunk, &tctx, &ImageEncodeProducer::sink_owned_thunk
+      };
 
       const bool caching = cache_ != nullptr && !cachefile_.empty();
       const OutputSink out = caching
@@ -312,10 +400,20 @@ namespace {
           break;
         }
         case SipiQualityFormat::JP2:
-          img_.write("jpx", out);
+          if (const auto *job = std::get_if<J2kRegionTranscode>(&copy_)) {
+            // Lossless region transcode: img_ is empty, the source's
+            // code-blocks are copied straight into the response.
+            SipiIOJ2k::transcode_region(infile_, *job, out);
+          } else {
+            img_.write("jpx", out);
+          }
           break;
         case SipiQualityFormat::TIF:
-          img_.write("tif", out);
+          if (const auto *job = std::get_if<TiffTileCopy>(&copy_)) {
+            SipiIOTiff::copy_tiles(infile_, *job, out);// raw tiles, img_ is empty
+          } else {
+            img_.write("tif", out);
+          }
           break;
         case SipiQualityFormat::PNG:
           img_.write("png", out);
@@ -323,6 +421,10 @@ namespace {
         default:
           break;
         }
+        // Encoded and handed to the sink: the pixels and their reservation
+        // are no longer needed while the cache file is committed.
+        img_ = SipiImage();
+        if (budget_guard_) { budget_guard_->shrink_to(0); }
       } catch (SipiImageClientAbortError &) {
         // Client closed the socket mid-response (Traefik 499). Not a server
         // error: drop the partial cache file, no Sentry.
@@ -357,9 +459,20 @@ namespace {
     {
       auto *t = static_cast<ThunkCtx *>(ctx);
       t->bytes += len;
+      serve_timings_add_response_bytes(len);
+      const SinkWaitTimer wait;
       return t->sink->write(data, len);
     }
 
+    static int sink_owned_thunk(void *ctx, std::uint8_t *data, std::size_t len, SipiReleaseFn release)
+    {
+      auto *t = static_cast<ThunkCtx *>(ctx);
+      t->bytes += len;
+      serve_timings_add_response_bytes(len);
+      const SinkWaitTimer wait;
+      return t->sink->write_owned(data, len, release);
+    }
+
     void capture_write_error(const std::string &message) const
     {
       ImageContext sentry_ctx;
@@ -412,10 +525,11 @@ namespace {
         info_.numpages);
     }
 
-    // The decode-memory reservation, held (not read) so the budget stays
-    // accounted for across the streamed encode and is released on destruction.
-    // Declared first so it outlives img_: the image buffer frees, *then* the
-    // budget is released, keeping the in-flight accounting honest at teardown.
+    // The decode-memory reservation, shrunk to img_'s buffer before the encode
+    // so the budget stays accounted for across the streamed encode, and
+    // released once the encode is done or on destruction. Declared first so it
+    // outlives img_: the image buffer frees, *then* the budget is released,
+    // keeping the in-flight accounting honest at teardown.
     std::optional<MemoryBudgetGuard> budget_guard_;
     SipiImage img_;
     SipiQualityFormat::FormatType format_;
@@ -434,10 +548,74 @@ namespace {
     // reads it. Never retain either past this object's lifetime.
     SipiReportErrorFn report_error_;
     void *report_ctx_;
+    // Set for a request served from the source's compressed data instead of
+    // by encoding img_.
+    CompressedCopy copy_;
   };
 
   std::string str_or_empty(const char *s) { return s != nullptr ? std::string(s) : std::string(); }
 
+  // A fresh cache file for the producer's TeeSink, probed for writability now
+  // (a 500 here is still pre-commit). Empty when caching is off.
+  std::expected<std::string, SipiStatus> new_cache_file(SipiCache *cache)
+  {
+    if (cache == nullptr) { return std::string(); }
+    std::string cachefile = cache->getNewCacheFileName();
+    std::ofstream probe(cachefile, std::ofstream::out | std::ofstream::binary | std::ofstream::trunc);
+    if (probe.fail()) { return std::unexpected(SipiStatus::InternalError); }
+    return cachefile;
+  }
+
+  // A reduce-only rendering: the Region in full-resolution pixels and the
+  // Size's reduce exponent.
+  struct ReduceOnlyRegion
+  {
+    uint32_t x, y, w, h;
+    int reduce;
+  };
+
+  // The request as a ReduceOnlyRegion; nullopt when its Size needs a residual
+  // rescale on top of the reduce.
+  std::optional<ReduceOnlyRegion> reduce_only_region(const SipiImgInfo &info, SipiRegion &region, SipiSize &size)
+  {
+    const auto img_w = static_cast<size_t>(info.width);
+    const auto img_h = static_cast<size_t>(info.height);
+    int x = 0, y = 0;
+    size_t w = img_w, h = img_h;
+    if (region.getType() != SipiRegion::FULL) { region.crop_coords(img_w, img_h, x, y, w, h); }
+    int reduce = 0;
+    bool redonly = true;
+    if (size.getType() != SipiSize::FULL) {
+      size_t nnx = 0, nny = 0;
+      size.get_size(w, h, nnx, nny, reduce, redonly);
+    }
+    if (!redonly || x < 0 || y < 0) { return std::nullopt; }
+    return ReduceOnlyRegion{ static_cast<uint32_t>(x),
+      static_cast<uint32_t>(y),
+      static_cast<uint32_t>(w),
+      static_cast<uint32_t>(h),
+      std::max(reduce, 0) };
+  }
+
+  // The compressed-domain copy for a same-format request, or monostate when it
+  // needs a pixel decode. JP2: the Region must be tile-aligned at the reduce
+  // on the codestream's own SIZ grid; `info` carries no canvas or tile
+  // origins (read_shape's Essentials fast path never sees the SIZ), so the
+  // plan reads the main header. TIFF: a pyramid level of exactly the reduce
+  // must hold the Region on whole tiles; read_shape's fast path skips the
+  // pyramid, so the plan reads it from the file.
+  CompressedCopy plan_compressed_copy(SipiQualityFormat::FormatType format,
+    const std::string &infile,
+    const ReduceOnlyRegion &r)
+  {
+    if (format == SipiQualityFormat::JP2) {
+      if (auto job = SipiIOJ2k::plan_region_transcode(infile, r.x, r.y, r.w, r.h, r.reduce)) { return *job; }
+    } else if (format == SipiQualityFormat::TIF) {
+      if (auto job = SipiIOTiff::plan_tile_copy(infile, r.x, r.y, r.w, r.h, r.reduce)) { return *job; }
+    }
+    return std::monostate{};
+  }
+
   // A full-file body for the passthrough / cache-hit paths, stat'd here so a
   // file that vanished after the earlier checks is a clean error rather than a
   // 200 with a wrong length (get_file_size returns 0 on a failed stat, which
@@ -452,43 +630,232 @@ namespace {
     return Body{ FileBody{ path, 0, size } };
   }
 
+  // Thrown out of the read_tiles callback when the caller's emit stops the batch.
+  struct TileBatchStopped
+  {};
+
+  int append_to_buffer(void *ctx, const std::uint8_t *data, std::size_t len)
+  {
+    auto *buf = static_cast<std::vector<std::uint8_t> *>(ctx);
+    buf->insert(buf->end(), data, data + len);
+    return 0;
+  }
+
+  // Rotates, converts, watermarks and encodes one decoded tile into `out`: the
+  // steps build_image_response runs after its decode, without the cache and
+  // the streamed body.
+  void encode_tile(SipiImage &img,
+    const SipiIiifParams &p,
+    const std::string &watermark,
+    int jpeg_quality,
+    std::vector<std::uint8_t> &out)
+  {
+    SipiRotation rotation(p.rotation, p.rotation_mirror != 0);
+    float angle = 0.F;
+    const bool mirror = rotation.get_rotation(angle);
+    if (mirror || angle != 0.0) { img.rotate(angle, mirror); }
+
+    switch (static_cast<SipiQualityFormat::QualityType>(p.quality_type)) {
+    case SipiQualityFormat::COLOR:
+      img.convertToIcc(Icc(icc_sRGB), 8);
+      break;
+    case SipiQualityFormat::GRAY:
+      if (!(img.getNc() == 1 && img.getBps() == 8 && img.getPhoto() == PhotometricInterpretation::MINISBLACK
+            && img.getIcc() != nullptr
+            && (img.getIcc()->getProfileType() == icc_GRAY_D50 || img.getIcc()->getProfileType() == icc_GRAY_sRGB))) {
+        img.convertToIcc(Icc(icc_GRAY_D50), 8);
+      }
+      break;
+    case SipiQualityFormat::BITONAL:
+      img.toBitonal();
+      break;
+    default:
+      break;
+    }
+    if (!watermark.empty()) { img.add_watermark(watermark); }
+
+    const OutputSink sink{ CallbackSink{ &append_to_buffer, &out } };
+    switch (static_cast<SipiQualityFormat::FormatType>(p.format_type)) {
+    case SipiQualityFormat::JPG: {
+      img.to8bps();// a batch of mixed formats is not decoded with force_bps_8
+      SipiCompressionParams qp = { { JPEG_QUALITY, std::to_string(jpeg_quality) } };
+      img.write("jpg", sink, &qp);
+      break;
+    }
+    case SipiQualityFormat::JP2:
+      img.write("jpx", sink);
+      break;
+    case SipiQualityFormat::TIF:
+      img.write("tif", sink);
+      break;
+    case SipiQualityFormat::PNG:
+      img.write("png", sink);
+      break;
+    default:
+      throw SipiError("Unsupported tile format");
+    }
+  }
+
+  // The client left after the decode started — mid-decode at a cancellation
+  // checkpoint, or before a later stage. Everything decoded since `decode_start`
+  // is thrown away.
+  std::unexpected<SipiStatus> decode_wasted(std::chrono::steady_clock::time_point decode_start)
+  {
+    auto &metrics = Metrics::instance();
+    const auto wasted = std::chrono::duration_cast<std::chrono::microseconds>(
+      std::chrono::steady_clock::now() - decode_start);
+    metrics.client_disconnected_total.Increment();
+    metrics.decode_wasted_microseconds_total.Increment(static_cast<double>(wasted.count()));
+    return std::unexpected(SipiStatus::ClientGone);
+  }
+
+  // SipiQualityFormat::FormatType and SipiFormatType share their values.
+  SipiFormatType format_type(SipiQualityFormat::FormatType format) { return static_cast<SipiFormatType>(format); }
+
+  // A body served from a file as-is: the bytes read are the bytes sent.
+  void record_file_body(SipiQualityFormat::FormatType in_format, SipiDecodePath path, const Body &body)
+  {
+    const auto *file = std::get_if<FileBody>(&body);
+    const std::uint64_t bytes = file != nullptr ? file->length : 0;
+    serve_timings_set_decode_path(format_type(in_format), path);
+    serve_timings_set_source_bytes(bytes);
+    serve_timings_add_response_bytes(bytes);
+  }
+
+  // The flight recorder's name for a plan route.
+  const char *route_name(SipiPlanRoute route)
+  {
+    switch (route) {
+    case SIPI_PLAN_HEAD:
+      return "head";
+    case SIPI_PLAN_PASSTHROUGH:
+      return "passthrough";
+    case SIPI_PLAN_CACHE_HIT:
+      return "cache_hit";
+    case SIPI_PLAN_COPY:
+      return "copy";
+    case SIPI_PLAN_DECODE:
+      break;
+    }
+    return "decode";
+  }
+
+  SipiDecodePath decode_path_label(DecodePath path)
+  {
+    switch (path) {
+    case DecodePath::Pyramid:
+      return SIPI_DECODE_PATH_PYRAMID;
+    case DecodePath::DctScaled:
+      return SIPI_DECODE_PATH_DCT_SCALED;
+    case DecodePath::Full:
+      break;
+    }
+    return SIPI_DECODE_PATH_FULL;
+  }
+
 }// namespace
 
-std::expected<ServeResponse, SipiStatus>
-  build_image_response(const SipiServeRequest &req, const EngineContext &eng, const std::function<bool()> &cancelled)
+// The request as plan_image left it: its typed params, the response headers,
+// and what the chosen route still needs to run.
+struct ServePlan::State
 {
-  const std::string infile = str_or_empty(req.resolved_path);
-  const std::string uri = str_or_empty(req.request_uri);
+  SipiPlanRoute route{ SIPI_PLAN_DECODE };
+  std::string infile;
+  std::string uri;
+  SipiQualityFormat::FormatType in_format{ SipiQualityFormat::UNSUPPORTED };
+  std::shared_ptr<SipiRegion> region;
+  std::shared_ptr<SipiSize> size;
+  float angle{ 0.F };
+  bool mirror{ false };
+  SipiQualityFormat quality_format;
+  std::string watermark;
+  SipiImgInfo info;
+  std::vector<Header> headers;
+  std::string cache_key;
+  const char *content_type{ nullptr };
+  // The request's deadline (plan time + `deadline_ms`), if it has one.
+  std::optional<std::chrono::steady_clock::time_point> deadline;
+
+  // SIPI_PLAN_CACHE_HIT: the pinned cache file, released here unless execute_plan
+  // handed the pin on to the response.
+  SipiCache *cache{ nullptr };
+  std::string cachefile;
+
+  // SIPI_PLAN_COPY
+  CompressedCopy copy;
+
+  // SIPI_PLAN_DECODE: the file actually decoded (a shadow pyramid or the source)
+  // and the decode's size and peak-memory estimate.
+  std::string decode_file;
+  SipiQualityFormat::FormatType decode_format{ SipiQualityFormat::UNSUPPORTED };
+  int decode_clevels{ 0 };
+  bool needs_icc{ false };
+  DecodeDims ddims;
+  std::size_t static_estimate{ 0 };//!< the model's estimate, before calibration
+  CalibrationKey calibration_key;
+  std::size_t estimated{ 0 };
+  bool full_lane{ false };
+
+  State() = default;
+  State(const State &) = delete;
+  State &operator=(const State &) = delete;
+  ~State()
+  {
+    if (cache != nullptr && !cachefile.empty()) { cache->deblock(cachefile); }
+  }
+};
+
+ServePlan::ServePlan(std::unique_ptr<State> state) : state_(std::move(state)) {}
+ServePlan::ServePlan(ServePlan &&) noexcept = default;
+ServePlan &ServePlan::operator=(ServePlan &&) noexcept = default;
+ServePlan::~ServePlan() = default;
+
+SipiPlanRoute ServePlan::route() const { return state_->route; }
+std::size_t ServePlan::decode_estimate() const { return state_->estimated; }
+bool ServePlan::full_lane() const { return state_->full_lane; }
+
+std::expected<ServePlan, SipiStatus> plan_image(const SipiServeRequest &req, const EngineContext &eng)
+{
+  auto plan = std::make_unique<ServePlan::State>();
+  ServePlan::State &st = *plan;
+  if (req.deadline_ms != 0) {
+    st.deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(req.deadline_ms);
+  }
+  st.infile = str_or_empty(req.resolved_path);
+  st.uri = str_or_empty(req.request_uri);
+  const std::string &infile = st.infile;
+  flight_note("uri", st.uri);
 
   // Reconstruct the typed IIIF params from the flat seam (caller already
   // validated the source strings, so this cannot throw).
-  auto region = rebuild_region(req.params);
-  auto size = rebuild_size(req.params);
+  st.region = rebuild_region(req.params);
+  st.size = rebuild_size(req.params);
   SipiRotation rotation(req.params.rotation, req.params.rotation_mirror != 0);
-  SipiQualityFormat quality_format(
-    static_cast<SipiQualityFormat::QualityType>(req.params.quality_type),
+  st.quality_format = SipiQualityFormat(static_cast<SipiQualityFormat::QualityType>(req.params.quality_type),
     static_cast<SipiQualityFormat::FormatType>(req.params.format_type));
+  SipiQualityFormat &quality_format = st.quality_format;
 
   const SipiIdentifier sid(shttps::urldecode(str_or_empty(req.identifier)));
 
-  const std::string watermark = str_or_empty(req.watermark_path);
+  st.watermark = str_or_empty(req.watermark_path);
   auto restricted_size =
     req.restricted_size != nullptr ? std::make_shared<SipiSize>(std::string(req.restricted_size)) : std::make_shared<SipiSize>();
 
   const SipiQualityFormat::FormatType in_format = detect_in_format(infile);
+  st.in_format = in_format;
 
   if (access(infile.c_str(), R_OK) != 0) { return std::unexpected(SipiStatus::NotFound); }
 
-  float angle = 0.F;
-  const bool mirror = rotation.get_rotation(angle);
+  st.mirror = rotation.get_rotation(st.angle);
+  const float angle = st.angle;
+  const bool mirror = st.mirror;
 
   // Image shape (no full decode) — needed for size math, the canonical URL, the
   // memory estimate, and the cache entry.
-  SipiImgInfo info;
   try {
     SipiImage probe;
     PhaseTimer phase_timer(SIPI_PHASE_SHAPE);
-    info = probe.read_shape(infile);
+    st.info = probe.read_shape(infile);
   } catch (SipiImageError &err) {
     ImageContext sentry_ctx;
     sentry_ctx.input_file = infile;
@@ -496,16 +863,19 @@ std::expected<ServeResponse, SipiStatus>
     report_image_error(req.report_error, req.report_ctx, err.to_string(), "read", sentry_ctx);
     return std::unexpected(SipiStatus::InternalError);
   }
+  const SipiImgInfo &info = st.info;
   if (info.success == SipiImgInfo::FAILURE) { return std::unexpected(SipiStatus::InternalError); }
 
   const size_t img_w = info.width;
   const size_t img_h = info.height;
+  flight_note("image_width", static_cast<std::uint64_t>(img_w));
+  flight_note("image_height", static_cast<std::uint64_t>(img_h));
 
   size_t tmp_r_w{ 0 }, tmp_r_h{ 0 };
   int tmp_red{ 0 };
   bool tmp_ro{ false };
   try {
-    size->get_size(img_w, img_h, tmp_r_w, tmp_r_h, tmp_red, tmp_ro);
+    st.size->get_size(img_w, img_h, tmp_r_w, tmp_r_h, tmp_red, tmp_ro);
   } catch (Sipi::SipiSizeError &) {
     return std::unexpected(SipiStatus::BadRequest);
   } catch (Sipi::SipiError &) {
@@ -519,12 +889,14 @@ std::expected<ServeResponse, SipiStatus>
   } catch (Sipi::SipiError &) {
     return std::unexpected(SipiStatus::BadRequest);
   }
-  if (!restricted_size->undefined() && (*size > *restricted_size)) { size = restricted_size; }
+  if (!restricted_size->undefined() && (*st.size > *restricted_size)) { st.size = restricted_size; }
+  const auto &region = st.region;
+  const auto &size = st.size;
 
   // Canonical URL (Link header + cache key). The Link header honours
   // X-Forwarded-Proto (SIPI serves plain HTTP behind Traefik); the cache key
   // stays scheme-free so an http and an https request share one cache entry.
-  const std::string cannonical_watermark = watermark.empty() ? "0" : "1";
+  const std::string cannonical_watermark = st.watermark.empty() ? "0" : "1";
   const char *forwarded_proto = req.forwarded_proto;
   const std::string scheme =
     (forwarded_proto != nullptr && *forwarded_proto != '\0') ? std::string(forwarded_proto) : std::string("http");
@@ -539,62 +911,89 @@ std::expected<ServeResponse, SipiStatus>
   const std::string canonical_header = canonical_info.first;
   // The Canonical URL used verbatim as the Cache key (this serve path adds no
   // watermark suffix); `SipiCache` keys its table by this string.
-  const std::string cache_key = canonical_info.second;
-  const char *content_type = content_type_for(quality_format.format());
-
-  auto base_headers = [&] {
-    std::vector<Header> h;
-    h.emplace_back("Cache-Control", kCacheControl);
-    // IIIF Image API 3.0 profileLinkHeader (advertised in info.json's extraFeatures):
-    // fold the profile Link into the canonical Link's value (one header) — the Rust
-    // response sink is last-write-wins per header name, so two separate "Link"
-    // entries would drop one.
-    h.emplace_back("Link", canonical_header + R"(, <http://iiif.io/api/image/3/level2.json>;rel="profile")");
-    if (content_type != nullptr) { h.emplace_back("Content-Type", content_type); }
-    return h;
-  };
+  st.cache_key = canonical_info.second;
+  st.content_type = content_type_for(quality_format.format());
+
+  st.headers.emplace_back("Cache-Control", kCacheControl);
+  // IIIF Image API 3.0 profileLinkHeader (advertised in info.json's extraFeatures):
+  // fold the profile Link into the canonical Link's value (one header) — the Rust
+  // response sink is last-write-wins per header name, so two separate "Link"
+  // entries would drop one.
+  st.headers.emplace_back("Link", canonical_header + R"(, <http://iiif.io/api/image/3/level2.json>;rel="profile")");
+  if (st.content_type != nullptr) { st.headers.emplace_back("Content-Type", st.content_type); }
 
   // HEAD: headers only — no decode, no cache write (also closes the legacy
   // zero-byte-HEAD cache bug, DEV-6660).
   if (req.is_head != 0) {
-    ServeResponse out;
-    out.http_status = 200;
-    out.headers = base_headers();
-    out.body = EmptyBody{};
-    return out;
+    st.route = SIPI_PLAN_HEAD;
+    return ServePlan(std::move(plan));
   }
 
   // Direct passthrough: the request maps 1:1 onto the source file.
   if (region->getType() == SipiRegion::FULL && size->getType() == SipiSize::FULL && angle == 0.0 && !mirror
-      && watermark.empty() && quality_format.format() == in_format
+      && st.watermark.empty() && quality_format.format() == in_format
       && quality_format.quality() == SipiQualityFormat::DEFAULT) {
-    auto body = full_file_body(infile);
-    if (!body) { return std::unexpected(body.error()); }
-    ServeResponse out;
-    out.http_status = 200;
-    out.headers = base_headers();
-    out.body = std::move(*body);
-    return out;
+    st.route = SIPI_PLAN_PASSTHROUGH;
+    return ServePlan(std::move(plan));
   }
 
-  // Cache hit (never for watermarked output): pin the file, serve it, unpin when
-  // the body has been delivered.
+  // Cache hit (never for watermarked output): pin the file now; it stays pinned
+  // until the body has been delivered, or until the plan is dropped unserved.
   if (eng.cache != nullptr) {
-    const std::string cachefile = eng.cache->check(infile, cache_key, true);
+    std::string cachefile = eng.cache->check(infile, st.cache_key, true);
+    flight_note("cache", std::string(cachefile.empty() ? "miss" : "hit"));
     if (!cachefile.empty()) {
       log_debug("Using cachefile %s", cachefile.c_str());
-      SipiCache *cache = eng.cache;
-      auto body = full_file_body(cachefile);
-      if (!body) {
-        cache->deblock(cachefile);// pinned by check(); release it before bailing
-        return std::unexpected(body.error());
+      st.route = SIPI_PLAN_CACHE_HIT;
+      st.cache = eng.cache;
+      st.cachefile = std::move(cachefile);
+      return ServePlan(std::move(plan));
+    }
+  }
+
+  // Compressed-domain copy: JP2 or TIFF in and out, a tile-aligned Region at a
+  // reduce-only Size, no quality/rotation/watermark change. The source's
+  // code-blocks (JP2) or compressed tiles (TIFF) are copied without decoding
+  // any pixels, so the request is I/O-bound and takes no decode-memory
+  // reservation.
+  if ((in_format == SipiQualityFormat::JP2 || in_format == SipiQualityFormat::TIF)
+      && quality_format.format() == in_format && angle == 0.0 && !mirror && st.watermark.empty()
+      && quality_format.quality() == SipiQualityFormat::DEFAULT) {
+    try {
+      if (const auto r = reduce_only_region(info, *region, *size)) {
+        st.copy = plan_compressed_copy(in_format, infile, *r);
+      }
+    } catch (Sipi::SipiSizeError &) {
+      // leave the Size error to the decode path's own handling
+    }
+    if (!std::holds_alternative<std::monostate>(st.copy)) {
+      st.route = SIPI_PLAN_COPY;
+      return ServePlan(std::move(plan));
+    }
+  }
+
+  // A flat source (no resolution levels) that has become hot is decoded from its
+  // shadow pyramid once the background builder has written one; the response,
+  // cache entry and error reports still name the original.
+  st.decode_file = infile;
+  st.decode_format = in_format;
+  st.decode_clevels = info.clevels;
+  if (eng.shadow_pyramids != nullptr && is_flat_source(in_format, info)) {
+    if (const auto shadow = eng.shadow_pyramids->lookup(infile, info)) {
+      try {
+        SipiImage probe;
+        const SipiImgInfo shadow_info = probe.read_shape(*shadow);
+        if (shadow_info.success != SipiImgInfo::FAILURE && shadow_info.width == info.width
+            && shadow_info.height == info.height) {
+          st.decode_file = *shadow;
+          st.decode_format = SipiQualityFormat::TIF;
+          st.decode_clevels = shadow_info.clevels;
+          Metrics::instance().shadow_pyramid_hits_total.Increment();
+          flight_note("decode_file", st.decode_file);
+        }
+      } catch (const SipiImageError &err) {
+        log_warn("Ignoring unreadable shadow pyramid %s: %s", shadow->c_str(), err.to_string().c_str());
       }
-      ServeResponse out;
-      out.http_status = 200;
-      out.headers = base_headers();
-      out.body = std::move(*body);
-      out.on_complete = [cache, cachefile] { cache->deblock(cachefile); };
-      return out;
     }
   }
 
@@ -602,24 +1001,181 @@ std::expected<ServeResponse, SipiStatus>
   // handed back over the seam accumulator into the shell's OTLP histogram —
   // independently of whether the budget is enforced: the estimate describes the
   // request, not the budget feature.
-  const auto ddims = compute_decode_dims(img_w, img_h, info.clevels, region, size);
-  const bool needs_icc = quality_format.quality() == SipiQualityFormat::COLOR
-                         || quality_format.quality() == SipiQualityFormat::GRAY;
-  const size_t estimated = estimate_peak_memory(
-    ddims.width, ddims.height, ddims.out_w, ddims.out_h, info.nc, info.bps, static_cast<double>(angle), needs_icc);
+  st.ddims = compute_decode_dims(img_w, img_h, st.decode_clevels, region, size);
+  const auto &ddims = st.ddims;
+  st.needs_icc = quality_format.quality() == SipiQualityFormat::COLOR
+                 || quality_format.quality() == SipiQualityFormat::GRAY;
+  // PNG decodes row by row inside the Region (and, with the HIGH resampler,
+  // scales while streaming), so it has its own model.
+  st.static_estimate =
+    st.decode_format == SipiQualityFormat::PNG
+      ? estimate_peak_memory_png(img_w, ddims.width, ddims.height, ddims.out_w, ddims.out_h, info.nc, info.bps,
+          static_cast<double>(angle), st.needs_icc, eng.scaling_quality.png == ScalingMethod::HIGH)
+      : estimate_peak_memory(ddims.width, ddims.height, ddims.out_w, ddims.out_h, info.nc, info.bps,
+          static_cast<double>(angle), st.needs_icc);
+  // The model sizes the pixel buffers only; the codecs' working memory on top
+  // of them is learned from measured decodes of the same kind.
+  st.calibration_key = calibration_key(st.decode_format,
+    ddims,
+    mirror || angle != 0.0F,
+    quality_format.quality() != SipiQualityFormat::DEFAULT);
+  st.estimated = eng.peak_calibration != nullptr
+                   ? eng.peak_calibration->corrected(st.calibration_key, st.static_estimate)
+                   : st.static_estimate;
+  st.full_lane = st.estimated >= eng.large_decode_threshold_bytes;
+  serve_timings_set_decode_estimate(static_cast<std::uint64_t>(st.estimated));
+  flight_note("reduce", static_cast<std::uint64_t>(std::max(ddims.reduce, 0)));
+  flight_note("decode_width", static_cast<std::uint64_t>(ddims.width));
+  flight_note("decode_height", static_cast<std::uint64_t>(ddims.height));
+  flight_note("output_width", static_cast<std::uint64_t>(ddims.out_w));
+  flight_note("output_height", static_cast<std::uint64_t>(ddims.out_h));
+  flight_note("estimate_bytes", static_cast<std::uint64_t>(st.estimated));
+  flight_note("full_lane", std::uint64_t{ st.full_lane ? 1U : 0U });
+  st.route = SIPI_PLAN_DECODE;
+  return ServePlan(std::move(plan));
+}
 
+std::expected<ServeResponse, SipiStatus> execute_plan(ServePlan plan,
+  const EngineContext &eng,
+  const std::function<bool()> &cancelled,
+  SipiReportErrorFn report_error,
+  void *report_ctx)
+{
+  ServePlan::State &st = plan.state();
+  const std::string &infile = st.infile;
+  const std::string &uri = st.uri;
+  SipiQualityFormat &quality_format = st.quality_format;
+  const float angle = st.angle;
+  const bool mirror = st.mirror;
+  flight_note("route", std::string(route_name(st.route)));
+
+  switch (st.route) {
+  case SIPI_PLAN_HEAD: {
+    ServeResponse out;
+    out.http_status = 200;
+    out.headers = std::move(st.headers);
+    out.body = EmptyBody{};
+    return out;
+  }
+  case SIPI_PLAN_PASSTHROUGH: {
+    auto body = full_file_body(infile);
+    if (!body) { return std::unexpected(body.error()); }
+    record_file_body(st.in_format, SIPI_DECODE_PATH_PASSTHROUGH, *body);
+    ServeResponse out;
+    out.http_status = 200;
+    out.headers = std::move(st.headers);
+    out.body = std::move(*body);
+    return out;
+  }
+  case SIPI_PLAN_CACHE_HIT: {
+    auto body = full_file_body(st.cachefile);
+    if (!body) { return std::unexpected(body.error()); }// the plan's destructor releases the pin
+    record_file_body(st.in_format, SIPI_DECODE_PATH_CACHE_HIT, *body);
+    ServeResponse out;
+    out.http_status = 200;
+    out.headers = std::move(st.headers);
+    out.body = std::move(*body);
+    // The pin moves from the plan to the response: released once the body is delivered.
+    out.on_complete = [cache = st.cache, cachefile = std::exchange(st.cachefile, std::string())] {
+      cache->deblock(cachefile);
+    };
+    return out;
+  }
+  case SIPI_PLAN_COPY: {
+    auto cachefile = new_cache_file(eng.cache);
+    if (!cachefile) { return std::unexpected(cachefile.error()); }
+    log_debug("GET %s: compressed-domain copy, no decode", uri.c_str());
+    serve_timings_set_decode_path(format_type(st.in_format), SIPI_DECODE_PATH_COPY);
+    ServeResponse out;
+    out.http_status = 200;
+    out.headers = std::move(st.headers);
+    out.body = StreamBody{ std::make_unique<ImageEncodeProducer>(SipiImage{},
+      quality_format.format(),
+      eng.jpeg_quality,
+      eng.cache,
+      std::move(*cachefile),
+      infile,
+      st.cache_key,
+      uri,
+      st.info,
+      std::nullopt,
+      report_error,
+      report_ctx,
+      std::move(st.copy)) };
+    return out;
+  }
+  case SIPI_PLAN_DECODE:
+    break;
+  }
+
+  const auto &ddims = st.ddims;
+  const size_t estimated = st.estimated;
   auto &metrics = Metrics::instance();
-  serve_timings_set_decode_estimate(static_cast<std::uint64_t>(estimated));
+
+  // Small JPEG renderings of a JPEG2000 source need not decode every quality
+  // layer; the other readers ignore the share.
+  const bool jpeg_out = quality_format.format() == SipiQualityFormat::JPG;
+  ScalingQuality scaling_quality = eng.scaling_quality;
+  scaling_quality.j2k_layer_percent = j2k_layer_percent(static_cast<uint32_t>(ddims.out_w),
+    static_cast<uint32_t>(ddims.out_h), jpeg_out ? eng.jpeg_quality : 0, eng.j2k_layer_truncation_size);
+  // A `gray` rendering of a colour JPEG2000 may decode only the luma component;
+  // the reader falls back to the full decode where that is not possible.
+  if (quality_format.quality() == SipiQualityFormat::GRAY) { scaling_quality.j2k_gray = eng.j2k_gray_decode; }
+
+  // A request with a deadline is rendered cheaper when the exact rendering
+  // would miss it: when the running decode rate predicts a decode longer than
+  // the time left, or when the full lane has no room for the exact estimate.
+  std::optional<DegradedRendering> degraded;
+  const auto degrade = [&] {
+    if (!degraded && st.deadline) {
+      auto cheaper = plan_degraded(DegradeInput{ .img_w = static_cast<std::size_t>(st.info.width),
+        .img_h = static_cast<std::size_t>(st.info.height),
+        .clevels = st.decode_clevels,
+        .nc = st.info.nc,
+        .bps = st.info.bps,
+        .region = st.region,
+        .size = st.size,
+        .ddims = ddims,
+        .estimated = estimated,
+        .angle = static_cast<double>(angle),
+        .needs_icc = st.needs_icc,
+        .decode_format = st.decode_format,
+        .out_format = quality_format.format(),
+        .scaling_quality = scaling_quality,
+        .jpeg_quality = eng.jpeg_quality });
+      if (cheaper.steps != 0) { degraded = std::move(cheaper); }
+    }
+    return degraded.has_value();
+  };
+  if (st.deadline && eng.decode_rate != nullptr) {
+    const auto predicted = eng.decode_rate->predict(estimated);
+    if (predicted && std::chrono::steady_clock::now() + *predicted > *st.deadline) { (void)degrade(); }
+  }
+  size_t charged = degraded ? degraded->estimated : estimated;
 
   // The full-lane memory budget accounts only full-lane decodes: those whose
   // estimated peak memory reaches the large-decode threshold. Tile decodes
   // (below the threshold) bypass the budget entirely and are never charged, so a
   // tile is never rejected for full-lane memory pressure.
   std::optional<MemoryBudgetGuard> budget_guard;
-  const bool is_full_lane = estimated >= eng.large_decode_threshold_bytes;
-  if (eng.memory_budget != nullptr && is_full_lane) {
-    const auto result = eng.memory_budget->try_acquire(estimated);
+  if (eng.memory_budget != nullptr && st.full_lane) {
+    // In advanced mode a request the full lane has no room for waits in the
+    // budget's queue. One with a deadline does not wait for its exact
+    // rendering: it queues for its cheaper one until the deadline instead.
+    const auto now = std::chrono::steady_clock::now();
+    auto result = eng.memory_budget->acquire(charged, st.deadline ? now : now + kMemoryBudgetWait, cancelled);
+    if (!result.allowed && st.deadline) {
+      if (degrade() && degraded->estimated < charged) { charged = degraded->estimated; }
+      result = eng.memory_budget->acquire(charged, *st.deadline, cancelled);
+    }
+    if (!result.allowed && cancelled()) {
+      metrics.client_disconnected_total.Increment();
+      return std::unexpected(SipiStatus::ClientGone);
+    }
+    record_memory_wait(result);
     metrics.decode_memory_used_bytes.Set(static_cast<double>(result.used));
+    flight_note("budget_charged_bytes", static_cast<std::uint64_t>(charged));
+    flight_note("budget_wait_ns", static_cast<std::uint64_t>(result.waited.count()));
 
     if (result.allowed && !result.over_budget) {
       metrics.decode_memory_acquired.Increment();
@@ -638,13 +1194,14 @@ std::expected<ServeResponse, SipiStatus>
       // exceeds the full-lane budget can never succeed — 413, no Retry-After.
       metrics.decode_memory_too_large_total.Increment();
       log_warn("Request estimate %zu exceeds full-lane budget %zu; rejecting (413): %s",
-        estimated, result.budget, uri.c_str());
+        charged, result.budget, uri.c_str());
       ServeResponse out;
       out.http_status = 413;
       out.body = EmptyBody{};
       return out;
     } else {
-      // ADVANCED, transient: the full lane is currently exhausted — 503 + Retry-After.
+      // ADVANCED, transient: the full lane stayed exhausted for as long as the
+      // request could wait — 503 + Retry-After.
       metrics.decode_memory_rejected.Increment();
       log_warn("Full-lane memory budget exhausted (advanced): %zu / %zu bytes, rejecting %s",
         result.used, result.budget, uri.c_str());
@@ -658,7 +1215,7 @@ std::expected<ServeResponse, SipiStatus>
     if (result.used > result.budget - result.budget / 5) { metrics.decode_memory_near_limit_total.Increment(); }
 
     SipiMemoryBudget *mb = eng.memory_budget;
-    budget_guard.emplace(*mb, estimated, result.allowed, [mb] {
+    budget_guard.emplace(*mb, charged, result.allowed, [mb] {
       Metrics::instance().decode_memory_used_bytes.Set(static_cast<double>(mb->used()));
     });
   }
@@ -668,36 +1225,81 @@ std::expected<ServeResponse, SipiStatus>
     return std::unexpected(SipiStatus::ClientGone);
   }
 
+  if (degraded) {
+    flight_note("degraded", degraded_header_value(degraded->steps));
+    metrics.decode_degraded_total.Increment();
+    log_info("GET %s: degraded rendering (%s) to meet its deadline",
+      uri.c_str(), degraded_header_value(degraded->steps).c_str());
+  }
+
+  // A full-lane decode of the exact rendering is measured against its static
+  // estimate, from here to the encode, for the calibration.
+  std::optional<PeakCalibration::Measurement> measurement;
+  if (eng.peak_calibration != nullptr && st.full_lane && !degraded && heap_reader_installed()) {
+    measurement.emplace(*eng.peak_calibration, st.calibration_key, st.static_estimate);
+  }
+
+  // The codecs poll `cancelled` between tiles, strips and row bands, so a
+  // client that leaves mid-decode releases the thread and the budget promptly.
   SipiImage img;
+  const auto decode_start = std::chrono::steady_clock::now();
+  DecodeReportScope decode_report;
   try {
     PhaseTimer phase_timer(SIPI_PHASE_DECODE);
-    img.read(infile, region, size, quality_format.format() == SipiQualityFormat::JPG, eng.scaling_quality);
+    const DecodeCancelScope cancel_scope(cancelled);
+    if (degraded) {
+      img.read(st.decode_file, st.region, degraded->decode_size, jpeg_out, degraded->scaling_quality);
+      if ((degraded->steps & kDegradeLevel) != 0) { img.scaleFast(degraded->out_w, degraded->out_h); }
+    } else {
+      img.read(st.decode_file, st.region, st.size, jpeg_out, scaling_quality);
+      if (eng.decode_rate != nullptr) {
+        eng.decode_rate->record(estimated, std::chrono::steady_clock::now() - decode_start);
+      }
+    }
+  } catch (const SipiImageClientAbortError &) {
+    Metrics::instance().decode_cancelled_total.Increment();
+    log_info("GET %s: decode cancelled, client gone", uri.c_str());
+    return decode_wasted(decode_start);
   } catch (const std::bad_alloc &) {
     Metrics::instance().memory_alloc_failures_total.Increment();
     ImageContext sentry_ctx;
     sentry_ctx.input_file = infile;
     sentry_ctx.file_size_bytes = get_file_size(infile);
-    report_image_error(req.report_error, req.report_ctx, "std::bad_alloc during image read", "read", sentry_ctx);
+    report_image_error(report_error, report_ctx, "std::bad_alloc during image read", "read", sentry_ctx);
     return std::unexpected(SipiStatus::InternalError);
   } catch (const SipiImageError &err) {
     ImageContext sentry_ctx;
     sentry_ctx.input_file = infile;
     sentry_ctx.file_size_bytes = get_file_size(infile);
     populate_from_image(sentry_ctx, img);
-    report_image_error(req.report_error, req.report_ctx, err.to_string(), "read", sentry_ctx);
+    report_image_error(report_error, report_ctx, err.to_string(), "read", sentry_ctx);
     return std::unexpected(SipiStatus::InternalError);
   } catch (const SipiSizeError &) {
     return std::unexpected(SipiStatus::BadRequest);
   }
 
+  // What the decode cost against what it delivered. A codec that reports
+  // nothing counts as having decoded the whole Region at its decode size, from
+  // the whole file; a shadow pyramid is a pyramid read whatever its level.
+  const std::uint64_t decoded_pixels =
+    decode_report.pixels() > 0 ? decode_report.pixels() : static_cast<std::uint64_t>(ddims.width * ddims.height);
+  const std::uint64_t source_bytes =
+    decode_report.bytes() > 0 ? decode_report.bytes() : static_cast<std::uint64_t>(get_file_size(st.decode_file));
+  const SipiDecodePath decode_path =
+    st.decode_file != infile ? SIPI_DECODE_PATH_PYRAMID : decode_path_label(decode_report.path());
+  serve_timings_set_decode_path(format_type(st.in_format), decode_path);
+  flight_note("decode_path", static_cast<std::uint64_t>(decode_path));
+  flight_note("decoded_pixels", decoded_pixels);
+
+  const bool converts = quality_format.quality() != SipiQualityFormat::DEFAULT;
+  shrink_reservation(budget_guard, img, mirror, static_cast<double>(angle), converts);
+
   if (mirror || angle != 0.0) {
-    if (cancelled()) {
-      Metrics::instance().client_disconnected_total.Increment();
-      return std::unexpected(SipiStatus::ClientGone);
-    }
+    if (cancelled()) { return decode_wasted(decode_start); }
     try {
       PhaseTimer phase_timer(SIPI_PHASE_ROTATE);
       img.rotate(angle, mirror);
+      shrink_reservation(budget_guard, img, false, 0.0, converts);
     } catch (const std::bad_alloc &) {
       Metrics::instance().memory_alloc_failures_total.Increment();
       return std::unexpected(SipiStatus::InternalError);
@@ -706,16 +1308,13 @@ std::expected<ServeResponse, SipiStatus>
       sentry_ctx.input_file = infile;
       sentry_ctx.file_size_bytes = get_file_size(infile);
       populate_from_image(sentry_ctx, img);
-      report_image_error(req.report_error, req.report_ctx, err.to_string(), "convert", sentry_ctx);
+      report_image_error(report_error, report_ctx, err.to_string(), "convert", sentry_ctx);
       return std::unexpected(SipiStatus::InternalError);
     }
   }
 
-  if (quality_format.quality() != SipiQualityFormat::DEFAULT) {
-    if (cancelled()) {
-      Metrics::instance().client_disconnected_total.Increment();
-      return std::unexpected(SipiStatus::ClientGone);
-    }
+  if (converts) {
+    if (cancelled()) { return decode_wasted(decode_start); }
     try {
       PhaseTimer phase_timer(SIPI_PHASE_QUALITY);
       switch (quality_format.quality()) {
@@ -723,7 +1322,14 @@ std::expected<ServeResponse, SipiStatus>
         img.convertToIcc(Icc(icc_sRGB), 8);
         break;
       case SipiQualityFormat::GRAY:
-        img.convertToIcc(Icc(icc_GRAY_D50), 8);
+        // A luminance-only JPEG2000 decode already delivers 8-bit gray, tagged
+        // with the gray profile whose tone curve its samples carry.
+        if (!(img.getNc() == 1 && img.getBps() == 8 && img.getPhoto() == PhotometricInterpretation::MINISBLACK
+              && img.getIcc() != nullptr
+              && (img.getIcc()->getProfileType() == icc_GRAY_D50
+                  || img.getIcc()->getProfileType() == icc_GRAY_sRGB))) {
+          img.convertToIcc(Icc(icc_GRAY_D50), 8);
+        }
         break;
       case SipiQualityFormat::BITONAL:
         img.toBitonal();
@@ -739,69 +1345,270 @@ std::expected<ServeResponse, SipiStatus>
       sentry_ctx.input_file = infile;
       sentry_ctx.file_size_bytes = get_file_size(infile);
       populate_from_image(sentry_ctx, img);
-      report_image_error(req.report_error, req.report_ctx, err.to_string(), "convert", sentry_ctx);
+      report_image_error(report_error, report_ctx, err.to_string(), "convert", sentry_ctx);
       return std::unexpected(SipiStatus::InternalError);
     }
   }
 
-  if (!watermark.empty()) {
-    if (cancelled()) {
-      Metrics::instance().client_disconnected_total.Increment();
-      return std::unexpected(SipiStatus::ClientGone);
-    }
+  if (!st.watermark.empty()) {
+    if (cancelled()) { return decode_wasted(decode_start); }
     try {
       PhaseTimer phase_timer(SIPI_PHASE_WATERMARK);
-      img.add_watermark(watermark);
+      img.add_watermark(st.watermark);
     } catch (Sipi::SipiError &err) {
       ImageContext sentry_ctx;
       sentry_ctx.input_file = infile;
       sentry_ctx.file_size_bytes = get_file_size(infile);
       populate_from_image(sentry_ctx, img);
-      report_image_error(req.report_error, req.report_ctx, err.to_string(), "convert", sentry_ctx);
+      report_image_error(report_error, report_ctx, err.to_string(), "convert", sentry_ctx);
       return std::unexpected(SipiStatus::InternalError);
     } catch (std::exception &err) {
       ImageContext sentry_ctx;
       sentry_ctx.input_file = infile;
       sentry_ctx.file_size_bytes = get_file_size(infile);
       populate_from_image(sentry_ctx, img);
-      report_image_error(req.report_error, req.report_ctx, err.what(), "convert", sentry_ctx);
+      report_image_error(report_error, report_ctx, err.what(), "convert", sentry_ctx);
       return std::unexpected(SipiStatus::InternalError);
     }
     log_info("GET %s: adding watermark", uri.c_str());
   }
 
-  if (cancelled()) {
-    Metrics::instance().client_disconnected_total.Increment();
-    return std::unexpected(SipiStatus::ClientGone);
+  if (measurement) {
+    const size_t measured = measurement->finish();
+    if (measured > 0) {
+      metrics.decode_memory_calibration_samples_total.Increment();
+      metrics.decode_memory_calibration_factor_max_percent.Set(100.0 * eng.peak_calibration->max_factor());
+      serve_timings_set_measured_peak(static_cast<std::uint64_t>(measured));
+    }
   }
 
-  // Cache file: probe writability now (a 500 here is still pre-commit), then let
-  // the producer's TeeSink fill it during the encode.
-  std::string cachefile;
-  if (eng.cache != nullptr) {
-    cachefile = eng.cache->getNewCacheFileName();
-    std::ofstream probe(cachefile, std::ofstream::out | std::ofstream::binary | std::ofstream::trunc);
-    if (probe.fail()) { return std::unexpected(SipiStatus::InternalError); }
+  if (cancelled()) { return decode_wasted(decode_start); }
+
+  const std::uint64_t output_pixels =
+    static_cast<std::uint64_t>(img.getNx()) * static_cast<std::uint64_t>(img.getNy());
+  serve_timings_set_decoded(decoded_pixels, output_pixels, source_bytes);
+  metrics.decoded_pixels_total.Increment(static_cast<double>(decoded_pixels));
+  metrics.decode_output_pixels_total.Increment(static_cast<double>(output_pixels));
+  if (eng.decode_amplification != nullptr) { eng.decode_amplification->record(infile, decoded_pixels, output_pixels); }
+
+  // The encode reads the final buffer as it streams; only the TIFF writer
+  // builds the whole file in memory beside it.
+  if (budget_guard) {
+    const size_t live = img.getPixelBytes();
+    budget_guard->shrink_to(quality_format.format() == SipiQualityFormat::TIF ? 2 * live : live);
   }
 
-  if (content_type == nullptr) { return std::unexpected(SipiStatus::BadRequest); }
+  // Cache file: probe writability now (a 500 here is still pre-commit), then let
+  // the producer's TeeSink fill it during the encode. A degraded rendering is
+  // never cached, here or downstream.
+  SipiCache *cache = degraded ? nullptr : eng.cache;
+  auto cachefile = new_cache_file(cache);
+  if (!cachefile) { return std::unexpected(cachefile.error()); }
+
+  if (st.content_type == nullptr) { return std::unexpected(SipiStatus::BadRequest); }
 
   ServeResponse out;
   out.http_status = 200;
-  out.headers = base_headers();
+  out.headers = std::move(st.headers);
+  if (degraded) {
+    for (auto &[name, value] : out.headers) {
+      if (name == "Cache-Control") { value = "no-store"; }
+    }
+    out.headers.emplace_back(kDegradedHeader, degraded_header_value(degraded->steps));
+  }
   out.body = StreamBody{ std::make_unique<ImageEncodeProducer>(std::move(img),
     quality_format.format(),
-    eng.jpeg_quality,
-    eng.cache,
-    std::move(cachefile),// the only non-const local here; infile/cache_key/uri are const, so copied
+    degraded ? degraded->jpeg_quality : eng.jpeg_quality,
+    cache,
+    std::move(*cachefile),
     infile,
-    cache_key,
+    st.cache_key,
     uri,
-    info,
+    st.info,
     std::move(budget_guard),
-    req.report_error,
-    req.report_ctx) };
+    report_error,
+    report_ctx) };
   return out;
 }
 
+
+std::expected<ServeResponse, SipiStatus>
+  build_image_response(const SipiServeRequest &req, const EngineContext &eng, const std::function<bool()> &cancelled)
+{
+  auto plan = plan_image(req, eng);
+  if (!plan) { return std::unexpected(plan.error()); }
+  return execute_plan(std::move(*plan), eng, cancelled, req.report_error, req.report_ctx);
+}
+
+SipiStatus render_tiles(const std::string &infile,
+  std::span<const SipiIiifParams> tiles,
+  const std::string &restricted_size,
+  const std::string &watermark,
+  const EngineContext &eng,
+  const TileEmit &emit)
+{
+  if (access(infile.c_str(), R_OK) != 0) { return SipiStatus::NotFound; }
+
+  SipiImgInfo info;
+  try {
+    SipiImage probe;
+    info = probe.read_shape(infile);
+  } catch (const SipiImageError &err) {
+    log_err("Cannot read the shape of %s: %s", infile.c_str(), err.to_string().c_str());
+    return SipiStatus::InternalError;
+  }
+  const auto img_w = static_cast<size_t>(info.width);
+  const auto img_h = static_cast<size_t>(info.height);
+
+  // The preflight's size restriction caps every tile as it caps a single
+  // request; one the image cannot be sized to fails the batch like it.
+  if (!restricted_size.empty()) {
+    try {
+      size_t w = 0, h = 0;
+      int red = 0;
+      bool ro = false;
+      SipiSize(restricted_size).get_size(img_w, img_h, w, h, red, ro);
+    } catch (const SipiSizeError &) {
+      return SipiStatus::BadRequest;
+    } catch (const SipiError &) {
+      return SipiStatus::BadRequest;
+    }
+  }
+
+  // Sort out the tiles that cannot be served before anything is decoded, and
+  // size the batch: one decode-memory reservation covers its largest tile, and
+  // the JPEG2000 layer share and gray hint apply to the batch as a whole.
+  std::vector<SipiTileRequest> requests;
+  std::vector<std::size_t> request_index;
+  std::vector<std::size_t> rejected;
+  size_t estimated = 0;
+  bool all_jpeg = true;
+  bool all_gray = true;
+  uint8_t layer_percent = 0;
+  for (std::size_t i = 0; i < tiles.size(); ++i) {
+    const SipiIiifParams &p = tiles[i];
+    const auto format = static_cast<SipiQualityFormat::FormatType>(p.format_type);
+    if (content_type_for(format) == nullptr) {
+      rejected.push_back(i);
+      continue;
+    }
+    auto region = rebuild_region(p);
+    auto size = rebuild_size(p);
+    DecodeDims ddims;
+    try {
+      size_t w = 0, h = 0;
+      int red = 0;
+      bool ro = false;
+      size->get_size(img_w, img_h, w, h, red, ro);
+      if (!restricted_size.empty()) {
+        auto restricted = std::make_shared<SipiSize>(restricted_size);
+        restricted->get_size(img_w, img_h, w, h, red, ro);
+        if (*size > *restricted) { size = std::move(restricted); }
+      }
+      ddims = compute_decode_dims(img_w, img_h, info.clevels, region, size);
+    } catch (const SipiSizeError &) {
+      rejected.push_back(i);
+      continue;
+    } catch (const SipiError &) {
+      rejected.push_back(i);
+      continue;
+    }
+    const auto quality = static_cast<SipiQualityFormat::QualityType>(p.quality_type);
+    const bool needs_icc = quality == SipiQualityFormat::COLOR || quality == SipiQualityFormat::GRAY;
+    estimated = std::max(estimated,
+      estimate_peak_memory(ddims.width, ddims.height, ddims.out_w, ddims.out_h, info.nc, info.bps,
+        static_cast<double>(p.rotation), needs_icc));
+    const bool jpeg_out = format == SipiQualityFormat::JPG;
+    const uint8_t percent = j2k_layer_percent(static_cast<uint32_t>(ddims.out_w),
+      static_cast<uint32_t>(ddims.out_h), jpeg_out ? eng.jpeg_quality : 0, eng.j2k_layer_truncation_size);
+    // 0 decodes every layer, so one such tile decides for the batch.
+    if (requests.empty()) {
+      layer_percent = percent;
+    } else if (layer_percent != 0) {
+      layer_percent = percent == 0 ? 0 : std::max(layer_percent, percent);
+    }
+    all_jpeg = all_jpeg && jpeg_out;
+    all_gray = all_gray && quality == SipiQualityFormat::GRAY;
+    requests.push_back(SipiTileRequest{ std::move(region), std::move(size) });
+    request_index.push_back(i);
+  }
+
+  std::optional<MemoryBudgetGuard> budget_guard;
+  if (eng.memory_budget != nullptr && estimated >= eng.large_decode_threshold_bytes) {
+    auto &metrics = Metrics::instance();
+    const auto result = eng.memory_budget->acquire(estimated, std::chrono::steady_clock::now() + kMemoryBudgetWait);
+    record_memory_wait(result);
+    metrics.decode_memory_used_bytes.Set(static_cast<double>(result.used));
+    if (!result.allowed) {
+      if (result.exceeds_budget_alone) {
+        metrics.decode_memory_too_large_total.Increment();
+      } else {
+        metrics.decode_memory_rejected.Increment();
+      }
+      log_warn("Tile batch estimate %zu does not fit the full-lane budget (%zu / %zu in use): %s",
+        estimated, result.used, result.budget, infile.c_str());
+      return SipiStatus::ServiceUnavailable;
+    }
+    metrics.decode_memory_acquired.Increment();
+    SipiMemoryBudget *mb = eng.memory_budget;
+    budget_guard.emplace(*mb, estimated, result.allowed, [mb] {
+      Metrics::instance().decode_memory_used_bytes.Set(static_cast<double>(mb->used()));
+    });
+  }
+
+  try {
+    for (const std::size_t i : rejected) {
+      if (!emit(i, SipiStatus::BadRequest, {})) { throw TileBatchStopped{}; }
+    }
+
+    ScalingQuality scaling_quality = eng.scaling_quality;
+    scaling_quality.j2k_layer_percent = layer_percent;
+    if (all_gray) { scaling_quality.j2k_gray = eng.j2k_gray_decode; }
+
+    std::size_t done = 0;
+    // The decode failed part-way: the tiles not yet delivered are reported failed.
+    const auto fail_rest = [&](SipiStatus status) {
+      for (std::size_t n = done; n < requests.size(); ++n) {
+        if (!emit(request_index[n], status, {})) { throw TileBatchStopped{}; }
+      }
+    };
+    try {
+      SipiImage::read_tiles(
+        infile,
+        requests,
+        [&](std::size_t n, SipiImage &img) {
+          const std::size_t i = request_index[n];
+          std::vector<std::uint8_t> encoded;
+          SipiStatus status = SipiStatus::Ok;
+          try {
+            encode_tile(img, tiles[i], watermark, eng.jpeg_quality, encoded);
+          } catch (const SipiImageError &err) {
+            log_err("Cannot encode tile %zu of %s: %s", i, infile.c_str(), err.to_string().c_str());
+            status = SipiStatus::InternalError;
+          } catch (const SipiError &err) {
+            log_err("Cannot encode tile %zu of %s: %s", i, infile.c_str(), err.to_string().c_str());
+            status = SipiStatus::InternalError;
+          } catch (const std::exception &err) {
+            log_err("Cannot encode tile %zu of %s: %s", i, infile.c_str(), err.what());
+            status = SipiStatus::InternalError;
+          }
+          done = n + 1;
+          if (status != SipiStatus::Ok) { encoded.clear(); }
+          if (!emit(i, status, encoded)) { throw TileBatchStopped{}; }
+        },
+        all_jpeg,
+        scaling_quality);
+    } catch (const SipiImageError &err) {
+      log_err("Cannot decode tiles of %s: %s", infile.c_str(), err.to_string().c_str());
+      fail_rest(SipiStatus::InternalError);
+    } catch (const SipiSizeError &) {
+      fail_rest(SipiStatus::BadRequest);
+    }
+  } catch (const TileBatchStopped &) {
+    Metrics::instance().client_disconnected_total.Increment();
+    return SipiStatus::ClientGone;
+  }
+  return SipiStatus::Ok;
+}
+
 }// namespace Sipi::ffi
@@ -15,12 +15,27 @@
  * `FileBody` (cache hit or direct passthrough → `sendFile`) or a `StreamBody`
  * whose producer runs only the encode (the rarely-failing tail), teeing to the
  * cache file with the DEV-6660 integrity guard.
+ *
+ * The same pipeline is available in two steps. `plan_image` runs everything up
+ * to the first pixel — shape lookup, size math, canonical URL, cache probe,
+ * compressed-copy check, shadow lookup and the exact decode-memory estimate —
+ * and `execute_plan` runs the rest, so a caller can admit the request on the
+ * engine's own numbers in between (`sipi_plan_image`).
+ *
+ * `render_tiles` renders a batch of IIIF requests of one image against a single
+ * open source (`SipiImage::read_tiles`) and hands each encoded tile to a
+ * callback — the multi-tile path for viewers and cache-warm jobs.
  */
 #ifndef SIPI_FFI_SERVE_IMAGE_H
 #define SIPI_FFI_SERVE_IMAGE_H
 
+#include <cstddef>
+#include <cstdint>
 #include <expected>
 #include <functional>
+#include <memory>
+#include <span>
+#include <string>
 
 #include "ffi/engine_context.h"
 #include "ffi/serve_response.h"
@@ -28,6 +43,50 @@
 
 namespace Sipi::ffi {
 
+/*! An IIIF image request planned up to its first pixel by `plan_image`.
+ *  Move-only. A cache-hit plan keeps its cache file pinned until it is executed
+ *  or destroyed. */
+class ServePlan
+{
+public:
+  struct State;//!< the planned request (serve_image.cpp)
+
+  explicit ServePlan(std::unique_ptr<State> state);
+  ServePlan(ServePlan &&) noexcept;
+  ServePlan &operator=(ServePlan &&) noexcept;
+  ~ServePlan();
+
+  /*! How the request will be served. */
+  [[nodiscard]] SipiPlanRoute route() const;
+
+  /*! Peak decode memory of a `SIPI_PLAN_DECODE` plan; 0 for the other routes. */
+  [[nodiscard]] std::size_t decode_estimate() const;
+
+  /*! Whether the decode estimate reaches the large-decode threshold, i.e. the
+   *  request belongs to the full lane and is charged to the memory budget. */
+  [[nodiscard]] bool full_lane() const;
+
+  [[nodiscard]] State &state() { return *state_; }
+
+private:
+  std::unique_ptr<State> state_;
+};
+
+/*! Plan an IIIF image request without decoding it. Fails with the status the
+ *  caller renders (404 missing, 400 bad size, 500 unreadable shape). Probing the
+ *  cache pins a hit, and a shadow-pyramid lookup counts as a decode of the
+ *  source, exactly as in `build_image_response`. */
+[[nodiscard]] std::expected<ServePlan, SipiStatus> plan_image(const SipiServeRequest &req, const EngineContext &eng);
+
+/*! Run a plan: charge the memory budget, decode, transform, and return the
+ *  response as `build_image_response` would. Handled decode errors are reported
+ *  through `report_error` (may be NULL). */
+[[nodiscard]] std::expected<ServeResponse, SipiStatus> execute_plan(ServePlan plan,
+  const EngineContext &eng,
+  const std::function<bool()> &cancelled,
+  SipiReportErrorFn report_error,
+  void *report_ctx);
+
 /*! Build the response for an IIIF image request. Reads engine services + config
  *  from `eng`. `cancelled` is polled between the decode stages to abort when the
  *  client has disconnected — pass `[]{ return false; }` in tests.
@@ -36,6 +95,28 @@ namespace Sipi::ffi {
 [[nodiscard]] std::expected<ServeResponse, SipiStatus>
   build_image_response(const SipiServeRequest &req, const EngineContext &eng, const std::function<bool()> &cancelled);
 
+/*! Receives tile `index` of a `render_tiles` batch: `Ok` with its encoded
+ *  bytes, or the status it would have been served with and no bytes. The bytes
+ *  are valid only for the call. Returns false to stop the batch. */
+using TileEmit = std::function<bool(std::size_t index, SipiStatus status, std::span<const std::uint8_t> bytes)>;
+
+/*! Render every request in `tiles` from the image `infile` (an already
+ *  validated path) with one open decoder, and report each index exactly once
+ *  through `emit`: tiles with an unsupported format or an invalid size first,
+ *  then the rest in request order as they are decoded and encoded. The
+ *  preflight's `restricted_size` caps and its `watermark` marks every tile as
+ *  they would a single request (empty = none). The batch reserves decode
+ *  memory for its largest tile. Returns `Ok` once every tile was reported;
+ *  `NotFound`, `BadRequest` (a restriction the image cannot be sized to),
+ *  `InternalError` (unreadable shape) or `ServiceUnavailable` (budget
+ *  exhausted) before any tile; `ClientGone` when `emit` stopped the batch. */
+[[nodiscard]] SipiStatus render_tiles(const std::string &infile,
+  std::span<const SipiIiifParams> tiles,
+  const std::string &restricted_size,
+  const std::string &watermark,
+  const EngineContext &eng,
+  const TileEmit &emit);
+
 }// namespace Sipi::ffi
 
 #endif// SIPI_FFI_SERVE_IMAGE_H
@@ -6,20 +6,35 @@
 // Co-located unit tests (ADR-0003) for the transport-pure IIIF response builder,
 // build_image_response. Because it takes only (request, engine context, cancel
 // predicate) it runs without a socket: the body shape (FileBody / StreamBody /
-// EmptyBody) and the pre-commit status codes are checked directly.
+// EmptyBody) and the pre-commit status codes are checked directly. The batch
+// renderer, render_tiles, is checked the same way through its emit callback.
 
 #include "gtest/gtest.h"
 
+#include <atomic>
+#include <chrono>
 #include <climits>
+#include <cstddef>
+#include <cstdint>
 #include <cstdlib>
+#include <fstream>
 #include <functional>
+#include <span>
 #include <string>
+#include <utility>
 #include <variant>
+#include <vector>
 
+#include "SipiImage.h"
+#include "ffi/decode_amplification.h"
+#include "ffi/degraded_render.h"
 #include "ffi/engine_context.h"
 #include "ffi/serve_image.h"
 #include "ffi/serve_response.h"
+#include "ffi/serve_timings.h"
 #include "ffi/sipi_ffi.h"
+#include "throttling/SipiMemoryBudget.h"
+#include "throttling/SipiPeakCalibration.h"
 #include "test_paths.h"
 
 namespace {
@@ -107,6 +122,24 @@ void collect_report(void *ctx, const SipiImageErrorReport *err)
   out->input_file = err->input_file != nullptr ? err->input_file : "";
 }
 
+// A 200-px-wide JPEG of the 512-px JPEG2000 fixture: the exact rendering
+// scales the 256-px level down, a degraded one upscales the 128-px level.
+SipiServeRequest j2k_thumbnail(const std::string &path)
+{
+  auto params = full_params(SIPI_FORMAT_JPG);
+  params.size_type = SIPI_SIZE_PIXELS_X;
+  params.size_nx = 200;
+  return make_request(path, params);
+}
+
+const std::string *find_header(const ServeResponse &r, const std::string &name)
+{
+  for (const auto &[n, v] : r.headers) {
+    if (n == name) { return &v; }
+  }
+  return nullptr;
+}
+
 }// namespace
 
 TEST(BuildImageResponse, MissingFileIsNotFound)
@@ -210,3 +243,310 @@ TEST(BuildImageResponse, ReportErrorNullCallbackIsSafeNoOp)
   ASSERT_FALSE(result.has_value());
   EXPECT_EQ(result.error(), SipiStatus::InternalError);
 }
+
+TEST(RenderTiles, EveryTileIsReportedOnceRejectedFirst)
+{
+  // Two valid tiles around an unsupported output format: the rejected tile is
+  // reported first, the decoded ones follow in request order with their bytes.
+  auto tile = full_params(SIPI_FORMAT_PNG);
+  tile.region_type = SIPI_REGION_COORDS;
+  tile.region[0] = 0.F;
+  tile.region[1] = 0.F;
+  tile.region[2] = 256.F;
+  tile.region[3] = 256.F;
+  auto reduced = tile;
+  reduced.format_type = SIPI_FORMAT_JPG;
+  reduced.size_type = SIPI_SIZE_PIXELS_X;
+  reduced.size_nx = 128;
+  auto unsupported = tile;
+  unsupported.format_type = SIPI_FORMAT_UNSUPPORTED;
+  const std::vector<SipiIiifParams> tiles = { tile, unsupported, reduced };
+
+  std::vector<std::pair<std::size_t, SipiStatus>> seen;
+  const auto status = render_tiles(fixture("/unit/lena512.tif"),
+    tiles,
+    {},
+    {},
+    bare_engine(),
+    [&](std::size_t i, SipiStatus st, std::span<const std::uint8_t> bytes) {
+      seen.emplace_back(i, st);
+      EXPECT_EQ(st == SipiStatus::Ok, !bytes.empty()) << "tile " << i;
+      return true;
+    });
+  EXPECT_EQ(status, SipiStatus::Ok);
+  const std::vector<std::pair<std::size_t, SipiStatus>> expected = {
+    { 1, SipiStatus::BadRequest }, { 0, SipiStatus::Ok }, { 2, SipiStatus::Ok }
+  };
+  EXPECT_EQ(seen, expected);
+}
+
+TEST(RenderTiles, StoppingTheBatchIsClientGone)
+{
+  const std::vector<SipiIiifParams> tiles(3, full_params(SIPI_FORMAT_PNG));
+  int calls = 0;
+  const auto status = render_tiles(fixture("/unit/lena512.tif"),
+    tiles,
+    {},
+    {},
+    bare_engine(),
+    [&](std::size_t, SipiStatus, std::span<const std::uint8_t>) { return ++calls < 2; });
+  EXPECT_EQ(status, SipiStatus::ClientGone);
+  EXPECT_EQ(calls, 2);
+}
+
+// The shape of an encoded tile, through a scratch file.
+Sipi::SipiImgInfo tile_shape(std::span<const std::uint8_t> bytes, const std::string &name)
+{
+  const std::string path = sipi::test::tmp_dir() + "/" + name;
+  std::ofstream(path, std::ios::binary).write(reinterpret_cast<const char *>(bytes.data()), bytes.size());
+  Sipi::SipiImage probe;
+  return probe.read_shape(path);
+}
+
+TEST(RenderTiles, RestrictedSizeCapsEveryTile)
+{
+  const std::vector<SipiIiifParams> tiles(2, full_params(SIPI_FORMAT_PNG));
+  std::vector<Sipi::SipiImgInfo> shapes;
+  const auto status = render_tiles(fixture("/unit/lena512.tif"),
+    tiles,
+    "!64,64",
+    {},
+    bare_engine(),
+    [&](std::size_t i, SipiStatus st, std::span<const std::uint8_t> bytes) {
+      EXPECT_EQ(st, SipiStatus::Ok) << "tile " << i;
+      shapes.push_back(tile_shape(bytes, "_render_tiles_restricted_" + std::to_string(i) + ".png"));
+      return true;
+    });
+  EXPECT_EQ(status, SipiStatus::Ok);
+  ASSERT_EQ(shapes.size(), 2u);
+  for (const auto &shape : shapes) {
+    EXPECT_LE(shape.width, 64);
+    EXPECT_LE(shape.height, 64);
+  }
+}
+
+TEST(RenderTiles, WatermarkMarksEveryTile)
+{
+  const std::vector<SipiIiifParams> tiles(2, full_params(SIPI_FORMAT_PNG));
+  const auto render = [&](const std::string &watermark) {
+    std::vector<std::vector<std::uint8_t>> out;
+    const auto status = render_tiles(fixture("/unit/lena512.tif"),
+      tiles,
+      {},
+      watermark,
+      bare_engine(),
+      [&](std::size_t, SipiStatus st, std::span<const std::uint8_t> bytes) {
+        EXPECT_EQ(st, SipiStatus::Ok);
+        out.emplace_back(bytes.begin(), bytes.end());
+        return true;
+      });
+    EXPECT_EQ(status, SipiStatus::Ok);
+    return out;
+  };
+  const auto plain = render({});
+  const auto marked = render(fixture("/unit/watermark_correct.tif"));
+  ASSERT_EQ(plain.size(), 2u);
+  ASSERT_EQ(marked.size(), 2u);
+  EXPECT_NE(plain[0], marked[0]);
+  EXPECT_NE(plain[1], marked[1]);
+}
+
+TEST(RenderTiles, MissingFileIsNotFound)
+{
+  const std::vector<SipiIiifParams> tiles = { full_params(SIPI_FORMAT_PNG) };
+  const auto status = render_tiles(kImagesDir + "/unit/does_not_exist.tif",
+    tiles,
+    {},
+    {},
+    bare_engine(),
+    [](std::size_t, SipiStatus, std::span<const std::uint8_t>) { return true; });
+  EXPECT_EQ(status, SipiStatus::NotFound);
+}
+
+TEST(PlanImage, DecodeRouteCarriesTheEstimate)
+{
+  const std::string path = fixture("/unit/lena512.tif");
+  const auto params = full_params(SIPI_FORMAT_PNG);
+  const auto req = make_request(path, params);
+  auto eng = bare_engine();
+  eng.large_decode_threshold_bytes = 1;
+
+  auto plan = plan_image(req, eng);
+  ASSERT_TRUE(plan.has_value());
+  EXPECT_EQ(plan->route(), SIPI_PLAN_DECODE);
+  EXPECT_GT(plan->decode_estimate(), 0U);
+  EXPECT_TRUE(plan->full_lane());
+
+  const auto result = execute_plan(std::move(*plan), eng, kNeverCancelled, nullptr, nullptr);
+  ASSERT_TRUE(result.has_value());
+  EXPECT_EQ(result->http_status, 200);
+  EXPECT_TRUE(std::holds_alternative<StreamBody>(result->body));
+}
+
+TEST(PlanImage, RoutesThatDecodeNothingCarryNoEstimate)
+{
+  const std::string path = fixture("/unit/lena512.tif");
+  const auto head = make_request(path, full_params(SIPI_FORMAT_PNG), /*is_head=*/1);
+  const auto passthrough = make_request(path, full_params(SIPI_FORMAT_TIF));
+
+  const std::vector<std::pair<SipiServeRequest, SipiPlanRoute>> cases = {
+    { head, SIPI_PLAN_HEAD }, { passthrough, SIPI_PLAN_PASSTHROUGH }
+  };
+  for (const auto &[req, route] : cases) {
+    const auto plan = plan_image(req, bare_engine());
+    ASSERT_TRUE(plan.has_value());
+    EXPECT_EQ(plan->route(), route);
+    EXPECT_EQ(plan->decode_estimate(), 0U);
+    EXPECT_FALSE(plan->full_lane());
+  }
+}
+
+TEST(PlanImage, MissingFileIsNotFound)
+{
+  const std::string path = kImagesDir + "/unit/does_not_exist.tif";
+  const auto req = make_request(path, full_params(SIPI_FORMAT_PNG));
+  const auto plan = plan_image(req, bare_engine());
+  ASSERT_FALSE(plan.has_value());
+  EXPECT_EQ(plan.error(), SipiStatus::NotFound);
+}
+
+TEST(DegradedRendering, FullLaneWithoutRoomRendersCheaperInsteadOfShedding)
+{
+  const std::string path = fixture("/unit/lena512.jp2");
+  auto eng = bare_engine();
+  eng.large_decode_threshold_bytes = 1;
+  auto req = j2k_thumbnail(path);
+  auto plan = plan_image(req, eng);
+  ASSERT_TRUE(plan.has_value());
+  ASSERT_EQ(plan->route(), SIPI_PLAN_DECODE);
+  Sipi::SipiMemoryBudget budget(plan->decode_estimate() - 1, Sipi::AdmissionMode::ADVANCED);
+  eng.memory_budget = &budget;
+
+  // Without a deadline the exact rendering cannot fit: 413.
+  const auto shed = build_image_response(req, eng, kNeverCancelled);
+  ASSERT_TRUE(shed.has_value());
+  EXPECT_EQ(shed->http_status, 413);
+
+  req.deadline_ms = 60000;
+  const auto result = build_image_response(req, eng, kNeverCancelled);
+  ASSERT_TRUE(result.has_value());
+  EXPECT_EQ(result->http_status, 200);
+  EXPECT_TRUE(std::holds_alternative<StreamBody>(result->body));
+  const std::string *degraded = find_header(*result, "X-Sipi-Degraded");
+  ASSERT_NE(degraded, nullptr);
+  EXPECT_NE(degraded->find("level"), std::string::npos);
+  EXPECT_TRUE(has_header(*result, "Cache-Control", "no-store"));
+}
+
+TEST(DegradedRendering, PredictedDeadlineMissRendersCheaper)
+{
+  const std::string path = fixture("/unit/lena512.jp2");
+  DecodeRate rate;
+  rate.record(1, std::chrono::hours(1));// every decode looks far too slow
+  auto eng = bare_engine();
+  eng.decode_rate = &rate;
+  auto req = j2k_thumbnail(path);
+
+  const auto exact = build_image_response(req, eng, kNeverCancelled);
+  ASSERT_TRUE(exact.has_value());
+  EXPECT_EQ(find_header(*exact, "X-Sipi-Degraded"), nullptr);// no deadline, no degrading
+
+  req.deadline_ms = 1000;
+  const auto result = build_image_response(req, eng, kNeverCancelled);
+  ASSERT_TRUE(result.has_value());
+  EXPECT_EQ(result->http_status, 200);
+  EXPECT_NE(find_header(*result, "X-Sipi-Degraded"), nullptr);
+}
+
+TEST(BudgetReservation, ShrinksToTheLiveBufferBeforeTheEncode)
+{
+  const std::string path = fixture("/unit/lena512.jp2");
+  auto eng = bare_engine();
+  eng.large_decode_threshold_bytes = 1;
+  const auto req = j2k_thumbnail(path);
+  auto plan = plan_image(req, eng);
+  ASSERT_TRUE(plan.has_value());
+  const std::size_t estimate = plan->decode_estimate();
+  Sipi::SipiMemoryBudget budget(4 * estimate, Sipi::AdmissionMode::ADVANCED);
+  eng.memory_budget = &budget;
+
+  {
+    const auto result = build_image_response(req, eng, kNeverCancelled);
+    ASSERT_TRUE(result.has_value());
+    ASSERT_EQ(result->http_status, 200);
+    // The producer holds only the 200-px output, not the decode + scale peak.
+    EXPECT_GT(budget.used(), 0U);
+    EXPECT_LT(budget.used(), estimate);
+  }
+  EXPECT_EQ(budget.used(), 0U);
+}
+
+// A heap that grows by a page at every reading: each checkpoint sees a new peak.
+std::int64_t growing_heap()
+{
+  static std::atomic<std::int64_t> level{ 0 };
+  return level.fetch_add(4096) + 4096;
+}
+
+TEST(PeakCalibration, FullLaneDecodeIsMeasuredAgainstItsStaticEstimate)
+{
+  const std::string path = fixture("/unit/lena512.jp2");
+  auto eng = bare_engine();
+  eng.large_decode_threshold_bytes = 1;
+  Sipi::PeakCalibration calibration;
+  eng.peak_calibration = &calibration;
+  Sipi::set_heap_reader(growing_heap);
+
+  serve_timings_reset();
+  const auto result = build_image_response(j2k_thumbnail(path), eng, kNeverCancelled);
+  Sipi::set_heap_reader(nullptr);
+  ASSERT_TRUE(result.has_value());
+  ASSERT_EQ(result->http_status, 200);
+  EXPECT_EQ(calibration.samples(), 1U);
+  SipiServeTimings timings{};
+  serve_timings_export(&timings);
+  EXPECT_GT(timings.decode_measured_peak_bytes, 0U);
+  // A single sample does not move the estimate yet.
+  EXPECT_EQ(timings.decode_estimate_bytes, plan_image(j2k_thumbnail(path), bare_engine())->decode_estimate());
+}
+
+TEST(DecodeAmplification, ReducedLevelDecodeIsLabelledAndRanked)
+{
+  const std::string path = fixture("/unit/lena512.jp2");
+  auto eng = bare_engine();
+  DecodeAmplification table;
+  eng.decode_amplification = &table;
+
+  serve_timings_reset();
+  const auto result = build_image_response(j2k_thumbnail(path), eng, kNeverCancelled);
+  ASSERT_TRUE(result.has_value());
+  SipiServeTimings timings{};
+  serve_timings_export(&timings);
+  EXPECT_EQ(timings.source_format, SIPI_FORMAT_JP2);
+  EXPECT_EQ(timings.decode_path, SIPI_DECODE_PATH_PYRAMID);
+  // The 256-px level, scaled down to 200 px.
+  EXPECT_EQ(timings.decoded_pixels, 256U * 256U);
+  EXPECT_EQ(timings.output_pixels, 200U * 200U);
+  EXPECT_GT(timings.source_bytes, 0U);
+
+  const auto top = table.top(1);
+  ASSERT_EQ(top.size(), 1U);
+  EXPECT_EQ(top[0].path, path);
+  EXPECT_DOUBLE_EQ(top[0].amplification, 65536.0 / 40000.0);
+}
+
+TEST(DecodeAmplification, PassthroughSendsWhatItReads)
+{
+  const std::string path = fixture("/unit/lena512.tif");
+  serve_timings_reset();
+  const auto req = make_request(path, full_params(SIPI_FORMAT_TIF));
+  const auto result = build_image_response(req, bare_engine(), kNeverCancelled);
+  ASSERT_TRUE(result.has_value());
+  SipiServeTimings timings{};
+  serve_timings_export(&timings);
+  EXPECT_EQ(timings.decode_path, SIPI_DECODE_PATH_PASSTHROUGH);
+  EXPECT_EQ(timings.source_format, SIPI_FORMAT_TIF);
+  EXPECT_EQ(timings.decoded_pixels, 0U);
+  EXPECT_EQ(timings.source_bytes, std::get<FileBody>(result->body).length);
+  EXPECT_EQ(timings.response_bytes, timings.source_bytes);
+}
@@ -36,6 +36,7 @@
 #include <vector>
 
 #include "ffi/sipi_ffi.h"
+#include "throttling/SipiPeakCalibration.h"// ServeInFlight
 
 namespace Sipi::ffi {
 
@@ -80,6 +81,17 @@ public:
   /*! Write one chunk. Returns 0 on success, non-zero on a write failure. */
   [[nodiscard]] int write(const std::uint8_t *data, std::size_t len) const { return resp_.write(resp_.ctx, data, len); }
 
+  /*! Write one heap buffer whose ownership passes to the transport; `release`
+   *  is called exactly once. Falls back to `write` + `release` when the
+   *  transport has no ownership-taking callback. */
+  [[nodiscard]] int write_owned(std::uint8_t *data, std::size_t len, SipiReleaseFn release) const
+  {
+    if (resp_.write_owned != nullptr) { return resp_.write_owned(resp_.ctx, data, len, release); }
+    const int rc = resp_.write(resp_.ctx, data, len);
+    release(data);
+    return rc;
+  }
+
   /*! 1 = client gone / timed out → the producer should abort. */
   [[nodiscard]] bool cancelled() const { return resp_.cancelled != nullptr && resp_.cancelled(resp_.ctx) != 0; }
 
@@ -131,10 +143,12 @@ struct ServeResponse
 void apply(ServeResponse &&response, const SipiResponse &resp);
 
 /*! Run an FFI entry body so no C++ exception crosses the `extern "C"` boundary:
- *  returns the body's status code, or 500 on any throw. */
+ *  returns the body's status code, or 500 on any throw. The body counts as
+ *  engine work in flight, so a calibration measurement it overlaps is dropped. */
 template<class F> int sipi_guard(F &&f) noexcept
 {
   try {
+    const ServeInFlight in_flight;
     return f();
   } catch (...) {
     return static_cast<int>(SipiStatus::InternalError);
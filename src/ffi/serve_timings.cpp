@@ -5,6 +5,9 @@
 
 #include "ffi/serve_timings.h"
 
+#include <sys/resource.h>
+#include <time.h>
+
 #include <array>
 #include <cstddef>
 #include <cstdint>
@@ -30,7 +33,22 @@ static_assert(offsetof(SipiServeTimings, failed) == 2 * SIPI_PHASE_COUNT * sizeo
 // one-sided phase-count bump.
 static_assert(offsetof(SipiServeTimings, decode_estimate_bytes) == 112,
   "SipiServeTimings.decode_estimate_bytes offset");
-static_assert(sizeof(SipiServeTimings) == 120, "SipiServeTimings size drifted from src/server-rs/src/ffi.rs");
+static_assert(offsetof(SipiServeTimings, decode_measured_peak_bytes) == 120,
+  "SipiServeTimings.decode_measured_peak_bytes offset");
+static_assert(offsetof(SipiServeTimings, cpu_ns) == 128, "SipiServeTimings.cpu_ns offset");
+static_assert(offsetof(SipiServeTimings, sink_wait_ns) == 128 + SIPI_PHASE_COUNT * sizeof(uint64_t),
+  "SipiServeTimings.sink_wait_ns offset");
+static_assert(offsetof(SipiServeTimings, read_bytes) == 128 + 2 * SIPI_PHASE_COUNT * sizeof(uint64_t),
+  "SipiServeTimings.read_bytes offset");
+static_assert(offsetof(SipiServeTimings, heap_peak_bytes) == 128 + 3 * SIPI_PHASE_COUNT * sizeof(uint64_t),
+  "SipiServeTimings.heap_peak_bytes offset");
+static_assert(offsetof(SipiServeTimings, decoded_pixels) == 320, "SipiServeTimings.decoded_pixels offset");
+static_assert(offsetof(SipiServeTimings, output_pixels) == 328, "SipiServeTimings.output_pixels offset");
+static_assert(offsetof(SipiServeTimings, source_bytes) == 336, "SipiServeTimings.source_bytes offset");
+static_assert(offsetof(SipiServeTimings, response_bytes) == 344, "SipiServeTimings.response_bytes offset");
+static_assert(offsetof(SipiServeTimings, source_format) == 352, "SipiServeTimings.source_format offset");
+static_assert(offsetof(SipiServeTimings, decode_path) == 356, "SipiServeTimings.decode_path offset");
+static_assert(sizeof(SipiServeTimings) == 360, "SipiServeTimings size drifted from src/server-rs/src/ffi.rs");
 
 namespace Sipi::ffi {
 
@@ -47,6 +65,19 @@ struct Accumulator
   std::array<std::uint8_t, SIPI_PHASE_COUNT> present{};
   std::array<std::uint8_t, SIPI_PHASE_COUNT> failed{};
   std::uint64_t decode_estimate_bytes{};
+  std::uint64_t decode_measured_peak_bytes{};
+  std::array<std::uint64_t, SIPI_PHASE_COUNT> cpu_ns{};
+  std::array<std::uint64_t, SIPI_PHASE_COUNT> sink_wait_ns{};
+  std::array<std::uint64_t, SIPI_PHASE_COUNT> read_bytes{};
+  std::array<std::uint64_t, SIPI_PHASE_COUNT> heap_peak_bytes{};
+  std::uint64_t decoded_pixels{};
+  std::uint64_t output_pixels{};
+  std::uint64_t source_bytes{};
+  std::uint64_t response_bytes{};
+  SipiFormatType source_format{ SIPI_FORMAT_UNSUPPORTED };
+  SipiDecodePath decode_path{ SIPI_DECODE_PATH_NONE };
+  //! Running total of the sink waits; a phase records the part inside it.
+  std::uint64_t sink_wait_total_ns{};
 };
 
 thread_local Accumulator g_accum;
@@ -58,6 +89,29 @@ std::uint64_t clamp_ns(std::chrono::steady_clock::duration d)
   return ns < 0 ? 0 : static_cast<std::uint64_t>(ns);
 }
 
+//! The calling thread's CPU time in nanoseconds.
+std::uint64_t thread_cpu_ns()
+{
+  timespec ts{};
+  if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) != 0) { return 0; }
+  return static_cast<std::uint64_t>(ts.tv_sec) * 1'000'000'000U + static_cast<std::uint64_t>(ts.tv_nsec);
+}
+
+//! Bytes the calling thread has read from storage: the kernel counts block
+//! input in 512-byte units, for read() and mmap page-ins alike.
+std::uint64_t thread_read_bytes()
+{
+#ifdef RUSAGE_THREAD
+  rusage ru{};
+  if (getrusage(RUSAGE_THREAD, &ru) != 0 || ru.ru_inblock < 0) { return 0; }
+  return static_cast<std::uint64_t>(ru.ru_inblock) * 512U;
+#else
+  return 0;
+#endif
+}
+
+std::uint64_t since(std::uint64_t start, std::uint64_t now) { return now > start ? now - start : 0; }
+
 }// namespace
 
 void serve_timings_reset()
@@ -68,10 +122,40 @@ void serve_timings_reset()
   g_accum.present.fill(0);
   g_accum.failed.fill(0);
   g_accum.decode_estimate_bytes = 0;
+  g_accum.decode_measured_peak_bytes = 0;
+  g_accum.cpu_ns.fill(0);
+  g_accum.sink_wait_ns.fill(0);
+  g_accum.read_bytes.fill(0);
+  g_accum.heap_peak_bytes.fill(0);
+  g_accum.decoded_pixels = 0;
+  g_accum.output_pixels = 0;
+  g_accum.source_bytes = 0;
+  g_accum.response_bytes = 0;
+  g_accum.source_format = SIPI_FORMAT_UNSUPPORTED;
+  g_accum.decode_path = SIPI_DECODE_PATH_NONE;
 }
 
 void serve_timings_set_decode_estimate(std::uint64_t bytes) { g_accum.decode_estimate_bytes = bytes; }
 
+void serve_timings_set_measured_peak(std::uint64_t bytes) { g_accum.decode_measured_peak_bytes = bytes; }
+
+void serve_timings_set_decode_path(SipiFormatType source_format, SipiDecodePath path)
+{
+  g_accum.source_format = source_format;
+  g_accum.decode_path = path;
+}
+
+void serve_timings_set_decoded(std::uint64_t decoded_pixels, std::uint64_t output_pixels, std::uint64_t source_bytes)
+{
+  g_accum.decoded_pixels = decoded_pixels;
+  g_accum.output_pixels = output_pixels;
+  g_accum.source_bytes = source_bytes;
+}
+
+void serve_timings_set_source_bytes(std::uint64_t bytes) { g_accum.source_bytes = bytes; }
+
+void serve_timings_add_response_bytes(std::uint64_t bytes) { g_accum.response_bytes += bytes; }
+
 void serve_timings_export(SipiServeTimings *out)
 {
   if (out == nullptr) { return; }
@@ -80,12 +164,56 @@ void serve_timings_export(SipiServeTimings *out)
     out->dur_ns[i] = g_accum.dur_ns[static_cast<std::size_t>(i)];
     out->present[i] = g_accum.present[static_cast<std::size_t>(i)];
     out->failed[i] = g_accum.failed[static_cast<std::size_t>(i)];
+    out->cpu_ns[i] = g_accum.cpu_ns[static_cast<std::size_t>(i)];
+    out->sink_wait_ns[i] = g_accum.sink_wait_ns[static_cast<std::size_t>(i)];
+    out->read_bytes[i] = g_accum.read_bytes[static_cast<std::size_t>(i)];
+    out->heap_peak_bytes[i] = g_accum.heap_peak_bytes[static_cast<std::size_t>(i)];
   }
   out->decode_estimate_bytes = g_accum.decode_estimate_bytes;
+  out->decode_measured_peak_bytes = g_accum.decode_measured_peak_bytes;
+  out->decoded_pixels = g_accum.decoded_pixels;
+  out->output_pixels = g_accum.output_pixels;
+  out->source_bytes = g_accum.source_bytes;
+  out->response_bytes = g_accum.response_bytes;
+  out->source_format = g_accum.source_format;
+  out->decode_path = g_accum.decode_path;
+}
+
+ServeTimingsState serve_timings_save()
+{
+  ServeTimingsState state;
+  state.t0 = g_accum.t0;
+  serve_timings_export(&state.timings);
+  return state;
+}
+
+void serve_timings_restore(const ServeTimingsState &state)
+{
+  g_accum.t0 = state.t0;
+  for (int i = 0; i < SIPI_PHASE_COUNT; ++i) {
+    g_accum.start_ns[static_cast<std::size_t>(i)] = state.timings.start_ns[i];
+    g_accum.dur_ns[static_cast<std::size_t>(i)] = state.timings.dur_ns[i];
+    g_accum.present[static_cast<std::size_t>(i)] = state.timings.present[i];
+    g_accum.failed[static_cast<std::size_t>(i)] = state.timings.failed[i];
+    g_accum.cpu_ns[static_cast<std::size_t>(i)] = state.timings.cpu_ns[i];
+    g_accum.sink_wait_ns[static_cast<std::size_t>(i)] = state.timings.sink_wait_ns[i];
+    g_accum.read_bytes[static_cast<std::size_t>(i)] = state.timings.read_bytes[i];
+    g_accum.heap_peak_bytes[static_cast<std::size_t>(i)] = state.timings.heap_peak_bytes[i];
+  }
+  g_accum.decode_estimate_bytes = state.timings.decode_estimate_bytes;
+  g_accum.decode_measured_peak_bytes = state.timings.decode_measured_peak_bytes;
+  g_accum.decoded_pixels = state.timings.decoded_pixels;
+  g_accum.output_pixels = state.timings.output_pixels;
+  g_accum.source_bytes = state.timings.source_bytes;
+  g_accum.response_bytes = state.timings.response_bytes;
+  g_accum.source_format = state.timings.source_format;
+  g_accum.decode_path = state.timings.decode_path;
 }
 
 PhaseTimer::PhaseTimer(SipiPhase phase)
-  : phase_(phase), uncaught_on_entry_(std::uncaught_exceptions()), start_(std::chrono::steady_clock::now())
+  : phase_(phase), uncaught_on_entry_(std::uncaught_exceptions()), start_(std::chrono::steady_clock::now()),
+    cpu_start_(thread_cpu_ns()), read_start_(thread_read_bytes()), sink_wait_start_(g_accum.sink_wait_total_ns),
+    heap_(HeapPeakScope::Sampling::Bounds)
 {
 }
 
@@ -97,9 +225,20 @@ PhaseTimer::~PhaseTimer()
   g_accum.start_ns[idx] = clamp_ns(start_ - g_accum.t0);
   g_accum.dur_ns[idx] = clamp_ns(end - start_);
   g_accum.present[idx] = 1;
+  g_accum.cpu_ns[idx] = since(cpu_start_, thread_cpu_ns());
+  g_accum.read_bytes[idx] = since(read_start_, thread_read_bytes());
+  g_accum.sink_wait_ns[idx] = since(sink_wait_start_, g_accum.sink_wait_total_ns);
+  g_accum.heap_peak_bytes[idx] = heap_.peak();
   // More exceptions in flight than at construction → this scope is unwinding
   // because the phase's work threw. Mark it so the shell flags the span errored.
   g_accum.failed[idx] = std::uncaught_exceptions() > uncaught_on_entry_ ? 1 : 0;
 }
 
+SinkWaitTimer::SinkWaitTimer() : start_(std::chrono::steady_clock::now()) {}
+
+SinkWaitTimer::~SinkWaitTimer()
+{
+  g_accum.sink_wait_total_ns += clamp_ns(std::chrono::steady_clock::now() - start_);
+}
+
 }// namespace Sipi::ffi
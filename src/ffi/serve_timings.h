@@ -28,6 +28,7 @@
 #include <cstdint>
 
 #include "ffi/sipi_ffi.h"
+#include "throttling/SipiPeakCalibration.h"// HeapPeakScope
 
 namespace Sipi::ffi {
 
@@ -39,6 +40,22 @@ void serve_timings_reset();
  *  `sipi_serve_timings_take` seam entry. */
 void serve_timings_export(SipiServeTimings *out);
 
+/*! A copy of one thread's accumulator, offset origin included. */
+struct ServeTimingsState
+{
+  std::chrono::steady_clock::time_point t0;
+  SipiServeTimings timings{};
+};
+
+/*! Save the calling thread's accumulator, so a serve planned on one worker
+ *  thread and run on another (`sipi_plan_image` → `sipi_serve_planned`) keeps a
+ *  single timeline. */
+[[nodiscard]] ServeTimingsState serve_timings_save();
+
+/*! Replace the calling thread's accumulator with `state`, in place of the
+ *  [`serve_timings_reset`] a fresh serve would start with. */
+void serve_timings_restore(const ServeTimingsState &state);
+
 /*! Record this serve's estimated peak decode memory (bytes) — the value the
  *  decode-memory budget admitted against. Not a timing, but it rides the same
  *  accumulator: it is observed inside the same call and read back by the same
@@ -46,11 +63,33 @@ void serve_timings_export(SipiServeTimings *out);
  *  the flat `SipiMetricsSnapshot` cannot carry. Left 0 when no decode ran. */
 void serve_timings_set_decode_estimate(std::uint64_t bytes);
 
+/*! Record this serve's measured peak heap rise (bytes) over its decode and
+ *  transforms, which the shell compares with the estimate. Left 0 when the
+ *  decode was not measured. */
+void serve_timings_set_measured_peak(std::uint64_t bytes);
+
+/*! Label how this serve got its body: the requested source's format and the
+ *  decode path (pyramid level, DCT-scaled, full decode, passthrough, cache hit
+ *  or compressed-domain copy). */
+void serve_timings_set_decode_path(SipiFormatType source_format, SipiDecodePath path);
+
+/*! Record this serve's decode amplification: pixels the codec decoded, pixels
+ *  of the rendering encoded from them, and the compressed bytes read for them. */
+void serve_timings_set_decoded(std::uint64_t decoded_pixels, std::uint64_t output_pixels, std::uint64_t source_bytes);
+
+/*! Record the source bytes of a serve that decoded nothing (passthrough, cache hit). */
+void serve_timings_set_source_bytes(std::uint64_t bytes);
+
+/*! Add `bytes` handed to the response sink to this serve's response size. */
+void serve_timings_add_response_bytes(std::uint64_t bytes);
+
 /*! RAII timer for one serve phase: records `[construction, destruction)` against
  *  `phase` in the thread-local accumulator, as an offset from the last
- *  [`serve_timings_reset`] plus a duration. If the scope exits via an exception,
- *  the phase is also marked failed (detected in the destructor via
- *  `std::uncaught_exceptions()`). Re-timing a phase overwrites it; an
+ *  [`serve_timings_reset`] plus a duration, together with what the phase cost
+ *  the thread: CPU time, storage reads, sink waits and peak heap rise (read at
+ *  the phase's bounds, plus the codec checkpoints of a calibration measurement
+ *  in progress). If the scope exits via an exception, the phase is also marked
+ *  failed (detected in the destructor via `std::uncaught_exceptions()`). Re-timing a phase overwrites it; an
  *  out-of-range index is ignored. Times only — it mints no OTel span; the shell
  *  does that from the exported timings. */
 class PhaseTimer
@@ -67,6 +106,25 @@ private:
   SipiPhase phase_;
   int uncaught_on_entry_;
   std::chrono::steady_clock::time_point start_;
+  std::uint64_t cpu_start_;
+  std::uint64_t read_start_;
+  std::uint64_t sink_wait_start_;
+  HeapPeakScope heap_;
+};
+
+/*! RAII timer around one call into the response sink's write callback: the
+ *  time it blocks (a slow client's back-pressure) is charged to the phase that
+ *  is open on the calling thread as `sink_wait_ns`. */
+class SinkWaitTimer
+{
+public:
+  SinkWaitTimer();
+  ~SinkWaitTimer();
+  SinkWaitTimer(const SinkWaitTimer &) = delete;
+  SinkWaitTimer &operator=(const SinkWaitTimer &) = delete;
+
+private:
+  std::chrono::steady_clock::time_point start_;
 };
 
 }// namespace Sipi::ffi
@@ -7,11 +7,16 @@
 
 #include <gtest/gtest.h>
 
+#include <chrono>
 #include <stdexcept>
+#include <thread>
 
 using Sipi::ffi::PhaseTimer;
 using Sipi::ffi::serve_timings_export;
 using Sipi::ffi::serve_timings_reset;
+using Sipi::ffi::serve_timings_restore;
+using Sipi::ffi::serve_timings_save;
+using Sipi::ffi::SinkWaitTimer;
 
 namespace {
 
@@ -35,7 +40,12 @@ TEST(ServeTimings, ResetClearsEverything)
     EXPECT_EQ(out.failed[i], 0) << "phase " << i;
     EXPECT_EQ(out.dur_ns[i], 0u) << "phase " << i;
     EXPECT_EQ(out.start_ns[i], 0u) << "phase " << i;
+    EXPECT_EQ(out.cpu_ns[i], 0u) << "phase " << i;
+    EXPECT_EQ(out.sink_wait_ns[i], 0u) << "phase " << i;
   }
+  EXPECT_EQ(out.decoded_pixels, 0u);
+  EXPECT_EQ(out.response_bytes, 0u);
+  EXPECT_EQ(out.decode_path, SIPI_DECODE_PATH_NONE);
 }
 
 // A timed phase marks only its own slot present, not failed.
@@ -119,4 +129,92 @@ TEST(ServeTimings, ExportNullIsNoop)
   serve_timings_export(nullptr);
 }
 
+// A phase that burns CPU records it; a phase that only sleeps records (almost) none.
+TEST(ServeTimings, CpuTimeIsTheThreadsOwn)
+{
+  serve_timings_reset();
+  {
+    PhaseTimer t(SIPI_PHASE_DECODE);
+    const auto until = std::chrono::steady_clock::now() + std::chrono::milliseconds(20);
+    volatile std::uint64_t spin = 0;
+    while (std::chrono::steady_clock::now() < until) { spin = spin + 1; }
+  }
+  {
+    PhaseTimer t(SIPI_PHASE_ENCODE);
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  }
+  const SipiServeTimings out = take();
+  EXPECT_GE(out.cpu_ns[SIPI_PHASE_DECODE], 10'000'000u);
+  EXPECT_LT(out.cpu_ns[SIPI_PHASE_ENCODE], out.dur_ns[SIPI_PHASE_ENCODE] / 2);
+}
+
+// Time blocked in the sink is charged to the phase open around it, and only to it.
+TEST(ServeTimings, SinkWaitIsChargedToTheOpenPhase)
+{
+  serve_timings_reset();
+  {
+    PhaseTimer t(SIPI_PHASE_DECODE);
+  }
+  {
+    PhaseTimer t(SIPI_PHASE_ENCODE);
+    const SinkWaitTimer wait;
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+  }
+  const SipiServeTimings out = take();
+  EXPECT_EQ(out.sink_wait_ns[SIPI_PHASE_DECODE], 0u);
+  EXPECT_GE(out.sink_wait_ns[SIPI_PHASE_ENCODE], 5'000'000u);
+  EXPECT_LE(out.sink_wait_ns[SIPI_PHASE_ENCODE], out.dur_ns[SIPI_PHASE_ENCODE]);
+}
+
+// A plan's observations carried to another thread keep their origin: a phase
+// timed there lands after the planned one on the same timeline.
+TEST(ServeTimings, SavedStateRestoresOnAnotherThread)
+{
+  serve_timings_reset();
+  {
+    PhaseTimer t(SIPI_PHASE_SHAPE);
+  }
+  Sipi::ffi::serve_timings_set_decode_estimate(1234);
+  Sipi::ffi::serve_timings_set_measured_peak(5678);
+  const auto saved = serve_timings_save();
+
+  SipiServeTimings out{};
+  std::thread([&] {
+    serve_timings_restore(saved);
+    {
+      PhaseTimer t(SIPI_PHASE_DECODE);
+    }
+    out = take();
+  }).join();
+  EXPECT_EQ(out.present[SIPI_PHASE_SHAPE], 1);
+  EXPECT_EQ(out.present[SIPI_PHASE_DECODE], 1);
+  EXPECT_EQ(out.decode_estimate_bytes, 1234u);
+  EXPECT_EQ(out.decode_measured_peak_bytes, 5678u);
+  EXPECT_GE(out.start_ns[SIPI_PHASE_DECODE], out.start_ns[SIPI_PHASE_SHAPE] + out.dur_ns[SIPI_PHASE_SHAPE]);
+}
+
+// Response bytes add up across sink writes; the next serve's reset clears every
+// amplification field.
+TEST(ServeTimings, AmplificationFieldsAccumulateAndReset)
+{
+  serve_timings_reset();
+  Sipi::ffi::serve_timings_set_decode_path(SIPI_FORMAT_JP2, SIPI_DECODE_PATH_PYRAMID);
+  Sipi::ffi::serve_timings_set_decoded(4096, 1024, 300);
+  Sipi::ffi::serve_timings_add_response_bytes(100);
+  Sipi::ffi::serve_timings_add_response_bytes(50);
+  SipiServeTimings out = take();
+  EXPECT_EQ(out.source_format, SIPI_FORMAT_JP2);
+  EXPECT_EQ(out.decode_path, SIPI_DECODE_PATH_PYRAMID);
+  EXPECT_EQ(out.decoded_pixels, 4096u);
+  EXPECT_EQ(out.output_pixels, 1024u);
+  EXPECT_EQ(out.source_bytes, 300u);
+  EXPECT_EQ(out.response_bytes, 150u);
+
+  serve_timings_reset();
+  out = take();
+  EXPECT_EQ(out.source_format, SIPI_FORMAT_UNSUPPORTED);
+  EXPECT_EQ(out.source_bytes, 0u);
+  EXPECT_EQ(out.response_bytes, 0u);
+}
+
 }// namespace
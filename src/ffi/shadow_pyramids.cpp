@@ -0,0 +1,331 @@
+/*
+ * Copyright © 2016 - 2026 Swiss National Data and Service Center for the Humanities and/or DaSCH Service Platform
+ * contributors. SPDX-License-Identifier: AGPL-3.0-or-later
+ */
+
+#include "ffi/shadow_pyramids.h"
+
+#include <sys/resource.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <limits>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#include "SipiError.h"
+#include "SipiImage.h"
+#include "SipiImageError.h"
+#include "logging/logger.h"
+#include "observability/metrics.h"
+#include "throttling/SipiMemoryBudget.h"
+#include "throttling/SipiPeakCalibration.h"
+#include "throttling/SipiPeakMemory.h"
+#include "util/Error.h"
+
+namespace Sipi::ffi {
+namespace {
+
+  using observability::Metrics;
+
+  constexpr const char *kBuildingPrefix = ".building-";
+
+  // Length of the path-hash prefix shared by all shadows of one source.
+  constexpr std::size_t kHashLength = 16;
+
+  // Bounds on the bookkeeping: the access table is reset when it reaches
+  // kMaxTracked names (a cold long tail must not grow it forever), and a source
+  // that turns hot while kMaxQueued builds wait keeps its count and is queued on
+  // a later decode.
+  constexpr std::size_t kMaxTracked = 65536;
+  constexpr std::size_t kMaxQueued = 64;
+
+  // Nice value of the build threads on Linux.
+  constexpr int kBuildNice = 10;
+
+  // A served shadow's mtime is bumped at most this often: it is the recency the
+  // size sweep evicts by, and a hot shadow need not cost a write per hit.
+  constexpr auto kTouchInterval = std::chrono::minutes(10);
+
+  // Lowers the calling build thread's priority so a build yields the CPU to
+  // live decodes. On Linux PRIO_PROCESS with who = 0 sets only the calling
+  // thread, and the pyramid writer's tile-encode threads inherit it. On macOS
+  // it would renice the whole server; PRIO_DARWIN_THREAD applies to the calling
+  // thread alone, and PRIO_DARWIN_BG also throttles its disk I/O.
+  bool lower_build_priority()
+  {
+#ifdef __APPLE__
+    return setpriority(PRIO_DARWIN_THREAD, 0, PRIO_DARWIN_BG) == 0;
+#elif defined(__linux__)
+    return setpriority(PRIO_PROCESS, 0, kBuildNice) == 0;
+#else
+    return false;
+#endif
+  }
+
+  // FNV-1a over the source path: stable across restarts, so shadows built by
+  // an earlier process are found again.
+  std::uint64_t path_hash(const std::string &path)
+  {
+    std::uint64_t h = 14695981039346656037ULL;
+    for (const unsigned char c : path) {
+      h ^= c;
+      h *= 1099511628211ULL;
+    }
+    return h;
+  }
+
+  // The shadow name of `path` as it is on disk now; nullopt when it cannot be stat'd.
+  std::optional<std::string> current_shadow_name(const std::string &path)
+  {
+    std::error_code ec;
+    const auto mtime = std::filesystem::last_write_time(path, ec);
+    if (ec) { return std::nullopt; }
+    const auto size = std::filesystem::file_size(path, ec);
+    if (ec) { return std::nullopt; }
+    const auto mtime_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(mtime.time_since_epoch()).count();
+    return shadow_file_name(path, static_cast<long long>(mtime_ns), static_cast<long long>(size));
+  }
+
+}// namespace
+
+bool is_flat_source(SipiQualityFormat::FormatType fmt, const SipiImgInfo &info)
+{
+  switch (fmt) {
+  case SipiQualityFormat::JPG:
+  case SipiQualityFormat::PNG:
+    return true;
+  case SipiQualityFormat::TIF:
+    return info.tile_width == 0 || info.tile_height == 0;
+  default:
+    return false;
+  }
+}
+
+std::string shadow_file_name(const std::string &path, long long mtime_ns, long long size)
+{
+  char hash[17];
+  std::snprintf(hash, sizeof(hash), "%016llx", static_cast<unsigned long long>(path_hash(path)));
+  return std::string(hash) + "-" + std::to_string(mtime_ns) + "-" + std::to_string(size) + ".tif";
+}
+
+ShadowPyramids::ShadowPyramids(std::string dir,
+  unsigned hot_threshold,
+  std::uintmax_t max_bytes,
+  SipiMemoryBudget *budget,
+  std::size_t min_edge,
+  unsigned workers)
+  : dir_(std::move(dir)), hot_threshold_(std::max(hot_threshold, 1U)), max_bytes_(max_bytes), budget_(budget),
+    min_edge_(min_edge)
+{
+  std::error_code ec;
+  std::filesystem::create_directories(dir_, ec);
+  if (ec || !std::filesystem::is_directory(dir_)) {
+    throw shttps::Error("shadow directory '" + dir_ + "' cannot be created: " + ec.message());
+  }
+  // A build interrupted by a restart leaves its temporary file behind.
+  for (const auto &entry : std::filesystem::directory_iterator(dir_, ec)) {
+    if (entry.path().filename().string().starts_with(kBuildingPrefix)) {
+      std::filesystem::remove(entry.path(), ec);
+    }
+  }
+  // The cap may have been lowered since the shadows were built.
+  sweep();
+  for (unsigned i = 0; i < std::max(workers, 1U); ++i) {
+    workers_.emplace_back([this](const std::stop_token &stop) { run(stop); });
+  }
+}
+
+ShadowPyramids::~ShadowPyramids()
+{
+  for (auto &w : workers_) { w.request_stop(); }
+  workers_.clear();// joins
+}
+
+std::optional<std::string> ShadowPyramids::lookup(const std::string &path, const SipiImgInfo &info)
+{
+  if (static_cast<std::size_t>(std::max(info.width, info.height)) < min_edge_) { return std::nullopt; }
+  const auto name = current_shadow_name(path);
+  if (!name) { return std::nullopt; }
+  std::string shadow = dir_ + "/" + *name;
+  std::error_code ec;
+  const auto used = std::filesystem::last_write_time(shadow, ec);
+  if (!ec) {
+    const auto now = std::filesystem::file_time_type::clock::now();
+    if (now - used > kTouchInterval) { std::filesystem::last_write_time(shadow, now, ec); }
+    return shadow;
+  }
+
+  std::lock_guard lock(mutex_);
+  if (pending_.contains(*name)) { return std::nullopt; }
+  if (hits_.size() >= kMaxTracked) { hits_.clear(); }
+  if (++hits_[*name] < hot_threshold_ || queue_.size() >= kMaxQueued) { return std::nullopt; }
+  hits_.erase(*name);
+  pending_.insert(*name);
+  if (sources_.size() >= kMaxTracked) { sources_.clear(); }
+  sources_[name->substr(0, kHashLength)] = path;
+  queue_.push_back(Job{ path, std::move(shadow), info });
+  wake_.notify_one();
+  return std::nullopt;
+}
+
+void ShadowPyramids::drain()
+{
+  std::unique_lock lock(mutex_);
+  idle_.wait(lock, [this] { return queue_.empty() && running_ == 0; });
+}
+
+void ShadowPyramids::run(const std::stop_token &stop)
+{
+  if (!lower_build_priority()) { log_debug("shadow pyramids: cannot lower build priority"); }
+  for (;;) {
+    Job job;
+    {
+      std::unique_lock lock(mutex_);
+      if (!wake_.wait(lock, stop, [this] { return !queue_.empty(); })) { return; }
+      job = std::move(queue_.front());
+      queue_.pop_front();
+      ++running_;
+    }
+    build(job);
+    {
+      std::lock_guard lock(mutex_);
+      pending_.erase(std::filesystem::path(job.shadow).filename().string());
+      --running_;
+    }
+    idle_.notify_all();
+  }
+}
+
+void ShadowPyramids::build(const Job &job)
+{
+  auto &metrics = Metrics::instance();
+
+  // The full decode, plus the reduced levels the pyramid writer derives from it
+  // (a third of the full level again).
+  const auto w = static_cast<std::size_t>(job.info.width);
+  const auto h = static_cast<std::size_t>(job.info.height);
+  const std::size_t decode = estimate_peak_memory(w, h, w, h, job.info.nc, job.info.bps, 0.0, false);
+  const std::size_t bytes =
+    decode > std::numeric_limits<std::size_t>::max() / 4 * 3 ? std::numeric_limits<std::size_t>::max() : decode / 3 * 4;
+
+  // A build takes budget only while no request waits in the full lane's queue
+  // (it must not overtake one) and half the lane stays free for live requests;
+  // otherwise it is dropped and re-queued once the source is hot again.
+  std::optional<MemoryBudgetGuard> budget_guard;
+  if (budget_ != nullptr) {
+    if (budget_->waiting() != 0) {
+      metrics.shadow_pyramid_deferred_total.Increment();
+      log_debug("shadow pyramids: deferring %s (%zu requests waiting for memory)",
+        job.source.c_str(), budget_->waiting());
+      return;
+    }
+    const auto result = budget_->try_acquire(bytes);
+    SipiMemoryBudget *mb = budget_;
+    budget_guard.emplace(*mb, bytes, result.allowed, [mb] {
+      Metrics::instance().decode_memory_used_bytes.Set(static_cast<double>(mb->used()));
+    });
+    if (!result.allowed || result.used > result.budget / 2) {
+      metrics.shadow_pyramid_deferred_total.Increment();
+      log_debug("shadow pyramids: deferring %s (%zu bytes, %zu / %zu in use)",
+        job.source.c_str(), bytes, result.used, result.budget);
+      return;
+    }
+    metrics.decode_memory_used_bytes.Set(static_cast<double>(result.used));
+  }
+
+  const std::filesystem::path shadow(job.shadow);
+  const std::filesystem::path tmp = shadow.parent_path() / (kBuildingPrefix + shadow.filename().string());
+  std::error_code ec;
+  try {
+    const ServeInFlight in_flight;// its allocations would skew a concurrent calibration measurement
+    SipiImage img;
+    img.read(job.source);
+    const SipiCompressionParams params = { { TIFF_Pyramid, "yes" }, { TIFF_Compression, "COMPRESSION_DEFLATE" } };
+    img.write("tif", tmp.string(), &params);
+  } catch (const SipiImageError &err) {
+    log_warn("shadow pyramids: cannot build shadow of %s: %s", job.source.c_str(), err.to_string().c_str());
+    std::filesystem::remove(tmp, ec);
+    return;
+  } catch (const SipiError &err) {
+    log_warn("shadow pyramids: cannot build shadow of %s: %s", job.source.c_str(), err.what());
+    std::filesystem::remove(tmp, ec);
+    return;
+  } catch (const std::exception &err) {
+    log_warn("shadow pyramids: cannot build shadow of %s: %s", job.source.c_str(), err.what());
+    std::filesystem::remove(tmp, ec);
+    return;
+  }
+
+  // The source was rewritten since the build was queued: the shadow holds the
+  // old pixels, and the next decode stamps a new name anyway.
+  if (current_shadow_name(job.source) != shadow.filename().string()) {
+    std::filesystem::remove(tmp, ec);
+    return;
+  }
+  std::filesystem::rename(tmp, shadow, ec);
+  if (ec) {
+    log_warn("shadow pyramids: cannot install %s: %s", shadow.c_str(), ec.message().c_str());
+    std::filesystem::remove(tmp, ec);
+    return;
+  }
+  metrics.shadow_pyramid_builds_total.Increment();
+  log_info("shadow pyramids: built %s for %s", shadow.c_str(), job.source.c_str());
+
+  sweep();
+}
+
+void ShadowPyramids::sweep()
+{
+  struct Shadow
+  {
+    std::filesystem::path path;
+    std::uintmax_t size;
+    std::filesystem::file_time_type used;
+  };
+  std::vector<Shadow> shadows;
+  std::uintmax_t total = 0;
+  std::size_t orphans = 0;
+  std::error_code ec;
+  for (const auto &entry : std::filesystem::directory_iterator(dir_, ec)) {
+    const std::string name = entry.path().filename().string();
+    if (name.starts_with(kBuildingPrefix) || !entry.is_regular_file(ec)) { continue; }
+    // A shadow of a known source that no longer matches it is of an earlier
+    // version, or of a source since deleted. Shadows of sources not decoded
+    // since startup are left to the size cap.
+    std::optional<std::string> source;
+    {
+      std::lock_guard lock(mutex_);
+      if (const auto it = sources_.find(name.substr(0, kHashLength)); it != sources_.end()) { source = it->second; }
+    }
+    if (source && current_shadow_name(*source) != name) {
+      if (std::filesystem::remove(entry.path(), ec)) { ++orphans; }
+      continue;
+    }
+    const auto size = entry.file_size(ec);
+    if (ec) { continue; }
+    const auto used = entry.last_write_time(ec);
+    if (ec) { continue; }
+    shadows.push_back(Shadow{ entry.path(), size, used });
+    total += size;
+  }
+  if (orphans > 0) { log_debug("shadow pyramids: removed %zu stale shadows", orphans); }
+  if (max_bytes_ == 0 || total <= max_bytes_) { return; }
+
+  std::ranges::sort(shadows, {}, &Shadow::used);
+  std::size_t evicted = 0;
+  for (const auto &s : shadows) {
+    if (total <= max_bytes_) { break; }
+    if (std::filesystem::remove(s.path, ec)) {
+      total -= s.size;
+      ++evicted;
+    }
+  }
+  log_info("shadow pyramids: evicted %zu least recently used shadows to fit %ju bytes", evicted, max_bytes_);
+}
+
+}// namespace Sipi::ffi
@@ -0,0 +1,124 @@
+/*
+ * Copyright © 2016 - 2026 Swiss National Data and Service Center for the Humanities and/or DaSCH Service Platform
+ * contributors. SPDX-License-Identifier: AGPL-3.0-or-later
+ */
+
+/*!
+ * Shadow pyramids: tiled pyramidal sidecars for hot flat sources.
+ *
+ * A JPEG, a PNG or an untiled TIFF in the image root has no resolution levels,
+ * so every thumbnail and tile of it pays for a full-resolution decode. Once such
+ * a source has been decoded `hot_threshold` times, `ShadowPyramids` writes a
+ * deflate-compressed tiled pyramidal TIFF of it into the shadow directory on a
+ * background worker, and `build_image_response` decodes from that sidecar
+ * instead — the TIFF reader then picks the smallest stored level.
+ *
+ * A shadow is named after the source path and the source's mtime and size, so
+ * rewriting the original makes its shadow unreachable at once. After each build
+ * the directory is swept: shadows whose source has since been rewritten or
+ * deleted are removed, then the least recently served ones until the directory
+ * fits `max_bytes`. Builds run on `workers` threads at lowered priority, and
+ * each charges its peak memory to the full-lane budget only while no request
+ * waits in the budget's queue and half the lane stays free for live requests —
+ * otherwise it is deferred until the source is hot again.
+ */
+#ifndef SIPI_FFI_SHADOW_PYRAMIDS_H
+#define SIPI_FFI_SHADOW_PYRAMIDS_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "SipiIO.h"// SipiImgInfo
+#include "iiifparser/SipiQualityFormat.h"
+
+namespace Sipi {
+class SipiMemoryBudget;
+}// namespace Sipi
+
+namespace Sipi::ffi {
+
+/*! Whether a source of format `fmt` and shape `info` has no resolution levels
+ *  to read a reduced size from: any JPEG or PNG, or a TIFF without tiles. */
+[[nodiscard]] bool is_flat_source(SipiQualityFormat::FormatType fmt, const SipiImgInfo &info);
+
+/*! The sidecar file name for `path` with modification time `mtime_ns` and size
+ *  `size`: a path hash followed by the two freshness stamps, so a rewritten
+ *  source maps to a different name. */
+[[nodiscard]] std::string shadow_file_name(const std::string &path, long long mtime_ns, long long size);
+
+/*! Counts decodes of flat sources and builds their shadow pyramids in the background. */
+class ShadowPyramids
+{
+public:
+  /*!
+   * \param dir Shadow directory (created if missing); throws shttps::Error when it cannot be.
+   * \param hot_threshold Decodes of a source after which its shadow is built (0 is treated as 1).
+   * \param max_bytes Size cap of the shadow directory, 0 for none.
+   * \param budget Full-lane memory budget builds are charged to, or null for uncharged builds.
+   * \param min_edge Sources whose longer edge is below this are never shadowed.
+   * \param workers Number of background build threads.
+   */
+  ShadowPyramids(std::string dir,
+    unsigned hot_threshold,
+    std::uintmax_t max_bytes,
+    SipiMemoryBudget *budget,
+    std::size_t min_edge = 1024,
+    unsigned workers = 1);
+
+  /*! Stops the workers; a build in progress is finished, queued ones are dropped. */
+  ~ShadowPyramids();
+
+  ShadowPyramids(const ShadowPyramids &) = delete;
+  ShadowPyramids &operator=(const ShadowPyramids &) = delete;
+
+  /*!
+   * Records a decode of the flat source `path` (shape `info`) and returns the
+   * path of its shadow when a fresh one exists, marking it recently used. A
+   * miss may queue a build.
+   */
+  [[nodiscard]] std::optional<std::string> lookup(const std::string &path, const SipiImgInfo &info);
+
+  /*! Blocks until no build is queued or running. */
+  void drain();
+
+private:
+  struct Job
+  {
+    std::string source;
+    std::string shadow;
+    SipiImgInfo info;
+  };
+
+  void run(const std::stop_token &stop);
+  void build(const Job &job);
+  void sweep();
+
+  std::string dir_;
+  unsigned hot_threshold_;
+  std::uintmax_t max_bytes_;
+  SipiMemoryBudget *budget_;
+  std::size_t min_edge_;
+
+  std::mutex mutex_;
+  std::condition_variable_any wake_;
+  std::condition_variable idle_;
+  std::unordered_map<std::string, unsigned> hits_;//!< decodes per shadow name since its last build attempt
+  std::unordered_set<std::string> pending_;//!< shadow names queued or building
+  std::unordered_map<std::string, std::string> sources_;//!< source path per path-hash prefix, for the orphan sweep
+  std::deque<Job> queue_;
+  unsigned running_{ 0 };
+  std::vector<std::jthread> workers_;
+};
+
+}// namespace Sipi::ffi
+
+#endif// SIPI_FFI_SHADOW_PYRAMIDS_H
@@ -0,0 +1,275 @@
+/*
+ * Copyright © 2016 - 2026 Swiss National Data and Service Center for the Humanities and/or DaSCH Service Platform
+ * contributors. SPDX-License-Identifier: AGPL-3.0-or-later
+ */
+
+// Co-located unit tests for the shadow-pyramid service: a flat source becomes
+// hot after `hot_threshold` decodes, its pyramidal TIFF sidecar decodes to the
+// same pixels, a rewritten source stops matching its shadow, a build without
+// budget headroom or behind queued requests is deferred, the directory sweep
+// drops shadows of deleted sources and the least recently used ones over the
+// size cap, and build_image_response decodes from a ready shadow. Each case
+// copies the lena512.tif fixture (an untiled TIFF) into the scratch directory
+// so it can touch the copy's mtime.
+
+#include "gtest/gtest.h"
+
+#include <algorithm>
+#include <chrono>
+#include <climits>
+#include <cstdlib>
+#include <filesystem>
+#include <functional>
+#include <string>
+#include <thread>
+#include <variant>
+
+#include "SipiImage.h"
+#include "ffi/engine_context.h"
+#include "ffi/serve_image.h"
+#include "ffi/shadow_pyramids.h"
+#include "observability/metrics.h"
+#include "throttling/SipiMemoryBudget.h"
+#include "test_paths.h"
+
+namespace {
+
+using namespace Sipi::ffi;
+namespace fs = std::filesystem;
+
+// A private copy of the fixture plus an empty shadow directory, both under
+// `name` in the scratch directory. Resolved through realpath() for the reason
+// given in serve_image_test.cpp (libmagic must not sniff a runfiles symlink).
+struct Scratch
+{
+  std::string source;
+  std::string shadows;
+};
+
+Scratch scratch(const std::string &name)
+{
+  const fs::path root = fs::path(sipi::test::tmp_dir()) / ("shadow_" + name);
+  fs::remove_all(root);
+  fs::create_directories(root);
+  char buf[PATH_MAX];
+  const std::string fixture = sipi::test::data_dir() + "/images/unit/lena512.tif";
+  const fs::path src = root / "lena512.tif";
+  fs::copy_file(realpath(fixture.c_str(), buf) != nullptr ? std::string(buf) : fixture, src);
+  return { src.string(), (root / "shadows").string() };
+}
+
+Sipi::SipiImgInfo shape(const std::string &path)
+{
+  Sipi::SipiImage probe;
+  return probe.read_shape(path);
+}
+
+TEST(ShadowPyramids, FlatSourcesAreJpegPngAndUntiledTiff)
+{
+  Sipi::SipiImgInfo untiled;
+  Sipi::SipiImgInfo tiled;
+  tiled.tile_width = 256;
+  tiled.tile_height = 256;
+  EXPECT_TRUE(is_flat_source(Sipi::SipiQualityFormat::JPG, tiled));
+  EXPECT_TRUE(is_flat_source(Sipi::SipiQualityFormat::PNG, untiled));
+  EXPECT_TRUE(is_flat_source(Sipi::SipiQualityFormat::TIF, untiled));
+  EXPECT_FALSE(is_flat_source(Sipi::SipiQualityFormat::TIF, tiled));
+  EXPECT_FALSE(is_flat_source(Sipi::SipiQualityFormat::JP2, untiled));
+}
+
+TEST(ShadowPyramids, FileNameTracksMtimeAndSize)
+{
+  const std::string a = shadow_file_name("/img/a.jpg", 1000, 42);
+  EXPECT_EQ(a, shadow_file_name("/img/a.jpg", 1000, 42));
+  EXPECT_NE(a, shadow_file_name("/img/a.jpg", 1001, 42));
+  EXPECT_NE(a, shadow_file_name("/img/a.jpg", 1000, 43));
+  // Versions of one source share the path-hash prefix; other sources do not.
+  EXPECT_EQ(a.substr(0, 16), shadow_file_name("/img/a.jpg", 2000, 7).substr(0, 16));
+  EXPECT_NE(a.substr(0, 16), shadow_file_name("/img/b.jpg", 1000, 42).substr(0, 16));
+}
+
+TEST(ShadowPyramids, HotSourceGetsAPyramidWithTheSamePixels)
+{
+  const auto s = scratch("hot");
+  const auto info = shape(s.source);
+  ASSERT_TRUE(is_flat_source(Sipi::SipiQualityFormat::TIF, info));
+
+  auto &builds = Sipi::observability::Metrics::instance().shadow_pyramid_builds_total;
+  const auto builds_before = builds.Value();
+  ShadowPyramids shadows(s.shadows, 2, 0, nullptr, 0);
+  EXPECT_FALSE(shadows.lookup(s.source, info).has_value());
+  shadows.drain();
+  EXPECT_FALSE(shadows.lookup(s.source, info).has_value());// second decode queues the build
+  shadows.drain();
+  const auto shadow = shadows.lookup(s.source, info);
+  ASSERT_TRUE(shadow.has_value());
+  EXPECT_EQ(builds.Value(), builds_before + 1);
+
+  const auto shadow_info = shape(*shadow);
+  EXPECT_GT(shadow_info.tile_width, 0);
+  EXPECT_EQ(shadow_info.width, info.width);
+  EXPECT_EQ(shadow_info.height, info.height);
+
+  Sipi::SipiImage original;
+  Sipi::SipiImage from_shadow;
+  ASSERT_NO_THROW(original.read(s.source));
+  ASSERT_NO_THROW(from_shadow.read(*shadow));
+  EXPECT_TRUE(original == from_shadow);
+}
+
+TEST(ShadowPyramids, RewrittenSourceMissesItsShadowAndReplacesIt)
+{
+  const auto s = scratch("rewritten");
+  const auto info = shape(s.source);
+  ShadowPyramids shadows(s.shadows, 1, 0, nullptr, 0);
+  EXPECT_FALSE(shadows.lookup(s.source, info).has_value());
+  shadows.drain();
+  const auto old_shadow = shadows.lookup(s.source, info);
+  ASSERT_TRUE(old_shadow.has_value());
+
+  fs::last_write_time(s.source, fs::last_write_time(s.source) + std::chrono::seconds(5));
+  EXPECT_FALSE(shadows.lookup(s.source, info).has_value());
+  shadows.drain();
+  const auto new_shadow = shadows.lookup(s.source, info);
+  ASSERT_TRUE(new_shadow.has_value());
+  EXPECT_NE(*new_shadow, *old_shadow);
+  EXPECT_FALSE(fs::exists(*old_shadow));
+}
+
+TEST(ShadowPyramids, BuildWithoutBudgetHeadroomIsDeferred)
+{
+  const auto s = scratch("deferred");
+  const auto info = shape(s.source);
+  auto &deferred = Sipi::observability::Metrics::instance().shadow_pyramid_deferred_total;
+  const auto deferred_before = deferred.Value();
+
+  Sipi::SipiMemoryBudget budget(4096, Sipi::AdmissionMode::BASIC);
+  ShadowPyramids shadows(s.shadows, 1, 0, &budget, 0);
+  EXPECT_FALSE(shadows.lookup(s.source, info).has_value());
+  shadows.drain();
+  EXPECT_EQ(deferred.Value(), deferred_before + 1);
+  EXPECT_EQ(budget.used(), 0U);
+  EXPECT_TRUE(fs::is_empty(s.shadows));
+}
+
+TEST(ShadowPyramids, BuildBehindQueuedRequestsIsDeferred)
+{
+  const auto s = scratch("queued");
+  const auto info = shape(s.source);
+  auto &deferred = Sipi::observability::Metrics::instance().shadow_pyramid_deferred_total;
+  const auto deferred_before = deferred.Value();
+
+  // A quarter of the lane in use and a request waiting for more than the rest:
+  // the build would fit with half the lane to spare, but must not overtake it.
+  constexpr std::size_t MiB = 1024 * 1024;
+  Sipi::SipiMemoryBudget budget(64 * MiB, Sipi::AdmissionMode::ADVANCED, 4);
+  ASSERT_TRUE(budget.try_acquire(16 * MiB).allowed);
+  std::thread waiter([&budget] {
+    if (budget.acquire(56 * MiB, std::chrono::steady_clock::now() + std::chrono::seconds(30)).allowed) {
+      budget.release(56 * MiB);
+    }
+  });
+  while (budget.waiting() == 0) { std::this_thread::yield(); }
+
+  ShadowPyramids shadows(s.shadows, 1, 0, &budget, 0);
+  EXPECT_FALSE(shadows.lookup(s.source, info).has_value());
+  shadows.drain();
+  EXPECT_EQ(deferred.Value(), deferred_before + 1);
+  EXPECT_TRUE(fs::is_empty(s.shadows));
+
+  budget.release(16 * MiB);
+  waiter.join();
+  EXPECT_EQ(budget.used(), 0U);
+}
+
+TEST(ShadowPyramids, DeletedSourceLosesItsShadow)
+{
+  const auto s = scratch("deleted");
+  const auto info = shape(s.source);
+  const std::string other = (fs::path(s.source).parent_path() / "other.tif").string();
+  fs::copy_file(s.source, other);
+  ShadowPyramids shadows(s.shadows, 1, 0, nullptr, 0);
+  EXPECT_FALSE(shadows.lookup(s.source, info).has_value());
+  shadows.drain();
+  const auto orphan = shadows.lookup(s.source, info);
+  ASSERT_TRUE(orphan.has_value());
+
+  fs::remove(s.source);
+  EXPECT_FALSE(shadows.lookup(other, info).has_value());// the next build sweeps
+  shadows.drain();
+  EXPECT_TRUE(shadows.lookup(other, info).has_value());
+  EXPECT_FALSE(fs::exists(*orphan));
+}
+
+TEST(ShadowPyramids, SizeCapEvictsTheLeastRecentlyUsed)
+{
+  const auto s = scratch("capped");
+  const auto info = shape(s.source);
+  const std::string other = (fs::path(s.source).parent_path() / "other.tif").string();
+  fs::copy_file(s.source, other);
+  std::string stale;
+  std::string recent;
+  {
+    ShadowPyramids shadows(s.shadows, 1, 0, nullptr, 0);
+    EXPECT_FALSE(shadows.lookup(s.source, info).has_value());
+    EXPECT_FALSE(shadows.lookup(other, info).has_value());
+    shadows.drain();
+    stale = shadows.lookup(s.source, info).value_or("");
+    recent = shadows.lookup(other, info).value_or("");
+    ASSERT_FALSE(stale.empty());
+    ASSERT_FALSE(recent.empty());
+  }
+  fs::last_write_time(stale, fs::last_write_time(recent) - std::chrono::hours(1));
+
+  // Room for one of the two: the startup sweep keeps the more recently served.
+  const auto cap = std::max(fs::file_size(stale), fs::file_size(recent));
+  ShadowPyramids shadows(s.shadows, 1, cap, nullptr, 0);
+  EXPECT_FALSE(fs::exists(stale));
+  EXPECT_EQ(shadows.lookup(other, info), recent);
+}
+
+TEST(ShadowPyramids, SourcesBelowTheMinimumEdgeAreNotShadowed)
+{
+  const auto s = scratch("small");
+  const auto info = shape(s.source);
+  ShadowPyramids shadows(s.shadows, 1, 0, nullptr, static_cast<std::size_t>(info.width) + 1);
+  for (int i = 0; i < 3; ++i) { EXPECT_FALSE(shadows.lookup(s.source, info).has_value()); }
+  shadows.drain();
+  EXPECT_TRUE(fs::is_empty(s.shadows));
+}
+
+TEST(ShadowPyramids, ServePathDecodesFromAReadyShadow)
+{
+  const auto s = scratch("serve");
+  const auto info = shape(s.source);
+  ShadowPyramids shadows(s.shadows, 1, 0, nullptr, 0);
+  EXPECT_FALSE(shadows.lookup(s.source, info).has_value());
+  shadows.drain();
+
+  EngineContext eng;
+  eng.shadow_pyramids = &shadows;
+  eng.jpeg_quality = 60;
+  SipiIiifParams params{};
+  params.region_type = SIPI_REGION_FULL;
+  params.size_type = SIPI_SIZE_FULL;
+  params.quality_type = SIPI_QUALITY_DEFAULT;
+  params.format_type = SIPI_FORMAT_PNG;
+  SipiServeRequest req{};
+  req.resolved_path = s.source.c_str();
+  req.prefix = "unit";
+  req.identifier = "lena512.tif";
+  req.client_ip = "127.0.0.1";
+  req.params = params;
+  req.forwarded_host = "localhost";
+  req.request_uri = "/unit/lena512.tif";
+
+  auto &hits = Sipi::observability::Metrics::instance().shadow_pyramid_hits_total;
+  const auto hits_before = hits.Value();
+  const auto result = build_image_response(req, eng, [] { return false; });
+  ASSERT_TRUE(result.has_value());
+  EXPECT_EQ(result->http_status, 200);
+  EXPECT_TRUE(std::holds_alternative<StreamBody>(result->body));
+  EXPECT_EQ(hits.Value(), hits_before + 1);
+}
+
+}// namespace
@@ -10,22 +10,52 @@
 #include <cstdint>
 #include <memory>
 #include <optional>
+#include <span>
 #include <string>
 #include <utility>
 
 #include "SipiImage.h"// SipiImage::read_shape (sipi_image_dims)
+#include "ffi/decode_amplification.h"// DecodeAmplification::top (sipi_decode_offenders)
 #include "ffi/engine_context.h"
 #include "ffi/metrics_snapshot.h"
 #include "ffi/serve_image.h"
 #include "ffi/serve_response.h"
 #include "ffi/serve_timings.h"// serve_timings_reset/export (sipi_serve_timings_take)
 #include "generated/SipiVersion.h"// VERSION / BUILD_SCM_REVISION (sipi_build_version/commit)
-#include "logging/logger.h"// set_log_trace_context (sipi_set_log_trace_context)
+#include "logging/logger.h"// set_log_trace_context (sipi_set_log_trace_context), log_warn, log_dropped_lines
+#include "observability/flight_recorder.h"
 #include "observability/metrics.h"
+#include "throttling/SipiPeakCalibration.h"// Sipi::set_heap_reader (sipi_set_heap_reader)
 #include "util/Parsing.h"// shttps::Parsing::getBestFileMimetype (sipi_mimetype)
 
+// The C handle behind `SipiServePlan`: the engine's plan plus the per-serve
+// observations and flight recording made while planning, carried to whichever
+// thread serves it.
+struct SipiServePlan
+{
+  Sipi::ffi::ServePlan plan;
+  Sipi::ffi::ServeTimingsState timings;
+  Sipi::observability::FlightRequest flight;
+};
+
 namespace {
 
+// End one serve's flight recording: the recorder keeps it if it was slow, and
+// a kept capture is logged as a one-line summary (the log line carries the
+// serve's trace id), so it reaches the operator without a reader on the seam;
+// the zones stay with `sipi_flight_captures`. Guarded, since keeping a capture
+// allocates.
+void finish_flight(Sipi::observability::FlightRequest &&flight, int status) noexcept
+{
+  (void)Sipi::ffi::sipi_guard([&] {
+    flight.note("status", static_cast<std::uint64_t>(status));
+    std::string summary;
+    if (Sipi::observability::FlightRecorder::instance().finish(std::move(flight), &summary)) {
+      log_warn("slow request kept by the flight recorder: %s", summary.c_str());
+    }
+    return static_cast<int>(Sipi::ffi::SipiStatus::Ok);
+  });
+}
 
 }// namespace
 
@@ -51,7 +81,10 @@ int sipi_serve_image(const SipiServeRequest *req, const SipiResponse *resp)
   // → apply (the only place that touches the response callbacks), all under the
   // no-throw guard. A return of 499 (SipiStatus::ClientGone) means the client
   // vanished mid-decode and nothing was emitted — the caller renders no error.
-  return Sipi::ffi::sipi_guard([&] {
+  // The serve is flight-recorded whatever its outcome.
+  Sipi::observability::FlightRequest flight;
+  const int status = Sipi::ffi::sipi_guard([&] {
+    const Sipi::observability::FlightAttach attach(flight);
     // Reset the per-phase timing accumulator for this thread; the phase timers in
     // build_image_response + the streamed encode fill it, and the shell reads it
     // back via sipi_serve_timings_take right after this returns.
@@ -62,6 +95,91 @@ int sipi_serve_image(const SipiServeRequest *req, const SipiResponse *resp)
     Sipi::ffi::apply(std::move(*result), *resp);
     return static_cast<int>(Sipi::ffi::SipiStatus::Ok);
   });
+  finish_flight(std::move(flight), status);
+  return status;
+}
+
+int sipi_plan_image(const SipiServeRequest *req, SipiServePlan **plan, SipiPlanInfo *info)
+{
+  // Guard-only: nothing is emitted, the plan is handed back for a later
+  // sipi_serve_planned (or sipi_plan_free). The flight recording starts here, so
+  // a capture shows the wait between planning and serving; a failed plan ends it.
+  *plan = nullptr;
+  Sipi::observability::FlightRequest flight;
+  const int status = Sipi::ffi::sipi_guard([&] {
+    const Sipi::observability::FlightAttach attach(flight);
+    Sipi::ffi::serve_timings_reset();
+    auto planned = Sipi::ffi::plan_image(*req, Sipi::ffi::engine_context());
+    if (!planned) { return static_cast<int>(planned.error()); }
+    info->route = planned->route();
+    info->full_lane = planned->full_lane() ? 1 : 0;
+    info->decode_estimate_bytes = static_cast<std::uint64_t>(planned->decode_estimate());
+    *plan = new SipiServePlan{ std::move(*planned), Sipi::ffi::serve_timings_save(), {} };
+    return static_cast<int>(Sipi::ffi::SipiStatus::Ok);
+  });
+  if (*plan != nullptr) {
+    (*plan)->flight = std::move(flight);
+  } else {
+    finish_flight(std::move(flight), status);
+  }
+  return status;
+}
+
+int sipi_serve_planned(SipiServePlan *plan,
+  const SipiResponse *resp,
+  SipiReportErrorFn report_error,
+  void *report_ctx)
+{
+  // The second half of sipi_serve_image: same build → apply split, with the
+  // planning thread's observations restored in place of the reset. A NULL plan
+  // (a failed sipi_plan_image served anyway) is the caller's bug: 500, nothing
+  // to record.
+  if (plan == nullptr) { return static_cast<int>(Sipi::ffi::SipiStatus::InternalError); }
+  std::unique_ptr<SipiServePlan> owned(plan);
+  const int status = Sipi::ffi::sipi_guard([&] {
+    const Sipi::observability::FlightAttach attach(owned->flight);
+    Sipi::ffi::serve_timings_restore(owned->timings);
+    const auto cancelled = [resp] { return resp->cancelled != nullptr && resp->cancelled(resp->ctx) != 0; };
+    auto result = Sipi::ffi::execute_plan(
+      std::move(owned->plan), Sipi::ffi::engine_context(), cancelled, report_error, report_ctx);
+    if (!result) { return static_cast<int>(result.error()); }
+    Sipi::ffi::apply(std::move(*result), *resp);
+    return static_cast<int>(Sipi::ffi::SipiStatus::Ok);
+  });
+  finish_flight(std::move(owned->flight), status);
+  return status;
+}
+
+void sipi_plan_free(SipiServePlan *plan) { delete plan; }
+
+int sipi_render_tiles(const char *resolved_path,
+  const SipiIiifParams *tiles,
+  size_t count,
+  const char *restricted_size,
+  const char *watermark_path,
+  SipiTileFn emit,
+  void *ctx)
+{
+  // No response sink: each tile goes to the caller's callback as it is
+  // encoded, so there is no build/apply split, only the no-throw guard.
+  Sipi::observability::FlightRequest flight;
+  const int status = Sipi::ffi::sipi_guard([&] {
+    const Sipi::observability::FlightAttach attach(flight);
+    Sipi::observability::flight_note("route", std::string("tiles"));
+    Sipi::observability::flight_note("tiles", static_cast<std::uint64_t>(count));
+    const std::span<const SipiIiifParams> batch(tiles, tiles != nullptr ? count : 0);
+    const auto rendered = Sipi::ffi::render_tiles(resolved_path,
+      batch,
+      restricted_size != nullptr ? restricted_size : "",
+      watermark_path != nullptr ? watermark_path : "",
+      Sipi::ffi::engine_context(),
+      [emit, ctx](std::size_t index, Sipi::ffi::SipiStatus st, std::span<const std::uint8_t> bytes) {
+        return emit(ctx, index, static_cast<int>(st), bytes.data(), bytes.size()) == 0;
+      });
+    return static_cast<int>(rendered);
+  });
+  finish_flight(std::move(flight), status);
+  return status;
 }
 
 void sipi_serve_timings_take(SipiServeTimings *out) { Sipi::ffi::serve_timings_export(out); }
@@ -239,6 +357,27 @@ int sipi_metrics_snapshot(SipiMetricsSnapshot *out)
     out->decode_memory_too_large_total = counter(m.decode_memory_too_large_total);
     out->decode_memory_shadow_too_large_total = counter(m.decode_memory_shadow_too_large_total);
 
+    out->shadow_pyramid_hits_total = counter(m.shadow_pyramid_hits_total);
+    out->shadow_pyramid_builds_total = counter(m.shadow_pyramid_builds_total);
+    out->shadow_pyramid_deferred_total = counter(m.shadow_pyramid_deferred_total);
+
+    out->decode_cancelled_total = counter(m.decode_cancelled_total);
+    out->decode_wasted_microseconds_total = counter(m.decode_wasted_microseconds_total);
+    out->decode_degraded_total = counter(m.decode_degraded_total);
+    out->decode_memory_waited_total = counter(m.decode_memory_waited_total);
+    out->decode_memory_wait_microseconds_total = counter(m.decode_memory_wait_microseconds_total);
+    out->decode_memory_calibration_samples_total = counter(m.decode_memory_calibration_samples_total);
+    out->decoded_pixels_total = counter(m.decoded_pixels_total);
+    out->decode_output_pixels_total = counter(m.decode_output_pixels_total);
+
+    // The logger keeps its own counters, outside the metrics singleton; only
+    // levels below LL_ERR are ever rate-limited.
+    out->log_dropped_lines_total = log_dropped_lines();
+    out->log_suppressed_lines_total = 0;
+    for (const LogLevel ll : { LL_DEBUG, LL_INFO, LL_NOTICE, LL_WARNING }) {
+      out->log_suppressed_lines_total += log_suppressed_lines(ll);
+    }
+
     out->waiting_connections = gauge(m.waiting_connections);
     out->cache_size_bytes = gauge(m.cache_size_bytes);
     out->cache_files = gauge(m.cache_files);
@@ -246,11 +385,43 @@ int sipi_metrics_snapshot(SipiMetricsSnapshot *out)
     out->cache_files_limit = gauge(m.cache_files_limit);
     out->decode_memory_budget_bytes = gauge(m.decode_memory_budget_bytes);
     out->decode_memory_used_bytes = gauge(m.decode_memory_used_bytes);
+    out->decode_memory_waiting = gauge(m.decode_memory_waiting);
+    out->decode_memory_calibration_factor_max_percent = gauge(m.decode_memory_calibration_factor_max_percent);
 
     return static_cast<int>(Sipi::ffi::SipiStatus::Ok);
   });
 }
 
+int sipi_flight_captures(SipiStrFn emit, void *ctx)
+{
+  // Guard-only: the JSON is rendered under the recorder's lock, emitted after.
+  return Sipi::ffi::sipi_guard([&] {
+    const std::string json = Sipi::observability::FlightRecorder::instance().to_json();
+    emit(ctx, json.c_str());
+    return static_cast<int>(Sipi::ffi::SipiStatus::Ok);
+  });
+}
+
+int sipi_decode_offenders(size_t max, SipiDecodeOffenderFn emit, void *ctx)
+{
+  // Guard-only, like sipi_metrics_snapshot: a copy of the table taken under its
+  // lock, then emitted with the lock released, so a slow callback holds up no
+  // decode. engine_context() throws before sipi_init → 500 via the guard.
+  return Sipi::ffi::sipi_guard([&] {
+    const auto *table = Sipi::ffi::engine_context().decode_amplification;
+    if (table == nullptr) { return static_cast<int>(Sipi::ffi::SipiStatus::Ok); }
+    for (const auto &entry : table->top(max)) {
+      const SipiDecodeOffender offender{ .path = entry.path.c_str(),
+        .requests = entry.requests,
+        .decoded_pixels = entry.decoded_pixels,
+        .output_pixels = entry.output_pixels,
+        .amplification = entry.amplification,
+        .error = entry.error };
+      emit(ctx, &offender);
+    }
+    return static_cast<int>(Sipi::ffi::SipiStatus::Ok);
+  });
+}
 
 void sipi_set_log_trace_context(const char *trace_id, const char *span_id)
 {
@@ -272,4 +443,6 @@ void sipi_set_outbound_traceparent(const char *traceparent)
   }
 }
 
+void sipi_set_heap_reader(SipiHeapInUseFn reader) { Sipi::set_heap_reader(reader); }
+
 }// extern "C"
@@ -54,6 +54,16 @@ extern "C" {
  *  formats/ffi layer boundary; each header stays self-contained. */
 typedef int (*SipiWriteFn)(void *ctx, const uint8_t *data, size_t len);
 
+/*! Frees a buffer handed over by `SipiWriteOwnedFn`. Callable from any thread. */
+typedef void (*SipiReleaseFn)(uint8_t *data);
+
+/*! Like `SipiWriteFn`, but ownership of `data` passes to the transport, which
+ *  forwards the bytes without copying and calls `release(data)` exactly once
+ *  when done — also when the write fails. Optional (NULL → the engine uses
+ *  `write`); the engine uses it for bodies it already holds as one heap buffer
+ *  (the in-memory TIFF). Structurally identical to `Sipi::SipiWriteOwnedFn`. */
+typedef int (*SipiWriteOwnedFn)(void *ctx, uint8_t *data, size_t len, SipiReleaseFn release);
+
 /*! Deliver a **known-length** file region `[offset, offset+length)` to the
  *  body. The size is known, so the transport frames it with Content-Length
  *  (and may use zero-copy `sendfile(2)`) — the right shape for raw file
@@ -84,6 +94,7 @@ typedef struct
   SipiWriteFn write;
   SipiSendFileFn send_file;
   SipiCancelledFn cancelled;
+  SipiWriteOwnedFn write_owned;
 } SipiResponse;
 
 /* ── IIIF serve request (consumed by sipi_serve_image) ──────────────────────
@@ -215,6 +226,7 @@ typedef struct
   const char *forwarded_host; /* X-Forwarded-Host  → canonical-URL `id` (host for the canonical URL) */
   const char *request_uri; /* raw request URI — error/log context only (Sentry), or NULL */
   int is_head; /* 1 = HEAD: emit status + headers, no body, no cache write */
+  uint32_t deadline_ms; /* 0 = none; else ms from the plan to answer in, degrading if need be (degraded_render.h) */
   SipiReportErrorFn report_error; /* handled-error side-channel report, or NULL = not wanted */
   void *report_ctx; /* opaque data passed to report_error (the Rust edge: the request URI) */
 } SipiServeRequest;
@@ -285,6 +297,13 @@ typedef struct SipiServerConfig
   const char *scaling_quality_tiff;
   const char *scaling_quality_png;
   const char *scaling_quality_j2k;
+  /* "exact" | "luminance" | "luminance_toned" (NULL = exact): how a `gray`
+   * rendering of a colour JPEG2000 decodes. TOML/Lua-config-only. */
+  const char *j2k_gray_decode;
+  /* Shadow-pyramid directory for hot flat sources (NULL/empty = off), and
+   * its size cap. TOML/Lua-config-only. */
+  const char *shadow_dir;
+  const char *shadow_max_size;    /* raw "10G" cap of shadow_dir — engine parses the suffix; "-1" = unlimited */
   /* 8-byte: 64-bit scalar values (presence via the has_ flags below) */
   double tiles_memory_ratio;            /* fraction of the envelope reserved for tiles; full lane = envelope × (1 − ratio) */
   uint64_t large_decode_threshold_bytes;/* estimated peak >= this => full lane (charged); below => tile (bypass) */
@@ -294,14 +313,22 @@ typedef struct SipiServerConfig
   uint32_t cache_nfiles;          /* 0 = unlimited; a negative is rejected at the CLI (no wrap) */
   int32_t pathprefix;             /* prefix_as_path, bool carried as 0/1 */
   int32_t jpeg_quality;           /* JPEG output quality (1-100); TOML-config-only */
+  int32_t j2k_layer_truncation_size; /* longest output edge (px) up to which JPEG2000 decodes drop quality layers; 0 = off */
+  uint32_t shadow_hot_threshold;  /* decodes of a flat source after which its shadow pyramid is built; TOML/Lua-config-only */
+  uint32_t slow_request_ms;       /* flight-recorder threshold (ms): slower serves are kept and logged; 0 = off */
+  uint32_t log_rate_limit;        /* server-mode log lines per second per level below ERR; 0 = off */
   /* 4-byte presence flags for the scalars above (non-zero = present) */
   int has_serverport;
   int has_maxtmpage;
   int has_cache_nfiles;
   int has_pathprefix;
   int has_jpeg_quality;
+  int has_j2k_layer_truncation_size;
   int has_tiles_memory_ratio;
   int has_large_decode_threshold_bytes;
+  int has_shadow_hot_threshold;
+  int has_slow_request_ms;
+  int has_log_rate_limit;
 } SipiServerConfig;
 
 #ifdef __cplusplus
@@ -310,7 +337,7 @@ typedef struct SipiServerConfig
  * breaks one of the two. LP64 on every supported target (darwin-aarch64,
  * linux-x86_64, linux-aarch64). */
 static_assert(sizeof(void *) == 8, "SipiServerConfig layout assumes an LP64 target");
-static_assert(sizeof(SipiServerConfig) == 240, "SipiServerConfig size drifted from src/server-rs/src/config.rs");
+static_assert(sizeof(SipiServerConfig) == 296, "SipiServerConfig size drifted from src/server-rs/src/config.rs");
 static_assert(offsetof(SipiServerConfig, imgroot) == 0, "SipiServerConfig layout drift");
 static_assert(offsetof(SipiServerConfig, scriptdir) == 8, "SipiServerConfig layout drift");
 static_assert(offsetof(SipiServerConfig, initscript) == 16, "SipiServerConfig layout drift");
@@ -333,20 +360,31 @@ static_assert(offsetof(SipiServerConfig, scaling_quality_jpeg) == 144, "SipiServ
 static_assert(offsetof(SipiServerConfig, scaling_quality_tiff) == 152, "SipiServerConfig layout drift");
 static_assert(offsetof(SipiServerConfig, scaling_quality_png) == 160, "SipiServerConfig layout drift");
 static_assert(offsetof(SipiServerConfig, scaling_quality_j2k) == 168, "SipiServerConfig layout drift");
-static_assert(offsetof(SipiServerConfig, tiles_memory_ratio) == 176, "SipiServerConfig layout drift");
-static_assert(offsetof(SipiServerConfig, large_decode_threshold_bytes) == 184, "SipiServerConfig layout drift");
-static_assert(offsetof(SipiServerConfig, serverport) == 192, "SipiServerConfig layout drift");
-static_assert(offsetof(SipiServerConfig, maxtmpage) == 196, "SipiServerConfig layout drift");
-static_assert(offsetof(SipiServerConfig, cache_nfiles) == 200, "SipiServerConfig layout drift");
-static_assert(offsetof(SipiServerConfig, pathprefix) == 204, "SipiServerConfig layout drift");
-static_assert(offsetof(SipiServerConfig, jpeg_quality) == 208, "SipiServerConfig layout drift");
-static_assert(offsetof(SipiServerConfig, has_serverport) == 212, "SipiServerConfig layout drift");
-static_assert(offsetof(SipiServerConfig, has_maxtmpage) == 216, "SipiServerConfig layout drift");
-static_assert(offsetof(SipiServerConfig, has_cache_nfiles) == 220, "SipiServerConfig layout drift");
-static_assert(offsetof(SipiServerConfig, has_pathprefix) == 224, "SipiServerConfig layout drift");
-static_assert(offsetof(SipiServerConfig, has_jpeg_quality) == 228, "SipiServerConfig layout drift");
-static_assert(offsetof(SipiServerConfig, has_tiles_memory_ratio) == 232, "SipiServerConfig layout drift");
-static_assert(offsetof(SipiServerConfig, has_large_decode_threshold_bytes) == 236, "SipiServerConfig layout drift");
+static_assert(offsetof(SipiServerConfig, j2k_gray_decode) == 176, "SipiServerConfig layout drift");
+static_assert(offsetof(SipiServerConfig, shadow_dir) == 184, "SipiServerConfig layout drift");
+static_assert(offsetof(SipiServerConfig, shadow_max_size) == 192, "SipiServerConfig layout drift");
+static_assert(offsetof(SipiServerConfig, tiles_memory_ratio) == 200, "SipiServerConfig layout drift");
+static_assert(offsetof(SipiServerConfig, large_decode_threshold_bytes) == 208, "SipiServerConfig layout drift");
+static_assert(offsetof(SipiServerConfig, serverport) == 216, "SipiServerConfig layout drift");
+static_assert(offsetof(SipiServerConfig, maxtmpage) == 220, "SipiServerConfig layout drift");
+static_assert(offsetof(SipiServerConfig, cache_nfiles) == 224, "SipiServerConfig layout drift");
+static_assert(offsetof(SipiServerConfig, pathprefix) == 228, "SipiServerConfig layout drift");
+static_assert(offsetof(SipiServerConfig, jpeg_quality) == 232, "SipiServerConfig layout drift");
+static_assert(offsetof(SipiServerConfig, j2k_layer_truncation_size) == 236, "SipiServerConfig layout drift");
+static_assert(offsetof(SipiServerConfig, shadow_hot_threshold) == 240, "SipiServerConfig layout drift");
+static_assert(offsetof(SipiServerConfig, slow_request_ms) == 244, "SipiServerConfig layout drift");
+static_assert(offsetof(SipiServerConfig, log_rate_limit) == 248, "SipiServerConfig layout drift");
+static_assert(offsetof(SipiServerConfig, has_serverport) == 252, "SipiServerConfig layout drift");
+static_assert(offsetof(SipiServerConfig, has_maxtmpage) == 256, "SipiServerConfig layout drift");
+static_assert(offsetof(SipiServerConfig, has_cache_nfiles) == 260, "SipiServerConfig layout drift");
+static_assert(offsetof(SipiServerConfig, has_pathprefix) == 264, "SipiServerConfig layout drift");
+static_assert(offsetof(SipiServerConfig, has_jpeg_quality) == 268, "SipiServerConfig layout drift");
+static_assert(offsetof(SipiServerConfig, has_j2k_layer_truncation_size) == 272, "SipiServerConfig layout drift");
+static_assert(offsetof(SipiServerConfig, has_tiles_memory_ratio) == 276, "SipiServerConfig layout drift");
+static_assert(offsetof(SipiServerConfig, has_large_decode_threshold_bytes) == 280, "SipiServerConfig layout drift");
+static_assert(offsetof(SipiServerConfig, has_shadow_hot_threshold) == 284, "SipiServerConfig layout drift");
+static_assert(offsetof(SipiServerConfig, has_slow_request_ms) == 288, "SipiServerConfig layout drift");
+static_assert(offsetof(SipiServerConfig, has_log_rate_limit) == 292, "SipiServerConfig layout drift");
 #endif
 
 /* Engine-counter snapshot for `sipi_metrics_snapshot`. Incomplete here on
@@ -385,7 +423,8 @@ typedef void (*SipiEssentialsFn)(void *ctx, const char *orig_mimetype, const cha
 
 /* ── Per-serve observations ──────────────────────────────────────────────────
  * What one `sipi_serve_image` call observed about itself: nanosecond timings per
- * phase (relative to the call's start) plus the decode-memory estimate. The
+ * phase (relative to the call's start), what each phase cost in thread CPU,
+ * storage reads, heap and sink back-pressure, plus the decode-memory estimate. The
  * engine accumulates them in a thread-local during the
  * call; `sipi_serve_timings_take` reads that accumulator, so the caller must
  * call it on the SAME thread immediately after `sipi_serve_image` returns. A
@@ -398,7 +437,8 @@ typedef void (*SipiEssentialsFn)(void *ctx, const char *orig_mimetype, const cha
  *
  * Caveat: SIPI_PHASE_ENCODE spans the streamed encode *and* the write to the
  * response sink, so a slow/back-pressured HTTP client inflates its `dur_ns` with
- * client-side wait, not just codec CPU. */
+ * client-side wait, not just codec CPU. `sink_wait_ns` is that wait, so
+ * `dur_ns − sink_wait_ns` is the encode's own time. */
 typedef enum {
   SIPI_PHASE_SHAPE = 0, /* header/shape probe (source open, no full decode) */
   SIPI_PHASE_DECODE = 1, /* SipiImage::read — decode + region + scale */
@@ -409,6 +449,20 @@ typedef enum {
   SIPI_PHASE_COUNT = 6 /* sentinel: number of phases, not a phase index */
 } SipiPhase;
 
+/* How a serve got its pixels — the decode-amplification label. A decode is
+ * PYRAMID when it read a reduced resolution level (a TIFF pyramid directory,
+ * JPEG2000 wavelet levels, or a shadow pyramid), DCT_SCALED when a JPEG decoded
+ * at 1/2, 1/4 or 1/8 in the DCT domain, FULL otherwise. */
+typedef enum {
+  SIPI_DECODE_PATH_NONE = 0, /* no body from the image (HEAD, or failed before its route) */
+  SIPI_DECODE_PATH_FULL = 1,
+  SIPI_DECODE_PATH_DCT_SCALED = 2,
+  SIPI_DECODE_PATH_PYRAMID = 3,
+  SIPI_DECODE_PATH_PASSTHROUGH = 4, /* the source file as-is */
+  SIPI_DECODE_PATH_CACHE_HIT = 5,
+  SIPI_DECODE_PATH_COPY = 6 /* compressed-domain copy, no pixel decode */
+} SipiDecodePath;
+
 typedef struct
 {
   uint64_t start_ns[SIPI_PHASE_COUNT]; /* offset from the serve call's start */
@@ -423,8 +477,65 @@ typedef struct
    * post-call read; the caller records it into a histogram the flat
    * `SipiMetricsSnapshot` cannot carry. */
   uint64_t decode_estimate_bytes;
+  /* Measured peak heap rise of this serve's decode and transforms, in bytes —
+   * what the estimator is calibrated against (`sipi_set_heap_reader`). 0 when
+   * the decode was not measured: no heap reader, a tile or degraded decode, or
+   * other engine work (any serve, a shadow build) in flight at the same time. */
+  uint64_t decode_measured_peak_bytes;
+  /* Per-phase resources, 0 where `present` is 0. `cpu_ns`: the thread's CPU
+   * time (CLOCK_THREAD_CPUTIME_ID). `sink_wait_ns`: time blocked inside the
+   * response sink's write callbacks. `read_bytes`: bytes the thread read from
+   * storage (page-cache hits excluded; 0 where the OS does not report it).
+   * `heap_peak_bytes`: peak rise of the live heap, read from the allocator
+   * reader (`sipi_set_heap_reader`) at the phase's bounds, and at the codec
+   * checkpoints only while a full-lane decode is measured for the calibration;
+   * process-wide, so concurrent serves inflate it; 0 without a reader. */
+  uint64_t cpu_ns[SIPI_PHASE_COUNT];
+  uint64_t sink_wait_ns[SIPI_PHASE_COUNT];
+  uint64_t read_bytes[SIPI_PHASE_COUNT];
+  uint64_t heap_peak_bytes[SIPI_PHASE_COUNT];
+  /* Decode amplification. `decoded_pixels`: pixels the codec decoded (whole
+   * tiles, strips or frames, at the level it read); `output_pixels`: pixels of
+   * the rendering encoded from them; both 0 unless a decode ran.
+   * `source_bytes`: compressed bytes read for the body — what the codec
+   * fetched where it reports it (TIFF tiles and strips, JPEG2000 code-blocks),
+   * else the decoded file's size; the file's size for a passthrough or cache
+   * hit; 0 for a compressed-domain copy. `response_bytes`: body bytes handed to
+   * the sink. `source_format`: the requested source's format (a shadow
+   * pyramid's source keeps its own). */
+  uint64_t decoded_pixels;
+  uint64_t output_pixels;
+  uint64_t source_bytes;
+  uint64_t response_bytes;
+  SipiFormatType source_format;
+  SipiDecodePath decode_path;
 } SipiServeTimings;
 
+/* ── Serve plans (sipi_plan_image → sipi_serve_planned) ─────────────────────
+ * An IIIF image request split in two: the plan runs everything up to the first
+ * pixel (shape, size math, canonical URL, cache probe, memory estimate) and
+ * reports how the request will be served, so the shell admits it on the
+ * engine's own numbers — the lane from `full_lane`, no permit at all for a
+ * route that decodes nothing — before the serve runs the rest. */
+typedef enum {
+  SIPI_PLAN_DECODE = 0, /* decode + transform + encode */
+  SIPI_PLAN_HEAD = 1, /* HEAD: headers only */
+  SIPI_PLAN_PASSTHROUGH = 2, /* the source file as-is */
+  SIPI_PLAN_CACHE_HIT = 3, /* a pinned cache file */
+  SIPI_PLAN_COPY = 4 /* compressed-domain copy, no pixel decode */
+} SipiPlanRoute;
+
+typedef struct
+{
+  SipiPlanRoute route;
+  int full_lane; /* 1 = decode estimate >= large_decode_threshold_bytes */
+  uint64_t decode_estimate_bytes; /* exact peak decode memory; 0 unless SIPI_PLAN_DECODE */
+} SipiPlanInfo;
+
+/*! Opaque plan handle; owned by the caller until passed to `sipi_serve_planned`
+ *  or `sipi_plan_free`. Not tied to a thread. */
+typedef struct SipiServePlan SipiServePlan;
+
 #ifdef __cplusplus
 /* Lock-step ABI guard for the hand-mirrored seam types — paired with the Rust
  * `offset_of!`/`size_of` tests and `const _` enum asserts in
@@ -468,14 +579,15 @@ static_assert(SIPI_EXTERNAL == 4, "SipiPermType drift");
 static_assert(SIPI_RESTRICT == 5, "SipiPermType drift");
 static_assert(SIPI_DENY == 6, "SipiPermType drift");
 
-/* SipiResponse — void* + five callback pointers. */
-static_assert(sizeof(SipiResponse) == 48, "SipiResponse size drifted from src/server-rs/src/ffi.rs");
+/* SipiResponse — void* + six callback pointers. */
+static_assert(sizeof(SipiResponse) == 56, "SipiResponse size drifted from src/server-rs/src/ffi.rs");
 static_assert(offsetof(SipiResponse, ctx) == 0, "SipiResponse layout drift");
 static_assert(offsetof(SipiResponse, set_status) == 8, "SipiResponse layout drift");
 static_assert(offsetof(SipiResponse, add_header) == 16, "SipiResponse layout drift");
 static_assert(offsetof(SipiResponse, write) == 24, "SipiResponse layout drift");
 static_assert(offsetof(SipiResponse, send_file) == 32, "SipiResponse layout drift");
 static_assert(offsetof(SipiResponse, cancelled) == 40, "SipiResponse layout drift");
+static_assert(offsetof(SipiResponse, write_owned) == 48, "SipiResponse layout drift");
 
 /* SipiIiifParams — the flattened IIIF params (also nested in SipiServeRequest). */
 static_assert(sizeof(SipiIiifParams) == 72, "SipiIiifParams size drifted from src/server-rs/src/ffi.rs");
@@ -505,10 +617,22 @@ static_assert(offsetof(SipiServeRequest, forwarded_proto) == 120, "SipiServeRequ
 static_assert(offsetof(SipiServeRequest, forwarded_host) == 128, "SipiServeRequest layout drift");
 static_assert(offsetof(SipiServeRequest, request_uri) == 136, "SipiServeRequest layout drift");
 static_assert(offsetof(SipiServeRequest, is_head) == 144, "SipiServeRequest layout drift");
+static_assert(offsetof(SipiServeRequest, deadline_ms) == 148, "SipiServeRequest layout drift");
 static_assert(offsetof(SipiServeRequest, report_error) == 152, "SipiServeRequest layout drift");
 static_assert(offsetof(SipiServeRequest, report_ctx) == 160, "SipiServeRequest layout drift");
 
 
+/* SipiPlanInfo — enum + int + uint64_t. */
+static_assert(SIPI_PLAN_DECODE == 0, "SipiPlanRoute drift");
+static_assert(SIPI_PLAN_HEAD == 1, "SipiPlanRoute drift");
+static_assert(SIPI_PLAN_PASSTHROUGH == 2, "SipiPlanRoute drift");
+static_assert(SIPI_PLAN_CACHE_HIT == 3, "SipiPlanRoute drift");
+static_assert(SIPI_PLAN_COPY == 4, "SipiPlanRoute drift");
+static_assert(sizeof(SipiPlanInfo) == 16, "SipiPlanInfo size drifted from src/server-rs/src/ffi.rs");
+static_assert(offsetof(SipiPlanInfo, route) == 0, "SipiPlanInfo layout drift");
+static_assert(offsetof(SipiPlanInfo, full_lane) == 4, "SipiPlanInfo layout drift");
+static_assert(offsetof(SipiPlanInfo, decode_estimate_bytes) == 8, "SipiPlanInfo layout drift");
+
 /* SipiImageDims — five uint32_t; 4-aligned, unlike the pointer-bearing structs. */
 static_assert(sizeof(SipiImageDims) == 20, "SipiImageDims size drifted from src/server-rs/src/ffi.rs");
 static_assert(offsetof(SipiImageDims, width) == 0, "SipiImageDims layout drift");
@@ -516,6 +640,15 @@ static_assert(offsetof(SipiImageDims, height) == 4, "SipiImageDims layout drift"
 static_assert(offsetof(SipiImageDims, numpages) == 8, "SipiImageDims layout drift");
 static_assert(offsetof(SipiImageDims, tile_width) == 12, "SipiImageDims layout drift");
 static_assert(offsetof(SipiImageDims, tile_height) == 16, "SipiImageDims layout drift");
+
+/* SipiDecodePath — the decode-amplification label in SipiServeTimings. */
+static_assert(SIPI_DECODE_PATH_NONE == 0, "SipiDecodePath drift");
+static_assert(SIPI_DECODE_PATH_FULL == 1, "SipiDecodePath drift");
+static_assert(SIPI_DECODE_PATH_DCT_SCALED == 2, "SipiDecodePath drift");
+static_assert(SIPI_DECODE_PATH_PYRAMID == 3, "SipiDecodePath drift");
+static_assert(SIPI_DECODE_PATH_PASSTHROUGH == 4, "SipiDecodePath drift");
+static_assert(SIPI_DECODE_PATH_CACHE_HIT == 5, "SipiDecodePath drift");
+static_assert(SIPI_DECODE_PATH_COPY == 6, "SipiDecodePath drift");
 #endif
 
 /* ── Entry points ───────────────────────────────────────────────────────────
@@ -525,6 +658,54 @@ static_assert(offsetof(SipiImageDims, tile_height) == 16, "SipiImageDims layout
 /*! IIIF decode→transform→encode→stream; honours the restrict size/watermark. */
 SIPI_FFI_NODISCARD int sipi_serve_image(const SipiServeRequest *req, const SipiResponse *resp);
 
+/*! Plan an IIIF image request without decoding it (see `SipiServePlan`). On 0,
+ *  `*plan` is a new handle and `*info` its route and exact decode estimate;
+ *  otherwise `*plan` is NULL and the return is the status to render (404, 400,
+ *  500). Probing the cache pins a hit until the plan is served or freed. Resets
+ *  the per-serve observations like `sipi_serve_image`; they travel with the
+ *  plan to `sipi_serve_planned`. */
+SIPI_FFI_NODISCARD int sipi_plan_image(const SipiServeRequest *req, SipiServePlan **plan, SipiPlanInfo *info);
+
+/*! Serve a plan — on any thread — exactly as `sipi_serve_image` would have
+ *  served its request; consumes `plan` whatever the outcome, and returns 500
+ *  without emitting anything for a NULL `plan`. Handled decode errors go to
+ *  `report_error`/`report_ctx` (NULL = absent), the only request fields the
+ *  serve still needs. `sipi_serve_timings_take` on the same thread then
+ *  returns the observations of both calls, relative to the plan's start. */
+SIPI_FFI_NODISCARD int sipi_serve_planned(SipiServePlan *plan,
+  const SipiResponse *resp,
+  SipiReportErrorFn report_error,
+  void *report_ctx);
+
+/*! Drop a plan that will not be served (the request was shed, or the client
+ *  left), releasing a pinned cache file. NULL is a no-op. */
+void sipi_plan_free(SipiServePlan *plan);
+
+/*! Receives tile `index` of a `sipi_render_tiles` batch. `status` is 0 with
+ *  the tile's encoded bytes in `data`/`len` (valid only for the call), or the
+ *  HTTP status the tile would have been served with (400, 500) and no bytes.
+ *  Returns 0 to continue; non-zero stops the batch (the consumer is gone). */
+typedef int (*SipiTileFn)(void *ctx, size_t index, int status, const uint8_t *data, size_t len);
+
+/*! Render `count` IIIF requests of one image (`tiles[i]` as in
+ *  `SipiServeRequest.params`) against a single open decoder — one TIFF handle or
+ *  one JPEG2000 codestream for the whole batch instead of one per tile — and
+ *  hand each encoded tile to `emit`, exactly once per index: tiles with an
+ *  unsupported format or an invalid size first, the rest in request order.
+ *  `resolved_path` is an already-validated absolute path; `restricted_size` and
+ *  `watermark_path` are the preflight's restriction, applied to every tile as
+ *  `SipiServeRequest`'s are to one request (NULL = none). Nothing is cached.
+ *  Returns 0 once every tile was reported; 404, 400 (a restriction the image
+ *  cannot be sized to), 500 (unreadable image) or 503 (decode-memory budget
+ *  exhausted) before any tile; 499 when `emit` stopped the batch. */
+SIPI_FFI_NODISCARD int sipi_render_tiles(const char *resolved_path,
+  const SipiIiifParams *tiles,
+  size_t count,
+  const char *restricted_size,
+  const char *watermark_path,
+  SipiTileFn emit,
+  void *ctx);
+
 /*! Copy the current thread's per-serve observations (see `SipiServeTimings`)
  *  into `*out`. Call on the SAME thread right after `sipi_serve_image` returns;
  *  a NULL `out` is a no-op. Never fails and emits nothing; the accumulator is
@@ -566,6 +747,41 @@ SIPI_FFI_NODISCARD int sipi_serve_file(const char *resolved_path, const char *ra
 /*! Engine counters → Rust OTel meter (NOT Prometheus). */
 SIPI_FFI_NODISCARD int sipi_metrics_snapshot(SipiMetricsSnapshot *out);
 
+/* One source of the decode-amplification table (ffi/decode_amplification.h):
+ * the files whose decodes cost the most pixels per pixel served. */
+typedef struct
+{
+  const char *path; /* valid only for the callback */
+  uint64_t requests;
+  uint64_t decoded_pixels;
+  uint64_t output_pixels;
+  double amplification; /* summed decoded / output pixels over its decodes */
+  double error; /* how far `amplification` may overstate it (bounded table) */
+} SipiDecodeOffender;
+
+#ifdef __cplusplus
+static_assert(sizeof(SipiDecodeOffender) == 48, "SipiDecodeOffender size drifted from src/server-rs/src/ffi.rs");
+static_assert(offsetof(SipiDecodeOffender, path) == 0, "SipiDecodeOffender layout drift");
+static_assert(offsetof(SipiDecodeOffender, requests) == 8, "SipiDecodeOffender layout drift");
+static_assert(offsetof(SipiDecodeOffender, decoded_pixels) == 16, "SipiDecodeOffender layout drift");
+static_assert(offsetof(SipiDecodeOffender, output_pixels) == 24, "SipiDecodeOffender layout drift");
+static_assert(offsetof(SipiDecodeOffender, amplification) == 32, "SipiDecodeOffender layout drift");
+static_assert(offsetof(SipiDecodeOffender, error) == 40, "SipiDecodeOffender layout drift");
+#endif
+
+typedef void (*SipiDecodeOffenderFn)(void *ctx, const SipiDecodeOffender *offender);
+
+/*! The up to `max` worst sources by summed decode amplification, worst first,
+ *  each handed to `emit`. The companion of `sipi_metrics_snapshot` for what the
+ *  flat snapshot cannot carry. Requires `sipi_init`. */
+SIPI_FFI_NODISCARD int sipi_decode_offenders(size_t max, SipiDecodeOffenderFn emit, void *ctx);
+
+/*! The slow-request flight recorder's captures (observability/flight_recorder.h)
+ *  as one JSON document, handed to `emit`: the most recent serves that took at
+ *  least the threshold, each with its profiling zones and pipeline decisions.
+ *  Works before `sipi_init`. */
+SIPI_FFI_NODISCARD int sipi_flight_captures(SipiStrFn emit, void *ctx);
+
 /*! Install the engine from the resolved config the shell assembled (both
  *  config flavors are parsed Rust-side; `overrides` is the one channel). */
 SIPI_FFI_NODISCARD int sipi_init(const SipiServerConfig *overrides);
@@ -672,6 +888,17 @@ void sipi_set_log_trace_context(const char *trace_id, const char *span_id);
  *  the full formatted header (incl. the sampling flag). */
 void sipi_set_outbound_traceparent(const char *traceparent);
 
+/*! Reads the memory the process allocator holds for all threads (e.g. its
+ *  committed bytes), or a negative value when the reading is unavailable. */
+typedef int64_t (*SipiHeapInUseFn)(void);
+
+/*! Register the heap reader the engine measures full-lane decodes with to
+ *  calibrate its peak-memory estimate (NULL unregisters; without one the static
+ *  estimate is used). The binary that links the allocator registers it once at
+ *  startup; the engine stays allocator-agnostic. `reader` must be callable from
+ *  any thread for the life of the process. */
+void sipi_set_heap_reader(SipiHeapInUseFn reader);
+
 /* ── SipiImage handle (script-facing image work) ─────────────────────────────
  *
  * The engine surface the Lua runtime's `SipiImage` userdata drives — THE CONTRACT:
@@ -21,7 +21,10 @@
  * -c opt binary (ADR-0003; docs/src/development/benchmarking.md).
  */
 
+#include <algorithm>
+#include <array>
 #include <assert.h>
+#include <atomic>
 #include <cmath>
 #include <cstddef>
 #include <cstdio>
@@ -31,6 +34,7 @@
 #include <memory>
 #include <span>
 #include <string>
+#include <type_traits>
 #include <vector>
 
 #include <cstring>
@@ -56,6 +60,8 @@
 
 #include "SipiError.h"
 #include "SipiImageError.h"
+#include "decode_cancel.h"
+#include "decode_report.h"
 #include "formats/SipiIOJ2k.h"
 #include "logging/logger.h"
 #include "observability/profiling.h"
@@ -65,6 +71,22 @@ using namespace kdu_supp;
 
 namespace Sipi {
 
+namespace {
+  // SipiIOJ2k::set_max_threads; 0 = one worker per core.
+  std::atomic<int> g_max_threads{ 0 };
+
+  // Kakadu workers for one decode or encode: one per core, capped by
+  // set_max_threads; 0 (no thread environment) when that leaves fewer than two.
+  int kakadu_threads()
+  {
+    int n = kdu_get_num_processors();
+    if (const int cap = g_max_threads.load(std::memory_order_relaxed); cap > 0) { n = std::min(n, cap); }
+    return n < 2 ? 0 : n;
+  }
+}// namespace
+
+void SipiIOJ2k::set_max_threads(int n) { g_max_threads.store(std::max(n, 0), std::memory_order_relaxed); }
+
 //=========================================================================
 // Here we are implementing a subclass of kdu_core::kdu_compressed_target
 // in order to write directly to the HTTP server connection
@@ -213,6 +235,69 @@ public:
 static KduSipiWarning kdu_sipi_warn("Kakadu-library: ");
 static KduSipiError kdu_sipi_error("Kakadu-library: ");
 
+uint8_t j2k_layer_percent(uint32_t out_w, uint32_t out_h, int jpeg_quality, uint32_t truncation_size)
+{
+  const uint32_t edge = std::max(out_w, out_h);
+  if (truncation_size == 0 || edge == 0 || edge > truncation_size || jpeg_quality <= 0) { return 0; }
+  // min + (100 - min) · (edge / size) · (quality / 100), rounded up in integers.
+  const uint64_t num = static_cast<uint64_t>(100 - kJ2kMinLayerPercent) * edge * std::min(jpeg_quality, 100);
+  const uint64_t den = static_cast<uint64_t>(truncation_size) * 100;
+  const auto percent = kJ2kMinLayerPercent + static_cast<int>((num + den - 1) / den);
+  return static_cast<uint8_t>(std::min(percent, 100));
+}
+
+int j2k_max_layers(int total_layers, uint8_t percent)
+{
+  if (percent == 0 || percent >= 100 || total_layers <= 0) { return 0; }
+  return std::max(1, (total_layers * percent + 99) / 100);
+}
+
+uint8_t j2k_luma_tone(uint8_t v)
+{
+  static const std::array<uint8_t, 256> lut = [] {
+    std::array<uint8_t, 256> t{};
+    for (int i = 0; i < 256; ++i) {
+      const double s = i / 255.0;
+      const double linear = s <= 0.04045 ? s / 12.92 : std::pow((s + 0.055) / 1.055, 2.4);
+      t[i] = static_cast<uint8_t>(std::lround(255.0 * std::pow(linear, 1.0 / 2.2)));
+    }
+    return t;
+  }();
+  return lut[v];
+}
+
+// One axis of j2k_region_is_transcodable: [pos, pos + len) within an image of
+// `extent` pixels at canvas `origin`, on a grid of `tile` pixels anchored at
+// `tile_origin` (0 = untiled).
+static bool j2k_axis_is_transcodable(uint32_t extent,
+  uint32_t origin,
+  uint32_t tile,
+  uint32_t tile_origin,
+  uint32_t pos,
+  uint32_t len,
+  int reduce)
+{
+  if (len == 0 || pos >= extent || len > extent - pos) { return false; }
+  const uint64_t end = static_cast<uint64_t>(origin) + extent;
+  const bool single_tile = tile == 0 || static_cast<uint64_t>(tile_origin) + tile >= end;
+  if (single_tile) { return pos == 0 && len == extent; }
+  const uint64_t step = uint64_t{ 1 } << reduce;
+  if (tile % step != 0 || tile_origin % step != 0 || origin % step != 0) { return false; }
+  const auto on_grid = [&](uint64_t canvas) { return (canvas - tile_origin) % tile == 0; };
+  const bool start_ok = pos == 0 || on_grid(static_cast<uint64_t>(origin) + pos);
+  const bool end_ok = pos + len == extent || on_grid(static_cast<uint64_t>(origin) + pos + len);
+  return start_ok && end_ok;
+}
+
+bool j2k_region_is_transcodable(const J2kCanvas &canvas, const J2kRegionTranscode &job)
+{
+  if (job.reduce < 0 || job.reduce > canvas.levels || job.reduce > 31) { return false; }
+  return j2k_axis_is_transcodable(
+           canvas.width, canvas.origin_x, canvas.tile_w, canvas.tile_origin_x, job.x, job.w, job.reduce)
+         && j2k_axis_is_transcodable(
+           canvas.height, canvas.origin_y, canvas.tile_h, canvas.tile_origin_y, job.y, job.h, job.reduce);
+}
+
 static bool is_jpx(const char *fname)
 {
   int retval = 0;
@@ -236,18 +321,70 @@ static bool is_jpx(const char *fname)
 //=============================================================================
 
 
-bool SipiIOJ2k::read(SipiImage *img,
-  const std::string &filepath,
-  const std::shared_ptr<SipiRegion> region,
-  const std::shared_ptr<SipiSize> size,
-  bool force_bps_8,
-  ScalingQuality scaling_quality)
+/*!
+ * An open JPEG2000 source — the file or JP2/JPX container, its codestream and
+ * the decode thread environment — shared by the reads of one file. `read`
+ * decodes one region from it; `read_tiles` opens it persistent and decodes each
+ * region from the same parsed codestream.
+ *
+ * Tears down the Kakadu decode machinery exactly once on every exit path
+ * (normal, throw, and error-return), in the required order: the decode worker
+ * threads first (env), then the codestream, then the compressed source, then
+ * the JPX container. env-before-codestream mirrors Kakadu's own
+ * kdu_buffered_expand demo (env.destroy ahead of codestream.destroy), so no
+ * worker thread outlives the codestream it reads from.
+ */
+struct SipiIOJ2k::Reader
 {
-  SIPI_ZONE_N("SipiIOJ2k::read");
-  if (!is_jpx(filepath.c_str())) return false;// It's not a JPGE2000....
+  kdu_supp::kdu_simple_file_source file_in;
+  kdu_supp::jp2_family_src jp2_ultimate_src;
+  kdu_supp::jpx_source jpx_in;
+  kdu_supp::jpx_codestream_source jpx_stream;
+  kdu_supp::jp2_palette palette;
+  kdu_core::kdu_compressed_source *input = nullptr;
+  kdu_core::kdu_codestream codestream;
+  // Multi-threaded decode environment, created by the first decode when
+  // num_threads > 0.
+  kdu_core::kdu_thread_env env;
+  int num_threads = 0;
+  int maximal_reduce = 0;
+  bool done = false;
 
-  int num_threads;
-  if ((num_threads = kdu_get_num_processors()) < 2) num_threads = 0;
+  Reader() = default;
+  Reader(const Reader &) = delete;
+  Reader &operator=(const Reader &) = delete;
+  ~Reader() { teardown(); }
+
+  void teardown()
+  {
+    if (done) { return; }
+    done = true;
+    if (env.exists()) { env.destroy(); }
+    if (codestream.exists()) { codestream.destroy(); }
+    if (input != nullptr) { input->close(); }
+    jpx_in.close();
+  }
+
+  // Opens `filepath` and reads its metadata (XMP, IPTC, Exif, Essentials) into
+  // `img`. `persistent` keeps the codestream decodable more than once.
+  void open(SipiImage *img, const std::string &filepath, bool persistent);
+
+  // Decodes `region` at `size` into `img`, which carries the metadata `open`
+  // read. `release` tears the source down as soon as the samples are out, before
+  // the palette/colour/scale post-processing. Returns false when Kakadu fails
+  // mid-decode.
+  bool decode(SipiImage *img,
+    const std::string &filepath,
+    const std::shared_ptr<SipiRegion> &region,
+    const std::shared_ptr<SipiSize> &size,
+    bool force_bps_8,
+    ScalingQuality scaling_quality,
+    bool release);
+};
+
+void SipiIOJ2k::Reader::open(SipiImage *img, const std::string &filepath, bool persistent)
+{
+  num_threads = kakadu_threads();
 #if defined(__SANITIZE_ADDRESS__) || (defined(__has_feature) && __has_feature(address_sanitizer))
   // Same ASan "Joining already joined thread" false positive as the encode path
   // (see the guard in write() for the full rationale): Kakadu's worker-thread
@@ -261,53 +398,6 @@ bool SipiIOJ2k::read(SipiImage *img,
   kdu_customize_warnings(&kdu_sipi_warn);
   kdu_customize_errors(&kdu_sipi_error);
 
-  kdu_core::kdu_compressed_source *input = nullptr;
-  kdu_supp::kdu_simple_file_source file_in;
-
-  kdu_supp::jp2_family_src jp2_ultimate_src;
-  kdu_supp::jpx_source jpx_in;
-  kdu_supp::jpx_codestream_source jpx_stream;
-  kdu_supp::jpx_layer_source jpx_layer;
-
-  kdu_supp::jp2_channels channels;
-  kdu_supp::jp2_palette palette;
-  kdu_supp::jp2_resolution resolution;
-  kdu_supp::jp2_colour colour;
-
-  kdu_core::kdu_codestream codestream;
-  // Multi-threaded decode environment, created below (before decompressor.start)
-  // when num_threads > 0. Owned by KduReadTeardown so its worker threads are
-  // joined ahead of the codestream they read from.
-  kdu_core::kdu_thread_env env;
-  kdu_core::kdu_thread_env *env_ref = nullptr;
-
-  // Tears down the Kakadu decode machinery exactly once on every exit path
-  // (normal, throw, and error-return), in the required order: the decode worker
-  // threads first (env), then the codestream, then the compressed source, then
-  // the JPX container. env-before-codestream mirrors Kakadu's own
-  // kdu_buffered_expand demo (env.destroy ahead of codestream.destroy), so no
-  // worker thread outlives the codestream it reads from.
-  struct KduReadTeardown
-  {
-    kdu_core::kdu_thread_env &env;
-    kdu_core::kdu_codestream &codestream;
-    kdu_core::kdu_compressed_source *&input;
-    kdu_supp::jpx_source &jpx_in;
-    bool done = false;
-
-    void teardown()
-    {
-      if (done) { return; }
-      done = true;
-      if (env.exists()) { env.destroy(); }
-      if (codestream.exists()) { codestream.destroy(); }
-      if (input != nullptr) { input->close(); }
-      jpx_in.close();
-    }
-
-    ~KduReadTeardown() { teardown(); }
-  } kdu_teardown{ env, codestream, input, jpx_in };
-
   jp2_ultimate_src.open(filepath.c_str());
 
   bool essentials_from_uuid_box = false;
@@ -394,7 +484,7 @@ bool SipiIOJ2k::read(SipiImage *img,
       input = jpx_stream.open_stream();
       palette = jpx_stream.access_palette();
     } catch (kdu_exception&) {
-      // KduReadTeardown closes whatever is live (input is set only if
+      // teardown() closes whatever is live (input is set only if
       // open_stream() returned before the throw; the codestream is not
       // created yet). jp2_ultimate_src is released by its destructor on
       // unwind, as on the normal path.
@@ -405,12 +495,13 @@ bool SipiIOJ2k::read(SipiImage *img,
 
   // Corrupt or truncated input makes create()/header parsing raise a Kakadu
   // error, which KduSipiError::flush throws as a kdu_exception. Convert it to a
-  // SipiImageError (as the JPEG/PNG handlers do); KduReadTeardown tears down
+  // SipiImageError (as the JPEG/PNG handlers do); teardown() tears down
   // the codestream + source, so the engine reports an enriched error rather
   // than a bare catch-all, and no source is leaked on the failure path.
-  int maximal_reduce;
   try {
     codestream.create(input);
+    // A reader that decodes several regions must keep the parsed code-blocks.
+    if (persistent) { codestream.set_persistent(); }
     // codestream.set_fussy(); // Set the parsing error tolerance.
     codestream.set_fast();// No errors expected in input
     maximal_reduce = codestream.get_min_dwt_levels();
@@ -438,14 +529,29 @@ bool SipiIOJ2k::read(SipiImage *img,
       comment = codestream.get_comment(comment);
     }
   }
+}
 
+bool SipiIOJ2k::Reader::decode(SipiImage *img,
+  const std::string &filepath,
+  const std::shared_ptr<SipiRegion> &region,
+  const std::shared_ptr<SipiSize> &size,
+  bool force_bps_8,
+  ScalingQuality scaling_quality,
+  bool release)
+{
   //
   // get the size of the full image (without reduce!)
   //
   siz_params *siz = codestream.access_siz();
-  int __nx, __ny;
+  int __nx, __ny, __ox, __oy;
   siz->get(Ssize, 0, 0, __ny);
   siz->get(Ssize, 0, 1, __nx);
+  // A non-zero image origin (e.g. a transcoded region, SipiIOJ2k::transcode_region)
+  // puts the image at [origin, Ssize) on the canvas.
+  siz->get(Sorigin, 0, 0, __oy);
+  siz->get(Sorigin, 0, 1, __ox);
+  __nx -= __ox;
+  __ny -= __oy;
 
   //
   // is there a region of interest defined ? If yes, get the cropping parameters...
@@ -455,6 +561,8 @@ bool SipiIOJ2k::read(SipiImage *img,
   if ((region != nullptr) && (region->getType()) != SipiRegion::FULL) {
     size_t sx, sy;
     region->crop_coords(__nx, __ny, roi.pos.x, roi.pos.y, sx, sy);
+    roi.pos.x += __ox;
+    roi.pos.y += __oy;
     roi.size.x = sx;
     roi.size.y = sy;
     do_roi = true;
@@ -478,7 +586,19 @@ bool SipiIOJ2k::read(SipiImage *img,
 
   if (reduce < 0) reduce = 0;
 
-  codestream.apply_input_restrictions(0, 0, reduce, 0, do_roi ? &roi : nullptr);
+  //
+  // Low-resolution renderings may skip the top quality layers (j2k_layer_percent):
+  // Kakadu then never decodes the code-block passes those layers carry.
+  //
+  int max_layers = 0;
+  if (scaling_quality.j2k_layer_percent != 0) {
+    int total_layers = 0;
+    kdu_params *cod = siz->access_cluster(COD_params);
+    if (cod != nullptr) { cod->get(Clayers, 0, 0, total_layers); }
+    max_layers = j2k_max_layers(total_layers, scaling_quality.j2k_layer_percent);
+  }
+
+  codestream.apply_input_restrictions(0, 0, reduce, max_layers, do_roi ? &roi : nullptr);
 
 
   // Determine number of components to decompress
@@ -502,10 +622,11 @@ bool SipiIOJ2k::read(SipiImage *img,
   //
   // get ICC-Profile if available
   //
-  jpx_layer = jpx_in.access_layer(0);
+  kdu_supp::jpx_layer_source jpx_layer = jpx_in.access_layer(0);
   img->photo = PhotometricInterpretation::INVALID;// we initialize to an invalid value in order to test later if
                                                   // img->photo has been set
   int numcol;
+  int colour_space = -1;// JP2 colour space of the first layer; -1 = none (raw codestream)
   if (jpx_layer.exists()) {
     kdu_supp::jp2_colour colinfo = jpx_layer.access_colour(0);
     kdu_supp::jp2_channels chaninfo = jpx_layer.access_channels();
@@ -535,6 +656,7 @@ bool SipiIOJ2k::read(SipiImage *img,
     }
     if (colinfo.exists()) {
       int space = colinfo.get_space();
+      colour_space = space;
       switch (space) {
       case kdu_supp::JP2_sRGB_SPACE: {
         img->photo = PhotometricInterpretation::RGB;
@@ -634,17 +756,47 @@ bool SipiIOJ2k::read(SipiImage *img,
     }// switch(numcol)
   }
 
+  //
+  // A `gray` rendering may decode only the luma: component 0 of a codestream
+  // that carries YCC, either through the Part 1 colour transform (Cycc) of an
+  // sRGB image or as stored YCC samples. The other two components are never
+  // entropy-decoded or inverse-transformed, and no ICC conversion follows.
+  //
+  bool luma_only = false;
+  if (scaling_quality.j2k_gray != J2kGrayDecode::EXACT && numcol == 3 && img->nc == 3 && rlut.empty()
+      && (force_bps_8 || img->bps == 8)) {
+    bool ycc = colour_space == kdu_supp::JP2_sYCC_SPACE || colour_space == kdu_supp::JP2_YCbCr1_SPACE;
+    if (colour_space == kdu_supp::JP2_sRGB_SPACE) {
+      kdu_params *cod = siz->access_cluster(COD_params);
+      if (cod != nullptr) { cod->get(Cycc, 0, 0, ycc); }
+    }
+    if (ycc) {
+      codestream.apply_input_restrictions(
+        0, 1, reduce, max_layers, do_roi ? &roi : nullptr, KDU_WANT_CODESTREAM_COMPONENTS);
+      img->nc = 1;
+      img->photo = PhotometricInterpretation::MINISBLACK;
+      // Plain luma keeps the sRGB encoding of the samples it is summed from;
+      // the toned variant is re-encoded to icc_GRAY_D50's gamma 2.2 below.
+      img->icc = std::make_shared<Icc>(
+        scaling_quality.j2k_gray == J2kGrayDecode::LUMINANCE_TONED ? icc_GRAY_D50 : icc_GRAY_sRGB);
+      luma_only = true;
+    }
+  }
+
   //
   // the following code directly converts a 16-Bit jpx into an 8-bit image.
   // In order to retrieve a 16-Bit image, use kdu_uin16 *buffer and the apropriate signature of the pull_stripe method
   //
   kdu_supp::kdu_stripe_decompressor decompressor;
+  // A persistent reader has read earlier regions' code-blocks already.
+  const kdu_long bytes_before = codestream.get_total_bytes();
   try {
     // Multi-threaded decode: one worker per core (mirroring the encode path in
     // write()), so the inverse DWT and sample processing run across all cores.
     // num_threads is 0 on a single-core host (and under ASan), in which case
-    // env_ref stays NULL and decode falls back to the single-threaded path.
-    if (num_threads > 0) {
+    // no thread environment is created and decode falls back to the
+    // single-threaded path. A persistent reader keeps its threads across regions.
+    if (num_threads > 0 && !env.exists()) {
       env.create();
       for (int nt = 1; nt < num_threads; nt++) {
         if (!env.add_thread()) {
@@ -652,44 +804,55 @@ bool SipiIOJ2k::read(SipiImage *img,
           break;
         }
       }
-      env_ref = &env;
     }
-    decompressor.start(codestream, false, false, env_ref);
+    decompressor.start(codestream, false, false, env.exists() ? &env : nullptr);
   } catch (kdu_exception&) {
     throw SipiImageError(
       "Cannot read JPEG2000 file \"" + filepath + "\": corrupt codestream (decompressor start failed)");
   }
-  // TODO: check image for number of components and make this dynamic
-  int stripe_heights[5] = {
-    dims.size.y, dims.size.y, dims.size.y, dims.size.y, dims.size.y
-  };// enough for alpha channel (5 components)
+  // Pulled in bands of kDecodeCancelRows rows — a stripe's rows are
+  // interleaved and contiguous, so band after band fills the buffer top to
+  // bottom — polling for a gone client between bands. False when Kakadu fails
+  // mid-decode.
+  const auto pull_bands = [&](auto *buffer, bool *is_signed) -> bool {
+    const auto row_samples = static_cast<std::size_t>(dims.size.x) * img->nc;
+    for (int y = 0; y < dims.size.y;) {
+      if (decode_cancelled()) {
+        decompressor.finish();
+        throw_decode_cancelled();
+      }
+      const int band = std::min(static_cast<int>(kDecodeCancelRows), dims.size.y - y);
+      // TODO: check image for number of components and make this dynamic
+      int stripe_heights[5] = { band, band, band, band, band };// enough for alpha channel (5 components)
+      try {
+        if constexpr (std::is_same_v<decltype(buffer), kdu_core::kdu_int16 *>) {
+          decompressor.pull_stripe(
+            buffer + y * row_samples, stripe_heights, nullptr, nullptr, nullptr, nullptr, is_signed);
+        } else {
+          decompressor.pull_stripe(buffer + y * row_samples, stripe_heights);
+        }
+      } catch (kdu_exception &exc) {
+        log_err("Error while decompressing image: %s.", filepath.c_str());
+        return false;
+      }
+      y += band;
+    }
+    return true;
+  };
 
   if (force_bps_8) img->bps = 8;// forces kakadu to convert to 8 bit!
   switch (img->bps) {
   case 8: {
     std::vector<byte> buffer8(static_cast<int>(dims.area()) * img->nc);
-    try {
-      decompressor.pull_stripe(buffer8.data(), stripe_heights);
-    } catch (kdu_exception &exc) {
-      log_err("Error while decompressing image: %s.", filepath.c_str());
-      return false;
-    }
+    if (!pull_bands(buffer8.data(), nullptr)) { return false; }
     img->pixels = std::move(buffer8);
     break;
   }
   case 12: {
     std::vector<char> get_signed(img->nc, 0);// vector<bool> does not work -> special treatment in C++
     std::vector<byte> buffer16(2 * dims.area() * img->nc);
-    try {
-      decompressor.pull_stripe(reinterpret_cast<kdu_core::kdu_int16 *>(buffer16.data()),
-        stripe_heights,
-        nullptr,
-        nullptr,
-        nullptr,
-        nullptr,
-        reinterpret_cast<bool *>(get_signed.data()));
-    } catch (kdu_exception &exc) {
-      log_err("Error while decompressing image: %s.", filepath.c_str());
+    if (!pull_bands(reinterpret_cast<kdu_core::kdu_int16 *>(buffer16.data()),
+          reinterpret_cast<bool *>(get_signed.data()))) {
       return false;
     }
     img->pixels = std::move(buffer16);
@@ -699,16 +862,8 @@ bool SipiIOJ2k::read(SipiImage *img,
   case 16: {
     std::vector<char> get_signed(img->nc, 0);// vector<bool> does not work -> special treatment in C++
     std::vector<byte> buffer16(2 * dims.area() * img->nc);
-    try {
-      decompressor.pull_stripe(reinterpret_cast<kdu_core::kdu_int16 *>(buffer16.data()),
-        stripe_heights,
-        nullptr,
-        nullptr,
-        nullptr,
-        nullptr,
-        reinterpret_cast<bool *>(get_signed.data()));
-    } catch (kdu_exception &exc) {
-      log_err("Error while decompressing image: %s.", filepath.c_str());
+    if (!pull_bands(reinterpret_cast<kdu_core::kdu_int16 *>(buffer16.data()),
+          reinterpret_cast<bool *>(get_signed.data()))) {
       return false;
     }
     img->pixels = std::move(buffer16);
@@ -723,7 +878,16 @@ bool SipiIOJ2k::read(SipiImage *img,
   }
   }
   decompressor.finish();
-  kdu_teardown.teardown();
+  // Decoded at the reduce's resolution level, only the precincts the ROI touches.
+  report_decoded(static_cast<std::uint64_t>(dims.size.x) * dims.size.y,
+    reduce > 0 ? DecodePath::Pyramid : DecodePath::Full);
+  const kdu_long bytes_read = codestream.get_total_bytes() - bytes_before;
+  report_decode_bytes(bytes_read > 0 ? static_cast<std::uint64_t>(bytes_read) : 0);
+  if (release) { teardown(); }
+
+  if (luma_only && scaling_quality.j2k_gray == J2kGrayDecode::LUMINANCE_TONED) {
+    for (auto &v : img->pixels) { v = j2k_luma_tone(v); }
+  }
 
   if (!rlut.empty()) {
     //
@@ -762,6 +926,44 @@ bool SipiIOJ2k::read(SipiImage *img,
 }
 //=============================================================================
 
+bool SipiIOJ2k::read(SipiImage *img,
+  const std::string &filepath,
+  const std::shared_ptr<SipiRegion> region,
+  const std::shared_ptr<SipiSize> size,
+  bool force_bps_8,
+  ScalingQuality scaling_quality)
+{
+  SIPI_ZONE_N("SipiIOJ2k::read");
+  if (!is_jpx(filepath.c_str())) return false;// It's not a JPGE2000....
+  Reader reader;
+  reader.open(img, filepath, false);
+  return reader.decode(img, filepath, region, size, force_bps_8, scaling_quality, true);
+}
+//=============================================================================
+
+bool SipiIOJ2k::read_tiles(const std::string &filepath,
+  const std::vector<SipiTileRequest> &tiles,
+  bool force_bps_8,
+  ScalingQuality scaling_quality,
+  const SipiTileEmit &emit)
+{
+  SIPI_ZONE_N("SipiIOJ2k::read_tiles");
+  if (!is_jpx(filepath.c_str())) return false;
+  Reader reader;
+  SipiImage meta;
+  reader.open(&meta, filepath, tiles.size() > 1);
+  for (std::size_t i = 0; i < tiles.size(); ++i) {
+    SipiImage tile(meta);
+    const bool last = i + 1 == tiles.size();
+    if (!reader.decode(&tile, filepath, tiles[i].region, tiles[i].size, force_bps_8, scaling_quality, last)) {
+      throw SipiImageError("Error decompressing tile " + std::to_string(i) + " of " + filepath);
+    }
+    emit(i, tile);
+  }
+  return true;
+}
+//=============================================================================
+
 
 SipiImgInfo SipiIOJ2k::read_shape(const std::string &filepath)
 {
@@ -885,12 +1087,14 @@ SipiImgInfo SipiIOJ2k::read_shape(const std::string &filepath)
   // get the size of the full image (without reduce!)
   //
   siz_params *siz = codestream.access_siz();
-  int tmp_height;
+  int tmp_height, tmp_oy;
   siz->get(Ssize, 0, 0, tmp_height);
-  info.height = tmp_height;
-  int tmp_width;
+  siz->get(Sorigin, 0, 0, tmp_oy);
+  info.height = tmp_height - tmp_oy;
+  int tmp_width, tmp_ox;
   siz->get(Ssize, 0, 1, tmp_width);
-  info.width = tmp_width;
+  siz->get(Sorigin, 0, 1, tmp_ox);
+  info.width = tmp_width - tmp_ox;
   if (info.success == SipiImgInfo::FAILURE) { info.success = SipiImgInfo::DIMS; }
 
   int __tnx, __tny;
@@ -1006,7 +1210,7 @@ void SipiIOJ2k::write(SipiImage *img, const OutputSink &sink, const SipiCompress
 
   kdu_membroker membroker;
 
-  if ((num_threads = kdu_get_num_processors()) < 2) num_threads = 0;
+  num_threads = kakadu_threads();
 #if defined(__SANITIZE_ADDRESS__) || (defined(__has_feature) && __has_feature(address_sanitizer))
   // Kakadu's own worker-thread pool (kdu_thread_env::create/add_thread,
   // below) trips ASan's "Joining already joined thread" abort when this
@@ -1485,4 +1689,354 @@ void SipiIOJ2k::write(SipiImage *img, const OutputSink &sink, const SipiCompress
       + ", colorspace=" + to_string(img->photo));
   }
 }
+//=============================================================================
+
+// Copies one code-block's compressed passes verbatim. The pass slopes carry the
+// source's layer membership (0xFFFF - layer index on a layer's last pass), so
+// flushing with the matching thresholds reproduces the source's layers.
+static void copy_block(kdu_block *in, kdu_block *out)
+{
+  if (in->K_max_prime != out->K_max_prime || in->size != out->size) {
+    throw SipiImageError("JPEG2000 transcode: code-block geometry differs between source and target");
+  }
+  out->missing_msbs = in->missing_msbs;
+  if (out->max_passes < in->num_passes + 2) { out->set_max_passes(in->num_passes + 2, false); }
+  out->num_passes = in->num_passes;
+  int num_bytes = 0;
+  for (int z = 0; z < in->num_passes; z++) {
+    num_bytes += (out->pass_lengths[z] = in->pass_lengths[z]);
+    out->pass_slopes[z] = in->pass_slopes[z];
+  }
+  if (out->max_bytes < num_bytes) { out->set_max_bytes(num_bytes, false); }
+  std::memcpy(out->byte_buffer, in->byte_buffer, static_cast<size_t>(num_bytes));
+}
+
+static void copy_tile(kdu_tile tile_in, kdu_tile tile_out)
+{
+  const int num_components = tile_out.get_num_components();
+  for (int c = 0; c < num_components; c++) {
+    kdu_tile_comp comp_in = tile_in.access_component(c);
+    kdu_tile_comp comp_out = tile_out.access_component(c);
+    const int num_resolutions = comp_out.get_num_resolutions();
+    for (int r = 0; r < num_resolutions; r++) {
+      kdu_resolution res_in = comp_in.access_resolution(r);
+      kdu_resolution res_out = comp_out.access_resolution(r);
+      int min_band;
+      int num_bands = res_in.get_valid_band_indices(min_band);
+      for (int b = min_band; num_bands > 0; num_bands--, b++) {
+        kdu_subband band_in = res_in.access_subband(b);
+        kdu_subband band_out = res_out.access_subband(b);
+        kdu_dims blocks_in, blocks_out;
+        band_in.get_valid_blocks(blocks_in);
+        band_out.get_valid_blocks(blocks_out);
+        if (blocks_in.size != blocks_out.size) {
+          throw SipiImageError("JPEG2000 transcode: code-block partition differs between source and target");
+        }
+        kdu_coords idx;
+        for (idx.y = 0; idx.y < blocks_out.size.y; idx.y++) {
+          for (idx.x = 0; idx.x < blocks_out.size.x; idx.x++) {
+            kdu_block *in = band_in.open_block(idx + blocks_in.pos);
+            kdu_block *out = band_out.open_block(idx + blocks_out.pos);
+            copy_block(in, out);
+            band_in.close_block(in);
+            band_out.close_block(out);
+          }
+        }
+      }
+    }
+  }
+}
+
+// The Essentials packet describes the image it sits in; a transcoded region
+// gets the output's shape (only when the source carried one — ADR-0004).
+static std::vector<kdu_byte> reshape_essentials(const std::vector<kdu_byte> &box, const J2kCanvas &out)
+{
+  std::span<const std::byte> payload(
+    reinterpret_cast<const std::byte *>(box.data()) + sizeof(sipi_essentials_uuid), box.size() - sizeof(sipi_essentials_uuid));
+  auto parsed = Essentials::parse(payload);
+  if (!parsed || parsed->fields().img_w == 0) { return box; }
+  auto &f = parsed->fields_mut();
+  f.img_w = out.width;
+  f.img_h = out.height;
+  f.tile_w = out.tile_w;
+  f.tile_h = out.tile_h;
+  f.clevels = static_cast<uint32_t>(out.levels);
+  const std::vector<std::byte> packet = parsed->serialize();
+  std::vector<kdu_byte> reshaped(sipi_essentials_uuid, sipi_essentials_uuid + sizeof(sipi_essentials_uuid));
+  const auto *bytes = reinterpret_cast<const kdu_byte *>(packet.data());
+  reshaped.insert(reshaped.end(), bytes, bytes + packet.size());
+  return reshaped;
+}
+
+// The SIZ geometry of an open codestream, canvas and tile origins included.
+static J2kCanvas siz_canvas(kdu_codestream &cs)
+{
+  siz_params *siz = cs.access_siz();
+  int sy, sx, oy, ox, ty, tx, toy, tox;
+  siz->get(Ssize, 0, 0, sy);
+  siz->get(Ssize, 0, 1, sx);
+  siz->get(Sorigin, 0, 0, oy);
+  siz->get(Sorigin, 0, 1, ox);
+  siz->get(Stiles, 0, 0, ty);
+  siz->get(Stiles, 0, 1, tx);
+  siz->get(Stile_origin, 0, 0, toy);
+  siz->get(Stile_origin, 0, 1, tox);
+  return J2kCanvas{ static_cast<uint32_t>(sx - ox),
+    static_cast<uint32_t>(sy - oy),
+    static_cast<uint32_t>(ox),
+    static_cast<uint32_t>(oy),
+    static_cast<uint32_t>(tx),
+    static_cast<uint32_t>(ty),
+    static_cast<uint32_t>(tox),
+    static_cast<uint32_t>(toy),
+    cs.get_min_dwt_levels() };
+}
+
+std::optional<J2kRegionTranscode> SipiIOJ2k::plan_region_transcode(const std::string &filepath,
+  uint32_t x,
+  uint32_t y,
+  uint32_t w,
+  uint32_t h,
+  int reduce)
+{
+  SIPI_ZONE_N("SipiIOJ2k::plan_region_transcode");
+  kdu_customize_warnings(&kdu_sipi_warn);
+  kdu_customize_errors(&kdu_sipi_error);
+
+  jp2_family_src jp2_ultimate_src;
+  jpx_source jpx_in;
+  kdu_compressed_source *input = nullptr;
+  kdu_codestream cs;
+
+  // Same exactly-once source teardown as transcode_region().
+  struct KduPlanTeardown
+  {
+    kdu_codestream &cs;
+    kdu_compressed_source *&input;
+    jpx_source &jpx_in;
+
+    ~KduPlanTeardown()
+    {
+      if (cs.exists()) { cs.destroy(); }
+      if (input != nullptr) { input->close(); }
+      jpx_in.close();
+    }
+  } kdu_teardown{ cs, input, jpx_in };
+
+  try {
+    jp2_ultimate_src.open(filepath.c_str());
+    if (jpx_in.open(&jp2_ultimate_src, true) < 0) { return std::nullopt; }
+    jpx_codestream_source stream = jpx_in.access_codestream(0);
+    input = stream.open_stream();
+    cs.create(input);// main header only; no tile is opened
+    const J2kRegionTranscode job{ x, y, w, h, reduce };
+    if (!j2k_region_is_transcodable(siz_canvas(cs), job)) { return std::nullopt; }
+    return job;
+  } catch (kdu_exception) {
+    return std::nullopt;
+  }
+}
+
+void SipiIOJ2k::transcode_region(const std::string &filepath, const J2kRegionTranscode &job, const OutputSink &sink)
+{
+  SIPI_ZONE_N("SipiIOJ2k::transcode_region");
+  const bool streaming = is_streaming_sink(sink);
+  const std::string outpath = streaming ? std::string("<http response>") : std::get<FilePath>(sink).path;
+
+  kdu_customize_warnings(&kdu_sipi_warn);
+  kdu_customize_errors(&kdu_sipi_error);
+
+  kdu_membroker membroker;
+  jp2_family_src jp2_ultimate_src;
+  jpx_source jpx_in;
+  jpx_codestream_source jpx_in_stream;
+  kdu_compressed_source *input = nullptr;
+  kdu_codestream in_cs;
+  kdu_codestream out_cs;
+  std::unique_ptr<SinkStream> sink_stream;
+  std::unique_ptr<J2kHttpStream> http;
+
+  // Same exactly-once source teardown as read(); the target codestream is
+  // destroyed separately (and the JPX target left unclosed) on the error path,
+  // as in write().
+  struct KduTranscodeTeardown
+  {
+    kdu_codestream &in_cs;
+    kdu_compressed_source *&input;
+    jpx_source &jpx_in;
+
+    ~KduTranscodeTeardown()
+    {
+      if (in_cs.exists()) { in_cs.destroy(); }
+      if (input != nullptr) { input->close(); }
+      jpx_in.close();
+    }
+  } kdu_teardown{ in_cs, input, jpx_in };
+
+  try {
+    jp2_ultimate_src.open(filepath.c_str());
+    if (jpx_in.open(&jp2_ultimate_src, true) < 0) {
+      throw SipiImageError("Cannot transcode JPEG2000 file \"" + filepath + "\": not a JP2/JPX container");
+    }
+
+    // Top-level metadata UUID boxes (Essentials, IPTC, EXIF, XMP), kept whole.
+    std::vector<std::vector<kdu_byte>> uuid_boxes;
+    jp2_input_box box;
+    if (box.open(&jp2_ultimate_src)) {
+      do {
+        const kdu_long len = box.get_remaining_bytes();
+        if (box.get_box_type() == jp2_uuid_4cc && len >= 16) {
+          std::vector<kdu_byte> payload(static_cast<size_t>(len));
+          box.read(payload.data(), static_cast<int>(payload.size()));
+          uuid_boxes.push_back(std::move(payload));
+        }
+        box.close();
+      } while (box.open_next());
+    }
+
+    jpx_in_stream = jpx_in.access_codestream(0);
+    input = jpx_in_stream.open_stream();
+    in_cs.create(input);
+    in_cs.set_fast();
+
+    siz_params *in_siz = in_cs.access_siz();
+    const J2kCanvas canvas = siz_canvas(in_cs);
+    const auto ox = static_cast<int>(canvas.origin_x);
+    const auto oy = static_cast<int>(canvas.origin_y);
+    const auto tx = static_cast<int>(canvas.tile_w);
+    const auto ty = static_cast<int>(canvas.tile_h);
+    const auto tox = static_cast<int>(canvas.tile_origin_x);
+    const auto toy = static_cast<int>(canvas.tile_origin_y);
+    if (!j2k_region_is_transcodable(canvas, job)) {
+      throw SipiImageError("Cannot transcode JPEG2000 file \"" + filepath + "\": region is not tile-aligned");
+    }
+
+    // Restrict the source to the region's tiles and the kept resolutions; the
+    // region is given on the full-resolution canvas.
+    kdu_dims roi;
+    roi.pos.x = ox + static_cast<int>(job.x);
+    roi.pos.y = oy + static_cast<int>(job.y);
+    roi.size.x = static_cast<int>(job.w);
+    roi.size.y = static_cast<int>(job.h);
+    in_cs.apply_input_restrictions(0, 0, job.reduce, 0, &roi, KDU_WANT_CODESTREAM_COMPONENTS);
+
+    kdu_dims out_dims;
+    in_cs.get_dims(-1, out_dims);
+    kdu_dims tiles_in;
+    in_cs.get_valid_tiles(tiles_in);
+
+    // The target keeps the source's canvas coordinates — the code-block and
+    // precinct partitions are anchored there — and moves the image and tile
+    // origins onto the region.
+    const int step = 1 << job.reduce;
+    const auto reduced = [step](int v) { return (v + step - 1) / step; };
+    siz_params out_siz;
+    out_siz.copy_from(in_siz, -1, -1, -1, 0, job.reduce, false, false, false);
+    out_siz.set(Sorigin, 0, 0, out_dims.pos.y);
+    out_siz.set(Sorigin, 0, 1, out_dims.pos.x);
+    out_siz.set(Ssize, 0, 0, out_dims.pos.y + out_dims.size.y);
+    out_siz.set(Ssize, 0, 1, out_dims.pos.x + out_dims.size.x);
+    out_siz.set(Stile_origin, 0, 0, reduced(toy + tiles_in.pos.y * ty));
+    out_siz.set(Stile_origin, 0, 1, reduced(tox + tiles_in.pos.x * tx));
+    out_siz.set(Stiles, 0, 0, reduced(ty));
+    out_siz.set(Stiles, 0, 1, reduced(tx));
+    kdu_params *out_siz_ref = &out_siz;
+    out_siz_ref->finalize();
+
+    jp2_family_tgt jp2_ultimate_tgt;
+    if (streaming) {
+      sink_stream = std::make_unique<SinkStream>(sink);
+      http = std::make_unique<J2kHttpStream>(sink_stream.get());
+      jp2_ultimate_tgt.open(http.get(), &membroker);
+    } else {
+      jp2_ultimate_tgt.open(outpath.c_str(), &membroker);
+    }
+    jpx_target jpx_out;
+    jpx_out.open(&jp2_ultimate_tgt, &membroker);
+    jpx_codestream_target jpx_stream = jpx_out.add_codestream();
+    jpx_layer_target jpx_layer = jpx_out.add_layer();
+
+    out_cs.create(&out_siz, jpx_stream.access_stream(), nullptr, 0, 0, nullptr, &membroker);
+    out_cs.access_siz()->copy_all(in_siz, 0, job.reduce);
+    out_cs.access_siz()->finalize_all();
+
+    // Legacy Essentials carrier: pre-rollout files keep the packet in a
+    // "SIPI:" codestream comment.
+    for (kdu_codestream_comment c = in_cs.get_comment(); c.exists(); c = in_cs.get_comment(c)) {
+      const char *text = c.get_text();
+      if (text != nullptr && std::strncmp(text, "SIPI:", 5) == 0) { out_cs.add_comment() << text; }
+    }
+
+    // Container boxes: the dimensions follow the target; colour (ICC),
+    // channels, palette and resolution are the source's.
+    jpx_stream.access_dimensions().init(out_cs.access_siz());
+    jpx_stream.access_palette().copy(jpx_in_stream.access_palette());
+    jpx_layer_source in_layer = jpx_in.access_layer(0);
+    if (in_layer.exists()) {
+      jpx_layer.add_colour().copy(in_layer.access_colour(0));
+      jpx_layer.access_channels().copy(in_layer.access_channels());
+      jpx_layer.access_resolution().copy(in_layer.access_resolution());
+    }
+    jpx_out.write_headers();
+
+    const J2kCanvas out_canvas{ static_cast<uint32_t>(out_dims.size.x),
+      static_cast<uint32_t>(out_dims.size.y),
+      0,
+      0,
+      static_cast<uint32_t>(std::min(reduced(tx), out_dims.size.x)),
+      static_cast<uint32_t>(std::min(reduced(ty), out_dims.size.y)),
+      0,
+      0,
+      canvas.levels - job.reduce };
+    for (const auto &payload : uuid_boxes) {
+      const bool is_essentials = std::memcmp(payload.data(), sipi_essentials_uuid, 16) == 0;
+      const std::vector<kdu_byte> bytes = is_essentials ? reshape_essentials(payload, out_canvas) : payload;
+      jp2_output_box out;
+      out.open(&jp2_ultimate_tgt, jp2_uuid_4cc);
+      out.set_target_size(static_cast<kdu_long>(bytes.size()));
+      out.write(bytes.data(), static_cast<int>(bytes.size()));
+      out.close();
+    }
+    jpx_out.write_headers();
+    jpx_stream.open_stream();
+
+    // The code-block copy: source and target tile grids match one for one.
+    kdu_dims tiles_out;
+    out_cs.get_valid_tiles(tiles_out);
+    if (tiles_in.size != tiles_out.size) {
+      throw SipiImageError("JPEG2000 transcode: tile grid differs between source and target");
+    }
+    kdu_coords t;
+    for (t.y = 0; t.y < tiles_out.size.y; t.y++) {
+      for (t.x = 0; t.x < tiles_out.size.x; t.x++) {
+        kdu_tile tile_in = in_cs.open_tile(t + tiles_in.pos);
+        kdu_tile tile_out = out_cs.open_tile(t + tiles_out.pos);
+        copy_tile(tile_in, tile_out);
+        tile_in.close();
+        tile_out.close();
+      }
+    }
+
+    const int num_layers = std::max(1, in_cs.get_max_tile_layers());
+    std::vector<kdu_long> layer_bytes(num_layers, 0);
+    std::vector<kdu_uint16> layer_thresholds(num_layers);
+    for (int l = 0; l < num_layers; l++) { layer_thresholds[l] = static_cast<kdu_uint16>(0xFFFF - l); }
+    out_cs.flush(layer_bytes.data(), num_layers, layer_thresholds.data(), true, false);
+
+    out_cs.destroy();
+    jpx_out.close();
+    if (jp2_ultimate_tgt.exists()) { jp2_ultimate_tgt.close(); }
+  } catch (kdu_exception e) {
+    if (out_cs.exists()) { out_cs.destroy(); }
+    if (http && http->client_aborted) {
+      throw SipiImageClientAbortError("Client aborted HTTP response during JPEG2000 transcode");
+    }
+    throw SipiImageError("Failed transcoding JPEG2000 image (Kakadu exception " + std::to_string(e) + ")"
+      + ", file=" + filepath + ", region=" + std::to_string(job.x) + "," + std::to_string(job.y) + ","
+      + std::to_string(job.w) + "," + std::to_string(job.h) + ", reduce=" + std::to_string(job.reduce));
+  } catch (SipiImageError &) {
+    if (out_cs.exists()) { out_cs.destroy(); }
+    throw;
+  }
+}
 }// namespace Sipi
@@ -9,6 +9,8 @@
 #ifndef __sipi_io_j2k_h
 #define __sipi_io_j2k_h
 
+#include <cstdint>
+#include <optional>
 #include <string>
 
 #include "tiff.h"
@@ -20,10 +22,86 @@
 
 namespace Sipi {
 
+//! Smallest share of quality layers `j2k_layer_percent` ever asks for.
+inline constexpr int kJ2kMinLayerPercent = 50;
+
+/*!
+ * Share of a JPEG2000 codestream's quality layers worth decoding for an
+ * `out_w`×`out_h` rendering that is JPEG-encoded at `jpeg_quality`.
+ *
+ * Returns 0 (decode every layer) when `truncation_size` is 0, when the longest
+ * output edge exceeds it, or when the output is not a JPEG (`jpeg_quality` ≤ 0).
+ * Otherwise the share scales with both the edge ratio and the JPEG quality,
+ * from `kJ2kMinLayerPercent` up to 100: the dropped layers only refine detail
+ * that the downscale and the JPEG quantiser discard anyway.
+ */
+[[nodiscard]] uint8_t j2k_layer_percent(uint32_t out_w, uint32_t out_h, int jpeg_quality, uint32_t truncation_size);
+
+/*!
+ * The `max_layers` to hand Kakadu's `apply_input_restrictions` for a codestream
+ * with `total_layers` quality layers: 0 (all layers) for `percent` 0 or an
+ * unknown layer count, else `percent` of the layers rounded up, at least one.
+ */
+[[nodiscard]] int j2k_max_layers(int total_layers, uint8_t percent);
+
+/*!
+ * Tone correction for a luminance-only JPEG2000 decode (J2kGrayDecode::
+ * LUMINANCE_TONED). The codestream's luma is a weighted sum of the
+ * sRGB-encoded samples; the exact gray path instead encodes the linear-light
+ * luminance with the gamma 2.2 of `icc_GRAY_D50`. Mapping an 8-bit luma `v`
+ * through sRGB-to-linear and the 2.2 encoding makes the two agree exactly on
+ * the neutral axis; saturated colours keep a small luma-vs-luminance error.
+ */
+[[nodiscard]] uint8_t j2k_luma_tone(uint8_t v);
+
+/*!
+ * A region of a JPEG2000 source at a reduce-only size, in full-resolution
+ * image coordinates (relative to the image origin). `reduce` is the number of
+ * discarded resolution levels (output = region / 2^reduce, rounded up).
+ */
+struct J2kRegionTranscode
+{
+  uint32_t x{ 0 };
+  uint32_t y{ 0 };
+  uint32_t w{ 0 };
+  uint32_t h{ 0 };
+  int reduce{ 0 };
+};
+
+/*!
+ * The SIZ geometry of a JPEG2000 codestream that decides whether a region can
+ * be transcoded. Origins are canvas coordinates; a tile size of 0 means the
+ * image is untiled (one tile covers it).
+ */
+struct J2kCanvas
+{
+  uint32_t width{ 0 };
+  uint32_t height{ 0 };
+  uint32_t origin_x{ 0 };
+  uint32_t origin_y{ 0 };
+  uint32_t tile_w{ 0 };
+  uint32_t tile_h{ 0 };
+  uint32_t tile_origin_x{ 0 };
+  uint32_t tile_origin_y{ 0 };
+  int levels{ 0 };
+};
+
+/*!
+ * Whether `job` can be served by `SipiIOJ2k::transcode_region`, i.e. whether
+ * its code-blocks can be copied into a new codestream unchanged: the region is
+ * non-empty, inside the image, and each edge lies on a tile boundary or the
+ * image edge; `reduce` is within the codestream's DWT levels; and the tile
+ * grid survives the reduce (tile size and origins divisible by 2^reduce,
+ * unless one tile spans the axis).
+ */
+[[nodiscard]] bool j2k_region_is_transcodable(const J2kCanvas &canvas, const J2kRegionTranscode &job);
+
 /*! Class which implements the JPEG2000-reader/writer */
 class SipiIOJ2k : public SipiIO
 {
 private:
+  struct Reader;//!< an open source the reads decode from (SipiIOJ2k.cpp)
+
 public:
   ~SipiIOJ2k() override = default;
   ;
@@ -44,6 +122,17 @@ public:
     bool force_bps_8,
     ScalingQuality scaling_quality) override;
 
+  /*!
+   * Read several regions of one JPEG2000 file from a single codestream: the
+   * container and the main header are parsed once, and the codestream is kept
+   * persistent so each region decodes from the same parsed state.
+   */
+  bool read_tiles(const std::string &filepath,
+    const std::vector<SipiTileRequest> &tiles,
+    bool force_bps_8,
+    ScalingQuality scaling_quality,
+    const SipiTileEmit &emit) override;
+
   /*!
    * Get the dimension of the image
    *
@@ -59,6 +148,39 @@ public:
    * \param sink Where the encoded bytes go.
    */
   void write(SipiImage *img, const OutputSink &sink, const SipiCompressionParams *params) override;
+
+  /*!
+   * The transcode for the full-resolution region (x, y, w, h) at reduce
+   * exponent `reduce` of the JPEG2000 file `filepath`, or nullopt when
+   * `j2k_region_is_transcodable` rejects it against the codestream's SIZ
+   * (canvas and tile origins included) or the file is not a JP2/JPX
+   * container. Reads the main header only.
+   *
+   * \param filepath JPEG2000 source
+   */
+  static std::optional<J2kRegionTranscode>
+    plan_region_transcode(const std::string &filepath, uint32_t x, uint32_t y, uint32_t w, uint32_t h, int reduce);
+
+  /*!
+   * Write the region `job` of the JPEG2000 file `filepath` as a new JP2 without
+   * decoding any pixels: the code-blocks of the covered tiles, resolutions and
+   * layers are copied into a fresh codestream. The colour, channel and
+   * resolution boxes and the metadata UUID boxes (Essentials, IPTC, EXIF, XMP)
+   * are carried over; the Essentials image-shape fields are updated to the
+   * output. The caller plans the job with `plan_region_transcode`; a region
+   * that turns out not to be transcodable throws SipiImageError.
+   *
+   * \param filepath JPEG2000 source (JP2/JPX container)
+   * \param job Tile-aligned region + reduce, from `plan_region_transcode`
+   * \param sink Where the encoded bytes go.
+   */
+  static void transcode_region(const std::string &filepath, const J2kRegionTranscode &job, const OutputSink &sink);
+
+  /*!
+   * Cap the Kakadu worker threads of each decode and encode at `n` (process
+   * wide); 0, the default, runs one per core, and 1 runs single-threaded.
+   */
+  static void set_max_threads(int n);
 };
 }// namespace Sipi
 
@@ -25,6 +25,8 @@
 #include "SipiIO.h"
 #include "SipiImage.h"
 #include "SipiImageError.h"
+#include "decode_cancel.h"
+#include "decode_report.h"
 #include "formats/SipiIOJpeg.h"
 #include "observability/profiling.h"
 
@@ -683,6 +685,9 @@ bool SipiIOJpeg::read(SipiImage *img,
 
   // icc_buffer is freed and nulled above; errors → longjmp → setjmp handler
   jpeg_start_decompress(&cinfo);
+  // The whole frame is decoded (a Region is cropped afterwards), at the DCT scale.
+  report_decoded(static_cast<std::uint64_t>(cinfo.output_width) * cinfo.output_height,
+    cinfo.scale_denom > 1 ? DecodePath::DctScaled : DecodePath::Full);
 
   img->bps = 8;
   img->nx = cinfo.output_width;
@@ -731,6 +736,10 @@ bool SipiIOJpeg::read(SipiImage *img,
   // All libjpeg calls below — errors → longjmp → setjmp handler above
   linbuf = (*cinfo.mem->alloc_sarray)((j_common_ptr)&cinfo, JPOOL_IMAGE, sll, 1);
   for (size_t i = 0; i < img->ny; i++) {
+    if (i % kDecodeCancelRows == 0 && decode_cancelled()) {
+      jpeg_destroy_decompress(&cinfo);
+      throw_decode_cancelled();
+    }
     jpeg_read_scanlines(&cinfo, linbuf, 1);
     memcpy(&(img->pixels[i * sll]), linbuf[0], (size_t)sll);
   }
@@ -43,8 +43,11 @@
 
 #include "logging/logger.h"
 #include "SipiImageError.h"
+#include "decode_cancel.h"
+#include "decode_report.h"
 #include "formats/SipiIOPng.h"
 #include "observability/profiling.h"
+#include "resample.h"
 
 // bad hack in order to include definitions in png.h on debian systems
 #if !defined(PNG_TEXT_SUPPORTED)
@@ -169,6 +172,8 @@ bool SipiIOPng::read(SipiImage *img,
   // safe — the vector object's storage is stable memory, not a register).
   std::vector<uint8_t> buffer;
   std::vector<png_bytep> row_pointers;
+  std::vector<uint8_t> row;
+  std::unique_ptr<StreamingResampler> resampler;
 
   // setjmp error recovery — sipi_error_fn calls longjmp(png_jmpbuf(png_ptr), 1)
   if (setjmp(png_jmpbuf(png_ptr))) {
@@ -282,50 +287,107 @@ bool SipiIOPng::read(SipiImage *img,
   }
 
   size_t sll = png_get_rowbytes(png_ptr, info_ptr);
-  buffer.resize(height * sll);
-
-  row_pointers.resize(height);
-  for (size_t i = 0; i < img->ny; i++) { row_pointers[i] = (buffer.data() + i * sll); }
-
-  png_read_image(png_ptr, row_pointers.data());
-  png_read_end(png_ptr, info_ptr);
   img->bps = png_get_bit_depth(png_ptr, info_ptr);
   img->nc = png_get_channels(png_ptr, info_ptr);
   if (color_type == PNG_COLOR_TYPE_PALETTE && img->nc == 4) { img->es.push_back(ExtraSamples::ASSOCALPHA); }
+  const size_t pixel_bytes = img->nc * (img->bps == 16 ? 2 : 1);
 
-  png_destroy_read_struct(&png_ptr, &info_ptr, nullptr);
+  //
+  // The region in source coordinates and the requested output size. Both are
+  // known before the first row is decoded, so a non-interlaced image is read row
+  // by row: rows above the region are decoded and dropped, decoding stops after
+  // its last row, and with the HIGH resampler the kept rows go straight through
+  // a StreamingResampler. Memory is then proportional to the region (or, when
+  // scaling, the output) rather than the source image.
+  //
+  int rx = 0, ry = 0;
+  size_t rw = width, rh = height;
+  if (region != nullptr && region->getType() != SipiRegion::FULL) { region->crop_coords(width, height, rx, ry, rw, rh); }
 
-  if (img->bps == 16) {
-    auto *tmp = (unsigned short *)buffer.data();
-    for (int i = 0; i < img->nx * img->ny * img->nc; i++) { tmp[i] = ntohs(tmp[i]); }
-  }
-  img->pixels = std::move(buffer);
+  size_t nnx = rw, nny = rh;
+  SipiSize::SizeType rtype = SipiSize::FULL;
+  if (size != nullptr) {
+    int reduce = -1;
+    bool redonly;
+    rtype = size->get_size(rw, rh, nnx, nny, reduce, redonly);
+  }
+
+  if (interlace_type != PNG_INTERLACE_NONE) {
+    // Adam7 delivers seven passes over the whole frame: decode it in full and
+    // crop afterwards.
+    buffer.resize(height * sll);
+    row_pointers.resize(height);
+    for (size_t i = 0; i < height; i++) { row_pointers[i] = (buffer.data() + i * sll); }
+    png_read_image(png_ptr, row_pointers.data());
+    report_decoded(static_cast<std::uint64_t>(width) * height, DecodePath::Full);
+    png_read_end(png_ptr, info_ptr);
+    png_destroy_read_struct(&png_ptr, &info_ptr, nullptr);
 
-  infile.reset();
+    if (img->bps == 16) {
+      auto *tmp = (unsigned short *)buffer.data();
+      for (size_t i = 0; i < img->nx * img->ny * img->nc; i++) { tmp[i] = ntohs(tmp[i]); }
+    }
+    img->pixels = std::move(buffer);
+    if (region != nullptr) { (void)img->crop(region); }
+  } else {
+    const bool stream_scale =
+      rtype != SipiSize::FULL && scaling_quality.png == ScalingMethod::HIGH && nnx > 1 && nny > 1 && rw > 1 && rh > 1;
+    if (stream_scale) {
+      buffer.resize(nnx * nny * pixel_bytes);
+      resampler = std::make_unique<StreamingResampler>(rw, rh, img->nc, nnx, nny, img->bps, buffer.data());
+    } else {
+      buffer.resize(rw * rh * pixel_bytes);
+    }
+    row.resize(sll);
+
+    const size_t row_end = static_cast<size_t>(ry) + rh;
+    for (size_t y = 0; y < row_end; y++) {
+      // Between rows libpng is not on the stack, so the unwind is ours to make.
+      if (y % kDecodeCancelRows == 0 && decode_cancelled()) {
+        png_destroy_read_struct(&png_ptr, &info_ptr, nullptr);
+        throw_decode_cancelled();
+      }
+      png_read_row(png_ptr, row.data(), nullptr);
+      if (y < static_cast<size_t>(ry)) { continue; }
+      uint8_t *src = row.data() + static_cast<size_t>(rx) * pixel_bytes;
+      if (img->bps == 16) {
+        auto *tmp = (unsigned short *)src;
+        for (size_t i = 0; i < rw * img->nc; i++) { tmp[i] = ntohs(tmp[i]); }
+      }
+      if (resampler != nullptr) {
+        resampler->push_row(src);
+      } else {
+        memcpy(buffer.data() + (y - ry) * rw * pixel_bytes, src, rw * pixel_bytes);
+      }
+    }
+    report_decoded(static_cast<std::uint64_t>(width) * row_end, DecodePath::Full);
+    // Only rows up to the end of the region were decoded; png_read_end would
+    // inflate the rest, so finish only when the whole image was consumed.
+    if (row_end == height) { png_read_end(png_ptr, info_ptr); }
+    png_destroy_read_struct(&png_ptr, &info_ptr, nullptr);
 
-  if (region != nullptr) {// we just use the image.crop method
-    (void)img->crop(region);
+    img->pixels = std::move(buffer);
+    img->nx = resampler != nullptr ? nnx : rw;
+    img->ny = resampler != nullptr ? nny : rh;
+    if (resampler != nullptr) { rtype = SipiSize::FULL; }// already at the output size
+    resampler.reset();
   }
 
+  infile.reset();
+
   //
   // resize/Scale the image if necessary
   //
-  if (size != nullptr) {
-    size_t nnx, nny;
-    int reduce = -1;
-    bool redonly;
-    SipiSize::SizeType rtype = size->get_size(img->nx, img->ny, nnx, nny, reduce, redonly);
-    if (rtype != SipiSize::FULL) {
-      switch (scaling_quality.png) {
-      case ScalingMethod::HIGH:
-        img->scale(nnx, nny);
-        break;
-      case ScalingMethod::MEDIUM:
-        img->scaleMedium(nnx, nny);
-        break;
-      case ScalingMethod::LOW:
-        img->scaleFast(nnx, nny);
-      }
+  if (rtype != SipiSize::FULL) {
+    switch (scaling_quality.png) {
+    case ScalingMethod::HIGH:
+      img->scale(nnx, nny);
+      break;
+    case ScalingMethod::MEDIUM:
+      img->scaleMedium(nnx, nny);
+      break;
+    case ScalingMethod::LOW:
+      img->scaleFast(nnx, nny);
     }
   }
 
@@ -21,7 +21,9 @@
  * -c opt binary (ADR-0003; docs/src/development/benchmarking.md).
  */
 
+#include <algorithm>
 #include <cassert>
+#include <csetjmp>
 #include <cstdarg>
 #include <cstddef>
 #include <cstdlib>
@@ -33,6 +35,8 @@
 #include <memory>
 #include <span>
 #include <string>
+#include <thread>
+#include <utility>
 #include <vector>
 
 #include <cerrno>
@@ -41,9 +45,15 @@
 #include "SipiError.h"
 #include "SipiImage.h"
 #include "SipiImageError.h"
+#include "decode_cancel.h"
+#include "decode_report.h"
 #include "formats/SipiIOTiff.h"
 #include "observability/metrics.h"
 #include "observability/profiling.h"
+#include "resample.h"
+
+#include "jerror.h"
+#include "jpeglib.h"
 
 
 #include "util/Global.h"
@@ -59,19 +69,19 @@ typedef struct _memtiff
 {
   unsigned char *data;
   tsize_t size;
-  tsize_t incsiz;
   tsize_t flen;
   toff_t fptr;
 } MEMTIFF;
 
-static MEMTIFF *memTiffOpen(tsize_t incsiz = 10240, tsize_t initsiz = 10240)
+// `initsiz` should be the expected file size (see estimate_tiff_size): the
+// buffer is allocated once at that size and only grows, geometrically, if the
+// estimate was short.
+static MEMTIFF *memTiffOpen(tsize_t initsiz = 10240)
 {
   MEMTIFF *memtif;
   if ((memtif = (MEMTIFF *)malloc(sizeof(MEMTIFF))) == nullptr) { throw Sipi::SipiImageError("malloc failed", errno); }
 
-  memtif->incsiz = incsiz;
-
-  if (initsiz == 0) initsiz = incsiz;
+  if (initsiz <= 0) initsiz = 10240;
 
   if ((memtif->data = (unsigned char *)malloc(initsiz * sizeof(unsigned char))) == nullptr) {
     free(memtif);
@@ -85,6 +95,22 @@ static MEMTIFF *memTiffOpen(tsize_t incsiz = 10240, tsize_t initsiz = 10240)
 }
 /*===========================================================================*/
 
+// Makes room for `needed` bytes. The capacity at least doubles on each growth,
+// so a long run of appends costs amortised O(1) copying per byte instead of a
+// realloc every few kilobytes. Returns false if realloc fails.
+static bool memTiffReserve(MEMTIFF *memtif, tsize_t needed)
+{
+  if (needed <= memtif->size) return true;
+  const tsize_t newsize = std::max(needed, memtif->size * 2);
+  // Use temp variable to avoid losing original pointer on realloc failure
+  auto *newdata = (unsigned char *)realloc(memtif->data, newsize);
+  if (newdata == nullptr) return false;
+  memtif->data = newdata;
+  memtif->size = newsize;
+  return true;
+}
+/*===========================================================================*/
+
 static tsize_t memTiffReadProc(thandle_t handle, tdata_t buf, tsize_t size)
 {
   auto *memtif = (MEMTIFF *)handle;
@@ -108,76 +134,50 @@ static tsize_t memTiffWriteProc(thandle_t handle, tdata_t buf, tsize_t size)
 {
   auto *memtif = (MEMTIFF *)handle;
 
-  if (((tsize_t)memtif->fptr + size) > memtif->size) {
-    // Use temp variable to avoid losing original pointer on realloc failure
-    auto *newdata = (unsigned char *)realloc(memtif->data, memtif->fptr + memtif->incsiz + size);
-    if (newdata == nullptr) {
-      // Return 0 to signal write failure — libtiff treats short writes as errors.
-      // Cannot throw: this is called from libtiff's C code.
-      return 0;
-    }
-    memtif->data = newdata;
-    memtif->size = memtif->fptr + memtif->incsiz + size;
+  if (!memTiffReserve(memtif, (tsize_t)memtif->fptr + size)) {
+    // Return 0 to signal write failure — libtiff treats short writes as errors.
+    // Cannot throw: this is called from libtiff's C code.
+    return 0;
   }
 
   memcpy(memtif->data + memtif->fptr, buf, size);
   memtif->fptr += size;
 
-  if (memtif->fptr > memtif->flen) memtif->flen = memtif->fptr;
+  if ((tsize_t)memtif->fptr > memtif->flen) memtif->flen = memtif->fptr;
 
   return size;
 }
 /*===========================================================================*/
 
+// Offsets are relative to the written length (`flen`), not the capacity.
+// Seeking past the end extends the file with zeros, as a sparse file would read.
 static toff_t memTiffSeekProc(thandle_t handle, toff_t off, int whence)
 {
   auto *memtif = (MEMTIFF *)handle;
 
+  toff_t pos;
   switch (whence) {
-  case SEEK_SET: {
-    if ((tsize_t)off > memtif->size) {
-      auto *newdata = (unsigned char *)realloc(memtif->data, memtif->size + memtif->incsiz + off);
-      if (newdata == nullptr) {
-        return (toff_t)-1;  // signal seek failure to libtiff
-      }
-      memtif->data = newdata;
-      memtif->size = memtif->size + memtif->incsiz + off;
-    }
-
-    memtif->fptr = off;
+  case SEEK_SET:
+    pos = off;
     break;
-  }
-  case SEEK_CUR: {
-    if ((tsize_t)(memtif->fptr + off) > memtif->size) {
-      auto *newdata = (unsigned char *)realloc(memtif->data, memtif->fptr + memtif->incsiz + off);
-      if (newdata == nullptr) {
-        return (toff_t)-1;
-      }
-      memtif->data = newdata;
-      memtif->size = memtif->fptr + memtif->incsiz + off;
-    }
-
-    memtif->fptr += off;
+  case SEEK_CUR:
+    pos = memtif->fptr + off;
     break;
-  }
-  case SEEK_END: {
-    if ((tsize_t)(memtif->size + off) > memtif->size) {
-      auto *newdata = (unsigned char *)realloc(memtif->data, memtif->size + memtif->incsiz + off);
-      if (newdata == nullptr) {
-        return (toff_t)-1;
-      }
-      memtif->data = newdata;
-      memtif->size = memtif->size + memtif->incsiz + off;
-    }
-
-    memtif->fptr = memtif->size + off;
+  case SEEK_END:
+    pos = memtif->flen + off;
     break;
-  }
-  default: {
-  }
+  default:
+    return (toff_t)-1;
   }
 
-  if (memtif->fptr > memtif->flen) memtif->flen = memtif->fptr;
+  if ((tsize_t)pos > memtif->flen) {
+    if (!memTiffReserve(memtif, (tsize_t)pos)) {
+      return (toff_t)-1;// signal seek failure to libtiff
+    }
+    memset(memtif->data + memtif->flen, 0, pos - memtif->flen);
+    memtif->flen = pos;
+  }
+  memtif->fptr = pos;
   return memtif->fptr;
 }
 /*===========================================================================*/
@@ -218,6 +218,10 @@ static void memTiffFree(MEMTIFF *memtif)
   free(memtif);
 }
 /*===========================================================================*/
+
+// Release function for a buffer detached from a MEMTIFF and handed to the sink.
+static void memTiffReleaseData(uint8_t *data) { free(data); }
+/*===========================================================================*/
 }
 
 
@@ -541,6 +545,13 @@ std::vector<T> separateToContig(std::vector<T> &&inbuf, uint32_t nx, uint32_t ny
   return tmpptr;
 }
 
+// Strips of an untiled TIFF covering the rows [roi_y, roi_y + roi_h) are read
+// directly with TIFFReadEncodedStrip: rows outside the ROI are never
+// decompressed, and — unlike TIFFReadScanline, which has to decode a compressed
+// image sequentially from the top — a lower ROI costs no more than an upper one.
+// Compressed strips are independent, so they are decoded in parallel, one
+// worker per core (as the JPEG2000 decode does), each on its own TIFF handle:
+// a TIFF* carries file position and codec state and cannot be shared.
 template<typename T>
 static std::vector<T> read_standard_data(TIFF *tif, int32_t roi_x, int32_t roi_y, uint32_t roi_w, uint32_t roi_h)
 {
@@ -548,7 +559,7 @@ static std::vector<T> read_standard_data(TIFF *tif, int32_t roi_x, int32_t roi_y
   TIFF_GET_FIELD(tif, TIFFTAG_PLANARCONFIG, &planar, PLANARCONFIG_CONTIG)
   uint16_t compression;
   TIFF_GET_FIELD(tif, TIFFTAG_COMPRESSION, &compression, COMPRESSION_NONE)
-  auto sll = static_cast<uint32_t>(TIFFScanlineSize(tif));
+  const auto sll = static_cast<uint32_t>(TIFFScanlineSize(tif));
 
   uint32_t nx, ny, nc, bps;
   TIFFGetField(tif, TIFFTAG_IMAGEWIDTH, &nx);
@@ -567,168 +578,141 @@ static std::vector<T> read_standard_data(TIFF *tif, int32_t roi_x, int32_t roi_y
     photo = static_cast<PhotometricInterpretation>(stmp);
   }
 
-  uint8_t black, white;
-  if (photo == PhotometricInterpretation::MINISBLACK) {
-    black = 0x00;// 0b0 -> 0x00
-    white = 0xff;// 0b1 -> 0xff
-  } else if (photo == PhotometricInterpretation::MINISWHITE) {
+  uint8_t black = 0x00, white = 0xff;// MINISBLACK: 0b0 -> 0x00, 0b1 -> 0xff
+  if (photo == PhotometricInterpretation::MINISWHITE) {
     black = 0xff;// 0b0 -> 0xff
     white = 0x00;// 0b1 -> 0x00
   }
+  const bool is_palette = photo == PhotometricInterpretation::PALETTE;
+
+  uint32_t rows_per_strip;
+  TIFFGetFieldDefaulted(tif, TIFFTAG_ROWSPERSTRIP, &rows_per_strip);
+  if (rows_per_strip == 0 || rows_per_strip > ny) { rows_per_strip = ny; }
+  if (roi_w == 0 || roi_h == 0) { return {}; }
+
+  // One plane for contiguous data; separate planes are read plane by plane into
+  // a planar buffer and interleaved afterwards.
+  const uint32_t planes = planar == PLANARCONFIG_SEPARATE ? nc : 1;
+  const uint32_t spp = planar == PLANARCONFIG_SEPARATE ? 1 : nc;// samples per pixel within a plane
+  const uint32_t strips_per_plane = (ny + rows_per_strip - 1) / rows_per_strip;
+  const uint32_t first_strip = static_cast<uint32_t>(roi_y) / rows_per_strip;
+  const uint32_t last_strip = (static_cast<uint32_t>(roi_y) + roi_h - 1) / rows_per_strip;
+
+  // (plane, strip) pairs to decode, in file order.
+  std::vector<std::pair<uint32_t, uint32_t>> jobs;
+  jobs.reserve(planes * (last_strip - first_strip + 1));
+  for (uint32_t c = 0; c < planes; ++c) {
+    for (uint32_t st = first_strip; st <= last_strip; ++st) { jobs.emplace_back(c, st); }
+  }
 
-  uint32_t psiz;
-  if (bps <= 8) {// 1, 4, 8 bit -> 8 bit
-    psiz = sizeof(uint8_t);
-  } else {// 12, 16 bit -> 16 bit
-    psiz = sizeof(uint16_t);
-  }
-
-  std::vector<T> inbuf(roi_h * roi_w * nc);
-  auto scanline = std::make_unique<uint8_t[]>(sll);
-  std::unique_ptr<T[]> line;
-  if (compression == COMPRESSION_NONE) {
-    if (planar == PLANARCONFIG_CONTIG) {// RGBRGBRGBRGB...
-      line = std::make_unique<T[]>(nx * nc);
-      for (uint32_t i = roi_y; i < roi_y + roi_h; ++i) {
-        if (TIFFReadScanline(tif, scanline.get(), i, 0) != 1) {
-          throw Sipi::SipiImageError("TIFFReadScanline failed on scanline " + std::to_string(i)
-            + ", dimensions=" + std::to_string(nx) + "x" + std::to_string(ny)
-            + ", channels=" + std::to_string(nc) + ", bps=" + std::to_string(bps));
-        }
-        // All memcpy destination offsets use `(i - roi_y)` so the first
-        // destination row is always row 0 of `inbuf`. Previously cases 1
-        // and 4 used `i * roi_w` and overflowed for any roi_y > 0.
-        switch (bps) {
-        case 1:
-          one2eight<T>(scanline.get(), line.get(), nc * nx, black, white);
-          std::memcpy(inbuf.data() + nc * (i - roi_y) * roi_w, line.get() + nc * roi_x, nc * roi_w);
-          break;
-        case 4:
-          four2eight<T>(scanline.get(), line.get(), nc * nx, photo == PhotometricInterpretation::PALETTE);
-          std::memcpy(inbuf.data() + nc * (i - roi_y) * roi_w, line.get() + nc * roi_x, nc * roi_w);
-          break;
-        case 8:
-          std::memcpy(inbuf.data() + nc * (i - roi_y) * roi_w, scanline.get() + nc * roi_x, nc * roi_w);
-          break;
-        case 12:
-          twelve2sixteen<T>(scanline.get(), line.get(), nc * nx, photo == PhotometricInterpretation::PALETTE);
-          std::memcpy(inbuf.data() + nc * (i - roi_y) * roi_w, line.get() + nc * roi_x, nc * roi_w * psiz);
-          break;
-        case 16:
-          std::memcpy(inbuf.data() + nc * (i - roi_y) * roi_w, scanline.get() + nc * roi_x * psiz, nc * roi_w * psiz);
-          break;
-        default:;
-        }
-      }
-    } else if (planar == PLANARCONFIG_SEPARATE) {// RRRRR…RRR GGGGG…GGGG BBBBB…BBB
-      line = std::make_unique<T[]>(nx);
-      for (uint32_t c = 0; c < nc; ++c) {
-        for (uint32_t i = roi_y; i < roi_h; ++i) {
-          if (TIFFReadScanline(tif, scanline.get(), i, c) == -1) {
-            throw Sipi::SipiImageError("TIFFReadScanline failed on scanline " + std::to_string(i)
-              + ", dimensions=" + std::to_string(nx) + "x" + std::to_string(ny)
-              + ", channels=" + std::to_string(nc) + ", bps=" + std::to_string(bps));
-          }
-          switch (bps) {
-          case 1:
-            one2eight<T>(scanline.get(), line.get(), nx, black, white);
-            std::memcpy(inbuf.data() + nc * roi_w + roi_h + i * roi_w, line.get() + roi_x, roi_w);
-            break;
-          case 4:
-            four2eight<T>(scanline.get(), line.get(), nx, photo == PhotometricInterpretation::PALETTE);
-            std::memcpy(inbuf.data() + nc * roi_w + roi_h + i * roi_w, line.get() + roi_x, roi_w);
-            break;
-          case 8:
-            std::memcpy(inbuf.data() + nc * roi_w + roi_h + i * roi_w, scanline.get() + roi_x, roi_w);
-            break;
-          case 12:
-            twelve2sixteen<T>(scanline.get(), line.get(), nx, photo == PhotometricInterpretation::PALETTE);
-            std::memcpy(inbuf.data() + nc * roi_w + roi_h + i * roi_w, line.get() + roi_x, roi_w * psiz);
-            break;
-          case 16:
-            std::memcpy(inbuf.data() + nc * roi_w + roi_h + i * roi_w, scanline.get() + roi_x * psiz, roi_w * psiz);
-            break;
-          default:;
-          }
-        }
-      }
-      inbuf = separateToContig<T>(std::move(inbuf), roi_w, roi_h, nc, roi_w);
-    }
-  } else {// we do have compression....
-    if (planar == PLANARCONFIG_CONTIG) {// RGBRGBRGBRGB...
-      line = std::make_unique<T[]>(nx * nc);
-      for (uint32_t i = 0; i < ny; ++i) {
-        if (TIFFReadScanline(tif, scanline.get(), i, 0) != 1) {
-          throw Sipi::SipiImageError("TIFFReadScanline failed on scanline " + std::to_string(i)
-            + ", dimensions=" + std::to_string(nx) + "x" + std::to_string(ny)
-            + ", channels=" + std::to_string(nc) + ", bps=" + std::to_string(bps));
-        }
-        if ((i >= roi_y) && (i < (roi_y + roi_h))) {
-          // All memcpy destination offsets use `(i - roi_y)` so that the
-          // first destination row written is always row 0 of `inbuf`,
-          // regardless of where in the image the ROI starts. Previously
-          // cases 1, 4, 12, 16 used `i * roi_w` and overflowed `inbuf` for
-          // any roi_y > 0.
-          switch (bps) {
-          case 1:
-            one2eight<T>(scanline.get(), line.get(), nc * nx, black, white);
-            std::memcpy(inbuf.data() + nc * (i - roi_y) * roi_w, line.get() + nc * roi_x, nc * roi_w);
-            break;
-          case 4:
-            four2eight<T>(scanline.get(), line.get(), nc * nx, photo == PhotometricInterpretation::PALETTE);
-            std::memcpy(inbuf.data() + nc * (i - roi_y) * roi_w, line.get() + nc * roi_x, nc * roi_w);
-            break;
-          case 8:
-            std::memcpy(inbuf.data() + nc * (i - roi_y) * roi_w, scanline.get() + nc * roi_x, nc * roi_w);
-            break;
-          case 12:
-            twelve2sixteen<T>(scanline.get(), line.get(), nc * nx, photo == PhotometricInterpretation::PALETTE);
-            std::memcpy(inbuf.data() + nc * (i - roi_y) * roi_w, line.get() + nc * roi_x * psiz, nc * roi_w * psiz);
-            break;
-          case 16:
-            std::memcpy(inbuf.data() + nc * (i - roi_y) * roi_w, scanline.get() + nc * roi_x * psiz, nc * roi_w * psiz);
-            break;
-          default:;
-          }
-        }
-      }
-    } else if (planar == PLANARCONFIG_SEPARATE) {// RRRRR…RRR GGGGG…GGGG BBBBB…BBB
-      line = std::make_unique<T[]>(nx);
-      for (uint32_t c = 0; c < nc; ++c) {
-        for (uint32_t i = 0; i < ny; ++i) {
-          if (TIFFReadScanline(tif, scanline.get(), i, c) == -1) {
-            throw Sipi::SipiImageError("TIFFReadScanline failed on scanline " + std::to_string(i)
-              + ", dimensions=" + std::to_string(nx) + "x" + std::to_string(ny)
-              + ", channels=" + std::to_string(nc) + ", bps=" + std::to_string(bps));
+  // Whole strips are decoded, across the full width.
+  const uint32_t strips_end = std::min(ny, (last_strip + 1) * rows_per_strip);
+  report_decoded(static_cast<std::uint64_t>(strips_end - first_strip * rows_per_strip) * nx, DecodePath::Full);
+  for (const auto &[c, st] : jobs) {
+    if (const tmsize_t n = TIFFRawStripSize(tif, c * strips_per_plane + st); n > 0) {
+      report_decode_bytes(static_cast<std::uint64_t>(n));
+    }
+  }
+
+  std::vector<T> inbuf(static_cast<size_t>(roi_h) * roi_w * nc);
+
+  // Copies the ROI columns of one decoded row into inbuf, widening 1/4/12-bit
+  // samples on the way.
+  auto copy_row = [&](const uint8_t *scanline, T *line, uint32_t row, uint32_t c) {
+    T *dst = planes == 1 ? inbuf.data() + static_cast<size_t>(nc) * (row - roi_y) * roi_w
+                         : inbuf.data() + (static_cast<size_t>(c) * roi_h + (row - roi_y)) * roi_w;
+    const size_t first = static_cast<size_t>(spp) * roi_x;
+    const size_t count = static_cast<size_t>(spp) * roi_w;
+    switch (bps) {
+    case 1:
+      one2eight<T>(scanline, line, spp * nx, black, white);
+      std::memcpy(dst, line + first, count * sizeof(T));
+      break;
+    case 4:
+      four2eight<T>(scanline, line, spp * nx, is_palette);
+      std::memcpy(dst, line + first, count * sizeof(T));
+      break;
+    case 12:
+      twelve2sixteen<T>(scanline, line, spp * nx, is_palette);
+      std::memcpy(dst, line + first, count * sizeof(T));
+      break;
+    case 8:
+    case 16:
+      std::memcpy(dst, scanline + first * sizeof(T), count * sizeof(T));
+      break;
+    default:;
+    }
+  };
+
+  // Decodes jobs[begin, end) through `handle`, stopping early once the decode
+  // is cancelled (`owner`: the calling thread, which polls for it). Returns an
+  // error message, empty on success.
+  DecodeCancelFanout cancel;
+  auto decode_jobs = [&](TIFF *handle, size_t begin, size_t end, bool owner) -> std::string {
+    auto stripbuf = std::make_unique<uint8_t[]>(static_cast<size_t>(TIFFStripSize(handle)));
+    auto line = std::make_unique<T[]>(static_cast<size_t>(spp) * nx);
+    for (size_t j = begin; j < end; ++j) {
+      if (owner ? cancel.poll() : cancel.stopped()) { return {}; }
+      const auto [c, st] = jobs[j];
+      const uint32_t strip_row0 = st * rows_per_strip;
+      const uint32_t strip_rows = std::min(rows_per_strip, ny - strip_row0);
+      if (TIFFReadEncodedStrip(handle, c * strips_per_plane + st, stripbuf.get(), static_cast<tmsize_t>(sll) * strip_rows)
+          == -1) {
+        return "TIFFReadEncodedStrip failed on strip " + std::to_string(c * strips_per_plane + st)
+               + ", dimensions=" + std::to_string(nx) + "x" + std::to_string(ny) + ", channels=" + std::to_string(nc)
+               + ", bps=" + std::to_string(bps);
+      }
+      const uint32_t row_begin = std::max(strip_row0, static_cast<uint32_t>(roi_y));
+      const uint32_t row_end = std::min(strip_row0 + strip_rows, static_cast<uint32_t>(roi_y) + roi_h);
+      for (uint32_t row = row_begin; row < row_end; ++row) {
+        copy_row(stripbuf.get() + static_cast<size_t>(row - strip_row0) * sll, line.get(), row, c);
+      }
+    }
+    return {};
+  };
+
+  size_t nworkers = 1;
+  if (compression != COMPRESSION_NONE) {
+    nworkers = std::min<size_t>(std::max(1U, std::thread::hardware_concurrency()), jobs.size());
+  }
+
+  if (nworkers <= 1) {
+    if (auto err = decode_jobs(tif, 0, jobs.size(), true); !err.empty()) { throw Sipi::SipiImageError(err); }
+  } else {
+    const char *filename = TIFFFileName(tif);
+    const tdir_t dir = TIFFCurrentDirectory(tif);
+    const size_t chunk = (jobs.size() + nworkers - 1) / nworkers;
+    std::vector<std::string> errors(nworkers);
+    {
+      std::vector<std::jthread> workers;
+      workers.reserve(nworkers - 1);
+      for (size_t w = 1; w < nworkers; ++w) {
+        workers.emplace_back([&, w] {
+          const size_t begin = w * chunk;
+          const size_t end = std::min(jobs.size(), begin + chunk);
+          if (begin >= end) { return; }
+          std::unique_ptr<TIFF, decltype(&TIFFClose)> own(TIFFOpen(filename, "r"), TIFFClose);
+          if (own == nullptr || TIFFSetDirectory(own.get(), dir) == 0) {
+            errors[w] = std::string("Cannot reopen TIFF for parallel strip decode: ") + filename;
+            return;
           }
-          if ((i >= roi_y) && (i < (roi_y + roi_h))) {
-            switch (bps) {
-            case 1:
-              one2eight<T>(scanline.get(), line.get(), nx, black, white);
-              std::memcpy(inbuf.data() + nc * roi_w + roi_h + i * roi_w, line.get() + roi_x, roi_w);
-              break;
-            case 4:
-              four2eight<T>(scanline.get(), line.get(), nx, photo == PhotometricInterpretation::PALETTE);
-              std::memcpy(inbuf.data() + nc * roi_w + roi_h + i * roi_w, line.get() + roi_x, roi_w);
-              break;
-            case 8:
-              std::memcpy(inbuf.data() + nc * roi_w + roi_h + i * roi_w, scanline.get() + roi_x, roi_w);
-              break;
-            case 12:
-              twelve2sixteen<T>(scanline.get(), line.get(), nx, photo == PhotometricInterpretation::PALETTE);
-              std::memcpy(inbuf.data() + nc * roi_w + roi_h + i * roi_w, line.get() + roi_x * psiz, roi_w * psiz);
-              break;
-            case 16:
-              std::memcpy(inbuf.data() + nc * roi_w + roi_h + i * roi_w, scanline.get() + roi_x * psiz, roi_w * psiz);
-              break;
-            default:;
-            }
+          TIFFSetField(own.get(), TIFFTAG_JPEGCOLORMODE, JPEGCOLORMODE_RGB);
+          try {
+            errors[w] = decode_jobs(own.get(), begin, end, false);
+          } catch (const std::bad_alloc &) {
+            errors[w] = "Out of memory in parallel strip decode";
           }
-        }
+        });
       }
-      inbuf = separateToContig<T>(std::move(inbuf), roi_w, roi_h, nc, roi_w);
+      errors[0] = decode_jobs(tif, 0, std::min(jobs.size(), chunk), true);
+    }// joins the workers
+    for (const auto &err : errors) {
+      if (!err.empty()) { throw Sipi::SipiImageError(err); }
     }
   }
+  if (cancel.stopped()) { throw_decode_cancelled(); }
+
+  if (planes > 1) { inbuf = separateToContig<T>(std::move(inbuf), roi_w, roi_h, nc, roi_w); }
   return inbuf;
 }
 
@@ -814,8 +798,16 @@ static std::vector<T> read_tiled_data(TIFF *tif, int32_t roi_x, int32_t roi_y, u
   uint32_t tile_size = TIFFTileSize(tif);
   auto tilebuf = std::make_unique<T[]>(bps == 8 ? tile_size : (tile_size >> 1));
   auto inbuf = std::vector<T>(roi_w * roi_h * nc);
+  report_decoded(static_cast<std::uint64_t>(endtile_x - starttile_x) * (endtile_y - starttile_y) * tile_width
+                   * tile_length,
+    DecodePath::Full);
   for (uint32_t ty = starttile_y; ty < endtile_y; ++ty) {
     for (uint32_t tx = starttile_x; tx < endtile_x; ++tx) {
+      check_decode_cancelled();
+      if (const tmsize_t n = TIFFRawTileSize(tif, TIFFComputeTile(tif, tx * tile_width, ty * tile_length, 0, 0));
+          n > 0) {
+        report_decode_bytes(static_cast<std::uint64_t>(n));
+      }
       if (TIFFReadTile(tif, tilebuf.get(), tx * tile_width, ty * tile_length, 0, 0) < 0) {
         throw Sipi::SipiImageError("TIFFReadTile failed on tile (" + std::to_string(tx) + ", " + std::to_string(ty) + ")"
           + ", dimensions=" + std::to_string(nx) + "x" + std::to_string(ny)
@@ -844,6 +836,183 @@ static std::vector<T> read_tiled_data(TIFF *tif, int32_t roi_x, int32_t roi_y, u
   }
   return inbuf;
 }
+// libjpeg error manager for the JPEG-in-TIFF tile decoder: error_exit formats
+// the message and longjmps back to the decoder's setjmp, as in SipiIOJpeg.cpp,
+// so no C++ exception is thrown through libjpeg's C frames.
+struct TileJpegErrorMgr
+{
+  jpeg_error_mgr pub;// must be first — libjpeg casts to this
+  jmp_buf error_jmp;
+  char error_message[JMSG_LENGTH_MAX]{};
+};
+
+static void tileJpegErrorExit(j_common_ptr cinfo)
+{
+  auto *err = reinterpret_cast<TileJpegErrorMgr *>(cinfo->err);
+  (*(cinfo->err->format_message))(cinfo, err->error_message);
+  longjmp(err->error_jmp, 1);
+}
+
+// Whether the current directory's tiles can go through read_jpeg_tiles_scaled:
+// contiguous 8-bit JPEG tiles of gray, RGB, or YCbCr (delivered as RGB, as
+// JPEGCOLORMODE_RGB has libtiff do), without extra samples.
+static bool tiff_jpeg_tiles_scalable(TIFF *tif)
+{
+  uint16_t compression = COMPRESSION_NONE, bps = 0, spp = 1, planar = PLANARCONFIG_CONTIG, photo = 0;
+  TIFFGetField(tif, TIFFTAG_COMPRESSION, &compression);
+  TIFFGetField(tif, TIFFTAG_BITSPERSAMPLE, &bps);
+  TIFFGetField(tif, TIFFTAG_SAMPLESPERPIXEL, &spp);
+  TIFFGetField(tif, TIFFTAG_PLANARCONFIG, &planar);
+  if (!TIFFIsTiled(tif) || compression != COMPRESSION_JPEG || bps != 8 || planar != PLANARCONFIG_CONTIG) return false;
+  if (TIFFGetField(tif, TIFFTAG_PHOTOMETRIC, &photo) != 1) return false;
+  return (photo == PHOTOMETRIC_MINISBLACK && spp == 1)
+         || ((photo == PHOTOMETRIC_RGB || photo == PHOTOMETRIC_YCBCR) && spp == 3);
+}
+
+// Reads the ROI (in the current level's pixels) of a directory whose tiles
+// pass tiff_jpeg_tiles_scalable, decoded at 1/denom by libjpeg-turbo's DCT
+// scaling instead of TIFFReadTile's full-resolution decode: the IDCT only
+// produces the pixels the size stage keeps. Each tile is an abbreviated JPEG
+// stream whose tables are in TIFFTAG_JPEGTABLES. The raw tiles are read
+// serially through `tif` and decoded in parallel, one worker per core, each
+// with its own decompressor. The ROI origin must be a multiple of `denom`
+// (tiff_jpeg_scale_denom); returns ceil(roi_w / denom) × ceil(roi_h / denom)
+// pixels.
+static std::vector<uint8_t> read_jpeg_tiles_scaled(TIFF *tif,
+  uint32_t roi_x,
+  uint32_t roi_y,
+  uint32_t roi_w,
+  uint32_t roi_h,
+  uint32_t denom)
+{
+  uint32_t tile_width = 0, tile_length = 0;
+  TIFFGetField(tif, TIFFTAG_TILEWIDTH, &tile_width);
+  TIFFGetField(tif, TIFFTAG_TILELENGTH, &tile_length);
+  uint16_t spp = 1, photo = 0;
+  TIFFGetField(tif, TIFFTAG_SAMPLESPERPIXEL, &spp);
+  TIFFGetField(tif, TIFFTAG_PHOTOMETRIC, &photo);
+  const uint32_t nc = spp;
+  const bool ycbcr = photo == PHOTOMETRIC_YCBCR;
+  uint32_t tables_len = 0;
+  void *tables = nullptr;
+  if (TIFFGetField(tif, TIFFTAG_JPEGTABLES, &tables_len, &tables) != 1 || tables == nullptr) { tables_len = 0; }
+
+  // Scaled geometry: the ROI and the tile grid at 1/denom.
+  const uint32_t sx = roi_x / denom, sy = roi_y / denom;
+  const uint32_t out_w = (roi_w + denom - 1) / denom, out_h = (roi_h + denom - 1) / denom;
+  const uint32_t stw = tile_width / denom, sth = tile_length / denom;
+
+  struct RawTile
+  {
+    std::vector<uint8_t> data;
+    uint32_t x;// scaled position of the tile's top-left pixel
+    uint32_t y;
+  };
+  std::vector<RawTile> tiles;
+  for (uint32_t ty = roi_y / tile_length * tile_length; ty < roi_y + roi_h; ty += tile_length) {
+    for (uint32_t tx = roi_x / tile_width * tile_width; tx < roi_x + roi_w; tx += tile_width) {
+      const ttile_t tile = TIFFComputeTile(tif, tx, ty, 0, 0);
+      const tmsize_t size = TIFFRawTileSize(tif, tile);
+      if (size <= 0) { throw Sipi::SipiImageError("TIFFRawTileSize failed on tile " + std::to_string(tile)); }
+      RawTile raw{ std::vector<uint8_t>(static_cast<size_t>(size)), tx / denom, ty / denom };
+      if (TIFFReadRawTile(tif, tile, raw.data.data(), size) != size) {
+        throw Sipi::SipiImageError("TIFFReadRawTile failed on tile " + std::to_string(tile));
+      }
+      report_decode_bytes(static_cast<std::uint64_t>(size));
+      tiles.push_back(std::move(raw));
+    }
+  }
+  report_decoded(static_cast<std::uint64_t>(tiles.size()) * stw * sth, DecodePath::DctScaled);
+
+  std::vector<uint8_t> out(static_cast<size_t>(out_w) * out_h * nc);
+
+  // Decodes tiles[begin, end) into `out`, stopping early once the decode is
+  // cancelled (`owner`: the calling thread, which polls for it). Returns an
+  // error message, empty on success.
+  DecodeCancelFanout cancel;
+  auto decode_tiles = [&](size_t begin, size_t end, bool owner) -> std::string {
+    jpeg_decompress_struct cinfo{};
+    TileJpegErrorMgr jerr;
+    std::vector<uint8_t> row(static_cast<size_t>(stw) * nc);
+    cinfo.err = jpeg_std_error(&jerr.pub);
+    jerr.pub.error_exit = tileJpegErrorExit;
+    jpeg_create_decompress(&cinfo);
+    if (setjmp(jerr.error_jmp)) {
+      jpeg_destroy_decompress(&cinfo);
+      return std::string("JPEG tile decode failed: ") + jerr.error_message;
+    }
+    if (tables_len > 0) {
+      jpeg_mem_src(&cinfo, static_cast<const unsigned char *>(tables), tables_len);
+      jpeg_read_header(&cinfo, FALSE);// tables only; they persist for the tiles
+    }
+    for (size_t j = begin; j < end; ++j) {
+      if (owner ? cancel.poll() : cancel.stopped()) { break; }
+      const RawTile &tile = tiles[j];
+      jpeg_mem_src(&cinfo, tile.data.data(), static_cast<unsigned long>(tile.data.size()));
+      jpeg_read_header(&cinfo, TRUE);
+      cinfo.jpeg_color_space = ycbcr ? JCS_YCbCr : JCS_UNKNOWN;
+      cinfo.out_color_space = ycbcr ? JCS_RGB : JCS_UNKNOWN;
+      cinfo.scale_num = 1;
+      cinfo.scale_denom = denom;
+      cinfo.dct_method = JDCT_ISLOW;// bit-exact across platforms (see SipiIOJpeg.cpp)
+      jpeg_start_decompress(&cinfo);
+      if (cinfo.output_width != stw || cinfo.output_height != sth
+          || static_cast<uint32_t>(cinfo.output_components) != nc) {
+        jpeg_destroy_decompress(&cinfo);
+        return "JPEG tile decodes to " + std::to_string(cinfo.output_width) + "x"
+               + std::to_string(cinfo.output_height) + ", expected " + std::to_string(stw) + "x"
+               + std::to_string(sth);
+      }
+      const uint32_t col0 = std::max(tile.x, sx);
+      const uint32_t col1 = std::min(tile.x + stw, sx + out_w);
+      while (cinfo.output_scanline < cinfo.output_height) {
+        const uint32_t gy = tile.y + cinfo.output_scanline;
+        JSAMPROW rowp = row.data();
+        jpeg_read_scanlines(&cinfo, &rowp, 1);
+        if (gy >= sy && gy < sy + out_h && col0 < col1) {
+          std::memcpy(out.data() + (static_cast<size_t>(gy - sy) * out_w + (col0 - sx)) * nc,
+            row.data() + static_cast<size_t>(col0 - tile.x) * nc,
+            static_cast<size_t>(col1 - col0) * nc);
+        }
+      }
+      jpeg_finish_decompress(&cinfo);
+    }
+    jpeg_destroy_decompress(&cinfo);
+    return {};
+  };
+
+  const size_t nworkers = std::min<size_t>(std::max(1U, std::thread::hardware_concurrency()), tiles.size());
+  if (nworkers <= 1) {
+    if (auto err = decode_tiles(0, tiles.size(), true); !err.empty()) { throw Sipi::SipiImageError(err); }
+    if (cancel.stopped()) { throw_decode_cancelled(); }
+    return out;
+  }
+  const size_t chunk = (tiles.size() + nworkers - 1) / nworkers;
+  std::vector<std::string> errors(nworkers);
+  {
+    std::vector<std::jthread> workers;
+    workers.reserve(nworkers - 1);
+    for (size_t w = 1; w < nworkers; ++w) {
+      workers.emplace_back([&, w] {
+        const size_t begin = w * chunk;
+        const size_t end = std::min(tiles.size(), begin + chunk);
+        if (begin >= end) { return; }
+        try {
+          errors[w] = decode_tiles(begin, end, false);
+        } catch (const std::bad_alloc &) {
+          errors[w] = "Out of memory in parallel JPEG tile decode";
+        }
+      });
+    }
+    errors[0] = decode_tiles(0, std::min(tiles.size(), chunk), true);
+  }// joins the workers
+  for (const auto &err : errors) {
+    if (!err.empty()) { throw Sipi::SipiImageError(err); }
+  }
+  if (cancel.stopped()) { throw_decode_cancelled(); }
+  return out;
+}
+
 // get the resolutions of pyramid if available
 std::vector<SubImageInfo> read_resolutions(uint64_t image_width, TIFF *tif)
 {
@@ -886,6 +1055,74 @@ uint32_t select_pyramid_level(const std::vector<SubImageInfo> &resolutions, int
   return level;
 }
 
+std::optional<TiffTileCopy> plan_tiff_tile_copy(const std::vector<SubImageInfo> &resolutions,
+  uint32_t x,
+  uint32_t y,
+  uint32_t w,
+  uint32_t h,
+  int reduce_exp)
+{
+  if (resolutions.empty() || reduce_exp < 0 || reduce_exp > 31) return std::nullopt;
+  const uint32_t level = select_pyramid_level(resolutions, reduce_exp);
+  const SubImageInfo &full = resolutions[0];
+  const SubImageInfo &lv = resolutions[level];
+  const uint64_t ratio = uint64_t{ 1 } << reduce_exp;
+  if (lv.reduce != ratio || lv.tile_width == 0 || lv.tile_height == 0) return std::nullopt;
+  // Only a rounded-up reduction maps full-resolution coordinates exactly.
+  if (lv.width != (full.width + ratio - 1) / ratio || lv.height != (full.height + ratio - 1) / ratio) {
+    return std::nullopt;
+  }
+
+  // One axis: [pos, pos + len) of `extent` full-resolution pixels onto a level
+  // of `level_extent` pixels tiled every `tile`.
+  const auto map_axis = [ratio](uint32_t extent,
+                          uint32_t level_extent,
+                          uint32_t tile,
+                          uint32_t pos,
+                          uint32_t len,
+                          uint32_t &level_pos,
+                          uint32_t &level_len) {
+    if (len == 0 || pos >= extent || len > extent - pos) return false;
+    const uint64_t end = static_cast<uint64_t>(pos) + len;
+    if (pos % ratio != 0 || (end != extent && end % ratio != 0)) return false;
+    const uint64_t level_end = end == extent ? level_extent : end / ratio;
+    level_pos = static_cast<uint32_t>(pos / ratio);
+    if (level_pos % tile != 0 || (level_end != level_extent && level_end % tile != 0)) return false;
+    level_len = static_cast<uint32_t>(level_end - level_pos);
+    return true;
+  };
+
+  TiffTileCopy job;
+  job.level = level;
+  if (!map_axis(full.width, lv.width, lv.tile_width, x, w, job.x, job.w)
+      || !map_axis(full.height, lv.height, lv.tile_height, y, h, job.y, job.h)) {
+    return std::nullopt;
+  }
+  return job;
+}
+
+uint32_t tiff_jpeg_scale_denom(const SubImageInfo &level,
+  int reduce_exp,
+  uint32_t x,
+  uint32_t y,
+  uint32_t w,
+  uint32_t h)
+{
+  if (reduce_exp <= 0 || level.reduce == 0 || level.tile_width == 0 || level.tile_height == 0) return 1;
+  if (reduce_exp > 31) reduce_exp = 31;
+  const uint32_t residual = (1u << static_cast<uint32_t>(reduce_exp)) / level.reduce;
+  const uint64_t end_x = static_cast<uint64_t>(x) + w;
+  const uint64_t end_y = static_cast<uint64_t>(y) + h;
+  if (w == 0 || h == 0 || end_x > level.width || end_y > level.height) return 1;
+  for (uint32_t denom = 8; denom > 1; denom >>= 1) {
+    if (denom > residual || level.tile_width % denom != 0 || level.tile_height % denom != 0) continue;
+    if (x % denom != 0 || y % denom != 0) continue;
+    if ((end_x != level.width && end_x % denom != 0) || (end_y != level.height && end_y % denom != 0)) continue;
+    return denom;
+  }
+  return 1;
+}
+
 #include <iostream>
 std::ostream &operator<<(std::ostream &os, const SubImageInfo &s)
 {
@@ -911,571 +1148,645 @@ bool SipiIOTiff::read(SipiImage *img,
 {
   SIPI_ZONE_N("SipiIOTiff::read");
   std::unique_ptr<TIFF, decltype(&TIFFClose)> tif_guard(TIFFOpen(filepath.c_str(), "r"), TIFFClose);
+  if (tif_guard == nullptr) { return false; }
+  TiffHeader header;
+  read_header(img, tif_guard.get(), filepath, header);
+  read_pixels(img, tif_guard.get(), filepath, header, std::move(region), std::move(size), force_bps_8, scaling_quality);
+  return true;
+}
 
-  if (tif_guard != nullptr) {
-    TIFF *tif = tif_guard.get();
-    TIFFSetErrorHandler(tiffError);
-    TIFFSetWarningHandler(tiffWarning);
-    TIFFSetField(tif, TIFFTAG_JPEGCOLORMODE, JPEGCOLORMODE_RGB);
+bool SipiIOTiff::read_tiles(const std::string &filepath,
+  const std::vector<SipiTileRequest> &tiles,
+  bool force_bps_8,
+  ScalingQuality scaling_quality,
+  const SipiTileEmit &emit)
+{
+  SIPI_ZONE_N("SipiIOTiff::read_tiles");
+  std::unique_ptr<TIFF, decltype(&TIFFClose)> tif_guard(TIFFOpen(filepath.c_str(), "r"), TIFFClose);
+  if (tif_guard == nullptr) { return false; }
+  // Every tile starts from a copy of the file's tags and metadata.
+  SipiImage file;
+  TiffHeader header;
+  read_header(&file, tif_guard.get(), filepath, header);
+  for (std::size_t i = 0; i < tiles.size(); ++i) {
+    SipiImage tile(file);
+    read_pixels(
+      &tile, tif_guard.get(), filepath, header, tiles[i].region, tiles[i].size, force_bps_8, scaling_quality);
+    emit(i, tile);
+  }
+  return true;
+}
 
-    //
-    // OK, it's a TIFF file
-    //
-    uint16_t safo, ori, planar, stmp;
+void SipiIOTiff::read_header(SipiImage *img, TIFF *tif, const std::string &filepath, TiffHeader &header)
+{
+  TIFFSetErrorHandler(tiffError);
+  TIFFSetWarningHandler(tiffWarning);
+  TIFFSetField(tif, TIFFTAG_JPEGCOLORMODE, JPEGCOLORMODE_RGB);
 
-    (void)TIFFSetWarningHandler(nullptr);
+  //
+  // OK, it's a TIFF file
+  //
+  uint16_t safo, ori, planar, stmp;
 
-    if (TIFFGetField(tif, TIFFTAG_IMAGEWIDTH, &(img->nx)) == 0) {
-      std::string msg = "TIFFGetField of TIFFTAG_IMAGEWIDTH failed: " + filepath;
-      throw Sipi::SipiImageError(msg);
-    }
+  (void)TIFFSetWarningHandler(nullptr);
 
-    if (TIFFGetField(tif, TIFFTAG_IMAGELENGTH, &(img->ny)) == 0) {
-      std::string msg = "TIFFGetField of TIFFTAG_IMAGELENGTH failed: " + filepath;
-      throw Sipi::SipiImageError(msg);
-    }
+  if (TIFFGetField(tif, TIFFTAG_IMAGEWIDTH, &(img->nx)) == 0) {
+    std::string msg = "TIFFGetField of TIFFTAG_IMAGEWIDTH failed: " + filepath;
+    throw Sipi::SipiImageError(msg);
+  }
 
-    TIFF_GET_FIELD(tif, TIFFTAG_SAMPLESPERPIXEL, &stmp, 1);
-    img->nc = static_cast<size_t>(stmp);
+  if (TIFFGetField(tif, TIFFTAG_IMAGELENGTH, &(img->ny)) == 0) {
+    std::string msg = "TIFFGetField of TIFFTAG_IMAGELENGTH failed: " + filepath;
+    throw Sipi::SipiImageError(msg);
+  }
 
-    TIFF_GET_FIELD(tif, TIFFTAG_BITSPERSAMPLE, &stmp, 1);
-    img->bps = static_cast<size_t>(stmp);
+  TIFF_GET_FIELD(tif, TIFFTAG_SAMPLESPERPIXEL, &stmp, 1);
+  img->nc = static_cast<size_t>(stmp);
 
-    TIFF_GET_FIELD(tif, TIFFTAG_ORIENTATION, &ori, ORIENTATION_TOPLEFT);
-    img->orientation = static_cast<Orientation>(ori);
+  TIFF_GET_FIELD(tif, TIFFTAG_BITSPERSAMPLE, &stmp, 1);
+  img->bps = static_cast<size_t>(stmp);
 
-    if (1 != TIFFGetField(tif, TIFFTAG_PHOTOMETRIC, &stmp)) {
-      img->photo = PhotometricInterpretation::MINISBLACK;
-    } else {
-      img->photo = static_cast<PhotometricInterpretation>(stmp);
-    }
+  TIFF_GET_FIELD(tif, TIFFTAG_ORIENTATION, &ori, ORIENTATION_TOPLEFT);
+  img->orientation = static_cast<Orientation>(ori);
 
-    //
-    // if we have a palette TIFF with a colormap, it gets complicated. We will have to
-    // read the colormap and later convert the image to RGB, since we do internally
-    // not support palette images.
-    //
+  if (1 != TIFFGetField(tif, TIFFTAG_PHOTOMETRIC, &stmp)) {
+    img->photo = PhotometricInterpretation::MINISBLACK;
+  } else {
+    img->photo = static_cast<PhotometricInterpretation>(stmp);
+  }
 
+  //
+  // if we have a palette TIFF with a colormap, it gets complicated. We will have to
+  // read the colormap and later convert the image to RGB, since we do internally
+  // not support palette images.
+  //
 
-    std::vector<uint16_t> rcm;
-    std::vector<uint16_t> gcm;
-    std::vector<uint16_t> bcm;
 
-    int colmap_len = 0;
-    if (img->photo == PhotometricInterpretation::PALETTE) {
-      uint16_t *_rcm = nullptr, *_gcm = nullptr, *_bcm = nullptr;
-      if (TIFFGetField(tif, TIFFTAG_COLORMAP, &_rcm, &_gcm, &_bcm) == 0) {
-        std::string msg = "TIFFGetField of TIFFTAG_COLORMAP failed: " + filepath;
-        throw Sipi::SipiImageError(msg);
-      }
-      colmap_len = 1;
-      size_t itmp = 0;
-      while (itmp < img->bps) {
-        colmap_len *= 2;
-        itmp++;
-      }
-      rcm.reserve(colmap_len);
-      gcm.reserve(colmap_len);
-      bcm.reserve(colmap_len);
-      for (int ii = 0; ii < colmap_len; ii++) {
-        rcm[ii] = _rcm[ii];
-        gcm[ii] = _gcm[ii];
-        bcm[ii] = _bcm[ii];
-      }
-    }
+  std::vector<uint16_t> &rcm = header.rcm;
+  std::vector<uint16_t> &gcm = header.gcm;
+  std::vector<uint16_t> &bcm = header.bcm;
 
-    TIFF_GET_FIELD(tif, TIFFTAG_PLANARCONFIG, &planar, PLANARCONFIG_CONTIG);
-    TIFF_GET_FIELD(tif, TIFFTAG_SAMPLEFORMAT, &safo, SAMPLEFORMAT_UINT);
+  int &colmap_len = header.colmap_len;
+  if (img->photo == PhotometricInterpretation::PALETTE) {
+    uint16_t *_rcm = nullptr, *_gcm = nullptr, *_bcm = nullptr;
+    if (TIFFGetField(tif, TIFFTAG_COLORMAP, &_rcm, &_gcm, &_bcm) == 0) {
+      std::string msg = "TIFFGetField of TIFFTAG_COLORMAP failed: " + filepath;
+      throw Sipi::SipiImageError(msg);
+    }
+    colmap_len = 1;
+    size_t itmp = 0;
+    while (itmp < img->bps) {
+      colmap_len *= 2;
+      itmp++;
+    }
+    rcm.resize(colmap_len);
+    gcm.resize(colmap_len);
+    bcm.resize(colmap_len);
+    for (int ii = 0; ii < colmap_len; ii++) {
+      rcm[ii] = _rcm[ii];
+      gcm[ii] = _gcm[ii];
+      bcm[ii] = _bcm[ii];
+    }
+  }
 
-    uint16_t *es;
-    int eslen = 0;
-    if (TIFFGetField(tif, TIFFTAG_EXTRASAMPLES, &eslen, &es) == 1) {
-      for (int i = 0; i < eslen; i++) {
-        ExtraSamples extra;
-        switch (es[i]) {
-        case 0:
-          extra = ExtraSamples::UNSPECIFIED;
-          break;
-        case 1:
-          extra = ExtraSamples::ASSOCALPHA;
-          break;
-        case 2:
-          extra = ExtraSamples::UNASSALPHA;
-          break;
-        default:
-          extra = ExtraSamples::UNSPECIFIED;
-        }
-        img->es.push_back(extra);
+  TIFF_GET_FIELD(tif, TIFFTAG_PLANARCONFIG, &planar, PLANARCONFIG_CONTIG);
+  TIFF_GET_FIELD(tif, TIFFTAG_SAMPLEFORMAT, &safo, SAMPLEFORMAT_UINT);
+
+  uint16_t *es;
+  int eslen = 0;
+  if (TIFFGetField(tif, TIFFTAG_EXTRASAMPLES, &eslen, &es) == 1) {
+    for (int i = 0; i < eslen; i++) {
+      ExtraSamples extra;
+      switch (es[i]) {
+      case 0:
+        extra = ExtraSamples::UNSPECIFIED;
+        break;
+      case 1:
+        extra = ExtraSamples::ASSOCALPHA;
+        break;
+      case 2:
+        extra = ExtraSamples::UNASSALPHA;
+        break;
+      default:
+        extra = ExtraSamples::UNSPECIFIED;
       }
+      img->es.push_back(extra);
     }
+  }
 
-    //
-    // reading TIFF Meatdata and adding the fields to the exif header.
-    // We store the TIFF metadata in the private exifData member variable using addKeyVal.
-    //
+  //
+  // reading TIFF Meatdata and adding the fields to the exif header.
+  // We store the TIFF metadata in the private exifData member variable using addKeyVal.
+  //
 
-    char *str;
+  char *str;
 
-    if (1 == TIFFGetField(tif, TIFFTAG_IMAGEDESCRIPTION, &str)) {
-      img->ensure_exif();
-      img->exif->addKeyVal(std::string("Exif.Image.ImageDescription"), std::string(str));
-    }
-    if (1 == TIFFGetField(tif, TIFFTAG_MAKE, &str)) {
-      img->ensure_exif();
-      img->exif->addKeyVal(std::string("Exif.Image.Make"), std::string(str));
-    }
-    if (1 == TIFFGetField(tif, TIFFTAG_MODEL, &str)) {
-      img->ensure_exif();
-      img->exif->addKeyVal(std::string("Exif.Image.Model"), std::string(str));
-    }
-    if (1 == TIFFGetField(tif, TIFFTAG_SOFTWARE, &str)) {
-      img->ensure_exif();
-      img->exif->addKeyVal(std::string("Exif.Image.Software"), std::string(str));
-    }
-    if (1 == TIFFGetField(tif, TIFFTAG_DATETIME, &str)) {
-      img->ensure_exif();
-      img->exif->addKeyVal(std::string("Exif.Image.DateTime"), std::string(str));
-    }
-    if (1 == TIFFGetField(tif, TIFFTAG_ARTIST, &str)) {
-      img->ensure_exif();
-      img->exif->addKeyVal(std::string("Exif.Image.Artist"), std::string(str));
-    }
-    if (1 == TIFFGetField(tif, TIFFTAG_HOSTCOMPUTER, &str)) {
-      img->ensure_exif();
-      img->exif->addKeyVal(std::string("Exif.Image.HostComputer"), std::string(str));
-    }
-    if (1 == TIFFGetField(tif, TIFFTAG_COPYRIGHT, &str)) {
-      img->ensure_exif();
-      img->exif->addKeyVal(std::string("Exif.Image.Copyright"), std::string(str));
-    }
-    if (1 == TIFFGetField(tif, TIFFTAG_DOCUMENTNAME, &str)) {
-      img->ensure_exif();
-      img->exif->addKeyVal(std::string("Exif.Image.DocumentName"), std::string(str));
-    }
-    // ???????? What shall we do with this meta data which is not standard in exif??????
-    // We could add it as Xmp?
-    //
-    /*
-                if (1 == TIFFGetField(tif, TIFFTAG_PAGENAME, &str)) {
-                    if (img->exif == NULL) img->exif = std::make_shared<Exif>();
-                    img->exif->addKeyVal(string("Exif.Image.PageName"), string(str));
-                }
-                if (1 == TIFFGetField(tif, TIFFTAG_PAGENUMBER, &str)) {
-                    if (img->exif == NULL) img->exif = std::make_shared<Exif>();
-                    img->exif->addKeyVal(string("Exif.Image.PageNumber"), string(str));
-                }
-    */
-    float f;
-    if (1 == TIFFGetField(tif, TIFFTAG_XRESOLUTION, &f)) {
-      img->ensure_exif();
-      img->exif->addKeyVal(std::string("Exif.Image.XResolution"), Exif::toRational(f));
-    }
-    if (1 == TIFFGetField(tif, TIFFTAG_YRESOLUTION, &f)) {
-      img->ensure_exif();
-      img->exif->addKeyVal(std::string("Exif.Image.YResolution"), Exif::toRational(f));
-    }
+  if (1 == TIFFGetField(tif, TIFFTAG_IMAGEDESCRIPTION, &str)) {
+    img->ensure_exif();
+    img->exif->addKeyVal(std::string("Exif.Image.ImageDescription"), std::string(str));
+  }
+  if (1 == TIFFGetField(tif, TIFFTAG_MAKE, &str)) {
+    img->ensure_exif();
+    img->exif->addKeyVal(std::string("Exif.Image.Make"), std::string(str));
+  }
+  if (1 == TIFFGetField(tif, TIFFTAG_MODEL, &str)) {
+    img->ensure_exif();
+    img->exif->addKeyVal(std::string("Exif.Image.Model"), std::string(str));
+  }
+  if (1 == TIFFGetField(tif, TIFFTAG_SOFTWARE, &str)) {
+    img->ensure_exif();
+    img->exif->addKeyVal(std::string("Exif.Image.Software"), std::string(str));
+  }
+  if (1 == TIFFGetField(tif, TIFFTAG_DATETIME, &str)) {
+    img->ensure_exif();
+    img->exif->addKeyVal(std::string("Exif.Image.DateTime"), std::string(str));
+  }
+  if (1 == TIFFGetField(tif, TIFFTAG_ARTIST, &str)) {
+    img->ensure_exif();
+    img->exif->addKeyVal(std::string("Exif.Image.Artist"), std::string(str));
+  }
+  if (1 == TIFFGetField(tif, TIFFTAG_HOSTCOMPUTER, &str)) {
+    img->ensure_exif();
+    img->exif->addKeyVal(std::string("Exif.Image.HostComputer"), std::string(str));
+  }
+  if (1 == TIFFGetField(tif, TIFFTAG_COPYRIGHT, &str)) {
+    img->ensure_exif();
+    img->exif->addKeyVal(std::string("Exif.Image.Copyright"), std::string(str));
+  }
+  if (1 == TIFFGetField(tif, TIFFTAG_DOCUMENTNAME, &str)) {
+    img->ensure_exif();
+    img->exif->addKeyVal(std::string("Exif.Image.DocumentName"), std::string(str));
+  }
+  // ???????? What shall we do with this meta data which is not standard in exif??????
+  // We could add it as Xmp?
+  //
+  /*
+              if (1 == TIFFGetField(tif, TIFFTAG_PAGENAME, &str)) {
+                  if (img->exif == NULL) img->exif = std::make_shared<Exif>();
+                  img->exif->addKeyVal(string("Exif.Image.PageName"), string(str));
+              }
+              if (1 == TIFFGetField(tif, TIFFTAG_PAGENUMBER, &str)) {
+                  if (img->exif == NULL) img->exif = std::make_shared<Exif>();
+                  img->exif->addKeyVal(string("Exif.Image.PageNumber"), string(str));
+              }
+  */
+  float f;
+  if (1 == TIFFGetField(tif, TIFFTAG_XRESOLUTION, &f)) {
+    img->ensure_exif();
+    img->exif->addKeyVal(std::string("Exif.Image.XResolution"), Exif::toRational(f));
+  }
+  if (1 == TIFFGetField(tif, TIFFTAG_YRESOLUTION, &f)) {
+    img->ensure_exif();
+    img->exif->addKeyVal(std::string("Exif.Image.YResolution"), Exif::toRational(f));
+  }
 
-    short s;
-    if (1 == TIFFGetField(tif, TIFFTAG_RESOLUTIONUNIT, &s)) {
-      img->ensure_exif();
-      img->exif->addKeyVal(std::string("Exif.Image.ResolutionUnit"), s);
-    }
+  short s;
+  if (1 == TIFFGetField(tif, TIFFTAG_RESOLUTIONUNIT, &s)) {
+    img->ensure_exif();
+    img->exif->addKeyVal(std::string("Exif.Image.ResolutionUnit"), s);
+  }
 
-    //
-    // read iptc header
-    //
-    unsigned int iptc_length = 0;
-    unsigned char *iptc_content = nullptr;
-
-    if (TIFFGetField(tif, TIFFTAG_RICHTIFFIPTC, &iptc_length, &iptc_content) != 0) {
-      try {
-        img->iptc = std::make_shared<Iptc>(iptc_content, iptc_length);
-      } catch (SipiError &err) {
-        log_err("%s", err.to_string().c_str());
-      }
-    }
+  //
+  // read iptc header
+  //
+  unsigned int iptc_length = 0;
+  unsigned char *iptc_content = nullptr;
 
-    //
-    // read exif here....
-    //
-    toff_t exif_ifd_offs;
-    if (1 == TIFFGetField(tif, TIFFTAG_EXIFIFD, &exif_ifd_offs)) {
-      img->ensure_exif();
-      readExif(img, tif, exif_ifd_offs);
+  if (TIFFGetField(tif, TIFFTAG_RICHTIFFIPTC, &iptc_length, &iptc_content) != 0) {
+    try {
+      img->iptc = std::make_shared<Iptc>(iptc_content, iptc_length);
+    } catch (SipiError &err) {
+      log_err("%s", err.to_string().c_str());
     }
+  }
 
-    //
-    // read xmp header
-    //
-    int xmp_length;
-    char *xmp_content = nullptr;
-
-    if (1 == TIFFGetField(tif, TIFFTAG_XMLPACKET, &xmp_length, &xmp_content)) {
-      try {
-        img->xmp = std::make_shared<Xmp>(xmp_content, xmp_length);
-      } catch (SipiError &err) {
-        log_err("%s", err.to_string().c_str());
-      }
+  //
+  // read exif here....
+  //
+  toff_t exif_ifd_offs;
+  if (1 == TIFFGetField(tif, TIFFTAG_EXIFIFD, &exif_ifd_offs)) {
+    img->ensure_exif();
+    readExif(img, tif, exif_ifd_offs);
+  }
+
+  //
+  // read xmp header
+  //
+  int xmp_length;
+  char *xmp_content = nullptr;
+
+  if (1 == TIFFGetField(tif, TIFFTAG_XMLPACKET, &xmp_length, &xmp_content)) {
+    try {
+      img->xmp = std::make_shared<Xmp>(xmp_content, xmp_length);
+    } catch (SipiError &err) {
+      log_err("%s", err.to_string().c_str());
     }
+  }
+
+  //
+  // Read ICC-profile
+  //
+  unsigned int icc_len;
+  unsigned char *icc_buf;
+  float *whitepoint_ti = nullptr;
+  float whitepoint[2];
 
+  if (1 == TIFFGetField(tif, TIFFTAG_ICCPROFILE, &icc_len, &icc_buf)) {
+    try {
+      img->icc = std::make_shared<Icc>(icc_buf, icc_len);
+    } catch (SipiError &err) {
+      log_err("%s", err.to_string().c_str());
+    }
+  } else if (1 == TIFFGetField(tif, TIFFTAG_WHITEPOINT, &whitepoint_ti)) {
+    whitepoint[0] = whitepoint_ti[0];
+    whitepoint[1] = whitepoint_ti[1];
     //
-    // Read ICC-profile
+    // Wow, we have TIFF colormetry..... Who is still using this???
     //
-    unsigned int icc_len;
-    unsigned char *icc_buf;
-    float *whitepoint_ti = nullptr;
-    float whitepoint[2];
-
-    if (1 == TIFFGetField(tif, TIFFTAG_ICCPROFILE, &icc_len, &icc_buf)) {
-      try {
-        img->icc = std::make_shared<Icc>(icc_buf, icc_len);
-      } catch (SipiError &err) {
-        log_err("%s", err.to_string().c_str());
-      }
-    } else if (1 == TIFFGetField(tif, TIFFTAG_WHITEPOINT, &whitepoint_ti)) {
-      whitepoint[0] = whitepoint_ti[0];
-      whitepoint[1] = whitepoint_ti[1];
+    float *primaries_ti = nullptr;
+    float primaries[6];
+
+    if (1 == TIFFGetField(tif, TIFFTAG_PRIMARYCHROMATICITIES, &primaries_ti)) {
+      primaries[0] = primaries_ti[0];
+      primaries[1] = primaries_ti[1];
+      primaries[2] = primaries_ti[2];
+      primaries[3] = primaries_ti[3];
+      primaries[4] = primaries_ti[4];
+      primaries[5] = primaries_ti[5];
+    } else {
       //
-      // Wow, we have TIFF colormetry..... Who is still using this???
+      // not defined, let's take the sRGB primaries
       //
-      float *primaries_ti = nullptr;
-      float primaries[6];
-
-      if (1 == TIFFGetField(tif, TIFFTAG_PRIMARYCHROMATICITIES, &primaries_ti)) {
-        primaries[0] = primaries_ti[0];
-        primaries[1] = primaries_ti[1];
-        primaries[2] = primaries_ti[2];
-        primaries[3] = primaries_ti[3];
-        primaries[4] = primaries_ti[4];
-        primaries[5] = primaries_ti[5];
-      } else {
-        //
-        // not defined, let's take the sRGB primaries
-        //
-        primaries[0] = 0.6400;
-        primaries[1] = 0.3300;
-        primaries[2] = 0.3000;
-        primaries[3] = 0.6000;
-        primaries[4] = 0.1500;
-        primaries[5] = 0.0600;
+      primaries[0] = 0.6400;
+      primaries[1] = 0.3300;
+      primaries[2] = 0.3000;
+      primaries[3] = 0.6000;
+      primaries[4] = 0.1500;
+      primaries[5] = 0.0600;
+    }
+
+    // Transfer functions are only meaningful for 8-bit and 16-bit images.
+    // For 1-bit / 4-bit images the buffer `3 * (1 << img->bps)` is only
+    // 6 / 48 shorts respectively; a malformed TRANSFERFUNCTION tag with
+    // a larger payload would overflow the heap allocation below. We
+    // deliberately allowlist 8 and 16 (rather than using `bps >= 8`) so
+    // the intent is documented in the code.
+    if (img->bps == 8 || img->bps == 16) {
+      // RAII-wrap the transfer-function buffer so that an exception from
+      // the Icc constructor cannot leak it. `tfunc_ti` is owned by
+      // libtiff and must not be freed; only our copy (`tfunc`) is owned here.
+      auto tfunc = std::make_unique<unsigned short[]>(3 * (1 << img->bps));
+      unsigned short *tfunc_ti;
+      unsigned int tfunc_len = 0;
+      unsigned int tfunc_len_ti;
+      bool has_tfunc = false;
+
+      if (1 == TIFFGetField(tif, TIFFTAG_TRANSFERFUNCTION, &tfunc_len_ti, &tfunc_ti)) {
+        has_tfunc = true;
+        if ((tfunc_len_ti / (1 << img->bps)) == 1) {
+          memcpy(tfunc.get(), tfunc_ti, tfunc_len_ti);
+          memcpy(tfunc.get() + tfunc_len_ti, tfunc_ti, tfunc_len_ti);
+          memcpy(tfunc.get() + 2 * tfunc_len_ti, tfunc_ti, tfunc_len_ti);
+          tfunc_len = tfunc_len_ti;
+        } else {
+          memcpy(tfunc.get(), tfunc_ti, tfunc_len_ti);
+          tfunc_len = tfunc_len_ti / 3;
+        }
       }
 
-      // Transfer functions are only meaningful for 8-bit and 16-bit images.
-      // For 1-bit / 4-bit images the buffer `3 * (1 << img->bps)` is only
-      // 6 / 48 shorts respectively; a malformed TRANSFERFUNCTION tag with
-      // a larger payload would overflow the heap allocation below. We
-      // deliberately allowlist 8 and 16 (rather than using `bps >= 8`) so
-      // the intent is documented in the code.
-      if (img->bps == 8 || img->bps == 16) {
-        // RAII-wrap the transfer-function buffer so that an exception from
-        // the Icc constructor cannot leak it. `tfunc_ti` is owned by
-        // libtiff and must not be freed; only our copy (`tfunc`) is owned here.
-        auto tfunc = std::make_unique<unsigned short[]>(3 * (1 << img->bps));
-        unsigned short *tfunc_ti;
-        unsigned int tfunc_len = 0;
-        unsigned int tfunc_len_ti;
-        bool has_tfunc = false;
-
-        if (1 == TIFFGetField(tif, TIFFTAG_TRANSFERFUNCTION, &tfunc_len_ti, &tfunc_ti)) {
-          has_tfunc = true;
-          if ((tfunc_len_ti / (1 << img->bps)) == 1) {
-            memcpy(tfunc.get(), tfunc_ti, tfunc_len_ti);
-            memcpy(tfunc.get() + tfunc_len_ti, tfunc_ti, tfunc_len_ti);
-            memcpy(tfunc.get() + 2 * tfunc_len_ti, tfunc_ti, tfunc_len_ti);
-            tfunc_len = tfunc_len_ti;
-          } else {
-            memcpy(tfunc.get(), tfunc_ti, tfunc_len_ti);
-            tfunc_len = tfunc_len_ti / 3;
-          }
-        }
+      img->icc = std::make_shared<Icc>(
+        whitepoint, primaries, has_tfunc ? tfunc.get() : nullptr, has_tfunc ? tfunc_len : 0);
+    } else {
+      // bilevel / 4-bit / non-standard — no transfer function
+      img->icc = std::make_shared<Icc>(whitepoint, primaries, nullptr, 0);
+    }
+  }
 
-        img->icc = std::make_shared<Icc>(
-          whitepoint, primaries, has_tfunc ? tfunc.get() : nullptr, has_tfunc ? tfunc_len : 0);
+  //
+  // Read SipiEssential metadata. Prefer the new TIFFTAG_SIPIMETA_PB
+  // (protobuf); fall back to the legacy TIFFTAG_SIPIMETA (pipe-delimited
+  // ASCII) when the new tag is absent or fails to parse. No in-tree writer
+  // ever emits both — the simultaneous presence of both tags would imply
+  // external tooling, and the prefer-new behaviour is the correct
+  // resolution either way.
+  //
+  {
+    uint32_t pb_count = 0;
+    const void *pb_data = nullptr;
+    char *emdatastr = nullptr;
+    const bool has_pb = 1 == TIFFGetField(tif, TIFFTAG_SIPIMETA_PB, &pb_count, &pb_data) && pb_count > 0 && pb_data;
+    const bool has_legacy = 1 == TIFFGetField(tif, TIFFTAG_SIPIMETA, &emdatastr) && emdatastr && strlen(emdatastr) > 0;
+
+    if (has_pb) {
+      std::span<const std::byte> bytes(static_cast<const std::byte *>(pb_data), pb_count);
+      auto parsed = Essentials::parse(bytes);
+      if (parsed) {
+        img->essential_metadata(*parsed);
       } else {
-        // bilevel / 4-bit / non-standard — no transfer function
-        img->icc = std::make_shared<Icc>(whitepoint, primaries, nullptr, 0);
+        log_warn("Essentials: protobuf parse failed for %s (variant=%d); falling back to legacy carrier",
+          filepath.c_str(),
+          static_cast<int>(parsed.error()));
+        if (has_legacy) { img->essential_metadata(Essentials::parse_legacy(emdatastr)); }
       }
+    } else if (has_legacy) {
+      img->essential_metadata(Essentials::parse_legacy(emdatastr));
     }
+  }
 
-    //
-    // Read SipiEssential metadata. Prefer the new TIFFTAG_SIPIMETA_PB
-    // (protobuf); fall back to the legacy TIFFTAG_SIPIMETA (pipe-delimited
-    // ASCII) when the new tag is absent or fails to parse. No in-tree writer
-    // ever emits both — the simultaneous presence of both tags would imply
-    // external tooling, and the prefer-new behaviour is the correct
-    // resolution either way.
-    //
-    {
-      uint32_t pb_count = 0;
-      const void *pb_data = nullptr;
-      char *emdatastr = nullptr;
-      const bool has_pb = 1 == TIFFGetField(tif, TIFFTAG_SIPIMETA_PB, &pb_count, &pb_data) && pb_count > 0 && pb_data;
-      const bool has_legacy = 1 == TIFFGetField(tif, TIFFTAG_SIPIMETA, &emdatastr) && emdatastr && strlen(emdatastr) > 0;
+  header.resolutions = read_resolutions(img->getNx(), tif);
+}
 
-      if (has_pb) {
-        std::span<const std::byte> bytes(static_cast<const std::byte *>(pb_data), pb_count);
-        auto parsed = Essentials::parse(bytes);
-        if (parsed) {
-          img->essential_metadata(*parsed);
-        } else {
-          log_warn("Essentials: protobuf parse failed for %s (variant=%d); falling back to legacy carrier",
-            filepath.c_str(),
-            static_cast<int>(parsed.error()));
-          if (has_legacy) { img->essential_metadata(Essentials::parse_legacy(emdatastr)); }
-        }
-      } else if (has_legacy) {
-        img->essential_metadata(Essentials::parse_legacy(emdatastr));
-      }
-    }
+void SipiIOTiff::read_pixels(SipiImage *img,
+  TIFF *tif,
+  const std::string &filepath,
+  const TiffHeader &header,
+  std::shared_ptr<SipiRegion> region,
+  std::shared_ptr<SipiSize> size,
+  bool force_bps_8,
+  ScalingQuality scaling_quality)
+{
+  const std::vector<SubImageInfo> &resolutions = header.resolutions;
+  const std::vector<uint16_t> &rcm = header.rcm;
+  const std::vector<uint16_t> &gcm = header.gcm;
+  const std::vector<uint16_t> &bcm = header.bcm;
+  const int colmap_len = header.colmap_len;
+  int reduce = -1;
+
+  size_t w = img->nx, h = img->ny;
+  size_t out_w, out_h;
+  bool redonly;
+  bool is_tiled;
+  uint32_t level = 0;
 
-    auto resolutions = read_resolutions(img->getNx(), tif);
-    int reduce = -1;
+  if (size) {
+    // get_size hands back `reduce` as a log2 exponent (0, 1, 2, 3 …). Pick the
+    // pyramid IFD whose reduction ratio is the largest available not exceeding
+    // 2^reduce, then decode from that directory. Any residual between the level
+    // ratio and the requested size is handled by the downstream size stage.
+    size->get_size(w, h, out_w, out_h, reduce, redonly);
 
-    size_t w = img->nx, h = img->ny;
-    size_t out_w, out_h;
-    bool redonly;
-    bool is_tiled;
-    uint32_t level = 0;
-
-    if (size) {
-      // get_size hands back `reduce` as a log2 exponent (0, 1, 2, 3 …). Pick the
-      // pyramid IFD whose reduction ratio is the largest available not exceeding
-      // 2^reduce, then decode from that directory. Any residual between the level
-      // ratio and the requested size is handled by the downstream size stage.
-      size->get_size(w, h, out_w, out_h, reduce, redonly);
-
-      level = select_pyramid_level(resolutions, reduce);
-      TIFFSetDirectory(tif, level);
-
-      img->nx = resolutions[level].width;
-      img->ny = resolutions[level].height;
-
-      // crop_coords maps a full-resolution region into this level's coordinate
-      // space by dividing by the level's ratio (1, 2, 4, 8 …), NOT by the log2
-      // exponent. Passing the exponent here is the historical "region + pct:50"
-      // bug; the ratio is always ≥ 1 so there is no division by zero.
-      if (region != nullptr) { region->set_reduce(static_cast<float>(resolutions[level].reduce)); }
-    }
-    is_tiled = (resolutions[level].tile_width != 0) && (resolutions[level].tile_height != 0);
-
-    if (level > 0) { observability::Metrics::instance().tiff_pyramid_reduced_decodes_total.Increment(); }
-
-    int32_t roi_x;
-    int32_t roi_y;
-    size_t roi_w;
-    size_t roi_h;
-    if (region == nullptr) {
-      roi_x = 0;
-      roi_y = 0;
-      roi_w = img->nx;
-      roi_h = img->ny;
-    } else {
-      region->crop_coords(img->nx, img->ny, roi_x, roi_y, roi_w, roi_h);
-    }
+    level = select_pyramid_level(resolutions, reduce);
 
-    int ps;// pixel size in bytes
-    switch (img->bps) {
-    case 1:// 1-bit is converted to 8-bit on-the-fly by read_standard_data (one2eight<T>())
-    case 8:
-      ps = 1;
-      break;
-    case 16:
-      ps = 2;
-      break;
-    default:
-      throw Sipi::SipiImageError(
-        "Unsupported bits/sample (" + std::to_string(img->bps) + ") in file " + filepath);
-    }
+    img->nx = resolutions[level].width;
+    img->ny = resolutions[level].height;
 
-    std::vector<uint8_t> inbuf(ps * roi_w * roi_h * img->nc);
+    // crop_coords maps a full-resolution region into this level's coordinate
+    // space by dividing by the level's ratio (1, 2, 4, 8 …), NOT by the log2
+    // exponent. Passing the exponent here is the historical "region + pct:50"
+    // bug; the ratio is always ≥ 1 so there is no division by zero.
+    if (region != nullptr) { region->set_reduce(static_cast<float>(resolutions[level].reduce)); }
+  }
+  // A multi-tile read leaves the handle on the previous tile's level.
+  if (TIFFCurrentDirectory(tif) != level) {
+    if (TIFFSetDirectory(tif, static_cast<tdir_t>(level)) == 0) {
+      throw Sipi::SipiImageError("Cannot select directory " + std::to_string(level) + " of " + filepath);
+    }
+    // read_header set IFD 0 up to decode JPEG tiles as RGB; re-entering it
+    // resets that.
+    if (level == 0) { TIFFSetField(tif, TIFFTAG_JPEGCOLORMODE, JPEGCOLORMODE_RGB); }
+  }
+  is_tiled = (resolutions[level].tile_width != 0) && (resolutions[level].tile_height != 0);
 
-    if (img->bps <= 8) {
-      std::vector<uint8_t> pixdata;
-      if (is_tiled)
-        pixdata = read_tiled_data<uint8_t>(tif, roi_x, roi_y, roi_w, roi_h);
-      else
-        pixdata = read_standard_data<uint8_t>(tif, roi_x, roi_y, roi_w, roi_h);
+  if (level > 0) {
+    observability::Metrics::instance().tiff_pyramid_reduced_decodes_total.Increment();
+    report_decoded(0, DecodePath::Pyramid);
+  }
 
-      img->bps = 8;
+  int32_t roi_x;
+  int32_t roi_y;
+  size_t roi_w;
+  size_t roi_h;
+  if (region == nullptr) {
+    roi_x = 0;
+    roi_y = 0;
+    roi_w = img->nx;
+    roi_h = img->ny;
+  } else {
+    region->crop_coords(img->nx, img->ny, roi_x, roi_y, roi_w, roi_h);
+  }
 
-      memcpy(inbuf.data(), pixdata.data(), pixdata.size() * img->bps / 8);
-    } else if (img->bps <= 16) {
-      std::vector<uint16_t> pixdata;
-      if (is_tiled)
-        pixdata = read_tiled_data<uint16_t>(tif, roi_x, roi_y, roi_w, roi_h);
-      else
-        pixdata = read_standard_data<uint16_t>(tif, roi_x, roi_y, roi_w, roi_h);
-      img->bps = 16;
-      memcpy(inbuf.data(), pixdata.data(), pixdata.size() * img->bps / 8);
-    }
+  int ps;// pixel size in bytes
+  switch (img->bps) {
+  case 1:// 1-bit is converted to 8-bit on-the-fly by read_standard_data (one2eight<T>())
+  case 8:
+    ps = 1;
+    break;
+  case 16:
+    ps = 2;
+    break;
+  default:
+    throw Sipi::SipiImageError(
+      "Unsupported bits/sample (" + std::to_string(img->bps) + ") in file " + filepath);
+  }
 
-    img->pixels = std::move(inbuf);
-    img->nx = roi_w;
-    img->ny = roi_h;
-    tif_guard.reset();
+  // A residual scale left between the chosen level and the requested size is
+  // taken in the DCT domain where the level's tiles are JPEG: decoding at
+  // 1/2, 1/4 or 1/8 skips up to 63/64 of the IDCT work. The size stage below
+  // scales what remains, as for any other decode.
+  uint32_t jpeg_denom = 1;
+  if (size && is_tiled && img->bps == 8 && tiff_jpeg_tiles_scalable(tif)) {
+    jpeg_denom = tiff_jpeg_scale_denom(resolutions[level],
+      reduce,
+      static_cast<uint32_t>(roi_x),
+      static_cast<uint32_t>(roi_y),
+      static_cast<uint32_t>(roi_w),
+      static_cast<uint32_t>(roi_h));
+  }
 
-    if (img->photo == PhotometricInterpretation::PALETTE) {
-      //
-      // ok, we have a palette color image we have to convert to RGB...
-      //
-      uint16_t cm_max = 0;
-      for (int i = 0; i < colmap_len; i++) {
-        if (rcm[i] > cm_max) cm_max = rcm[i];
-        if (gcm[i] > cm_max) cm_max = gcm[i];
-        if (bcm[i] > cm_max) cm_max = bcm[i];
-      }
-      std::vector<uint8_t> dataptr(3 * img->nx * img->ny);
-      if (cm_max <= 256) {// we have a colomap with entries form 0 - 255
-        for (size_t i = 0; i < img->nx * img->ny; i++) {
-          dataptr[3 * i] = (uint8_t)rcm[img->pixels[i]];
-          dataptr[3 * i + 1] = (uint8_t)gcm[img->pixels[i]];
-          dataptr[3 * i + 2] = (uint8_t)bcm[img->pixels[i]];
-        }
-      } else {// we have a colormap with entries > 255, assuming 16 bit
-        for (size_t i = 0; i < img->nx * img->ny; i++) {
-          dataptr[3 * i] = (uint8_t)(rcm[img->pixels[i]] >> 8);
-          dataptr[3 * i + 1] = (uint8_t)(gcm[img->pixels[i]] >> 8);
-          dataptr[3 * i + 2] = (uint8_t)(bcm[img->pixels[i]] >> 8);
-        }
+  std::vector<uint8_t> inbuf(jpeg_denom > 1 ? 0 : ps * roi_w * roi_h * img->nc);
+
+  if (jpeg_denom > 1) {
+    inbuf = read_jpeg_tiles_scaled(tif,
+      static_cast<uint32_t>(roi_x),
+      static_cast<uint32_t>(roi_y),
+      static_cast<uint32_t>(roi_w),
+      static_cast<uint32_t>(roi_h),
+      jpeg_denom);
+    roi_w = (roi_w + jpeg_denom - 1) / jpeg_denom;
+    roi_h = (roi_h + jpeg_denom - 1) / jpeg_denom;
+  } else if (img->bps <= 8) {
+    std::vector<uint8_t> pixdata;
+    if (is_tiled)
+      pixdata = read_tiled_data<uint8_t>(tif, roi_x, roi_y, roi_w, roi_h);
+    else
+      pixdata = read_standard_data<uint8_t>(tif, roi_x, roi_y, roi_w, roi_h);
+
+    img->bps = 8;
+
+    memcpy(inbuf.data(), pixdata.data(), pixdata.size() * img->bps / 8);
+  } else if (img->bps <= 16) {
+    std::vector<uint16_t> pixdata;
+    if (is_tiled)
+      pixdata = read_tiled_data<uint16_t>(tif, roi_x, roi_y, roi_w, roi_h);
+    else
+      pixdata = read_standard_data<uint16_t>(tif, roi_x, roi_y, roi_w, roi_h);
+    img->bps = 16;
+    memcpy(inbuf.data(), pixdata.data(), pixdata.size() * img->bps / 8);
+  }
+
+  img->pixels = std::move(inbuf);
+  img->nx = roi_w;
+  img->ny = roi_h;
+
+  if (img->photo == PhotometricInterpretation::PALETTE) {
+    //
+    // ok, we have a palette color image we have to convert to RGB...
+    //
+    uint16_t cm_max = 0;
+    for (int i = 0; i < colmap_len; i++) {
+      if (rcm[i] > cm_max) cm_max = rcm[i];
+      if (gcm[i] > cm_max) cm_max = gcm[i];
+      if (bcm[i] > cm_max) cm_max = bcm[i];
+    }
+    std::vector<uint8_t> dataptr(3 * img->nx * img->ny);
+    if (cm_max <= 256) {// we have a colomap with entries form 0 - 255
+      for (size_t i = 0; i < img->nx * img->ny; i++) {
+        dataptr[3 * i] = (uint8_t)rcm[img->pixels[i]];
+        dataptr[3 * i + 1] = (uint8_t)gcm[img->pixels[i]];
+        dataptr[3 * i + 2] = (uint8_t)bcm[img->pixels[i]];
       }
-      img->pixels = std::move(dataptr);
-      img->photo = PhotometricInterpretation::RGB;
-      img->nc = 3;
-    }
-
-    if (img->icc == nullptr) {
-      switch (img->photo) {
-      case PhotometricInterpretation::MINISBLACK: {
-        // read_standard_data<uint8_t>() already converts 1-bit to 8-bit via
-        // one2eight<T>(); by the time we reach this block `img->bps == 8`.
-        // The previous `cvrt1BitTo8Bit` call was dead code.
-        img->icc = std::make_shared<Icc>(icc_GRAY_D50);
-        break;
+    } else {// we have a colormap with entries > 255, assuming 16 bit
+      for (size_t i = 0; i < img->nx * img->ny; i++) {
+        dataptr[3 * i] = (uint8_t)(rcm[img->pixels[i]] >> 8);
+        dataptr[3 * i + 1] = (uint8_t)(gcm[img->pixels[i]] >> 8);
+        dataptr[3 * i + 2] = (uint8_t)(bcm[img->pixels[i]] >> 8);
       }
+    }
+    img->pixels = std::move(dataptr);
+    img->photo = PhotometricInterpretation::RGB;
+    img->nc = 3;
+  }
 
-      case PhotometricInterpretation::MINISWHITE: {
-        // Same as MINISBLACK above — 1-bit → 8-bit conversion already happened.
-        img->icc = std::make_shared<Icc>(icc_GRAY_D50);
-        break;
-      }
+  if (img->icc == nullptr) {
+    switch (img->photo) {
+    case PhotometricInterpretation::MINISBLACK: {
+      // read_standard_data<uint8_t>() already converts 1-bit to 8-bit via
+      // one2eight<T>(); by the time we reach this block `img->bps == 8`.
+      // The previous `cvrt1BitTo8Bit` call was dead code.
+      img->icc = std::make_shared<Icc>(icc_GRAY_D50);
+      break;
+    }
 
-      case PhotometricInterpretation::SEPARATED: {
-        img->icc = std::make_shared<Icc>(icc_CMYK_standard);
-        break;
-      }
+    case PhotometricInterpretation::MINISWHITE: {
+      // Same as MINISBLACK above — 1-bit → 8-bit conversion already happened.
+      img->icc = std::make_shared<Icc>(icc_GRAY_D50);
+      break;
+    }
 
-      case PhotometricInterpretation::YCBCR:// fall through!
+    case PhotometricInterpretation::SEPARATED: {
+      img->icc = std::make_shared<Icc>(icc_CMYK_standard);
+      break;
+    }
 
-      case PhotometricInterpretation::RGB: {
-        img->icc = std::make_shared<Icc>(icc_sRGB);
-        break;
-      }
+    case PhotometricInterpretation::YCBCR:// fall through!
 
-      case PhotometricInterpretation::CIELAB: {
-        //
-        // we have to convert to JPEG2000/littleCMS standard
-        //
-        if (img->bps == 8) {
-          for (size_t y = 0; y < img->ny; y++) {
-            for (size_t x = 0; x < img->nx; x++) {
-              union {
-                unsigned char u;
-                signed char s;
-              } v{};
-              v.u = img->pixels[img->nc * (y * img->nx + x) + 1];
-              img->pixels[img->nc * (y * img->nx + x) + 1] = 128 + v.s;
-              v.u = img->pixels[img->nc * (y * img->nx + x) + 2];
-              img->pixels[img->nc * (y * img->nx + x) + 2] = 128 + v.s;
-            }
+    case PhotometricInterpretation::RGB: {
+      img->icc = std::make_shared<Icc>(icc_sRGB);
+      break;
+    }
+
+    case PhotometricInterpretation::CIELAB: {
+      //
+      // we have to convert to JPEG2000/littleCMS standard
+      //
+      if (img->bps == 8) {
+        for (size_t y = 0; y < img->ny; y++) {
+          for (size_t x = 0; x < img->nx; x++) {
+            union {
+              unsigned char u;
+              signed char s;
+            } v{};
+            v.u = img->pixels[img->nc * (y * img->nx + x) + 1];
+            img->pixels[img->nc * (y * img->nx + x) + 1] = 128 + v.s;
+            v.u = img->pixels[img->nc * (y * img->nx + x) + 2];
+            img->pixels[img->nc * (y * img->nx + x) + 2] = 128 + v.s;
           }
-          img->icc = std::make_shared<Icc>(icc_LAB);
-        } else if (img->bps == 16) {
-          auto *data = (unsigned short *)img->pixels.data();
-          for (size_t y = 0; y < img->ny; y++) {
-            for (size_t x = 0; x < img->nx; x++) {
-              union {
-                unsigned short u;
-                signed short s;
-              } v{};
-              v.u = data[img->nc * (y * img->nx + x) + 1];
-              data[img->nc * (y * img->nx + x) + 1] = 32768 + v.s;
-              v.u = data[img->nc * (y * img->nx + x) + 2];
-              data[img->nc * (y * img->nx + x) + 2] = 32768 + v.s;
-            }
+        }
+        img->icc = std::make_shared<Icc>(icc_LAB);
+      } else if (img->bps == 16) {
+        auto *data = (unsigned short *)img->pixels.data();
+        for (size_t y = 0; y < img->ny; y++) {
+          for (size_t x = 0; x < img->nx; x++) {
+            union {
+              unsigned short u;
+              signed short s;
+            } v{};
+            v.u = data[img->nc * (y * img->nx + x) + 1];
+            data[img->nc * (y * img->nx + x) + 1] = 32768 + v.s;
+            v.u = data[img->nc * (y * img->nx + x) + 2];
+            data[img->nc * (y * img->nx + x) + 2] = 32768 + v.s;
           }
-          img->icc = std::make_shared<Icc>(icc_LAB);
-        } else {
-          throw Sipi::SipiImageError("Unsupported bits per sample (" + std::to_string(img->bps) + ")");
         }
-        break;
-      }
-
-      default: {
-        throw Sipi::SipiImageError("Unsupported photometric interpretation (" + to_string(img->photo) + ")");
-      }
+        img->icc = std::make_shared<Icc>(icc_LAB);
+      } else {
+        throw Sipi::SipiImageError("Unsupported bits per sample (" + std::to_string(img->bps) + ")");
       }
+      break;
     }
-    /*
-    if ((img->nc == 3) && (img->photo == PHOTOMETRIC_YCBCR)) {
-        std::shared_ptr<Icc> target_profile = std::make_shared<Icc>(img->icc);
-        switch (img->bps) {
-            case 8: {
-                img->convertToIcc(target_profile, TYPE_YCbCr_8);
-                break;
-            }
-            case 16: {
-                img->convertToIcc(target_profile, TYPE_YCbCr_16);
-                break;
-            }
-            default: {
-                throw Sipi::SipiImageError(thisSourceFile, __LINE__, "Unsupported bits/sample (" + std::to_string(bps) +
-    ")!");
-            }
-        }
+
+    default: {
+      throw Sipi::SipiImageError("Unsupported photometric interpretation (" + to_string(img->photo) + ")");
     }
-    else if ((img->nc == 4) && (img->photo == PHOTOMETRIC_SEPARATED)) { // CMYK image
-        std::shared_ptr<Icc> target_profile = std::make_shared<Icc>(icc_sRGB);
-        switch (img->bps) {
-            case 8: {
-                img->convertToIcc(target_profile, TYPE_CMYK_8);
-                break;
-            }
-            case 16: {
-                img->convertToIcc(target_profile, TYPE_CMYK_16);
-                break;
-            }
-            default: {
-                throw Sipi::SipiImageError(thisSourceFile, __LINE__, "Unsupported bits/sample (" + std::to_string(bps) +
-    ")!");
-            }
-        }
     }
-    */
-    //
-    // resize/Scale the image if necessary
-    //
-    if (size != NULL) {
-      size_t nnx, nny;
-      int reduce = -1;
-      bool redonly;
-      SipiSize::SizeType rtype = size->get_size(w, h, nnx, nny, reduce, redonly);
-      if (rtype != SipiSize::FULL) {
-        switch (scaling_quality.jpeg) {
-        case ScalingMethod::HIGH:
-          img->scale(nnx, nny);
-          break;
-        case ScalingMethod::MEDIUM:
-          img->scaleMedium(nnx, nny);
-          break;
-        case ScalingMethod::LOW:
-          img->scaleFast(nnx, nny);
-        }
+  }
+  /*
+  if ((img->nc == 3) && (img->photo == PHOTOMETRIC_YCBCR)) {
+      std::shared_ptr<Icc> target_profile = std::make_shared<Icc>(img->icc);
+      switch (img->bps) {
+          case 8: {
+              img->convertToIcc(target_profile, TYPE_YCbCr_8);
+              break;
+          }
+          case 16: {
+              img->convertToIcc(target_profile, TYPE_YCbCr_16);
+              break;
+          }
+          default: {
+              throw Sipi::SipiImageError(thisSourceFile, __LINE__, "Unsupported bits/sample (" + std::to_string(bps) +
+  ")!");
+          }
+      }
+  }
+  else if ((img->nc == 4) && (img->photo == PHOTOMETRIC_SEPARATED)) { // CMYK image
+      std::shared_ptr<Icc> target_profile = std::make_shared<Icc>(icc_sRGB);
+      switch (img->bps) {
+          case 8: {
+              img->convertToIcc(target_profile, TYPE_CMYK_8);
+              break;
+          }
+          case 16: {
+              img->convertToIcc(target_profile, TYPE_CMYK_16);
+              break;
+          }
+          default: {
+              throw Sipi::SipiImageError(thisSourceFile, __LINE__, "Unsupported bits/sample (" + std::to_string(bps) +
+  ")!");
+          }
+      }
+  }
+  */
+  //
+  // resize/Scale the image if necessary
+  //
+  if (size != NULL) {
+    size_t nnx, nny;
+    int reduce = -1;
+    bool redonly;
+    SipiSize::SizeType rtype = size->get_size(w, h, nnx, nny, reduce, redonly);
+    if (rtype != SipiSize::FULL) {
+      switch (scaling_quality.jpeg) {
+      case ScalingMethod::HIGH:
+        img->scale(nnx, nny);
+        break;
+      case ScalingMethod::MEDIUM:
+        img->scaleMedium(nnx, nny);
+        break;
+      case ScalingMethod::LOW:
+        img->scaleFast(nnx, nny);
       }
     }
-    if (force_bps_8) { img->to8bps(); }
-    return true;
   }
-  return false;
+  if (force_bps_8) { img->to8bps(); }
 }
 //============================================================================
 
@@ -1636,22 +1947,32 @@ void SipiIOTiff::write_basic_tags(const SipiImage &img,
   TIFFSetField(tif, TIFFTAG_PHOTOMETRIC, img.photo);
 }
 
-void SipiIOTiff::write(SipiImage *img, const OutputSink &sink, const SipiCompressionParams *params)
+// Expected size of an in-memory TIFF: the raw samples, a third more for the
+// reduced levels of a pyramid, and headroom for the IFDs and metadata. Exact
+// for uncompressed output and an upper bound for compressed tiles, so the
+// MEMTIFF is allocated once and never grows in the common case.
+static size_t estimate_tiff_size(const SipiImage &img, bool pyramid)
 {
-  SIPI_ZONE_N("SipiIOTiff::write");
-  // A streamed sink (callback/tee) and stdout both need an in-memory TIFF
-  // (libtiff requires a seekable target); a real FilePath is written directly.
-  // `filepath` is derived only for the file branch and the error messages.
-  const bool streaming = is_streaming_sink(sink);
-  const std::string filepath = streaming ? std::string("<http response>") : std::get<FilePath>(sink).path;
+  constexpr size_t kHeaderRoom = 64 * 1024;
+  size_t bytes = img.getNx() * img.getNy() * img.getNc() * img.getBps() / 8;
+  if (pyramid) { bytes += bytes / 3; }
+  return bytes + kHeaderRoom;
+}
 
-  // Declared before tif_guard: TIFFClose flushes through the memTiff*Proc
-  // callbacks, so the MEMTIFF must outlive the TIFF handle.
-  std::unique_ptr<MEMTIFF, decltype(&memTiffFree)> memtif_guard(nullptr, &memTiffFree);
-  std::unique_ptr<TIFF, decltype(&TIFFClose)> tif_guard(nullptr, &TIFFClose);
-  auto rowsperstrip = (uint32_t)-1;
-  if (streaming || (filepath == "stdout:")) {
-    memtif_guard.reset(memTiffOpen());
+using MemTiffGuard = std::unique_ptr<MEMTIFF, decltype(&memTiffFree)>;
+using TiffGuard = std::unique_ptr<TIFF, decltype(&TIFFClose)>;
+
+// Opens the TIFF write target for `sink`: the file itself, or — for a streamed
+// sink and stdout, which libtiff cannot seek on — an in-memory TIFF of `initsiz`
+// bytes that deliver_memtiff passes on once the TIFF is closed.
+static void open_tiff_target(const OutputSink &sink,
+  const std::string &filepath,
+  size_t initsiz,
+  MemTiffGuard &memtif_guard,
+  TiffGuard &tif_guard)
+{
+  if (is_streaming_sink(sink) || (filepath == "stdout:")) {
+    memtif_guard.reset(memTiffOpen(static_cast<tsize_t>(initsiz)));
     tif_guard.reset(TIFFClientOpen("MEMTIFF",
       "w",
       (thandle_t)memtif_guard.get(),
@@ -1670,6 +1991,53 @@ void SipiIOTiff::write(SipiImage *img, const OutputSink &sink, const SipiCompres
       throw Sipi::SipiImageError(msg);
     }
   }
+}
+
+// Passes a closed in-memory TIFF on to stdout or the streamed sink.
+static void deliver_memtiff(MEMTIFF *memtif, const OutputSink &sink, const std::string &filepath)
+{
+  const bool streaming = is_streaming_sink(sink);
+  if (!streaming && filepath == "stdout:") {
+    size_t n = 0;
+
+    while (n < memtif->flen) {
+      n += fwrite(&(memtif->data[n]), 1, memtif->flen - n > 10240 ? 10240 : memtif->flen - n, stdout);
+    }
+
+    fflush(stdout);
+  } else if (streaming) {
+    // The whole in-memory TIFF is broadcast to the sink in one write. The
+    // buffer is detached from the MEMTIFF and handed over, so a sink that can
+    // take ownership forwards it without copying the bytes again. A non-zero
+    // return is a body-write failure (the socket is gone) — the equivalent of
+    // the old OUTPUT_WRITE_FAIL abort signal.
+    SinkStream stream{ sink };
+    unsigned char *data = std::exchange(memtif->data, nullptr);
+    if (stream.write_owned(data, static_cast<size_t>(memtif->flen), &memTiffReleaseData) != 0) {
+      throw Sipi::SipiImageClientAbortError("Client aborted HTTP response during TIFF write");
+    }
+  } else {
+    throw Sipi::SipiImageError("Unknown output method: " + filepath + " !");
+  }
+}
+
+void SipiIOTiff::write(SipiImage *img, const OutputSink &sink, const SipiCompressionParams *params)
+{
+  SIPI_ZONE_N("SipiIOTiff::write");
+  // A streamed sink (callback/tee) and stdout both need an in-memory TIFF
+  // (libtiff requires a seekable target); a real FilePath is written directly.
+  // `filepath` is derived only for the file branch and the error messages.
+  const bool streaming = is_streaming_sink(sink);
+  const std::string filepath = streaming ? std::string("<http response>") : std::get<FilePath>(sink).path;
+
+  // Declared before tif_guard: TIFFClose flushes through the memTiff*Proc
+  // callbacks, so the MEMTIFF must outlive the TIFF handle.
+  MemTiffGuard memtif_guard(nullptr, &memTiffFree);
+  TiffGuard tif_guard(nullptr, &TIFFClose);
+  auto rowsperstrip = (uint32_t)-1;
+  const bool pyramid =
+    params && params->contains(TIFF_Pyramid) && params->at(TIFF_Pyramid).compare("yes") == 0;
+  open_tiff_target(sink, filepath, estimate_tiff_size(*img, pyramid), memtif_guard, tif_guard);
   TIFF *tif = tif_guard.get();
   MEMTIFF *memtif = memtif_guard.get();
   TIFFSetField(tif, TIFFTAG_IMAGEWIDTH, static_cast<int>(img->nx));
@@ -1838,8 +2206,6 @@ void SipiIOTiff::write(SipiImage *img, const OutputSink &sink, const SipiCompres
   // dual-carrier path. The `Essentials es` declaration above
   // (line 1652) still feeds the ICC fallback at line 1653+.
   //
-  const bool pyramid =
-    params && params->contains(TIFF_Pyramid) && params->at(TIFF_Pyramid).compare("yes") == 0;
   // Essentials emit gate: the packet's presence in memory is the signal
   // (caller's responsibility, per ADR-0010). The pyramid check stays —
   // a plain TIFF carrying Essentials in memory would be a caller bug,
@@ -1861,17 +2227,44 @@ void SipiIOTiff::write(SipiImage *img, const OutputSink &sink, const SipiCompres
         TIFFWriteScanline(tif, img->pixels.data() + i * img->nc * img->nx * (img->bps / 8), (int)i, 0);
       }
     } else {
+      // Levels are built iteratively: each one is a 2×2 box reduction of the
+      // level above it, so the full-resolution buffer is read once and at most
+      // two reduced levels are alive at a time.
+      if (img->bps != 8 && img->bps != 16) {
+        throw Sipi::SipiImageError("Unsupported bits per sample for pyramid (" + std::to_string(img->bps) + ")");
+      }
+      const std::string compression =
+        params && params->contains(TIFF_Compression) ? params->at(TIFF_Compression) : std::string{};
+      const uint8_t *level_pixels = img->pixels.data();
+      std::vector<uint8_t> level_buf;
+      size_t nnx = img->nx;
+      size_t nny = img->ny;
       for (int reduce = 0; reduce <= 5; reduce += 1) {
-        SipiSize size(reduce);
-        size_t nnx;
-        size_t nny;
-        bool redonly;
-        (void)size.get_size(img->nx, img->ny, nnx, nny, reduce, redonly);
-
-        if (std::min(nnx, nny) <= 32) break;
+        if (reduce > 0) {
+          const size_t rnx = (nnx + 1) / 2;
+          const size_t rny = (nny + 1) / 2;
+          if (std::min(rnx, rny) <= 32) break;
+          std::vector<uint8_t> next(rnx * rny * img->nc * img->bps / 8);
+          if (img->bps == 8) {
+            box_reduce_2x2_u8(level_pixels, nnx, nny, img->nc, next.data());
+          } else {
+            box_reduce_2x2_u16(reinterpret_cast<const uint16_t *>(level_pixels),
+              nnx,
+              nny,
+              img->nc,
+              reinterpret_cast<uint16_t *>(next.data()));
+          }
+          level_buf = std::move(next);
+          level_pixels = level_buf.data();
+          nnx = rnx;
+          nny = rny;
+        } else if (std::min(nnx, nny) <= 32) {
+          break;
+        }
 
         uint32_t tw = 0, th = tw;
-        write_subfile(*img, tif, reduce, tw, th, "");
+        write_subfile(
+          *img, tif, reduce, level_pixels, static_cast<uint32_t>(nnx), static_cast<uint32_t>(nny), tw, th, compression);
       }
     }
   }
@@ -1885,82 +2278,20 @@ void SipiIOTiff::write(SipiImage *img, const OutputSink &sink, const SipiCompres
   }
   // Close (and thereby flush) the TIFF before consuming the MEMTIFF buffer.
   tif_guard.reset();
-
-  if (memtif != nullptr) {
-    if (!streaming && filepath == "stdout:") {
-      size_t n = 0;
-
-      while (n < memtif->flen) {
-        n += fwrite(&(memtif->data[n]), 1, memtif->flen - n > 10240 ? 10240 : memtif->flen - n, stdout);
-      }
-
-      fflush(stdout);
-    } else if (streaming) {
-      // The whole in-memory TIFF is broadcast to the sink in one write. A
-      // non-zero return is a body-write failure (the socket is gone) — the
-      // equivalent of the old OUTPUT_WRITE_FAIL abort signal.
-      SinkStream stream{ sink };
-      if (stream.write(memtif->data, memtif->flen) != 0) {
-        throw Sipi::SipiImageClientAbortError("Client aborted HTTP response during TIFF write");
-      }
-    } else {
-      throw Sipi::SipiImageError("Unknown output method: " + filepath + " !");
-    }
-  }
+  if (memtif != nullptr) { deliver_memtiff(memtif, sink, filepath); }
 }
 //============================================================================
 
-template<typename T>
-std::vector<T> doReduce(std::vector<T> &&inbuf, int reduce, size_t nx, size_t ny, size_t nc, size_t &nnx, size_t nny)
-{
-  SipiSize size(reduce);
-  int r = 0;
-  bool redonly;
-  size.get_size(nx, ny, nnx, nny, r, redonly);
-  auto outbuf = std::vector<T>(nnx * nny * nc);
-
-  auto inbuf_raw = inbuf.data();
-  auto outbuf_raw = outbuf.data();
-  reduce = 1 << reduce;
-  if (reduce <= 1) {
-    memcpy(outbuf_raw, inbuf_raw, nnx * nny * nc * sizeof(T));
-  } else {
-    for (uint32_t y = 0; y < nny; ++y) {
-      for (uint32_t x = 0; x < nnx; ++x) {
-        for (uint32_t c = 0; c < nc; ++c) {
-          uint32_t cnt = 0;
-          uint32_t tmp = 0;
-          for (uint32_t xx = 0; xx < reduce; ++xx) {
-            for (uint32_t yy = 0; yy < reduce; ++yy) {
-              if (((reduce * x + xx) < nx) && ((reduce * y + yy) < ny)) {
-                tmp += static_cast<uint32_t>(inbuf[nc * ((reduce * y + yy) * nx + (reduce * x + xx)) + c]);
-                ++cnt;
-              }
-            }
-          }
-          outbuf[nc * (y * nnx + x) + c] = (cnt > 0) ? tmp / cnt : 0;
-        }
-      }
-    }
-  }
-  return outbuf;
-}
-
 void SipiIOTiff::write_subfile(const SipiImage &img,
   TIFF *tif,
   int level,
+  const uint8_t *level_pixels,
+  uint32_t nnx,
+  uint32_t nny,
   uint32_t &tile_width,
   uint32_t &tile_height,
   const std::string &compression)
 {
-  SipiSize size(level);
-  size_t nnx;
-  size_t nny;
-  bool redonly;
-  /* try { */
-  (void)size.get_size(img.nx, img.ny, nnx, nny, level, redonly);
-  /* } catch (const IIIFSizeError &err) {} */
-
   write_basic_tags(img, tif, nnx, nny, false, compression);
   if (level > 0) { TIFFSetField(tif, TIFFTAG_SUBFILETYPE, FILETYPE_REDUCEDIMAGE); }
 
@@ -1968,38 +2299,337 @@ void SipiIOTiff::write_subfile(const SipiImage &img,
   TIFFSetField(tif, TIFFTAG_TILEWIDTH, tile_width);
   TIFFSetField(tif, TIFFTAG_TILELENGTH, tile_height);
 
-  tsize_t tilesize = TIFFTileSize(tif);
-
-  // reduce resolution of image: A reduce factor can be given, 0=no scaling, 1=0.5, 2=0.25, 3=0.125,...
-  std::vector<uint8_t> nbuf(img.pixels.data(), img.pixels.data() + img.nx * img.ny * img.nc * img.bps / 8);
-
-  if (level > 0) { nbuf = doReduce<uint8_t>(std::move(nbuf), level, img.nx, img.ny, img.nc, nnx, nny); }
+  const size_t pixel_bytes = static_cast<size_t>(img.nc) * img.bps / 8;
+  const size_t level_row_bytes = nnx * pixel_bytes;
+  const size_t tile_row_bytes = tile_width * pixel_bytes;
+  const uint32_t ntiles_x = (nnx + tile_width - 1) / tile_width;
+  const uint32_t ntiles_y = (nny + tile_height - 1) / tile_height;
+  const uint32_t ntiles = ntiles_x * ntiles_y;
+  const auto tilesize = static_cast<size_t>(TIFFTileSize(tif));
+
+  // Each tile row is one memcpy from the level buffer; the parts of an edge
+  // tile that lie outside the image are zero-filled. Tiles are numbered in
+  // TIFF order (row-major), matching TIFFComputeTile.
+  auto fill_tile = [&](uint32_t tile, uint8_t *tilebuf) {
+    const uint32_t tx = tile % ntiles_x;
+    const uint32_t ty = tile / ntiles_x;
+    const uint32_t rows = std::min(tile_height, nny - ty * tile_height);
+    const size_t cols_bytes = std::min(tile_width, nnx - tx * tile_width) * pixel_bytes;
+    const uint8_t *src = level_pixels + static_cast<size_t>(ty) * tile_height * level_row_bytes + tx * tile_row_bytes;
+    for (uint32_t y = 0; y < rows; ++y) {
+      uint8_t *dst = tilebuf + y * tile_row_bytes;
+      std::memcpy(dst, src + y * level_row_bytes, cols_bytes);
+      if (cols_bytes < tile_row_bytes) { std::memset(dst + cols_bytes, 0, tile_row_bytes - cols_bytes); }
+    }
+    if (rows < tile_height) { std::memset(tilebuf + rows * tile_row_bytes, 0, (tile_height - rows) * tile_row_bytes); }
+  };
 
-  auto ntiles_x = static_cast<uint32_t>(ceilf(static_cast<float>(nnx) / static_cast<float>(tile_width)));
-  auto ntiles_y = static_cast<uint32_t>(ceilf(static_cast<float>(nny) / static_cast<float>(tile_height)));
+  uint16_t compress = COMPRESSION_NONE;
+  TIFFGetField(tif, TIFFTAG_COMPRESSION, &compress);
+  const unsigned nworkers =
+    compress == COMPRESSION_NONE ? 1 : std::min<unsigned>(std::max(1u, std::thread::hardware_concurrency()), ntiles);
 
-  auto tilebuf = std::vector<uint8_t>(tilesize);
-  for (uint32_t ty = 0; ty < ntiles_y; ++ty) {
-    for (uint32_t tx = 0; tx < ntiles_x; ++tx) {
-      for (uint32_t y = 0; y < tile_height; ++y) {
-        for (uint32_t x = 0; x < tile_width; ++x) {
-          for (uint32_t c = 0; c < img.nc; ++c) {
-            uint32_t xx = tx * tile_width + x;
-            uint32_t yy = ty * tile_height + y;
-            if ((xx < nnx) && (yy < nny)) {
-              tilebuf[img.nc * (y * tile_width + x) + c] = nbuf[img.nc * (yy * nnx + xx) + c];
-            } else {
-              tilebuf[img.nc * (y * tile_width + x) + c] = 0;
+  if (nworkers <= 1) {
+    auto tilebuf = std::vector<uint8_t>(tilesize);
+    for (uint32_t tile = 0; tile < ntiles; ++tile) {
+      fill_tile(tile, tilebuf.data());
+      if (TIFFWriteEncodedTile(tif, tile, tilebuf.data(), static_cast<tmsize_t>(tilesize)) < 0) {
+        throw Sipi::SipiImageError("TIFFWriteEncodedTile failed for tile " + std::to_string(tile));
+      }
+    }
+  } else {
+    // Compression is the cost, so tiles are encoded in parallel and appended in
+    // order with TIFFWriteRawTile. Each worker encodes its share of a batch into
+    // its own in-memory TIFF with the same sample layout, tile size and codec —
+    // LZW and Deflate reset their state per tile, so the encoded bytes are
+    // exactly what TIFFWriteEncodedTile would emit here. Batching bounds the
+    // encoded tiles held in memory to a few per worker.
+    constexpr uint32_t kTilesPerWorker = 16;
+    const uint32_t batch = nworkers * kTilesPerWorker;
+    std::vector<std::vector<uint8_t>> encoded(batch);
+
+    auto encode_tiles = [&](uint32_t first, uint32_t count, uint32_t slot) -> std::string {
+      std::unique_ptr<MEMTIFF, decltype(&memTiffFree)> mem(
+        memTiffOpen(static_cast<tsize_t>(tilesize * count)), &memTiffFree);
+      std::unique_ptr<TIFF, decltype(&TIFFClose)> scratch(TIFFClientOpen("MEMTIFF",
+                                                            "w",
+                                                            (thandle_t)mem.get(),
+                                                            memTiffReadProc,
+                                                            memTiffWriteProc,
+                                                            memTiffSeekProc,
+                                                            memTiffCloseProc,
+                                                            memTiffSizeProc,
+                                                            memTiffMapProc,
+                                                            memTiffUnmapProc),
+        &TIFFClose);
+      if (scratch == nullptr) { return "TIFFClientOpen for tile encoding failed"; }
+      write_basic_tags(img, scratch.get(), tile_width, tile_height * count, false, compression);
+      TIFFSetField(scratch.get(), TIFFTAG_TILEWIDTH, tile_width);
+      TIFFSetField(scratch.get(), TIFFTAG_TILELENGTH, tile_height);
+
+      auto tilebuf = std::vector<uint8_t>(tilesize);
+      for (uint32_t i = 0; i < count; ++i) {
+        fill_tile(first + i, tilebuf.data());
+        if (TIFFWriteEncodedTile(scratch.get(), i, tilebuf.data(), static_cast<tmsize_t>(tilesize)) < 0) {
+          return "TIFFWriteEncodedTile failed for tile " + std::to_string(first + i);
+        }
+      }
+      uint64_t *offsets = nullptr;
+      uint64_t *bytecounts = nullptr;
+      if (TIFFGetField(scratch.get(), TIFFTAG_TILEOFFSETS, &offsets) == 0
+          || TIFFGetField(scratch.get(), TIFFTAG_TILEBYTECOUNTS, &bytecounts) == 0) {
+        return "Encoded tile offsets unavailable";
+      }
+      for (uint32_t i = 0; i < count; ++i) {
+        const unsigned char *data = mem->data + offsets[i];
+        encoded[slot + i].assign(data, data + bytecounts[i]);
+      }
+      return {};
+    };
+
+    for (uint32_t first = 0; first < ntiles; first += batch) {
+      const uint32_t count = std::min(batch, ntiles - first);
+      std::vector<std::string> errors(nworkers);
+      {
+        std::vector<std::jthread> pool;
+        pool.reserve(nworkers);
+        for (unsigned w = 0; w < nworkers; ++w) {
+          const uint32_t begin = first + count * w / nworkers;
+          const uint32_t end = first + count * (w + 1) / nworkers;
+          if (begin == end) { continue; }
+          pool.emplace_back([&, w, begin, end] {
+            try {
+              errors[w] = encode_tiles(begin, end - begin, begin - first);
+            } catch (const std::exception &err) {
+              errors[w] = err.what();
             }
-          }
+          });
+        }
+      }
+      for (const auto &err : errors) {
+        if (!err.empty()) { throw Sipi::SipiImageError(err); }
+      }
+      for (uint32_t tile = first; tile < first + count; ++tile) {
+        auto &bytes = encoded[tile - first];
+        if (TIFFWriteRawTile(tif, tile, bytes.data(), static_cast<tmsize_t>(bytes.size())) < 0) {
+          throw Sipi::SipiImageError("TIFFWriteRawTile failed for tile " + std::to_string(tile));
         }
+        bytes.clear();
       }
-      TIFFWriteTile(tif, static_cast<void *>(tilebuf.data()), tx * tile_width, ty * tile_height, 0, 0);
     }
   }
   TIFFWriteDirectory(tif);
 }
 
+// Whether the current directory's samples reach the output unchanged by a
+// decode: top-left, unsigned 8/16-bit gray or RGB, or YCbCr inside JPEG (which
+// a decode turns into RGB, a tile copy keeps — the same pixels either way).
+static bool tiff_tiles_copyable(TIFF *tif)
+{
+  uint16_t bps = 0, photo = 0, compression = COMPRESSION_NONE, ori = ORIENTATION_TOPLEFT, safo = SAMPLEFORMAT_UINT;
+  TIFFGetField(tif, TIFFTAG_BITSPERSAMPLE, &bps);
+  if (TIFFGetField(tif, TIFFTAG_PHOTOMETRIC, &photo) != 1) return false;
+  TIFFGetField(tif, TIFFTAG_COMPRESSION, &compression);
+  TIFFGetField(tif, TIFFTAG_ORIENTATION, &ori);
+  TIFFGetField(tif, TIFFTAG_SAMPLEFORMAT, &safo);
+  if (!TIFFIsTiled(tif) || (bps != 8 && bps != 16) || ori != ORIENTATION_TOPLEFT || safo != SAMPLEFORMAT_UINT) {
+    return false;
+  }
+  return photo == PHOTOMETRIC_MINISBLACK || photo == PHOTOMETRIC_RGB
+         || (photo == PHOTOMETRIC_YCBCR && compression == COMPRESSION_JPEG);
+}
+
+// Copies a counted-blob tag (JPEG tables) as is.
+static void copy_blob_tag(TIFF *in, TIFF *out, ttag_t tag)
+{
+  uint32_t count = 0;
+  void *data = nullptr;
+  if (TIFFGetField(in, tag, &count, &data) == 1 && count > 0 && data != nullptr) {
+    TIFFSetField(out, tag, count, data);
+  }
+}
+
+// The document-level tags — ICC profile, XMP, IPTC and resolution — of the
+// first directory. SIPI's pyramid writer stores them on IFD 0 only, so a copy
+// out of a reduced level takes them from there, as a decode of that level does.
+struct TiffDocumentTags
+{
+  std::vector<uint8_t> icc;
+  std::vector<uint8_t> xmp;
+  std::vector<uint8_t> iptc;
+  std::optional<float> x_res;
+  std::optional<float> y_res;
+  std::optional<uint16_t> res_unit;
+};
+
+static std::vector<uint8_t> read_blob_tag(TIFF *in, ttag_t tag)
+{
+  uint32_t count = 0;
+  const uint8_t *data = nullptr;
+  if (TIFFGetField(in, tag, &count, &data) == 1 && count > 0 && data != nullptr) { return { data, data + count }; }
+  return {};
+}
+
+static TiffDocumentTags read_document_tags(TIFF *in)
+{
+  TiffDocumentTags tags;
+  tags.icc = read_blob_tag(in, TIFFTAG_ICCPROFILE);
+  tags.xmp = read_blob_tag(in, TIFFTAG_XMLPACKET);
+  tags.iptc = read_blob_tag(in, TIFFTAG_RICHTIFFIPTC);
+  float res = 0.F;
+  uint16_t unit = 0;
+  if (TIFFGetField(in, TIFFTAG_XRESOLUTION, &res) == 1) { tags.x_res = res; }
+  if (TIFFGetField(in, TIFFTAG_YRESOLUTION, &res) == 1) { tags.y_res = res; }
+  if (TIFFGetField(in, TIFFTAG_RESOLUTIONUNIT, &unit) == 1) { tags.res_unit = unit; }
+  return tags;
+}
+
+static void write_document_tags(TIFF *out, const TiffDocumentTags &tags)
+{
+  const auto set_blob = [out](ttag_t tag, const std::vector<uint8_t> &blob) {
+    if (!blob.empty()) { TIFFSetField(out, tag, static_cast<uint32_t>(blob.size()), blob.data()); }
+  };
+  set_blob(TIFFTAG_ICCPROFILE, tags.icc);
+  set_blob(TIFFTAG_XMLPACKET, tags.xmp);
+  set_blob(TIFFTAG_RICHTIFFIPTC, tags.iptc);
+  if (tags.x_res) { TIFFSetField(out, TIFFTAG_XRESOLUTION, *tags.x_res); }
+  if (tags.y_res) { TIFFSetField(out, TIFFTAG_YRESOLUTION, *tags.y_res); }
+  if (tags.res_unit) { TIFFSetField(out, TIFFTAG_RESOLUTIONUNIT, *tags.res_unit); }
+}
+
+std::optional<TiffTileCopy> SipiIOTiff::plan_tile_copy(const std::string &filepath,
+  uint32_t x,
+  uint32_t y,
+  uint32_t w,
+  uint32_t h,
+  int reduce_exp)
+{
+  SIPI_ZONE_N("SipiIOTiff::plan_tile_copy");
+  TiffGuard tif(TIFFOpen(filepath.c_str(), "r"), TIFFClose);
+  if (tif == nullptr) return std::nullopt;
+  uint32_t width = 0;
+  if (TIFFGetField(tif.get(), TIFFTAG_IMAGEWIDTH, &width) == 0) return std::nullopt;
+  const auto job = plan_tiff_tile_copy(read_resolutions(width, tif.get()), x, y, w, h, reduce_exp);
+  if (!job || TIFFSetDirectory(tif.get(), static_cast<tdir_t>(job->level)) == 0 || !tiff_tiles_copyable(tif.get())) {
+    return std::nullopt;
+  }
+  return job;
+}
+
+void SipiIOTiff::copy_tiles(const std::string &filepath, const TiffTileCopy &job, const OutputSink &sink)
+{
+  SIPI_ZONE_N("SipiIOTiff::copy_tiles");
+  const bool streaming = is_streaming_sink(sink);
+  const std::string outpath = streaming ? std::string("<http response>") : std::get<FilePath>(sink).path;
+
+  TiffGuard in_guard(TIFFOpen(filepath.c_str(), "r"), TIFFClose);
+  if (in_guard == nullptr) { throw Sipi::SipiImageError("TIFFopen of \"" + filepath + "\" failed!"); }
+  TIFF *in = in_guard.get();
+  const TiffDocumentTags document_tags = read_document_tags(in);// IFD 0, before moving to the level
+  if (TIFFSetDirectory(in, static_cast<tdir_t>(job.level)) == 0 || !tiff_tiles_copyable(in)) {
+    throw Sipi::SipiImageError(
+      "Cannot copy tiles of \"" + filepath + "\": level " + std::to_string(job.level) + " is not copyable");
+  }
+  uint32_t width = 0, height = 0, tw = 0, th = 0;
+  TIFFGetField(in, TIFFTAG_IMAGEWIDTH, &width);
+  TIFFGetField(in, TIFFTAG_IMAGELENGTH, &height);
+  TIFFGetField(in, TIFFTAG_TILEWIDTH, &tw);
+  TIFFGetField(in, TIFFTAG_TILELENGTH, &th);
+  const uint64_t end_x = static_cast<uint64_t>(job.x) + job.w;
+  const uint64_t end_y = static_cast<uint64_t>(job.y) + job.h;
+  if (job.w == 0 || job.h == 0 || end_x > width || end_y > height || job.x % tw != 0 || job.y % th != 0
+      || (end_x != width && end_x % tw != 0) || (end_y != height && end_y % th != 0)) {
+    throw Sipi::SipiImageError("Cannot copy tiles of \"" + filepath + "\": region is not tile-aligned");
+  }
+
+  uint16_t bps = 0, spp = 1, photo = 0, planar = PLANARCONFIG_CONTIG, compression = COMPRESSION_NONE;
+  uint16_t safo = SAMPLEFORMAT_UINT;
+  TIFFGetField(in, TIFFTAG_BITSPERSAMPLE, &bps);
+  TIFFGetField(in, TIFFTAG_SAMPLESPERPIXEL, &spp);
+  TIFFGetField(in, TIFFTAG_PHOTOMETRIC, &photo);
+  TIFFGetField(in, TIFFTAG_PLANARCONFIG, &planar);
+  TIFFGetField(in, TIFFTAG_COMPRESSION, &compression);
+  TIFFGetField(in, TIFFTAG_SAMPLEFORMAT, &safo);
+
+  // The source tiles in output order; their summed sizes are the exact body
+  // size of the in-memory TIFF.
+  constexpr size_t kHeaderRoom = 64 * 1024;
+  const uint16_t planes = planar == PLANARCONFIG_SEPARATE ? spp : 1;
+  std::vector<ttile_t> tiles;
+  size_t body_bytes = 0;
+  for (uint16_t s = 0; s < planes; ++s) {
+    for (uint64_t ty = job.y; ty < end_y; ty += th) {
+      for (uint64_t tx = job.x; tx < end_x; tx += tw) {
+        const ttile_t tile = TIFFComputeTile(in, static_cast<uint32_t>(tx), static_cast<uint32_t>(ty), 0, s);
+        tiles.push_back(tile);
+        body_bytes += static_cast<size_t>(std::max<tmsize_t>(TIFFRawTileSize(in, tile), 0));
+      }
+    }
+  }
+
+  MemTiffGuard memtif_guard(nullptr, &memTiffFree);
+  TiffGuard tif_guard(nullptr, &TIFFClose);
+  open_tiff_target(sink, outpath, body_bytes + kHeaderRoom, memtif_guard, tif_guard);
+  TIFF *out = tif_guard.get();
+
+  TIFFSetField(out, TIFFTAG_IMAGEWIDTH, job.w);
+  TIFFSetField(out, TIFFTAG_IMAGELENGTH, job.h);
+  TIFFSetField(out, TIFFTAG_ORIENTATION, ORIENTATION_TOPLEFT);
+  TIFFSetField(out, TIFFTAG_BITSPERSAMPLE, bps);
+  TIFFSetField(out, TIFFTAG_SAMPLESPERPIXEL, spp);
+  TIFFSetField(out, TIFFTAG_SAMPLEFORMAT, safo);
+  TIFFSetField(out, TIFFTAG_PLANARCONFIG, planar);
+  TIFFSetField(out, TIFFTAG_PHOTOMETRIC, photo);
+  TIFFSetField(out, TIFFTAG_TILEWIDTH, tw);
+  TIFFSetField(out, TIFFTAG_TILELENGTH, th);
+  // Codec tags are only known to libtiff once the compression is set.
+  TIFFSetField(out, TIFFTAG_COMPRESSION, compression);
+  uint16_t predictor = 0;
+  if (TIFFGetField(in, TIFFTAG_PREDICTOR, &predictor) == 1) { TIFFSetField(out, TIFFTAG_PREDICTOR, predictor); }
+  copy_blob_tag(in, out, TIFFTAG_JPEGTABLES);
+
+  uint16_t sub_h = 0, sub_v = 0;
+  if (photo == PHOTOMETRIC_YCBCR && TIFFGetField(in, TIFFTAG_YCBCRSUBSAMPLING, &sub_h, &sub_v) == 1) {
+    TIFFSetField(out, TIFFTAG_YCBCRSUBSAMPLING, sub_h, sub_v);
+  }
+  float *ref_bw = nullptr;
+  if (TIFFGetField(in, TIFFTAG_REFERENCEBLACKWHITE, &ref_bw) == 1) {
+    TIFFSetField(out, TIFFTAG_REFERENCEBLACKWHITE, ref_bw);
+  }
+  uint16_t es_count = 0;
+  uint16_t *es = nullptr;
+  if (TIFFGetField(in, TIFFTAG_EXTRASAMPLES, &es_count, &es) == 1 && es_count > 0) {
+    TIFFSetField(out, TIFFTAG_EXTRASAMPLES, es_count, es);
+  }
+  write_document_tags(out, document_tags);
+
+  std::vector<uint8_t> raw;
+  size_t next = 0;
+  for (uint16_t s = 0; s < planes; ++s) {
+    for (uint64_t ty = job.y; ty < end_y; ty += th) {
+      for (uint64_t tx = job.x; tx < end_x; tx += tw) {
+        const ttile_t tile_in = tiles[next++];
+        const ttile_t tile_out = TIFFComputeTile(
+          out, static_cast<uint32_t>(tx - job.x), static_cast<uint32_t>(ty - job.y), 0, s);
+        const tmsize_t size = TIFFRawTileSize(in, tile_in);
+        if (size <= 0) { throw Sipi::SipiImageError("TIFFRawTileSize failed: " + filepath); }
+        raw.resize(static_cast<size_t>(size));
+        if (TIFFReadRawTile(in, tile_in, raw.data(), size) != size) {
+          throw Sipi::SipiImageError("TIFFReadRawTile of tile " + std::to_string(tile_in) + " failed: " + filepath);
+        }
+        if (TIFFWriteRawTile(out, tile_out, raw.data(), size) != size) {
+          throw Sipi::SipiImageError("TIFFWriteRawTile of tile " + std::to_string(tile_out) + " failed: " + outpath);
+        }
+      }
+    }
+  }
+
+  // Close (and thereby flush) the TIFF before consuming the MEMTIFF buffer.
+  tif_guard.reset();
+  if (memtif_guard != nullptr) { deliver_memtiff(memtif_guard.get(), sink, outpath); }
+}
+//============================================================================
+
 void SipiIOTiff::readExif(SipiImage *img, TIFF *tif, toff_t exif_offset)
 {
   uint16_t curdir = TIFFCurrentDirectory(tif);
@@ -9,6 +9,8 @@
 #ifndef __sipi_io_tiff_h
 #define __sipi_io_tiff_h
 
+#include <cstdint>
+#include <optional>
 #include <string>
 #include <vector>
 
@@ -37,6 +39,50 @@ namespace Sipi {
  */
 [[nodiscard]] uint32_t select_pyramid_level(const std::vector<SubImageInfo> &resolutions, int reduce_exp);
 
+/*!
+ * A tile-aligned region of one pyramid level of a tiled TIFF, in that level's
+ * pixel coordinates — what `SipiIOTiff::copy_tiles` copies without decoding.
+ */
+struct TiffTileCopy
+{
+  uint32_t level{ 0 };
+  uint32_t x{ 0 };
+  uint32_t y{ 0 };
+  uint32_t w{ 0 };
+  uint32_t h{ 0 };
+};
+
+/*!
+ * The tile copy that serves the full-resolution region (x, y, w, h) at the IIIF
+ * reduce exponent `reduce_exp` from a pyramid described by `resolutions` (as
+ * for `select_pyramid_level`), if there is one: a tiled level whose ratio is
+ * exactly 2^reduce_exp and which is the rounded-up reduction of level 0, with
+ * the region mapping onto whole pixels of it and each edge on the level's tile
+ * grid or the image edge. Returns nullopt when the request needs a decode.
+ */
+[[nodiscard]] std::optional<TiffTileCopy> plan_tiff_tile_copy(const std::vector<SubImageInfo> &resolutions,
+  uint32_t x,
+  uint32_t y,
+  uint32_t w,
+  uint32_t h,
+  int reduce_exp);
+
+/*!
+ * The libjpeg DCT scale denominator (1, 2, 4 or 8) at which the JPEG tiles of
+ * pyramid level `level` can be decoded for a request at the IIIF reduce
+ * exponent `reduce_exp`: the largest power of two, at most 8, within the
+ * residual 2^reduce_exp / level.reduce that `select_pyramid_level` leaves to
+ * the size stage, and dividing the tile size and the ROI (x, y, w, h) in the
+ * level's pixels — an ROI end may instead lie on the level edge. 1 = decode
+ * at full level resolution.
+ */
+[[nodiscard]] uint32_t tiff_jpeg_scale_denom(const SubImageInfo &level,
+  int reduce_exp,
+  uint32_t x,
+  uint32_t y,
+  uint32_t w,
+  uint32_t h);
+
 /*! Class which implements the TIFF-reader/writer */
 class SipiIOTiff : public SipiIO
 {
@@ -56,6 +102,38 @@ private:
    */
   void writeExif(SipiImage *img, TIFF *tif);
 
+  //! What the pixel stage of a read needs from the file besides the tags and
+  //! metadata `read_header` puts into the image: the palette and the resolution
+  //! levels.
+  struct TiffHeader
+  {
+    std::vector<uint16_t> rcm;
+    std::vector<uint16_t> gcm;
+    std::vector<uint16_t> bcm;
+    int colmap_len = 0;
+    std::vector<SubImageInfo> resolutions;
+  };
+
+  /*!
+   * Reads the shape, tags and metadata of the first directory of an open TIFF
+   * into img (no pixels), and walks its resolution levels into header.
+   */
+  void read_header(SipiImage *img, TIFF *tif, const std::string &filepath, TiffHeader &header);
+
+  /*!
+   * Decodes region/size of an open TIFF into img, which holds what
+   * `read_header` read from it. Switches the handle to the pyramid level the
+   * size selects, and leaves it there.
+   */
+  void read_pixels(SipiImage *img,
+    TIFF *tif,
+    const std::string &filepath,
+    const TiffHeader &header,
+    std::shared_ptr<SipiRegion> region,
+    std::shared_ptr<SipiSize> size,
+    bool force_bps_8,
+    ScalingQuality scaling_quality);
+
   static void write_basic_tags(const SipiImage &img,
     TIFF *tif,
     uint32_t nx,
@@ -63,9 +141,17 @@ private:
     bool its_1_bit,
     const std::string &compression);
 
+  /*!
+   * Writes one pyramid level as a tiled subfile (IFD).
+   * \param[in] level Pyramid level (0 = full resolution, marked as reduced image otherwise)
+   * \param[in] level_pixels Interleaved pixels of the level (nnx * nny pixels in the image's sample layout)
+   */
   static void write_subfile(const SipiImage &img,
     TIFF *tif,
     int level,
+    const uint8_t *level_pixels,
+    uint32_t nnx,
+    uint32_t nny,
     uint32_t &tile_width,
     uint32_t &tile_height,
     const std::string &compression = "");
@@ -108,6 +194,18 @@ public:
     bool force_bps_8,
     ScalingQuality scaling_quality) override;
 
+  /*!
+   * Read several regions of one TIFF through a single open handle: the file
+   * is opened, its tags and metadata are read and its pyramid directories are
+   * walked once for all tiles, and the handle only changes directory between
+   * tiles of different pyramid levels.
+   */
+  bool read_tiles(const std::string &filepath,
+    const std::vector<SipiTileRequest> &tiles,
+    bool force_bps_8,
+    ScalingQuality scaling_quality,
+    const SipiTileEmit &emit) override;
+
   /*!
    * Get the dimension of the image
    *
@@ -128,6 +226,33 @@ public:
    * stdout via "-"/"stdout:"), or a streamed CallbackSink / TeeSink.
    */
   void write(SipiImage *img, const OutputSink &sink, const SipiCompressionParams *params) override;
+
+  /*!
+   * The tile copy for the full-resolution region (x, y, w, h) at reduce
+   * exponent `reduce_exp` of the TIFF `filepath` (see `plan_tiff_tile_copy`).
+   * Also nullopt when the selected level's samples would be converted by a
+   * decode — only top-left 8/16-bit unsigned gray or RGB, or JPEG YCbCr, is
+   * copied.
+   *
+   * \param filepath TIFF source
+   */
+  static std::optional<TiffTileCopy>
+    plan_tile_copy(const std::string &filepath, uint32_t x, uint32_t y, uint32_t w, uint32_t h, int reduce_exp);
+
+  /*!
+   * Write the region `job` of the TIFF `filepath` as a new single-level tiled
+   * TIFF without decoding any pixels: the compressed tiles are copied with
+   * TIFFReadRawTile/TIFFWriteRawTile, along with the compression (predictor,
+   * JPEG tables), photometric, YCbCr and extra-sample tags, the ICC profile,
+   * XMP, IPTC and the resolution. The output is an Access File and carries no
+   * Essentials packet. A job that turns out not to be copyable throws
+   * SipiImageError.
+   *
+   * \param filepath TIFF source
+   * \param job Level and tile-aligned region, from `plan_tile_copy`
+   * \param sink Where the encoded bytes go.
+   */
+  static void copy_tiles(const std::string &filepath, const TiffTileCopy &job, const OutputSink &sink);
 };
 }// namespace Sipi
 
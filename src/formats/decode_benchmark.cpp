@@ -10,9 +10,18 @@
 //   pyr-none.tif   256×256 tiled pyramid, uncompressed — the fast baseline
 //   pyr-zstd.tif   tiled pyramid, ZStd level 9
 //   pyr-webp.tif   tiled pyramid, WebP Q90
-//   pyr.jp2        Kakadu JPEG2000 (Pillay slide-14 params)
+//   pyr.jp2        Kakadu JPEG2000 (Pillay slide-14 params); the thumbnail
+//                  is also measured with a truncated quality-layer share
 //   baseline.jpg   plain JPEG Q90      — deliberate slow baseline
 //   flat.tif       untiled flat TIFF   — deliberate slow baseline
+//   baseline.png   non-interlaced PNG of flat.tif's pixels — row-streamed
+//                  (region rows only; the HIGH scale runs while decoding).
+//                  Not in the pinned archive: written once per run into the
+//                  temp dir from flat.tif.
+//   pyr-jpeg.tif   256×256 tiled pyramid, JPEG Q90 (YCbCr), levels 1, 1/2
+//                  and 1/4 only — the thumbnail reduces past the deepest
+//                  level, so its tiles decode at a DCT scale. Also derived
+//                  from flat.tif once per run (SIPI writes no JPEG-in-TIFF).
 //
 // Two access shapes per format: a full-resolution tile (region dim×dim,
 // 1:1 size — the deep-zoom viewer hot path; the slow baselines pay a full
@@ -32,15 +41,20 @@
 
 #include <benchmark/benchmark.h>
 
+#include <algorithm>
 #include <cstdint>
 #include <cstdio>
 #include <cstdlib>
 #include <memory>
 #include <string>
+#include <vector>
+
+#include "tiffio.h"
 
 #include "SipiImage.h"
 #include "iiifparser/SipiRegion.h"
 #include "iiifparser/SipiSize.h"
+#include "metadata/icc.h"
 
 namespace {
 
@@ -57,12 +71,90 @@ std::string fixture(const std::string &name)
   return std::string{ dir } + "/big_building/" + name;
 }
 
+std::string tmp_path(const std::string &name)
+{
+  const char *tmp = std::getenv("TEST_TMPDIR");
+  return std::string{ tmp != nullptr ? tmp : "/tmp" } + "/" + name;
+}
+
+// Appends `img` to `tif` as one 256×256-tiled, JPEG Q90 YCbCr directory.
+void write_jpeg_level(TIFF *tif, Sipi::SipiImage &img, bool reduced)
+{
+  constexpr uint32_t kTile = 256;
+  const auto w = static_cast<uint32_t>(img.getNx());
+  const auto h = static_cast<uint32_t>(img.getNy());
+  if (reduced) { TIFFSetField(tif, TIFFTAG_SUBFILETYPE, FILETYPE_REDUCEDIMAGE); }
+  TIFFSetField(tif, TIFFTAG_IMAGEWIDTH, w);
+  TIFFSetField(tif, TIFFTAG_IMAGELENGTH, h);
+  TIFFSetField(tif, TIFFTAG_SAMPLESPERPIXEL, static_cast<uint16_t>(3));
+  TIFFSetField(tif, TIFFTAG_BITSPERSAMPLE, static_cast<uint16_t>(8));
+  TIFFSetField(tif, TIFFTAG_PLANARCONFIG, PLANARCONFIG_CONTIG);
+  TIFFSetField(tif, TIFFTAG_TILEWIDTH, kTile);
+  TIFFSetField(tif, TIFFTAG_TILELENGTH, kTile);
+  TIFFSetField(tif, TIFFTAG_COMPRESSION, COMPRESSION_JPEG);
+  TIFFSetField(tif, TIFFTAG_PHOTOMETRIC, PHOTOMETRIC_YCBCR);
+  TIFFSetField(tif, TIFFTAG_JPEGQUALITY, 90);
+  TIFFSetField(tif, TIFFTAG_JPEGCOLORMODE, JPEGCOLORMODE_RGB);
+  std::vector<uint8_t> tile(static_cast<size_t>(kTile) * kTile * 3);
+  for (uint32_t ty = 0; ty < h; ty += kTile) {
+    for (uint32_t tx = 0; tx < w; tx += kTile) {
+      std::fill(tile.begin(), tile.end(), uint8_t{ 0 });
+      for (uint32_t y = 0; y < std::min(kTile, h - ty); ++y) {
+        for (uint32_t x = 0; x < std::min(kTile, w - tx); ++x) {
+          for (uint32_t c = 0; c < 3; ++c) {
+            tile[(y * kTile + x) * 3 + c] = static_cast<uint8_t>(img.getPixel(tx + x, ty + y, c));
+          }
+        }
+      }
+      TIFFWriteTile(tif, tile.data(), tx, ty, 0, 0);
+    }
+  }
+  TIFFWriteDirectory(tif);
+}
+
+// baseline.png and pyr-jpeg.tif are derived from flat.tif on first use (same
+// pixels), so the PNG row-streaming and JPEG-in-TIFF DCT-scaling paths are
+// measured against the same master as the others.
+std::string resolve(const std::string &name)
+{
+  if (name == "baseline.png") {
+    static const std::string png_path = [] {
+      std::string out = tmp_path("sipi_bench_baseline.png");
+      Sipi::SipiImage img;
+      img.read(fixture("flat.tif"));
+      img.write("png", out);
+      return out;
+    }();
+    return png_path;
+  }
+  if (name == "pyr-jpeg.tif") {
+    static const std::string tif_path = [] {
+      std::string out = tmp_path("sipi_bench_pyr_jpeg.tif");
+      Sipi::SipiImage img;
+      img.read(fixture("flat.tif"));
+      std::unique_ptr<TIFF, decltype(&TIFFClose)> tif(TIFFOpen(out.c_str(), "w"), TIFFClose);
+      if (tif == nullptr || img.getNc() != 3 || img.getBps() != 8) {
+        std::fprintf(stderr, "cannot derive %s from flat.tif\n", out.c_str());
+        std::exit(1);
+      }
+      write_jpeg_level(tif.get(), img, false);
+      for (int level = 1; level <= 2; ++level) {
+        img.scale((img.getNx() + 1) / 2, (img.getNy() + 1) / 2);
+        write_jpeg_level(tif.get(), img, true);
+      }
+      return out;
+    }();
+    return tif_path;
+  }
+  return fixture(name);
+}
+
 // Full-resolution dim×dim tile at (1024,1024) — what a deep-zoom viewer
 // requests. Tiled formats touch a handful of tiles; the slow baselines
 // (plain JPEG, flat TIFF) must decode the whole 39 Mpx image first.
 void decode_tile(benchmark::State &state, const char *file)
 {
-  const std::string path = fixture(file);
+  const std::string path = resolve(file);
   const auto dim = state.range(0);
   const std::string size_spec = std::to_string(dim) + "," + std::to_string(dim);
   for (auto _ : state) {
@@ -81,7 +173,7 @@ void decode_tile(benchmark::State &state, const char *file)
 // the slow baselines decode everything and downscale.
 void decode_thumb(benchmark::State &state, const char *file)
 {
-  const std::string path = fixture(file);
+  const std::string path = resolve(file);
   // !256,256 best-fits the 4:3 master to 256×192, not 256×256 — report
   // throughput from the actual decoded dimensions.
   int64_t thumb_bytes = 0;
@@ -96,6 +188,43 @@ void decode_thumb(benchmark::State &state, const char *file)
   state.SetBytesProcessed(state.iterations() * thumb_bytes);
 }
 
+// The jp2 thumbnail again with the quality-layer share the serve path picks
+// for small JPEG renderings (Arg = percent of layers; 0 = all layers).
+void decode_thumb_layers(benchmark::State &state, const char *file)
+{
+  const std::string path = resolve(file);
+  Sipi::ScalingQuality quality{
+    Sipi::ScalingMethod::HIGH, Sipi::ScalingMethod::HIGH, Sipi::ScalingMethod::HIGH, Sipi::ScalingMethod::HIGH
+  };
+  quality.j2k_layer_percent = static_cast<uint8_t>(state.range(0));
+  for (auto _ : state) {
+    Sipi::SipiImage img;
+    auto size = std::make_shared<Sipi::SipiSize>("!256,256");
+    img.read(path, nullptr, size, false, quality);
+    benchmark::DoNotOptimize(img.getNx());
+    benchmark::ClobberMemory();
+  }
+}
+
+// The jp2 thumbnail as a `gray` rendering: the exact path (full decode + ICC
+// conversion to gray) against the luma-only decode (Arg = J2kGrayDecode).
+void decode_thumb_gray(benchmark::State &state, const char *file)
+{
+  const std::string path = resolve(file);
+  Sipi::ScalingQuality quality{
+    Sipi::ScalingMethod::HIGH, Sipi::ScalingMethod::HIGH, Sipi::ScalingMethod::HIGH, Sipi::ScalingMethod::HIGH
+  };
+  quality.j2k_gray = static_cast<Sipi::J2kGrayDecode>(state.range(0));
+  for (auto _ : state) {
+    Sipi::SipiImage img;
+    auto size = std::make_shared<Sipi::SipiSize>("!256,256");
+    img.read(path, nullptr, size, true, quality);
+    if (img.getNc() != 1) { img.convertToIcc(Sipi::Icc(Sipi::icc_GRAY_D50), 8); }
+    benchmark::DoNotOptimize(img.getNx());
+    benchmark::ClobberMemory();
+  }
+}
+
 #define SIPI_DECODE_BENCH(name, file)                                                             \
   BENCHMARK_CAPTURE(decode_tile, name, file)->Arg(256)->Arg(1024)->Unit(benchmark::kMillisecond); \
   BENCHMARK_CAPTURE(decode_thumb, name, file)->Unit(benchmark::kMillisecond)
@@ -104,8 +233,12 @@ SIPI_DECODE_BENCH(pyr_none, "pyr-none.tif");
 SIPI_DECODE_BENCH(pyr_zstd, "pyr-zstd.tif");
 SIPI_DECODE_BENCH(pyr_webp, "pyr-webp.tif");
 SIPI_DECODE_BENCH(jp2, "pyr.jp2");
+BENCHMARK_CAPTURE(decode_thumb_layers, jp2, "pyr.jp2")->Arg(0)->Arg(75)->Arg(50)->Unit(benchmark::kMillisecond);
+BENCHMARK_CAPTURE(decode_thumb_gray, jp2, "pyr.jp2")->Arg(0)->Arg(1)->Arg(2)->Unit(benchmark::kMillisecond);
 SIPI_DECODE_BENCH(jpeg_baseline, "baseline.jpg");
 SIPI_DECODE_BENCH(flat_tiff, "flat.tif");
+SIPI_DECODE_BENCH(png, "baseline.png");
+SIPI_DECODE_BENCH(pyr_jpeg, "pyr-jpeg.tif");
 
 #undef SIPI_DECODE_BENCH
 
@@ -11,7 +11,7 @@
 // the image in place for format constraints, so iterations must not share
 // state).
 //
-// Matrix: JPEG Q75 / Q90, PNG, TIFF, JPEG2000 — the four formats
+// Matrix: JPEG Q75 / Q90, PNG, TIFF (flat and pyramidal), JPEG2000 — the four formats
 // `SipiImage::write()` emits (`jpg`/`png`/`tif`/`jpx`, the keys of the
 // static SipiIO handler map in SipiImage.cpp). The plan's "WebP" encode
 // entry does not exist in SIPI: WebP is supported only as a TIFF-internal
@@ -98,6 +98,15 @@ BENCHMARK(BM_EncodePng)->Unit(benchmark::kMillisecond);
 void BM_EncodeTiff(benchmark::State &state) { encode(state, "tif", nullptr); }
 BENCHMARK(BM_EncodeTiff)->Unit(benchmark::kMillisecond);
 
+// Tiled pyramidal TIFF — the `convert service-file` write: every level is a
+// 2×2 box reduction of the one above, tiled into 256² tiles.
+void BM_EncodeTiffPyramid(benchmark::State &state)
+{
+  const Sipi::SipiCompressionParams params = { { Sipi::TIFF_Pyramid, "yes" } };
+  encode(state, "tif", &params);
+}
+BENCHMARK(BM_EncodeTiffPyramid)->Unit(benchmark::kMillisecond);
+
 void BM_EncodeJ2k(benchmark::State &state) { encode(state, "jpx", nullptr); }
 BENCHMARK(BM_EncodeJ2k)->Unit(benchmark::kMillisecond);
 
@@ -0,0 +1,51 @@
+/*
+ * Copyright © 2016 - 2026 Swiss National Data and Service Center for the Humanities and/or DaSCH Service Platform
+ * contributors. SPDX-License-Identifier: AGPL-3.0-or-later
+ */
+
+#include "gtest/gtest.h"
+
+#include "formats/SipiIOJ2k.h"
+
+using Sipi::j2k_layer_percent;
+using Sipi::j2k_max_layers;
+using Sipi::kJ2kMinLayerPercent;
+
+// Off (size 0), outputs larger than the threshold, and non-JPEG outputs decode
+// every layer.
+TEST(J2kLayerPolicy, AllLayersOutsideThePolicy)
+{
+  EXPECT_EQ(j2k_layer_percent(128, 96, 60, 0), 0);
+  EXPECT_EQ(j2k_layer_percent(1024, 768, 60, 512), 0);
+  EXPECT_EQ(j2k_layer_percent(300, 513, 60, 512), 0);
+  EXPECT_EQ(j2k_layer_percent(128, 96, 0, 512), 0);
+  EXPECT_EQ(j2k_layer_percent(0, 0, 60, 512), 0);
+}
+
+// The share grows with the output edge and the JPEG quality and stays within
+// [kJ2kMinLayerPercent, 100].
+TEST(J2kLayerPolicy, ShareScalesWithSizeAndQuality)
+{
+  EXPECT_EQ(j2k_layer_percent(512, 384, 100, 512), 100);
+  EXPECT_EQ(j2k_layer_percent(512, 384, 60, 512), 80);
+  EXPECT_EQ(j2k_layer_percent(128, 96, 60, 512), 58);
+  EXPECT_EQ(j2k_layer_percent(1, 1, 1, 512), kJ2kMinLayerPercent + 1);// rounded up
+  EXPECT_EQ(j2k_layer_percent(96, 128, 60, 512), j2k_layer_percent(128, 96, 60, 512));
+  EXPECT_LT(j2k_layer_percent(128, 96, 60, 512), j2k_layer_percent(256, 192, 60, 512));
+  EXPECT_LT(j2k_layer_percent(256, 192, 40, 512), j2k_layer_percent(256, 192, 90, 512));
+  EXPECT_EQ(j2k_layer_percent(512, 512, 250, 512), 100);
+}
+
+// Percentages round up to whole layers, never below one; 0, 100 and an unknown
+// layer count leave Kakadu's "all layers" (0).
+TEST(J2kLayerPolicy, MaxLayersRoundsUp)
+{
+  EXPECT_EQ(j2k_max_layers(8, 0), 0);
+  EXPECT_EQ(j2k_max_layers(8, 100), 0);
+  EXPECT_EQ(j2k_max_layers(0, 50), 0);
+  EXPECT_EQ(j2k_max_layers(8, 50), 4);
+  EXPECT_EQ(j2k_max_layers(8, 58), 5);
+  EXPECT_EQ(j2k_max_layers(8, 80), 7);
+  EXPECT_EQ(j2k_max_layers(1, 50), 1);
+  EXPECT_EQ(j2k_max_layers(3, 1), 1);
+}
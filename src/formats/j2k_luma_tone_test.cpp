@@ -0,0 +1,37 @@
+/*
+ * Copyright © 2016 - 2026 Swiss National Data and Service Center for the Humanities and/or DaSCH Service Platform
+ * contributors. SPDX-License-Identifier: AGPL-3.0-or-later
+ */
+
+#include "gtest/gtest.h"
+
+#include <cmath>
+
+#include "formats/SipiIOJ2k.h"
+
+using Sipi::j2k_luma_tone;
+
+// Black and white are fixed points, and the curve never reverses.
+TEST(J2kLumaTone, EndpointsFixedAndMonotone)
+{
+  EXPECT_EQ(j2k_luma_tone(0), 0);
+  EXPECT_EQ(j2k_luma_tone(255), 255);
+  for (int v = 1; v < 256; ++v) {
+    EXPECT_LE(j2k_luma_tone(static_cast<uint8_t>(v - 1)), j2k_luma_tone(static_cast<uint8_t>(v))) << v;
+  }
+}
+
+// On the neutral axis the tone equals what the exact path produces: the sRGB
+// sample decoded to linear light and re-encoded with gamma 2.2.
+TEST(J2kLumaTone, MatchesSrgbToGamma22OnTheNeutralAxis)
+{
+  for (int v = 0; v < 256; ++v) {
+    const double s = v / 255.0;
+    const double linear = s <= 0.04045 ? s / 12.92 : std::pow((s + 0.055) / 1.055, 2.4);
+    const double expected = 255.0 * std::pow(linear, 1.0 / 2.2);
+    EXPECT_NEAR(j2k_luma_tone(static_cast<uint8_t>(v)), expected, 0.5) << v;
+  }
+  // sRGB and gamma 2.2 nearly coincide in the mid-tones and part in the shadows.
+  EXPECT_EQ(j2k_luma_tone(128), 127);
+  EXPECT_GT(j2k_luma_tone(10), 10);
+}
@@ -0,0 +1,96 @@
+/*
+ * Copyright © 2016 - 2026 Swiss National Data and Service Center for the Humanities and/or DaSCH Service Platform
+ * contributors. SPDX-License-Identifier: AGPL-3.0-or-later
+ */
+
+#include "gtest/gtest.h"
+
+#include "formats/SipiIOJ2k.h"
+
+using Sipi::J2kCanvas;
+using Sipi::J2kRegionTranscode;
+using Sipi::j2k_region_is_transcodable;
+
+namespace {
+
+// 1100×700 at origin 0, 256×256 tiles, 5 DWT levels: 5×3 tiles, the last
+// column 76 px wide and the last row 188 px high.
+J2kCanvas tiled()
+{
+  J2kCanvas c;
+  c.width = 1100;
+  c.height = 700;
+  c.tile_w = 256;
+  c.tile_h = 256;
+  c.levels = 5;
+  return c;
+}
+
+}// namespace
+
+// Edges on tile boundaries or the image edge, with the tile grid surviving the
+// reduce.
+TEST(J2kTranscodeRegion, TileAlignedRegions)
+{
+  EXPECT_TRUE(j2k_region_is_transcodable(tiled(), { 0, 0, 1100, 700, 0 }));
+  EXPECT_TRUE(j2k_region_is_transcodable(tiled(), { 256, 256, 256, 256, 0 }));
+  EXPECT_TRUE(j2k_region_is_transcodable(tiled(), { 256, 0, 512, 512, 2 }));
+  EXPECT_TRUE(j2k_region_is_transcodable(tiled(), { 768, 512, 332, 188, 5 }));// last tile, ragged edges
+}
+
+TEST(J2kTranscodeRegion, UnalignedRegionsNeedADecode)
+{
+  EXPECT_FALSE(j2k_region_is_transcodable(tiled(), { 10, 0, 246, 256, 0 }));
+  EXPECT_FALSE(j2k_region_is_transcodable(tiled(), { 0, 0, 300, 256, 0 }));
+  EXPECT_FALSE(j2k_region_is_transcodable(tiled(), { 0, 0, 256, 255, 0 }));
+}
+
+TEST(J2kTranscodeRegion, OutOfRangeRegionsAndReduces)
+{
+  EXPECT_FALSE(j2k_region_is_transcodable(tiled(), { 0, 0, 0, 256, 0 }));
+  EXPECT_FALSE(j2k_region_is_transcodable(tiled(), { 1024, 0, 256, 256, 0 }));
+  EXPECT_FALSE(j2k_region_is_transcodable(tiled(), { 0, 700, 256, 256, 0 }));
+  EXPECT_FALSE(j2k_region_is_transcodable(tiled(), { 0, 0, 256, 256, 6 }));
+  EXPECT_FALSE(j2k_region_is_transcodable(tiled(), { 0, 0, 256, 256, -1 }));
+}
+
+// A tile size not divisible by 2^reduce would not map onto the reduced grid.
+TEST(J2kTranscodeRegion, TileGridMustSurviveTheReduce)
+{
+  J2kCanvas c = tiled();
+  c.tile_w = 384;
+  c.tile_h = 384;
+  EXPECT_TRUE(j2k_region_is_transcodable(c, { 384, 0, 384, 384, 5 }));
+  c.tile_w = 300;
+  c.tile_h = 300;
+  EXPECT_TRUE(j2k_region_is_transcodable(c, { 300, 300, 300, 300, 2 }));
+  EXPECT_FALSE(j2k_region_is_transcodable(c, { 300, 300, 300, 300, 3 }));
+}
+
+// Untiled images (tile size 0, or one tile over the whole axis) only transcode
+// whole — a reduce of the full image.
+TEST(J2kTranscodeRegion, UntiledImagesOnlyWhole)
+{
+  J2kCanvas c = tiled();
+  c.tile_w = 0;
+  c.tile_h = 0;
+  EXPECT_TRUE(j2k_region_is_transcodable(c, { 0, 0, 1100, 700, 3 }));
+  EXPECT_FALSE(j2k_region_is_transcodable(c, { 0, 0, 512, 512, 0 }));
+  c.tile_w = 2048;
+  c.tile_h = 2048;
+  EXPECT_TRUE(j2k_region_is_transcodable(c, { 0, 0, 1100, 700, 5 }));
+}
+
+// Tile boundaries are measured on the canvas, from the tile origin.
+TEST(J2kTranscodeRegion, CanvasOrigins)
+{
+  J2kCanvas c = tiled();
+  c.origin_x = 256;
+  c.tile_origin_x = 0;
+  EXPECT_TRUE(j2k_region_is_transcodable(c, { 0, 0, 256, 256, 0 }));
+  EXPECT_TRUE(j2k_region_is_transcodable(c, { 256, 0, 256, 256, 0 }));
+  c.origin_x = 100;
+  EXPECT_TRUE(j2k_region_is_transcodable(c, { 156, 0, 256, 256, 0 }));
+  EXPECT_FALSE(j2k_region_is_transcodable(c, { 256, 0, 256, 256, 0 }));
+  EXPECT_FALSE(j2k_region_is_transcodable(c, { 156, 0, 256, 256, 3 }));// origin 100 not divisible by 8
+}
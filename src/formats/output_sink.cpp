@@ -19,14 +19,14 @@ void SinkStream::flatten(const OutputSink &sink)
     [this](const auto &alt) {
       using T = std::decay_t<decltype(alt)>;
       if constexpr (std::is_same_v<T, CallbackSink>) {
-        leaves_.push_back(Leaf{ alt.write, alt.ctx, nullptr, /*fatal=*/true });
+        leaves_.push_back(Leaf{ alt.write, alt.write_owned, alt.ctx, nullptr, /*fatal=*/true });
       } else if constexpr (std::is_same_v<T, FilePath>) {
         // A FilePath leaf only reaches SinkStream as part of a tee (the cache
         // file). Open it for streaming; an open failure leaves the leaf inert,
         // matching shttps's best-effort cache (a bad cache write never aborts
         // the response).
         auto file = std::make_shared<std::ofstream>(alt.path, std::ios::binary | std::ios::trunc);
-        leaves_.push_back(Leaf{ nullptr, nullptr, std::move(file), /*fatal=*/false });
+        leaves_.push_back(Leaf{ nullptr, nullptr, nullptr, std::move(file), /*fatal=*/false });
       } else if constexpr (std::is_same_v<T, TeeSink>) {
         for (const auto &child : alt.sinks) flatten(child);
       }
@@ -34,19 +34,48 @@ void SinkStream::flatten(const OutputSink &sink)
     sink);
 }
 
+int SinkStream::write_leaf(Leaf &leaf, const uint8_t *data, size_t len)
+{
+  if (leaf.fn != nullptr) {
+    const int r = leaf.fn(leaf.ctx, data, len);
+    if (r != 0 && leaf.fatal) return r;
+  } else if (leaf.file) {
+    // Best-effort: a failed cache write sets failbit and is silently
+    // dropped, exactly as shttps does for its tee'd cache file.
+    leaf.file->write(reinterpret_cast<const char *>(data), static_cast<std::streamsize>(len));
+  }
+  return 0;
+}
+
 int SinkStream::write(const uint8_t *data, size_t len)
 {
   int rc = 0;
   for (auto &leaf : leaves_) {
-    if (leaf.fn != nullptr) {
-      const int r = leaf.fn(leaf.ctx, data, len);
-      if (r != 0 && leaf.fatal) rc = r;
-    } else if (leaf.file) {
-      // Best-effort: a failed cache write sets failbit and is silently
-      // dropped, exactly as shttps does for its tee'd cache file.
-      leaf.file->write(reinterpret_cast<const char *>(data), static_cast<std::streamsize>(len));
-    }
+    const int r = write_leaf(leaf, data, len);
+    if (r != 0) rc = r;
+  }
+  return rc;
+}
+
+int SinkStream::write_owned(uint8_t *data, size_t len, SipiReleaseFn release)
+{
+  Leaf *owner = nullptr;
+  for (auto &leaf : leaves_) {
+    if (leaf.owned_fn != nullptr) owner = &leaf;
+  }
+
+  int rc = 0;
+  for (auto &leaf : leaves_) {
+    if (&leaf == owner) continue;
+    const int r = write_leaf(leaf, data, len);
+    if (r != 0) rc = r;
+  }
+  if (owner == nullptr) {
+    release(data);
+    return rc;
   }
+  const int r = owner->owned_fn(owner->ctx, data, len, release);
+  if (r != 0 && owner->fatal) rc = r;
   return rc;
 }
 
@@ -34,6 +34,16 @@ namespace Sipi {
  */
 extern "C" {
 typedef int (*SipiWriteFn)(void *ctx, const uint8_t *data, size_t len);
+
+/*! Frees a buffer passed to a `SipiWriteOwnedFn`. Callable from any thread. */
+typedef void (*SipiReleaseFn)(uint8_t *data);
+
+/*!
+ * Ownership-taking body write: the callee keeps `data` and calls
+ * `release(data)` exactly once when it is done with it — also when it fails.
+ * Identical to the FFI `SipiWriteOwnedFn`.
+ */
+typedef int (*SipiWriteOwnedFn)(void *ctx, uint8_t *data, size_t len, SipiReleaseFn release);
 }
 
 /*!
@@ -47,11 +57,17 @@ struct FilePath
   std::string path;
 };
 
-/*! An opaque C-ABI sink — the HTTP socket today, a Rust-owned sink eventually. */
+/*!
+ * An opaque C-ABI sink — the HTTP socket today, a Rust-owned sink eventually.
+ * `write_owned` is optional: when set, a codec that produces its output as one
+ * heap buffer (the in-memory TIFF) hands the buffer over instead of having it
+ * copied.
+ */
 struct CallbackSink
 {
   SipiWriteFn write;
   void *ctx;
+  SipiWriteOwnedFn write_owned{ nullptr };
 };
 
 struct TeeSink;//!< forward declaration (a variant alternative may contain the variant)
@@ -103,16 +119,27 @@ public:
   /*! Write one chunk. Returns 0 on success, non-zero if a fatal sink failed. */
   [[nodiscard]] int write(const uint8_t *data, size_t len);
 
+  /*!
+   * Write one chunk held in a malloc-style buffer whose ownership passes to the
+   * stream: every other leaf is written from it first, then the last
+   * `CallbackSink` leaf with a `write_owned` callback takes it. Without such a
+   * leaf the buffer is written like `write()` and released here. `release` is
+   * called exactly once either way. Same return contract as `write()`.
+   */
+  [[nodiscard]] int write_owned(uint8_t *data, size_t len, SipiReleaseFn release);
+
 private:
   struct Leaf
   {
     SipiWriteFn fn{ nullptr };//!< set for a CallbackSink leaf
+    SipiWriteOwnedFn owned_fn{ nullptr };//!< optional ownership-taking variant of `fn`
     void *ctx{ nullptr };
     std::shared_ptr<std::ostream> file;//!< set for a FilePath leaf
     bool fatal{ false };//!< CallbackSink failures abort; FilePath failures don't
   };
 
   void flatten(const OutputSink &sink);
+  [[nodiscard]] static int write_leaf(Leaf &leaf, const uint8_t *data, size_t len);
 
   std::vector<Leaf> leaves_;
 };
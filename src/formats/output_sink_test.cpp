@@ -7,6 +7,7 @@
 
 #include <gtest/gtest.h>
 
+#include <algorithm>
 #include <cstdint>
 #include <cstdlib>
 #include <fstream>
@@ -31,6 +32,38 @@ extern "C" int capture_write(void *ctx, const uint8_t *data, size_t len)
   return c->return_code;
 }
 
+// Records what an ownership-taking callback was handed, then releases it as
+// the contract requires.
+struct OwnedCtx
+{
+  const uint8_t *received{ nullptr };
+  std::vector<uint8_t> bytes;
+};
+
+int releases = 0;
+
+extern "C" void count_release(uint8_t *data)
+{
+  ++releases;
+  std::free(data);
+}
+
+extern "C" int capture_owned(void *ctx, uint8_t *data, size_t len, Sipi::SipiReleaseFn release)
+{
+  auto *c = static_cast<OwnedCtx *>(ctx);
+  c->received = data;
+  c->bytes.assign(data, data + len);
+  release(data);
+  return 0;
+}
+
+uint8_t *heap_copy(const std::vector<uint8_t> &v)
+{
+  auto *p = static_cast<uint8_t *>(std::malloc(v.size()));
+  std::copy(v.begin(), v.end(), p);
+  return p;
+}
+
 std::vector<uint8_t> read_all(const std::string &path)
 {
   std::ifstream in(path, std::ios::binary);
@@ -104,4 +137,35 @@ TEST(OutputSink, CacheFileFailureIsBestEffortNotFatal)
   EXPECT_EQ(kHello, ctx.bytes);
 }
 
+// An owning callback receives the caller's buffer itself (no copy); the cache
+// file leaf of the tee is written from it first.
+TEST(OutputSink, WriteOwnedHandsBufferToOwningCallback)
+{
+  OwnedCtx owned_ctx;
+  const std::string path = temp_path("output_sink_owned.bin");
+  Sipi::TeeSink tee{ { Sipi::CallbackSink{ &capture_write, &owned_ctx, &capture_owned }, Sipi::FilePath{ path } } };
+  releases = 0;
+  uint8_t *buf = heap_copy(kHello);
+  {
+    Sipi::SinkStream stream{ tee };
+    EXPECT_EQ(0, stream.write_owned(buf, kHello.size(), &count_release));
+  }
+  EXPECT_EQ(buf, owned_ctx.received);
+  EXPECT_EQ(kHello, owned_ctx.bytes);
+  EXPECT_EQ(kHello, read_all(path));
+  EXPECT_EQ(1, releases);
+}
+
+// Without an owning callback the buffer is written like write() and released
+// by the stream.
+TEST(OutputSink, WriteOwnedFallsBackToCopyingWrite)
+{
+  CaptureCtx ctx;
+  releases = 0;
+  Sipi::SinkStream stream{ Sipi::CallbackSink{ &capture_write, &ctx } };
+  EXPECT_EQ(0, stream.write_owned(heap_copy(kWorld), kWorld.size(), &count_release));
+  EXPECT_EQ(kWorld, ctx.bytes);
+  EXPECT_EQ(1, releases);
+}
+
 }// namespace
@@ -0,0 +1,61 @@
+/*
+ * Copyright © 2016 - 2026 Swiss National Data and Service Center for the Humanities and/or DaSCH Service Platform
+ * contributors. SPDX-License-Identifier: AGPL-3.0-or-later
+ */
+
+#include "gtest/gtest.h"
+
+#include "SipiIO.h"
+#include "formats/SipiIOTiff.h"
+
+using Sipi::SubImageInfo;
+using Sipi::tiff_jpeg_scale_denom;
+
+namespace {
+
+// The smallest level of a three-level pyramid: 1/4 of a 4096×3072 image, 256×256 tiles.
+const SubImageInfo kLevel{ 4, 1024, 768, 256, 256 };
+
+}// namespace
+
+// The residual beyond the level's own ratio picks the DCT scale, capped at 1/8.
+TEST(TiffJpegScaleDenom, ResidualPicksTheScale)
+{
+  EXPECT_EQ(tiff_jpeg_scale_denom(kLevel, 2, 0, 0, 1024, 768), 1u);// the level itself
+  EXPECT_EQ(tiff_jpeg_scale_denom(kLevel, 3, 0, 0, 1024, 768), 2u);
+  EXPECT_EQ(tiff_jpeg_scale_denom(kLevel, 4, 0, 0, 1024, 768), 4u);
+  EXPECT_EQ(tiff_jpeg_scale_denom(kLevel, 5, 0, 0, 1024, 768), 8u);
+  EXPECT_EQ(tiff_jpeg_scale_denom(kLevel, 9, 0, 0, 1024, 768), 8u);
+}
+
+// Full-size requests, untiled levels and empty or out-of-range ROIs decode at 1/1.
+TEST(TiffJpegScaleDenom, NoScaleOutsideThePolicy)
+{
+  EXPECT_EQ(tiff_jpeg_scale_denom(kLevel, 0, 0, 0, 1024, 768), 1u);
+  EXPECT_EQ(tiff_jpeg_scale_denom(kLevel, -1, 0, 0, 1024, 768), 1u);
+  EXPECT_EQ(tiff_jpeg_scale_denom({ 4, 1024, 768, 0, 0 }, 5, 0, 0, 1024, 768), 1u);
+  EXPECT_EQ(tiff_jpeg_scale_denom(kLevel, 5, 0, 0, 0, 768), 1u);
+  EXPECT_EQ(tiff_jpeg_scale_denom(kLevel, 5, 512, 0, 1024, 768), 1u);
+}
+
+// A non-power-of-two level ratio leaves the integer part of the residual.
+TEST(TiffJpegScaleDenom, NonPowerOfTwoLevel)
+{
+  const SubImageInfo level{ 3, 1366, 1024, 256, 256 };
+  EXPECT_EQ(tiff_jpeg_scale_denom(level, 2, 0, 0, 1366, 1024), 1u);// 4 / 3
+  EXPECT_EQ(tiff_jpeg_scale_denom(level, 4, 0, 0, 1366, 1024), 4u);// 16 / 3 = 5 → 4
+}
+
+// The ROI origin, and an ROI end short of the level edge, must fall on the
+// scaled grid; the scale steps down until they do.
+TEST(TiffJpegScaleDenom, RoiAlignmentBoundsTheScale)
+{
+  EXPECT_EQ(tiff_jpeg_scale_denom(kLevel, 5, 256, 512, 256, 256), 8u);
+  EXPECT_EQ(tiff_jpeg_scale_denom(kLevel, 5, 4, 0, 256, 256), 4u);
+  EXPECT_EQ(tiff_jpeg_scale_denom(kLevel, 5, 2, 0, 256, 256), 2u);
+  EXPECT_EQ(tiff_jpeg_scale_denom(kLevel, 5, 1, 0, 256, 256), 1u);
+  EXPECT_EQ(tiff_jpeg_scale_denom(kLevel, 5, 0, 0, 100, 256), 4u);
+  EXPECT_EQ(tiff_jpeg_scale_denom(kLevel, 5, 0, 0, 1024, 7), 1u);
+  EXPECT_EQ(tiff_jpeg_scale_denom(kLevel, 5, 1016, 760, 8, 8), 8u);
+  EXPECT_EQ(tiff_jpeg_scale_denom(kLevel, 5, 1000, 760, 24, 8), 8u);// ends on the level edge
+}
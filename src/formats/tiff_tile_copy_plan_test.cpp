@@ -0,0 +1,88 @@
+/*
+ * Copyright © 2016 - 2026 Swiss National Data and Service Center for the Humanities and/or DaSCH Service Platform
+ * contributors. SPDX-License-Identifier: AGPL-3.0-or-later
+ */
+
+#include "gtest/gtest.h"
+
+#include "SipiIO.h"
+#include "formats/SipiIOTiff.h"
+
+using Sipi::plan_tiff_tile_copy;
+using Sipi::SubImageInfo;
+
+namespace {
+
+// A SIPI pyramid of a 1100×700 image: each level the rounded-up half of the one
+// above, all tiled 256×256.
+std::vector<SubImageInfo> sipi_pyramid()
+{
+  return {
+    { 1, 1100, 700, 256, 256 },
+    { 2, 550, 350, 256, 256 },
+    { 4, 275, 175, 256, 256 },
+    { 8, 138, 88, 256, 256 },
+  };
+}
+
+}// namespace
+
+// Interior and edge tiles at full resolution map onto level 0 unchanged.
+TEST(PlanTiffTileCopy, FullResolutionTiles)
+{
+  const auto job = plan_tiff_tile_copy(sipi_pyramid(), 256, 256, 512, 256, 0);
+  ASSERT_TRUE(job.has_value());
+  EXPECT_EQ(job->level, 0u);
+  EXPECT_EQ(job->x, 256u);
+  EXPECT_EQ(job->y, 256u);
+  EXPECT_EQ(job->w, 512u);
+  EXPECT_EQ(job->h, 256u);
+
+  const auto edge = plan_tiff_tile_copy(sipi_pyramid(), 1024, 512, 76, 188, 0);
+  ASSERT_TRUE(edge.has_value());
+  EXPECT_EQ(edge->w, 76u);
+  EXPECT_EQ(edge->h, 188u);
+}
+
+// A reduce selects the level of that ratio and maps the region into it; a
+// region reaching the image edge ends at the level edge.
+TEST(PlanTiffTileCopy, ReducedLevels)
+{
+  const auto job = plan_tiff_tile_copy(sipi_pyramid(), 512, 0, 588, 700, 1);
+  ASSERT_TRUE(job.has_value());
+  EXPECT_EQ(job->level, 1u);
+  EXPECT_EQ(job->x, 256u);
+  EXPECT_EQ(job->y, 0u);
+  EXPECT_EQ(job->w, 294u);
+  EXPECT_EQ(job->h, 350u);
+
+  const auto whole = plan_tiff_tile_copy(sipi_pyramid(), 0, 0, 1100, 700, 3);
+  ASSERT_TRUE(whole.has_value());
+  EXPECT_EQ(whole->level, 3u);
+  EXPECT_EQ(whole->w, 138u);
+  EXPECT_EQ(whole->h, 88u);
+}
+
+TEST(PlanTiffTileCopy, UnalignedRegionsNeedADecode)
+{
+  EXPECT_FALSE(plan_tiff_tile_copy(sipi_pyramid(), 10, 0, 246, 256, 0).has_value());
+  EXPECT_FALSE(plan_tiff_tile_copy(sipi_pyramid(), 0, 0, 300, 256, 0).has_value());
+  EXPECT_FALSE(plan_tiff_tile_copy(sipi_pyramid(), 256, 0, 256, 256, 1).has_value());// level x 128
+  EXPECT_FALSE(plan_tiff_tile_copy(sipi_pyramid(), 0, 0, 0, 256, 0).has_value());
+  EXPECT_FALSE(plan_tiff_tile_copy(sipi_pyramid(), 1024, 0, 256, 256, 0).has_value());
+}
+
+// No level of the exact ratio, or a level that is not the rounded-up
+// reduction, leaves the rescale to the decode path.
+TEST(PlanTiffTileCopy, LevelsMustMatchTheReduce)
+{
+  EXPECT_FALSE(plan_tiff_tile_copy(sipi_pyramid(), 0, 0, 1100, 700, 4).has_value());
+  auto odd = sipi_pyramid();
+  odd[1].width = 549;
+  EXPECT_FALSE(plan_tiff_tile_copy(odd, 0, 0, 1100, 700, 1).has_value());
+  auto untiled = sipi_pyramid();
+  untiled[0].tile_width = 0;
+  untiled[0].tile_height = 0;
+  EXPECT_FALSE(plan_tiff_tile_copy(untiled, 0, 0, 1100, 700, 0).has_value());
+  EXPECT_FALSE(plan_tiff_tile_copy({}, 0, 0, 1100, 700, 0).has_value());
+}
@@ -1,14 +1,25 @@
 #include <algorithm>
+#include <array>
 #include <atomic>
+#include <bit>
 #include <cctype>
+#include <chrono>
+#include <climits>
+#include <condition_variable>
 #include <cstdarg>
 #include <cstdio>
+#include <cstdlib>
 #include <cstring>
 #include <ctime>
 #include <iomanip>
 #include <iostream>
+#include <memory>
+#include <mutex>
 #include <sstream>
 #include <string>
+#include <string_view>
+#include <system_error>
+#include <thread>
 
 #include "logger.h"
 
@@ -226,6 +237,267 @@ std::string log_sformat(LogLevel ll, const char *message, ...)
   return r;
 }
 
+// ---- Server-mode output: rate limit, async ring, flusher ----
+
+// Per-level rate-limit windows: the current second (upper 32 bits) and the
+// lines written in it (lower 32), updated with one CAS per line.
+static std::atomic<unsigned> g_rate_limit{ 0 };
+static std::array<std::atomic<std::uint64_t>, LL_EMERG + 1> g_rate_windows{};
+static std::array<std::atomic<std::uint64_t>, LL_EMERG + 1> g_suppressed{};
+static std::array<std::atomic<std::uint64_t>, LL_EMERG + 1> g_suppressed_reported{};
+static std::atomic<std::uint64_t> g_dropped{ 0 };
+static std::atomic<std::uint64_t> g_dropped_reported{ 0 };
+
+void set_log_rate_limit(unsigned lines_per_second) { g_rate_limit.store(lines_per_second, std::memory_order_relaxed); }
+
+std::uint64_t log_suppressed_lines(LogLevel ll)
+{
+  return (ll >= LL_DEBUG && ll <= LL_EMERG) ? g_suppressed[ll].load(std::memory_order_relaxed) : 0;
+}
+
+std::uint64_t log_dropped_lines() { return g_dropped.load(std::memory_order_relaxed); }
+
+static bool rate_allows(LogLevel ll)
+{
+  const unsigned limit = g_rate_limit.load(std::memory_order_relaxed);
+  if (limit == 0 || ll >= LL_ERR || ll < LL_DEBUG) return true;
+  const auto second = static_cast<std::uint64_t>(
+    std::chrono::duration_cast<std::chrono::seconds>(std::chrono::steady_clock::now().time_since_epoch()).count())
+                      & 0xffffffffU;
+  auto &window = g_rate_windows[ll];
+  std::uint64_t cur = window.load(std::memory_order_relaxed);
+  for (;;) {
+    const bool same_second = (cur >> 32) == second;
+    if (same_second && (cur & 0xffffffffU) >= limit) {
+      g_suppressed[ll].fetch_add(1, std::memory_order_relaxed);
+      return false;
+    }
+    const std::uint64_t next = same_second ? cur + 1 : (second << 32) | 1U;
+    if (window.compare_exchange_weak(cur, next, std::memory_order_relaxed)) return true;
+  }
+}
+
+// Claim the part of `total` not yet reported against `reported`; 0 when another
+// writer claimed it first or there is nothing new.
+static std::uint64_t claim_unreported(const std::atomic<std::uint64_t> &total, std::atomic<std::uint64_t> &reported)
+{
+  const std::uint64_t now = total.load(std::memory_order_relaxed);
+  std::uint64_t prev = reported.load(std::memory_order_relaxed);
+  if (now <= prev || !reported.compare_exchange_strong(prev, now, std::memory_order_relaxed)) return 0;
+  return now - prev;
+}
+
+// The in-band reports of lines the server-mode logger did not write, as JSON
+// lines ready to precede the next batch.
+static void append_loss_reports(std::string &out)
+{
+  if (const auto dropped = claim_unreported(g_dropped, g_dropped_reported); dropped != 0) {
+    out += log_sformat(LL_WARNING, "log buffer full: %llu lines dropped", static_cast<unsigned long long>(dropped));
+  }
+  for (int ll = LL_DEBUG; ll < LL_ERR; ++ll) {
+    if (const auto n = claim_unreported(g_suppressed[ll], g_suppressed_reported[ll]); n != 0) {
+      out += log_sformat(LL_WARNING, "log rate limit: %llu %s lines suppressed", static_cast<unsigned long long>(n),
+        LogLevelToString(static_cast<LogLevel>(ll)));
+    }
+  }
+}
+
+// A write of at most PIPE_BUF bytes to a pipe is atomic, so text goes out in
+// chunks of whole lines no longer than that: another writer to the same pipe
+// (the shell's own log lines) may land between two chunks but never inside a
+// line. A single line longer than PIPE_BUF is written on its own.
+static void write_stdout(std::string_view text)
+{
+  while (!text.empty()) {
+    std::size_t n = text.size();
+    if (n > PIPE_BUF) {
+      const auto last = text.rfind('\n', PIPE_BUF - 1);
+      const auto first = last != std::string_view::npos ? last : text.find('\n');
+      n = first != std::string_view::npos ? first + 1 : text.size();
+    }
+    std::fwrite(text.data(), 1, n, stdout);
+    std::fflush(stdout);
+    text.remove_prefix(n);
+  }
+}
+
+// A bounded multi-producer / single-consumer ring of formatted lines (Vyukov's
+// bounded queue): a producer claims a slot with one CAS on `head_` and publishes
+// it through the slot's sequence number; the flusher alone advances `tail_`.
+// Neither side ever blocks on the other — a full ring fails the push instead.
+class LogRing
+{
+public:
+  explicit LogRing(std::size_t capacity)
+    : mask_(std::bit_ceil(std::max<std::size_t>(capacity, 2)) - 1), slots_(new Slot[mask_ + 1])
+  {
+    for (std::size_t i = 0; i <= mask_; ++i) slots_[i].seq.store(i, std::memory_order_relaxed);
+  }
+
+  bool try_push(std::string &&line)
+  {
+    std::uint64_t pos = head_.load(std::memory_order_relaxed);
+    for (;;) {
+      Slot &slot = slots_[pos & mask_];
+      const std::uint64_t seq = slot.seq.load(std::memory_order_acquire);
+      if (seq == pos) {
+        if (head_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+          slot.line = std::move(line);
+          slot.seq.store(pos + 1, std::memory_order_release);
+          return true;
+        }
+      } else if (seq < pos) {
+        return false;// the slot still holds the line written one lap ago: full
+      } else {
+        pos = head_.load(std::memory_order_relaxed);
+      }
+    }
+  }
+
+  // Append up to `max_bytes` of published lines to `out`; returns how many.
+  std::size_t drain(std::string &out, std::size_t max_bytes)
+  {
+    std::size_t n = 0;
+    while (out.size() < max_bytes) {
+      Slot &slot = slots_[tail_ & mask_];
+      if (slot.seq.load(std::memory_order_acquire) != tail_ + 1) break;
+      out += slot.line;
+      slot.line.clear();
+      slot.seq.store(tail_ + mask_ + 1, std::memory_order_release);
+      ++tail_;
+      ++n;
+    }
+    return n;
+  }
+
+  [[nodiscard]] std::uint64_t pushed() const { return head_.load(std::memory_order_acquire); }
+
+private:
+  struct Slot
+  {
+    std::atomic<std::uint64_t> seq;
+    std::string line;
+  };
+
+  const std::size_t mask_;
+  std::unique_ptr<Slot[]> slots_;
+  alignas(64) std::atomic<std::uint64_t> head_{ 0 };
+  alignas(64) std::uint64_t tail_{ 0 };
+};
+
+// The async logger: the ring, its flusher, and the sleep/wake handshake. The
+// mutex is only taken to sleep or wake the flusher — producers touch it only
+// while the flusher is idle, never on a busy log path.
+struct AsyncLogger
+{
+  static constexpr std::size_t kBatchBytes = 64 * 1024;
+  static constexpr auto kIdleWake = std::chrono::milliseconds(200);
+
+  explicit AsyncLogger(std::size_t capacity) : ring(capacity), flusher([this] { run(); }) {}
+
+  ~AsyncLogger()
+  {
+    {
+      const std::lock_guard lock(mutex);
+      stopping = true;
+    }
+    wake.notify_one();
+    flusher.join();
+  }
+
+  void push(std::string &&line)
+  {
+    if (!ring.try_push(std::move(line))) {
+      g_dropped.fetch_add(1, std::memory_order_relaxed);
+      return;
+    }
+    // Pairs with the fence in run(): either the flusher sees this line before
+    // it sleeps, or this sees it sleeping and wakes it.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (sleeping.load(std::memory_order_relaxed)) {
+      { const std::lock_guard lock(mutex); }
+      wake.notify_one();
+    }
+  }
+
+  void flush()
+  {
+    const std::uint64_t target = ring.pushed();
+    std::unique_lock lock(mutex);
+    wake.notify_one();
+    flushed.wait(lock, [&] { return written >= target || stopping; });
+  }
+
+  void run()
+  {
+    std::string batch;
+    batch.reserve(kBatchBytes);
+    std::uint64_t consumed = 0;
+    for (;;) {
+      batch.clear();
+      append_loss_reports(batch);
+      consumed += ring.drain(batch, kBatchBytes);
+      if (!batch.empty()) write_stdout(batch);
+      {
+        std::unique_lock lock(mutex);
+        written = consumed;
+        flushed.notify_all();
+        if (!batch.empty()) continue;
+        if (stopping) return;
+        sleeping.store(true, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (ring.pushed() == consumed) { wake.wait_for(lock, kIdleWake); }
+        sleeping.store(false, std::memory_order_relaxed);
+      }
+    }
+  }
+
+  LogRing ring;
+  std::mutex mutex;
+  std::condition_variable wake;
+  std::condition_variable flushed;
+  std::atomic<bool> sleeping{ false };
+  std::uint64_t written{ 0 };
+  bool stopping{ false };
+  std::thread flusher;
+};
+
+// Set by start_async_logging and read on every server-mode line. A line counts
+// itself in `g_async_users` before it reads the pointer and out after its push;
+// stop_async_logging clears the pointer, then waits for the count to reach zero
+// before destroying the logger. Both sides are seq_cst, so a line either sees
+// the cleared pointer (and is written synchronously) or is counted and waited
+// for (and its push is drained with the rest of the ring).
+static std::mutex g_async_mutex;
+static std::unique_ptr<AsyncLogger> g_async_owner;
+static std::atomic<AsyncLogger *> g_async{ nullptr };
+alignas(64) static std::atomic<unsigned> g_async_users{ 0 };
+
+void start_async_logging(std::size_t capacity)
+{
+  const std::lock_guard lock(g_async_mutex);
+  if (g_async_owner) return;
+  static const bool registered = std::atexit(stop_async_logging) == 0;
+  (void)registered;
+  g_async_owner = std::make_unique<AsyncLogger>(capacity);
+  g_async.store(g_async_owner.get(), std::memory_order_release);
+}
+
+void stop_async_logging()
+{
+  const std::lock_guard lock(g_async_mutex);
+  if (!g_async_owner) return;
+  g_async.store(nullptr);
+  while (g_async_users.load() != 0) std::this_thread::yield();
+  g_async_owner.reset();// the flusher drains the ring before it exits
+}
+
+void flush_logs()
+{
+  const std::lock_guard lock(g_async_mutex);
+  if (g_async_owner) g_async_owner->flush();
+}
+
 void log_vformat(LogLevel ll, const char *message, va_list args)
 {
   if (ll < g_log_level) return;
@@ -242,11 +514,23 @@ void log_vformat(LogLevel ll, const char *message, va_list args)
       fflush(stdout);
     }
   } else {
-    // Server mode: JSON format→stdout (container best practice)
-    // fflush required because stdout is fully buffered when piped
+    // Server mode: JSON format→stdout (container best practice). Formatted
+    // here, on the calling thread, so the line carries its trace context; then
+    // either queued for the flusher or — without the async logger — written
+    // and flushed (stdout is fully buffered when piped).
+    if (!rate_allows(ll)) return;
     std::string outfmt = log_vsformat(ll, message, args);
-    fprintf(stdout, "%s", outfmt.c_str());
-    fflush(stdout);
+    g_async_users.fetch_add(1);
+    if (AsyncLogger *async = g_async.load()) {
+      async->push(std::move(outfmt));
+      g_async_users.fetch_sub(1, std::memory_order_release);
+      return;
+    }
+    g_async_users.fetch_sub(1, std::memory_order_release);
+    std::string text;
+    append_loss_reports(text);
+    text += outfmt;
+    write_stdout(text);
   }
 }
 
@@ -1,6 +1,8 @@
 #ifndef LOGGER_H
 #define LOGGER_H
 
+#include <cstddef>
+#include <cstdint>
 #include <string>
 
 enum LogLevel { LL_DEBUG, LL_INFO, LL_NOTICE, LL_WARNING, LL_ERR, LL_CRIT, LL_ALERT, LL_EMERG };
@@ -65,4 +67,46 @@ void set_outbound_traceparent(const char *traceparent);
  */
 std::string get_outbound_traceparent();
 
+/*!
+ * Take server-mode log output off the logging threads. A line is still
+ * formatted by its caller (so it keeps that thread's trace context), then handed
+ * to a bounded lock-free multi-producer ring of `capacity` lines (rounded up to
+ * a power of two); one flusher thread drains it and writes each batch to stdout
+ * in whole-line writes of at most PIPE_BUF bytes, so no line interleaves with
+ * another writer on the same pipe. When the ring is full the line is dropped —
+ * the caller never blocks on a slow log pipe — and counted: the flusher writes
+ * one `log buffer full: N lines dropped` line with its next batch, and
+ * `log_dropped_lines` returns the total. Idempotent; CLI mode always logs
+ * synchronously. The ring is drained at process exit (`std::atexit`).
+ */
+void start_async_logging(std::size_t capacity = 8192);
+
+/*!
+ * Drain the ring, stop the flusher and log synchronously again. Lines logged
+ * concurrently are either queued before the drain or written synchronously.
+ * No-op when the async logger is not running.
+ */
+void stop_async_logging();
+
+/*!
+ * Block until every line logged before the call has been written. Returns at
+ * once when the async logger is not running.
+ */
+void flush_logs();
+
+/*! Lines the async logger dropped because its ring was full. */
+[[nodiscard]] std::uint64_t log_dropped_lines();
+
+/*!
+ * Rate-limit server-mode lines below LL_ERR: at most `lines_per_second` lines
+ * of each level are written per second, so a warning repeated on
+ * every request cannot flood the log pipe; errors are never limited. The
+ * excess is counted per level and reported as one `log rate limit: N <LEVEL>
+ * lines suppressed` line with the next written one. 0 (the default) disables it.
+ */
+void set_log_rate_limit(unsigned lines_per_second);
+
+/*! Lines of `ll` the rate limit suppressed. */
+[[nodiscard]] std::uint64_t log_suppressed_lines(LogLevel ll);
+
 #endif
@@ -163,6 +163,17 @@ Icc::Icc(PredefinedProfiles predef)
     profile_type = icc_ROMM_GRAY;
     break;
   }
+  case icc_GRAY_sRGB: {
+    cmsContext context = cmsCreateContext(nullptr, nullptr);
+    // IEC 61966-2-1: Y = ((X + 0.055) / 1.055)^2.4 above 0.04045, X / 12.92 below
+    const cmsFloat64Number srgb[5] = { 2.4, 1.0 / 1.055, 0.055 / 1.055, 1.0 / 12.92, 0.04045 };
+    cmsToneCurve *srgb_trc = cmsBuildParametricToneCurve(context, 4, srgb);
+    icc_profile.reset(cmsCreateGrayProfileTHR(context, cmsD50_xyY(), srgb_trc));
+    cmsFreeToneCurve(srgb_trc);
+    cmsDeleteContext(context);
+    profile_type = icc_GRAY_sRGB;
+    break;
+  }
   case icc_LAB: {
     icc_profile.reset(cmsCreateLab4Profile(NULL));
     profile_type = icc_LAB;
@@ -40,6 +40,7 @@ typedef enum {
   icc_GRAY_D50,//!< A standard profile for gray value images using a D50 light source and a gamma of 2.2
   icc_LUM_D65,//!< A standard profile for gray value images as used be JPEG2000 JP2_sLUM_SPACE
   icc_ROMM_GRAY,//!< A profile used by the JPEG2000 ISO suite....
+  icc_GRAY_sRGB,//!< A gray profile with the sRGB tone curve, for sRGB-encoded luma (D50 white, as icc_GRAY_D50)
   icc_LAB
 } PredefinedProfiles;
 
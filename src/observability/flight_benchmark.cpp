@@ -0,0 +1,72 @@
+/*
+ * Copyright © 2016 - 2026 Swiss National Data and Service Center for the Humanities and/or DaSCH Service Platform
+ * contributors. SPDX-License-Identifier: AGPL-3.0-or-later
+ */
+
+// Flight-recorder overhead — what every SIPI_ZONE* costs in a production build,
+// where Tracy compiles away and only the flight recorder's span remains. The
+// budget is < 50 ns per zone; BM_Zone is that number. BM_AttachDetach is the
+// per-request cost of collecting a pipeline's worth of zones (~32) out of the
+// ring.
+//
+// Built only via `just bench flight` (-c opt, manual-tagged cc_binary); never
+// part of `bazel test //...`. See docs/src/development/benchmarking.md.
+
+#include <benchmark/benchmark.h>
+
+#include "observability/flight_recorder.h"
+
+namespace {
+
+using Sipi::observability::FlightAttach;
+using Sipi::observability::FlightRequest;
+using Sipi::observability::FlightZone;
+
+void BM_ClockRead(benchmark::State &state)
+{
+  // The precise steady clock: read at a request's start and finish only.
+  for (auto _ : state) { benchmark::DoNotOptimize(Sipi::observability::flight_clock_ns()); }
+}
+BENCHMARK(BM_ClockRead);
+
+void BM_ZoneClockRead(benchmark::State &state)
+{
+  // The floor: one zone is two of these plus a ring store.
+  for (auto _ : state) { benchmark::DoNotOptimize(Sipi::observability::flight_zone_clock_ns()); }
+}
+BENCHMARK(BM_ZoneClockRead);
+
+void BM_Zone(benchmark::State &state)
+{
+  for (auto _ : state) {
+    FlightZone zone("BM_Zone");
+    benchmark::ClobberMemory();
+  }
+}
+BENCHMARK(BM_Zone);
+
+void BM_ZoneAcrossThreads(benchmark::State &state)
+{
+  // Rings are per thread: concurrent zones share no cache line.
+  for (auto _ : state) {
+    FlightZone zone("BM_ZoneAcrossThreads");
+    benchmark::ClobberMemory();
+  }
+}
+BENCHMARK(BM_ZoneAcrossThreads)->Threads(4);
+
+void BM_AttachDetach(benchmark::State &state)
+{
+  const auto zones = state.range(0);
+  for (auto _ : state) {
+    FlightRequest request;
+    {
+      FlightAttach attach(request);
+      for (int64_t i = 0; i < zones; ++i) { FlightZone zone("BM_AttachDetach"); }
+    }
+    benchmark::DoNotOptimize(request.spans().data());
+  }
+}
+BENCHMARK(BM_AttachDetach)->Arg(32);
+
+}// namespace
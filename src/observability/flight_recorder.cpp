@@ -0,0 +1,214 @@
+/*
+ * Copyright © 2016 - 2026 Swiss National Data and Service Center for the Humanities and/or DaSCH Service Platform
+ * contributors. SPDX-License-Identifier: AGPL-3.0-or-later
+ */
+
+#include "flight_recorder.h"
+
+#include <algorithm>
+#include <array>
+#include <cstdio>
+#include <new>
+
+namespace Sipi::observability {
+
+namespace {
+  static_assert((kFlightRingSize & (kFlightRingSize - 1)) == 0, "the ring index is masked");
+
+  // The calling thread's last kFlightRingSize zones; `next` counts every zone
+  // the thread ever closed, so a mark taken from it outlives a wrap-around.
+  struct Ring
+  {
+    std::array<FlightSpan, kFlightRingSize> slots;
+    std::uint64_t next;
+  };
+
+  thread_local Ring g_ring{};
+  thread_local FlightRequest *g_attached = nullptr;
+
+  void append_json_string(std::string &out, std::string_view s)
+  {
+    out += '"';
+    for (const char c : s) {
+      switch (c) {
+      case '"':
+        out += "\\\"";
+        break;
+      case '\\':
+        out += "\\\\";
+        break;
+      case '\n':
+        out += "\\n";
+        break;
+      case '\r':
+        out += "\\r";
+        break;
+      case '\t':
+        out += "\\t";
+        break;
+      default:
+        if (static_cast<unsigned char>(c) < 0x20) {
+          char buf[8];
+          std::snprintf(buf, sizeof(buf), "\\u%04x", static_cast<unsigned>(c));
+          out += buf;
+        } else {
+          out += c;
+        }
+      }
+    }
+    out += '"';
+  }
+
+  std::uint64_t since(std::uint64_t origin, std::uint64_t t) { return t > origin ? t - origin : 0; }
+}// namespace
+
+void flight_record(const char *zone, std::uint64_t start_ns, std::uint64_t end_ns) noexcept
+{
+  Ring &ring = g_ring;
+  ring.slots[ring.next & (kFlightRingSize - 1)] = FlightSpan{ zone, start_ns, end_ns };
+  ++ring.next;
+}
+
+void FlightRequest::set(std::string_view key, std::string value, bool numeric)
+{
+  for (auto &n : notes_) {
+    if (n.key == key) {
+      n.value = std::move(value);
+      n.numeric = numeric;
+      return;
+    }
+  }
+  notes_.push_back(Note{ std::string(key), std::move(value), numeric });
+}
+
+void FlightRequest::note(std::string_view key, std::string value) { set(key, std::move(value), false); }
+
+void FlightRequest::note(std::string_view key, std::uint64_t value) { set(key, std::to_string(value), true); }
+
+FlightAttach::FlightAttach(FlightRequest &request) noexcept
+  : request_(request), previous_(g_attached), mark_(g_ring.next)
+{
+  g_attached = &request;
+}
+
+FlightAttach::~FlightAttach()
+{
+  const Ring &ring = g_ring;
+  const std::uint64_t closed = ring.next - mark_;
+  const std::uint64_t kept = std::min<std::uint64_t>(closed, kFlightRingSize);
+  request_.dropped_ += closed - kept;
+  try {
+    request_.spans_.reserve(request_.spans_.size() + kept);
+    for (std::uint64_t i = ring.next - kept; i != ring.next; ++i) {
+      request_.spans_.push_back(ring.slots[i & (kFlightRingSize - 1)]);
+    }
+  } catch (const std::bad_alloc &) {
+    request_.dropped_ += kept;
+  }
+  g_attached = previous_;
+}
+
+void flight_note(std::string_view key, std::string value)
+{
+  if (g_attached != nullptr) { g_attached->note(key, std::move(value)); }
+}
+
+void flight_note(std::string_view key, std::uint64_t value)
+{
+  if (g_attached != nullptr) { g_attached->note(key, value); }
+}
+
+FlightRecorder::FlightRecorder(std::uint32_t threshold_ms, std::size_t capacity)
+  : threshold_ms_(threshold_ms), capacity_(std::max<std::size_t>(capacity, 1))
+{}
+
+FlightRecorder &FlightRecorder::instance()
+{
+  static FlightRecorder recorder;
+  return recorder;
+}
+
+void FlightRecorder::set_threshold_ms(std::uint32_t ms) { threshold_ms_.store(ms, std::memory_order_relaxed); }
+
+std::uint32_t FlightRecorder::threshold_ms() const { return threshold_ms_.load(std::memory_order_relaxed); }
+
+bool FlightRecorder::finish(FlightRequest &&request, std::string *summary)
+{
+  const std::uint32_t threshold = threshold_ms();
+  const std::uint64_t duration = since(request.start_ns_, flight_clock_ns());
+  if (threshold == 0 || duration < std::uint64_t{ threshold } * 1'000'000U) { return false; }
+
+  const auto finished = std::chrono::duration_cast<std::chrono::milliseconds>(
+    std::chrono::system_clock::now().time_since_epoch());
+  // The ring keeps zones in the order they closed; a capture lists them by start.
+  std::ranges::sort(request.spans_, {}, &FlightSpan::start_ns);
+  Capture capture{ duration, finished.count(), std::move(request) };
+  if (summary != nullptr) {
+    summary->clear();
+    append_summary(*summary, capture);
+  }
+
+  const std::lock_guard lock(mutex_);
+  if (captures_.size() == capacity_) { captures_.pop_front(); }
+  captures_.push_back(std::move(capture));
+  return true;
+}
+
+void FlightRecorder::append_json(std::string &out, const Capture &capture)
+{
+  out += "{\"finished_unix_ms\":" + std::to_string(capture.finished_unix_ms);
+  out += ",\"duration_ns\":" + std::to_string(capture.duration_ns);
+  out += ",\"dropped_zones\":" + std::to_string(capture.request.dropped_);
+  out += ",\"notes\":{";
+  bool first = true;
+  for (const auto &n : capture.request.notes_) {
+    if (!first) { out += ','; }
+    first = false;
+    append_json_string(out, n.key);
+    out += ':';
+    if (n.numeric) {
+      out += n.value;
+    } else {
+      append_json_string(out, n.value);
+    }
+  }
+  out += "},\"zones\":[";
+  first = true;
+  for (const auto &span : capture.request.spans_) {
+    if (!first) { out += ','; }
+    first = false;
+    out += "{\"zone\":";
+    append_json_string(out, span.zone != nullptr ? span.zone : "");
+    out += ",\"start_ns\":" + std::to_string(since(capture.request.start_ns_, span.start_ns));
+    out += ",\"duration_ns\":" + std::to_string(since(span.start_ns, span.end_ns)) + '}';
+  }
+  out += "]}";
+}
+
+void FlightRecorder::append_summary(std::string &out, const Capture &capture)
+{
+  out += "duration_ms=" + std::to_string(capture.duration_ns / 1'000'000U);
+  out += " zones=" + std::to_string(capture.request.spans_.size());
+  out += " dropped_zones=" + std::to_string(capture.request.dropped_);
+  for (const std::string_view key : { "status", "route", "uri" }) {
+    for (const auto &n : capture.request.notes_) {
+      if (n.key == key) { out += ' ' + n.key + '=' + n.value; }
+    }
+  }
+}
+
+std::string FlightRecorder::to_json() const
+{
+  std::string out = "{\"threshold_ms\":" + std::to_string(threshold_ms()) + ",\"captures\":[";
+  const std::lock_guard lock(mutex_);
+  bool first = true;
+  for (const auto &c : captures_) {
+    if (!first) { out += ','; }
+    first = false;
+    append_json(out, c);
+  }
+  out += "]}";
+  return out;
+}
+
+}// namespace Sipi::observability
@@ -0,0 +1,197 @@
+/*
+ * Copyright © 2016 - 2026 Swiss National Data and Service Center for the Humanities and/or DaSCH Service Platform
+ * contributors. SPDX-License-Identifier: AGPL-3.0-or-later
+ */
+
+#ifndef SIPI_OBSERVABILITY_FLIGHT_RECORDER_H
+#define SIPI_OBSERVABILITY_FLIGHT_RECORDER_H
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <time.h>
+#include <utility>
+#include <vector>
+
+namespace Sipi::observability {
+
+/*!
+ * Always-on flight recorder for slow requests.
+ *
+ * Tracy zones exist only in `--config=tracy` builds. In every build the same
+ * SIPI_ZONE* macros (profiling.h) also time their scope into the calling
+ * thread's ring of its last kFlightRingSize zones: the zone's name literal as
+ * its id, and its start and end in nanoseconds on the coarse zone clock. A
+ * zone costs two coarse clock reads and one ring slot — no lock, no allocation.
+ * Request boundaries keep the precise steady clock, so the threshold is exact.
+ *
+ * A request being recorded (`FlightRequest`) is attached to the thread that
+ * runs it (`FlightAttach`); the pipeline notes its decisions into it
+ * (`flight_note`), and on detach the zones the thread closed meanwhile are
+ * copied out of the ring. `FlightRecorder::finish` keeps a request that took at
+ * least the threshold, with its zones and notes, among the most recent slow
+ * requests, which `to_json` renders for `sipi_flight_captures`; the seam also
+ * logs a one-line summary of each one as it is kept.
+ */
+
+inline constexpr std::size_t kFlightRingSize = 512;
+
+/// One closed zone: `zone` is the name literal the macro was given.
+struct FlightSpan
+{
+  const char *zone;
+  std::uint64_t start_ns;
+  std::uint64_t end_ns;
+};
+
+/// The steady clock in nanoseconds — the timeline of every zone and request.
+[[nodiscard]] inline std::uint64_t flight_clock_ns() noexcept
+{
+  return static_cast<std::uint64_t>(
+    std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch())
+      .count());
+}
+
+/*! The zone clock: the steady clock's timeline read at the kernel tick's
+ *  resolution (CLOCK_MONOTONIC_COARSE, 1-4 ms on Linux). A precise read is a
+ *  large share of the per-zone budget, and a zone worth finding in a request
+ *  slower than the threshold spans many ticks; shorter ones read as 0 ns. */
+[[nodiscard]] inline std::uint64_t flight_zone_clock_ns() noexcept
+{
+#if defined(__APPLE__)
+  return clock_gettime_nsec_np(CLOCK_UPTIME_RAW_APPROX);
+#elif defined(CLOCK_MONOTONIC_COARSE)
+  timespec ts{};
+  clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+  return static_cast<std::uint64_t>(ts.tv_sec) * 1'000'000'000U + static_cast<std::uint64_t>(ts.tv_nsec);
+#else
+  return flight_clock_ns();
+#endif
+}
+
+/// Append a closed zone to the calling thread's ring.
+void flight_record(const char *zone, std::uint64_t start_ns, std::uint64_t end_ns) noexcept;
+
+/// Times the enclosing scope into the calling thread's ring (SIPI_ZONE*).
+class FlightZone
+{
+public:
+  explicit FlightZone(const char *zone) noexcept : zone_(zone), start_ns_(flight_zone_clock_ns()) {}
+  ~FlightZone() { flight_record(zone_, start_ns_, flight_zone_clock_ns()); }
+
+  FlightZone(const FlightZone &) = delete;
+  FlightZone &operator=(const FlightZone &) = delete;
+
+private:
+  const char *zone_;
+  std::uint64_t start_ns_;
+};
+
+/*! One request's recording: its zones, collected from each thread it ran on,
+ *  and the decisions the pipeline noted. Movable while detached. */
+class FlightRequest
+{
+public:
+  FlightRequest() : start_ns_(flight_clock_ns()) {}
+
+  /// Note a pipeline decision; a repeated key keeps its last value.
+  void note(std::string_view key, std::string value);
+  void note(std::string_view key, std::uint64_t value);
+
+  [[nodiscard]] std::uint64_t start_ns() const { return start_ns_; }
+  [[nodiscard]] const std::vector<FlightSpan> &spans() const { return spans_; }
+
+  /// Zones that closed while attached but had left the ring before the detach.
+  [[nodiscard]] std::uint64_t dropped() const { return dropped_; }
+
+private:
+  friend class FlightAttach;
+  friend class FlightRecorder;
+
+  struct Note
+  {
+    std::string key;
+    std::string value;
+    bool numeric;
+  };
+
+  void set(std::string_view key, std::string value, bool numeric);
+
+  std::uint64_t start_ns_;
+  std::vector<FlightSpan> spans_;
+  std::vector<Note> notes_;
+  std::uint64_t dropped_{ 0 };
+};
+
+/*! Attaches `request` to the calling thread for the scope's lifetime: the zones
+ *  the thread closes meanwhile are copied into it on exit, and `flight_note`
+ *  writes to it. Scopes nest, restoring the outer one on exit. */
+class FlightAttach
+{
+public:
+  explicit FlightAttach(FlightRequest &request) noexcept;
+  ~FlightAttach();
+
+  FlightAttach(const FlightAttach &) = delete;
+  FlightAttach &operator=(const FlightAttach &) = delete;
+
+private:
+  FlightRequest &request_;
+  FlightRequest *previous_;
+  std::uint64_t mark_;
+};
+
+/// Note a decision into the request attached to the calling thread; a no-op without one.
+void flight_note(std::string_view key, std::string value);
+void flight_note(std::string_view key, std::uint64_t value);
+
+/*! The most recent slow requests. Thread-safe; `finish` takes a short lock only
+ *  for a request it keeps. */
+class FlightRecorder
+{
+public:
+  static constexpr std::uint32_t kDefaultThresholdMs = 1000;
+  static constexpr std::size_t kDefaultCapacity = 32;
+
+  explicit FlightRecorder(std::uint32_t threshold_ms = kDefaultThresholdMs, std::size_t capacity = kDefaultCapacity);
+
+  static FlightRecorder &instance();
+
+  /// Requests at least this long are kept; 0 keeps none.
+  void set_threshold_ms(std::uint32_t ms);
+  [[nodiscard]] std::uint32_t threshold_ms() const;
+
+  /// End `request` now and keep it if it was slow; returns whether it was kept.
+  /// A kept request is also summarized into `*summary` when given — duration,
+  /// zone count and the status/route/uri notes on one short line; the zones
+  /// themselves stay with `to_json`.
+  bool finish(FlightRequest &&request, std::string *summary = nullptr);
+
+  /// The kept requests, oldest first, as one JSON document.
+  [[nodiscard]] std::string to_json() const;
+
+private:
+  struct Capture
+  {
+    std::uint64_t duration_ns;
+    std::int64_t finished_unix_ms;
+    FlightRequest request;
+  };
+
+  static void append_json(std::string &out, const Capture &capture);
+  static void append_summary(std::string &out, const Capture &capture);
+
+  mutable std::mutex mutex_;
+  std::atomic<std::uint32_t> threshold_ms_;
+  std::size_t capacity_;
+  std::deque<Capture> captures_;
+};
+
+}// namespace Sipi::observability
+
+#endif// SIPI_OBSERVABILITY_FLIGHT_RECORDER_H
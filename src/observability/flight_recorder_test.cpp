@@ -0,0 +1,142 @@
+/*
+ * Copyright © 2026 Swiss National Data and Service Center for the Humanities
+ * and/or DaSCH Service Platform contributors. SPDX-License-Identifier:
+ * AGPL-3.0-or-later
+ */
+
+#include "observability/flight_recorder.h"
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <thread>
+
+#include "gtest/gtest.h"
+
+namespace {
+
+using Sipi::observability::FlightAttach;
+using Sipi::observability::FlightRecorder;
+using Sipi::observability::FlightRequest;
+using Sipi::observability::FlightZone;
+using Sipi::observability::flight_note;
+using Sipi::observability::kFlightRingSize;
+
+TEST(FlightRecorder, AttachCollectsOnlyTheZonesClosedWhileAttached)
+{
+  { FlightZone before("before"); }
+  FlightRequest request;
+  {
+    FlightAttach attach(request);
+    {
+      const FlightZone outer("outer");
+      const FlightZone inner("inner");
+    }
+    flight_note("route", std::string("decode"));
+    flight_note("reduce", std::uint64_t{ 2 });
+  }
+  { FlightZone after("after"); }
+  flight_note("route", std::string("detached"));
+
+  ASSERT_EQ(request.spans().size(), 2U);
+  EXPECT_STREQ(request.spans()[0].zone, "inner");
+  EXPECT_STREQ(request.spans()[1].zone, "outer");
+  EXPECT_LE(request.spans()[1].start_ns, request.spans()[0].start_ns);
+  EXPECT_EQ(request.dropped(), 0U);
+}
+
+TEST(FlightRecorder, RingOverflowCountsDroppedZones)
+{
+  FlightRequest request;
+  {
+    FlightAttach attach(request);
+    for (std::size_t i = 0; i < kFlightRingSize + 10; ++i) { FlightZone zone("z"); }
+  }
+  EXPECT_EQ(request.spans().size(), kFlightRingSize);
+  EXPECT_EQ(request.dropped(), 10U);
+}
+
+TEST(FlightRecorder, ARequestCollectsZonesFromEachThreadItRanOn)
+{
+  FlightRequest request;
+  {
+    FlightAttach attach(request);
+    FlightZone plan("plan");
+  }
+  std::thread([&request] {
+    FlightAttach attach(request);
+    FlightZone execute("execute");
+  }).join();
+  ASSERT_EQ(request.spans().size(), 2U);
+  EXPECT_STREQ(request.spans()[0].zone, "plan");
+  EXPECT_STREQ(request.spans()[1].zone, "execute");
+}
+
+TEST(FlightRecorder, KeepsOnlySlowRequestsUpToCapacity)
+{
+  FlightRecorder recorder(1, 2);
+  EXPECT_FALSE(recorder.finish(FlightRequest{}));
+
+  for (int i = 0; i < 3; ++i) {
+    FlightRequest request;
+    request.note("n", static_cast<std::uint64_t>(i));
+    std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    EXPECT_TRUE(recorder.finish(std::move(request)));
+  }
+  const std::string json = recorder.to_json();
+  EXPECT_EQ(json.find("\"n\":0"), std::string::npos);
+  EXPECT_NE(json.find("\"n\":1"), std::string::npos);
+  EXPECT_NE(json.find("\"n\":2"), std::string::npos);
+
+  recorder.set_threshold_ms(0);
+  FlightRequest slow;
+  std::this_thread::sleep_for(std::chrono::milliseconds(2));
+  EXPECT_FALSE(recorder.finish(std::move(slow)));
+}
+
+TEST(FlightRecorder, JsonCarriesZonesAndEscapedNotes)
+{
+  FlightRecorder recorder(1, 4);
+  FlightRequest request;
+  {
+    FlightAttach attach(request);
+    FlightZone zone("SipiImage::read");
+    flight_note("uri", std::string("a \"quoted\"\\path"));
+    flight_note("estimate_bytes", std::uint64_t{ 4096 });
+  }
+  std::this_thread::sleep_for(std::chrono::milliseconds(2));
+  ASSERT_TRUE(recorder.finish(std::move(request)));
+
+  const std::string json = recorder.to_json();
+  EXPECT_EQ(json.rfind("{\"threshold_ms\":1,\"captures\":[{", 0), 0U);
+  EXPECT_NE(json.find(R"("uri":"a \"quoted\"\\path")"), std::string::npos);
+  EXPECT_NE(json.find(R"("estimate_bytes":4096)"), std::string::npos);
+  EXPECT_NE(json.find(R"({"zone":"SipiImage::read","start_ns":)"), std::string::npos);
+  EXPECT_NE(json.find(R"("dropped_zones":0)"), std::string::npos);
+}
+
+TEST(FlightRecorder, KeptRequestIsSummarizedOnOneLine)
+{
+  FlightRecorder recorder(1, 4);
+  std::string summary = "untouched";
+  EXPECT_FALSE(recorder.finish(FlightRequest{}, &summary));
+  EXPECT_EQ(summary, "untouched");
+
+  FlightRequest request;
+  {
+    FlightAttach attach(request);
+    for (int i = 0; i < 100; ++i) { FlightZone zone("SipiImage::read"); }
+    flight_note("uri", std::string("/iiif/3/x.jp2/full/max/0/default.jpg"));
+    flight_note("route", std::string("decode"));
+    flight_note("status", std::uint64_t{ 200 });
+  }
+  std::this_thread::sleep_for(std::chrono::milliseconds(2));
+  ASSERT_TRUE(recorder.finish(std::move(request), &summary));
+  EXPECT_EQ(summary.rfind("duration_ms=", 0), 0U);
+  EXPECT_NE(summary.find(" zones=100 dropped_zones=0 status=200 route=decode uri=/iiif/3/x.jp2/"), std::string::npos);
+  // The zones themselves stay in the capture document.
+  EXPECT_EQ(summary.find("SipiImage::read"), std::string::npos);
+  EXPECT_NE(recorder.to_json().find("SipiImage::read"), std::string::npos);
+}
+
+}// namespace
@@ -103,6 +103,15 @@ public:
   // 503. Engine-internal until bridged through SipiMetricsSnapshot.
   Counter decode_memory_too_large_total;       // advanced: 413 returned
   Counter decode_memory_shadow_too_large_total;// basic: would-be 413 (shadow-counted)
+  // Advanced-mode wait queue (SipiMemoryBudget::acquire): requests queued now,
+  // requests admitted after waiting, and their total wait in microseconds.
+  Gauge decode_memory_waiting;
+  Counter decode_memory_waited_total;
+  Counter decode_memory_wait_microseconds_total;
+  // Peak-memory calibration (SipiPeakCalibration.h): measured decodes recorded,
+  // and the largest fitted correction factor, in percent of the static estimate.
+  Counter decode_memory_calibration_samples_total;
+  Gauge decode_memory_calibration_factor_max_percent;
 
   // read_shape fast path (ADR-0004 / DEV-6537).
   // Format = {jp2, tiff}; outcome = {hit, miss, partial, fallback}.
@@ -142,6 +151,28 @@ public:
   // snapshot bridge to OTLP.
   Counter tiff_pyramid_reduced_decodes_total;
 
+  // Shadow pyramids (ffi/shadow_pyramids.h): decodes of a flat source served
+  // from its pyramidal sidecar, sidecars built, and builds deferred because the
+  // full-lane budget had no room for them.
+  Counter shadow_pyramid_hits_total;
+  Counter shadow_pyramid_builds_total;
+  Counter shadow_pyramid_deferred_total;
+
+  // Decodes abandoned because the client left: aborted mid-decode at a codec
+  // cancellation checkpoint (decode_cancel.h), and the decode time — in
+  // microseconds — spent on requests whose client left before the encode.
+  Counter decode_cancelled_total;
+  Counter decode_wasted_microseconds_total;
+
+  // Requests rendered cheaper than asked to meet their deadline (ffi/degraded_render.h).
+  Counter decode_degraded_total;
+
+  // Decode amplification (ffi/decode_amplification.h): pixels the codecs
+  // decoded, and pixels the same decodes rendered; the ratio of the two is the
+  // fleet-wide amplification.
+  Counter decoded_pixels_total;
+  Counter decode_output_pixels_total;
+
 private:
   Metrics() = default;
 };
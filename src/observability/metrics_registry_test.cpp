@@ -33,7 +33,7 @@
 namespace {
 
 // Fields whose values reach production OTLP, via `SipiMetricsSnapshot` and the
-// COUNTERS/GAUGES tables in `server-rs/src/metrics.rs`. Exactly the 21 members
+// COUNTERS/GAUGES tables in `server-rs/src/metrics.rs`. Exactly the 32 members
 // `sipi_metrics_snapshot` reads.
 const std::set<std::string> kBridgedToOtlp = {
   "cache_hits_total",
@@ -50,6 +50,17 @@ const std::set<std::string> kBridgedToOtlp = {
   "decode_memory_too_large_total",
   "decode_memory_shadow_too_large_total",
   "tiff_pyramid_reduced_decodes_total",
+  "shadow_pyramid_hits_total",
+  "shadow_pyramid_builds_total",
+  "shadow_pyramid_deferred_total",
+  "decode_cancelled_total",
+  "decode_wasted_microseconds_total",
+  "decode_degraded_total",
+  "decode_memory_waited_total",
+  "decode_memory_wait_microseconds_total",
+  "decode_memory_calibration_samples_total",
+  "decoded_pixels_total",
+  "decode_output_pixels_total",
   "waiting_connections",
   "cache_size_bytes",
   "cache_files",
@@ -57,6 +68,8 @@ const std::set<std::string> kBridgedToOtlp = {
   "cache_files_limit",
   "decode_memory_budget_bytes",
   "decode_memory_used_bytes",
+  "decode_memory_waiting",
+  "decode_memory_calibration_factor_max_percent",
 };
 
 // Engine-internal counters the snapshot deliberately does NOT carry: the two
@@ -89,10 +102,13 @@ const std::set<std::string> kEngineInternalNotBridged = {
 
 TEST(SipiMetricsSeam, BridgedSetMatchesTheSnapshotFieldCount)
 {
-  // The snapshot reads exactly 21 scalar members (7 counters + 6 decode-memory
-  // counters + tiff_pyramid + 7 gauges). The `SipiMetricsSnapshot` layout asserts
-  // lock the struct; this pins the classification's view of it.
-  EXPECT_EQ(kBridgedToOtlp.size(), 21U)
+  // The snapshot reads exactly 34 scalar members (7 counters + 6 decode-memory
+  // counters + tiff_pyramid + 3 shadow_pyramid + 2 decode-cancellation +
+  // decode_degraded + 2 decode-memory wait + calibration samples + 2 decode
+  // amplification + 9 gauges). The `SipiMetricsSnapshot` layout asserts lock
+  // the struct; this pins the classification's view of it. The snapshot's two
+  // log-line counters come from the logger, not this singleton.
+  EXPECT_EQ(kBridgedToOtlp.size(), 34U)
     << "The bridged-to-OTLP set changed. If you added/removed a snapshot field, "
        "update ffi/metrics_snapshot.h + server-rs/src/metrics.rs to match.";
 }
@@ -12,15 +12,31 @@
 // docs/src/development/profiling.md). In every other build
 // <tracy/Tracy.hpp> defines its own macros as no-ops, so SIPI_ZONE* compile to
 // nothing — zero overhead, nothing to strip.
+//
+// The zone macros additionally feed the always-on slow-request flight recorder
+// (flight_recorder.h) in every build: each zone is timed into its thread's ring
+// under its name — the function name for SIPI_ZONE() — at the cost of two clock
+// reads (`just bench flight`).
 #include <tracy/Tracy.hpp>
 
+#include "flight_recorder.h"
+
+#define SIPI_FLIGHT_CONCAT_(a, b) a##b
+#define SIPI_FLIGHT_CONCAT(a, b) SIPI_FLIGHT_CONCAT_(a, b)
+#define SIPI_FLIGHT_ZONE(name)                                                                  \
+  const ::Sipi::observability::FlightZone SIPI_FLIGHT_CONCAT(sipi_flight_zone_, __LINE__)(name)
+
 // Profile the enclosing scope; the zone is labelled with the function name.
-#define SIPI_ZONE() ZoneScoped
+#define SIPI_ZONE() \
+  ZoneScoped;       \
+  SIPI_FLIGHT_ZONE(__func__)
 
 // Profile the enclosing scope under an explicit name. Prefer this where the
 // function name alone is ambiguous (e.g. the four format handlers' read()/
 // write(), which would otherwise all show up as "read"/"write").
-#define SIPI_ZONE_N(name) ZoneScopedN(name)
+#define SIPI_ZONE_N(name) \
+  ZoneScopedN(name);      \
+  SIPI_FLIGHT_ZONE(name)
 
 // Mark the end of one logical unit of work (one IIIF request) for Tracy's
 // per-frame throughput view.
@@ -43,6 +43,7 @@ std::string predefined_profile_to_string(PredefinedProfiles p)
   case icc_GRAY_D50: return "Gray D50";
   case icc_LUM_D65: return "Luminance D65";
   case icc_ROMM_GRAY: return "ROMM Gray";
+  case icc_GRAY_sRGB: return "Gray sRGB";
   case icc_LAB: return "L*a*b*";
   default: return "unknown";
   }
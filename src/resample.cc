@@ -8,14 +8,27 @@
  * per column) and stays scalar. Accumulation is int32 fixed-point, so the result
  * is bit-identical to the scalar reference and across every SIMD target — see
  * resample.h and test/unit/sipiimage/scale_resample_test.cpp.
+ *
+ * Both passes poll for a cancelled decode every kDecodeCancelRows rows
+ * (decode_cancel.h), so a gone client stops a large downscale part-way.
+ *
+ * The pyramid 2×2 box reduction (box_reduce_2x2_*) lives here too: its
+ * four-tap sum is contiguous per sample and vectorizes the same way.
+ *
+ * The per-axis weight builder and the row-streaming StreamingResampler (scalar,
+ * compiled once) live in the HWY_ONCE section at the bottom.
  */
 
 #include "resample.h"
 
 #include <algorithm>
+#include <cmath>
+#include <cstring>
 #include <limits>
 #include <vector>
 
+#include "decode_cancel.h"
+
 // Disable every 512-bit target (all AVX3 variants + AVX10.2): under this
 // hermetic-clang toolchain the per-target attribute push does not enable
 // `avx512f` for those namespaces, so their intrinsics fail to inline. SSE4 +
@@ -52,6 +65,7 @@ HWY_ATTR void ResampleSeparable(const T *in, size_t nx, size_t ny, size_t nc, si
   // sample range. Scalar — the tap set varies per output column.
   std::vector<int32_t> tmp(ny * row_len);
   for (size_t y = 0; y < ny; ++y) {
+    if (y % kDecodeCancelRows == 0) { check_decode_cancelled(); }
     const T *row = in + y * nx * nc;
     int32_t *orow = tmp.data() + y * row_len;
     for (size_t i = 0; i < nnx; ++i) {
@@ -75,6 +89,7 @@ HWY_ATTR void ResampleSeparable(const T *in, size_t nx, size_t ny, size_t nc, si
   // tolerates it — which is why ARM-only local runs did not catch this).
   std::vector<int32_t> acc(row_len);
   for (size_t j = 0; j < nny; ++j) {
+    if (j % kDecodeCancelRows == 0) { check_decode_cancelled(); }
     size_t f = 0;
     for (; f + N <= row_len; f += N) { hn::StoreU(vround, d, acc.data() + f); }
     for (; f < row_len; ++f) { acc[f] = round; }
@@ -116,6 +131,62 @@ HWY_ATTR void ResampleU16(const uint16_t *in, size_t nx, size_t ny, size_t nc, s
   ResampleSeparable<uint16_t>(in, nx, ny, nc, nnx, nny, hoff, hidx, hwt, voff, vidx, vwt, out);
 }
 
+// 2×2 box reduction (one pyramid level). The four-tap sum
+// r0[j] + r0[j+nc] + r1[j] + r1[j+nc] is contiguous in the sample index j, so
+// it vectorizes as four unaligned loads widened to W; only the sums at even
+// pixels are kept, compacted into the output row with one memcpy per pixel. A
+// missing right column or bottom row is replaced by the edge itself, which
+// gives exactly the rounded mean of the samples that exist.
+template<typename T, typename W>
+HWY_ATTR void BoxReduce2x2(const T *in, size_t nx, size_t ny, size_t nc, T *out)
+{
+  const size_t nnx = (nx + 1) / 2;
+  const size_t nny = (ny + 1) / 2;
+  const size_t row_len = nx * nc;
+  const size_t span = nx >= 2 ? (nx - 1) * nc : 0;// samples with a right-hand neighbour
+
+  const hn::ScalableTag<W> dw;
+  const hn::Rebind<T, decltype(dw)> dn;
+  const size_t N = hn::Lanes(dw);
+  const auto vtwo = hn::Set(dw, static_cast<W>(2));
+
+  std::vector<T> sums(span);
+  for (size_t y = 0; y < nny; ++y) {
+    const T *r0 = in + 2 * y * row_len;
+    const T *r1 = 2 * y + 1 < ny ? r0 + row_len : r0;
+    size_t j = 0;
+    for (; j + N <= span; j += N) {
+      auto s = hn::Add(hn::PromoteTo(dw, hn::LoadU(dn, r0 + j)), hn::PromoteTo(dw, hn::LoadU(dn, r0 + j + nc)));
+      s = hn::Add(s, hn::PromoteTo(dw, hn::LoadU(dn, r1 + j)));
+      s = hn::Add(s, hn::PromoteTo(dw, hn::LoadU(dn, r1 + j + nc)));
+      hn::StoreU(hn::DemoteTo(dn, hn::ShiftRight<2>(hn::Add(s, vtwo))), dn, sums.data() + j);
+    }
+    for (; j < span; ++j) {
+      const W s = static_cast<W>(r0[j]) + r0[j + nc] + r1[j] + r1[j + nc];
+      sums[j] = static_cast<T>((s + 2) >> 2);
+    }
+
+    T *orow = out + y * nnx * nc;
+    for (size_t x = 0; x < nx / 2; ++x) { std::memcpy(orow + x * nc, sums.data() + 2 * x * nc, nc * sizeof(T)); }
+    if (nx % 2 == 1) {
+      const size_t last = (nx - 1) * nc;
+      for (size_t c = 0; c < nc; ++c) {
+        orow[(nnx - 1) * nc + c] = static_cast<T>((static_cast<W>(r0[last + c]) + r1[last + c] + 1) >> 1);
+      }
+    }
+  }
+}
+
+HWY_ATTR void BoxReduceU8(const uint8_t *in, size_t nx, size_t ny, size_t nc, uint8_t *out)
+{
+  BoxReduce2x2<uint8_t, uint16_t>(in, nx, ny, nc, out);
+}
+
+HWY_ATTR void BoxReduceU16(const uint16_t *in, size_t nx, size_t ny, size_t nc, uint16_t *out)
+{
+  BoxReduce2x2<uint16_t, uint32_t>(in, nx, ny, nc, out);
+}
+
 }// namespace HWY_NAMESPACE
 }// namespace Sipi
 HWY_AFTER_NAMESPACE();
@@ -142,5 +213,154 @@ void resample_separable_u16(const uint16_t *in, size_t nx, size_t ny, size_t nc,
   (in, nx, ny, nc, nnx, nny, hoff, hidx, hwt, voff, vidx, vwt, out);
 }
 
+HWY_EXPORT(BoxReduceU8);
+HWY_EXPORT(BoxReduceU16);
+
+void box_reduce_2x2_u8(const uint8_t *in, size_t nx, size_t ny, size_t nc, uint8_t *out)
+{
+  HWY_DYNAMIC_DISPATCH(BoxReduceU8)
+  (in, nx, ny, nc, out);
+}
+
+void box_reduce_2x2_u16(const uint16_t *in, size_t nx, size_t ny, size_t nc, uint16_t *out)
+{
+  HWY_DYNAMIC_DISPATCH(BoxReduceU16)
+  (in, nx, ny, nc, out);
+}
+
+AxisWeights build_axis_weights(size_t src, size_t dst)
+{
+  AxisWeights w;
+  std::vector<double> dwt;// real-valued weights, quantised to fixed point below
+  w.offset.reserve(dst + 1);
+
+  if (dst == src) {
+    for (size_t i = 0; i < dst; ++i) {
+      w.offset.push_back(w.idx.size());
+      w.idx.push_back(i);
+      dwt.push_back(1.0);
+    }
+  } else if (dst < src) {
+    // Area averaging: output i covers the source interval [i*ratio, (i+1)*ratio);
+    // each covered source sample contributes its overlap length, normalised by
+    // the interval width so the weights sum to 1.
+    const double ratio = static_cast<double>(src) / static_cast<double>(dst);
+    for (size_t i = 0; i < dst; ++i) {
+      w.offset.push_back(w.idx.size());
+      const double start = static_cast<double>(i) * ratio;
+      const double end = static_cast<double>(i + 1) * ratio;
+      for (auto s = static_cast<size_t>(std::floor(start)); static_cast<double>(s) < end && s < src; ++s) {
+        const double lo = std::max(start, static_cast<double>(s));
+        const double hi = std::min(end, static_cast<double>(s + 1));
+        const double cover = hi - lo;
+        if (cover <= 0.0) { continue; }
+        w.idx.push_back(s);
+        dwt.push_back(cover / ratio);
+      }
+    }
+  } else {
+    // Enlarge: 2-tap linear interpolation. The sample position matches the
+    // legacy mapping i*(src-1)/(dst-1), so an exact integer upscale lands on
+    // grid points.
+    for (size_t i = 0; i < dst; ++i) {
+      w.offset.push_back(w.idx.size());
+      const double pos =
+        (dst > 1) ? static_cast<double>(i) * static_cast<double>(src - 1) / static_cast<double>(dst - 1) : 0.0;
+      const auto s0 = static_cast<size_t>(std::floor(pos));
+      const double frac = pos - static_cast<double>(s0);
+      const size_t s1 = std::min(s0 + 1, src - 1);
+      w.idx.push_back(s0);
+      dwt.push_back(1.0 - frac);
+      if (s1 != s0) {
+        w.idx.push_back(s1);
+        dwt.push_back(frac);
+      }
+    }
+  }
+  w.offset.push_back(w.idx.size());
+
+  // Quantise each output's real weights to fixed point, then fold the rounding
+  // residual into the largest tap so the group sums to exactly kResampleOne
+  // (preserves the DC level: a flat region resamples to itself).
+  w.wt.resize(dwt.size());
+  for (size_t i = 0; i + 1 < w.offset.size(); ++i) {
+    int32_t sum = 0;
+    size_t max_t = w.offset[i];
+    for (size_t t = w.offset[i]; t < w.offset[i + 1]; ++t) {
+      w.wt[t] = static_cast<int32_t>(std::lround(dwt[t] * kResampleOne));
+      sum += w.wt[t];
+      if (dwt[t] > dwt[max_t]) { max_t = t; }
+    }
+    if (w.offset[i] < w.offset[i + 1]) { w.wt[max_t] += kResampleOne - sum; }
+  }
+  return w;
+}
+
+/*==========================================================================*/
+
+StreamingResampler::StreamingResampler(size_t nx, size_t ny, size_t nc, size_t nnx, size_t nny, int bps, void *out)
+  : nx_(nx), ny_(ny), nc_(nc), nnx_(nnx), nny_(nny), bps_(bps), out_(out), wx_(build_axis_weights(nx, nnx)),
+    wy_(build_axis_weights(ny, nny)), hrow_(nnx * nc)
+{}
+
+template<typename T> void StreamingResampler::horizontal(const T *row)
+{
+  constexpr int32_t maxval = static_cast<int32_t>(std::numeric_limits<T>::max());
+  constexpr int32_t round = 1 << (kResamplePrecisionBits - 1);
+  for (size_t i = 0; i < nnx_; ++i) {
+    for (size_t k = 0; k < nc_; ++k) {
+      int32_t acc = round;
+      for (size_t t = wx_.offset[i]; t < wx_.offset[i + 1]; ++t) {
+        acc += wx_.wt[t] * static_cast<int32_t>(row[wx_.idx[t] * nc_ + k]);
+      }
+      hrow_[i * nc_ + k] = std::clamp(acc >> kResamplePrecisionBits, 0, maxval);
+    }
+  }
+}
+
+template<typename T> void StreamingResampler::emit(size_t j, const std::vector<int32_t> &acc)
+{
+  constexpr int32_t maxval = static_cast<int32_t>(std::numeric_limits<T>::max());
+  T *orow = static_cast<T *>(out_) + j * nnx_ * nc_;
+  for (size_t f = 0; f < acc.size(); ++f) {
+    orow[f] = static_cast<T>(std::clamp(acc[f] >> kResamplePrecisionBits, 0, maxval));
+  }
+}
+
+void StreamingResampler::push_row(const void *row)
+{
+  if (next_src_ >= ny_) { return; }
+  if (bps_ == 16) {
+    horizontal(static_cast<const uint16_t *>(row));
+  } else {
+    horizontal(static_cast<const uint8_t *>(row));
+  }
+  const size_t s = next_src_++;
+  constexpr int32_t round = 1 << (kResamplePrecisionBits - 1);
+
+  // Add the row into every open output row whose tap range has reached it,
+  // opening an accumulator for each output row whose first tap is this row.
+  for (size_t k = 0, j = first_open_; j < nny_ && wy_.idx[wy_.offset[j]] <= s; ++k, ++j) {
+    if (k == acc_.size()) { acc_.emplace_back(hrow_.size(), round); }
+    std::vector<int32_t> &acc = acc_[k];
+    for (size_t t = wy_.offset[j]; t < wy_.offset[j + 1]; ++t) {
+      if (wy_.idx[t] != s) { continue; }
+      const int32_t w = wy_.wt[t];
+      for (size_t f = 0; f < acc.size(); ++f) { acc[f] += w * hrow_[f]; }
+    }
+  }
+
+  // Output rows complete in order (the last tap is non-decreasing in j).
+  while (!acc_.empty() && wy_.idx[wy_.offset[first_open_ + 1] - 1] <= s) {
+    if (bps_ == 16) {
+      emit<uint16_t>(first_open_, acc_.front());
+    } else {
+      emit<uint8_t>(first_open_, acc_.front());
+    }
+    acc_.pop_front();
+    ++first_open_;
+  }
+}
+
 }// namespace Sipi
 #endif
@@ -8,6 +8,8 @@
 
 #include <cstddef>
 #include <cstdint>
+#include <deque>
+#include <vector>
 
 namespace Sipi {
 
@@ -20,12 +22,31 @@ namespace Sipi {
 // across x86-64 and aarch64. 14 bits keeps 8- and 16-bit sample sums in int32.
 inline constexpr int kResamplePrecisionBits = 14;
 
+// Fixed-point one (weights sum to this per output).
+inline constexpr int32_t kResampleOne = 1 << kResamplePrecisionBits;
+
+// Separable resample weights for one axis, in CSR layout: output sample `i`
+// is the weighted sum of source samples idx[offset[i] .. offset[i+1]). The
+// per-output weights are fixed-point and sum to exactly kResampleOne.
+struct AxisWeights
+{
+  std::vector<size_t> offset;// dst + 1 row pointers into idx/wt
+  std::vector<size_t> idx;   // source sample indices (ascending within an output)
+  std::vector<int32_t> wt;   // fixed-point weights (each output's weights sum to kResampleOne)
+};
+
+// Builds the weights for resampling one axis from `src` to `dst` samples.
+// Shrinking uses area (box) averaging for an anti-aliased downscale; enlarging
+// uses 2-tap linear interpolation; an unchanged axis is an identity passthrough.
+AxisWeights build_axis_weights(size_t src, size_t dst);
+
 // Two-pass separable resample of an interleaved image (nx*ny*nc samples) to
 // nnx*nny, using CSR-layout fixed-point weights per axis: `off` has dst+1 row
 // pointers, `idx`/`wt` have off[dst] entries, and each output's weights sum to
 // 2^kResamplePrecisionBits. The horizontal pass (hoff/hidx/hwt) runs first, the
 // vertical pass (voff/vidx/vwt) second; `out` receives nnx*nny*nc samples. The
-// best SIMD target is selected at runtime via Highway dynamic dispatch.
+// best SIMD target is selected at runtime via Highway dynamic dispatch. Throws
+// SipiImageClientAbortError between row bands once the decode is cancelled.
 void resample_separable_u8(const uint8_t *in, size_t nx, size_t ny, size_t nc, size_t nnx, size_t nny,
   const size_t *hoff, const size_t *hidx, const int32_t *hwt, const size_t *voff, const size_t *vidx,
   const int32_t *vwt, uint8_t *out);
@@ -34,6 +55,53 @@ void resample_separable_u16(const uint16_t *in, size_t nx, size_t ny, size_t nc,
   const size_t *hoff, const size_t *hidx, const int32_t *hwt, const size_t *voff, const size_t *vidx,
   const int32_t *vwt, uint16_t *out);
 
+// Halves an interleaved image (nx*ny*nc samples) with a 2×2 box filter — one
+// pyramid level step. `out` receives ceil(nx/2)*ceil(ny/2)*nc samples, each the
+// rounded integer mean of its block; on an odd last column or row the block
+// averages only the samples that exist. Integer arithmetic, so bit-identical
+// across SIMD targets.
+void box_reduce_2x2_u8(const uint8_t *in, size_t nx, size_t ny, size_t nc, uint8_t *out);
+
+void box_reduce_2x2_u16(const uint16_t *in, size_t nx, size_t ny, size_t nc, uint16_t *out);
+
+// Row-streaming form of the separable resampler, for decoders that produce the
+// source top to bottom (PNG). Source rows are pushed one at a time; each is
+// run through the horizontal pass at once, then added into the accumulator row
+// of every output row whose vertical taps include it. An output row is
+// round-shift-clamped into `out` as soon as its last tap has arrived and its
+// accumulator is dropped, so the live state is one int32 output-width row per
+// output row in flight (two on a downscale) — never the source image.
+//
+// Integer accumulation is associative, so the result is bit-identical to
+// resample_separable_u8/_u16 over the same source.
+class StreamingResampler
+{
+public:
+  // `out` must hold nnx*nny*nc samples of the source sample type (8 or 16
+  // bits per sample, native byte order) and outlive the resampler.
+  StreamingResampler(size_t nx, size_t ny, size_t nc, size_t nnx, size_t nny, int bps, void *out);
+
+  // Consumes the next source row (nx*nc samples, native byte order).
+  void push_row(const void *row);
+
+  // True once all ny source rows have been pushed (every output row is written).
+  [[nodiscard]] bool done() const { return next_src_ == ny_; }
+
+private:
+  template<typename T> void horizontal(const T *row);
+  template<typename T> void emit(size_t j, const std::vector<int32_t> &acc);
+
+  size_t nx_, ny_, nc_, nnx_, nny_;
+  int bps_;
+  void *out_;
+  AxisWeights wx_;
+  AxisWeights wy_;
+  std::vector<int32_t> hrow_;             // the current source row after the horizontal pass
+  std::deque<std::vector<int32_t>> acc_;  // accumulators for output rows [first_open_, first_open_ + acc_.size())
+  size_t first_open_{ 0 };                // lowest output row not yet written
+  size_t next_src_{ 0 };                  // index of the next source row expected
+};
+
 }// namespace Sipi
 
 #endif
@@ -0,0 +1,329 @@
+/*
+ * Copyright © 2016 - 2026 Swiss National Data and Service Center for the Humanities and/or DaSCH Service Platform
+ * contributors. SPDX-License-Identifier: AGPL-3.0-or-later
+ */
+
+// Scaling-tier benchmarks — how each engine stage holds up when many requests
+// run it at once. Every stage runs on 1, 2, 4, … hardware_concurrency threads
+// against the SAME shared fixture, and the run ends with a parallel-efficiency
+// table: throughput at N threads over N × the single-thread throughput. A
+// stage that serializes on shared library state shows up as a falling
+// efficiency long before it shows up in a single-request microbenchmark.
+//
+// The stages, and the shared state each one is suspected of contending on:
+//
+//   mimetype   shttps::Parsing::getFileMimetype — libmagic, whose magic
+//              database is loaded afresh on every call
+//   shape      SipiImage::read_shape — the mimetype probe plus the static
+//              SipiIO handler map and the format's header parse
+//   exif       Exif parse + re-encode of a camera EXIF blob — Exiv2
+//   decode     a 256×256 full-resolution tile out of the tiled-TIFF (libtiff)
+//              and JP2 (Kakadu, with its process-wide message handlers)
+//              fixtures
+//   icc        CMYK → sRGB convertToIcc — lcms transform creation and its
+//              global context
+//   encode     a 1024×1024 rendering to JPEG, PNG and JPEG2000, streamed into
+//              a byte-counting CallbackSink so no file I/O is measured
+//
+// The icc and encode stages copy their source image inside the timed loop:
+// both mutate it in place, and PauseTiming would synchronise all threads on
+// every iteration. The copy is a memcpy, small against either stage.
+//
+// Efficiency is judged per stage at every measured thread count up to
+// SIPI_BENCH_SCALING_FLAG_THREADS (default: half the hardware threads, so SMT
+// siblings and all-core turbo clocks — which make the top of the range
+// sub-linear on any host — don't flag lock-free stages). A stage below
+// SIPI_BENCH_SCALING_MIN_EFFICIENCY (default 0.70) there is FLAGGED and the
+// binary exits 2, so `just bench scaling` doubles as a local regression guard
+// for engine scalability. Kakadu is pinned to one thread per call (JP2 decode,
+// JPEG2000 encode): with its per-core pool, one benchmark thread would already
+// occupy the host and efficiency would fall with N by construction. Like every
+// tier it is never a CI gate: shared runners have neither the cores nor the
+// quiet to measure scaling.
+//
+// The binary brings its own main() (the efficiency table needs every run's
+// result), so `--benchmark_format` is fixed to the console; `--benchmark_out`
+// still writes the raw runs.
+//
+// Built only via `just bench scaling` (-c opt, manual-tagged cc_binary).
+// See docs/src/development/benchmarking.md.
+
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "SipiImage.h"
+#include "formats/SipiIOJ2k.h"
+#include "formats/SipiIOTiff.h"
+#include "formats/output_sink.h"
+#include "iiifparser/SipiRegion.h"
+#include "iiifparser/SipiSize.h"
+#include "metadata/exif.h"
+#include "metadata/icc.h"
+#include "test_paths.h"
+#include "util/Parsing.h"
+
+namespace {
+
+std::string fixture(const std::string &name)
+{
+  const char *dir = std::getenv("SIPI_BENCH_FIXTURES_DIR");
+  if (dir == nullptr) {
+    std::fprintf(stderr, "SIPI_BENCH_FIXTURES_DIR not set — run via `just bench scaling`\n");
+    std::exit(1);
+  }
+  return std::string{ dir } + "/big_building/" + name;
+}
+
+Sipi::SipiImage load(const std::string &rel)
+{
+  Sipi::SipiImage img;
+  img.read(sipi::test::data_dir() + "/images/" + rel);
+  return img;
+}
+
+// The EXIF blob of a camera JPEG, extracted once.
+const std::vector<unsigned char> &exif_blob()
+{
+  static const std::vector<unsigned char> blob = [] {
+    const Sipi::SipiImage img = load("unit/img_exif_gps.jpg");
+    if (img.getExif() == nullptr) {
+      std::fprintf(stderr, "unit/img_exif_gps.jpg decoded without EXIF\n");
+      std::exit(1);
+    }
+    return img.getExif()->exifBytes();
+  }();
+  return blob;
+}
+
+// 128×128 CMYK — the same colour-transform source as the process tier.
+const Sipi::SipiImage &cmyk128()
+{
+  static const Sipi::SipiImage img = [] {
+    Sipi::SipiImage i = load("jpeg/cmyk/cmyk_photoshop_app14.jpg");
+    if (i.getNc() != 4) {
+      std::fprintf(stderr, "cmyk128 fixture decoded to %zu channels, expected 4\n", i.getNc());
+      std::exit(1);
+    }
+    return i;
+  }();
+  return img;
+}
+
+// A 1024×1024 RGB 8bps region of the master — a large viewer rendering.
+const Sipi::SipiImage &rendering1024()
+{
+  static const Sipi::SipiImage img = [] {
+    Sipi::SipiImage i;
+    i.read(fixture("pyr-zstd.tif"), std::make_shared<Sipi::SipiRegion>(0, 0, 1024, 1024));
+    return i;
+  }();
+  return img;
+}
+
+// ── Stages ──────────────────────────────────────────────────────────────
+
+void scaling_mimetype(benchmark::State &state, const char *file)
+{
+  const std::string path = fixture(file);
+  for (auto _ : state) {
+    auto mimetype = shttps::Parsing::getFileMimetype(path);
+    benchmark::DoNotOptimize(mimetype);
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+
+void scaling_shape(benchmark::State &state, const char *file)
+{
+  const std::string path = fixture(file);
+  const Sipi::SipiImage probe;
+  for (auto _ : state) {
+    auto info = probe.read_shape(path);
+    benchmark::DoNotOptimize(info);
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+
+void scaling_exif(benchmark::State &state)
+{
+  const std::vector<unsigned char> &blob = exif_blob();
+  for (auto _ : state) {
+    Sipi::Exif exif(blob.data(), static_cast<unsigned int>(blob.size()));
+    auto bytes = exif.exifBytes();
+    benchmark::DoNotOptimize(bytes);
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+
+void scaling_decode(benchmark::State &state, const char *file)
+{
+  const std::string path = fixture(file);
+  for (auto _ : state) {
+    Sipi::SipiImage img;
+    auto region = std::make_shared<Sipi::SipiRegion>(1024, 1024, 256, 256);
+    auto size = std::make_shared<Sipi::SipiSize>("256,256");
+    img.read(path, region, size);
+    benchmark::DoNotOptimize(img.getNx());
+    benchmark::ClobberMemory();
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+
+void scaling_icc(benchmark::State &state)
+{
+  const Sipi::SipiImage &src = cmyk128();
+  for (auto _ : state) {
+    Sipi::SipiImage img(src);
+    img.convertToIcc(Sipi::Icc(Sipi::icc_sRGB), 8);
+    benchmark::DoNotOptimize(img.getNc());
+    benchmark::ClobberMemory();
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+
+int count_bytes(void *ctx, const uint8_t *, size_t len)
+{
+  *static_cast<std::size_t *>(ctx) += len;
+  return 0;
+}
+
+void scaling_encode(benchmark::State &state, const char *ftype)
+{
+  const Sipi::SipiImage &src = rendering1024();
+  std::size_t written = 0;
+  const Sipi::OutputSink sink = Sipi::CallbackSink{ count_bytes, &written };
+  for (auto _ : state) {
+    Sipi::SipiImage img(src);
+    img.write(ftype, sink);
+    benchmark::ClobberMemory();
+  }
+  state.SetItemsProcessed(state.iterations());
+  state.SetBytesProcessed(static_cast<int64_t>(written));
+}
+
+int max_threads() { return static_cast<int>(std::max(1U, std::thread::hardware_concurrency())); }
+
+void across_threads(benchmark::internal::Benchmark *b)
+{
+  b->ThreadRange(1, max_threads())->UseRealTime()->Unit(benchmark::kMillisecond);
+}
+
+BENCHMARK_CAPTURE(scaling_mimetype, pyr_zstd, "pyr-zstd.tif")->Apply(across_threads);
+BENCHMARK_CAPTURE(scaling_shape, pyr_zstd, "pyr-zstd.tif")->Apply(across_threads);
+BENCHMARK_CAPTURE(scaling_shape, jp2, "pyr.jp2")->Apply(across_threads);
+BENCHMARK(scaling_exif)->Apply(across_threads);
+BENCHMARK_CAPTURE(scaling_decode, pyr_zstd, "pyr-zstd.tif")->Apply(across_threads);
+BENCHMARK_CAPTURE(scaling_decode, jp2, "pyr.jp2")->Apply(across_threads);
+BENCHMARK(scaling_icc)->Apply(across_threads);
+BENCHMARK_CAPTURE(scaling_encode, jpg, "jpg")->Apply(across_threads);
+BENCHMARK_CAPTURE(scaling_encode, png, "png")->Apply(across_threads);
+BENCHMARK_CAPTURE(scaling_encode, jpx, "jpx")->Apply(across_threads);
+
+// ── Parallel efficiency ─────────────────────────────────────────────────
+
+double env_double(const char *name, double fallback)
+{
+  const char *v = std::getenv(name);
+  if (v == nullptr || *v == '\0') { return fallback; }
+  char *end = nullptr;
+  const double d = std::strtod(v, &end);
+  return (end != v && d > 0) ? d : fallback;
+}
+
+/*!
+ * The console reporter, plus the efficiency table once every run is in.
+ * Throughput is iterations per wall-clock second (`UseRealTime`); repeated
+ * runs of one stage and thread count are averaged.
+ */
+class ScalingReporter : public benchmark::ConsoleReporter
+{
+public:
+  ScalingReporter(double min_efficiency, int flag_threads)
+    : benchmark::ConsoleReporter(OO_Tabular), min_efficiency_(min_efficiency), flag_threads_(flag_threads)
+  {}
+
+  void ReportRuns(const std::vector<Run> &reports) override
+  {
+    benchmark::ConsoleReporter::ReportRuns(reports);
+    for (const Run &run : reports) {
+      if (run.run_type != Run::RT_Iteration || run.skipped || run.real_accumulated_time <= 0) { continue; }
+      std::string stage = run.run_name.function_name;
+      if (!run.run_name.args.empty()) { stage += "/" + run.run_name.args; }
+      Rate &rate = stages_[stage][static_cast<int>(run.threads)];
+      rate.sum += static_cast<double>(run.iterations) / run.real_accumulated_time;
+      ++rate.runs;
+    }
+  }
+
+  void Finalize() override
+  {
+    std::ostream &out = GetOutputStream();
+    char line[160];
+    std::snprintf(line, sizeof(line), "\nParallel efficiency (flagged below %.2f at <= %d threads)\n", min_efficiency_,
+      flag_threads_);
+    out << line;
+    for (const auto &[stage, by_threads] : stages_) {
+      const auto single = by_threads.find(1);
+      const double base = single != by_threads.end() ? single->second.mean() : 0;
+      if (base <= 0) { continue; }
+      bool stage_flagged = false;
+      std::string row;
+      for (const auto &[threads, rate] : by_threads) {
+        const double efficiency = rate.mean() / (base * threads);
+        if (threads <= flag_threads_ && efficiency < min_efficiency_) { stage_flagged = true; }
+        std::snprintf(line, sizeof(line), " %dt=%.2f", threads, efficiency);
+        row += line;
+      }
+      std::snprintf(line, sizeof(line), "%-34s", stage.c_str());
+      out << line << row << (stage_flagged ? "  FLAGGED" : "") << '\n';
+      flagged_ = flagged_ || stage_flagged;
+    }
+    benchmark::ConsoleReporter::Finalize();
+  }
+
+  [[nodiscard]] bool flagged() const { return flagged_; }
+
+private:
+  struct Rate
+  {
+    double sum{ 0 };
+    int runs{ 0 };
+    [[nodiscard]] double mean() const { return runs > 0 ? sum / runs : 0; }
+  };
+
+  double min_efficiency_;
+  int flag_threads_;
+  std::map<std::string, std::map<int, Rate>> stages_;
+  bool flagged_{ false };
+};
+
+}// namespace
+
+int main(int argc, char **argv)
+{
+  benchmark::Initialize(&argc, argv);
+  if (benchmark::ReportUnrecognizedArguments(argc, argv)) { return 1; }
+  // The server registers SIPI's TIFF tags at startup; so do we.
+  Sipi::SipiIOTiff::initLibrary();
+  // One Kakadu thread per call, so the JP2 and JPEG2000 stages measure
+  // contention between requests (its message handlers) rather than its pool.
+  Sipi::SipiIOJ2k::set_max_threads(1);
+
+  const double min_efficiency = env_double("SIPI_BENCH_SCALING_MIN_EFFICIENCY", 0.70);
+  const int flag_threads =
+    static_cast<int>(env_double("SIPI_BENCH_SCALING_FLAG_THREADS", std::max(2, max_threads() / 2)));
+  ScalingReporter reporter(min_efficiency, flag_threads);
+  benchmark::RunSpecifiedBenchmarks(&reporter);
+  benchmark::Shutdown();
+  return reporter.flagged() ? 2 : 0;
+}
@@ -61,6 +61,9 @@ fn absent_keys_resolve_to_defaults() {
     assert_eq!(cfg.cache_dir, "./cache");
     assert_eq!(cfg.cache_size, "200M");
     assert_eq!(cfg.cache_nfiles, 200);
+    assert_eq!(cfg.shadow_dir, "");
+    assert_eq!(cfg.shadow_max_size, "10G");
+    assert_eq!(cfg.shadow_hot_threshold, 3);
     assert_eq!(cfg.thumb_size, "!128,128");
     assert_eq!(cfg.max_post_size, "0");
     assert_eq!(cfg.tmp_dir, "/tmp");
@@ -74,6 +77,10 @@ fn absent_keys_resolve_to_defaults() {
     assert_eq!(cfg.wwwroute, "");
     assert!(cfg.routes.is_empty());
     assert_eq!(cfg.scaling_quality, Default::default());
+    assert_eq!(cfg.j2k_layer_truncation_size, 0);
+    assert_eq!(cfg.j2k_gray_decode, "exact");
+    assert_eq!(cfg.slow_request_ms, 1000);
+    assert_eq!(cfg.log_rate_limit, 200);
 }
 
 #[test]
@@ -91,6 +98,34 @@ fn both_cache_dir_keys_is_an_error() {
     assert!(err.contains("cachedir"), "{err}");
 }
 
+#[test]
+fn negative_j2k_layer_truncation_size_is_an_error() {
+    let (_d, path) = write_config("sipi = { j2k_layer_truncation_size = -1 }\nroutes = {}\n");
+    let err = parse_config_file(&path).expect_err("must reject a negative edge length");
+    assert!(err.contains("j2k_layer_truncation_size"), "{err}");
+}
+
+#[test]
+fn negative_slow_request_ms_is_an_error() {
+    let (_d, path) = write_config("sipi = { slow_request_ms = -5 }\nroutes = {}\n");
+    let err = parse_config_file(&path).expect_err("must reject a negative threshold");
+    assert!(err.contains("slow_request_ms"), "{err}");
+}
+
+#[test]
+fn negative_log_rate_limit_is_an_error() {
+    let (_d, path) = write_config("sipi = { log_rate_limit = -1 }\nroutes = {}\n");
+    let err = parse_config_file(&path).expect_err("must reject a negative rate limit");
+    assert!(err.contains("log_rate_limit"), "{err}");
+}
+
+#[test]
+fn unknown_j2k_gray_decode_is_an_error() {
+    let (_d, path) = write_config("sipi = { j2k_gray_decode = 'luma' }\nroutes = {}\n");
+    let err = parse_config_file(&path).expect_err("must reject an unknown mode");
+    assert!(err.contains("j2k_gray_decode"), "{err}");
+}
+
 #[test]
 fn strict_types_are_enforced() {
     for (body, needle) in [
@@ -110,6 +145,10 @@ fn strict_types_are_enforced() {
             "sipi = { cache_size = '20X' }\nroutes = {}\n",
             "invalid size value",
         ),
+        (
+            "sipi = { shadow_max_size = '0' }\nroutes = {}\n",
+            "Invalid shadow_max_size value '0'",
+        ),
     ] {
         let (_d, path) = write_config(body);
         let err = parse_config_file(&path).expect_err(body);
@@ -53,10 +53,15 @@ pub struct LuaConfigFile {
     pub prefix_as_path: bool,
     pub jpeg_quality: i64,
     pub scaling_quality: LuaScalingQuality,
+    pub j2k_layer_truncation_size: i64,
+    pub j2k_gray_decode: String,
     pub init_script: String,
     pub cache_dir: String,
     pub cache_size: String,
     pub cache_nfiles: i64,
+    pub shadow_dir: String,
+    pub shadow_max_size: String,
+    pub shadow_hot_threshold: i64,
     pub thumb_size: String,
     pub max_post_size: String,
     pub tmp_dir: String,
@@ -68,6 +73,11 @@ pub struct LuaConfigFile {
     pub admin_password: String,
     pub docroot: String,
     pub wwwroute: String,
+    /// Flight-recorder threshold (ms): a serve at least this slow is kept and
+    /// logged with its profiling zones; 0 = off.
+    pub slow_request_ms: i64,
+    /// Server-mode log lines written per second for each level below ERR; 0 = off.
+    pub log_rate_limit: i64,
     /// Read and type-checked for schema parity; the shell's own
     /// `--drain-timeout` knob governs draining, so this value is not consumed.
     pub drain_timeout: i64,
@@ -168,6 +178,16 @@ fn read_config(lua: &Lua) -> Result<LuaConfigFile, String> {
         ));
     }
 
+    // shadow_max_size: raw like cache_size; the shadows are capped or explicitly
+    // unlimited, never disabled by size (an empty shadow_dir does that).
+    let shadow_max_size = cfg_string(&sipi, "sipi", "shadow_max_size", "10G")?;
+    let shadow_max_bytes = parse_size_string(&shadow_max_size)?;
+    if shadow_max_bytes == 0 || shadow_max_bytes < -1 {
+        return Err(format!(
+            "Invalid shadow_max_size value '{shadow_max_size}'. Use '-1' (unlimited) or a positive value like '10G'."
+        ));
+    }
+
     // cache_hysteresis: no longer supported; warn when explicitly set.
     if cfg_float(&sipi, "sipi", "cache_hysteresis", -1.0)? >= 0.0 {
         tracing::warn!(
@@ -178,6 +198,37 @@ fn read_config(lua: &Lua) -> Result<LuaConfigFile, String> {
     let max_post_size = cfg_string(&sipi, "sipi", "max_post_size", "0")?;
     parse_size_string(&max_post_size)?;
 
+    let j2k_layer_truncation_size = cfg_integer(&sipi, "sipi", "j2k_layer_truncation_size", 0)?;
+    if j2k_layer_truncation_size < 0 {
+        return Err(format!(
+            "Invalid j2k_layer_truncation_size value '{j2k_layer_truncation_size}'. Use '0' (off) or a positive edge length in px."
+        ));
+    }
+
+    let j2k_gray_decode = cfg_string(&sipi, "sipi", "j2k_gray_decode", "exact")?;
+    if !matches!(
+        j2k_gray_decode.as_str(),
+        "exact" | "luminance" | "luminance_toned"
+    ) {
+        return Err(format!(
+            "Invalid j2k_gray_decode value '{j2k_gray_decode}'. Use 'exact', 'luminance', or 'luminance_toned'."
+        ));
+    }
+
+    let slow_request_ms = cfg_integer(&sipi, "sipi", "slow_request_ms", 1000)?;
+    if slow_request_ms < 0 {
+        return Err(format!(
+            "Invalid slow_request_ms value '{slow_request_ms}'. Use '0' (off) or a positive number of milliseconds."
+        ));
+    }
+
+    let log_rate_limit = cfg_integer(&sipi, "sipi", "log_rate_limit", 200)?;
+    if log_rate_limit < 0 {
+        return Err(format!(
+            "Invalid log_rate_limit value '{log_rate_limit}'. Use '0' (off) or a positive number of lines per second."
+        ));
+    }
+
     let scaling = cfg_string_table(&sipi, "sipi", "scaling_quality")?;
     let scaling_quality = match scaling {
         Some(map) => LuaScalingQuality {
@@ -198,10 +249,15 @@ fn read_config(lua: &Lua) -> Result<LuaConfigFile, String> {
         prefix_as_path: cfg_boolean(&sipi, "sipi", "prefix_as_path", true)?,
         jpeg_quality: cfg_integer(&sipi, "sipi", "jpeg_quality", 80)?,
         scaling_quality,
+        j2k_layer_truncation_size,
+        j2k_gray_decode,
         init_script: cfg_string(&sipi, "sipi", "initscript", ".")?,
         cache_dir,
         cache_size,
         cache_nfiles: cfg_integer(&sipi, "sipi", "cache_nfiles", 200)?.max(0),
+        shadow_dir: cfg_string(&sipi, "sipi", "shadow_dir", "")?,
+        shadow_max_size,
+        shadow_hot_threshold: cfg_integer(&sipi, "sipi", "shadow_hot_threshold", 3)?.max(1),
         thumb_size: cfg_string(&sipi, "sipi", "thumb_size", "!128,128")?,
         max_post_size,
         tmp_dir: cfg_string(&sipi, "sipi", "tmpdir", "/tmp")?,
@@ -213,6 +269,8 @@ fn read_config(lua: &Lua) -> Result<LuaConfigFile, String> {
         admin_password: cfg_string(&admin, "admin", "password", "")?,
         docroot: cfg_string(&fileserver, "fileserver", "docroot", "")?,
         wwwroute: cfg_string(&fileserver, "fileserver", "wwwroute", "")?,
+        slow_request_ms,
+        log_rate_limit,
         drain_timeout: {
             let v = cfg_integer(&sipi, "sipi", "drain_timeout", 30)?;
             if v < 1 {
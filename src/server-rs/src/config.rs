@@ -74,6 +74,14 @@ pub struct ServerOverrides {
     /// 0 = unlimited; a negative is rejected at the CLI (clap `u32` + the C++
     /// `unsigned` var), so there is no signed→unsigned wrap.
     pub cache_nfiles: Option<u32>,
+    /// Directory for the shadow pyramids of hot flat sources; empty = off.
+    /// TOML/Lua-config-only.
+    pub shadow_dir: Option<String>,
+    /// Size cap of `shadow_dir` as a raw size string ("10G"; "-1" = unlimited);
+    /// the engine parses the suffix. TOML/Lua-config-only.
+    pub shadow_max_size: Option<String>,
+    /// Decodes of a flat source after which its shadow pyramid is built.
+    pub shadow_hot_threshold: Option<u32>,
 
     // Limits / admission
     /// Total RAM envelope as a raw size string ("8G"); the engine parses the
@@ -97,10 +105,22 @@ pub struct ServerOverrides {
 
     // Logging
     pub loglevel: Option<String>,
+    /// Flight-recorder threshold: a serve at least this slow (ms) is kept and
+    /// logged with its profiling zones; 0 = off.
+    pub slow_request_ms: Option<u32>,
+    /// Server-mode log lines written per second for each level below ERR; the
+    /// excess is counted, not written. 0 = off.
+    pub log_rate_limit: Option<u32>,
 
     // Image quality — TOML-config-only (no CLI flag).
     pub jpeg_quality: Option<i32>,
     pub scaling_quality: ScalingQuality,
+    /// Longest output edge (px) up to which JPEG2000 decodes drop quality
+    /// layers; `0` = off.
+    pub j2k_layer_truncation_size: Option<i32>,
+    /// How `gray` renderings of colour JPEG2000 sources decode: "exact" |
+    /// "luminance" | "luminance_toned".
+    pub j2k_gray_decode: Option<String>,
 
     // Lua-config-only (never set from CLI/env): no engine behavior of their
     // own — they feed the SipiConf getters the Lua `config` table exposes to
@@ -134,6 +154,9 @@ impl std::fmt::Debug for ServerOverrides {
             .field("cache_dir", &self.cache_dir)
             .field("cache_size", &self.cache_size)
             .field("cache_nfiles", &self.cache_nfiles)
+            .field("shadow_dir", &self.shadow_dir)
+            .field("shadow_max_size", &self.shadow_max_size)
+            .field("shadow_hot_threshold", &self.shadow_hot_threshold)
             .field("memory_limit", &self.memory_limit)
             .field("admission_mode", &self.admission_mode)
             .field("tiles_memory_ratio", &self.tiles_memory_ratio)
@@ -146,8 +169,12 @@ impl std::fmt::Debug for ServerOverrides {
             .field("knorapath", &self.knorapath)
             .field("knoraport", &self.knoraport)
             .field("loglevel", &self.loglevel)
+            .field("slow_request_ms", &self.slow_request_ms)
+            .field("log_rate_limit", &self.log_rate_limit)
             .field("jpeg_quality", &self.jpeg_quality)
             .field("scaling_quality", &self.scaling_quality)
+            .field("j2k_layer_truncation_size", &self.j2k_layer_truncation_size)
+            .field("j2k_gray_decode", &self.j2k_gray_decode)
             .field("hostname", &self.hostname)
             .field("sslport", &self.sslport)
             .finish()
@@ -179,6 +206,12 @@ impl ServerOverrides {
             cache_dir: Some(cfg.cache_dir.clone()),
             cache_size: Some(cfg.cache_size.clone()),
             cache_nfiles: Some(narrow(cfg.cache_nfiles, "sipi.cache_nfiles")?),
+            shadow_dir: Some(cfg.shadow_dir.clone()),
+            shadow_max_size: Some(cfg.shadow_max_size.clone()),
+            shadow_hot_threshold: Some(narrow(
+                cfg.shadow_hot_threshold,
+                "sipi.shadow_hot_threshold",
+            )?),
             // Shell-owned admission knobs: never read from the Lua config
             // (CLI/env or TOML only).
             memory_limit: None,
@@ -191,6 +224,8 @@ impl ServerOverrides {
             knoraport: Some(cfg.knora_port.clone()),
             // The Lua config schema has no log-level key.
             loglevel: None,
+            slow_request_ms: Some(narrow(cfg.slow_request_ms, "sipi.slow_request_ms")?),
+            log_rate_limit: Some(narrow(cfg.log_rate_limit, "sipi.log_rate_limit")?),
             jpeg_quality: Some(narrow(cfg.jpeg_quality, "sipi.jpeg_quality")?),
             scaling_quality: ScalingQuality {
                 jpeg: cfg.scaling_quality.jpeg.clone(),
@@ -198,6 +233,11 @@ impl ServerOverrides {
                 png: cfg.scaling_quality.png.clone(),
                 j2k: cfg.scaling_quality.j2k.clone(),
             },
+            j2k_layer_truncation_size: Some(narrow(
+                cfg.j2k_layer_truncation_size,
+                "sipi.j2k_layer_truncation_size",
+            )?),
+            j2k_gray_decode: Some(cfg.j2k_gray_decode.clone()),
             hostname: Some(cfg.hostname.clone()),
             sslport: Some(narrow(cfg.ssl_port, "sipi.ssl_port")?),
         })
@@ -249,6 +289,9 @@ impl ServerOverrides {
             cache_dir: self.cache_dir.or(base.cache_dir),
             cache_size: self.cache_size.or(base.cache_size),
             cache_nfiles: self.cache_nfiles.or(base.cache_nfiles),
+            shadow_dir: self.shadow_dir.or(base.shadow_dir),
+            shadow_max_size: self.shadow_max_size.or(base.shadow_max_size),
+            shadow_hot_threshold: self.shadow_hot_threshold.or(base.shadow_hot_threshold),
             memory_limit: self.memory_limit.or(base.memory_limit),
             admission_mode: self.admission_mode.or(base.admission_mode),
             tiles_memory_ratio: self.tiles_memory_ratio.or(base.tiles_memory_ratio),
@@ -260,6 +303,8 @@ impl ServerOverrides {
             knorapath: self.knorapath.or(base.knorapath),
             knoraport: self.knoraport.or(base.knoraport),
             loglevel: self.loglevel.or(base.loglevel),
+            slow_request_ms: self.slow_request_ms.or(base.slow_request_ms),
+            log_rate_limit: self.log_rate_limit.or(base.log_rate_limit),
             jpeg_quality: self.jpeg_quality.or(base.jpeg_quality),
             scaling_quality: ScalingQuality {
                 jpeg: self.scaling_quality.jpeg.or(base.scaling_quality.jpeg),
@@ -267,6 +312,10 @@ impl ServerOverrides {
                 png: self.scaling_quality.png.or(base.scaling_quality.png),
                 j2k: self.scaling_quality.j2k.or(base.scaling_quality.j2k),
             },
+            j2k_layer_truncation_size: self
+                .j2k_layer_truncation_size
+                .or(base.j2k_layer_truncation_size),
+            j2k_gray_decode: self.j2k_gray_decode.or(base.j2k_gray_decode),
             hostname: self.hostname.or(base.hostname),
             sslport: self.sslport.or(base.sslport),
         }
@@ -317,6 +366,9 @@ pub(crate) struct SipiServerConfig {
     pub scaling_quality_tiff: *const c_char,
     pub scaling_quality_png: *const c_char,
     pub scaling_quality_j2k: *const c_char,
+    pub j2k_gray_decode: *const c_char, // "exact" | "luminance" | "luminance_toned"; TOML/Lua-only
+    pub shadow_dir: *const c_char, // shadow-pyramid directory for hot flat sources; null/empty = off; TOML/Lua-only
+    pub shadow_max_size: *const c_char, // raw "10G" size cap of shadow_dir; "-1" = unlimited; TOML/Lua-only
     // 8-byte: 64-bit scalar values (presence via the has_ flags below)
     pub tiles_memory_ratio: f64, // fraction of the envelope reserved for tiles; full lane = envelope × (1 − ratio)
     pub large_decode_threshold_bytes: u64, // estimated peak >= this => full lane (charged); below => tile (bypass)
@@ -326,14 +378,22 @@ pub(crate) struct SipiServerConfig {
     pub cache_nfiles: u32, // 0 = unlimited; a negative is rejected at the CLI (no wrap)
     pub pathprefix: i32,   // prefix_as_path, bool carried as 0/1
     pub jpeg_quality: i32, // JPEG output quality (1-100); TOML-only
+    pub j2k_layer_truncation_size: i32, // longest output edge (px) up to which JPEG2000 decodes drop quality layers; 0 = off
+    pub shadow_hot_threshold: u32, // decodes of a flat source after which its shadow pyramid is built; TOML/Lua-only
+    pub slow_request_ms: u32,      // flight-recorder threshold (ms); 0 = off
+    pub log_rate_limit: u32,       // log lines per second per level below ERR; 0 = off
     // 4-byte presence flags (non-zero = present)
     pub has_serverport: c_int,
     pub has_maxtmpage: c_int,
     pub has_cache_nfiles: c_int,
     pub has_pathprefix: c_int,
     pub has_jpeg_quality: c_int,
+    pub has_j2k_layer_truncation_size: c_int,
     pub has_tiles_memory_ratio: c_int,
     pub has_large_decode_threshold_bytes: c_int,
+    pub has_shadow_hot_threshold: c_int,
+    pub has_slow_request_ms: c_int,
+    pub has_log_rate_limit: c_int,
 }
 
 /// Owns the C storage backing a [`SipiServerConfig`] so its pointers stay valid
@@ -381,6 +441,9 @@ impl OverridesHolder {
             cache_dir,
             cache_size,
             cache_nfiles,
+            shadow_dir,
+            shadow_max_size,
+            shadow_hot_threshold,
             memory_limit,
             admission_mode,
             tiles_memory_ratio,
@@ -390,8 +453,12 @@ impl OverridesHolder {
             knorapath,
             knoraport,
             loglevel,
+            slow_request_ms,
+            log_rate_limit,
             jpeg_quality,
             scaling_quality,
+            j2k_layer_truncation_size,
+            j2k_gray_decode,
             // Lua-config-only: consumed Rust-side (the Lua `config` table);
             // they do not cross the seam.
             hostname: _,
@@ -423,6 +490,9 @@ impl OverridesHolder {
             scaling_quality_tiff: intern_cstr(&mut strings, &scaling_quality.tiff)?,
             scaling_quality_png: intern_cstr(&mut strings, &scaling_quality.png)?,
             scaling_quality_j2k: intern_cstr(&mut strings, &scaling_quality.j2k)?,
+            j2k_gray_decode: intern_cstr(&mut strings, &j2k_gray_decode)?,
+            shadow_dir: intern_cstr(&mut strings, &shadow_dir)?,
+            shadow_max_size: intern_cstr(&mut strings, &shadow_max_size)?,
             tiles_memory_ratio: tiles_memory_ratio.unwrap_or(0.0),
             // Always sent with the shell-side default when unset: the shell owns
             // the single definition (DUNE-003), so the engine reads it from the
@@ -434,15 +504,23 @@ impl OverridesHolder {
             cache_nfiles: cache_nfiles.unwrap_or(0),
             pathprefix: pathprefix.map(i32::from).unwrap_or(0),
             jpeg_quality: jpeg_quality.unwrap_or(0),
+            j2k_layer_truncation_size: j2k_layer_truncation_size.unwrap_or(0),
+            shadow_hot_threshold: shadow_hot_threshold.unwrap_or(0),
+            slow_request_ms: slow_request_ms.unwrap_or(0),
+            log_rate_limit: log_rate_limit.unwrap_or(0),
             has_serverport: serverport.is_some() as c_int,
             has_maxtmpage: maxtmpage.is_some() as c_int,
             has_cache_nfiles: cache_nfiles.is_some() as c_int,
             has_pathprefix: pathprefix.is_some() as c_int,
             has_jpeg_quality: jpeg_quality.is_some() as c_int,
+            has_j2k_layer_truncation_size: j2k_layer_truncation_size.is_some() as c_int,
             has_tiles_memory_ratio: tiles_memory_ratio.is_some() as c_int,
             // Always present: the shell always supplies the threshold (its own
             // default when unset), so the engine can rely on the seam value.
             has_large_decode_threshold_bytes: 1,
+            has_shadow_hot_threshold: shadow_hot_threshold.is_some() as c_int,
+            has_slow_request_ms: slow_request_ms.is_some() as c_int,
+            has_log_rate_limit: log_rate_limit.is_some() as c_int,
         };
 
         Ok(Self {
@@ -488,7 +566,7 @@ mod layout {
     fn repr_c_matches_sipi_ffi_h() {
         assert_eq!(size_of::<usize>(), 8, "layout assumes an LP64 target");
         assert_eq!(align_of::<SipiServerConfig>(), 8);
-        assert_eq!(size_of::<SipiServerConfig>(), 240);
+        assert_eq!(size_of::<SipiServerConfig>(), 296);
 
         assert_eq!(offset_of!(SipiServerConfig, imgroot), 0);
         assert_eq!(offset_of!(SipiServerConfig, scriptdir), 8);
@@ -512,26 +590,40 @@ mod layout {
         assert_eq!(offset_of!(SipiServerConfig, scaling_quality_tiff), 152);
         assert_eq!(offset_of!(SipiServerConfig, scaling_quality_png), 160);
         assert_eq!(offset_of!(SipiServerConfig, scaling_quality_j2k), 168);
-        assert_eq!(offset_of!(SipiServerConfig, tiles_memory_ratio), 176);
+        assert_eq!(offset_of!(SipiServerConfig, j2k_gray_decode), 176);
+        assert_eq!(offset_of!(SipiServerConfig, shadow_dir), 184);
+        assert_eq!(offset_of!(SipiServerConfig, shadow_max_size), 192);
+        assert_eq!(offset_of!(SipiServerConfig, tiles_memory_ratio), 200);
         assert_eq!(
             offset_of!(SipiServerConfig, large_decode_threshold_bytes),
-            184
+            208
         );
-        assert_eq!(offset_of!(SipiServerConfig, serverport), 192);
-        assert_eq!(offset_of!(SipiServerConfig, maxtmpage), 196);
-        assert_eq!(offset_of!(SipiServerConfig, cache_nfiles), 200);
-        assert_eq!(offset_of!(SipiServerConfig, pathprefix), 204);
-        assert_eq!(offset_of!(SipiServerConfig, jpeg_quality), 208);
-        assert_eq!(offset_of!(SipiServerConfig, has_serverport), 212);
-        assert_eq!(offset_of!(SipiServerConfig, has_maxtmpage), 216);
-        assert_eq!(offset_of!(SipiServerConfig, has_cache_nfiles), 220);
-        assert_eq!(offset_of!(SipiServerConfig, has_pathprefix), 224);
-        assert_eq!(offset_of!(SipiServerConfig, has_jpeg_quality), 228);
-        assert_eq!(offset_of!(SipiServerConfig, has_tiles_memory_ratio), 232);
+        assert_eq!(offset_of!(SipiServerConfig, serverport), 216);
+        assert_eq!(offset_of!(SipiServerConfig, maxtmpage), 220);
+        assert_eq!(offset_of!(SipiServerConfig, cache_nfiles), 224);
+        assert_eq!(offset_of!(SipiServerConfig, pathprefix), 228);
+        assert_eq!(offset_of!(SipiServerConfig, jpeg_quality), 232);
+        assert_eq!(offset_of!(SipiServerConfig, j2k_layer_truncation_size), 236);
+        assert_eq!(offset_of!(SipiServerConfig, shadow_hot_threshold), 240);
+        assert_eq!(offset_of!(SipiServerConfig, slow_request_ms), 244);
+        assert_eq!(offset_of!(SipiServerConfig, log_rate_limit), 248);
+        assert_eq!(offset_of!(SipiServerConfig, has_serverport), 252);
+        assert_eq!(offset_of!(SipiServerConfig, has_maxtmpage), 256);
+        assert_eq!(offset_of!(SipiServerConfig, has_cache_nfiles), 260);
+        assert_eq!(offset_of!(SipiServerConfig, has_pathprefix), 264);
+        assert_eq!(offset_of!(SipiServerConfig, has_jpeg_quality), 268);
+        assert_eq!(
+            offset_of!(SipiServerConfig, has_j2k_layer_truncation_size),
+            272
+        );
+        assert_eq!(offset_of!(SipiServerConfig, has_tiles_memory_ratio), 276);
         assert_eq!(
             offset_of!(SipiServerConfig, has_large_decode_threshold_bytes),
-            236
+            280
         );
+        assert_eq!(offset_of!(SipiServerConfig, has_shadow_hot_threshold), 284);
+        assert_eq!(offset_of!(SipiServerConfig, has_slow_request_ms), 288);
+        assert_eq!(offset_of!(SipiServerConfig, has_log_rate_limit), 292);
     }
 }
 
@@ -84,6 +84,12 @@ struct CacheSection {
     /// Raw size string ("200M"); the engine parses the suffix.
     size: Option<String>,
     n_files: Option<u32>,
+    /// Directory for the shadow pyramids of hot flat sources; absent/empty = off.
+    shadow_dir: Option<String>,
+    /// Size cap of `shadow_dir` as a raw size string ("10G"; "-1" = unlimited).
+    shadow_max_size: Option<String>,
+    /// Decodes of a flat source after which its shadow pyramid is built.
+    shadow_hot_threshold: Option<u32>,
 }
 
 #[derive(Debug, Default, Deserialize)]
@@ -111,6 +117,12 @@ struct ImageSection {
     jpeg_quality: Option<i32>,
     #[serde(default)]
     scaling_quality: ScalingQualitySection,
+    /// Longest output edge (px) up to which JPEG2000 decodes drop quality
+    /// layers; `0` = off.
+    j2k_layer_truncation_size: Option<i32>,
+    /// `gray` renderings of colour JPEG2000: "exact" | "luminance" |
+    /// "luminance_toned". Parsed engine-side (unknown = exact).
+    j2k_gray_decode: Option<String>,
 }
 
 /// Per-codec scaling quality ("high"|"medium"|"low"). Maps to [`ScalingQuality`].
@@ -142,6 +154,10 @@ struct KnoraSection {
 #[serde(deny_unknown_fields)]
 struct LoggingSection {
     level: Option<String>,
+    /// Flight-recorder threshold in milliseconds; 0 = off.
+    slow_request_ms: Option<u32>,
+    /// Log lines per second written for each level below ERR; 0 = off.
+    log_rate_limit: Option<u32>,
 }
 
 /// One `[[routes]]` entry — the same shape as a Lua `routes` table row. `script`
@@ -168,6 +184,12 @@ pub enum ConfigError {
     /// rather than as a per-request 500 at the first JPEG encode (the C++ CLI
     /// path range-checks the same flag).
     JpegQualityRange(i32),
+    /// A negative `[image].j2k_layer_truncation_size` (an edge length in px;
+    /// `0` turns the layer truncation off).
+    J2kLayerTruncationSizeNegative(i32),
+    /// An `[image].j2k_gray_decode` other than `exact`, `luminance` or
+    /// `luminance_toned`.
+    J2kGrayDecodeUnknown(String),
     /// A `[[routes]]` entry whose HTTP method the shell does not serve — caught
     /// at startup rather than silently dropping the route at registration.
     UnknownRouteMethod(String),
@@ -193,6 +215,14 @@ impl std::fmt::Display for ConfigError {
             ConfigError::JpegQualityRange(q) => {
                 write!(f, "[image].jpeg_quality must be 1-100, got {q}")
             }
+            ConfigError::J2kLayerTruncationSizeNegative(n) => write!(
+                f,
+                "[image].j2k_layer_truncation_size must be >= 0 (0 = off), got {n}"
+            ),
+            ConfigError::J2kGrayDecodeUnknown(v) => write!(
+                f,
+                "[image].j2k_gray_decode '{v}' is not supported (use exact, luminance, or luminance_toned)"
+            ),
             ConfigError::UnknownRouteMethod(m) => write!(
                 f,
                 "[[routes]] method '{m}' is not supported (use GET, HEAD, POST, PUT, DELETE, or OPTIONS)"
@@ -237,6 +267,18 @@ impl Config {
             }
         }
 
+        if let Some(n) = effective.j2k_layer_truncation_size {
+            if n < 0 {
+                return Err(ConfigError::J2kLayerTruncationSizeNegative(n));
+            }
+        }
+
+        if let Some(v) = &effective.j2k_gray_decode {
+            if !matches!(v.as_str(), "exact" | "luminance" | "luminance_toned") {
+                return Err(ConfigError::J2kGrayDecodeUnknown(v.clone()));
+            }
+        }
+
         let script_dir = effective.scriptdir.clone().unwrap_or_default();
         let has_relative = self
             .routes
@@ -288,6 +330,9 @@ impl Config {
             cache_dir: self.cache.dir.clone(),
             cache_size: self.cache.size.clone(),
             cache_nfiles: self.cache.n_files,
+            shadow_dir: self.cache.shadow_dir.clone(),
+            shadow_max_size: self.cache.shadow_max_size.clone(),
+            shadow_hot_threshold: self.cache.shadow_hot_threshold,
             memory_limit: self.limits.memory_limit.clone(),
             admission_mode: self.limits.admission_mode.clone(),
             tiles_memory_ratio: self.limits.tiles_memory_ratio,
@@ -297,6 +342,8 @@ impl Config {
             knorapath: self.knora.path.clone(),
             knoraport: self.knora.port.clone(),
             loglevel: self.logging.level.clone(),
+            slow_request_ms: self.logging.slow_request_ms,
+            log_rate_limit: self.logging.log_rate_limit,
             jpeg_quality: self.image.jpeg_quality,
             scaling_quality: ScalingQuality {
                 jpeg: self.image.scaling_quality.jpeg.clone(),
@@ -304,6 +351,8 @@ impl Config {
                 png: self.image.scaling_quality.png.clone(),
                 j2k: self.image.scaling_quality.j2k.clone(),
             },
+            j2k_layer_truncation_size: self.image.j2k_layer_truncation_size,
+            j2k_gray_decode: self.image.j2k_gray_decode.clone(),
             // Lua-config-only fields (the TOML schema deliberately owns no
             // transport keys; these feed the Lua `config` table for scripts).
             hostname: None,
@@ -341,6 +390,9 @@ www_route = "/server"
 dir = "/cache"
 size = "200M"
 n_files = 250
+shadow_dir = "/shadows"
+shadow_max_size = "20G"
+shadow_hot_threshold = 5
 
 [limits]
 max_post_size = "300M"
@@ -349,6 +401,8 @@ thumb_size = "!128,128"
 [image]
 jpeg_quality = 90
 scaling_quality = { jpeg = "high", tiff = "medium", png = "low", j2k = "high" }
+j2k_layer_truncation_size = 512
+j2k_gray_decode = "luminance"
 
 [tls_auth]
 jwt_secret = "secret"
@@ -360,6 +414,8 @@ port = "443"
 
 [logging]
 level = "INFO"
+slow_request_ms = 2000
+log_rate_limit = 50
 
 [[routes]]
 method = "POST"
@@ -378,6 +434,9 @@ script = "upload.lua"
         assert_eq!(base.cache_dir.as_deref(), Some("/cache"));
         assert_eq!(base.cache_size.as_deref(), Some("200M"));
         assert_eq!(base.cache_nfiles, Some(250));
+        assert_eq!(base.shadow_dir.as_deref(), Some("/shadows"));
+        assert_eq!(base.shadow_max_size.as_deref(), Some("20G"));
+        assert_eq!(base.shadow_hot_threshold, Some(5));
         assert_eq!(base.maxpost.as_deref(), Some("300M"));
         assert_eq!(base.thumbsize.as_deref(), Some("!128,128"));
         assert_eq!(base.jpeg_quality, Some(90));
@@ -386,10 +445,14 @@ script = "upload.lua"
         // j2k maps through Rust-side; the engine currently ignores it (it reads
         // that slot under a legacy "jpk" key), but the value must still parse.
         assert_eq!(base.scaling_quality.j2k.as_deref(), Some("high"));
+        assert_eq!(base.j2k_layer_truncation_size, Some(512));
+        assert_eq!(base.j2k_gray_decode.as_deref(), Some("luminance"));
         assert_eq!(base.jwtkey.as_deref(), Some("secret"));
         assert_eq!(base.adminuser.as_deref(), Some("root"));
         assert_eq!(base.knorapath.as_deref(), Some("knora.example.org"));
         assert_eq!(base.loglevel.as_deref(), Some("INFO"));
+        assert_eq!(base.slow_request_ms, Some(2000));
+        assert_eq!(base.log_rate_limit, Some(50));
     }
 
     #[test]
@@ -443,6 +506,32 @@ script = "/abs/x.lua"
         ));
     }
 
+    #[test]
+    fn negative_j2k_layer_truncation_size_is_rejected() {
+        let toml = "[paths]\nimg_root = \"/imgroot\"\n[image]\nj2k_layer_truncation_size = -1\n";
+        let cfg: Config = toml::from_str(toml).unwrap();
+        assert!(matches!(
+            cfg.resolve(ServerOverrides::default()),
+            Err(ConfigError::J2kLayerTruncationSizeNegative(-1))
+        ));
+    }
+
+    #[test]
+    fn negative_slow_request_ms_fails_to_parse() {
+        let toml = "[paths]\nimg_root = \"/imgroot\"\n[logging]\nslow_request_ms = -1\n";
+        assert!(toml::from_str::<Config>(toml).is_err());
+    }
+
+    #[test]
+    fn unknown_j2k_gray_decode_is_rejected() {
+        let toml = "[paths]\nimg_root = \"/imgroot\"\n[image]\nj2k_gray_decode = \"luma\"\n";
+        let cfg: Config = toml::from_str(toml).unwrap();
+        assert!(matches!(
+            cfg.resolve(ServerOverrides::default()),
+            Err(ConfigError::J2kGrayDecodeUnknown(v)) if v == "luma"
+        ));
+    }
+
     #[test]
     fn missing_img_root_is_an_error() {
         let cfg: Config = toml::from_str("[network]\nport = 1024\n").unwrap();
@@ -25,6 +25,14 @@ use crate::config::{OverridesHolder, ServerOverrides, SipiServerConfig};
 /// Returns 0 on success, non-zero on a write failure.
 pub type SipiWriteFn = extern "C" fn(ctx: *mut c_void, data: *const u8, len: usize) -> c_int;
 
+/// Frees a buffer handed over through [`SipiWriteOwnedFn`]. Callable from any thread.
+pub type SipiReleaseFn = extern "C" fn(data: *mut u8);
+
+/// Like [`SipiWriteFn`], but ownership of `data` passes to the sink, which must
+/// call `release(data)` exactly once when done with it — also on failure.
+pub type SipiWriteOwnedFn =
+    extern "C" fn(ctx: *mut c_void, data: *mut u8, len: usize, release: SipiReleaseFn) -> c_int;
+
 /// Known-length file region `[offset, offset+length)` (→ Content-Length framing,
 /// zero-copy where possible). Returns 0 on success, non-zero on a write failure.
 pub type SipiSendFileFn =
@@ -39,6 +47,17 @@ pub type SipiStatusFn = extern "C" fn(ctx: *mut c_void, status: c_int);
 /// Polled between pipeline stages; 1 = client gone / timed out → abort.
 pub type SipiCancelledFn = extern "C" fn(ctx: *mut c_void) -> c_int;
 
+/// One tile of a [`sipi_render_tiles`] batch: `status` 0 with its encoded bytes
+/// (valid only for the call), or the HTTP status it would have been served with
+/// (400/500) and no bytes. Returns 0 to continue, non-zero to stop the batch.
+pub type SipiTileFn = extern "C" fn(
+    ctx: *mut c_void,
+    index: usize,
+    status: c_int,
+    data: *const u8,
+    len: usize,
+) -> c_int;
+
 /// The response sink the engine drives. A body is delivered either as a
 /// known-length file region (`send_file`) or an unknown-length byte stream
 /// (`write`) — never both.
@@ -50,6 +69,7 @@ pub struct SipiResponse {
     pub write: Option<SipiWriteFn>,
     pub send_file: Option<SipiSendFileFn>,
     pub cancelled: Option<SipiCancelledFn>,
+    pub write_owned: Option<SipiWriteOwnedFn>,
 }
 
 // ── IIIF serve request (consumed by sipi_serve_image) ───────────────────────
@@ -288,6 +308,19 @@ pub struct SipiMetricsSnapshot {
     pub tiff_pyramid_reduced_decodes_total: u64,
     pub decode_memory_too_large_total: u64,
     pub decode_memory_shadow_too_large_total: u64,
+    pub shadow_pyramid_hits_total: u64,
+    pub shadow_pyramid_builds_total: u64,
+    pub shadow_pyramid_deferred_total: u64,
+    pub decode_cancelled_total: u64,
+    pub decode_wasted_microseconds_total: u64,
+    pub decode_degraded_total: u64,
+    pub decode_memory_waited_total: u64,
+    pub decode_memory_wait_microseconds_total: u64,
+    pub decode_memory_calibration_samples_total: u64,
+    pub decoded_pixels_total: u64,
+    pub decode_output_pixels_total: u64,
+    pub log_dropped_lines_total: u64,
+    pub log_suppressed_lines_total: u64,
     pub waiting_connections: i64,
     pub cache_size_bytes: i64,
     pub cache_files: i64,
@@ -295,6 +328,8 @@ pub struct SipiMetricsSnapshot {
     pub cache_files_limit: i64,
     pub decode_memory_budget_bytes: i64,
     pub decode_memory_used_bytes: i64,
+    pub decode_memory_waiting: i64,
+    pub decode_memory_calibration_factor_max_percent: i64,
 }
 
 /// The IIIF serve request — mirrors `SipiServeRequest` in `sipi_ffi.h`. All
@@ -313,6 +348,9 @@ pub struct SipiServeRequest {
     pub forwarded_host: *const c_char,
     pub request_uri: *const c_char,
     pub is_head: c_int,
+    /// 0 = none; otherwise the milliseconds from the plan within which to
+    /// answer, rendering a cheaper uncached variant if the exact one would miss.
+    pub deadline_ms: u32,
     pub report_error: Option<SipiReportErrorFn>,
     pub report_ctx: *mut c_void,
 }
@@ -336,6 +374,10 @@ pub struct SipiImageDims {
 /// C string, so `sipi_mimetype` hands its result back through this callback.
 pub type SipiStrFn = extern "C" fn(ctx: *mut c_void, value: *const c_char);
 
+/// Reads the process allocator's live heap bytes, negative when unavailable
+/// (mirrors `SipiHeapInUseFn`). Registered via [`sipi_set_heap_reader`].
+pub type SipiHeapInUseFn = unsafe extern "C" fn() -> i64;
+
 /// Emits an image's Essentials-packet identity — original mimetype + original
 /// filename — together (mirrors `SipiEssentialsFn`). Called at most once: both
 /// strings are known together or not at all.
@@ -411,8 +453,14 @@ pub const PHASE_SPAN_NAMES: [&str; PHASE_COUNT] = [
 /// is 0 when the phase did not run, and `failed[i]` is 1 when the phase exited
 /// via an exception (the shell then marks that span errored).
 /// `decode_estimate_bytes` is the estimated peak decode memory the budget
-/// admitted against, 0 when no decode ran. Kept in lock-step with the C struct by
-/// the `serve_timings_layout` test below.
+/// admitted against, 0 when no decode ran; `decode_measured_peak_bytes` is the
+/// decode's measured peak heap rise, 0 when it was not measured. `cpu_ns`,
+/// `sink_wait_ns`, `read_bytes` and `heap_peak_bytes` are what each phase cost:
+/// thread CPU time, time blocked in the response sink (client back-pressure),
+/// bytes read from storage, and peak heap rise. `decoded_pixels`,
+/// `output_pixels`, `source_bytes` and `response_bytes` measure the serve's
+/// decode amplification, labelled by `source_format` and `decode_path`. Kept in
+/// lock-step with the C struct by the `serve_timings_layout` test below.
 #[repr(C)]
 #[derive(Clone, Copy, Debug)]
 pub struct SipiServeTimings {
@@ -421,8 +469,46 @@ pub struct SipiServeTimings {
     pub present: [u8; PHASE_COUNT],
     pub failed: [u8; PHASE_COUNT],
     pub decode_estimate_bytes: u64,
+    pub decode_measured_peak_bytes: u64,
+    pub cpu_ns: [u64; PHASE_COUNT],
+    pub sink_wait_ns: [u64; PHASE_COUNT],
+    pub read_bytes: [u64; PHASE_COUNT],
+    pub heap_peak_bytes: [u64; PHASE_COUNT],
+    pub decoded_pixels: u64,
+    pub output_pixels: u64,
+    pub source_bytes: u64,
+    pub response_bytes: u64,
+    pub source_format: SipiFormatType,
+    pub decode_path: SipiDecodePath,
+}
+
+/// How a serve got its body (mirrors `SipiDecodePath`): `None` when it sent no
+/// image body; `Pyramid` for a reduced resolution level or a shadow pyramid;
+/// `DctScaled` for a JPEG decoded at 1/2, 1/4 or 1/8; `Copy` for a
+/// compressed-domain copy without a pixel decode.
+#[repr(C)]
+#[derive(Clone, Copy, PartialEq, Eq, Debug)]
+pub enum SipiDecodePath {
+    None = 0,
+    Full = 1,
+    DctScaled = 2,
+    Pyramid = 3,
+    Passthrough = 4,
+    CacheHit = 5,
+    Copy = 6,
 }
 
+// Compile-time value guard, paired with the C++ `static_assert`s in `sipi_ffi.h`.
+const _: () = {
+    assert!(SipiDecodePath::None as isize == 0);
+    assert!(SipiDecodePath::Full as isize == 1);
+    assert!(SipiDecodePath::DctScaled as isize == 2);
+    assert!(SipiDecodePath::Pyramid as isize == 3);
+    assert!(SipiDecodePath::Passthrough as isize == 4);
+    assert!(SipiDecodePath::CacheHit as isize == 5);
+    assert!(SipiDecodePath::Copy as isize == 6);
+};
+
 /// Take the calling thread's per-serve observations. Call right after
 /// [`sipi_serve_image`] on the same thread; every `present` is 0 when the engine
 /// recorded nothing (e.g. a cache hit or HEAD, which skip decode/encode).
@@ -434,6 +520,17 @@ pub fn serve_timings_take() -> SipiServeTimings {
         present: [0; PHASE_COUNT],
         failed: [0; PHASE_COUNT],
         decode_estimate_bytes: 0,
+        decode_measured_peak_bytes: 0,
+        cpu_ns: [0; PHASE_COUNT],
+        sink_wait_ns: [0; PHASE_COUNT],
+        read_bytes: [0; PHASE_COUNT],
+        heap_peak_bytes: [0; PHASE_COUNT],
+        decoded_pixels: 0,
+        output_pixels: 0,
+        source_bytes: 0,
+        response_bytes: 0,
+        source_format: SipiFormatType::Unsupported,
+        decode_path: SipiDecodePath::None,
     };
     // SAFETY: `out` is a valid, fully-initialised SipiServeTimings; the FFI only
     // writes its fields for the duration of the call and never retains the pointer.
@@ -441,6 +538,95 @@ pub fn serve_timings_take() -> SipiServeTimings {
     out
 }
 
+// ── Serve plans ─────────────────────────────────────────────────────────────
+
+/// How a planned IIIF request will be served (mirrors `SipiPlanRoute`). Only
+/// `Decode` holds pixels; the others need no admission beyond the plan itself.
+#[repr(C)]
+#[derive(Clone, Copy, PartialEq, Eq, Debug)]
+pub enum SipiPlanRoute {
+    Decode = 0,
+    Head = 1,
+    Passthrough = 2,
+    CacheHit = 3,
+    Copy = 4,
+}
+
+// Compile-time value guard, paired with the C++ `static_assert`s in `sipi_ffi.h`.
+const _: () = {
+    assert!(SipiPlanRoute::Decode as isize == 0);
+    assert!(SipiPlanRoute::Head as isize == 1);
+    assert!(SipiPlanRoute::Passthrough as isize == 2);
+    assert!(SipiPlanRoute::CacheHit as isize == 3);
+    assert!(SipiPlanRoute::Copy as isize == 4);
+};
+
+/// The engine's verdict on a planned request (mirrors `SipiPlanInfo`):
+/// `full_lane` is 1 when `decode_estimate_bytes` reaches
+/// `large_decode_threshold_bytes`, and the estimate is 0 unless the route is
+/// [`SipiPlanRoute::Decode`]. Kept in lock-step by the `plan_info_layout` test.
+#[repr(C)]
+#[derive(Clone, Copy, Debug)]
+pub struct SipiPlanInfo {
+    pub route: SipiPlanRoute,
+    pub full_lane: c_int,
+    pub decode_estimate_bytes: u64,
+}
+
+/// The engine's opaque plan handle (`SipiServePlan`); only ever behind a pointer.
+#[repr(C)]
+pub struct SipiServePlan {
+    _private: [u8; 0],
+}
+
+/// An owned [`sipi_plan_image`] result. Serving it hands the handle to
+/// [`sipi_serve_planned`] via [`ServePlan::into_raw`]; dropping it unserved
+/// (a shed, a gone client) frees it, releasing a pinned cache file.
+pub struct ServePlan {
+    raw: std::ptr::NonNull<SipiServePlan>,
+    pub info: SipiPlanInfo,
+}
+
+// SAFETY: the plan is plain engine-owned data with no thread affinity — the
+// per-serve observations it carries are restored on whichever thread serves it.
+unsafe impl Send for ServePlan {}
+
+impl ServePlan {
+    /// Plan `req` without decoding. `Err` carries the status to render
+    /// (400/404/500/…), exactly as `sipi_serve_image` would have returned it.
+    pub fn new(req: &SipiServeRequest) -> Result<Self, c_int> {
+        let mut raw = std::ptr::null_mut();
+        let mut info = SipiPlanInfo {
+            route: SipiPlanRoute::Decode,
+            full_lane: 0,
+            decode_estimate_bytes: 0,
+        };
+        // SAFETY: `req`'s pointers outlive this synchronous call; `raw` and
+        // `info` are valid out-params the engine only writes during it.
+        let code = unsafe { sipi_plan_image(req, &mut raw, &mut info) };
+        match std::ptr::NonNull::new(raw) {
+            Some(raw) if code == 0 => Ok(Self { raw, info }),
+            _ => Err(if code == 0 { 500 } else { code }),
+        }
+    }
+
+    /// Give up ownership for [`sipi_serve_planned`], which consumes the handle.
+    #[must_use]
+    pub fn into_raw(self) -> *mut SipiServePlan {
+        let raw = self.raw.as_ptr();
+        std::mem::forget(self);
+        raw
+    }
+}
+
+impl Drop for ServePlan {
+    fn drop(&mut self) {
+        // SAFETY: `raw` came from `sipi_plan_image` and was never handed on
+        // (`into_raw` forgets `self`), so this is its only free.
+        unsafe { sipi_plan_free(self.raw.as_ptr()) };
+    }
+}
+
 /// The engine's baked version — `version.txt`, via Bazel's build stamp. `None`
 /// only if the stamp somehow held non-UTF-8 bytes.
 #[must_use]
@@ -467,6 +653,44 @@ extern "C" {
     /// run first.
     pub fn sipi_serve_image(req: *const SipiServeRequest, resp: *const SipiResponse) -> c_int;
 
+    /// Plan an IIIF image request without decoding it — see [`ServePlan`], the
+    /// safe owner. On 0 `*plan` is a new handle and `*info` its route and exact
+    /// decode estimate; otherwise `*plan` is null and the return is the status.
+    pub fn sipi_plan_image(
+        req: *const SipiServeRequest,
+        plan: *mut *mut SipiServePlan,
+        info: *mut SipiPlanInfo,
+    ) -> c_int;
+
+    /// Serve a plan (on any thread) as [`sipi_serve_image`] would have served
+    /// its request; consumes `plan` whatever the outcome. The per-serve
+    /// observations of plan and serve are then taken together on this thread.
+    pub fn sipi_serve_planned(
+        plan: *mut SipiServePlan,
+        resp: *const SipiResponse,
+        report_error: Option<SipiReportErrorFn>,
+        report_ctx: *mut c_void,
+    ) -> c_int;
+
+    /// Free a plan that will not be served. Null is a no-op.
+    pub fn sipi_plan_free(plan: *mut SipiServePlan);
+
+    /// Render `count` IIIF requests of one image against a single open decoder
+    /// (one TIFF handle / JPEG2000 codestream), reporting every index exactly
+    /// once through `emit`. `restricted_size`/`watermark_path` carry the
+    /// preflight's restriction to every tile (null = none); nothing is cached.
+    /// Returns 0, 404/400/500/503 before any tile, or 499 when `emit` stopped
+    /// the batch.
+    pub fn sipi_render_tiles(
+        resolved_path: *const c_char,
+        tiles: *const SipiIiifParams,
+        count: usize,
+        restricted_size: *const c_char,
+        watermark_path: *const c_char,
+        emit: SipiTileFn,
+        ctx: *mut c_void,
+    ) -> c_int;
+
     /// Copy the current thread's per-serve observations into `*out`. Call on the
     /// same thread right after [`sipi_serve_image`] returns; a null `out` is a
     /// no-op. Never fails, emits nothing.
@@ -549,6 +773,12 @@ extern "C" {
     /// pre-commit step. Returns 0, or non-zero on an internal error.
     pub fn sipi_metrics_snapshot(out: *mut SipiMetricsSnapshot) -> c_int;
 
+    /// Emit the up to `max` worst sources of the engine's decode-amplification
+    /// table, worst first, via `emit`/`ctx`. Guard-only like
+    /// `sipi_metrics_snapshot`. Returns 0, or 500 if `sipi_init` has not run.
+    pub fn sipi_decode_offenders(max: usize, emit: SipiDecodeOffenderFn, ctx: *mut c_void)
+        -> c_int;
+
     /// Header-only image-shape probe (no full decode) — also optionally emits
     /// the Essentials identity from the SAME read via `emit`/`ctx` (`None` =
     /// caller doesn't want it, e.g. info.json). When `emit` is present, it
@@ -576,6 +806,10 @@ extern "C" {
     /// engine's Lua `server.http` client injects on outbound requests so a
     /// downstream service continues this trace. NULL clears it. See `sipi_ffi.h`.
     pub fn sipi_set_outbound_traceparent(traceparent: *const c_char);
+
+    /// Register the allocator's live-heap reader the engine calibrates its
+    /// peak-memory estimate with; `None` unregisters. See `sipi_ffi.h`.
+    pub fn sipi_set_heap_reader(reader: Option<SipiHeapInUseFn>);
 }
 
 /// Stamps the C++ engine's logs (on the current thread) with a trace context for
@@ -669,6 +903,7 @@ pub fn link_self_check() -> i32 {
         write: None,
         send_file: None,
         cancelled: None,
+        write_owned: None,
     };
     let bogus = c"/sipi-rust-shell-link-self-check/does-not-exist";
     // SAFETY: `bogus` is a valid NUL-terminated C string that outlives the call;
@@ -850,6 +1085,79 @@ pub fn metrics_snapshot() -> Option<SipiMetricsSnapshot> {
     }
 }
 
+/// One source of the decode-amplification table (mirrors `SipiDecodeOffender`).
+/// `path` is only valid for the callback that receives it. Kept in lock-step by
+/// the `decode_offender_layout` test.
+#[repr(C)]
+pub struct SipiDecodeOffender {
+    pub path: *const c_char,
+    pub requests: u64,
+    pub decoded_pixels: u64,
+    pub output_pixels: u64,
+    pub amplification: f64,
+    pub error: f64,
+}
+
+/// Receives one [`SipiDecodeOffender`] (mirrors `SipiDecodeOffenderFn`).
+pub type SipiDecodeOffenderFn =
+    extern "C" fn(ctx: *mut c_void, offender: *const SipiDecodeOffender);
+
+/// An owned copy of one [`SipiDecodeOffender`].
+#[derive(Clone, Debug, PartialEq)]
+pub struct DecodeOffender {
+    pub path: String,
+    pub requests: u64,
+    pub decoded_pixels: u64,
+    pub output_pixels: u64,
+    pub amplification: f64,
+    pub error: f64,
+}
+
+/// Collects each emitted offender into the `Vec<DecodeOffender>` at `ctx`.
+extern "C" fn collect_offender(ctx: *mut c_void, offender: *const SipiDecodeOffender) {
+    // Mirror the sink callbacks: a Rust panic must not unwind into C++.
+    let _ = std::panic::catch_unwind(std::panic::AssertUnwindSafe(|| {
+        // SAFETY: `ctx` is the `&mut Vec<DecodeOffender>` passed to
+        // sipi_decode_offenders; `offender` is valid for the call.
+        let (out, o) = unsafe { (&mut *(ctx as *mut Vec<DecodeOffender>), &*offender) };
+        if o.path.is_null() {
+            return;
+        }
+        // SAFETY: the engine passes a NUL-terminated C string valid for the call.
+        let path = unsafe { CStr::from_ptr(o.path) }
+            .to_string_lossy()
+            .into_owned();
+        out.push(DecodeOffender {
+            path,
+            requests: o.requests,
+            decoded_pixels: o.decoded_pixels,
+            output_pixels: o.output_pixels,
+            amplification: o.amplification,
+            error: o.error,
+        });
+    }));
+}
+
+/// The up to `max` sources whose decodes cost the most pixels per pixel served,
+/// worst first. Empty on an internal FFI error, like [`metrics_snapshot`]'s `None`.
+#[must_use]
+pub fn decode_offenders(max: usize) -> Vec<DecodeOffender> {
+    let mut out: Vec<DecodeOffender> = Vec::new();
+    // SAFETY: `collect_offender` writes into `out` via the ctx pointer, only
+    // during the synchronous call; the seam guards exceptions.
+    let code = unsafe {
+        sipi_decode_offenders(
+            max,
+            collect_offender,
+            &mut out as *mut Vec<DecodeOffender> as *mut c_void,
+        )
+    };
+    if code != 0 {
+        out.clear();
+    }
+    out
+}
+
 /// One configured Lua route: HTTP method, the route prefix, and the script
 /// path (composed against the config's script dir by the config loader).
 #[derive(Clone)]
@@ -877,8 +1185,8 @@ pub fn image_dims(resolved_path: &str) -> Result<SipiImageDims, i32> {
     Ok(dims)
 }
 
-/// Collects the single emitted MIME string into the `Option<String>` at `ctx`.
-extern "C" fn collect_mime(ctx: *mut c_void, value: *const c_char) {
+/// Collects the single emitted string into the `Option<String>` at `ctx`.
+extern "C" fn collect_str(ctx: *mut c_void, value: *const c_char) {
     // Mirror the sink callbacks: a Rust panic must not unwind into C++.
     let _ = std::panic::catch_unwind(std::panic::AssertUnwindSafe(|| {
         // SAFETY: `ctx` is the `&mut Option<String>` passed to sipi_mimetype.
@@ -900,12 +1208,12 @@ extern "C" fn collect_mime(ctx: *mut c_void, value: *const c_char) {
 pub fn mimetype(resolved_path: &str) -> Result<String, i32> {
     let c_path = CString::new(resolved_path).map_err(|_| -1)?;
     let mut out: Option<String> = None;
-    // SAFETY: `c_path` outlives the synchronous call; `collect_mime` writes into
+    // SAFETY: `c_path` outlives the synchronous call; `collect_str` writes into
     // `out` via the ctx pointer; the seam guards exceptions.
     let code = unsafe {
         sipi_mimetype(
             c_path.as_ptr(),
-            collect_mime,
+            collect_str,
             &mut out as *mut Option<String> as *mut c_void,
         )
     };
@@ -1103,7 +1411,7 @@ mod serve_timings_layout {
         // SAFETY: a pure `return SIPI_PHASE_COUNT` accessor; no state, never fails.
         assert_eq!(PHASE_COUNT, unsafe { sipi_phase_count() } as usize);
         assert_eq!(align_of::<SipiServeTimings>(), 8);
-        assert_eq!(size_of::<SipiServeTimings>(), 120);
+        assert_eq!(size_of::<SipiServeTimings>(), 360);
         assert_eq!(offset_of!(SipiServeTimings, start_ns), 0);
         assert_eq!(offset_of!(SipiServeTimings, dur_ns), PHASE_COUNT * 8);
         assert_eq!(offset_of!(SipiServeTimings, present), 2 * PHASE_COUNT * 8);
@@ -1114,6 +1422,29 @@ mod serve_timings_layout {
         // `failed` ends at 108; the u64 that follows is 8-aligned, so four bytes
         // of padding precede it.
         assert_eq!(offset_of!(SipiServeTimings, decode_estimate_bytes), 112);
+        assert_eq!(
+            offset_of!(SipiServeTimings, decode_measured_peak_bytes),
+            120
+        );
+        assert_eq!(offset_of!(SipiServeTimings, cpu_ns), 128);
+        assert_eq!(
+            offset_of!(SipiServeTimings, sink_wait_ns),
+            128 + PHASE_COUNT * 8
+        );
+        assert_eq!(
+            offset_of!(SipiServeTimings, read_bytes),
+            128 + 2 * PHASE_COUNT * 8
+        );
+        assert_eq!(
+            offset_of!(SipiServeTimings, heap_peak_bytes),
+            128 + 3 * PHASE_COUNT * 8
+        );
+        assert_eq!(offset_of!(SipiServeTimings, decoded_pixels), 320);
+        assert_eq!(offset_of!(SipiServeTimings, output_pixels), 328);
+        assert_eq!(offset_of!(SipiServeTimings, source_bytes), 336);
+        assert_eq!(offset_of!(SipiServeTimings, response_bytes), 344);
+        assert_eq!(offset_of!(SipiServeTimings, source_format), 352);
+        assert_eq!(offset_of!(SipiServeTimings, decode_path), 356);
     }
 
     #[test]
@@ -1143,6 +1474,9 @@ mod serve_timings_layout {
         assert!(t.dur_ns.iter().all(|&d| d == 0));
         assert!(t.failed.iter().all(|&f| f == 0));
         assert_eq!(t.decode_estimate_bytes, 0);
+        assert_eq!(t.decode_measured_peak_bytes, 0);
+        assert!(t.cpu_ns.iter().all(|&c| c == 0));
+        assert!(t.sink_wait_ns.iter().all(|&w| w == 0));
     }
 }
 
@@ -1185,7 +1519,7 @@ mod metrics_snapshot_layout {
     fn repr_c_matches_metrics_snapshot_h() {
         assert_eq!(size_of::<usize>(), 8, "layout assumes an LP64 target");
         assert_eq!(align_of::<SipiMetricsSnapshot>(), 8);
-        assert_eq!(size_of::<SipiMetricsSnapshot>(), 168);
+        assert_eq!(size_of::<SipiMetricsSnapshot>(), 288);
 
         assert_eq!(offset_of!(SipiMetricsSnapshot, cache_hits_total), 0);
         assert_eq!(offset_of!(SipiMetricsSnapshot, cache_misses_total), 8);
@@ -1231,18 +1565,69 @@ mod metrics_snapshot_layout {
             offset_of!(SipiMetricsSnapshot, decode_memory_shadow_too_large_total),
             104
         );
-        assert_eq!(offset_of!(SipiMetricsSnapshot, waiting_connections), 112);
-        assert_eq!(offset_of!(SipiMetricsSnapshot, cache_size_bytes), 120);
-        assert_eq!(offset_of!(SipiMetricsSnapshot, cache_files), 128);
-        assert_eq!(offset_of!(SipiMetricsSnapshot, cache_size_limit_bytes), 136);
-        assert_eq!(offset_of!(SipiMetricsSnapshot, cache_files_limit), 144);
+        assert_eq!(
+            offset_of!(SipiMetricsSnapshot, shadow_pyramid_hits_total),
+            112
+        );
+        assert_eq!(
+            offset_of!(SipiMetricsSnapshot, shadow_pyramid_builds_total),
+            120
+        );
+        assert_eq!(
+            offset_of!(SipiMetricsSnapshot, shadow_pyramid_deferred_total),
+            128
+        );
+        assert_eq!(offset_of!(SipiMetricsSnapshot, decode_cancelled_total), 136);
+        assert_eq!(
+            offset_of!(SipiMetricsSnapshot, decode_wasted_microseconds_total),
+            144
+        );
+        assert_eq!(offset_of!(SipiMetricsSnapshot, decode_degraded_total), 152);
+        assert_eq!(
+            offset_of!(SipiMetricsSnapshot, decode_memory_waited_total),
+            160
+        );
+        assert_eq!(
+            offset_of!(SipiMetricsSnapshot, decode_memory_wait_microseconds_total),
+            168
+        );
+        assert_eq!(
+            offset_of!(SipiMetricsSnapshot, decode_memory_calibration_samples_total),
+            176
+        );
+        assert_eq!(offset_of!(SipiMetricsSnapshot, decoded_pixels_total), 184);
+        assert_eq!(
+            offset_of!(SipiMetricsSnapshot, decode_output_pixels_total),
+            192
+        );
+        assert_eq!(
+            offset_of!(SipiMetricsSnapshot, log_dropped_lines_total),
+            200
+        );
+        assert_eq!(
+            offset_of!(SipiMetricsSnapshot, log_suppressed_lines_total),
+            208
+        );
+        assert_eq!(offset_of!(SipiMetricsSnapshot, waiting_connections), 216);
+        assert_eq!(offset_of!(SipiMetricsSnapshot, cache_size_bytes), 224);
+        assert_eq!(offset_of!(SipiMetricsSnapshot, cache_files), 232);
+        assert_eq!(offset_of!(SipiMetricsSnapshot, cache_size_limit_bytes), 240);
+        assert_eq!(offset_of!(SipiMetricsSnapshot, cache_files_limit), 248);
         assert_eq!(
             offset_of!(SipiMetricsSnapshot, decode_memory_budget_bytes),
-            152
+            256
         );
         assert_eq!(
             offset_of!(SipiMetricsSnapshot, decode_memory_used_bytes),
-            160
+            264
+        );
+        assert_eq!(offset_of!(SipiMetricsSnapshot, decode_memory_waiting), 272);
+        assert_eq!(
+            offset_of!(
+                SipiMetricsSnapshot,
+                decode_memory_calibration_factor_max_percent
+            ),
+            280
         );
     }
 }
@@ -1261,13 +1646,14 @@ mod response_layout {
     fn repr_c_matches_sipi_ffi_h() {
         assert_eq!(size_of::<usize>(), 8, "layout assumes an LP64 target");
         assert_eq!(align_of::<SipiResponse>(), 8);
-        assert_eq!(size_of::<SipiResponse>(), 48);
+        assert_eq!(size_of::<SipiResponse>(), 56);
         assert_eq!(offset_of!(SipiResponse, ctx), 0);
         assert_eq!(offset_of!(SipiResponse, set_status), 8);
         assert_eq!(offset_of!(SipiResponse, add_header), 16);
         assert_eq!(offset_of!(SipiResponse, write), 24);
         assert_eq!(offset_of!(SipiResponse, send_file), 32);
         assert_eq!(offset_of!(SipiResponse, cancelled), 40);
+        assert_eq!(offset_of!(SipiResponse, write_owned), 48);
     }
 }
 
@@ -1428,6 +1814,7 @@ mod serve_request_layout {
         assert_eq!(offset_of!(SipiServeRequest, forwarded_host), 128);
         assert_eq!(offset_of!(SipiServeRequest, request_uri), 136);
         assert_eq!(offset_of!(SipiServeRequest, is_head), 144);
+        assert_eq!(offset_of!(SipiServeRequest, deadline_ms), 148);
         assert_eq!(offset_of!(SipiServeRequest, report_error), 152);
         assert_eq!(offset_of!(SipiServeRequest, report_ctx), 160);
     }
@@ -1450,3 +1837,38 @@ mod image_dims_layout {
         assert_eq!(offset_of!(SipiImageDims, tile_height), 16);
     }
 }
+
+#[cfg(test)]
+mod decode_offender_layout {
+    use super::SipiDecodeOffender;
+    use std::mem::{align_of, offset_of, size_of};
+
+    #[test]
+    fn repr_c_matches_sipi_ffi_h() {
+        assert_eq!(align_of::<SipiDecodeOffender>(), 8);
+        assert_eq!(size_of::<SipiDecodeOffender>(), 48);
+        assert_eq!(offset_of!(SipiDecodeOffender, path), 0);
+        assert_eq!(offset_of!(SipiDecodeOffender, requests), 8);
+        assert_eq!(offset_of!(SipiDecodeOffender, decoded_pixels), 16);
+        assert_eq!(offset_of!(SipiDecodeOffender, output_pixels), 24);
+        assert_eq!(offset_of!(SipiDecodeOffender, amplification), 32);
+        assert_eq!(offset_of!(SipiDecodeOffender, error), 40);
+    }
+}
+
+#[cfg(test)]
+mod plan_info_layout {
+    use super::{SipiPlanInfo, SipiPlanRoute};
+    use std::mem::{align_of, offset_of, size_of};
+
+    #[test]
+    fn repr_c_matches_sipi_ffi_h() {
+        // A C enum is int-sized; the u64 estimate makes the struct 8-aligned.
+        assert_eq!(size_of::<SipiPlanRoute>(), 4);
+        assert_eq!(align_of::<SipiPlanInfo>(), 8);
+        assert_eq!(size_of::<SipiPlanInfo>(), 16);
+        assert_eq!(offset_of!(SipiPlanInfo, route), 0);
+        assert_eq!(offset_of!(SipiPlanInfo, full_lane), 4);
+        assert_eq!(offset_of!(SipiPlanInfo, decode_estimate_bytes), 8);
+    }
+}
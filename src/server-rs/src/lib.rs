@@ -22,6 +22,7 @@ pub mod malloc_stats;
 pub mod metrics;
 pub mod path;
 pub mod preflight_cache;
+pub mod replay;
 pub mod routes;
 pub mod sink;
 pub mod telemetry;
@@ -154,94 +155,16 @@ async fn server_main(
 
     // Install the engine + config before serving. engine_context() hard-fails on
     // any serve call until this runs, so without --config only the engine-free
-    // routes (/health, /favicon.ico) work. Both config flavors are parsed
-    // Rust-side into the override channel and feed the engine a Lua-less init:
-    // a `.toml` through `config_file`, anything else as a Lua config through
-    // the scripting crate's config VM. `effective` is the overrides after the
-    // config base + CLI/env merge (the listen port folds in here for both
-    // flavors); the configured Lua routes are sourced Rust-side either way.
-    let (effective, configured_routes): (ServerOverrides, Option<Vec<ffi::RouteEntry>>) =
-        match config.as_deref() {
-            Some(cfg) if cfg.ends_with(".toml") => {
-                // Experimental (ADR-0017): the native config format may change
-                // until it is validated in production.
-                tracing::warn!(
-                    "TOML config support is experimental; the schema may change \
-                 until it is validated in production"
-                );
-                let parsed = match config_file::Config::load(cfg) {
-                    Ok(c) => c,
-                    Err(e) => {
-                        tracing::error!(config = %cfg, error = %e, "invalid TOML config");
-                        flush_telemetry(otel).await;
-                        return ExitCode::FAILURE;
-                    }
-                };
-                let (effective, routes) = match parsed.resolve(overrides) {
-                    Ok(r) => r,
-                    Err(e) => {
-                        tracing::error!(config = %cfg, error = %e, "invalid TOML config");
-                        flush_telemetry(otel).await;
-                        return ExitCode::FAILURE;
-                    }
-                };
-                // The engine default-constructs its config; these overrides then
-                // supply every value.
-                if let Err(code) = ffi::init(&effective) {
-                    tracing::error!(config = %cfg, code, "sipi_init failed");
-                    flush_telemetry(otel).await;
-                    return ExitCode::FAILURE;
-                }
-                tracing::info!(config = %cfg, "engine installed (TOML config)");
-                (effective, Some(routes))
-            }
-            Some(cfg) => {
-                // A Lua config, evaluated in the scripting crate's config VM
-                // (whitelisted, unlimited — the trusted startup path). Parse errors
-                // arrive pre-sanitized: chunk name + line, never a source echo (the
-                // file carries `jwt_secret = '…'` literally), so logging `e` here
-                // cannot leak it to tracing/Sentry.
-                let parsed = match scripting::parse_config_file(std::path::Path::new(cfg)) {
-                    Ok(p) => p,
-                    Err(e) => {
-                        tracing::error!(config = %cfg, error = %e, "invalid Lua config");
-                        flush_telemetry(otel).await;
-                        return ExitCode::FAILURE;
-                    }
-                };
-                let base = match ServerOverrides::from_lua_config(&parsed) {
-                    Ok(b) => b,
-                    Err(e) => {
-                        tracing::error!(config = %cfg, error = %e, "invalid Lua config");
-                        flush_telemetry(otel).await;
-                        return ExitCode::FAILURE;
-                    }
-                };
-                let routes: Vec<ffi::RouteEntry> = parsed
-                    .routes
-                    .iter()
-                    .map(|r| ffi::RouteEntry {
-                        method: r.method.clone(),
-                        route: r.route.clone(),
-                        script: config_file::compose_script_path(&parsed.script_dir, &r.script),
-                    })
-                    .collect();
-                let effective = overrides.layered_over(base);
-                if let Err(code) = ffi::init(&effective) {
-                    tracing::error!(config = %cfg, code, "sipi_init failed");
-                    flush_telemetry(otel).await;
-                    return ExitCode::FAILURE;
-                }
-                tracing::info!(config = %cfg, "engine installed (Lua config)");
-                (effective, Some(routes))
-            }
-            None => {
-                tracing::warn!(
-                    "no --config: engine uninitialised; only /health and /favicon.ico will serve"
-                );
-                (overrides, None)
-            }
-        };
+    // routes (/health, /favicon.ico) work.
+    let Ok((effective, configured_routes)) = install_engine(config.as_deref(), overrides) else {
+        flush_telemetry(otel).await;
+        return ExitCode::FAILURE;
+    };
+    if configured_routes.is_none() {
+        tracing::warn!(
+            "no --config: engine uninitialised; only /health and /favicon.ico will serve"
+        );
+    }
 
     // The Rust-hosted Lua environment: hardened runtime + init script + the
     // config-table values, built from the resolved config. The boot probe runs
@@ -344,6 +267,87 @@ async fn server_main(
     }
 }
 
+/// Resolve `config` — `.toml` natively, anything else as a Lua config — with
+/// the CLI/env `overrides` layered on top, and install the engine with the
+/// result. Returns the effective overrides and the configured Lua routes; with
+/// no config, the overrides unchanged, no routes and the engine not installed.
+/// Failures are logged here; the caller only decides how to exit.
+pub(crate) fn install_engine(
+    config: Option<&str>,
+    overrides: ServerOverrides,
+) -> Result<(ServerOverrides, Option<Vec<ffi::RouteEntry>>), ()> {
+    match config {
+        Some(cfg) if cfg.ends_with(".toml") => {
+            // Experimental (ADR-0017): the native config format may change
+            // until it is validated in production.
+            tracing::warn!(
+                "TOML config support is experimental; the schema may change \
+                 until it is validated in production"
+            );
+            let parsed = match config_file::Config::load(cfg) {
+                Ok(c) => c,
+                Err(e) => {
+                    tracing::error!(config = %cfg, error = %e, "invalid TOML config");
+                    return Err(());
+                }
+            };
+            let (effective, routes) = match parsed.resolve(overrides) {
+                Ok(r) => r,
+                Err(e) => {
+                    tracing::error!(config = %cfg, error = %e, "invalid TOML config");
+                    return Err(());
+                }
+            };
+            // The engine default-constructs its config; these overrides then
+            // supply every value.
+            if let Err(code) = ffi::init(&effective) {
+                tracing::error!(config = %cfg, code, "sipi_init failed");
+                return Err(());
+            }
+            tracing::info!(config = %cfg, "engine installed (TOML config)");
+            Ok((effective, Some(routes)))
+        }
+        Some(cfg) => {
+            // A Lua config, evaluated in the scripting crate's config VM
+            // (whitelisted, unlimited — the trusted startup path). Parse errors
+            // arrive pre-sanitized: chunk name + line, never a source echo (the
+            // file carries `jwt_secret = '…'` literally), so logging `e` here
+            // cannot leak it to tracing/Sentry.
+            let parsed = match scripting::parse_config_file(std::path::Path::new(cfg)) {
+                Ok(p) => p,
+                Err(e) => {
+                    tracing::error!(config = %cfg, error = %e, "invalid Lua config");
+                    return Err(());
+                }
+            };
+            let base = match ServerOverrides::from_lua_config(&parsed) {
+                Ok(b) => b,
+                Err(e) => {
+                    tracing::error!(config = %cfg, error = %e, "invalid Lua config");
+                    return Err(());
+                }
+            };
+            let routes: Vec<ffi::RouteEntry> = parsed
+                .routes
+                .iter()
+                .map(|r| ffi::RouteEntry {
+                    method: r.method.clone(),
+                    route: r.route.clone(),
+                    script: config_file::compose_script_path(&parsed.script_dir, &r.script),
+                })
+                .collect();
+            let effective = overrides.layered_over(base);
+            if let Err(code) = ffi::init(&effective) {
+                tracing::error!(config = %cfg, code, "sipi_init failed");
+                return Err(());
+            }
+            tracing::info!(config = %cfg, "engine installed (Lua config)");
+            Ok((effective, Some(routes)))
+        }
+        None => Ok((overrides, None)),
+    }
+}
+
 /// Flush + shut down the OTel exporter off the async runtime — the flush
 /// performs blocking I/O (the documented current-thread-shutdown deadlock is
 /// avoided by running it on a blocking thread).
@@ -61,6 +61,16 @@ pub fn set_source(source: fn() -> Option<MallocStats>) {
     let _ = SOURCE.set(source);
 }
 
+/// Register the allocator's live-heap reader with the engine, which samples it
+/// during full-lane decodes to calibrate its peak-memory estimate (call once
+/// at startup, like [`set_source`]). Without one the engine charges its static
+/// estimate. The reader must be callable from any thread.
+pub fn set_heap_reader(reader: crate::ffi::SipiHeapInUseFn) {
+    // SAFETY: `reader` is a plain function pointer the engine stores and calls
+    // for the life of the process; registration has no other precondition.
+    unsafe { crate::ffi::sipi_set_heap_reader(Some(reader)) };
+}
+
 #[cfg(all(target_os = "linux", target_env = "gnu"))]
 mod imp {
     use super::MallocStats;
@@ -28,15 +28,24 @@
 //! singleton. The read is a cheap singleton copy and collection runs at the
 //! reader interval (60s), so the ~22 reads per cycle are immaterial.
 //!
-//! Two instruments are **synchronous** rather than observable, because they
+//! Some instruments are **synchronous** rather than observable, because they
 //! record a distribution over individual requests that no end-of-interval poll
-//! can reconstruct: [`record_http_duration`] (request latency) and
-//! [`record_decode_estimate`] (per-serve decode-memory estimate). Their handles
-//! are kept in `OnceLock`s, and a request that arrives before [`register`] ran
-//! records nothing.
+//! can reconstruct: [`record_http_duration`] (request latency),
+//! [`record_decode_estimate`] (per-serve decode-memory estimate),
+//! [`record_decode_estimate_error`] (measured peak against that estimate),
+//! [`record_phase_resources`] (what each engine phase cost) and
+//! [`record_amplification`] (decoded against rendered pixels, bytes read against
+//! bytes sent, and decode throughput, per source format and decode path). Their
+//! handles are kept in `OnceLock`s, and a request that arrives before
+//! [`register`] ran records nothing.
+//!
+//! The engine's bounded table of the sources with the worst decode
+//! amplification does not fit the flat snapshot either; it is read through its
+//! own seam call ([`ffi::decode_offenders`]) by the
+//! `sipi.decode.offender.amplification` gauge, one series per listed source.
 
 use std::sync::{Arc, OnceLock};
-use std::time::Instant;
+use std::time::{Duration, Instant};
 
 use axum::extract::{MatchedPath, Request};
 use axum::middleware::Next;
@@ -46,7 +55,10 @@ use opentelemetry::{global, KeyValue};
 
 use admission::{Admission, AdmissionMode, AdmissionSnapshot};
 
-use crate::ffi::{self, SipiMetricsSnapshot};
+use crate::ffi::{
+    self, SipiDecodePath, SipiFormatType, SipiMetricsSnapshot, SipiPhase, SipiServeTimings,
+    PHASE_COUNT, PHASE_SPAN_NAMES,
+};
 use crate::malloc_stats::{self, MallocStats};
 use crate::preflight_cache;
 
@@ -71,6 +83,46 @@ const DECODE_ESTIMATE_BOUNDARIES: &[f64] = &[
     2_147_483_648.0,
 ];
 
+/// Bucket boundaries (percent) for a measured decode peak against its estimate:
+/// below 100 the estimate was generous, above it the decode outgrew its
+/// reservation.
+const ESTIMATE_ERROR_BOUNDARIES: &[f64] = &[
+    25.0, 50.0, 75.0, 90.0, 100.0, 110.0, 125.0, 150.0, 200.0, 300.0, 400.0,
+];
+
+/// Bucket boundaries (seconds) for per-phase CPU and sink-wait time: 100 µs → 10 s.
+const PHASE_TIME_BOUNDARIES: &[f64] = &[
+    0.0001, 0.0005, 0.001, 0.005, 0.01, 0.025, 0.05, 0.1, 0.25, 0.5, 1.0, 2.5, 5.0, 10.0,
+];
+
+/// Bucket boundaries (bytes) for per-phase storage reads and heap peaks: 4 KiB → 4 GiB.
+const PHASE_BYTES_BOUNDARIES: &[f64] = &[
+    4096.0,
+    65_536.0,
+    1_048_576.0,
+    16_777_216.0,
+    67_108_864.0,
+    268_435_456.0,
+    1_073_741_824.0,
+    4_294_967_296.0,
+];
+
+/// Bucket boundaries (ratio) for decoded pixels per rendered pixel and source
+/// bytes per response byte: 1 is a decode at exactly the output size, a pyramid
+/// hit sits below 4 and a full decode of a thumbnail runs into the thousands.
+const AMPLIFICATION_BOUNDARIES: &[f64] = &[
+    0.5, 1.0, 1.5, 2.0, 4.0, 8.0, 16.0, 64.0, 256.0, 1024.0, 4096.0, 16_384.0,
+];
+
+/// Bucket boundaries (megapixels per second) for decode throughput.
+const THROUGHPUT_BOUNDARIES: &[f64] = &[
+    1.0, 5.0, 10.0, 25.0, 50.0, 100.0, 200.0, 400.0, 800.0, 1600.0,
+];
+
+/// How many of the engine's worst-amplification sources the offender gauge
+/// reports each collection.
+const DECODE_OFFENDERS_REPORTED: usize = 10;
+
 /// The HTTP methods the semantic conventions treat as known; anything else is
 /// reported as `_OTHER` so a client cannot mint unbounded label values by
 /// sending arbitrary method tokens (a method router answers 405 *after* this
@@ -81,6 +133,24 @@ const KNOWN_METHODS: &[&str] = &[
 
 static HTTP_DURATION: OnceLock<Histogram<f64>> = OnceLock::new();
 static DECODE_ESTIMATE: OnceLock<Histogram<u64>> = OnceLock::new();
+static ESTIMATE_ERROR: OnceLock<Histogram<u64>> = OnceLock::new();
+
+/// The per-phase resource histograms (see [`record_phase_resources`]).
+struct PhaseResources {
+    cpu_time: Histogram<f64>,
+    sink_wait: Histogram<f64>,
+    read: Histogram<u64>,
+    heap_peak: Histogram<u64>,
+}
+static PHASE_RESOURCES: OnceLock<PhaseResources> = OnceLock::new();
+
+/// The decode-amplification histograms (see [`record_amplification`]).
+struct Amplification {
+    pixels: Histogram<f64>,
+    bytes: Histogram<f64>,
+    throughput: Histogram<f64>,
+}
+static AMPLIFICATION: OnceLock<Amplification> = OnceLock::new();
 
 /// Register the engine + admission observable instruments against the global
 /// meter. Safe to call unconditionally: with no meter provider installed (no OTLP
@@ -114,6 +184,60 @@ pub(crate) fn register(admission: Arc<Admission>) {
             .with_boundaries(DECODE_ESTIMATE_BOUNDARIES.to_vec())
             .build(),
     );
+    let _ = ESTIMATE_ERROR.set(
+        meter
+            .u64_histogram("sipi.decode_memory.estimate_error")
+            .with_description("Measured peak decode memory as a percentage of its estimate")
+            .with_unit("%")
+            .with_boundaries(ESTIMATE_ERROR_BOUNDARIES.to_vec())
+            .build(),
+    );
+    let _ = PHASE_RESOURCES.set(PhaseResources {
+        cpu_time: meter
+            .f64_histogram("sipi.engine.phase.cpu_time")
+            .with_description("Thread CPU time of one engine phase")
+            .with_unit("s")
+            .with_boundaries(PHASE_TIME_BOUNDARIES.to_vec())
+            .build(),
+        sink_wait: meter
+            .f64_histogram("sipi.engine.phase.sink_wait")
+            .with_description("Time one engine phase spent blocked writing to the client")
+            .with_unit("s")
+            .with_boundaries(PHASE_TIME_BOUNDARIES.to_vec())
+            .build(),
+        read: meter
+            .u64_histogram("sipi.engine.phase.read")
+            .with_description("Bytes one engine phase read from storage")
+            .with_unit("By")
+            .with_boundaries(PHASE_BYTES_BOUNDARIES.to_vec())
+            .build(),
+        heap_peak: meter
+            .u64_histogram("sipi.engine.phase.heap_peak")
+            .with_description("Peak heap rise during one engine phase")
+            .with_unit("By")
+            .with_boundaries(PHASE_BYTES_BOUNDARIES.to_vec())
+            .build(),
+    });
+    let _ = AMPLIFICATION.set(Amplification {
+        pixels: meter
+            .f64_histogram("sipi.decode.amplification")
+            .with_description("Pixels decoded per pixel rendered for one served image")
+            .with_unit("1")
+            .with_boundaries(AMPLIFICATION_BOUNDARIES.to_vec())
+            .build(),
+        bytes: meter
+            .f64_histogram("sipi.serve.byte_amplification")
+            .with_description("Source bytes read per response byte for one served image")
+            .with_unit("1")
+            .with_boundaries(AMPLIFICATION_BOUNDARIES.to_vec())
+            .build(),
+        throughput: meter
+            .f64_histogram("sipi.decode.throughput")
+            .with_description("Pixels decoded per second of the decode phase")
+            .with_unit("Mpx/s")
+            .with_boundaries(THROUGHPUT_BOUNDARIES.to_vec())
+            .build(),
+    });
 
     // ── Engine counters (monotonic) ─────────────────────────────────────────
     for (name, description, extract) in COUNTERS {
@@ -333,6 +457,25 @@ pub(crate) fn register(admission: Arc<Admission>) {
             .build();
     }
 
+    // ── Decode-amplification offenders ──────────────────────────────────────
+    // The engine's bounded top-N of sources by summed decoded-per-rendered
+    // pixels; a source leaves the series once it drops out of the table.
+    meter
+        .f64_observable_gauge("sipi.decode.offender.amplification")
+        .with_description(
+            "Summed decoded-per-rendered pixel ratio of the sources that amplify worst",
+        )
+        .with_unit("1")
+        .with_callback(|observer| {
+            for offender in ffi::decode_offenders(DECODE_OFFENDERS_REPORTED) {
+                observer.observe(
+                    offender.amplification,
+                    &[KeyValue::new("sipi.source", offender.path)],
+                );
+            }
+        })
+        .build();
+
     meter
         .i64_observable_gauge("sipi.preflight_cache.entries")
         .with_description(
@@ -404,7 +547,118 @@ pub(crate) fn record_decode_estimate(estimate_bytes: u64) {
     }
 }
 
-/// The 13 live monotonic counters: OTel name, description, and the field to read
+/// Record how a measured decode compared with the estimate it was admitted on,
+/// as a percentage. Only full-lane decodes that ran alone are measured; a zero
+/// measurement or estimate is not a sample.
+pub(crate) fn record_decode_estimate_error(estimate_bytes: u64, measured_bytes: u64) {
+    if estimate_bytes == 0 || measured_bytes == 0 {
+        return;
+    }
+    if let Some(histogram) = ESTIMATE_ERROR.get() {
+        let percent = u128::from(measured_bytes) * 100 / u128::from(estimate_bytes);
+        histogram.record(u64::try_from(percent).unwrap_or(u64::MAX), &[]);
+    }
+}
+
+/// Record what each engine phase of one serve cost, labelled `sipi.phase`
+/// (`shape`, `decode`, …, `encode`): thread CPU time and time blocked on the client, so
+/// codec cost and network cost separate, plus storage reads and heap peak. A
+/// phase that did not run records nothing.
+pub(crate) fn record_phase_resources(timings: &SipiServeTimings) {
+    let Some(h) = PHASE_RESOURCES.get() else {
+        return;
+    };
+    for i in 0..PHASE_COUNT {
+        if timings.present[i] == 0 {
+            continue;
+        }
+        let attributes = [KeyValue::new("sipi.phase", phase_label(i))];
+        h.cpu_time.record(
+            Duration::from_nanos(timings.cpu_ns[i]).as_secs_f64(),
+            &attributes,
+        );
+        h.sink_wait.record(
+            Duration::from_nanos(timings.sink_wait_ns[i]).as_secs_f64(),
+            &attributes,
+        );
+        h.read.record(timings.read_bytes[i], &attributes);
+        if timings.heap_peak_bytes[i] != 0 {
+            h.heap_peak.record(timings.heap_peak_bytes[i], &attributes);
+        }
+    }
+}
+
+/// Record one serve's decode amplification, labelled `sipi.format` (the source
+/// format) and `sipi.decode.path` (`pyramid`, `dct_scaled`, `full`,
+/// `passthrough`, `cache_hit` or `copy`): decoded per rendered pixels and decode
+/// megapixels per second where a decode ran, source per response bytes where
+/// both are known. A serve that sent no image body records nothing.
+pub(crate) fn record_amplification(timings: &SipiServeTimings) {
+    let Some(h) = AMPLIFICATION.get() else {
+        return;
+    };
+    let Some(path) = decode_path_label(timings.decode_path) else {
+        return;
+    };
+    let attributes = [
+        KeyValue::new("sipi.format", format_label(timings.source_format)),
+        KeyValue::new("sipi.decode.path", path),
+    ];
+    if timings.decoded_pixels > 0 && timings.output_pixels > 0 {
+        h.pixels.record(
+            timings.decoded_pixels as f64 / timings.output_pixels as f64,
+            &attributes,
+        );
+        let decode_ns = timings.dur_ns[SipiPhase::Decode as usize];
+        if decode_ns > 0 {
+            // pixels per nanosecond × 1e9 / 1e6
+            h.throughput.record(
+                timings.decoded_pixels as f64 * 1e3 / decode_ns as f64,
+                &attributes,
+            );
+        }
+    }
+    if timings.source_bytes > 0 && timings.response_bytes > 0 {
+        h.bytes.record(
+            timings.source_bytes as f64 / timings.response_bytes as f64,
+            &attributes,
+        );
+    }
+}
+
+/// The `sipi.decode.path` label of a decode path, `None` for no image body.
+fn decode_path_label(path: SipiDecodePath) -> Option<&'static str> {
+    match path {
+        SipiDecodePath::None => None,
+        SipiDecodePath::Full => Some("full"),
+        SipiDecodePath::DctScaled => Some("dct_scaled"),
+        SipiDecodePath::Pyramid => Some("pyramid"),
+        SipiDecodePath::Passthrough => Some("passthrough"),
+        SipiDecodePath::CacheHit => Some("cache_hit"),
+        SipiDecodePath::Copy => Some("copy"),
+    }
+}
+
+/// The `sipi.format` label of a source format.
+fn format_label(format: SipiFormatType) -> &'static str {
+    match format {
+        SipiFormatType::Unsupported => "other",
+        SipiFormatType::Jpg => "jpg",
+        SipiFormatType::Tif => "tif",
+        SipiFormatType::Png => "png",
+        SipiFormatType::Gif => "gif",
+        SipiFormatType::Jp2 => "jp2",
+        SipiFormatType::Pdf => "pdf",
+        SipiFormatType::Webp => "webp",
+    }
+}
+
+/// The short phase name (`decode`) of phase index `i`, from its span name.
+fn phase_label(i: usize) -> &'static str {
+    PHASE_SPAN_NAMES[i].trim_start_matches("sipi.engine.")
+}
+
+/// The 26 live monotonic counters: OTel name, description, and the field to read
 /// from a snapshot. (`rejected_connections_total` is omitted — transport-dead.)
 type CounterRow = (&'static str, &'static str, fn(&SipiMetricsSnapshot) -> u64);
 const COUNTERS: &[CounterRow] = &[
@@ -465,9 +719,72 @@ const COUNTERS: &[CounterRow] = &[
         "TIFF decodes served from a reduced pyramid level",
         |s| s.tiff_pyramid_reduced_decodes_total,
     ),
+    (
+        "sipi.shadow_pyramid.hits",
+        "Flat-source decodes served from a shadow pyramid",
+        |s| s.shadow_pyramid_hits_total,
+    ),
+    (
+        "sipi.shadow_pyramid.builds",
+        "Shadow pyramids built for hot flat sources",
+        |s| s.shadow_pyramid_builds_total,
+    ),
+    (
+        "sipi.shadow_pyramid.deferred",
+        "Shadow pyramid builds deferred for lack of full-lane budget",
+        |s| s.shadow_pyramid_deferred_total,
+    ),
+    (
+        "sipi.decode.cancelled",
+        "Decodes aborted mid-decode because the client left",
+        |s| s.decode_cancelled_total,
+    ),
+    (
+        "sipi.decode.wasted_microseconds",
+        "Decode time spent on requests whose client left before the encode",
+        |s| s.decode_wasted_microseconds_total,
+    ),
+    (
+        "sipi.decode.degraded",
+        "Requests rendered cheaper than asked to meet their deadline",
+        |s| s.decode_degraded_total,
+    ),
+    (
+        "sipi.decode_memory.waited",
+        "Decode-memory budget: acquisitions admitted after waiting in the queue",
+        |s| s.decode_memory_waited_total,
+    ),
+    (
+        "sipi.decode_memory.wait_microseconds",
+        "Decode-memory budget: time admitted requests spent in the queue",
+        |s| s.decode_memory_wait_microseconds_total,
+    ),
+    (
+        "sipi.decode_memory.calibration_samples",
+        "Decode-memory calibration: measured decodes recorded",
+        |s| s.decode_memory_calibration_samples_total,
+    ),
+    ("sipi.decode.pixels", "Pixels decoded by the codecs", |s| {
+        s.decoded_pixels_total
+    }),
+    (
+        "sipi.decode.output_pixels",
+        "Pixels rendered from those decodes",
+        |s| s.decode_output_pixels_total,
+    ),
+    (
+        "sipi.log.dropped",
+        "Engine log lines dropped because the log buffer was full",
+        |s| s.log_dropped_lines_total,
+    ),
+    (
+        "sipi.log.suppressed",
+        "Engine log lines held back by the per-level log rate limit",
+        |s| s.log_suppressed_lines_total,
+    ),
 ];
 
-/// The 6 live gauges: OTel name, description, unit (`""` = none), and the field.
+/// The 8 live gauges: OTel name, description, unit (`""` = none), and the field.
 /// (`waiting_connections` is omitted — transport-dead.)
 type GaugeRow = (
     &'static str,
@@ -506,6 +823,18 @@ const GAUGES: &[GaugeRow] = &[
         "By",
         |s| s.decode_memory_used_bytes,
     ),
+    (
+        "sipi.decode_memory.waiting",
+        "Full-lane decodes waiting for decode-memory budget",
+        "",
+        |s| s.decode_memory_waiting,
+    ),
+    (
+        "sipi.decode_memory.calibration_factor_max",
+        "Decode-memory calibration: largest correction of the static estimate",
+        "%",
+        |s| s.decode_memory_calibration_factor_max_percent,
+    ),
 ];
 
 /// The process-allocator gauges: OTel name, description, and the field to
@@ -631,8 +960,8 @@ fn admission_float_gauge(
 
 #[cfg(test)]
 mod tests {
-    use super::{COUNTERS, GAUGES, MALLOC_GAUGES};
-    use crate::ffi::SipiMetricsSnapshot;
+    use super::{decode_path_label, phase_label, COUNTERS, GAUGES, MALLOC_GAUGES};
+    use crate::ffi::{SipiDecodePath, SipiMetricsSnapshot, PHASE_COUNT};
     use std::collections::HashSet;
     use std::mem::size_of;
 
@@ -695,6 +1024,36 @@ mod tests {
         }
     }
 
+    #[test]
+    fn phase_labels_are_the_bare_phase_names() {
+        assert_eq!(phase_label(1), "decode");
+        for i in 0..PHASE_COUNT {
+            let label = phase_label(i);
+            assert!(
+                !label.is_empty() && !label.contains('.'),
+                "{label} is not a bare phase name"
+            );
+        }
+    }
+
+    #[test]
+    fn decode_path_labels_are_distinct_and_no_body_is_unlabelled() {
+        assert_eq!(decode_path_label(SipiDecodePath::None), None);
+        let labels: Vec<_> = [
+            SipiDecodePath::Full,
+            SipiDecodePath::DctScaled,
+            SipiDecodePath::Pyramid,
+            SipiDecodePath::Passthrough,
+            SipiDecodePath::CacheHit,
+            SipiDecodePath::Copy,
+        ]
+        .into_iter()
+        .map(|p| decode_path_label(p).expect("a body path is labelled"))
+        .collect();
+        let unique: HashSet<_> = labels.iter().collect();
+        assert_eq!(unique.len(), labels.len());
+    }
+
     /// Every table-driven instrument name: engine counters and gauges, then
     /// the allocator gauges.
     fn names() -> Vec<&'static str> {
@@ -0,0 +1,871 @@
+//! Access-log replay (`sipi replay`): drive the engine with recorded traffic,
+//! offline, to size a node or compare two configs on the same workload.
+//!
+//! A log of IIIF request targets with timestamps is replayed in-process through
+//! the router the server mounts ([`crate::app`]) — classification, path
+//! resolution under the image root, the two-lane admission pool and the FFI
+//! serve entry — with no socket in between. The Lua routes and preflight hooks
+//! are not run: every identifier resolves to its default path under the image
+//! root, so a local copy of the images the log names is all a replay needs.
+//!
+//! Two pacings ([`Pace`]):
+//! - open loop: each request is sent at its logged offset from the first one,
+//!   divided by the speed-up, whether or not earlier ones have finished — the
+//!   arrival process of the real traffic, compressed or stretched;
+//! - closed loop: a fixed number of clients each send the next logged request
+//!   as soon as their previous one has completed.
+//!
+//! The report carries the latency percentiles and histogram (until the body is
+//! fully read), the count per status, and per window of replay time the
+//! requests completed, the cache hit rate, the decode-memory budget rejections
+//! and waits, the 503 sheds and the process's peak RSS so far.
+
+use std::collections::BTreeMap;
+use std::fs::File;
+use std::io::{BufRead, BufReader};
+use std::path::PathBuf;
+use std::process::ExitCode;
+use std::sync::atomic::{AtomicUsize, Ordering};
+use std::sync::{Arc, Mutex};
+use std::time::{Duration, Instant};
+
+use axum::body::Body;
+use axum::http::{Method, Request, Uri};
+use axum::Router;
+use tokio::task::JoinSet;
+use tokio_stream::StreamExt;
+use tower::ServiceExt;
+use tracing_subscriber::EnvFilter;
+
+use crate::config::ServerOverrides;
+use crate::ffi::{self, SipiMetricsSnapshot};
+use crate::routes;
+
+/// How requests are released.
+#[derive(Debug, Clone, Copy, PartialEq)]
+pub enum Pace {
+    /// At the logged offsets divided by `speed` (2.0 replays twice as fast).
+    Open { speed: f64 },
+    /// `concurrency` clients, each sending its next request when the last one is done.
+    Closed { concurrency: usize },
+}
+
+/// Everything `sipi replay` takes besides the engine config.
+#[derive(Debug, Clone)]
+pub struct ReplayOptions {
+    /// The access log: Common/Combined Log Format, or `<unix-seconds> [GET|HEAD] <target>`.
+    pub log: PathBuf,
+    pub pace: Pace,
+    /// Length of one row of the over-time report.
+    pub window: Duration,
+    /// Replay only the first `limit` requests of the log.
+    pub limit: Option<usize>,
+    /// Print the report as one JSON document instead of text.
+    pub json: bool,
+    /// The admission-pool knobs, as for `sipi server`.
+    pub nthreads: Option<u32>,
+    pub tiles_thread_ratio: Option<f64>,
+    pub max_waiting: Option<u64>,
+    pub queue_timeout: Option<u32>,
+}
+
+/// One request of the log, as replayed.
+#[derive(Debug, Clone, PartialEq)]
+pub struct LogEntry {
+    /// Offset from the earliest request of the log.
+    pub at: Duration,
+    pub head: bool,
+    /// Path and query, e.g. `/iiif/3/book/page1.jp2/full/max/0/default.jpg`.
+    pub target: String,
+}
+
+/// A parsed log line before the offsets are known.
+#[derive(Debug, Clone, PartialEq)]
+struct Logged {
+    /// Unix seconds.
+    secs: f64,
+    /// The timestamp had whole-second resolution (CLF), so requests sharing it
+    /// are spread across that second rather than released as one burst.
+    whole_second: bool,
+    head: bool,
+    target: String,
+}
+
+/// Replay `options.log` against the engine installed from `config` and
+/// `overrides`, then print the report to stdout.
+pub fn run(config: Option<String>, overrides: ServerOverrides, options: ReplayOptions) -> ExitCode {
+    // Diagnostics go to stderr so stdout carries only the report; not the
+    // server's telemetry, which logs JSON to stdout and exports over OTLP.
+    let _ = tracing_subscriber::fmt()
+        .with_writer(std::io::stderr)
+        .with_env_filter(
+            EnvFilter::try_from_default_env().unwrap_or_else(|_| EnvFilter::new("warn")),
+        )
+        .try_init();
+
+    let valid_pace = match options.pace {
+        Pace::Open { speed } => speed.is_finite() && speed > 0.0,
+        Pace::Closed { concurrency } => concurrency > 0,
+    };
+    if !valid_pace || options.window.is_zero() {
+        tracing::error!(pace = ?options.pace, window = ?options.window, "invalid replay pacing");
+        return ExitCode::FAILURE;
+    }
+
+    // Parse the log first, so a bad path or an empty log fails before the
+    // engine builds its cache.
+    let (entries, skipped) = match read_log(&options.log, options.limit) {
+        Ok(r) => r,
+        Err(e) => {
+            tracing::error!(log = %options.log.display(), error = %e, "cannot read the access log");
+            return ExitCode::FAILURE;
+        }
+    };
+    if skipped > 0 {
+        tracing::warn!(
+            skipped,
+            "access-log lines without a GET or HEAD request were skipped"
+        );
+    }
+    if entries.is_empty() {
+        tracing::error!(log = %options.log.display(), "no replayable requests in the access log");
+        return ExitCode::FAILURE;
+    }
+
+    let runtime = match tokio::runtime::Builder::new_multi_thread()
+        .enable_all()
+        .build()
+    {
+        Ok(rt) => rt,
+        Err(e) => {
+            tracing::error!(error = %e, "failed to build the tokio runtime");
+            return ExitCode::FAILURE;
+        }
+    };
+    runtime.block_on(replay_main(config, overrides, options, entries, skipped))
+}
+
+async fn replay_main(
+    config: Option<String>,
+    mut overrides: ServerOverrides,
+    options: ReplayOptions,
+    entries: Vec<LogEntry>,
+    skipped: usize,
+) -> ExitCode {
+    // The engine logs each request at INFO; a replay keeps only its warnings
+    // unless --loglevel asks for more.
+    if overrides.loglevel.is_none() {
+        overrides.loglevel = Some("WARN".to_string());
+    }
+    let installed = match config.as_deref() {
+        Some(_) => crate::install_engine(config.as_deref(), overrides).map(|_| ()),
+        None => ffi::init(&overrides).map_err(|code| tracing::error!(code, "sipi_init failed")),
+    };
+    if installed.is_err() {
+        return ExitCode::FAILURE;
+    }
+
+    // No Lua routes, no preflight: identifiers resolve under the image root.
+    let state = match routes::AppState::load(
+        None,
+        None,
+        None,
+        options.nthreads,
+        options.tiles_thread_ratio,
+        options.max_waiting,
+        options.queue_timeout,
+        None,
+        None,
+    ) {
+        Ok(s) => s,
+        Err(e) => {
+            tracing::error!(error = %e, "invalid admission config");
+            return ExitCode::FAILURE;
+        }
+    };
+    let app = crate::app(Arc::new(state));
+
+    let samples = Arc::new(Mutex::new(Vec::with_capacity(entries.len())));
+    let ticks = Arc::new(Mutex::new(vec![tick(Duration::ZERO)]));
+    let start = Instant::now();
+
+    let sampler = {
+        let ticks = Arc::clone(&ticks);
+        let window = options.window;
+        tokio::spawn(async move {
+            let mut interval = tokio::time::interval_at((start + window).into(), window);
+            loop {
+                interval.tick().await;
+                let t = tick(start.elapsed());
+                ticks.lock().unwrap_or_else(|p| p.into_inner()).push(t);
+            }
+        })
+    };
+
+    let total = entries.len();
+    let mut tasks = JoinSet::new();
+    match options.pace {
+        Pace::Open { speed } => {
+            for entry in entries {
+                tokio::time::sleep_until((start + entry.at.div_f64(speed)).into()).await;
+                let (app, samples) = (app.clone(), Arc::clone(&samples));
+                tasks.spawn(async move {
+                    let sample = send(app, &entry, start).await;
+                    samples
+                        .lock()
+                        .unwrap_or_else(|p| p.into_inner())
+                        .push(sample);
+                });
+            }
+        }
+        Pace::Closed { concurrency } => {
+            let entries = Arc::new(entries);
+            let next = Arc::new(AtomicUsize::new(0));
+            for _ in 0..concurrency.clamp(1, total) {
+                let (app, samples) = (app.clone(), Arc::clone(&samples));
+                let (entries, next) = (Arc::clone(&entries), Arc::clone(&next));
+                tasks.spawn(async move {
+                    while let Some(entry) = entries.get(next.fetch_add(1, Ordering::Relaxed)) {
+                        let sample = send(app.clone(), entry, start).await;
+                        samples
+                            .lock()
+                            .unwrap_or_else(|p| p.into_inner())
+                            .push(sample);
+                    }
+                });
+            }
+        }
+    }
+    while tasks.join_next().await.is_some() {}
+    sampler.abort();
+
+    let elapsed = start.elapsed();
+    let mut ticks = std::mem::take(&mut *ticks.lock().unwrap_or_else(|p| p.into_inner()));
+    ticks.push(tick(elapsed));
+    let samples = std::mem::take(&mut *samples.lock().unwrap_or_else(|p| p.into_inner()));
+
+    let report = Report::build(&samples, &ticks, elapsed, skipped);
+    if options.json {
+        println!("{}", report.to_json(options.pace));
+    } else {
+        print!("{}", report.to_text(options.pace));
+    }
+    ExitCode::SUCCESS
+}
+
+/// One completed request.
+#[derive(Debug, Clone, Copy)]
+struct Sample {
+    /// Since the start of the replay.
+    done_at: Duration,
+    latency: Duration,
+    status: u16,
+    bytes: u64,
+}
+
+/// The engine counters and the peak RSS at one point of the replay.
+#[derive(Debug, Clone, Copy)]
+struct Tick {
+    at: Duration,
+    snapshot: SipiMetricsSnapshot,
+    peak_rss_bytes: u64,
+}
+
+fn tick(at: Duration) -> Tick {
+    Tick {
+        at,
+        snapshot: ffi::metrics_snapshot().unwrap_or_default(),
+        peak_rss_bytes: peak_rss_bytes(),
+    }
+}
+
+/// Send one request through the router and read its body to the end.
+async fn send(app: Router, entry: &LogEntry, start: Instant) -> Sample {
+    let sent = Instant::now();
+    let method = if entry.head {
+        Method::HEAD
+    } else {
+        Method::GET
+    };
+    let request = match Request::builder()
+        .method(method)
+        .uri(entry.target.as_str())
+        .body(Body::empty())
+    {
+        Ok(r) => r,
+        // Targets were validated as URIs when the log was read.
+        Err(_) => {
+            return Sample {
+                done_at: start.elapsed(),
+                latency: sent.elapsed(),
+                status: 400,
+                bytes: 0,
+            }
+        }
+    };
+    let response = match app.oneshot(request).await {
+        Ok(r) => r,
+        Err(never) => match never {},
+    };
+    let status = response.status().as_u16();
+    let mut body = response.into_body().into_data_stream();
+    let mut bytes = 0u64;
+    while let Some(chunk) = body.next().await {
+        match chunk {
+            Ok(c) => bytes += c.len() as u64,
+            Err(_) => break,
+        }
+    }
+    Sample {
+        done_at: start.elapsed(),
+        latency: sent.elapsed(),
+        status,
+        bytes,
+    }
+}
+
+/// The process's peak resident set size so far, in bytes; 0 if unavailable.
+fn peak_rss_bytes() -> u64 {
+    // SAFETY: `rusage` is plain old data, so all-zero is a valid value.
+    let mut usage: libc::rusage = unsafe { std::mem::zeroed() };
+    // SAFETY: `usage` is a valid, writable `rusage` for the call's duration.
+    if unsafe { libc::getrusage(libc::RUSAGE_SELF, &mut usage) } != 0 {
+        return 0;
+    }
+    let max = u64::try_from(usage.ru_maxrss).unwrap_or(0);
+    // Linux reports KiB, macOS bytes.
+    if cfg!(target_os = "macos") {
+        max
+    } else {
+        max * 1024
+    }
+}
+
+// ---------------------------------------------------------------------------
+// The access log
+// ---------------------------------------------------------------------------
+
+/// Read the replayable requests of the log at `path`, in timestamp order, with
+/// the number of non-blank, non-comment lines that were not one.
+fn read_log(
+    path: &std::path::Path,
+    limit: Option<usize>,
+) -> std::io::Result<(Vec<LogEntry>, usize)> {
+    let reader = BufReader::new(File::open(path)?);
+    let mut logged = Vec::new();
+    let mut skipped = 0usize;
+    for line in reader.lines() {
+        let line = line?;
+        let trimmed = line.trim();
+        if trimmed.is_empty() || trimmed.starts_with('#') {
+            continue;
+        }
+        match parse_line(trimmed) {
+            Some(l) if l.target.parse::<Uri>().is_ok() => logged.push(l),
+            _ => skipped += 1,
+        }
+    }
+    let mut entries = entries_from(logged);
+    if let Some(limit) = limit {
+        entries.truncate(limit);
+    }
+    Ok((entries, skipped))
+}
+
+/// Order `logged` by timestamp, spread each run of requests sharing a
+/// whole-second timestamp evenly across that second, and make the offsets
+/// relative to the earliest request.
+fn entries_from(mut logged: Vec<Logged>) -> Vec<LogEntry> {
+    logged.sort_by(|a, b| a.secs.total_cmp(&b.secs));
+    let Some(origin) = logged.first().map(|l| l.secs) else {
+        return Vec::new();
+    };
+    let mut entries = Vec::with_capacity(logged.len());
+    let mut i = 0;
+    while i < logged.len() {
+        let run = logged[i..]
+            .iter()
+            .take_while(|l| l.secs == logged[i].secs && l.whole_second == logged[i].whole_second)
+            .count();
+        for (k, l) in logged[i..i + run].iter().enumerate() {
+            let spread = if l.whole_second {
+                k as f64 / run as f64
+            } else {
+                0.0
+            };
+            entries.push(LogEntry {
+                at: Duration::from_secs_f64((l.secs - origin + spread).max(0.0)),
+                head: l.head,
+                target: l.target.clone(),
+            });
+        }
+        i += run;
+    }
+    entries
+}
+
+/// Parse one log line: Common/Combined Log Format
+/// (`host - user [10/Oct/2000:13:55:36 -0700] "GET /iiif/... HTTP/1.1" 200 ...`)
+/// or the plain `<unix-seconds[.fraction]> [GET|HEAD] <target>`. Absolute URLs
+/// are reduced to their path and query. Other methods yield `None`.
+fn parse_line(line: &str) -> Option<Logged> {
+    let (secs, whole_second, method, target) = match line.find('[') {
+        Some(open) => {
+            let close = open + line[open..].find(']')?;
+            let secs = parse_clf_time(&line[open + 1..close])?;
+            let rest = &line[close + 1..];
+            let quoted = &rest[rest.find('"')? + 1..];
+            let mut request = quoted[..quoted.find('"')?].split_whitespace();
+            (secs, true, request.next()?, request.next()?)
+        }
+        None => {
+            let mut fields = line.split_whitespace();
+            let secs: f64 = fields.next()?.parse().ok()?;
+            if !secs.is_finite() {
+                return None;
+            }
+            match fields.next()? {
+                m @ ("GET" | "HEAD") => (secs, false, m, fields.next()?),
+                target => (secs, false, "GET", target),
+            }
+        }
+    };
+    let head = match method {
+        "GET" => false,
+        "HEAD" => true,
+        _ => return None,
+    };
+    let target = strip_origin(target);
+    if !target.starts_with('/') {
+        return None;
+    }
+    Some(Logged {
+        secs,
+        whole_second,
+        head,
+        target: target.to_string(),
+    })
+}
+
+/// `https://host:8080/iiif/...` → `/iiif/...`; a bare path is returned as is.
+fn strip_origin(target: &str) -> &str {
+    match target.split_once("://") {
+        Some((_, rest)) => rest.find('/').map_or("/", |slash| &rest[slash..]),
+        None => target,
+    }
+}
+
+/// `10/Oct/2000:13:55:36 -0700` → Unix seconds.
+fn parse_clf_time(stamp: &str) -> Option<f64> {
+    const MONTHS: [&str; 12] = [
+        "Jan", "Feb", "Mar", "Apr", "May", "Jun", "Jul", "Aug", "Sep", "Oct", "Nov", "Dec",
+    ];
+    let (local, zone) = stamp.split_once(' ')?;
+    let fields: Vec<&str> = local.split(['/', ':']).collect();
+    let [day, month, year, hour, minute, second] = fields.as_slice() else {
+        return None;
+    };
+    let month = MONTHS.iter().position(|m| m == month)? as i64 + 1;
+    let (day, year): (i64, i64) = (day.parse().ok()?, year.parse().ok()?);
+    let (hour, minute, second): (i64, i64, i64) = (
+        hour.parse().ok()?,
+        minute.parse().ok()?,
+        second.parse().ok()?,
+    );
+
+    let (sign, offset) = match zone.as_bytes().first()? {
+        b'+' => (1, &zone[1..]),
+        b'-' => (-1, &zone[1..]),
+        _ => return None,
+    };
+    if offset.len() != 4 {
+        return None;
+    }
+    let offset_secs =
+        sign * (offset[..2].parse::<i64>().ok()? * 3600 + offset[2..].parse::<i64>().ok()? * 60);
+
+    let local_secs =
+        days_from_civil(year, month, day) * 86_400 + hour * 3600 + minute * 60 + second;
+    Some((local_secs - offset_secs) as f64)
+}
+
+/// Days since 1970-01-01 of a proleptic Gregorian date (Hinnant's algorithm).
+fn days_from_civil(year: i64, month: i64, day: i64) -> i64 {
+    let year = if month <= 2 { year - 1 } else { year };
+    let era = if year >= 0 { year } else { year - 399 } / 400;
+    let year_of_era = year - era * 400;
+    let day_of_year = (153 * ((month + 9) % 12) + 2) / 5 + day - 1;
+    let day_of_era = year_of_era * 365 + year_of_era / 4 - year_of_era / 100 + day_of_year;
+    era * 146_097 + day_of_era - 719_468
+}
+
+// ---------------------------------------------------------------------------
+// The report
+// ---------------------------------------------------------------------------
+
+/// Upper bounds of the latency histogram, in milliseconds; the last bucket is open.
+const BUCKETS_MS: [f64; 16] = [
+    0.5, 1.0, 2.0, 5.0, 10.0, 20.0, 50.0, 100.0, 200.0, 500.0, 1000.0, 2000.0, 5000.0, 10_000.0,
+    30_000.0, 60_000.0,
+];
+
+/// The latency of the request at quantile `q` of `sorted`, by nearest rank.
+fn percentile(sorted: &[Duration], q: f64) -> Duration {
+    if sorted.is_empty() {
+        return Duration::ZERO;
+    }
+    let rank = (q * sorted.len() as f64).ceil() as usize;
+    sorted[rank.clamp(1, sorted.len()) - 1]
+}
+
+/// Counts per [`BUCKETS_MS`] bucket, plus one for the open bucket.
+fn histogram(latencies: &[Duration]) -> Vec<u64> {
+    let mut counts = vec![0u64; BUCKETS_MS.len() + 1];
+    for l in latencies {
+        let ms = l.as_secs_f64() * 1000.0;
+        let bucket = BUCKETS_MS
+            .iter()
+            .position(|&b| ms <= b)
+            .unwrap_or(BUCKETS_MS.len());
+        counts[bucket] += 1;
+    }
+    counts
+}
+
+/// One row of the over-time report: the requests completed and the engine's
+/// counter deltas between two ticks.
+#[derive(Debug, Clone, PartialEq)]
+struct Window {
+    end: Duration,
+    completed: usize,
+    shed_503: usize,
+    cache_hits: u64,
+    cache_misses: u64,
+    budget_rejected: u64,
+    budget_waited: u64,
+    peak_rss_bytes: u64,
+}
+
+impl Window {
+    fn cache_hit_rate(&self) -> Option<f64> {
+        let lookups = self.cache_hits + self.cache_misses;
+        (lookups > 0).then(|| self.cache_hits as f64 / lookups as f64)
+    }
+}
+
+/// Budget rejections: requests refused for want of budget, and those whose
+/// estimate alone exceeds it.
+fn budget_rejected(s: &SipiMetricsSnapshot) -> u64 {
+    s.decode_memory_rejected_total + s.decode_memory_too_large_total
+}
+
+struct Report {
+    elapsed: Duration,
+    skipped: usize,
+    requests: usize,
+    bytes: u64,
+    by_status: BTreeMap<u16, usize>,
+    /// Sorted ascending.
+    latencies: Vec<Duration>,
+    windows: Vec<Window>,
+    total: Window,
+}
+
+impl Report {
+    /// `ticks` starts at zero and ends at `elapsed`.
+    fn build(samples: &[Sample], ticks: &[Tick], elapsed: Duration, skipped: usize) -> Self {
+        let mut latencies: Vec<Duration> = samples.iter().map(|s| s.latency).collect();
+        latencies.sort_unstable();
+        let mut by_status = BTreeMap::new();
+        for s in samples {
+            *by_status.entry(s.status).or_insert(0) += 1;
+        }
+
+        let window = |from: &Tick, to: &Tick, first: bool| {
+            let in_window = samples
+                .iter()
+                .filter(|s| (first || s.done_at > from.at) && s.done_at <= to.at);
+            let (a, b) = (&from.snapshot, &to.snapshot);
+            Window {
+                end: to.at,
+                completed: in_window.clone().count(),
+                shed_503: in_window.filter(|s| s.status == 503).count(),
+                cache_hits: b.cache_hits_total.saturating_sub(a.cache_hits_total),
+                cache_misses: b.cache_misses_total.saturating_sub(a.cache_misses_total),
+                budget_rejected: budget_rejected(b).saturating_sub(budget_rejected(a)),
+                budget_waited: b
+                    .decode_memory_waited_total
+                    .saturating_sub(a.decode_memory_waited_total),
+                peak_rss_bytes: to.peak_rss_bytes,
+            }
+        };
+        let windows = ticks
+            .windows(2)
+            .enumerate()
+            .map(|(i, pair)| window(&pair[0], &pair[1], i == 0))
+            .collect();
+        let total = match (ticks.first(), ticks.last()) {
+            (Some(first), Some(last)) => window(first, last, true),
+            _ => window(&tick(Duration::ZERO), &tick(elapsed), true),
+        };
+
+        Report {
+            elapsed,
+            skipped,
+            requests: samples.len(),
+            bytes: samples.iter().map(|s| s.bytes).sum(),
+            by_status,
+            latencies,
+            windows,
+            total,
+        }
+    }
+
+    fn rate(&self) -> f64 {
+        self.requests as f64 / self.elapsed.as_secs_f64().max(f64::EPSILON)
+    }
+
+    fn quantiles(&self) -> [(&'static str, Duration); 5] {
+        [
+            ("p50", percentile(&self.latencies, 0.50)),
+            ("p90", percentile(&self.latencies, 0.90)),
+            ("p99", percentile(&self.latencies, 0.99)),
+            ("p999", percentile(&self.latencies, 0.999)),
+            ("max", self.latencies.last().copied().unwrap_or_default()),
+        ]
+    }
+
+    fn to_text(&self, pace: Pace) -> String {
+        use std::fmt::Write;
+        let ms = |d: Duration| d.as_secs_f64() * 1000.0;
+        let mib = |b: u64| b as f64 / (1024.0 * 1024.0);
+        let mut out = String::new();
+        let pace = match pace {
+            Pace::Open { speed } => format!("open loop x{speed}"),
+            Pace::Closed { concurrency } => format!("closed loop, concurrency {concurrency}"),
+        };
+        let _ = writeln!(
+            out,
+            "replayed {} requests in {:.1} s ({:.1} req/s, {:.1} MiB), {pace}; {} log lines skipped",
+            self.requests,
+            self.elapsed.as_secs_f64(),
+            self.rate(),
+            mib(self.bytes),
+            self.skipped
+        );
+        let statuses: Vec<String> = self
+            .by_status
+            .iter()
+            .map(|(s, n)| format!("{s}={n}"))
+            .collect();
+        let _ = writeln!(out, "status: {}", statuses.join(" "));
+        let quantiles: Vec<String> = self
+            .quantiles()
+            .iter()
+            .map(|(name, d)| format!("{name}={:.1}", ms(*d)))
+            .collect();
+        let _ = writeln!(out, "latency ms: {}", quantiles.join(" "));
+        let _ = writeln!(
+            out,
+            "cache hit rate: {}; budget rejections: {}; budget waits: {}; peak RSS: {:.1} MiB",
+            self.total
+                .cache_hit_rate()
+                .map_or_else(|| "-".to_string(), |r| format!("{:.1}%", r * 100.0)),
+            self.total.budget_rejected,
+            self.total.budget_waited,
+            mib(self.total.peak_rss_bytes)
+        );
+
+        let _ = writeln!(out, "\nlatency histogram (ms):");
+        let counts = histogram(&self.latencies);
+        for (i, n) in counts.iter().enumerate() {
+            let label = match BUCKETS_MS.get(i) {
+                Some(b) => format!("<= {b}"),
+                None => format!("> {}", BUCKETS_MS[BUCKETS_MS.len() - 1]),
+            };
+            let _ = writeln!(out, "  {label:>10} {n:>9}");
+        }
+
+        let _ = writeln!(
+            out,
+            "\n{:>8} {:>9} {:>9} {:>10} {:>9} {:>9} {:>12}",
+            "end_s", "requests", "shed_503", "cache_hit", "rejected", "waited", "peak_rss_mib"
+        );
+        for w in &self.windows {
+            let _ = writeln!(
+                out,
+                "{:>8.1} {:>9} {:>9} {:>10} {:>9} {:>9} {:>12.1}",
+                w.end.as_secs_f64(),
+                w.completed,
+                w.shed_503,
+                w.cache_hit_rate()
+                    .map_or_else(|| "-".to_string(), |r| format!("{:.1}%", r * 100.0)),
+                w.budget_rejected,
+                w.budget_waited,
+                mib(w.peak_rss_bytes)
+            );
+        }
+        out
+    }
+
+    fn to_json(&self, pace: Pace) -> serde_json::Value {
+        let ms = |d: Duration| d.as_secs_f64() * 1000.0;
+        let pace = match pace {
+            Pace::Open { speed } => serde_json::json!({ "mode": "open", "speed": speed }),
+            Pace::Closed { concurrency } => {
+                serde_json::json!({ "mode": "closed", "concurrency": concurrency })
+            }
+        };
+        let quantiles: serde_json::Map<String, serde_json::Value> = self
+            .quantiles()
+            .iter()
+            .map(|(name, d)| (format!("{name}_ms"), ms(*d).into()))
+            .collect();
+        let buckets: Vec<serde_json::Value> = histogram(&self.latencies)
+            .iter()
+            .enumerate()
+            .map(|(i, n)| serde_json::json!({ "le_ms": BUCKETS_MS.get(i), "count": n }))
+            .collect();
+        let window = |w: &Window| {
+            serde_json::json!({
+                "end_s": w.end.as_secs_f64(),
+                "requests": w.completed,
+                "shed_503": w.shed_503,
+                "cache_hits": w.cache_hits,
+                "cache_misses": w.cache_misses,
+                "cache_hit_rate": w.cache_hit_rate(),
+                "budget_rejected": w.budget_rejected,
+                "budget_waited": w.budget_waited,
+                "peak_rss_bytes": w.peak_rss_bytes,
+            })
+        };
+        serde_json::json!({
+            "pace": pace,
+            "requests": self.requests,
+            "skipped_lines": self.skipped,
+            "elapsed_s": self.elapsed.as_secs_f64(),
+            "requests_per_s": self.rate(),
+            "response_bytes": self.bytes,
+            "status": self.by_status.iter().map(|(s, n)| (s.to_string(), *n)).collect::<BTreeMap<_, _>>(),
+            "latency": quantiles,
+            "latency_histogram": buckets,
+            "total": window(&self.total),
+            "windows": self.windows.iter().map(window).collect::<Vec<_>>(),
+        })
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn parses_combined_log_format() {
+        let line = r#"10.0.0.1 - - [10/Oct/2000:13:55:36 -0700] "GET /iiif/3/a.jp2/full/max/0/default.jpg HTTP/1.1" 200 2326 "-" "curl/8""#;
+        let l = parse_line(line).unwrap();
+        assert_eq!(l.secs, 971_211_336.0);
+        assert!(l.whole_second);
+        assert!(!l.head);
+        assert_eq!(l.target, "/iiif/3/a.jp2/full/max/0/default.jpg");
+    }
+
+    #[test]
+    fn parses_plain_lines_and_absolute_urls() {
+        let l =
+            parse_line("1700000000.250 HEAD https://iiif.example.org:8443/iiif/3/a.tif/info.json")
+                .unwrap();
+        assert_eq!(l.secs, 1_700_000_000.25);
+        assert!(!l.whole_second);
+        assert!(l.head);
+        assert_eq!(l.target, "/iiif/3/a.tif/info.json");
+
+        let l = parse_line("1700000001 /iiif/3/a.tif/full/256,/0/default.jpg?x=1").unwrap();
+        assert!(!l.head);
+        assert_eq!(l.target, "/iiif/3/a.tif/full/256,/0/default.jpg?x=1");
+    }
+
+    #[test]
+    fn rejects_other_methods_and_garbage() {
+        assert_eq!(
+            parse_line(r#"h - - [10/Oct/2000:13:55:36 +0000] "POST /api/upload HTTP/1.1" 200 1"#),
+            None
+        );
+        assert_eq!(
+            parse_line(r#"h - - [10/Foo/2000:13:55:36 +0000] "GET / HTTP/1.1" 200 1"#),
+            None
+        );
+        assert_eq!(parse_line("not a log line"), None);
+        assert_eq!(parse_line("NaN GET /a"), None);
+        assert_eq!(parse_line("1700000000 GET relative/path"), None);
+    }
+
+    #[test]
+    fn clf_time_honours_the_zone_offset() {
+        assert_eq!(parse_clf_time("01/Jan/1970:00:00:00 +0000"), Some(0.0));
+        assert_eq!(parse_clf_time("01/Jan/1970:01:00:00 +0100"), Some(0.0));
+        assert_eq!(
+            parse_clf_time("29/Feb/2024:23:59:59 -0030"),
+            Some(1_709_252_999.0)
+        );
+        assert_eq!(parse_clf_time("29/Feb/2024:23:59:59"), None);
+    }
+
+    #[test]
+    fn whole_second_runs_are_spread_and_offsets_start_at_zero() {
+        let logged = |secs: f64, whole_second: bool, target: &str| Logged {
+            secs,
+            whole_second,
+            head: false,
+            target: target.to_string(),
+        };
+        let entries = entries_from(vec![
+            logged(101.0, true, "/c"),
+            logged(100.0, true, "/a"),
+            logged(100.0, true, "/b"),
+            logged(100.0, true, "/b2"),
+            logged(100.0, true, "/b3"),
+            logged(102.5, false, "/d"),
+        ]);
+        let at: Vec<(f64, &str)> = entries
+            .iter()
+            .map(|e| (e.at.as_secs_f64(), e.target.as_str()))
+            .collect();
+        assert_eq!(
+            at,
+            [
+                (0.0, "/a"),
+                (0.25, "/b"),
+                (0.5, "/b2"),
+                (0.75, "/b3"),
+                (1.0, "/c"),
+                (2.5, "/d")
+            ]
+        );
+    }
+
+    #[test]
+    fn percentiles_use_the_nearest_rank() {
+        let sorted: Vec<Duration> = (1..=1000).map(Duration::from_millis).collect();
+        assert_eq!(percentile(&sorted, 0.50), Duration::from_millis(500));
+        assert_eq!(percentile(&sorted, 0.99), Duration::from_millis(990));
+        assert_eq!(percentile(&sorted, 0.999), Duration::from_millis(999));
+        assert_eq!(percentile(&sorted, 1.0), Duration::from_millis(1000));
+        assert_eq!(percentile(&[], 0.5), Duration::ZERO);
+    }
+
+    #[test]
+    fn histogram_buckets_are_inclusive_upper_bounds() {
+        let counts = histogram(&[
+            Duration::from_micros(500),
+            Duration::from_micros(501),
+            Duration::from_millis(3),
+            Duration::from_secs(120),
+        ]);
+        assert_eq!(counts.len(), BUCKETS_MS.len() + 1);
+        assert_eq!(counts[0], 1);
+        assert_eq!(counts[1], 1);
+        assert_eq!(counts[3], 1);
+        assert_eq!(counts[BUCKETS_MS.len()], 1);
+        assert_eq!(counts.iter().sum::<u64>(), 4);
+    }
+}
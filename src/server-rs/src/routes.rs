@@ -23,7 +23,7 @@ use tempfile::NamedTempFile;
 use tokio::sync::{mpsc, oneshot};
 
 use admission::{
-    Acquired, Admission, AdmissionConfig, AdmissionError, AdmissionKind, AdmissionMode,
+    Acquired, Admission, AdmissionConfig, AdmissionError, AdmissionKind, AdmissionMode, Permit,
 };
 use iiif_parser::{ParsedRequest, RequestKind};
 
@@ -275,16 +275,19 @@ pub async fn iiif(
     }
 
     // Everything else drives the blocking C++ engine (the per-call preflight VM,
-    // realpath, decode/encode). Classify the request tile/full and admit it to
-    // that partition of the two-lane pool, running the work on a blocking thread
-    // so the async runtime stays responsive; a shed/timeout returns 503 +
-    // Retry-After. /health, /favicon, and OPTIONS are separate routes that never
-    // reach here.
-    let permit = match state
-        .admission
-        .acquire(state.admission.classify(&parsed))
-        .await
-    {
+    // realpath, decode/encode). Admit the request to the two-lane pool, running
+    // the work on a blocking thread so the async runtime stays responsive; a
+    // shed/timeout returns 503 + Retry-After. An IIIF image request enters as a
+    // tile — planning it reads only the source header — and is re-admitted on
+    // the engine's own estimate once planned (`admit_plan`); the other kinds are
+    // classified here. /health, /favicon, and OPTIONS are separate routes that
+    // never reach here.
+    let kind = if parsed.kind == RequestKind::Iiif {
+        AdmissionKind::Tile
+    } else {
+        state.admission.classify(&parsed)
+    };
+    let permit = match state.admission.acquire(kind).await {
         Acquired::Admitted(permit) => permit,
         Acquired::Shed | Acquired::TimedOut => return busy_response(),
     };
@@ -301,9 +304,9 @@ pub async fn iiif(
     // The engine commits the head (status + headers) on the oneshot, then streams
     // body chunks on the bounded mpsc as it produces them. A slow client
     // stalls the engine thread; a disconnect drops the receiver, which
-    // the engine's cancelled() poll and a failed body send both observe, aborting
     // the work. The pool permit is held for the whole dispatch — released when the
-    // blocking task ends (after the last chunk), restoring the concurrency bound.
+    // blocking task ends (after the last chunk), restoring the concurrency bound —
+    // unless the image plan trades it for a full permit or gives it back.
     let (outcome_tx, outcome_rx) = oneshot::channel::<Outcome>();
     let (body_tx, body_rx) = mpsc::channel::<sink::BodyItem>(sink::BODY_CHANNEL_CAP);
     // Carry the request span (created by OtelAxumLayer) onto the blocking thread
@@ -311,10 +314,9 @@ pub async fn iiif(
     // stamps the C++ engine logs.
     let request_span = tracing::Span::current();
     tokio::task::spawn_blocking(move || {
-        let _permit = permit; // released when the engine work (decode/encode/stream) completes
         let _entered = request_span.enter();
         dispatch_engine(
-            &state, &parsed, &method, &uri, &headers, outcome_tx, body_tx,
+            &state, &parsed, &method, &uri, &headers, permit, outcome_tx, body_tx,
         );
     });
     match outcome_rx.await {
@@ -357,13 +359,16 @@ pub async fn iiif(
 /// the serve call (decode/encode, or raw `/file`). Split out of [`iiif`] so the
 /// async runtime never blocks on the C++ engine. Redirects are handled by the
 /// caller before the pool; file downloads are handled here, ahead of the IIIF
-/// JSON/image kinds.
+/// JSON/image kinds. `permit` is released when the dispatch returns (after the
+/// last chunk), except where [`admit_plan`] replaces it.
+#[allow(clippy::too_many_arguments)]
 fn dispatch_engine(
     state: &AppState,
     parsed: &ParsedRequest,
     method: &Method,
     uri: &Uri,
     headers: &HeaderMap,
+    permit: Permit,
     outcome_tx: oneshot::Sender<Outcome>,
     body_tx: mpsc::Sender<sink::BodyItem>,
 ) {
@@ -429,6 +434,7 @@ fn dispatch_engine(
                 *method == Method::HEAD,
                 &access,
                 &state.admission,
+                permit,
                 outcome_tx,
                 body_tx,
             );
@@ -693,8 +699,10 @@ fn resolve(infile: &str, resolved_root: &str) -> Result<String, Box<Response>> {
 
 // ── Serve handlers ──────────────────────────────────────────────────────────
 
-/// IIIF image via `sipi_serve_image`, honouring a `restrict` decision's
-/// `size`/`watermark` from the preflight kv channel.
+/// IIIF image via `sipi_plan_image` + `sipi_serve_planned`, honouring a
+/// `restrict` decision's `size`/`watermark` from the preflight kv channel. The
+/// plan runs under the tile `permit`; [`admit_plan`] then settles the permit
+/// the serve holds from the plan's route and exact decode estimate.
 // Single-caller engine-dispatch glue; the arguments are the distinct FFI inputs,
 // not a bundle worth a struct.
 #[allow(clippy::too_many_arguments)]
@@ -706,6 +714,7 @@ fn serve_image(
     is_head: bool,
     access: &Access,
     admission: &Admission,
+    permit: Permit,
     outcome_tx: oneshot::Sender<Outcome>,
     body_tx: mpsc::Sender<sink::BodyItem>,
 ) {
@@ -715,7 +724,7 @@ fn serve_image(
         .into();
     let (scheme, host) = forwarded(headers);
 
-    // Every C string must outlive the synchronous sipi_serve_image call.
+    // Every C string must outlive the synchronous plan and serve calls.
     let (c_resolved, c_prefix, c_identifier) = match (
         CString::new(resolved),
         CString::new(parsed.prefix.as_str()),
@@ -752,6 +761,7 @@ fn serve_image(
         forwarded_host: c_host.as_ptr(),
         request_uri: c_uri.as_ptr(),
         is_head: i32::from(is_head),
+        deadline_ms: deadline_ms(headers),
         // A handled decode/convert/write error is reported as a side-channel
         // (never part of the response); `report_ctx` reuses `c_uri` — the
         // request URI already lives on the request, so it isn't duplicated
@@ -761,40 +771,91 @@ fn serve_image(
     };
 
     // Wall-clock anchor for the engine child spans: the per-phase offsets the
-    // engine records (monotonic) are added onto this. Captured just before the
-    // call, a hair earlier than the engine's own monotonic origin — an accepted,
-    // sub-microsecond skew (one struct build, no I/O, in between).
+    // engine records (monotonic, from the start of the plan) are added onto this.
+    // Captured just before the plan, a hair earlier than the engine's own
+    // monotonic origin — an accepted, sub-microsecond skew (one struct build, no
+    // I/O, in between).
     let engine_start = SystemTime::now();
-    // SAFETY: every pointer in `req` outlives this synchronous call; the seam
-    // guards C++ exceptions (→ status code, never an unwind into Rust). The
-    // streamed head's CORS header is added by the caller (`iiif`).
-    sink::serve_streaming(outcome_tx, body_tx, |resp: &SipiResponse| unsafe {
-        ffi::sipi_serve_image(&req, resp)
-    });
+    match ffi::ServePlan::new(&req) {
+        Err(code) => complete(outcome_tx, sink::error_response(sink::map_status(code))),
+        Ok(plan) => match admit_plan(admission, &plan.info, permit) {
+            // Shed: dropping the plan releases a pinned cache file.
+            Err(busy) => complete(outcome_tx, *busy),
+            // SAFETY: `report_ctx` (`c_uri`) outlives this synchronous call; the
+            // seam consumes the plan and guards C++ exceptions (→ status code,
+            // never an unwind into Rust). The streamed head's CORS header is
+            // added by the caller (`iiif`).
+            Ok(_permit) => {
+                sink::serve_streaming(outcome_tx, body_tx, |resp: &SipiResponse| unsafe {
+                    ffi::sipi_serve_planned(plan.into_raw(), resp, req.report_error, req.report_ctx)
+                })
+            }
+        },
+    }
     // Read back what the engine observed about this call, once. The decode-memory
-    // estimate feeds a metric and the per-phase timings feed child spans; metrics
-    // and traces are independent pipelines, so the take is unconditional.
+    // estimate, per-phase resource costs and decode amplification feed metrics
+    // and the per-phase timings feed child spans; metrics and traces are
+    // independent pipelines, so the take is unconditional.
     let observed = ffi::serve_timings_take();
     crate::metrics::record_decode_estimate(observed.decode_estimate_bytes);
-    // Compare the shell's pre-dispatch partition against the engine's precise
-    // verdict (estimate ≥ threshold), bumping the disagreement counter on drift.
-    // A zero estimate (cache hit / HEAD / passthrough) records nothing.
+    crate::metrics::record_decode_estimate_error(
+        observed.decode_estimate_bytes,
+        observed.decode_measured_peak_bytes,
+    );
+    crate::metrics::record_phase_resources(&observed);
+    crate::metrics::record_amplification(&observed);
+    // Admission follows the plan, so the shell's URL-only classifier no longer
+    // gates anything; comparing it with the engine's verdict (estimate ≥
+    // threshold) still counts how often it would have been wrong. A zero
+    // estimate (cache hit / HEAD / passthrough / copy) records nothing.
     admission.record_classification(admission.classify(parsed), observed.decode_estimate_bytes);
     // Break the opaque engine span open: one child span per phase (decode,
     // encode, …) under `sipi.serve`, from the timings the engine just recorded.
     emit_engine_phase_spans(engine_start, &observed);
 }
 
+/// Settle the permit a planned IIIF request is served under. A decode below the
+/// full-lane threshold or a compressed-domain copy keeps the tile `permit` that
+/// covered planning. A full-lane decode trades it for a full permit, released
+/// first so the full waits in the full queue rather than on a global permit it
+/// already holds (the full-first ordering in [`Admission::acquire`]); runs on
+/// the blocking thread, so the wait blocks it via the runtime handle. A route
+/// that decodes nothing — HEAD, passthrough, cache hit — gives the permit back
+/// and streams unthrottled. `Err` is the 503 for a shed or timed-out full.
+fn admit_plan(
+    admission: &Admission,
+    info: &ffi::SipiPlanInfo,
+    permit: Permit,
+) -> Result<Option<Permit>, Box<Response>> {
+    match info.route {
+        ffi::SipiPlanRoute::Head
+        | ffi::SipiPlanRoute::Passthrough
+        | ffi::SipiPlanRoute::CacheHit => Ok(None),
+        ffi::SipiPlanRoute::Copy => Ok(Some(permit)),
+        ffi::SipiPlanRoute::Decode if info.full_lane == 0 => Ok(Some(permit)),
+        ffi::SipiPlanRoute::Decode => {
+            drop(permit);
+            match tokio::runtime::Handle::current().block_on(admission.acquire(AdmissionKind::Full))
+            {
+                Acquired::Admitted(full) => Ok(Some(full)),
+                Acquired::Shed | Acquired::TimedOut => Err(Box::new(busy_response())),
+            }
+        }
+    }
+}
+
 /// Mint an OTel child span under the current `sipi.serve` span for each engine
 /// phase the just-returned `sipi_serve_image` recorded, placing it on the trace
 /// timeline from the FFI-returned per-phase offsets (relative to `engine_start`).
 /// Runs on the same blocking thread as the FFI call, so `Span::current()` is
 /// `sipi.serve`. Returns immediately when trace export is off (no throwaway spans
 /// on the hot path) or when the engine recorded nothing (cache hit / HEAD /
-/// passthrough). A phase that exited via an exception (`failed`) is marked
-/// `Status=Error`.
+/// passthrough). Each span carries what its phase cost (CPU time, time blocked
+/// on the client, storage reads, heap peak). A phase that exited via an
+/// exception (`failed`) is marked `Status=Error`.
 fn emit_engine_phase_spans(engine_start: SystemTime, timings: &ffi::SipiServeTimings) {
     use opentelemetry::trace::{Span as _, Status, Tracer as _};
+    use opentelemetry::KeyValue;
     use tracing_opentelemetry::OpenTelemetrySpanExt as _;
 
     if !crate::telemetry::tracing_active() {
@@ -814,6 +875,15 @@ fn emit_engine_phase_spans(engine_start: SystemTime, timings: &ffi::SipiServeTim
         let mut span = tracer
             .span_builder(ffi::PHASE_SPAN_NAMES[i])
             .with_start_time(start)
+            .with_attributes([
+                KeyValue::new("sipi.phase.cpu_ns", timings.cpu_ns[i] as i64),
+                KeyValue::new("sipi.phase.sink_wait_ns", timings.sink_wait_ns[i] as i64),
+                KeyValue::new("sipi.phase.read_bytes", timings.read_bytes[i] as i64),
+                KeyValue::new(
+                    "sipi.phase.heap_peak_bytes",
+                    timings.heap_peak_bytes[i] as i64,
+                ),
+            ])
             .start_with_context(&tracer, &parent_cx);
         if timings.failed[i] != 0 {
             span.set_status(Status::error("engine phase failed"));
@@ -1925,6 +1995,16 @@ fn forwarded(headers: &HeaderMap) -> (String, String) {
     (scheme, host)
 }
 
+/// The request's deadline from `X-Sipi-Deadline-Ms` (set per route by the
+/// proxy, or by a client that prefers a coarser image to a late one), else 0 =
+/// none. The engine counts it from the plan, so time spent waiting for a full
+/// permit counts against it. An unparsable value is ignored.
+fn deadline_ms(headers: &HeaderMap) -> u32 {
+    header_str(headers, "x-sipi-deadline-ms")
+        .and_then(|v| v.trim().parse().ok())
+        .unwrap_or(0)
+}
+
 /// The canonical service id: `scheme://host/[prefix/]identifier`.
 fn canonical_id(scheme: &str, host: &str, prefix: &str, identifier: &str) -> String {
     if prefix.is_empty() {
@@ -2036,6 +2116,14 @@ mod tests {
         assert_eq!(forwarded(&h), ("http".into(), "iiif.example.org".into()));
     }
 
+    #[test]
+    fn deadline_is_read_from_its_header_and_defaults_to_none() {
+        assert_eq!(deadline_ms(&headers(&[("x-sipi-deadline-ms", "250")])), 250);
+        assert_eq!(deadline_ms(&headers(&[("x-sipi-deadline-ms", "soon")])), 0);
+        assert_eq!(deadline_ms(&headers(&[("x-sipi-deadline-ms", "-5")])), 0);
+        assert_eq!(deadline_ms(&headers(&[])), 0);
+    }
+
     #[test]
     fn cors_preflight_echoes_origin_credentials_and_methods() {
         // Cookie auth: with an Origin, the preflight echoes it + credentials and
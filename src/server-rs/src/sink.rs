@@ -26,7 +26,7 @@ use std::os::raw::{c_char, c_int, c_void};
 use tokio::sync::{mpsc, oneshot};
 use tokio_stream::wrappers::ReceiverStream;
 
-use crate::ffi::SipiResponse;
+use crate::ffi::{SipiReleaseFn, SipiResponse};
 
 /// Body-chunk channel capacity: bounds in-flight memory to `CAP × chunk` and
 /// stalls the engine thread when the client drains slowly.
@@ -155,6 +155,61 @@ extern "C" fn cb_write(ctx: *mut c_void, data: *const u8, len: usize) -> c_int {
     .unwrap_or(1)
 }
 
+/// A body buffer owned by the engine's allocator, handed over through
+/// `write_owned`. Wrapped into `Bytes` without copying; dropping the last
+/// `Bytes` handle calls the engine's release function.
+struct EngineBuffer {
+    data: *mut u8,
+    len: usize,
+    release: SipiReleaseFn,
+}
+
+// SAFETY: the buffer is exclusively ours once handed over, is never mutated, and
+// the seam guarantees `release` may be called from any thread.
+unsafe impl Send for EngineBuffer {}
+// SAFETY: shared access is read-only.
+unsafe impl Sync for EngineBuffer {}
+
+impl AsRef<[u8]> for EngineBuffer {
+    fn as_ref(&self) -> &[u8] {
+        // SAFETY: the engine guarantees `data` points at `len` valid bytes until
+        // `release` is called, which only happens in `drop`.
+        unsafe { std::slice::from_raw_parts(self.data, self.len) }
+    }
+}
+
+impl Drop for EngineBuffer {
+    fn drop(&mut self) {
+        (self.release)(self.data);
+    }
+}
+
+extern "C" fn cb_write_owned(
+    ctx: *mut c_void,
+    data: *mut u8,
+    len: usize,
+    release: SipiReleaseFn,
+) -> c_int {
+    // Take ownership first, so the buffer is released on every path below —
+    // including a panic unwinding out of the closure.
+    let buffer = EngineBuffer { data, len, release };
+    std::panic::catch_unwind(std::panic::AssertUnwindSafe(move || {
+        // SAFETY: `ctx` is the `&mut StreamSink` the sink was built with; the
+        // engine calls this synchronously on the serving thread, no aliasing race.
+        let state = unsafe { &mut *(ctx as *mut StreamSink) };
+        state.send_head();
+        if buffer.data.is_null() || buffer.len == 0 {
+            return 0;
+        }
+        // Same back-pressure and disconnect handling as `cb_write`, minus the copy.
+        match state.body_tx.blocking_send(Ok(Bytes::from_owner(buffer))) {
+            Ok(()) => 0,
+            Err(_) => 1,
+        }
+    }))
+    .unwrap_or(1)
+}
+
 extern "C" fn cb_send_file(
     ctx: *mut c_void,
     path: *const c_char,
@@ -258,6 +313,7 @@ pub fn serve_streaming<F>(
         write: Some(cb_write),
         send_file: Some(cb_send_file),
         cancelled: Some(cb_cancelled),
+        write_owned: Some(cb_write_owned),
     };
     let code = call(&resp);
     // No body callback fired (HEAD / EmptyBody, or a pre-commit failure that
@@ -332,7 +388,8 @@ fn apply_headers(mut builder: Builder, headers: &[(String, String)]) -> Builder
     builder
 }
 
-fn map_status(code: i32) -> StatusCode {
+/// The HTTP status for a non-zero seam return code (500 when out of range).
+pub(crate) fn map_status(code: i32) -> StatusCode {
     StatusCode::from_u16(u16::try_from(code).unwrap_or(500))
         .unwrap_or(StatusCode::INTERNAL_SERVER_ERROR)
 }
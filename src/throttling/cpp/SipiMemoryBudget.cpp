@@ -7,6 +7,7 @@
 
 #include <algorithm>
 #include <cctype>
+#include <chrono>
 
 namespace Sipi {
 
@@ -21,8 +22,13 @@ std::optional<AdmissionMode> parse_admission_mode(const std::string &mode_str)
   return std::nullopt;
 }
 
-SipiMemoryBudget::SipiMemoryBudget(size_t total_budget, AdmissionMode mode)
-  : _budget(total_budget), _mode(mode)
+namespace {
+  // How often a queued waiter re-checks its `cancelled` callback.
+  constexpr auto kCancelPoll = std::chrono::milliseconds(50);
+}// namespace
+
+SipiMemoryBudget::SipiMemoryBudget(size_t total_budget, AdmissionMode mode, size_t max_waiters)
+  : _budget(total_budget), _mode(mode), _max_waiters(max_waiters)
 {}
 
 MemoryBudgetResult SipiMemoryBudget::try_acquire(size_t bytes)
@@ -67,20 +73,124 @@ MemoryBudgetResult SipiMemoryBudget::try_acquire(size_t bytes)
   }
 }
 
+MemoryBudgetResult SipiMemoryBudget::acquire(size_t bytes,
+                                             std::chrono::steady_clock::time_point deadline,
+                                             const std::function<bool()> &cancelled)
+{
+  // Uncontended: nobody is queued, so the lock-free path cannot overtake anyone.
+  if (_mode == AdmissionMode::BASIC || bytes == 0 || bytes > _budget || _max_waiters == 0
+      || _waiting.load() == 0) {
+    auto result = try_acquire(bytes);
+    if (result.allowed || result.exceeds_budget_alone || _mode == AdmissionMode::BASIC || _max_waiters == 0) {
+      return result;
+    }
+  }
+
+  const auto start = std::chrono::steady_clock::now();
+  std::unique_lock lock(_mutex);
+  if (_queue.size() >= _max_waiters) {
+    lock.unlock();
+    return try_acquire(bytes);
+  }
+
+  Waiter self(bytes);
+  _queue.push_back(&self);
+  _waiting.fetch_add(1);
+  // Bytes released since the lock-free attempt are only handed out here.
+  grant_waiters();
+
+  while (!self.granted) {
+    const auto now = std::chrono::steady_clock::now();
+    if (now >= deadline) break;
+    if (cancelled) {
+      // The poll calls back into the shell, so it runs unlocked; a release may
+      // grant us meanwhile, and a grant wins over a late cancel.
+      lock.unlock();
+      const bool gone = cancelled();
+      lock.lock();
+      if (self.granted || gone) break;
+    }
+    self.cv.wait_until(lock, cancelled ? std::min(deadline, now + kCancelPoll) : deadline);
+  }
+
+  const auto waited = std::chrono::steady_clock::now() - start;
+  if (self.granted) {
+    return {.allowed = true,
+            .over_budget = false,
+            .exceeds_budget_alone = false,
+            .used = _used.load(std::memory_order_relaxed),
+            .budget = _budget,
+            .waited = waited};
+  }
+  _queue.remove(&self);
+  _waiting.fetch_sub(1);
+  // A waiter that held back the ones behind it is gone; they may fit now.
+  grant_waiters();
+  return {.allowed = false,
+          .over_budget = true,
+          .exceeds_budget_alone = false,
+          .used = _used.load(std::memory_order_relaxed),
+          .budget = _budget,
+          .waited = waited};
+}
+
+bool SipiMemoryBudget::try_reserve(size_t bytes)
+{
+  size_t current = _used.load();
+  while (bytes <= _budget && current <= _budget - bytes) {
+    if (_used.compare_exchange_weak(current, current + bytes)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void SipiMemoryBudget::grant_waiters()
+{
+  auto it = _queue.begin();
+  while (it != _queue.end()) {
+    Waiter *w = *it;
+    if (try_reserve(w->bytes)) {
+      // Everyone still ahead of `w` did not fit and has now been passed once.
+      bool held = false;
+      for (auto ahead = _queue.begin(); ahead != it; ++ahead) {
+        held = ++(*ahead)->bypassed >= kMaxBypass || held;
+      }
+      w->granted = true;
+      it = _queue.erase(it);
+      _waiting.fetch_sub(1);
+      w->cv.notify_one();
+      if (held) break;
+      continue;
+    }
+    // Passed often enough: nobody behind it goes first until it fits.
+    if (w->bypassed >= kMaxBypass) break;
+    ++it;
+  }
+  if (_on_waiting) _on_waiting(_queue.size());
+}
+
 void SipiMemoryBudget::release(size_t bytes)
 {
   if (bytes == 0) {
     return;
   }
 
-  // Clamp to zero on underflow (defensive)
+  // Clamp to zero on underflow (defensive). Sequentially consistent with the
+  // queue's `_waiting` so that either this release sees a new waiter or that
+  // waiter's own grant pass sees the released bytes.
   size_t current = _used.load(std::memory_order_relaxed);
   while (true) {
     size_t desired = (current >= bytes) ? (current - bytes) : 0;
-    if (_used.compare_exchange_weak(current, desired, std::memory_order_acq_rel, std::memory_order_relaxed)) {
-      return;
+    if (_used.compare_exchange_weak(current, desired, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+      break;
     }
   }
+
+  if (_waiting.load() != 0) {
+    std::lock_guard lock(_mutex);
+    grant_waiters();
+  }
 }
 
 // --- MemoryBudgetGuard ---
@@ -102,6 +212,16 @@ MemoryBudgetGuard::~MemoryBudgetGuard()
   }
 }
 
+void MemoryBudgetGuard::shrink_to(size_t bytes)
+{
+  if (!_acquired || _budget == nullptr || bytes >= _bytes) {
+    return;
+  }
+  _budget->release(_bytes - bytes);
+  _bytes = bytes;
+  if (_on_release) _on_release();
+}
+
 MemoryBudgetGuard::MemoryBudgetGuard(MemoryBudgetGuard &&other) noexcept
   : _budget(other._budget), _bytes(other._bytes), _acquired(other._acquired),
     _on_release(std::move(other._on_release))
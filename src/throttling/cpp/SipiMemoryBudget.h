@@ -7,8 +7,12 @@
 #define SIPI_SIPIMEMORYBUDGET_H
 
 #include <atomic>
+#include <chrono>
+#include <condition_variable>
 #include <cstddef>
 #include <functional>
+#include <list>
+#include <mutex>
 #include <optional>
 #include <string>
 
@@ -32,6 +36,7 @@ struct MemoryBudgetResult
   bool exceeds_budget_alone; ///< true if this request's estimate alone exceeds the budget (permanently unservable → 413, not 503)
   size_t used;               ///< current usage after this request
   size_t budget;             ///< total budget (the full lane's byte cap)
+  std::chrono::nanoseconds waited{0}; ///< time spent in the wait queue (0 when admitted or refused without queueing)
 };
 
 /*!
@@ -42,14 +47,29 @@ struct MemoryBudgetResult
  * large image decodes. Tile decodes (below the large-decode threshold) bypass
  * the budget entirely and are never charged.
  *
+ * In ADVANCED mode a request that does not fit right now may wait in a bounded
+ * FIFO queue (`acquire`) instead of being refused at once: a burst of large
+ * decodes that finish within a second of each other is then served rather than
+ * sent away with 503 + Retry-After. Released bytes are handed to the waiters
+ * in arrival order; a waiter that does not fit yet may be passed by smaller
+ * ones behind it, but at most `kMaxBypass` times, so neither one huge request
+ * blocks many mid-size ones nor do they starve it.
+ *
  * Thread-safety: All public methods are safe to call from any thread.
  * Uses std::atomic<size_t> with compare_exchange_weak for lock-free
- * acquire/release operations.
+ * acquire/release operations; the queue's mutex is only taken while
+ * someone waits.
  */
 class SipiMemoryBudget
 {
 public:
-  SipiMemoryBudget(size_t total_budget, AdmissionMode mode);
+  /// How often a queued waiter may be passed by smaller waiters behind it
+  /// before it holds back everyone behind it until it fits.
+  static constexpr unsigned kMaxBypass = 8;
+
+  /// `max_waiters` bounds the ADVANCED wait queue; 0 disables it, so `acquire`
+  /// refuses at once like `try_acquire`.
+  SipiMemoryBudget(size_t total_budget, AdmissionMode mode, size_t max_waiters = 0);
 
   /*!
    * Try to acquire `bytes` from the budget.
@@ -65,14 +85,44 @@ public:
    */
   [[nodiscard]] MemoryBudgetResult try_acquire(size_t bytes);
 
+  /*!
+   * Acquire `bytes`, waiting in the FIFO queue until `deadline` if the budget
+   * has no room for them now.
+   *
+   * Behaves like `try_acquire` when the request is admitted at once, in BASIC
+   * mode, when its estimate alone exceeds the budget (waiting cannot help), and
+   * when the queue is full or disabled. Otherwise the caller blocks until
+   * released bytes are granted to it (allowed=true, `waited` set), `deadline`
+   * passes, or `cancelled` returns true (allowed=false; polled while waiting).
+   * While others wait, a new request queues behind them even if it would fit,
+   * so it passes them only as the bypass rule allows.
+   *
+   * @param bytes      Estimated peak memory for this decode operation
+   * @param deadline   Latest time to give up waiting
+   * @param cancelled  Optional; true once the caller no longer wants the bytes
+   * @return MemoryBudgetResult with decision and current state
+   */
+  [[nodiscard]] MemoryBudgetResult acquire(size_t bytes,
+                                           std::chrono::steady_clock::time_point deadline,
+                                           const std::function<bool()> &cancelled = nullptr);
+
   /*!
    * Release `bytes` back to the budget.
    *
    * Must be called exactly once for each successful acquire.
    * Clamps to zero on underflow (defensive — should not happen in correct usage).
+   * Lock-free unless requests are queued, which it then grants in order.
    */
   void release(size_t bytes);
 
+  /// Install a callback that receives the queue depth whenever it changes
+  /// (used for gauge updates without coupling to metrics). Called with the
+  /// queue's lock held; set it before the budget is shared.
+  void set_waiting_observer(std::function<void(size_t)> observer) { _on_waiting = std::move(observer); }
+
+  /// Requests currently queued in `acquire`.
+  [[nodiscard]] size_t waiting() const { return _waiting.load(std::memory_order_relaxed); }
+
   /// Current bytes allocated to in-flight decodes.
   [[nodiscard]] size_t used() const { return _used.load(std::memory_order_relaxed); }
 
@@ -83,16 +133,38 @@ public:
   [[nodiscard]] AdmissionMode mode() const { return _mode; }
 
 private:
+  struct Waiter
+  {
+    explicit Waiter(size_t b) : bytes(b) {}
+    size_t bytes;
+    unsigned bypassed{0}; ///< times a waiter behind this one was granted first
+    bool granted{false};
+    std::condition_variable cv;
+  };
+
+  /// Take `bytes` if they fit within the budget (ADVANCED semantics, any mode).
+  bool try_reserve(size_t bytes);
+
+  /// Grant queued waiters in order while released bytes allow; `_mutex` held.
+  void grant_waiters();
+
   std::atomic<size_t> _used{0};
   size_t _budget;
   AdmissionMode _mode;
+  size_t _max_waiters;
+  std::atomic<size_t> _waiting{0};
+  std::mutex _mutex;
+  std::list<Waiter *> _queue;
+  std::function<void(size_t)> _on_waiting;
 };
 
 /*!
  * RAII guard that releases memory budget on destruction.
  *
  * Ensures budget is released on all exit paths, including exceptions.
- * Non-copyable. Move-enabled for transfer of ownership.
+ * The reservation can shrink as the pipeline's live buffers do (`shrink_to`),
+ * so a request that has finished its large intermediate steps holds only what
+ * it still uses. Non-copyable. Move-enabled for transfer of ownership.
  */
 class MemoryBudgetGuard
 {
@@ -105,6 +177,14 @@ public:
 
   ~MemoryBudgetGuard();
 
+  /// Shrink the reservation to `bytes`, releasing the surplus to the budget at
+  /// once (granting queued requests it now fits) and firing `on_release`. A
+  /// no-op unless `bytes` is below what is held: the guard never grows.
+  void shrink_to(size_t bytes);
+
+  /// Bytes currently held (0 if not acquired or moved from).
+  [[nodiscard]] size_t bytes() const { return _acquired ? _bytes : 0; }
+
   // Non-copyable
   MemoryBudgetGuard(const MemoryBudgetGuard &) = delete;
   MemoryBudgetGuard &operator=(const MemoryBudgetGuard &) = delete;
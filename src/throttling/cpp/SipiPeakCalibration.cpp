@@ -0,0 +1,159 @@
+/*
+ * Copyright © 2016 - 2026 Swiss National Data and Service Center for the Humanities and/or DaSCH Service Platform
+ * contributors. SPDX-License-Identifier: AGPL-3.0-or-later
+ */
+
+#include "SipiPeakCalibration.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace Sipi {
+
+namespace {
+  std::atomic<HeapInUseFn> g_heap_reader{ nullptr };
+
+  // The calling thread's innermost HeapPeakScope, and how many of its open
+  // scopes want the checkpoint samples.
+  thread_local HeapPeakScope *g_active_scope = nullptr;
+  thread_local unsigned g_checkpoint_scopes = 0;
+
+  // Weight of a new ratio once a slot has kMinSamples (1/8).
+  constexpr double kRatioWeight = 0.125;
+
+  // Engine work in flight, process-wide and on the calling thread, and a count
+  // of work started, so a measurement can tell that nothing began during it.
+  std::atomic<std::uint32_t> g_in_flight{ 0 };
+  std::atomic<std::uint64_t> g_started{ 0 };
+  thread_local std::uint32_t t_in_flight = 0;
+
+  std::int64_t read_heap()
+  {
+    const HeapInUseFn reader = g_heap_reader.load(std::memory_order_acquire);
+    return reader != nullptr ? reader() : -1;
+  }
+}// namespace
+
+void set_heap_reader(HeapInUseFn reader) { g_heap_reader.store(reader, std::memory_order_release); }
+
+bool heap_reader_installed() { return g_heap_reader.load(std::memory_order_acquire) != nullptr; }
+
+HeapPeakScope::HeapPeakScope(Sampling sampling)
+  : _previous(g_active_scope), _checkpoints(sampling == Sampling::Checkpoints), _baseline(read_heap()), _high(_baseline)
+{
+  g_active_scope = this;
+  if (_checkpoints) { ++g_checkpoint_scopes; }
+}
+
+HeapPeakScope::~HeapPeakScope()
+{
+  g_active_scope = _previous;
+  if (_checkpoints) { --g_checkpoint_scopes; }
+}
+
+void HeapPeakScope::sample()
+{
+  if (g_checkpoint_scopes != 0) { g_active_scope->observe(); }
+}
+
+void HeapPeakScope::observe()
+{
+  const std::int64_t now = read_heap();
+  if (now < 0) { return; }
+  for (HeapPeakScope *scope = this; scope != nullptr; scope = scope->_previous) {
+    if (scope->_baseline >= 0 && now > scope->_high) { scope->_high = now; }
+  }
+}
+
+size_t HeapPeakScope::peak()
+{
+  if (_baseline < 0) { return 0; }
+  observe();
+  return static_cast<size_t>(_high - _baseline);
+}
+
+ServeInFlight::ServeInFlight()
+{
+  g_in_flight.fetch_add(1, std::memory_order_acq_rel);
+  if (t_in_flight++ == 0) { g_started.fetch_add(1, std::memory_order_acq_rel); }
+}
+
+ServeInFlight::~ServeInFlight()
+{
+  --t_in_flight;
+  g_in_flight.fetch_sub(1, std::memory_order_acq_rel);
+}
+
+size_t PeakCalibration::slot_index(const CalibrationKey &key)
+{
+  const unsigned codec = std::min(key.codec, kCalibrationCodecs - 1);
+  return codec * 16 + (key.reduced ? 8U : 0U) + (key.scales ? 4U : 0U) + (key.rotates ? 2U : 0U)
+         + (key.converts ? 1U : 0U);
+}
+
+size_t PeakCalibration::corrected(const CalibrationKey &key, size_t estimated) const
+{
+  const double f = factor(key);
+  if (f <= 1.0) { return estimated; }
+  return static_cast<size_t>(std::ceil(f * static_cast<double>(estimated)));
+}
+
+double PeakCalibration::factor(const CalibrationKey &key) const
+{
+  return _factors[slot_index(key)].load(std::memory_order_relaxed);
+}
+
+double PeakCalibration::max_factor() const
+{
+  double max = 1.0;
+  for (const auto &f : _factors) { max = std::max(max, f.load(std::memory_order_relaxed)); }
+  return max;
+}
+
+void PeakCalibration::record(const CalibrationKey &key, size_t estimated, size_t measured)
+{
+  if (estimated == 0) { return; }
+  const double ratio = static_cast<double>(measured) / static_cast<double>(estimated);
+  const size_t i = slot_index(key);
+
+  const std::lock_guard lock(_mutex);
+  Slot &slot = _slots[i];
+  ++slot.n;
+  const double weight = std::max(1.0 / slot.n, kRatioWeight);
+  if (slot.n == 1) {
+    slot.mean = ratio;
+  } else {
+    slot.deviation += weight * (std::abs(ratio - slot.mean) - slot.deviation);
+    slot.mean += weight * (ratio - slot.mean);
+  }
+  if (slot.n >= kMinSamples) {
+    _factors[i].store(std::clamp(slot.mean + 2.0 * slot.deviation, 1.0, kMaxFactor), std::memory_order_relaxed);
+  }
+  _samples.fetch_add(1, std::memory_order_relaxed);
+}
+
+PeakCalibration::Measurement::Measurement(PeakCalibration &calibration, const CalibrationKey &key, size_t estimated)
+  : _calibration(calibration), _key(key), _estimated(estimated),
+    _alone(g_in_flight.fetch_add(1, std::memory_order_acq_rel) == t_in_flight),
+    _ticket(g_started.fetch_add(1, std::memory_order_acq_rel) + 1)
+{}
+
+PeakCalibration::Measurement::~Measurement()
+{
+  if (!_finished) { g_in_flight.fetch_sub(1, std::memory_order_acq_rel); }
+}
+
+size_t PeakCalibration::Measurement::finish()
+{
+  if (_finished) { return 0; }
+  _finished = true;
+  const size_t measured = _heap.peak();
+  // Alone throughout: nobody was in flight at the start and nobody started since.
+  const bool alone = _alone && g_started.load(std::memory_order_acquire) == _ticket;
+  g_in_flight.fetch_sub(1, std::memory_order_acq_rel);
+  if (!alone || !_heap.valid()) { return 0; }
+  _calibration.record(_key, _estimated, measured);
+  return measured;
+}
+
+}// namespace Sipi
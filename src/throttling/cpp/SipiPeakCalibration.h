@@ -0,0 +1,199 @@
+/*
+ * Copyright © 2016 - 2026 Swiss National Data and Service Center for the Humanities and/or DaSCH Service Platform
+ * contributors. SPDX-License-Identifier: AGPL-3.0-or-later
+ */
+
+#ifndef SIPI_SIPIPEAKCALIBRATION_H
+#define SIPI_SIPIPEAKCALIBRATION_H
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+
+namespace Sipi {
+
+/// Reads the memory the process allocator holds for all threads (e.g. its
+/// committed bytes), or a negative value when the reading is unavailable. The binary that chose
+/// the allocator registers it (`set_heap_reader`); the engine itself stays
+/// allocator-agnostic, so without a reader nothing is measured.
+using HeapInUseFn = std::int64_t (*)();
+
+/// Register the heap reader (nullptr unregisters). Safe to call at any time.
+void set_heap_reader(HeapInUseFn reader);
+
+/// Whether a heap reader is registered.
+[[nodiscard]] bool heap_reader_installed();
+
+/*!
+ * Measures how far the heap rises above its level at construction while the
+ * scope is the calling thread's active one.
+ *
+ * The heap is read at construction and at every `peak()`. A `Checkpoints`
+ * scope also has it read at every `sample()` on the same thread — the codec
+ * checkpoints call it between Kakadu stripes, TIFF tiles and strips and
+ * resample row bands (decode_cancel.h), where the codecs' internal buffers are
+ * live. A reading costs an allocator process-info query, so only a calibration
+ * measurement asks for them; with none open on the thread, `sample()` reads
+ * nothing and a `Bounds` scope (a serve phase) sees only its two ends.
+ *
+ * Scopes nest, restoring the outer one on exit; a reading raises every
+ * enclosing scope too, so a phase's scope does not hide the samples from a
+ * whole-decode measurement around it.
+ */
+class HeapPeakScope
+{
+public:
+  enum class Sampling { Bounds, Checkpoints };
+
+  explicit HeapPeakScope(Sampling sampling = Sampling::Checkpoints);
+  ~HeapPeakScope();
+
+  HeapPeakScope(const HeapPeakScope &) = delete;
+  HeapPeakScope &operator=(const HeapPeakScope &) = delete;
+
+  /// Reads the heap into the calling thread's active scope; a no-op unless a
+  /// `Checkpoints` scope is open on the thread.
+  static void sample();
+
+  /// Whether the heap could be read at construction.
+  [[nodiscard]] bool valid() const { return _baseline >= 0; }
+
+  /// Highest heap level above the baseline seen so far, this call included.
+  [[nodiscard]] size_t peak();
+
+private:
+  void observe();
+
+  HeapPeakScope *_previous;
+  bool _checkpoints;
+  std::int64_t _baseline;
+  std::int64_t _high;
+};
+
+/*!
+ * Marks engine work in flight on the calling thread — a serve of any lane, a
+ * plan, a tile batch, a background build — for the calibration's "ran alone"
+ * test: a measured decode is recorded only if no other thread's work was in
+ * flight at any point during it (PeakCalibration::Measurement). The seam holds
+ * one around every entry point (sipi_guard). Nests; only the outermost one on a
+ * thread counts as new work.
+ */
+class ServeInFlight
+{
+public:
+  ServeInFlight();
+  ~ServeInFlight();
+
+  ServeInFlight(const ServeInFlight &) = delete;
+  ServeInFlight &operator=(const ServeInFlight &) = delete;
+};
+
+/// What a decode's peak memory depends on beyond its buffer sizes: the codec
+/// (an index the caller assigns, below kCalibrationCodecs), whether it decodes
+/// at a reduced resolution level, and which pipeline steps run after it.
+struct CalibrationKey
+{
+  unsigned codec{ 0 };
+  bool reduced{ false };
+  bool scales{ false };
+  bool rotates{ false };
+  bool converts{ false };//!< colour, gray or bitonal conversion
+};
+
+inline constexpr unsigned kCalibrationCodecs = 5;
+
+/*!
+ * Online correction of the static peak-memory estimate (SipiPeakMemory.h).
+ *
+ * The static model sizes the pixel buffers of read → scale → rotate → ICC but
+ * knows nothing of Kakadu's code-block and stripe buffers, libtiff's tile
+ * buffers or LCMS's transform caches. Each measured decode records the ratio of
+ * its measured peak heap rise to its static estimate under its CalibrationKey;
+ * the slot keeps a running mean and mean absolute deviation of that ratio (each
+ * new sample weighs 1/n for the first kMinSamples, then 1/8). Once a slot has
+ * kMinSamples samples, `corrected` scales the static estimate by mean + 2 ×
+ * deviation, never below the static estimate and never above kMaxFactor times
+ * it.
+ *
+ * The heap reading is process-wide, so only a decode that ran while no other
+ * engine work was in flight (ServeInFlight) is recorded (`Measurement`); the
+ * shell's own allocations remain as noise, which the deviation term absorbs.
+ *
+ * Thread-safety: `corrected` is lock-free; recording takes a mutex, once per
+ * measured decode.
+ */
+class PeakCalibration
+{
+public:
+  static constexpr unsigned kMinSamples = 8;
+  static constexpr double kMaxFactor = 4.0;
+
+  /// `estimated` corrected by the slot's factor (unchanged until it has kMinSamples).
+  [[nodiscard]] size_t corrected(const CalibrationKey &key, size_t estimated) const;
+
+  /// Record a decode of static estimate `estimated` whose heap rose by `measured`.
+  void record(const CalibrationKey &key, size_t estimated, size_t measured);
+
+  /// The slot's current factor (1.0 until it has kMinSamples).
+  [[nodiscard]] double factor(const CalibrationKey &key) const;
+
+  /// The largest factor across all slots.
+  [[nodiscard]] double max_factor() const;
+
+  /// Decodes recorded so far.
+  [[nodiscard]] std::uint64_t samples() const { return _samples.load(std::memory_order_relaxed); }
+
+  /*!
+   * Measures one decode for `record`: from construction, which reads the heap
+   * baseline, to `finish`, which records the peak rise if the decode ran alone —
+   * the calling thread's own ServeInFlight aside, nothing else in flight at
+   * construction and nothing started since. It counts as work in flight itself,
+   * so two measurements never both record. The heap is sampled on the
+   * constructing thread (HeapPeakScope).
+   */
+  class Measurement
+  {
+  public:
+    Measurement(PeakCalibration &calibration, const CalibrationKey &key, size_t estimated);
+    ~Measurement();
+
+    Measurement(const Measurement &) = delete;
+    Measurement &operator=(const Measurement &) = delete;
+
+    /// Records the decode and returns its measured peak, or 0 when it was not
+    /// recorded (no heap reader, or other engine work overlapped it).
+    size_t finish();
+
+  private:
+    PeakCalibration &_calibration;
+    CalibrationKey _key;
+    size_t _estimated;
+    bool _alone;
+    std::uint64_t _ticket;
+    bool _finished{ false };
+    HeapPeakScope _heap;
+  };
+
+private:
+  static constexpr size_t kSlots = kCalibrationCodecs * 16;
+
+  struct Slot
+  {
+    std::uint32_t n{ 0 };
+    double mean{ 0.0 };
+    double deviation{ 0.0 };
+  };
+
+  [[nodiscard]] static size_t slot_index(const CalibrationKey &key);
+
+  std::mutex _mutex;
+  std::array<Slot, kSlots> _slots{};
+  std::array<std::atomic<double>, kSlots> _factors{};
+  std::atomic<std::uint64_t> _samples{ 0 };
+};
+
+}// namespace Sipi
+
+#endif// SIPI_SIPIPEAKCALIBRATION_H
@@ -117,6 +117,78 @@ namespace Sipi {
   return peak;
 }
 
+/// PNG-specific peak-memory model.
+///
+/// SipiIOPng::read decodes a non-interlaced PNG row by row and keeps only the
+/// rows inside the Region, so no full-source buffer exists. The decode stage
+/// holds one source row plus either the cropped Region or — when the HIGH
+/// resampler streams the scale — the output buffer, one int32 output-width
+/// horizontal row and the int32 accumulator rows in flight (two on a
+/// downscale, up to ceil(out_h / region_h) + 1 on an enlarge). The stages after
+/// decode are those of estimate_peak_memory on the buffer decode leaves behind.
+///
+/// Adam7-interlaced PNGs are decoded in full; read_shape does not report
+/// interlacing, so they are not modelled here.
+///
+/// @param src_w            Source image width (one decoded row)
+/// @param region_w         Region width (decode dims from compute_decode_dims)
+/// @param region_h         Region height
+/// @param out_w            Output width after scale (0 = no scaling)
+/// @param out_h            Output height after scale (0 = no scaling)
+/// @param nc               Number of channels (0 defaults to 4)
+/// @param bps              Bits per sample (0 defaults to 8)
+/// @param rotation         Rotation angle in degrees
+/// @param needs_icc        Whether ICC conversion will run
+/// @param streaming_scale  Whether the scale runs inside the decoder (ScalingMethod::HIGH)
+/// @return Estimated peak memory in bytes
+[[nodiscard]] inline size_t estimate_peak_memory_png(
+    size_t src_w,
+    size_t region_w,
+    size_t region_h,
+    size_t out_w,
+    size_t out_h,
+    int nc,
+    int bps,
+    double rotation,
+    bool needs_icc,
+    bool streaming_scale)
+{
+  size_t channels = (nc > 0) ? static_cast<size_t>(nc) : 4;
+  size_t bytes_per_sample = (bps > 0) ? static_cast<size_t>(bps) / 8 : 1;
+  if (bytes_per_sample == 0) bytes_per_sample = 1;
+
+  constexpr size_t kMaxBuf = std::numeric_limits<size_t>::max();
+  auto sat_add = [](size_t a, size_t b) -> size_t { return (a > kMaxBuf - b) ? kMaxBuf : a + b; };
+  auto safe_buf = [](size_t w, size_t h, size_t bpp) -> size_t {
+    if (w == 0 || h == 0) return 0;
+    if (w > kMaxBuf / h) return kMaxBuf;
+    size_t pixels = w * h;
+    if (pixels > kMaxBuf / bpp) return kMaxBuf;
+    return pixels * bpp;
+  };
+
+  const size_t src_row = safe_buf(src_w, 1, channels * bytes_per_sample);
+
+  if (out_w == 0) out_w = region_w;
+  if (out_h == 0) out_h = region_h;
+  const bool scaling = out_w != region_w || out_h != region_h;
+
+  if (!streaming_scale || !scaling) {
+    const size_t decode_stage = sat_add(safe_buf(region_w, region_h, channels * bytes_per_sample), src_row);
+    return std::max(decode_stage,
+      estimate_peak_memory(region_w, region_h, out_w, out_h, nc, bps, rotation, needs_icc));
+  }
+
+  const size_t acc_row = safe_buf(out_w, 1, channels * sizeof(int32_t));
+  const size_t acc_rows = (out_h > region_h && region_h > 0) ? (out_h + region_h - 1) / region_h + 1 : 2;
+  size_t decode_stage = safe_buf(out_w, out_h, channels * bytes_per_sample);
+  decode_stage = sat_add(decode_stage, src_row);
+  decode_stage = sat_add(decode_stage, acc_row);// horizontal pass row
+  decode_stage = sat_add(decode_stage, safe_buf(acc_row, acc_rows, 1));
+
+  return std::max(decode_stage, estimate_peak_memory(out_w, out_h, 0, 0, nc, bps, rotation, needs_icc));
+}
+
 }// namespace Sipi
 
 #endif// SIPI_SIPIPEAKMEMORY_H
@@ -77,3 +77,37 @@ TEST(MemoryBudgetGuardTest, GuardMoveSemantics)
 
   EXPECT_EQ(budget.used(), 0);
 }
+
+TEST(MemoryBudgetGuardTest, ShrinkReleasesTheSurplusAtOnce)
+{
+  SipiMemoryBudget budget(1000, AdmissionMode::ADVANCED);
+  int released = 0;
+
+  {
+    ASSERT_TRUE(budget.try_acquire(800).allowed);
+    MemoryBudgetGuard guard(budget, 800, true, [&] { ++released; });
+    guard.shrink_to(300);
+    EXPECT_EQ(budget.used(), 300);
+    EXPECT_EQ(guard.bytes(), 300);
+    EXPECT_EQ(released, 1);
+
+    guard.shrink_to(500);// never grows
+    EXPECT_EQ(budget.used(), 300);
+    EXPECT_EQ(guard.bytes(), 300);
+    EXPECT_EQ(released, 1);
+  }// only what is still held is released
+
+  EXPECT_EQ(budget.used(), 0);
+  EXPECT_EQ(released, 2);
+}
+
+TEST(MemoryBudgetGuardTest, ShrinkOfAnUnacquiredGuardIsANoOp)
+{
+  SipiMemoryBudget budget(1000, AdmissionMode::ADVANCED);
+  ASSERT_TRUE(budget.try_acquire(400).allowed);
+
+  MemoryBudgetGuard guard(budget, 400, false);
+  guard.shrink_to(0);
+  EXPECT_EQ(budget.used(), 400);
+  EXPECT_EQ(guard.bytes(), 0);
+}
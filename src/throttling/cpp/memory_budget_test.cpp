@@ -6,6 +6,7 @@
 #include <gtest/gtest.h>
 
 #include <atomic>
+#include <chrono>
 #include <optional>
 #include <thread>
 #include <vector>
@@ -230,3 +231,165 @@ TEST(MemoryBudgetTest, ConcurrentAcquiresRespectBudget)
   EXPECT_FALSE(budget_ever_exceeded.load());
   EXPECT_EQ(budget.used(), 0);
 }
+
+// --- Wait queue (ADVANCED acquire) ---
+
+namespace {
+constexpr auto kLongWait = std::chrono::seconds(10);
+
+// Spin until `n` requests are queued in `budget`.
+void await_waiting(const SipiMemoryBudget &budget, size_t n)
+{
+  while (budget.waiting() != n) { std::this_thread::yield(); }
+}
+}// namespace
+
+TEST(MemoryBudgetQueueTest, DisabledQueueRefusesAtOnce)
+{
+  SipiMemoryBudget budget(1000, AdmissionMode::ADVANCED);// max_waiters = 0
+  ASSERT_TRUE(budget.try_acquire(900).allowed);
+  auto result = budget.acquire(200, std::chrono::steady_clock::now() + kLongWait);
+  EXPECT_FALSE(result.allowed);
+  EXPECT_FALSE(result.exceeds_budget_alone);
+  EXPECT_EQ(result.waited, std::chrono::nanoseconds(0));
+}
+
+TEST(MemoryBudgetQueueTest, TooLargeIsNotQueued)
+{
+  SipiMemoryBudget budget(1000, AdmissionMode::ADVANCED, 4);
+  auto result = budget.acquire(1100, std::chrono::steady_clock::now() + kLongWait);
+  EXPECT_FALSE(result.allowed);
+  EXPECT_TRUE(result.exceeds_budget_alone);// 413 — waiting cannot help
+  EXPECT_EQ(budget.waiting(), 0);
+}
+
+TEST(MemoryBudgetQueueTest, WaiterIsAdmittedOnRelease)
+{
+  SipiMemoryBudget budget(1000, AdmissionMode::ADVANCED, 4);
+  ASSERT_TRUE(budget.try_acquire(900).allowed);
+  std::optional<MemoryBudgetResult> result;
+  std::thread waiter([&] { result = budget.acquire(200, std::chrono::steady_clock::now() + kLongWait); });
+  await_waiting(budget, 1);
+  budget.release(900);
+  waiter.join();
+  ASSERT_TRUE(result.has_value());
+  EXPECT_TRUE(result->allowed);
+  EXPECT_GT(result->waited, std::chrono::nanoseconds(0));
+  EXPECT_EQ(budget.used(), 200);
+  EXPECT_EQ(budget.waiting(), 0);
+}
+
+TEST(MemoryBudgetQueueTest, WaiterTimesOutAtItsDeadline)
+{
+  SipiMemoryBudget budget(1000, AdmissionMode::ADVANCED, 4);
+  ASSERT_TRUE(budget.try_acquire(900).allowed);
+  auto result = budget.acquire(200, std::chrono::steady_clock::now() + std::chrono::milliseconds(20));
+  EXPECT_FALSE(result.allowed);
+  EXPECT_FALSE(result.exceeds_budget_alone);// still a 503
+  EXPECT_GE(result.waited, std::chrono::milliseconds(20));
+  EXPECT_EQ(budget.used(), 900);
+  EXPECT_EQ(budget.waiting(), 0);
+}
+
+TEST(MemoryBudgetQueueTest, CancelledWaiterLeavesTheQueue)
+{
+  SipiMemoryBudget budget(1000, AdmissionMode::ADVANCED, 4);
+  ASSERT_TRUE(budget.try_acquire(900).allowed);
+  std::atomic<bool> gone{false};
+  std::optional<MemoryBudgetResult> result;
+  std::thread waiter([&] {
+    result = budget.acquire(200, std::chrono::steady_clock::now() + kLongWait, [&] { return gone.load(); });
+  });
+  await_waiting(budget, 1);
+  gone = true;
+  waiter.join();
+  ASSERT_TRUE(result.has_value());
+  EXPECT_FALSE(result->allowed);
+  EXPECT_EQ(budget.waiting(), 0);
+}
+
+TEST(MemoryBudgetQueueTest, CancelPollRunsWithoutTheQueueLock)
+{
+  SipiMemoryBudget budget(1000, AdmissionMode::ADVANCED, 4);
+  ASSERT_TRUE(budget.try_acquire(900).allowed);
+  // A poll that re-enters the budget (release takes the queue lock while a
+  // request waits) must not deadlock; the grant it causes is taken.
+  bool released = false;
+  auto result = budget.acquire(200, std::chrono::steady_clock::now() + kLongWait, [&] {
+    if (!released) {
+      released = true;
+      budget.release(900);
+    }
+    return false;
+  });
+  EXPECT_TRUE(result.allowed);
+  EXPECT_EQ(budget.used(), 200);
+  EXPECT_EQ(budget.waiting(), 0);
+}
+
+TEST(MemoryBudgetQueueTest, WaitersAreGrantedInArrivalOrder)
+{
+  SipiMemoryBudget budget(1000, AdmissionMode::ADVANCED, 4);
+  ASSERT_TRUE(budget.try_acquire(1000).allowed);
+  std::vector<std::thread> waiters;
+  for (size_t i = 0; i < 3; ++i) {
+    waiters.emplace_back(
+      [&] { EXPECT_TRUE(budget.acquire(600, std::chrono::steady_clock::now() + kLongWait).allowed); });
+    await_waiting(budget, i + 1);
+  }
+  // Room for one at a time: each release admits the next in line.
+  for (size_t i = 0; i < 3; ++i) {
+    budget.release(i == 0 ? 1000 : 600);
+    waiters[i].join();
+    EXPECT_EQ(budget.waiting(), 2 - i);
+    EXPECT_EQ(budget.used(), 600);
+  }
+}
+
+TEST(MemoryBudgetQueueTest, SmallerWaitersPassAHugeOneAtMostMaxBypassTimes)
+{
+  SipiMemoryBudget budget(1000, AdmissionMode::ADVANCED, 32);
+  ASSERT_TRUE(budget.try_acquire(100).allowed);
+  ASSERT_TRUE(budget.try_acquire(900).allowed);
+  std::thread huge([&] { EXPECT_TRUE(budget.acquire(1000, std::chrono::steady_clock::now() + kLongWait).allowed); });
+  await_waiting(budget, 1);
+
+  const auto passes = static_cast<size_t>(SipiMemoryBudget::kMaxBypass);
+  std::vector<std::thread> small;
+  for (size_t i = 0; i < passes + 1; ++i) {
+    small.emplace_back(
+      [&] { EXPECT_TRUE(budget.acquire(100, std::chrono::steady_clock::now() + kLongWait).allowed); });
+    await_waiting(budget, i + 2);
+  }
+  // Room for every small one but not the huge one: kMaxBypass of them pass it,
+  // the last waits behind it.
+  budget.release(900);
+  for (size_t i = 0; i < passes; ++i) { small[i].join(); }
+  EXPECT_EQ(budget.waiting(), 2);
+  EXPECT_EQ(budget.used(), 100 + passes * 100);
+
+  budget.release(passes * 100 + 100);// the huge one fits first
+  huge.join();
+  EXPECT_EQ(budget.waiting(), 1);
+  budget.release(1000);
+  small.back().join();
+  EXPECT_EQ(budget.used(), 100);
+}
+
+TEST(MemoryBudgetQueueTest, ObserverSeesQueueDepth)
+{
+  SipiMemoryBudget budget(1000, AdmissionMode::ADVANCED, 4);
+  std::atomic<size_t> depth{0};
+  std::atomic<size_t> max_depth{0};
+  budget.set_waiting_observer([&](size_t n) {
+    depth = n;
+    if (n > max_depth) { max_depth = n; }
+  });
+  ASSERT_TRUE(budget.try_acquire(1000).allowed);
+  std::thread waiter([&] { EXPECT_TRUE(budget.acquire(100, std::chrono::steady_clock::now() + kLongWait).allowed); });
+  await_waiting(budget, 1);
+  budget.release(1000);
+  waiter.join();
+  EXPECT_EQ(max_depth.load(), 1U);
+  EXPECT_EQ(depth.load(), 0U);
+}
@@ -0,0 +1,250 @@
+/*
+ * Copyright © 2016 - 2026 Swiss National Data and Service Center for the Humanities and/or DaSCH Service Platform
+ * contributors. SPDX-License-Identifier: AGPL-3.0-or-later
+ */
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <latch>
+#include <memory>
+#include <thread>
+
+#include "SipiPeakCalibration.h"
+
+using namespace Sipi;
+
+namespace {
+
+// A fake allocator: the tests move the heap level by hand.
+std::int64_t g_heap = 0;
+std::int64_t fake_heap() { return g_heap; }
+
+// The fake allocator, counting its reads.
+int g_reads = 0;
+std::int64_t counting_heap()
+{
+  ++g_reads;
+  return g_heap;
+}
+
+class PeakCalibrationTest : public ::testing::Test
+{
+protected:
+  void SetUp() override
+  {
+    g_heap = 1000;
+    set_heap_reader(fake_heap);
+  }
+  void TearDown() override { set_heap_reader(nullptr); }
+};
+
+constexpr CalibrationKey kJp2Scaled{ .codec = 0, .reduced = true, .scales = true };
+constexpr CalibrationKey kTifPlain{ .codec = 1 };
+
+}// namespace
+
+// --- HeapPeakScope ---
+
+TEST_F(PeakCalibrationTest, ScopeKeepsTheHighestSampledLevel)
+{
+  HeapPeakScope scope;
+  g_heap = 1500;
+  HeapPeakScope::sample();
+  g_heap = 1200;
+  HeapPeakScope::sample();
+  EXPECT_EQ(scope.peak(), 500U);
+}
+
+TEST_F(PeakCalibrationTest, NestedScopeRestoresTheOuterOne)
+{
+  HeapPeakScope outer;
+  {
+    HeapPeakScope inner;
+    g_heap = 1300;
+    HeapPeakScope::sample();
+    EXPECT_EQ(inner.peak(), 300U);
+  }
+  g_heap = 1800;
+  HeapPeakScope::sample();
+  g_heap = 1000;
+  EXPECT_EQ(outer.peak(), 800U);
+}
+
+TEST_F(PeakCalibrationTest, InnerSamplesRaiseTheOuterScope)
+{
+  HeapPeakScope outer;
+  {
+    HeapPeakScope inner;
+    g_heap = 2000;
+    HeapPeakScope::sample();
+  }
+  g_heap = 1000;
+  EXPECT_EQ(outer.peak(), 1000U);
+}
+
+TEST_F(PeakCalibrationTest, ScopeWithoutAReaderMeasuresNothing)
+{
+  set_heap_reader(nullptr);
+  HeapPeakScope scope;
+  EXPECT_FALSE(scope.valid());
+  HeapPeakScope::sample();
+  EXPECT_EQ(scope.peak(), 0U);
+}
+
+TEST_F(PeakCalibrationTest, BoundsScopeReadsOnlyItsEnds)
+{
+  g_reads = 0;
+  set_heap_reader(counting_heap);
+  HeapPeakScope phase(HeapPeakScope::Sampling::Bounds);
+  g_heap = 5000;
+  for (int i = 0; i < 10; ++i) { HeapPeakScope::sample(); }
+  g_heap = 1200;
+  EXPECT_EQ(phase.peak(), 200U);// the checkpoint peak went unseen
+  EXPECT_EQ(g_reads, 2);
+}
+
+TEST_F(PeakCalibrationTest, MeasurementSamplesRaiseAPhaseInsideIt)
+{
+  HeapPeakScope measured;
+  {
+    HeapPeakScope phase(HeapPeakScope::Sampling::Bounds);
+    g_heap = 5000;
+    HeapPeakScope::sample();
+    g_heap = 1200;
+    EXPECT_EQ(phase.peak(), 4000U);
+  }
+  EXPECT_EQ(measured.peak(), 4000U);
+}
+
+// --- PeakCalibration ---
+
+TEST_F(PeakCalibrationTest, StaticEstimateHoldsUntilMinSamples)
+{
+  PeakCalibration cal;
+  for (unsigned i = 1; i < PeakCalibration::kMinSamples; ++i) { cal.record(kJp2Scaled, 1000, 2000); }
+  EXPECT_EQ(cal.corrected(kJp2Scaled, 1000), 1000U);
+  cal.record(kJp2Scaled, 1000, 2000);
+  EXPECT_EQ(cal.corrected(kJp2Scaled, 1000), 2000U);
+  EXPECT_EQ(cal.samples(), PeakCalibration::kMinSamples);
+}
+
+TEST_F(PeakCalibrationTest, FactorIsFlooredAtTheStaticEstimateAndCapped)
+{
+  PeakCalibration cal;
+  for (unsigned i = 0; i < PeakCalibration::kMinSamples; ++i) {
+    cal.record(kTifPlain, 1000, 500);// over-estimated: never corrected downwards
+    cal.record(kJp2Scaled, 1000, 100000);
+  }
+  EXPECT_DOUBLE_EQ(cal.factor(kTifPlain), 1.0);
+  EXPECT_EQ(cal.corrected(kTifPlain, 1000), 1000U);
+  EXPECT_DOUBLE_EQ(cal.factor(kJp2Scaled), PeakCalibration::kMaxFactor);
+  EXPECT_DOUBLE_EQ(cal.max_factor(), PeakCalibration::kMaxFactor);
+}
+
+TEST_F(PeakCalibrationTest, ScatterWidensTheMargin)
+{
+  PeakCalibration steady;
+  PeakCalibration noisy;
+  for (unsigned i = 0; i < 2 * PeakCalibration::kMinSamples; ++i) {
+    steady.record(kJp2Scaled, 1000, 1500);
+    noisy.record(kJp2Scaled, 1000, i % 2 == 0 ? 1200 : 1800);
+  }
+  EXPECT_NEAR(steady.factor(kJp2Scaled), 1.5, 1e-9);
+  EXPECT_GT(noisy.factor(kJp2Scaled), steady.factor(kJp2Scaled));
+}
+
+TEST_F(PeakCalibrationTest, SlotsAreIndependent)
+{
+  PeakCalibration cal;
+  for (unsigned i = 0; i < PeakCalibration::kMinSamples; ++i) { cal.record(kJp2Scaled, 1000, 3000); }
+  EXPECT_EQ(cal.corrected(kTifPlain, 1000), 1000U);
+  EXPECT_EQ(cal.corrected(CalibrationKey{ .codec = 0, .scales = true }, 1000), 1000U);
+}
+
+// --- Measurement ---
+
+TEST_F(PeakCalibrationTest, SoloMeasurementIsRecorded)
+{
+  PeakCalibration cal;
+  PeakCalibration::Measurement m(cal, kJp2Scaled, 1000);
+  g_heap = 2500;
+  HeapPeakScope::sample();
+  g_heap = 1100;
+  EXPECT_EQ(m.finish(), 1500U);
+  EXPECT_EQ(cal.samples(), 1U);
+}
+
+TEST_F(PeakCalibrationTest, OverlappingMeasurementsAreNotRecorded)
+{
+  PeakCalibration cal;
+  auto first = std::make_unique<PeakCalibration::Measurement>(cal, kJp2Scaled, 1000);
+  {
+    PeakCalibration::Measurement second(cal, kTifPlain, 1000);
+    g_heap = 3000;
+    EXPECT_EQ(second.finish(), 0U);
+  }
+  EXPECT_EQ(first->finish(), 0U);
+  EXPECT_EQ(cal.samples(), 0U);
+
+  // Once both are done, the next one runs alone again.
+  first.reset();
+  PeakCalibration::Measurement third(cal, kJp2Scaled, 1000);
+  EXPECT_EQ(third.finish(), 0U);// heap did not rise
+  EXPECT_EQ(cal.samples(), 1U);
+}
+
+TEST_F(PeakCalibrationTest, UnfinishedMeasurementLeavesNoTrace)
+{
+  PeakCalibration cal;
+  { PeakCalibration::Measurement abandoned(cal, kJp2Scaled, 1000); }
+  PeakCalibration::Measurement next(cal, kJp2Scaled, 1000);
+  g_heap = 1400;
+  EXPECT_EQ(next.finish(), 400U);
+}
+
+TEST_F(PeakCalibrationTest, TheMeasuredServesOwnWorkDoesNotCount)
+{
+  PeakCalibration cal;
+  const ServeInFlight serve;
+  PeakCalibration::Measurement m(cal, kJp2Scaled, 1000);
+  g_heap = 1600;
+  EXPECT_EQ(m.finish(), 600U);
+  EXPECT_EQ(cal.samples(), 1U);
+}
+
+TEST_F(PeakCalibrationTest, UnmeasuredWorkElsewhereDoesNotMoveTheFactor)
+{
+  PeakCalibration cal;
+  for (unsigned i = 0; i < PeakCalibration::kMinSamples; ++i) {
+    // Already in flight when the measurement starts, then starting during it:
+    // an unmeasured tile batch on another thread allocating either way.
+    {
+      std::latch started(1);
+      std::latch done(1);
+      std::thread tiles([&] {
+        const ServeInFlight in_flight;
+        started.count_down();
+        done.wait();
+      });
+      started.wait();
+      PeakCalibration::Measurement m(cal, kJp2Scaled, 1000);
+      g_heap = 9000;
+      done.count_down();
+      tiles.join();
+      EXPECT_EQ(m.finish(), 0U);
+    }
+    g_heap = 1000;
+    {
+      PeakCalibration::Measurement m(cal, kJp2Scaled, 1000);
+      std::thread([] {
+        const ServeInFlight tiles;
+        g_heap = 9000;
+      }).join();
+      EXPECT_EQ(m.finish(), 0U);
+    }
+    g_heap = 1000;
+  }
+  EXPECT_EQ(cal.samples(), 0U);
+  EXPECT_EQ(cal.corrected(kJp2Scaled, 1000), 1000U);
+}
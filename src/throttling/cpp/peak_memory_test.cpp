@@ -110,3 +110,38 @@ TEST(PeakMemory, ZeroNcDefaultsToFourChannels)
   size_t expected = 100 * 100 * 4;
   EXPECT_EQ(peak, expected);
 }
+
+// --- PNG row-streaming model ---
+
+TEST(PeakMemory, PngStreamingThumbnailIsProportionalToOutput)
+{
+  // !512,512 of a 20000x20000 16-bit RGB PNG with the streaming HIGH resampler:
+  // no full-source buffer — output + one source row + int32 rows in flight.
+  size_t peak = estimate_peak_memory_png(20000, 20000, 20000, 512, 512, 3, 16, 0.0, false, true);
+  size_t out_buf = 512 * 512 * 3 * 2;
+  size_t src_row = 20000 * 3 * 2;
+  size_t acc_row = 512 * 3 * 4;
+  EXPECT_EQ(peak, out_buf + src_row + acc_row + 2 * acc_row);
+  EXPECT_LT(peak, 4 * 1024 * 1024);// the full decode would be 2.4 GB
+}
+
+TEST(PeakMemory, PngRegionWithoutScaleHoldsOnlyRegion)
+{
+  // 1024x1024 region of a 20000-wide 8-bit RGB PNG, no scaling.
+  size_t peak = estimate_peak_memory_png(20000, 1024, 1024, 0, 0, 3, 8, 0.0, false, true);
+  EXPECT_EQ(peak, 1024 * 1024 * 3 + 20000 * 3);
+}
+
+TEST(PeakMemory, PngNonStreamingScaleFallsBackToRegionModel)
+{
+  // MEDIUM/LOW scale after the (streamed) crop: the generic model on the region.
+  size_t peak = estimate_peak_memory_png(4000, 2000, 2000, 500, 500, 3, 8, 0.0, false, false);
+  EXPECT_EQ(peak, estimate_peak_memory(2000, 2000, 500, 500, 3, 8, 0.0, false));
+}
+
+TEST(PeakMemory, PngStreamingScaleThenRotateUsesOutputBuffers)
+{
+  size_t peak = estimate_peak_memory_png(8000, 8000, 8000, 400, 300, 3, 8, 90.0, false, true);
+  EXPECT_GE(peak, estimate_peak_memory(400, 300, 0, 0, 3, 8, 90.0, false));
+  EXPECT_LT(peak, 8000 * 8000);
+}
@@ -1,21 +1,22 @@
 //! End-to-end coverage for cost-based two-lane admission control (ADR-0022):
 //! advanced-mode full-lane budget rejection (413), the tile bypass, an
-//! in-budget full decode, and basic-mode observe-only. The oracle and its
+//! in-budget full decode, basic-mode observe-only, which planned routes hold a
+//! full-lane permit, and the degraded rendering of a request that would miss
+//! its `X-Sipi-Deadline-Ms`. The oracle and its
 //! differential parity gate were removed (ADR-0020), so this suite is the
 //! advanced-mode regression net alongside the engine-free
 //! `//src/throttling/rust:admission` crate tests and the engine budget unit
 //! tests.
 //!
-//! Scope note — **413 is tested here, transient 503 is not.** A single request
-//! whose estimate alone exceeds the budget is deterministic (it 413s on the
-//! first CAS, no load needed). A *transient* 503 needs two full decodes holding
-//! the budget at the same instant; with the fast lena512 decode that is a
-//! timing race that cannot be made deterministic without knowing the exact
-//! `estimate_peak_memory` to size the budget window. That 503-vs-413 split is
-//! covered deterministically at the engine level
-//! (`MemoryBudgetTest.TransientOverBudgetIsNotFlaggedAsTooLarge` /
-//! `SingleRequestExceedingBudgetIsFlaggedAsTooLarge`) and the thread shed by
-//! the crate's `full_partition_is_hard_capped_even_when_tiles_idle`.
+//! Scope note — **413 and transient 503 are both tested here.** A single
+//! request whose estimate alone exceeds the budget is deterministic (it 413s
+//! on the first CAS, no load needed). The transient cases need the budget held
+//! for as long as the test likes, which a fast lena512 decode cannot do: a raw
+//! connection that never reads a ~48 MiB upscale ([`hold_full_lane`]) pins its
+//! reservation, sized exactly by [`HELD_ESTIMATE`]. Against a budget with no
+//! room for a second lena512 beside it, a request waits in the budget queue
+//! and serves once the holder leaves; past the 64-waiter cap, or past its 5 s
+//! wait, it gets 503 + Retry-After.
 //!
 //! Every advanced-mode test runs against its **own empty cache dir**: a cache hit
 //! makes the engine return before the memory-budget gate (serve_image.cpp), so
@@ -24,7 +25,11 @@
 //! `lena512.jp2` decode (~768 KB) is classified full-lane (the 32 MiB default
 //! is far above it, and a tile bypasses the budget entirely).
 
-use sipi_e2e::{http_client, test_data_dir, SipiServer};
+use std::io::Write;
+use std::net::TcpStream;
+use std::time::{Duration, Instant};
+
+use sipi_e2e::{http_client, poll_cache_file_count, test_data_dir, SipiServer};
 use tempfile::TempDir;
 
 /// Start an isolated server with the given admission mode + RAM envelope, its
@@ -35,9 +40,20 @@ use tempfile::TempDir;
 /// that explicit order is load-bearing (destructured locals otherwise drop
 /// LIFO, i.e. cache first, yanking the dir out from under a still-running sipi).
 fn start(mode: &str, memory_limit: &str, tiles_memory_ratio: &str) -> (SipiServer, TempDir) {
+    start_pool(mode, memory_limit, tiles_memory_ratio, &[])
+}
+
+/// [`start`] with extra environment, for the tests that size the worker pool
+/// (`SIPI_NTHREADS`) to control the full partition.
+fn start_pool(
+    mode: &str,
+    memory_limit: &str,
+    tiles_memory_ratio: &str,
+    env: &[(&str, &str)],
+) -> (SipiServer, TempDir) {
     let cache = tempfile::tempdir().expect("create isolated cache dir");
     let cache_arg = cache.path().to_string_lossy().to_string();
-    let srv = SipiServer::start_with_args(
+    let srv = SipiServer::start_env(
         "config/sipi.e2e-test-config.lua",
         &test_data_dir(),
         &[
@@ -52,12 +68,39 @@ fn start(mode: &str, memory_limit: &str, tiles_memory_ratio: &str) -> (SipiServe
             "--cache-dir",
             &cache_arg,
         ],
+        env,
     );
     (srv, cache)
 }
 
 const FULL_MAX: &str = "/unit/lena512.jp2/full/max/0/default.jpg";
 
+/// lena512 upscaled to 4096² as an uncompressed TIFF: a full-lane decode
+/// estimated at 786 432 + 50 331 648 bytes whose ~48 MiB body is far more than
+/// the loopback socket buffers hold.
+const HELD: &str = "/unit/lena512.jp2/full/^4096,/0/default.tif";
+const HELD_ESTIMATE: u64 = 786_432 + 50_331_648;
+
+/// `--memory-limit` (at `--tiles-memory-ratio 0.5`) whose full-lane budget
+/// holds [`HELD`] with 512 KiB to spare: too little for lena512's 786 432-byte
+/// full decode beside it.
+fn budget_for_held() -> String {
+    (2 * (HELD_ESTIMATE + 512 * 1024)).to_string()
+}
+
+/// Request [`HELD`] on a raw connection that never reads the response. The
+/// engine blocks streaming the body once the socket buffers fill, so the
+/// request keeps its full-lane permit and its decode-memory reservation until
+/// the returned stream is dropped (the reset fails the next write).
+fn hold_full_lane(srv: &SipiServer) -> TcpStream {
+    let addr = srv.base_url.trim_start_matches("http://");
+    let mut conn = TcpStream::connect(addr).expect("connect holder");
+    write!(conn, "GET {HELD} HTTP/1.1\r\nHost: {addr}\r\n\r\n").expect("send held request");
+    // Time for the engine to plan and admit it.
+    std::thread::sleep(Duration::from_millis(500));
+    conn
+}
+
 // =============================================================================
 // 413 — a single request whose estimate alone exceeds the full-lane budget
 // =============================================================================
@@ -225,3 +268,265 @@ fn lua_route_occupies_the_full_lane() {
     assert_eq!(body.trim(), "SLOW_DONE");
     drop(srv);
 }
+
+// =============================================================================
+// A request that would miss its deadline is rendered cheaper, never cached
+// =============================================================================
+
+/// `X-Sipi-Deadline-Ms` asks for a coarser image rather than a late one. One
+/// exact decode seeds the engine's running decode rate; a 1 ms deadline then
+/// cannot fit the predicted decode of a full lena512, so the engine renders the
+/// degraded variant: 200 with `X-Sipi-Degraded` naming its steps and
+/// `Cache-Control: no-store`, and no cache file is written for it. The same URL
+/// without a deadline still renders exactly.
+#[test]
+fn deadline_miss_serves_degraded_and_uncached() {
+    let (srv, cache) = start("advanced", "64M", "0.5");
+    let client = http_client();
+
+    // A different URL, so the request under test is not a cache hit.
+    let warm = client
+        .get(format!(
+            "{}/unit/lena512.jp2/full/256,/0/default.jpg",
+            srv.base_url
+        ))
+        .send()
+        .expect("warm-up request should return a response");
+    assert_eq!(warm.status().as_u16(), 200);
+    warm.bytes().expect("read warm-up body");
+    assert_eq!(poll_cache_file_count(cache.path(), |n| n >= 1), 1);
+
+    let resp = client
+        .get(format!("{}{}", srv.base_url, FULL_MAX))
+        .header("X-Sipi-Deadline-Ms", "1")
+        .send()
+        .expect("deadline request should return a response");
+    assert_eq!(
+        resp.status().as_u16(),
+        200,
+        "a degraded render is still a 200"
+    );
+    let steps = resp
+        .headers()
+        .get("X-Sipi-Degraded")
+        .expect("a deadline miss must be marked X-Sipi-Degraded")
+        .to_str()
+        .unwrap()
+        .to_string();
+    assert!(!steps.is_empty(), "X-Sipi-Degraded names the steps taken");
+    assert_eq!(
+        resp.headers()
+            .get("Cache-Control")
+            .map(|v| v.to_str().unwrap()),
+        Some("no-store"),
+        "a degraded render must not be stored downstream"
+    );
+    let body = resp.bytes().expect("read degraded body");
+    assert!(body.len() > 2 && body[0] == 0xFF && body[1] == 0xD8);
+    assert_eq!(
+        poll_cache_file_count(cache.path(), |n| n > 1),
+        1,
+        "a degraded render must not be written to the cache"
+    );
+
+    let exact = client
+        .get(format!("{}{}", srv.base_url, FULL_MAX))
+        .send()
+        .expect("exact request should return a response");
+    assert_eq!(exact.status().as_u16(), 200);
+    assert!(
+        exact.headers().get("X-Sipi-Degraded").is_none(),
+        "without a deadline the exact rendering is served ({steps} was not cached)"
+    );
+    assert_ne!(
+        exact
+            .headers()
+            .get("Cache-Control")
+            .map(|v| v.to_str().unwrap()),
+        Some("no-store")
+    );
+    drop(srv);
+    drop(cache);
+}
+
+// =============================================================================
+// Only decodes take the full lane
+// =============================================================================
+
+/// The full partition is settled after the plan (`admit_plan`): a HEAD or a
+/// cache hit decodes nothing and streams without a full permit, while an
+/// uncached large decode still queues for one. With `SIPI_NTHREADS=2`
+/// (full_max = 1) a held upscale occupies the only full permit; a HEAD and a
+/// cache hit of a full-lane image serve at once, and a full-lane decode waits
+/// in the full queue until the holder goes away, then serves.
+#[test]
+fn head_and_cache_hit_skip_the_full_lane_but_decodes_queue() {
+    let (srv, cache) = start_pool("advanced", "1G", "0.5", &[("SIPI_NTHREADS", "2")]);
+    let client = http_client();
+
+    let warm = client
+        .get(format!("{}{}", srv.base_url, FULL_MAX))
+        .send()
+        .expect("warm-up request should return a response");
+    assert_eq!(warm.status().as_u16(), 200);
+    warm.bytes().expect("read warm-up body");
+    assert_eq!(poll_cache_file_count(cache.path(), |n| n >= 1), 1);
+
+    let holder = hold_full_lane(&srv);
+
+    // lena512 at 256 px: a 196 608-byte estimate, above the 100 KB threshold.
+    let queued = std::thread::spawn({
+        let url = format!("{}/unit/lena512.jp2/full/256,/0/default.jpg", srv.base_url);
+        move || {
+            let started = Instant::now();
+            let resp = http_client().get(url).send().expect("queued GET failed");
+            (resp.status().as_u16(), started.elapsed())
+        }
+    });
+    std::thread::sleep(Duration::from_millis(300));
+
+    let head = client
+        .head(format!(
+            "{}/unit/lena512.jp2/full/max/0/default.png",
+            srv.base_url
+        ))
+        .send()
+        .expect("HEAD should return a response");
+    assert_eq!(
+        head.status().as_u16(),
+        200,
+        "a HEAD decodes nothing and must not wait for the full lane"
+    );
+
+    let hit = client
+        .get(format!("{}{}", srv.base_url, FULL_MAX))
+        .send()
+        .expect("cache hit should return a response");
+    assert_eq!(
+        hit.status().as_u16(),
+        200,
+        "a cache hit decodes nothing and must not wait for the full lane"
+    );
+    let body = hit.bytes().expect("read cached body");
+    assert!(body.len() > 2 && body[0] == 0xFF && body[1] == 0xD8);
+
+    assert!(
+        !queued.is_finished(),
+        "an uncached full-lane decode must still queue behind the held full permit"
+    );
+    drop(holder);
+    let (status, waited) = queued.join().expect("queued request thread panicked");
+    assert_eq!(
+        status, 200,
+        "the queued decode serves once the full permit is free"
+    );
+    assert!(
+        waited >= Duration::from_millis(300),
+        "it waited: {waited:?}"
+    );
+    drop(srv);
+    drop(cache);
+}
+
+// =============================================================================
+// Over budget: wait in the budget queue, then serve — or 503 past the queue
+// =============================================================================
+
+/// A full decode that does not fit beside the held reservation waits in the
+/// budget queue instead of answering 503 at once, and serves as soon as the
+/// holder's bytes are released.
+#[test]
+fn advanced_over_budget_request_waits_then_serves() {
+    let (srv, cache) = start_pool(
+        "advanced",
+        &budget_for_held(),
+        "0.5",
+        &[("SIPI_NTHREADS", "8")],
+    );
+    let holder = hold_full_lane(&srv);
+
+    let waiter = std::thread::spawn({
+        let url = format!("{}{}", srv.base_url, FULL_MAX);
+        move || {
+            let started = Instant::now();
+            let resp = http_client().get(url).send().expect("waiting GET failed");
+            (resp.status().as_u16(), started.elapsed())
+        }
+    });
+    std::thread::sleep(Duration::from_secs(1));
+    assert!(
+        !waiter.is_finished(),
+        "an over-budget decode must wait for the budget, not shed at once"
+    );
+
+    drop(holder);
+    let (status, waited) = waiter.join().expect("waiter thread panicked");
+    assert_eq!(status, 200, "the waiter serves once the budget frees up");
+    assert!(waited >= Duration::from_secs(1), "it waited: {waited:?}");
+    drop(srv);
+    drop(cache);
+}
+
+/// The budget queue holds at most 64 waiters. With the full partition wide
+/// enough (`SIPI_NTHREADS=160`, full_max = 80) for 70 decodes to reach the
+/// budget behind the holder, the six past the cap are shed with 503 at once;
+/// the 64 queued ones get 503 when their 5 s wait runs out. Every 503 carries
+/// Retry-After, and the budget serves again once the holder leaves.
+#[test]
+fn advanced_budget_queue_sheds_past_its_cap_and_on_timeout() {
+    const BURST: usize = 70;
+    const QUEUE_CAP: usize = 64;
+    let (srv, cache) = start_pool(
+        "advanced",
+        &budget_for_held(),
+        "0.5",
+        &[("SIPI_NTHREADS", "160")],
+    );
+    let holder = hold_full_lane(&srv);
+
+    let started = Instant::now();
+    let burst: Vec<_> = (0..BURST)
+        .map(|_| {
+            let url = format!("{}{}", srv.base_url, FULL_MAX);
+            std::thread::spawn(move || {
+                let resp = http_client().get(url).send().expect("burst GET failed");
+                (
+                    resp.status().as_u16(),
+                    resp.headers().contains_key("Retry-After"),
+                    started.elapsed(),
+                )
+            })
+        })
+        .collect();
+    let outcomes: Vec<_> = burst
+        .into_iter()
+        .map(|t| t.join().expect("burst thread panicked"))
+        .collect();
+
+    for (status, retry_after, _) in &outcomes {
+        assert_eq!(*status, 503, "nothing fits beside the holder");
+        assert!(*retry_after, "a transient 503 carries Retry-After");
+    }
+    let shed_at_once = outcomes
+        .iter()
+        .filter(|(_, _, took)| *took < Duration::from_secs(3))
+        .count();
+    assert!(
+        shed_at_once >= BURST - QUEUE_CAP,
+        "the requests past the 64-waiter cap shed without waiting \
+         ({shed_at_once} of {BURST} answered before the 5 s wait)"
+    );
+    assert!(
+        shed_at_once < BURST,
+        "the queued requests wait out their 5 s before the 503"
+    );
+
+    drop(holder);
+    let resp = http_client()
+        .get(format!("{}{}", srv.base_url, FULL_MAX))
+        .send()
+        .expect("request after the burst should return a response");
+    assert_eq!(resp.status().as_u16(), 200, "the budget serves again");
+    drop(srv);
+    drop(cache);
+}
@@ -16,8 +16,15 @@
 //! through several collection cycles — each one invokes every observable
 //! callback, including the allocator stats reader — and assert the server
 //! is still alive and serving.
+//!
+//! Two more tests point the exporter at a loopback fake collector instead and
+//! check that the engine's decode-memory queue counters and the logger's
+//! dropped/suppressed line counters (all bridged through `SipiMetricsSnapshot`)
+//! are in what it sends.
 
-use std::time::Duration;
+use std::io::{Read, Write};
+use std::net::{TcpListener, TcpStream};
+use std::time::{Duration, Instant};
 
 use sipi_e2e::{http_client, test_data_dir, SipiServer};
 
@@ -62,3 +69,112 @@ fn metrics_collection_does_not_kill_the_server() {
         "healthy after metrics collections"
     );
 }
+
+/// HTTP/2 frames a fake collector sends on accept: SETTINGS raising the
+/// per-stream window to 2^31 − 1, and a connection WINDOW_UPDATE to match, so
+/// flow control never holds back an export body.
+const H2_SERVER_HELLO: [u8; 28] = [
+    0x00, 0x00, 0x06, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00, // SETTINGS, 6 bytes
+    0x00, 0x04, 0x7f, 0xff, 0xff, 0xff, // INITIAL_WINDOW_SIZE
+    0x00, 0x00, 0x04, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, // WINDOW_UPDATE, stream 0
+    0x7f, 0xff, 0x00, 0x00,
+];
+const H2_SETTINGS_ACK: [u8; 9] = [0x00, 0x00, 0x00, 0x04, 0x01, 0x00, 0x00, 0x00, 0x00];
+
+/// Serve as the OTLP collector on `listener` and read what the exporters send
+/// until every one of `names` has appeared or 20 s pass; returns the names
+/// never seen. Each exporter (metrics, traces) opens its own connection, so
+/// all of them are read. OTLP/gRPC carries metric names verbatim in the
+/// uncompressed protobuf body, so a byte search finds them. No RPC is ever
+/// answered — the exporters time out and fail open.
+fn missing_from_export(listener: TcpListener, names: &[&str]) -> Vec<String> {
+    let deadline = Instant::now() + Duration::from_secs(20);
+    listener
+        .set_nonblocking(true)
+        .expect("non-blocking listener");
+    // Per connection: the stream, what it sent so far, whether its SETTINGS
+    // were acked.
+    let mut conns: Vec<(TcpStream, Vec<u8>, bool)> = Vec::new();
+    let missing = |conns: &[(TcpStream, Vec<u8>, bool)]| -> Vec<String> {
+        names
+            .iter()
+            .filter(|n| {
+                !conns
+                    .iter()
+                    .any(|(_, seen, _)| seen.windows(n.len()).any(|w| w == n.as_bytes()))
+            })
+            .map(|n| n.to_string())
+            .collect()
+    };
+    let mut chunk = [0u8; 64 * 1024];
+    while Instant::now() < deadline {
+        if let Ok((mut conn, _)) = listener.accept() {
+            conn.set_nonblocking(true).ok();
+            conn.write_all(&H2_SERVER_HELLO).ok();
+            conns.push((conn, Vec::new(), false));
+        }
+        for (conn, seen, acked) in &mut conns {
+            while let Ok(n @ 1..) = conn.read(&mut chunk) {
+                seen.extend_from_slice(&chunk[..n]);
+                if !*acked {
+                    *acked = conn.write_all(&H2_SETTINGS_ACK).is_ok();
+                }
+            }
+        }
+        if missing(&conns).is_empty() {
+            break;
+        }
+        std::thread::sleep(Duration::from_millis(50));
+    }
+    missing(&conns)
+}
+
+#[test]
+fn decode_memory_queue_metrics_are_exported() {
+    let collector = TcpListener::bind("127.0.0.1:0").expect("bind fake collector");
+    let endpoint = format!("http://{}", collector.local_addr().unwrap());
+    let _srv = SipiServer::start_env(
+        "config/sipi.e2e-test-config.lua",
+        &test_data_dir(),
+        &[],
+        &[
+            ("OTEL_EXPORTER_OTLP_ENDPOINT", &endpoint),
+            ("OTEL_METRIC_EXPORT_INTERVAL", "250"),
+        ],
+    );
+
+    let missing = missing_from_export(
+        collector,
+        &[
+            "sipi.decode_memory.waited",
+            "sipi.decode_memory.wait_microseconds",
+            "sipi.decode_memory.waiting",
+        ],
+    );
+    assert!(
+        missing.is_empty(),
+        "metrics absent from the OTLP export: {missing:?}"
+    );
+}
+
+#[test]
+fn log_counters_are_exported() {
+    let collector = TcpListener::bind("127.0.0.1:0").expect("bind fake collector");
+    let endpoint = format!("http://{}", collector.local_addr().unwrap());
+    let _srv = SipiServer::start_env(
+        "config/sipi.e2e-test-config.lua",
+        &test_data_dir(),
+        &[],
+        &[
+            ("OTEL_EXPORTER_OTLP_ENDPOINT", &endpoint),
+            ("OTEL_METRIC_EXPORT_INTERVAL", "250"),
+            ("SIPI_LOG_RATE_LIMIT", "0"),
+        ],
+    );
+
+    let missing = missing_from_export(collector, &["sipi.log.dropped", "sipi.log.suppressed"]);
+    assert!(
+        missing.is_empty(),
+        "metrics absent from the OTLP export: {missing:?}"
+    );
+}
@@ -0,0 +1,136 @@
+// Copyright © 2016 - 2026 Swiss National Data and Service Center for the Humanities and/or DaSCH Service Platform
+// contributors. SPDX-License-Identifier: AGPL-3.0-or-later
+//
+// `sipi replay --json`: feed a recorded access log through the in-process
+// engine and check the report. Covers both pacing modes — open loop (the
+// log's own timestamps) and closed loop (`--concurrency`) — against the e2e
+// test images, so a 200, a 404 and a HEAD all show up in the status counts.
+
+use serde_json::Value;
+use sipi_e2e::{sipi_bin_path, test_data_dir};
+use std::path::Path;
+use std::process::Command;
+
+const CONFIG: &str = "config/sipi.e2e-test-config.lua";
+
+/// Six replayable requests spread over two seconds, plus a comment, a blank
+/// line and one POST that the parser must count as skipped.
+const LOG: &str = "\
+# recorded on a test box
+1700000000.0 GET /unit/lena512.jp2/full/max/0/default.jpg
+1700000000.5 /unit/lena512.jp2/0,0,256,256/128,/0/default.jpg
+1700000001.0 HEAD /unit/lena512.jp2/info.json
+
+1700000001.2 GET /unit/lena512.jp2/full/max/0/default.jpg
+1700000001.5 POST /unit/lena512.jp2/full/max/0/default.jpg
+1700000001.8 GET /unit/does-not-exist.jp2/full/max/0/default.jpg
+1700000002.0 GET /unit/lena512.jp2/full/256,/0/default.jpg
+";
+const REPLAYED: u64 = 6;
+
+fn replay(dir: &Path, extra: &[&str]) -> Value {
+    let log = dir.join("access.log");
+    std::fs::write(&log, LOG).expect("write replay log");
+    let cache = dir.join("cache");
+    std::fs::create_dir_all(&cache).expect("create cache dir");
+
+    let out = Command::new(sipi_bin_path())
+        .current_dir(test_data_dir())
+        .arg("replay")
+        .args(["--config", CONFIG])
+        .arg("--cache-dir")
+        .arg(&cache)
+        .args(["--window", "1", "--json"])
+        .args(extra)
+        .arg(&log)
+        .output()
+        .expect("sipi replay should run");
+    assert!(
+        out.status.success(),
+        "sipi replay should exit 0\nstderr: {}",
+        String::from_utf8_lossy(&out.stderr)
+    );
+
+    let stdout = std::str::from_utf8(&out.stdout).expect("stdout is utf-8");
+    serde_json::from_str(stdout.trim())
+        .unwrap_or_else(|e| panic!("stdout must be the JSON report: {e}\nstdout: {stdout:?}"))
+}
+
+/// Checks shared by both pacing modes.
+fn assert_report(report: &Value) {
+    assert_eq!(report["requests"], REPLAYED, "{report}");
+    assert_eq!(
+        report["skipped_lines"], 1,
+        "the POST line is skipped: {report}"
+    );
+
+    let status = &report["status"];
+    assert_eq!(status["200"], REPLAYED - 1, "{status}");
+    assert_eq!(status["404"], 1, "{status}");
+
+    let latency = &report["latency"];
+    for key in ["p50_ms", "p90_ms", "p99_ms", "p999_ms", "max_ms"] {
+        assert!(latency[key].is_f64(), "latency.{key} missing: {latency}");
+    }
+    assert!(latency["p50_ms"].as_f64() <= latency["max_ms"].as_f64());
+    assert!(latency["max_ms"].as_f64().unwrap() > 0.0);
+
+    let bucketed: u64 = report["latency_histogram"]
+        .as_array()
+        .expect("latency_histogram is an array")
+        .iter()
+        .map(|b| b["count"].as_u64().unwrap())
+        .sum();
+    assert_eq!(bucketed, REPLAYED);
+
+    let windows = report["windows"].as_array().expect("windows is an array");
+    assert!(!windows.is_empty());
+    for row in windows {
+        for key in [
+            "end_s",
+            "requests",
+            "cache_hits",
+            "cache_misses",
+            "budget_rejected",
+            "budget_waited",
+            "peak_rss_bytes",
+        ] {
+            assert!(!row[key].is_null(), "window row lacks {key}: {row}");
+        }
+    }
+    let per_window: u64 = windows
+        .iter()
+        .map(|w| w["requests"].as_u64().unwrap())
+        .sum();
+    assert_eq!(per_window, REPLAYED, "windows must add up to the total");
+    let last_end = windows.last().unwrap()["end_s"].as_f64().unwrap();
+    let elapsed = report["elapsed_s"].as_f64().unwrap();
+    assert!(
+        (last_end - elapsed).abs() < 0.5,
+        "last window should close at the end of the run: {last_end} vs {elapsed}"
+    );
+    assert_eq!(report["total"]["requests"], REPLAYED);
+}
+
+#[test]
+fn replay_open_loop_keeps_log_timing() {
+    let dir = tempfile::tempdir().unwrap();
+    let report = replay(dir.path(), &["--speed", "1"]);
+
+    assert_eq!(report["pace"]["mode"], "open", "{report}");
+    assert_report(&report);
+    // Two seconds of log at 1× with one-second windows: the requests land in
+    // more than one row, and the run cannot finish before the log does.
+    assert!(report["elapsed_s"].as_f64().unwrap() >= 1.9, "{report}");
+    assert!(report["windows"].as_array().unwrap().len() >= 2, "{report}");
+}
+
+#[test]
+fn replay_closed_loop_ignores_log_timing() {
+    let dir = tempfile::tempdir().unwrap();
+    let report = replay(dir.path(), &["--concurrency", "2"]);
+
+    assert_eq!(report["pace"]["mode"], "closed", "{report}");
+    assert_eq!(report["pace"]["concurrency"], 2, "{report}");
+    assert_report(&report);
+}
@@ -0,0 +1,114 @@
+/*
+ * Copyright © 2016 - 2026 Swiss National Data and Service Center for the Humanities and/or DaSCH Service Platform
+ * contributors. SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ * Cooperative decode cancellation: inside a DecodeCancelScope whose poll
+ * reports the client gone, every codec's read and the resampler stop at their
+ * next checkpoint with SipiImageClientAbortError — also when the poll turns
+ * only after the decode has begun — and a poll that never fires leaves the
+ * decode untouched.
+ */
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "SipiImage.h"
+#include "SipiImageError.h"
+#include "decode_cancel.h"
+#include "iiifparser/SipiSize.h"
+#include "resample.h"
+#include "test_paths.h"
+
+namespace {
+
+const std::string test_images = sipi::test::data_dir() + "/images/unit/";
+
+// A poll that reports the client gone from its `after`-th call on.
+std::function<bool()> gone_after(int after)
+{
+  auto calls = std::make_shared<int>(0);
+  return [calls, after] { return ++*calls > after; };
+}
+
+void expect_read_cancelled(const std::string &file, int after)
+{
+  const auto poll = gone_after(after);
+  const Sipi::DecodeCancelScope scope(poll);
+  Sipi::SipiImage img;
+  EXPECT_THROW(img.read(test_images + file), Sipi::SipiImageClientAbortError) << file;
+}
+
+TEST(DecodeCancel, OutsideAScopeNothingIsCancelled) { EXPECT_FALSE(Sipi::decode_cancelled()); }
+
+TEST(DecodeCancel, ScopesNestAndRestore)
+{
+  const std::function<bool()> gone = [] { return true; };
+  const std::function<bool()> here = [] { return false; };
+  {
+    const Sipi::DecodeCancelScope outer(gone);
+    {
+      const Sipi::DecodeCancelScope inner(here);
+      EXPECT_FALSE(Sipi::decode_cancelled());
+    }
+    EXPECT_TRUE(Sipi::decode_cancelled());
+    EXPECT_THROW(Sipi::check_decode_cancelled(), Sipi::SipiImageClientAbortError);
+  }
+  EXPECT_FALSE(Sipi::decode_cancelled());
+}
+
+TEST(DecodeCancel, JpegStopsBetweenScanlineBatches) { expect_read_cancelled("MaoriFigure.jpg", 1); }
+
+TEST(DecodeCancel, UntiledTiffStopsBetweenStrips) { expect_read_cancelled("lena512.tif", 0); }
+
+TEST(DecodeCancel, PyramidTiffStopsBetweenTiles) { expect_read_cancelled("lena512_pyramid.tif", 1); }
+
+TEST(DecodeCancel, Jpeg2000StopsBetweenStripes) { expect_read_cancelled("lena512.jp2", 1); }
+
+TEST(DecodeCancel, PngStopsBetweenRowBatches)
+{
+  // Written here rather than checked in: a non-interlaced PNG tall enough for
+  // several row batches.
+  Sipi::SipiImage source;
+  source.read(test_images + "lena512.tif");
+  const std::string png = sipi::test::tmp_dir() + "/decode_cancel_lena512.png";
+  ASSERT_NO_THROW(source.write("png", png));
+  const auto poll = gone_after(1);
+  const Sipi::DecodeCancelScope scope(poll);
+  Sipi::SipiImage img;
+  EXPECT_THROW(img.read(png), Sipi::SipiImageClientAbortError);
+}
+
+TEST(DecodeCancel, PollThatNeverFiresLeavesTheDecodeAlone)
+{
+  const std::function<bool()> here = [] { return false; };
+  Sipi::SipiImage expected;
+  expected.read(test_images + "lena512.jp2");
+  Sipi::SipiImage img;
+  {
+    const Sipi::DecodeCancelScope scope(here);
+    ASSERT_NO_THROW(img.read(test_images + "lena512.jp2", nullptr, std::make_shared<Sipi::SipiSize>("200,")));
+  }
+  EXPECT_EQ(img.getNx(), 200U);
+  EXPECT_EQ(img.getNy(), 200U);
+}
+
+TEST(DecodeCancel, ResampleStopsBetweenRowBands)
+{
+  const std::size_t nx = 64, ny = 4 * Sipi::kDecodeCancelRows, nnx = 32, nny = ny / 2;
+  const std::vector<std::uint8_t> in(nx * ny, 128);
+  std::vector<std::uint8_t> out(nnx * nny);
+  const auto wx = Sipi::build_axis_weights(nx, nnx);
+  const auto wy = Sipi::build_axis_weights(ny, nny);
+  const auto poll = gone_after(2);
+  const Sipi::DecodeCancelScope scope(poll);
+  EXPECT_THROW(Sipi::resample_separable_u8(in.data(), nx, ny, 1, nnx, nny, wx.offset.data(), wx.idx.data(),
+                 wx.wt.data(), wy.offset.data(), wy.idx.data(), wy.wt.data(), out.data()),
+    Sipi::SipiImageClientAbortError);
+}
+
+}// namespace
@@ -0,0 +1,164 @@
+/*
+ * Copyright © 2016 - 2026 Swiss National Data and Service Center for the Humanities and/or DaSCH Service Platform
+ * contributors. SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ * A `gray` rendering of a colour JPEG2000 may decode only the codestream's luma
+ * component (J2kGrayDecode). The luminance decode must come back as 8-bit gray
+ * tagged with the gray profile the serve path converts to, stay close to the
+ * exact ICC conversion on a natural image, match it on the neutral axis once
+ * tone-corrected, and leave sources without a luma component untouched.
+ */
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <limits>
+#include <memory>
+#include <string>
+
+#include "SipiImage.h"
+#include "iiifparser/SipiSize.h"
+#include "metadata/icc.h"
+#include "test_paths.h"
+
+namespace {
+
+const std::string test_images = sipi::test::data_dir() + "/images/";
+const std::string tmp_dir = sipi::test::tmp_dir() + "/";
+
+Sipi::SipiImage read_gray(const std::string &path, Sipi::J2kGrayDecode mode)
+{
+  Sipi::ScalingQuality quality{
+    Sipi::ScalingMethod::HIGH, Sipi::ScalingMethod::HIGH, Sipi::ScalingMethod::HIGH, Sipi::ScalingMethod::HIGH
+  };
+  quality.j2k_gray = mode;
+  Sipi::SipiImage img;
+  img.read(path, nullptr, std::make_shared<Sipi::SipiSize>("!256,256"), true, quality);
+  if (mode == Sipi::J2kGrayDecode::EXACT) { img.convertToIcc(Sipi::Icc(Sipi::icc_GRAY_D50), 8); }
+  return img;
+}
+
+double psnr(Sipi::SipiImage &a, Sipi::SipiImage &b)
+{
+  double sse = 0.0;
+  for (size_t y = 0; y < a.getNy(); ++y) {
+    for (size_t x = 0; x < a.getNx(); ++x) {
+      const double d = static_cast<double>(a.getPixel(x, y, 0)) - static_cast<double>(b.getPixel(x, y, 0));
+      sse += d * d;
+    }
+  }
+  if (sse == 0.0) { return std::numeric_limits<double>::infinity(); }
+  const double mse = sse / static_cast<double>(a.getNx() * a.getNy());
+  return 10.0 * std::log10(255.0 * 255.0 / mse);
+}
+
+// Plain luma is sRGB-encoded and tagged so; toned luma carries the exact
+// path's gamma 2.2 profile.
+void expect_luma_gray(Sipi::SipiImage &img, Sipi::PredefinedProfiles profile)
+{
+  EXPECT_EQ(img.getNc(), 1u);
+  EXPECT_EQ(img.getBps(), 8u);
+  EXPECT_EQ(img.getPhoto(), Sipi::PhotometricInterpretation::MINISBLACK);
+  ASSERT_NE(img.getIcc(), nullptr);
+  EXPECT_EQ(img.getIcc()->getProfileType(), profile);
+}
+
+int max_abs_diff(Sipi::SipiImage &a, Sipi::SipiImage &b)
+{
+  int max_diff = 0;
+  for (size_t y = 0; y < a.getNy(); ++y) {
+    for (size_t x = 0; x < a.getNx(); ++x) {
+      max_diff = std::max(max_diff, std::abs(static_cast<int>(a.getPixel(x, y, 0)) - b.getPixel(x, y, 0)));
+    }
+  }
+  return max_diff;
+}
+
+TEST(J2kGrayDecode, LuminanceIsCloseToTheExactConversion)
+{
+  const std::string path = tmp_dir + "_gray_decode_lena.jp2";
+  Sipi::SipiImage src;
+  src.read(test_images + "unit/lena512.tif");
+  src.write("jpx", path);
+
+  Sipi::SipiImage exact = read_gray(path, Sipi::J2kGrayDecode::EXACT);
+  Sipi::SipiImage luma = read_gray(path, Sipi::J2kGrayDecode::LUMINANCE);
+  Sipi::SipiImage toned = read_gray(path, Sipi::J2kGrayDecode::LUMINANCE_TONED);
+  expect_luma_gray(luma, Sipi::icc_GRAY_sRGB);
+  expect_luma_gray(toned, Sipi::icc_GRAY_D50);
+  ASSERT_EQ(luma.getNx(), exact.getNx());
+  ASSERT_EQ(luma.getNy(), exact.getNy());
+  EXPECT_GE(psnr(exact, luma), 24.0);
+  EXPECT_GE(psnr(exact, toned), 28.0);
+}
+
+// R = G = B: the reversible colour transform's luma is the sample itself, so
+// the tone-corrected decode reproduces the exact path up to ICC rounding.
+TEST(J2kGrayDecode, TonedLuminanceMatchesExactOnTheNeutralAxis)
+{
+  constexpr size_t nx = 256, ny = 64;
+  Sipi::SipiImage src(nx, ny, 3, 8, Sipi::PhotometricInterpretation::RGB);
+  for (size_t y = 0; y < ny; ++y) {
+    for (size_t x = 0; x < nx; ++x) {
+      for (size_t c = 0; c < 3; ++c) { src.setPixel(x, y, c, static_cast<int>(x)); }
+    }
+  }
+  const std::string path = tmp_dir + "_gray_decode_ramp.jp2";
+  src.write("jpx", path);
+
+  Sipi::SipiImage exact = read_gray(path, Sipi::J2kGrayDecode::EXACT);
+  Sipi::SipiImage toned = read_gray(path, Sipi::J2kGrayDecode::LUMINANCE_TONED);
+  expect_luma_gray(toned, Sipi::icc_GRAY_D50);
+  ASSERT_EQ(toned.getNx(), exact.getNx());
+  ASSERT_EQ(toned.getNy(), exact.getNy());
+  EXPECT_LE(max_abs_diff(exact, toned), 1);
+}
+
+// The plain luma's profile is the one its samples carry: a colour-managed
+// conversion to the exact path's profile lands on the exact decode.
+TEST(J2kGrayDecode, LuminanceProfileMatchesItsToneCurve)
+{
+  constexpr size_t nx = 256, ny = 64;
+  Sipi::SipiImage src(nx, ny, 3, 8, Sipi::PhotometricInterpretation::RGB);
+  for (size_t y = 0; y < ny; ++y) {
+    for (size_t x = 0; x < nx; ++x) {
+      for (size_t c = 0; c < 3; ++c) { src.setPixel(x, y, c, static_cast<int>(x)); }
+    }
+  }
+  const std::string path = tmp_dir + "_gray_decode_ramp_profile.jp2";
+  src.write("jpx", path);
+
+  Sipi::SipiImage exact = read_gray(path, Sipi::J2kGrayDecode::EXACT);
+  Sipi::SipiImage luma = read_gray(path, Sipi::J2kGrayDecode::LUMINANCE);
+  expect_luma_gray(luma, Sipi::icc_GRAY_sRGB);
+  luma.convertToIcc(Sipi::Icc(Sipi::icc_GRAY_D50), 8);
+  ASSERT_EQ(luma.getNx(), exact.getNx());
+  ASSERT_EQ(luma.getNy(), exact.getNy());
+  EXPECT_LE(max_abs_diff(exact, luma), 1);
+}
+
+// A single-component source has no luma to pick: the hint leaves the decode
+// untouched.
+TEST(J2kGrayDecode, GraySourceIgnoresTheHint)
+{
+  constexpr size_t nx = 64, ny = 64;
+  Sipi::SipiImage src(nx, ny, 1, 8, Sipi::PhotometricInterpretation::MINISBLACK);
+  for (size_t y = 0; y < ny; ++y) {
+    for (size_t x = 0; x < nx; ++x) { src.setPixel(x, y, 0, static_cast<int>((x * 3 + y * 5) % 256)); }
+  }
+  const std::string path = tmp_dir + "_gray_decode_gray.jp2";
+  src.write("jpx", path);
+
+  Sipi::ScalingQuality quality{
+    Sipi::ScalingMethod::HIGH, Sipi::ScalingMethod::HIGH, Sipi::ScalingMethod::HIGH, Sipi::ScalingMethod::HIGH
+  };
+  quality.j2k_gray = Sipi::J2kGrayDecode::LUMINANCE_TONED;
+  Sipi::SipiImage img;
+  img.read(path, nullptr, nullptr, true, quality);
+  EXPECT_TRUE(img == src);
+}
+
+}// namespace
@@ -0,0 +1,104 @@
+/*
+ * Copyright © 2016 - 2026 Swiss National Data and Service Center for the Humanities and/or DaSCH Service Platform
+ * contributors. SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ * Small JPEG renderings of a JPEG2000 source decode only a share of its quality
+ * layers (`j2k_layer_percent`). The policy must stay visually transparent at
+ * preview sizes: a layer-truncated decode of the lena fixture, written as a
+ * SIPI JP2 (reversible, 8 layers), is compared against the all-layer decode of
+ * the same rendering by PSNR — and must actually differ, or no layers were
+ * dropped.
+ */
+
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <string>
+
+#include "SipiImage.h"
+#include "formats/SipiIOJ2k.h"
+#include "iiifparser/SipiSize.h"
+#include "test_paths.h"
+
+namespace {
+
+const std::string test_images = sipi::test::data_dir() + "/images/";
+const std::string tmp_dir = sipi::test::tmp_dir() + "/";
+
+// The per-sample error floor below which a preview is indistinguishable.
+constexpr double kMinPsnr = 32.0;
+
+Sipi::SipiImage read_jp2(const std::string &path, const std::string &size_spec, uint8_t layer_percent)
+{
+  Sipi::ScalingQuality quality{
+    Sipi::ScalingMethod::HIGH, Sipi::ScalingMethod::HIGH, Sipi::ScalingMethod::HIGH, Sipi::ScalingMethod::HIGH
+  };
+  quality.j2k_layer_percent = layer_percent;
+  Sipi::SipiImage img;
+  img.read(path, nullptr, std::make_shared<Sipi::SipiSize>(size_spec), true, quality);
+  return img;
+}
+
+double psnr(Sipi::SipiImage &a, Sipi::SipiImage &b)
+{
+  double sse = 0.0;
+  for (size_t y = 0; y < a.getNy(); ++y) {
+    for (size_t x = 0; x < a.getNx(); ++x) {
+      for (size_t c = 0; c < a.getNc(); ++c) {
+        const double d = static_cast<double>(a.getPixel(x, y, c)) - static_cast<double>(b.getPixel(x, y, c));
+        sse += d * d;
+      }
+    }
+  }
+  if (sse == 0.0) { return std::numeric_limits<double>::infinity(); }
+  const double mse = sse / static_cast<double>(a.getNx() * a.getNy() * a.getNc());
+  return 10.0 * std::log10(255.0 * 255.0 / mse);
+}
+
+class J2kLayerTruncation : public ::testing::Test
+{
+protected:
+  static void SetUpTestSuite()
+  {
+    Sipi::SipiImage src;
+    src.read(test_images + "unit/lena512.tif");
+    src.write("jpx", jp2_path);
+  }
+
+  static void expect_transparent(const std::string &size_spec, uint8_t layer_percent)
+  {
+    Sipi::SipiImage all = read_jp2(jp2_path, size_spec, 0);
+    Sipi::SipiImage truncated = read_jp2(jp2_path, size_spec, layer_percent);
+    ASSERT_EQ(truncated.getNx(), all.getNx());
+    ASSERT_EQ(truncated.getNy(), all.getNy());
+    ASSERT_EQ(truncated.getNc(), all.getNc());
+    const double db = psnr(all, truncated);
+    EXPECT_TRUE(std::isfinite(db)) << size_spec << " @" << int{ layer_percent } << "%: no layers were dropped";
+    EXPECT_GE(db, kMinPsnr) << size_spec << " @" << int{ layer_percent } << "%";
+  }
+
+  static inline const std::string jp2_path = tmp_dir + "_layer_truncation.jp2";
+};
+
+// The share the serve path picks for the default JPEG quality and a 512 px
+// truncation size, at thumbnail and low-zoom sizes.
+TEST_F(J2kLayerTruncation, PolicyShareIsTransparentForPreviews)
+{
+  for (const uint32_t edge : { 128U, 256U, 512U }) {
+    const uint8_t percent = Sipi::j2k_layer_percent(edge, edge, 60, 512);
+    ASSERT_GT(percent, 0);
+    SCOPED_TRACE(edge);
+    expect_transparent("!" + std::to_string(edge) + "," + std::to_string(edge), percent);
+  }
+}
+
+// The policy floor — the fewest layers it ever asks for — at thumbnail size.
+TEST_F(J2kLayerTruncation, FloorShareIsTransparentForThumbnails)
+{
+  expect_transparent("!128,128", static_cast<uint8_t>(Sipi::kJ2kMinLayerPercent));
+}
+
+}// namespace
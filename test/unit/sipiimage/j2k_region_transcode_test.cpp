@@ -0,0 +1,108 @@
+/*
+ * Copyright © 2016 - 2026 Swiss National Data and Service Center for the Humanities and/or DaSCH Service Platform
+ * contributors. SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ * A tile-aligned region of a JPEG2000 source at a reduce-only size is served by
+ * copying its code-blocks into a new codestream (SipiIOJ2k::transcode_region).
+ * For a reversible SIPI JP2 the result must decode to exactly the pixels a
+ * region decode of the source yields, and the Essentials packet must describe
+ * the output's shape.
+ */
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include "SipiImage.h"
+#include "SipiImageError.h"
+#include "formats/SipiIOJ2k.h"
+#include "formats/output_sink.h"
+#include "iiifparser/SipiRegion.h"
+#include "iiifparser/SipiSize.h"
+#include "metadata/essentials.h"
+#include "util/Hash.h"
+#include "test_paths.h"
+
+namespace {
+
+const std::string tmp_dir = sipi::test::tmp_dir() + "/";
+
+// 1100×700 RGB with 256×256 tiles: 5×3 tiles, ragged last column and row.
+constexpr size_t kNx = 1100, kNy = 700, kNc = 3;
+
+std::string write_tiled_source()
+{
+  Sipi::SipiImage src(kNx, kNy, kNc, 8, Sipi::PhotometricInterpretation::RGB);
+  for (size_t y = 0; y < kNy; ++y) {
+    for (size_t x = 0; x < kNx; ++x) {
+      for (size_t c = 0; c < kNc; ++c) { src.setPixel(x, y, c, static_cast<int>((x * 3 + y * 5 + c * 85) % 256)); }
+    }
+  }
+  Sipi::EssentialsFields f;
+  f.origname = "transcode_source.tif";
+  f.mimetype = "image/tiff";
+  f.hash_type = shttps::HashType::sha256;
+  f.data_chksum = src.compute_pixel_hash(f.hash_type);
+  f.img_w = kNx;
+  f.img_h = kNy;
+  f.nc = kNc;
+  f.bps = 8;
+  src.essential_metadata(Sipi::Essentials{ std::move(f) });
+
+  const std::string path = tmp_dir + "transcode_source.jp2";
+  const Sipi::SipiCompressionParams params = { { Sipi::J2K_Stiles, "{256,256}" } };
+  src.write("jpx", path, &params);
+  return path;
+}
+
+void expect_transcode_matches_decode(const Sipi::J2kRegionTranscode &job, const std::string &size_spec)
+{
+  const std::string source = write_tiled_source();
+  const std::string path = tmp_dir + "transcode_" + std::to_string(job.x) + "_" + std::to_string(job.y) + "_r"
+                           + std::to_string(job.reduce) + ".jp2";
+  ASSERT_NO_THROW(Sipi::SipiIOJ2k::transcode_region(source, job, Sipi::FilePath{ path }));
+
+  Sipi::SipiImage expected;
+  expected.read(source,
+    std::make_shared<Sipi::SipiRegion>(job.x, job.y, job.w, job.h),
+    size_spec.empty() ? nullptr : std::make_shared<Sipi::SipiSize>(size_spec));
+  Sipi::SipiImage actual;
+  ASSERT_NO_THROW(actual.read(path));
+  ASSERT_EQ(actual.getNx(), expected.getNx());
+  ASSERT_EQ(actual.getNy(), expected.getNy());
+  EXPECT_TRUE(actual == expected);
+
+  // The Essentials shape follows the output; identity is the source's.
+  const auto &fields = actual.essential_metadata().fields();
+  EXPECT_EQ(fields.img_w, actual.getNx());
+  EXPECT_EQ(fields.img_h, actual.getNy());
+  EXPECT_EQ(fields.origname, "transcode_source.tif");
+
+  Sipi::SipiImage probe;
+  const Sipi::SipiImgInfo info = probe.read_shape(path);
+  EXPECT_EQ(static_cast<size_t>(info.width), actual.getNx());
+  EXPECT_EQ(static_cast<size_t>(info.height), actual.getNy());
+
+  // A region of the transcoded file addresses the output's own pixels.
+  Sipi::SipiImage sub;
+  ASSERT_NO_THROW(sub.read(path, std::make_shared<Sipi::SipiRegion>(10, 20, 30, 40)));
+  EXPECT_EQ(sub.getPixel(0, 0, 1), expected.getPixel(10, 20, 1));
+}
+
+TEST(J2kRegionTranscode, InteriorTilesAtFullResolution)
+{
+  expect_transcode_matches_decode({ 256, 256, 512, 256, 0 }, "");
+}
+
+TEST(J2kRegionTranscode, EdgeTilesReduced) { expect_transcode_matches_decode({ 512, 0, 588, 700, 1 }, "294,"); }
+
+TEST(J2kRegionTranscode, UnalignedRegionThrows)
+{
+  const std::string source = write_tiled_source();
+  EXPECT_THROW(Sipi::SipiIOJ2k::transcode_region(source, { 10, 0, 246, 256, 0 }, Sipi::FilePath{ tmp_dir + "x.jp2" }),
+    Sipi::SipiImageError);
+}
+
+}// namespace
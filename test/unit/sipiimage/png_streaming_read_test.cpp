@@ -0,0 +1,79 @@
+/*
+ * Copyright © 2016 - 2026 Swiss National Data and Service Center for the Humanities and/or DaSCH Service Platform
+ * contributors. SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ * SipiIOPng::read decodes row by row: only the rows inside the Region are kept,
+ * and the HIGH scale runs while decoding (StreamingResampler). The result must
+ * be pixel-identical to the whole-image path it replaces — full decode, then
+ * SipiImage::crop, then SipiImage::scale.
+ */
+
+#include <gtest/gtest.h>
+
+#include <memory>
+#include <string>
+
+#include "SipiImage.h"
+#include "iiifparser/SipiRegion.h"
+#include "iiifparser/SipiSize.h"
+#include "test_paths.h"
+
+namespace {
+
+const std::string test_images = sipi::test::data_dir() + "/images/";
+
+// Reference: decode everything, then crop and scale in memory.
+Sipi::SipiImage read_whole_then_transform(const std::string &path,
+  const std::shared_ptr<Sipi::SipiRegion> &region,
+  const std::string &size_spec)
+{
+  Sipi::SipiImage img;
+  img.read(path);
+  img.crop(region);
+  auto size = std::make_shared<Sipi::SipiSize>(size_spec);
+  size_t nnx = 0, nny = 0;
+  int reduce = -1;
+  bool redonly = false;
+  if (size->get_size(img.getNx(), img.getNy(), nnx, nny, reduce, redonly) != Sipi::SipiSize::FULL) {
+    img.scale(nnx, nny);
+  }
+  return img;
+}
+
+void expect_streamed_equals_reference(const std::string &path,
+  const std::shared_ptr<Sipi::SipiRegion> &region,
+  const std::string &size_spec)
+{
+  Sipi::SipiImage streamed;
+  streamed.read(path, region, std::make_shared<Sipi::SipiSize>(size_spec));
+  const Sipi::SipiImage reference = read_whole_then_transform(path, region, size_spec);
+  ASSERT_EQ(streamed.getNx(), reference.getNx());
+  ASSERT_EQ(streamed.getNy(), reference.getNy());
+  ASSERT_EQ(streamed.getNc(), reference.getNc());
+  EXPECT_TRUE(streamed == reference) << path << " " << size_spec;
+}
+
+TEST(PngStreamingRead, RegionOnlyMatchesCrop)
+{
+  expect_streamed_equals_reference(
+    test_images + "unit/mario.png", std::make_shared<Sipi::SipiRegion>(10, 20, 60, 40), "max");
+}
+
+TEST(PngStreamingRead, FullRegionDownscaleMatchesScale)
+{
+  expect_streamed_equals_reference(test_images + "unit/mario.png", std::make_shared<Sipi::SipiRegion>(), "!64,64");
+}
+
+TEST(PngStreamingRead, RegionAndDownscaleSixteenBit)
+{
+  expect_streamed_equals_reference(
+    test_images + "knora/png_16bit.png", std::make_shared<Sipi::SipiRegion>("pct:10,10,50,60"), "!100,100");
+}
+
+TEST(PngStreamingRead, RegionAndUpscale)
+{
+  expect_streamed_equals_reference(
+    test_images + "unit/mario.png", std::make_shared<Sipi::SipiRegion>(0, 0, 30, 20), "^90,");
+}
+
+}// namespace
@@ -0,0 +1,86 @@
+/*
+ * Copyright © 2016 - 2026 Swiss National Data and Service Center for the Humanities and/or DaSCH Service Platform
+ * contributors. SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ * SipiImage::read_tiles decodes a batch of region/size requests against one open
+ * source — a single TIFF handle, a single persistent Kakadu codestream, or the
+ * per-tile fallback for the other formats. Every tile must come out exactly as a
+ * standalone read() with the same region and size, metadata included, and be
+ * emitted once, in request order.
+ */
+
+#include <gtest/gtest.h>
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "SipiImage.h"
+#include "SipiImageError.h"
+#include "iiifparser/SipiRegion.h"
+#include "iiifparser/SipiSize.h"
+#include "metadata/icc.h"
+#include "test_paths.h"
+
+namespace {
+
+const std::string test_images = sipi::test::data_dir() + "/images/";
+
+// Overlapping, disjoint, reduced and full-image requests, including a repeat.
+std::vector<Sipi::SipiTileRequest> batch()
+{
+  return {
+    { std::make_shared<Sipi::SipiRegion>(0, 0, 256, 256), nullptr },
+    { std::make_shared<Sipi::SipiRegion>(256, 0, 256, 256), std::make_shared<Sipi::SipiSize>("128,") },
+    { std::make_shared<Sipi::SipiRegion>(100, 200, 300, 150), nullptr },
+    { nullptr, std::make_shared<Sipi::SipiSize>("64,") },
+    { std::make_shared<Sipi::SipiRegion>(0, 0, 256, 256), nullptr },
+  };
+}
+
+void expect_tiles_match_reads(const std::string &file)
+{
+  const std::string path = test_images + file;
+  const auto tiles = batch();
+  std::vector<std::size_t> order;
+  ASSERT_NO_THROW(Sipi::SipiImage::read_tiles(path, tiles, [&](std::size_t i, Sipi::SipiImage &tile) {
+    order.push_back(i);
+    Sipi::SipiImage expected;
+    expected.read(path, tiles[i].region, tiles[i].size);
+    ASSERT_EQ(tile.getNx(), expected.getNx()) << file << " tile " << i;
+    ASSERT_EQ(tile.getNy(), expected.getNy()) << file << " tile " << i;
+    EXPECT_TRUE(tile == expected) << file << " tile " << i;
+    // Each tile carries its own copy of the file's metadata.
+    ASSERT_EQ(tile.getIcc() != nullptr, expected.getIcc() != nullptr) << file << " tile " << i;
+    if (tile.getIcc() != nullptr) {
+      EXPECT_EQ(tile.getIcc()->iccBytes(), expected.getIcc()->iccBytes()) << file << " tile " << i;
+    }
+    EXPECT_EQ(tile.getExif() != nullptr, expected.getExif() != nullptr) << file << " tile " << i;
+  }));
+  EXPECT_EQ(order, (std::vector<std::size_t>{ 0, 1, 2, 3, 4 })) << file;
+}
+
+TEST(ReadTiles, UntiledTiffMatchesStandaloneReads) { expect_tiles_match_reads("unit/lena512.tif"); }
+
+TEST(ReadTiles, PyramidTiffMatchesStandaloneReads) { expect_tiles_match_reads("unit/lena512_pyramid.tif"); }
+
+TEST(ReadTiles, Jpeg2000MatchesStandaloneReads) { expect_tiles_match_reads("unit/lena512.jp2"); }
+
+TEST(ReadTiles, FallbackFormatMatchesStandaloneReads) { expect_tiles_match_reads("unit/MaoriFigure.jpg"); }
+
+TEST(ReadTiles, EmptyBatchEmitsNothing)
+{
+  int calls = 0;
+  Sipi::SipiImage::read_tiles(test_images + "unit/lena512.tif", {}, [&](std::size_t, Sipi::SipiImage &) { ++calls; });
+  EXPECT_EQ(calls, 0);
+}
+
+TEST(ReadTiles, MissingFileThrows)
+{
+  const std::vector<Sipi::SipiTileRequest> tiles = { { nullptr, nullptr } };
+  const std::string path = test_images + "unit/does-not-exist.tif";
+  EXPECT_THROW(Sipi::SipiImage::read_tiles(path, tiles, [](std::size_t, Sipi::SipiImage &) {}), Sipi::SipiImageError);
+}
+
+}// namespace
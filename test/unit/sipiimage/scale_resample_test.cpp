@@ -13,9 +13,12 @@
 
 #include <gtest/gtest.h>
 
+#include <algorithm>
+#include <cstdint>
 #include <vector>
 
 #include "../../../src/SipiImage.h"
+#include "../../../src/resample.h"
 
 namespace {
 
@@ -100,4 +103,88 @@ TEST(ScaleResample, Downscale16Bit)
   expect_gray(img, 2, 2, { 2000, 10000, 2000, 10000 });
 }
 
+// The row-streaming resampler (PNG decode path) must be bit-identical to the
+// in-memory two-pass kernel: same weights, same int32 accumulation, only the
+// order of the vertical sums differs, and integer addition is associative.
+// Covered shapes: integer and non-integer downscale, enlarge, mixed axes.
+TEST(ScaleResample, StreamingMatchesInMemory)
+{
+  struct Shape
+  {
+    size_t nx, ny, nnx, nny;
+  };
+  for (const Shape sh : { Shape{ 37, 41, 5, 7 }, Shape{ 64, 64, 17, 23 }, Shape{ 9, 6, 31, 19 }, Shape{ 40, 12, 13, 30 } }) {
+    constexpr size_t nc = 3;
+    std::vector<uint8_t> src(sh.nx * sh.ny * nc);
+    for (size_t i = 0; i < src.size(); ++i) { src[i] = static_cast<uint8_t>((i * 37 + i / 7) & 0xff); }
+
+    const auto wx = Sipi::build_axis_weights(sh.nx, sh.nnx);
+    const auto wy = Sipi::build_axis_weights(sh.ny, sh.nny);
+    std::vector<uint8_t> expected(sh.nnx * sh.nny * nc);
+    Sipi::resample_separable_u8(src.data(), sh.nx, sh.ny, nc, sh.nnx, sh.nny, wx.offset.data(), wx.idx.data(),
+      wx.wt.data(), wy.offset.data(), wy.idx.data(), wy.wt.data(), expected.data());
+
+    std::vector<uint8_t> streamed(expected.size());
+    Sipi::StreamingResampler rs(sh.nx, sh.ny, nc, sh.nnx, sh.nny, 8, streamed.data());
+    for (size_t y = 0; y < sh.ny; ++y) { rs.push_row(src.data() + y * sh.nx * nc); }
+    EXPECT_TRUE(rs.done());
+    EXPECT_EQ(streamed, expected) << sh.nx << "x" << sh.ny << " -> " << sh.nnx << "x" << sh.nny;
+  }
+}
+
+// The 16-bit streaming branch matches the in-memory kernel as well.
+TEST(ScaleResample, StreamingMatchesInMemory16Bit)
+{
+  constexpr size_t nx = 50, ny = 33, nnx = 11, nny = 8, nc = 2;
+  std::vector<uint16_t> src(nx * ny * nc);
+  for (size_t i = 0; i < src.size(); ++i) { src[i] = static_cast<uint16_t>((i * 2711) & 0xffff); }
+
+  const auto wx = Sipi::build_axis_weights(nx, nnx);
+  const auto wy = Sipi::build_axis_weights(ny, nny);
+  std::vector<uint16_t> expected(nnx * nny * nc);
+  Sipi::resample_separable_u16(src.data(), nx, ny, nc, nnx, nny, wx.offset.data(), wx.idx.data(), wx.wt.data(),
+    wy.offset.data(), wy.idx.data(), wy.wt.data(), expected.data());
+
+  std::vector<uint16_t> streamed(expected.size());
+  Sipi::StreamingResampler rs(nx, ny, nc, nnx, nny, 16, streamed.data());
+  for (size_t y = 0; y < ny; ++y) { rs.push_row(src.data() + y * nx * nc); }
+  EXPECT_EQ(streamed, expected);
+}
+
+// 3x3 -> 2x2 pyramid step: the interior block is the rounded mean of four
+// samples, the odd last column/row average only the samples that exist, and
+// the corner is passed through.
+TEST(ScaleResample, BoxReduce2x2OddEdges)
+{
+  const std::vector<uint8_t> src = { 10, 20, 31, 30, 41, 50, 70, 80, 90 };
+  std::vector<uint8_t> out(4);
+  Sipi::box_reduce_2x2_u8(src.data(), 3, 3, 1, out.data());
+  // (10+20+30+41+2)/4 = 25, (31+50+1)/2 = 41, (70+80+1)/2 = 75, 90.
+  EXPECT_EQ(out, (std::vector<uint8_t>{ 25, 41, 75, 90 }));
+}
+
+// 16-bit, multi-channel, odd width and height, wide enough for several SIMD
+// lanes: every output sample is the rounded mean of its (clipped) 2x2 block.
+TEST(ScaleResample, BoxReduce2x2MatchesBlockMean16Bit)
+{
+  constexpr size_t nx = 67, ny = 23, nc = 3;
+  constexpr size_t nnx = (nx + 1) / 2, nny = (ny + 1) / 2;
+  std::vector<uint16_t> src(nx * ny * nc);
+  for (size_t i = 0; i < src.size(); ++i) { src[i] = static_cast<uint16_t>((i * 40503) & 0xffff); }
+
+  std::vector<uint16_t> out(nnx * nny * nc);
+  Sipi::box_reduce_2x2_u16(src.data(), nx, ny, nc, out.data());
+  for (size_t y = 0; y < nny; ++y) {
+    for (size_t x = 0; x < nnx; ++x) {
+      for (size_t c = 0; c < nc; ++c) {
+        uint32_t sum = 0, n = 0;
+        for (size_t yy = 2 * y; yy < std::min(ny, 2 * y + 2); ++yy) {
+          for (size_t xx = 2 * x; xx < std::min(nx, 2 * x + 2); ++xx, ++n) { sum += src[(yy * nx + xx) * nc + c]; }
+        }
+        ASSERT_EQ(out[(y * nnx + x) * nc + c], (sum + n / 2) / n) << "at (" << x << "," << y << "," << c << ")";
+      }
+    }
+  }
+}
+
 }// namespace
@@ -9,6 +9,7 @@
 #include "../../../src/SipiImageError.h"
 #include "formats/SipiIOTiff.h"
 #include "observability/metrics.h"
+#include "resample.h"
 #include "test_paths.h"
 #include <cmath>
 #include <ranges>
@@ -455,6 +456,45 @@ TEST(SipiImage, TiffPyramidLayers)
   }
 }
 
+// 16-bit pyramid levels hold the 2×2 box reduction of the level above, in
+// 16-bit samples: a pct:50 read is served from level 1 unchanged.
+TEST(SipiImage, TiffPyramid16BitLevels)
+{
+  Sipi::SipiIOTiff::initLibrary();
+
+  constexpr size_t nx = 200, ny = 150, nc = 3;
+  Sipi::SipiImage src(nx, ny, nc, 16, Sipi::PhotometricInterpretation::RGB);
+  std::vector<uint16_t> flat(nx * ny * nc);
+  for (size_t y = 0; y < ny; ++y) {
+    for (size_t x = 0; x < nx; ++x) {
+      for (size_t c = 0; c < nc; ++c) {
+        const auto v = static_cast<int>((x * 331 + y * 977 + c * 12011) & 0xffff);
+        src.setPixel(x, y, c, v);
+        flat[(y * nx + x) * nc + c] = static_cast<uint16_t>(v);
+      }
+    }
+  }
+  const std::string out = tmp_dir + "pyramid_16bit.tif";
+  Sipi::SipiCompressionParams params = { { Sipi::TIFF_Pyramid, "yes" } };
+  ASSERT_NO_THROW(src.write("tif", out, &params));
+
+  std::vector<uint16_t> level1((nx / 2) * (ny / 2) * nc);
+  Sipi::box_reduce_2x2_u16(flat.data(), nx, ny, nc, level1.data());
+
+  Sipi::SipiImage img;
+  ASSERT_NO_THROW(img.read(out, std::shared_ptr<Sipi::SipiRegion>(), std::make_shared<Sipi::SipiSize>("pct:50")));
+  ASSERT_EQ(img.getNx(), nx / 2);
+  ASSERT_EQ(img.getNy(), ny / 2);
+  ASSERT_EQ(img.getBps(), 16u);
+  for (size_t y = 0; y < ny / 2; ++y) {
+    for (size_t x = 0; x < nx / 2; ++x) {
+      for (size_t c = 0; c < nc; ++c) {
+        ASSERT_EQ(img.getPixel(x, y, c), level1[(y * (nx / 2) + x) * nc + c]) << "at (" << x << "," << y << ")";
+      }
+    }
+  }
+}
+
 TEST(SipiImage, PercentParsing)
 {
   Sipi::SipiIOTiff::initLibrary();
@@ -0,0 +1,129 @@
+/*
+ * Copyright © 2016 - 2026 Swiss National Data and Service Center for the Humanities and/or DaSCH Service Platform
+ * contributors. SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ * JPEG-compressed TIFF tiles are decoded at 1/2, 1/4 or 1/8 scale by libjpeg
+ * when a request reduces further than the deepest pyramid level. These cases
+ * write a two-level YCbCr/JPEG pyramid with libtiff and check that such a
+ * read decodes only the DCT-scaled tiles and returns the requested size within
+ * JPEG noise of the full-resolution decode of the deepest level, scaled down
+ * afterwards.
+ */
+
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "tiffio.h"
+
+#include "SipiImage.h"
+#include "decode_report.h"
+#include "iiifparser/SipiSize.h"
+#include "test_paths.h"
+
+namespace {
+
+const std::string tmp_dir = sipi::test::tmp_dir() + "/";
+
+constexpr uint32_t kW = 512;
+constexpr uint32_t kH = 384;
+constexpr uint32_t kTile = 128;
+
+uint8_t pattern(uint32_t x, uint32_t y, uint32_t c) { return static_cast<uint8_t>((x / 2 + y / 3 + c * 60) % 256); }
+
+void write_level(TIFF *tif, uint32_t w, uint32_t h, uint32_t ratio, bool reduced)
+{
+  if (reduced) { TIFFSetField(tif, TIFFTAG_SUBFILETYPE, FILETYPE_REDUCEDIMAGE); }
+  TIFFSetField(tif, TIFFTAG_IMAGEWIDTH, w);
+  TIFFSetField(tif, TIFFTAG_IMAGELENGTH, h);
+  TIFFSetField(tif, TIFFTAG_SAMPLESPERPIXEL, static_cast<uint16_t>(3));
+  TIFFSetField(tif, TIFFTAG_BITSPERSAMPLE, static_cast<uint16_t>(8));
+  TIFFSetField(tif, TIFFTAG_PLANARCONFIG, PLANARCONFIG_CONTIG);
+  TIFFSetField(tif, TIFFTAG_TILEWIDTH, kTile);
+  TIFFSetField(tif, TIFFTAG_TILELENGTH, kTile);
+  TIFFSetField(tif, TIFFTAG_COMPRESSION, COMPRESSION_JPEG);
+  TIFFSetField(tif, TIFFTAG_PHOTOMETRIC, PHOTOMETRIC_YCBCR);
+  TIFFSetField(tif, TIFFTAG_JPEGQUALITY, 95);
+  TIFFSetField(tif, TIFFTAG_JPEGCOLORMODE, JPEGCOLORMODE_RGB);
+
+  std::vector<uint8_t> tile(static_cast<size_t>(kTile) * kTile * 3);
+  for (uint32_t ty = 0; ty < h; ty += kTile) {
+    for (uint32_t tx = 0; tx < w; tx += kTile) {
+      for (uint32_t y = 0; y < kTile; ++y) {
+        for (uint32_t x = 0; x < kTile; ++x) {
+          for (uint32_t c = 0; c < 3; ++c) {
+            tile[(y * kTile + x) * 3 + c] = pattern((tx + x) * ratio, (ty + y) * ratio, c);
+          }
+        }
+      }
+      ASSERT_GE(TIFFWriteTile(tif, tile.data(), tx, ty, 0, 0), 0);
+    }
+  }
+  TIFFWriteDirectory(tif);
+}
+
+std::string write_pyramid()
+{
+  const std::string path = tmp_dir + "jpeg_scaled_pyramid.tif";
+  std::unique_ptr<TIFF, decltype(&TIFFClose)> tif(TIFFOpen(path.c_str(), "w"), TIFFClose);
+  EXPECT_NE(tif, nullptr);
+  write_level(tif.get(), kW, kH, 1, false);
+  write_level(tif.get(), kW / 2, kH / 2, 2, true);
+  return path;
+}
+
+double psnr(Sipi::SipiImage &a, Sipi::SipiImage &b)
+{
+  double sse = 0.0;
+  for (size_t y = 0; y < a.getNy(); ++y) {
+    for (size_t x = 0; x < a.getNx(); ++x) {
+      for (size_t c = 0; c < a.getNc(); ++c) {
+        const double d = static_cast<double>(a.getPixel(x, y, c)) - static_cast<double>(b.getPixel(x, y, c));
+        sse += d * d;
+      }
+    }
+  }
+  if (sse == 0.0) { return std::numeric_limits<double>::infinity(); }
+  const double mse = sse / static_cast<double>(a.getNx() * a.getNy() * a.getNc());
+  return 10.0 * std::log10(255.0 * 255.0 / mse);
+}
+
+// `spec` reduces 2×, 4× or 8× past the 1/2 level (DCT scale 1/`denom`). The
+// size stage would produce the requested dimensions from a full decode of the
+// level too, so the decode report must count the 2×2 level tiles at 1/`denom`
+// (a full decode reports them at 128×128). Its path is `Pyramid`, the cheaper
+// of the two paths taken, so the pixel count is what tells them apart.
+// The reference reads that level at full resolution ("256,") and is scaled
+// down to match.
+void expect_scaled_read(const std::string &spec, size_t nx, size_t ny, uint32_t denom)
+{
+  const std::string path = write_pyramid();
+  Sipi::SipiImage scaled;
+  {
+    Sipi::DecodeReportScope report;
+    ASSERT_NO_THROW(scaled.read(path, nullptr, std::make_shared<Sipi::SipiSize>(spec)));
+    EXPECT_EQ(report.pixels(), 4u * (kTile / denom) * (kTile / denom)) << spec;
+  }
+  ASSERT_EQ(scaled.getNc(), 3u);
+  ASSERT_EQ(scaled.getNx(), nx);
+  ASSERT_EQ(scaled.getNy(), ny);
+
+  Sipi::SipiImage reference;
+  ASSERT_NO_THROW(reference.read(path, nullptr, std::make_shared<Sipi::SipiSize>("256,")));
+  ASSERT_EQ(reference.getNx(), kW / 2);
+  reference.scale(nx, ny);
+  EXPECT_GE(psnr(scaled, reference), 30.0) << spec;
+}
+
+TEST(TiffJpegScaledRead, HalfScaleTiles) { expect_scaled_read("128,", 128, 96, 2); }
+
+TEST(TiffJpegScaledRead, QuarterScaleTiles) { expect_scaled_read("64,", 64, 48, 4); }
+
+TEST(TiffJpegScaledRead, EighthScaleTiles) { expect_scaled_read("32,", 32, 24, 8); }
+
+}// namespace
@@ -0,0 +1,105 @@
+/*
+ * Copyright © 2016 - 2026 Swiss National Data and Service Center for the Humanities and/or DaSCH Service Platform
+ * contributors. SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ * Compressed pyramidal TIFF tiles are encoded in parallel and appended with
+ * TIFFWriteRawTile. The file must be byte-identical to the serial writer: every
+ * stored tile has to equal what TIFFWriteEncodedTile emits for the same pixels
+ * with the same tags, and the tiles must decode to the source.
+ */
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "tiffio.h"
+
+#include "SipiImage.h"
+#include "test_paths.h"
+
+namespace {
+
+const std::string tmp_dir = sipi::test::tmp_dir() + "/";
+
+using TiffPtr = std::unique_ptr<TIFF, decltype(&TIFFClose)>;
+
+// Encodes one tile serially with the tags of `src`'s current directory and
+// returns the raw bytes libtiff stored for it.
+std::vector<uint8_t> encode_serially(TIFF *src, const std::vector<uint8_t> &pixels, const std::string &path)
+{
+  uint32_t tw = 0, th = 0;
+  uint16_t bps = 0, spp = 0, photo = 0, compression = 0;
+  TIFFGetField(src, TIFFTAG_TILEWIDTH, &tw);
+  TIFFGetField(src, TIFFTAG_TILELENGTH, &th);
+  TIFFGetField(src, TIFFTAG_BITSPERSAMPLE, &bps);
+  TIFFGetField(src, TIFFTAG_SAMPLESPERPIXEL, &spp);
+  TIFFGetField(src, TIFFTAG_PHOTOMETRIC, &photo);
+  TIFFGetField(src, TIFFTAG_COMPRESSION, &compression);
+  {
+    TiffPtr out(TIFFOpen(path.c_str(), "w"), &TIFFClose);
+    TIFFSetField(out.get(), TIFFTAG_IMAGEWIDTH, tw);
+    TIFFSetField(out.get(), TIFFTAG_IMAGELENGTH, th);
+    TIFFSetField(out.get(), TIFFTAG_BITSPERSAMPLE, bps);
+    TIFFSetField(out.get(), TIFFTAG_SAMPLESPERPIXEL, spp);
+    TIFFSetField(out.get(), TIFFTAG_PHOTOMETRIC, photo);
+    TIFFSetField(out.get(), TIFFTAG_PLANARCONFIG, PLANARCONFIG_CONTIG);
+    TIFFSetField(out.get(), TIFFTAG_COMPRESSION, compression);
+    TIFFSetField(out.get(), TIFFTAG_TILEWIDTH, tw);
+    TIFFSetField(out.get(), TIFFTAG_TILELENGTH, th);
+    TIFFWriteEncodedTile(out.get(), 0, const_cast<uint8_t *>(pixels.data()), static_cast<tmsize_t>(pixels.size()));
+  }
+  TiffPtr in(TIFFOpen(path.c_str(), "r"), &TIFFClose);
+  std::vector<uint8_t> raw(static_cast<size_t>(TIFFRawTileSize(in.get(), 0)));
+  TIFFReadRawTile(in.get(), 0, raw.data(), static_cast<tmsize_t>(raw.size()));
+  return raw;
+}
+
+void expect_tiles_match_serial_encoding(const std::string &compression)
+{
+  // 1100×700 RGB → 5×3 tiles at level 0; five levels above the 32 px floor.
+  constexpr size_t nx = 1100, ny = 700, nc = 3;
+  Sipi::SipiImage src(nx, ny, nc, 8, Sipi::PhotometricInterpretation::RGB);
+  for (size_t y = 0; y < ny; ++y) {
+    for (size_t x = 0; x < nx; ++x) {
+      for (size_t c = 0; c < nc; ++c) { src.setPixel(x, y, c, static_cast<int>((x * 3 + y * 5 + c * 85) % 256)); }
+    }
+  }
+  const std::string path = tmp_dir + "pyramid_" + compression + ".tif";
+  Sipi::SipiCompressionParams params = { { Sipi::TIFF_Pyramid, "yes" }, { Sipi::TIFF_Compression, compression } };
+  ASSERT_NO_THROW(src.write("tif", path, &params));
+
+  TiffPtr tif(TIFFOpen(path.c_str(), "r"), &TIFFClose);
+  ASSERT_NE(tif, nullptr);
+  int levels = 0;
+  do {
+    if (!TIFFIsTiled(tif.get())) { continue; }
+    ++levels;
+    const auto ntiles = TIFFNumberOfTiles(tif.get());
+    ASSERT_GT(ntiles, 0u);
+    for (uint32_t tile = 0; tile < ntiles; ++tile) {
+      std::vector<uint8_t> pixels(static_cast<size_t>(TIFFTileSize(tif.get())));
+      ASSERT_GT(TIFFReadEncodedTile(tif.get(), tile, pixels.data(), static_cast<tmsize_t>(pixels.size())), 0);
+      std::vector<uint8_t> raw(static_cast<size_t>(TIFFRawTileSize(tif.get(), tile)));
+      ASSERT_GT(TIFFReadRawTile(tif.get(), tile, raw.data(), static_cast<tmsize_t>(raw.size())), 0);
+      EXPECT_EQ(raw, encode_serially(tif.get(), pixels, tmp_dir + "pyramid_serial_tile.tif"))
+        << compression << " level " << levels - 1 << " tile " << tile;
+    }
+  } while (TIFFReadDirectory(tif.get()));
+  EXPECT_EQ(levels, 5);
+
+  Sipi::SipiImage back;
+  ASSERT_NO_THROW(back.read(path));
+  EXPECT_TRUE(back == src);
+}
+
+TEST(TiffPyramidWrite, ParallelDeflateTilesMatchSerialEncoding)
+{
+  expect_tiles_match_serial_encoding("COMPRESSION_DEFLATE");
+}
+
+TEST(TiffPyramidWrite, ParallelLzwTilesMatchSerialEncoding) { expect_tiles_match_serial_encoding("COMPRESSION_LZW"); }
+
+}// namespace
@@ -0,0 +1,76 @@
+/*
+ * Copyright © 2016 - 2026 Swiss National Data and Service Center for the Humanities and/or DaSCH Service Platform
+ * contributors. SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ * A streamed TIFF is assembled in an in-memory buffer (MEMTIFF) and handed to
+ * the sink in one ownership-transferring write. The bytes must be identical to
+ * the same image written straight to a file — the in-memory backend behaves like
+ * a file (appends land at the written end, not at the buffer capacity) — and the
+ * buffer must reach an owning sink through `write_owned`, never the copying
+ * `write`.
+ */
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include "SipiImage.h"
+#include "formats/output_sink.h"
+#include "test_paths.h"
+
+namespace {
+
+const std::string test_images = sipi::test::data_dir() + "/images/";
+const std::string tmp_dir = sipi::test::tmp_dir() + "/";
+
+struct OwnedCapture
+{
+  std::vector<uint8_t> bytes;
+  int owned_writes{ 0 };
+};
+
+extern "C" int unexpected_copy(void *, const uint8_t *, size_t) { return 1; }
+
+extern "C" int take_buffer(void *ctx, uint8_t *data, size_t len, Sipi::SipiReleaseFn release)
+{
+  auto *c = static_cast<OwnedCapture *>(ctx);
+  ++c->owned_writes;
+  c->bytes.assign(data, data + len);
+  release(data);
+  return 0;
+}
+
+std::vector<uint8_t> read_all(const std::string &path)
+{
+  std::ifstream in(path, std::ios::binary);
+  return { std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>() };
+}
+
+void expect_stream_equals_file(const Sipi::SipiCompressionParams *params, const std::string &name)
+{
+  Sipi::SipiImage img;
+  ASSERT_NO_THROW(img.read(test_images + "unit/lena512.tif"));
+  Sipi::SipiImage copy(img);
+
+  const std::string path = tmp_dir + name;
+  ASSERT_NO_THROW(img.write("tif", path, params));
+
+  OwnedCapture capture;
+  ASSERT_NO_THROW(copy.write("tif", Sipi::CallbackSink{ &unexpected_copy, &capture, &take_buffer }, params));
+  EXPECT_EQ(capture.owned_writes, 1);
+  EXPECT_EQ(read_all(path), capture.bytes) << name;
+}
+
+TEST(TiffStreamWrite, FlatTiffStreamMatchesFile) { expect_stream_equals_file(nullptr, "stream_flat.tif"); }
+
+TEST(TiffStreamWrite, PyramidTiffStreamMatchesFile)
+{
+  const Sipi::SipiCompressionParams params = { { Sipi::TIFF_Pyramid, "yes" } };
+  expect_stream_equals_file(&params, "stream_pyramid.tif");
+}
+
+}// namespace
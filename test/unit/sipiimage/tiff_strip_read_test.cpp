@@ -0,0 +1,108 @@
+/*
+ * Copyright © 2016 - 2026 Swiss National Data and Service Center for the Humanities and/or DaSCH Service Platform
+ * contributors. SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ * Untiled TIFFs are read strip by strip (TIFFReadEncodedStrip) over only the
+ * strips covering the Region, decoded in parallel when compressed. These cases
+ * write small striped rasters with a known per-pixel pattern and check that
+ * a Region read returns exactly the pattern's window — for contiguous and
+ * separate planes, 8 and 16 bits, compressed and uncompressed, with a Region
+ * that starts and ends mid-strip.
+ */
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "tiffio.h"
+
+#include "SipiImage.h"
+#include "iiifparser/SipiRegion.h"
+#include "test_paths.h"
+
+namespace {
+
+const std::string tmp_dir = sipi::test::tmp_dir() + "/";
+
+constexpr uint32_t kW = 61;
+constexpr uint32_t kH = 97;
+constexpr uint32_t kNc = 3;
+
+uint32_t pattern(uint32_t x, uint32_t y, uint32_t c, uint32_t maxval) { return (x * 7 + y * 13 + c * 61) % maxval; }
+
+void write_striped(const std::string &path, uint16_t bps, uint16_t planar, uint16_t compression, uint32_t rps)
+{
+  std::unique_ptr<TIFF, decltype(&TIFFClose)> tif(TIFFOpen(path.c_str(), "w"), TIFFClose);
+  ASSERT_NE(tif, nullptr);
+  TIFFSetField(tif.get(), TIFFTAG_IMAGEWIDTH, kW);
+  TIFFSetField(tif.get(), TIFFTAG_IMAGELENGTH, kH);
+  TIFFSetField(tif.get(), TIFFTAG_SAMPLESPERPIXEL, static_cast<uint16_t>(kNc));
+  TIFFSetField(tif.get(), TIFFTAG_BITSPERSAMPLE, bps);
+  TIFFSetField(tif.get(), TIFFTAG_PHOTOMETRIC, static_cast<uint16_t>(PHOTOMETRIC_RGB));
+  TIFFSetField(tif.get(), TIFFTAG_PLANARCONFIG, planar);
+  TIFFSetField(tif.get(), TIFFTAG_COMPRESSION, compression);
+  TIFFSetField(tif.get(), TIFFTAG_ROWSPERSTRIP, rps);
+
+  const uint32_t maxval = bps == 16 ? 65521 : 251;
+  const uint32_t planes = planar == PLANARCONFIG_SEPARATE ? kNc : 1;
+  const uint32_t spp = planar == PLANARCONFIG_SEPARATE ? 1 : kNc;
+  std::vector<uint8_t> row(static_cast<size_t>(kW) * spp * (bps / 8));
+  for (uint32_t p = 0; p < planes; ++p) {
+    for (uint32_t y = 0; y < kH; ++y) {
+      for (uint32_t x = 0; x < kW; ++x) {
+        for (uint32_t k = 0; k < spp; ++k) {
+          const uint32_t c = planes == 1 ? k : p;
+          if (bps == 16) {
+            reinterpret_cast<uint16_t *>(row.data())[x * spp + k] = static_cast<uint16_t>(pattern(x, y, c, maxval));
+          } else {
+            row[x * spp + k] = static_cast<uint8_t>(pattern(x, y, c, maxval));
+          }
+        }
+      }
+      ASSERT_EQ(TIFFWriteScanline(tif.get(), row.data(), y, static_cast<uint16_t>(p)), 1);
+    }
+  }
+}
+
+void expect_region(uint16_t bps, uint16_t planar, uint16_t compression, uint32_t rps)
+{
+  const std::string path = tmp_dir + "strip_read_" + std::to_string(bps) + "_" + std::to_string(planar) + "_"
+                           + std::to_string(compression) + "_" + std::to_string(rps) + ".tif";
+  write_striped(path, bps, planar, compression, rps);
+
+  // Starts mid-strip, ends mid-strip, and skips both the top and bottom strips.
+  constexpr uint32_t rx = 5, ry = 21, rw = 40, rh = 53;
+  Sipi::SipiImage img;
+  img.read(path, std::make_shared<Sipi::SipiRegion>(rx, ry, rw, rh));
+  ASSERT_EQ(img.getNx(), rw);
+  ASSERT_EQ(img.getNy(), rh);
+  ASSERT_EQ(img.getNc(), kNc);
+
+  const uint32_t maxval = bps == 16 ? 65521 : 251;
+  for (uint32_t y = 0; y < rh; ++y) {
+    for (uint32_t x = 0; x < rw; ++x) {
+      for (uint32_t c = 0; c < kNc; ++c) {
+        ASSERT_EQ(static_cast<uint32_t>(img.getPixel(x, y, c)), pattern(x + rx, y + ry, c, maxval))
+          << "at (" << x << "," << y << "," << c << ") " << path;
+      }
+    }
+  }
+}
+
+TEST(TiffStripRead, ContiguousLzwRegion) { expect_region(8, PLANARCONFIG_CONTIG, COMPRESSION_LZW, 8); }
+
+TEST(TiffStripRead, ContiguousDeflateRegionSixteenBit)
+{
+  expect_region(16, PLANARCONFIG_CONTIG, COMPRESSION_ADOBE_DEFLATE, 5);
+}
+
+TEST(TiffStripRead, ContiguousUncompressedRegion) { expect_region(8, PLANARCONFIG_CONTIG, COMPRESSION_NONE, 16); }
+
+TEST(TiffStripRead, SeparatePlanesLzwRegion) { expect_region(8, PLANARCONFIG_SEPARATE, COMPRESSION_LZW, 7); }
+
+TEST(TiffStripRead, SingleStripRegion) { expect_region(8, PLANARCONFIG_CONTIG, COMPRESSION_LZW, kH); }
+
+}// namespace
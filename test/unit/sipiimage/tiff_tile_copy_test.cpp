@@ -0,0 +1,134 @@
+/*
+ * Copyright © 2016 - 2026 Swiss National Data and Service Center for the Humanities and/or DaSCH Service Platform
+ * contributors. SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ * A tile-aligned region of a pyramidal TIFF at a reduce-only size is served by
+ * copying the level's compressed tiles (SipiIOTiff::copy_tiles). The copy must
+ * decode to exactly what a region decode of the source yields, and its tiles
+ * must be the source's stored bytes, unchanged.
+ */
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "tiffio.h"
+
+#include "SipiImage.h"
+#include "SipiImageError.h"
+#include "formats/SipiIOTiff.h"
+#include "formats/output_sink.h"
+#include "iiifparser/SipiRegion.h"
+#include "iiifparser/SipiSize.h"
+#include "metadata/icc.h"
+#include "test_paths.h"
+
+namespace {
+
+const std::string tmp_dir = sipi::test::tmp_dir() + "/";
+
+using TiffPtr = std::unique_ptr<TIFF, decltype(&TIFFClose)>;
+
+// 1100×700 RGB, deflate: 5×3 tiles of 256 at level 0, ragged last column/row.
+// With `icc`, the pixels are converted to AdobeRGB and carry its profile.
+std::string write_pyramid(bool icc = false)
+{
+  constexpr size_t nx = 1100, ny = 700, nc = 3;
+  Sipi::SipiImage src(nx, ny, nc, 8, Sipi::PhotometricInterpretation::RGB);
+  for (size_t y = 0; y < ny; ++y) {
+    for (size_t x = 0; x < nx; ++x) {
+      for (size_t c = 0; c < nc; ++c) { src.setPixel(x, y, c, static_cast<int>((x * 3 + y * 5 + c * 85) % 256)); }
+    }
+  }
+  if (icc) { src.convertToIcc(Sipi::Icc(Sipi::icc_AdobeRGB), 8); }
+  const std::string path = tmp_dir + (icc ? "tile_copy_source_icc.tif" : "tile_copy_source.tif");
+  const Sipi::SipiCompressionParams params = { { Sipi::TIFF_Pyramid, "yes" },
+    { Sipi::TIFF_Compression, "COMPRESSION_DEFLATE" } };
+  src.write("tif", path, &params);
+  return path;
+}
+
+std::vector<uint8_t> raw_tile(TIFF *tif, uint32_t x, uint32_t y)
+{
+  const ttile_t tile = TIFFComputeTile(tif, x, y, 0, 0);
+  std::vector<uint8_t> raw(static_cast<size_t>(TIFFRawTileSize(tif, tile)));
+  TIFFReadRawTile(tif, tile, raw.data(), static_cast<tmsize_t>(raw.size()));
+  return raw;
+}
+
+void expect_copy_matches_decode(uint32_t x, uint32_t y, uint32_t w, uint32_t h, int reduce, const std::string &size)
+{
+  const std::string source = write_pyramid();
+  const auto job = Sipi::SipiIOTiff::plan_tile_copy(source, x, y, w, h, reduce);
+  ASSERT_TRUE(job.has_value());
+  EXPECT_EQ(job->level, static_cast<uint32_t>(reduce));
+
+  const std::string path = tmp_dir + "tile_copy_" + std::to_string(x) + "_r" + std::to_string(reduce) + ".tif";
+  ASSERT_NO_THROW(Sipi::SipiIOTiff::copy_tiles(source, *job, Sipi::FilePath{ path }));
+
+  Sipi::SipiImage expected;
+  expected.read(source,
+    std::make_shared<Sipi::SipiRegion>(x, y, w, h),
+    size.empty() ? nullptr : std::make_shared<Sipi::SipiSize>(size));
+  Sipi::SipiImage actual;
+  ASSERT_NO_THROW(actual.read(path));
+  ASSERT_EQ(actual.getNx(), expected.getNx());
+  ASSERT_EQ(actual.getNy(), expected.getNy());
+  EXPECT_TRUE(actual == expected);
+
+  // The first output tile is the source's tile at the region origin, byte for byte.
+  TiffPtr in(TIFFOpen(source.c_str(), "r"), &TIFFClose);
+  ASSERT_NE(TIFFSetDirectory(in.get(), static_cast<tdir_t>(job->level)), 0);
+  TiffPtr out(TIFFOpen(path.c_str(), "r"), &TIFFClose);
+  EXPECT_EQ(raw_tile(out.get(), 0, 0), raw_tile(in.get(), job->x, job->y));
+}
+
+TEST(TiffTileCopy, InteriorTilesAtFullResolution) { expect_copy_matches_decode(256, 256, 512, 256, 0, ""); }
+
+TEST(TiffTileCopy, EdgeTilesOfAReducedLevel) { expect_copy_matches_decode(512, 0, 588, 700, 1, "294,"); }
+
+std::vector<uint8_t> icc_tag(TIFF *tif)
+{
+  uint32_t len = 0;
+  const uint8_t *data = nullptr;
+  if (TIFFGetField(tif, TIFFTAG_ICCPROFILE, &len, &data) != 1) { return {}; }
+  return { data, data + len };
+}
+
+// The pyramid writer stores the profile on IFD 0 only; a copy out of a reduced
+// level must carry it all the same.
+TEST(TiffTileCopy, ReducedLevelKeepsTheDocumentProfile)
+{
+  const std::string source = write_pyramid(true);
+  const auto job = Sipi::SipiIOTiff::plan_tile_copy(source, 0, 0, 512, 512, 1);
+  ASSERT_TRUE(job.has_value());
+  const std::string path = tmp_dir + "tile_copy_icc_r1.tif";
+  ASSERT_NO_THROW(Sipi::SipiIOTiff::copy_tiles(source, *job, Sipi::FilePath{ path }));
+
+  TiffPtr in(TIFFOpen(source.c_str(), "r"), &TIFFClose);
+  const std::vector<uint8_t> profile = icc_tag(in.get());
+  ASSERT_FALSE(profile.empty());
+  TiffPtr out(TIFFOpen(path.c_str(), "r"), &TIFFClose);
+  EXPECT_EQ(icc_tag(out.get()), profile);
+
+  Sipi::SipiImage expected;
+  expected.read(source, std::make_shared<Sipi::SipiRegion>(0, 0, 512, 512), std::make_shared<Sipi::SipiSize>("256,"));
+  Sipi::SipiImage actual;
+  ASSERT_NO_THROW(actual.read(path));
+  ASSERT_NE(actual.getIcc(), nullptr);
+  ASSERT_NE(expected.getIcc(), nullptr);
+  EXPECT_EQ(actual.getIcc()->iccBytes(), expected.getIcc()->iccBytes());
+}
+
+TEST(TiffTileCopy, UnalignedRegionIsNotPlanned)
+{
+  const std::string source = write_pyramid();
+  EXPECT_FALSE(Sipi::SipiIOTiff::plan_tile_copy(source, 10, 0, 246, 256, 0).has_value());
+  EXPECT_THROW(Sipi::SipiIOTiff::copy_tiles(source, { 0, 10, 0, 246, 256 }, Sipi::FilePath{ tmp_dir + "x.tif" }),
+    Sipi::SipiImageError);
+}
+
+}// namespace